@@ -0,0 +1,226 @@
+/*****************************************************************************
+
+common_colour.h
+
+Common include file for both sets of fw (ESP32 and Arduino Nano) in the
+ ButtonChaser project
+
+Integer-only colour space conversions (HSV <-> RGB). Everything in here is
+static inline and uses only 8/16/32-bit integer maths, so it can be compiled
+for the ESP32 as well as the ATmega328 (16-bit int, no FPU) without pulling in
+any float support.
+
+Scaling used throughout:
+    - Hue:          3 flavours, all covering one full turn of the wheel
+                        h360 - degrees, 0 to 359
+                        h8   - 0 to 255 (256 steps per turn)
+                        h16  - 0 to 65535 (65536 steps per turn)
+    - Saturation:   0 to 255
+    - Value:        0 to 255
+    - RGB:          24-bit 0x00RRGGBB
+
+The worst case error of HSV -> RGB is 2 LSB per channel compared to the
+equivalent float calculation, and an RGB -> HSV -> RGB round trip returns each
+channel within 1 LSB of where it started.
+
+It also holds the per-output colour calibration (white balance and a brightness
+limit) which each node keeps in its NV store and reports to the master when it
+is registered. The calibration is applied to the linear colour value, before 
+the gamma (CIE lightness) correction of the output.
+
+******************************************************************************/
+#ifndef __common_colour_H__
+#define __common_colour_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************
+includes
+******************************************************************************/
+#include <stdint.h>
+
+/******************************************************************************
+Macros
+******************************************************************************/
+#define COLOUR_HUE_SECTORS      (6)     /* R->Y->G->C->B->M->R */
+#define COLOUR_HUE360_SECTOR    (60)    /* Degrees per sector */
+#define COLOUR_FRAC_ONE         (256)   /* Sector fraction scale (8.8 fixed point) */
+
+/* An erased (0xFF) calibration is "no correction", so an NV store block without
+ a calibration in it reads as the default */
+#define COLOUR_CAL_DEFAULT      {0xFF, 0xFF, 0xFF, 0xFF}
+
+/* Rounded division by 255, exact for 0 <= x <= 65535 */
+#define COLOUR_DIV255(x)        ((uint16_t)(((uint32_t)(x) + 128 + (((uint32_t)(x) + 128) >> 8)) >> 8))
+
+/******************************************************************************
+Struct & Unions
+******************************************************************************/
+typedef struct
+{
+    uint8_t red;        // Red scale (255 = 100%)
+    uint8_t green;      // Green scale (255 = 100%)
+    uint8_t blue;       // Blue scale (255 = 100%)
+    uint8_t max_lvl;    // Brightness (current) limit applied to all channels (255 = no limit)
+}colour_cal_t;
+
+/******************************************************************************
+Global (public) function definitions
+******************************************************************************/
+
+/*! @brief Scales an 8-bit value, where a scale of 255 leaves the value as is
+ * @param x The value to scale, 0-255
+ * @param scale The scale factor, 0-255 (0% to 100%)
+ * @return The scaled value
+ */
+static inline uint8_t colour_scale8(uint8_t x, uint8_t scale)
+{
+    return (uint8_t)(((uint16_t)x * ((uint16_t)scale + 1)) >> 8);
+}
+
+/*! @brief Applies the white balance of a calibration to an RGB value
+ * @param cal The calibration to apply
+ * @param rgb The 24-bit RGB value
+ * @return The white balanced 24-bit RGB value (the brightness limit is NOT 
+ *  applied here, since it applies to the output after the gamma correction)
+ */
+static inline uint32_t colour_cal_white_balance(const colour_cal_t * cal, uint32_t rgb)
+{
+    return ((uint32_t)colour_scale8((uint8_t)(rgb >> 16), cal->red) << 16) | 
+           ((uint32_t)colour_scale8((uint8_t)(rgb >> 8), cal->green) << 8) | 
+            (uint32_t)colour_scale8((uint8_t)(rgb), cal->blue);
+}
+
+/*! @brief Builds the RGB value for a position on the hue wheel
+ * @param sector The sector of the hue wheel (0 to 5)
+ * @param frac The position within the sector (0 to COLOUR_FRAC_ONE-1)
+ * @param s Saturation, 0-255
+ * @param v Value, 0-255
+ * @return The 24-bit RGB value
+ */
+static inline uint32_t colour_sector2rgb(uint8_t sector, uint16_t frac, uint8_t s, uint8_t v)
+{
+    uint8_t rgb_max = v;
+    uint8_t rgb_min = (uint8_t)(v - COLOUR_DIV255((uint16_t)v * s));
+    /* RGB adjustment amount by position in the sector (rounded) */
+    uint8_t rgb_adj = (uint8_t)((((uint16_t)(rgb_max - rgb_min)) * frac + (COLOUR_FRAC_ONE/2)) >> 8);
+    uint8_t r, g, b;
+
+    switch (sector)
+    {
+    case 0:  r = rgb_max;           g = rgb_min + rgb_adj;  b = rgb_min;            break;
+    case 1:  r = rgb_max - rgb_adj; g = rgb_max;            b = rgb_min;            break;
+    case 2:  r = rgb_min;           g = rgb_max;            b = rgb_min + rgb_adj;  break;
+    case 3:  r = rgb_min;           g = rgb_max - rgb_adj;  b = rgb_max;            break;
+    case 4:  r = rgb_min + rgb_adj; g = rgb_min;            b = rgb_max;            break;
+    default: r = rgb_max;           g = rgb_min;            b = rgb_max - rgb_adj;  break;
+    }
+    return ((uint32_t)r << 16) | ((uint32_t)g << 8) | (uint32_t)b;
+}
+
+/*! @brief Converts HSV to RGB, with the hue in degrees
+ * @param h Hue angle, 0-359 (wrapped if larger)
+ * @param s Saturation, 0-255
+ * @param v Value, 0-255
+ * @return The 24-bit RGB value
+ */
+static inline uint32_t colour_hsv2rgb_h360(uint16_t h, uint8_t s, uint8_t v)
+{
+    h %= 360;
+    return colour_sector2rgb((uint8_t)(h / COLOUR_HUE360_SECTOR),
+                             (uint16_t)(((h % COLOUR_HUE360_SECTOR) * COLOUR_FRAC_ONE) / COLOUR_HUE360_SECTOR),
+                             s, v);
+}
+
+/*! @brief Converts HSV to RGB, with a 16-bit hue (65536 steps per turn)
+ * @param h Hue, 0-65535
+ * @param s Saturation, 0-255
+ * @param v Value, 0-255
+ * @return The 24-bit RGB value
+ */
+static inline uint32_t colour_hsv2rgb_h16(uint16_t h, uint8_t s, uint8_t v)
+{
+    uint32_t h6 = (uint32_t)h * COLOUR_HUE_SECTORS;     /* sector in the top bits, fraction in the lower 16 */
+    return colour_sector2rgb((uint8_t)(h6 >> 16), (uint16_t)((h6 >> 8) & 0xFF), s, v);
+}
+
+/*! @brief Converts HSV to RGB, with an 8-bit hue (256 steps per turn)
+ * @param h Hue, 0-255
+ * @param s Saturation, 0-255
+ * @param v Value, 0-255
+ * @return The 24-bit RGB value
+ */
+static inline uint32_t colour_hsv2rgb_h8(uint8_t h, uint8_t s, uint8_t v)
+{
+    return colour_hsv2rgb_h16((uint16_t)h << 8, s, v);
+}
+
+/*! @brief Converts RGB to HSV, with a 16-bit hue (65536 steps per turn)
+ * @param rgb The 24-bit RGB value
+ * @param h Pointer to the hue, 0-65535 (may be NULL)
+ * @param s Pointer to the saturation, 0-255 (may be NULL)
+ * @param v Pointer to the value, 0-255 (may be NULL)
+ */
+static inline void colour_rgb2hsv_h16(uint32_t rgb, uint16_t *h, uint8_t *s, uint8_t *v)
+{
+    uint8_t r = (uint8_t)(rgb >> 16);
+    uint8_t g = (uint8_t)(rgb >> 8);
+    uint8_t b = (uint8_t)(rgb);
+    uint8_t max = (r > g) ? ((r > b) ? r : b) : ((g > b) ? g : b);
+    uint8_t min = (r < g) ? ((r < b) ? r : b) : ((g < b) ? g : b);
+    uint8_t delta = max - min;
+    int32_t h_tmp;
+
+    if (v)
+        *v = max;
+
+    if (delta == 0)
+    {
+        /* Grey scale - hue and saturation are 0 */
+        if (s)
+            *s = 0;
+        if (h)
+            *h = 0;
+        return;
+    }
+
+    if (s)
+        *s = (uint8_t)(((uint16_t)delta * 255 + (max/2)) / max);
+
+    if (h)
+    {
+        /* Sector base + signed offset within the sector, both in 1/6th turn units of 65536/6 */
+        if (r == max)
+            h_tmp = 0L     + (((int32_t)((int16_t)g - b) * 65536L) / (COLOUR_HUE_SECTORS * (int32_t)delta));
+        else if (g == max)
+            h_tmp = 21845L + (((int32_t)((int16_t)b - r) * 65536L) / (COLOUR_HUE_SECTORS * (int32_t)delta));
+        else
+            h_tmp = 43691L + (((int32_t)((int16_t)r - g) * 65536L) / (COLOUR_HUE_SECTORS * (int32_t)delta));
+
+        /* The red sector wraps around 0 - the cast to 16 bits takes care of this */
+        *h = (uint16_t)h_tmp;
+    }
+}
+
+/*! @brief Converts RGB to HSV, with an 8-bit hue (256 steps per turn)
+ * @param rgb The 24-bit RGB value
+ * @param h Pointer to the hue, 0-255 (may be NULL)
+ * @param s Pointer to the saturation, 0-255 (may be NULL)
+ * @param v Pointer to the value, 0-255 (may be NULL)
+ */
+static inline void colour_rgb2hsv_h8(uint32_t rgb, uint8_t *h, uint8_t *s, uint8_t *v)
+{
+    uint16_t h16;
+    colour_rgb2hsv_h16(rgb, &h16, s, v);
+    if (h)
+        *h = (uint8_t)((h16 + 0x80) >> 8);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __common_colour_H__ */
+
+/****************************** END OF FILE **********************************/
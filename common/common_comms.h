@@ -9,11 +9,13 @@ Messages between the master and the slave devices are sent with an STX-DLE-ETX
 framing.
 
 Within the framing, the message format is as follows:
-    [Version][Flags][ID][SRC][DST][PAYLOAD][CRC]:
+    [Version][ID][SRC][DST][FRAG][LEN][PAYLOAD][CRC]:
     - VERSION: The current version of the message format
     - ID: Unique ID/Sequence number of this message (to help sync)
     - SRC: The source address of the message
     - DST: The destination address of the message
+    - FRAG: The fragment index (bits 0-6), with bit 7 set if more fragments follow
+    - LEN: The number of PAYLOAD bytes in this frame
     - PAYLOAD: The data of the message which will be 1 or more Cmd-&-Data 
         elements, where the Cmd is 1 byte and the data is 0 or more bytes.
         The number of data bytes associated with each command is determined by 
@@ -21,6 +23,11 @@ Within the framing, the message format is as follows:
         [Cmd_1][4 bytes][Cmd_2][0 bytes]...[Cmd_N][X bytes]
     - CRC: The CRC of the message (all bytes preceding this byte)
 
+Messages longer than a single frame (RGB_BTN_FRAME_MAX_LEN) are split into 
+fragments which share the same ID, SRC and DST. Fragments are sent in order, 
+and the receiver reassembles them (up to RGB_BTN_MSG_MAX_LEN) before the 
+commands are processed, so a command (and its data) may span over 2 frames.
+
 ******************************************************************************/
 #ifndef __common_comms_H__
 #define __common_comms_H__
@@ -32,7 +39,9 @@ extern "C" {
 includes
 ******************************************************************************/
 #include <stdint.h>
+#include <stdbool.h>
 #include "common_defines.h"
+#include "common_colour.h"
 
 /******************************************************************************
 definitions
@@ -53,8 +62,12 @@ Macros
 
 // #define RGB_BTN_I2C_CLK_FREQ    (200000)    /* 200kHz */
 
-#define RGB_BTN_MSG_MAX_LEN     (32)    /* Keep as a multiple of 4 */
-#define RGB_BTN_MSG_VERSION     (0)
+#define RGB_BTN_MSG_MAX_LEN     (128)   /* A (reassembled) message - Keep as a multiple of 4 */
+#define RGB_BTN_FRAME_MAX_LEN   (64)    /* A single frame on the bus, limited by the RAM on the nodes - Keep as a multiple of 4 */
+#define RGB_BTN_MSG_VERSION     (1)     /* v1: FRAG and LEN added to the header */
+
+#define COMMS_FRAG_MORE         (0x80)  /* More fragments of this message will follow */
+#define COMMS_FRAG_INDEX_MASK   (0x7F)
 
 #define STX     (0x02)
 #define DLE     (0x10)
@@ -75,6 +88,7 @@ Macros
 #define BUS_SILENCE_MIN_MS              (5)  /* ms */
 #define ROLL_CALL_BASE_TIME_MS          (2 * BUS_SILENCE_MIN_MS)
 #define ROLL_CALL_TIMOUT_MS(_a, _r)     (((uint32_t)_a * ROLL_CALL_BASE_TIME_MS) + _r)
+#define ROLL_CHECK_TIMOUT_MS(_slot)     (((uint32_t)(_slot) + 1) * ROLL_CALL_BASE_TIME_MS) /* Registered nodes answer a check (or a cmd_poll_reaction) in their own slot, so no jitter is needed */
 
 #define REMOTE_CONSOLE_SUPPORTED (0) /* Enables/disables the remote console (which is still untested). Currently this equates to 650 bytes Flash and 2 bytes RAM */
 
@@ -82,77 +96,138 @@ Macros
 #define CMD_TYPE_DIRECT     0x02
 #define CMD_TYPE_RESTRICTED 0x04
 
+#define CMD_RC_PAYLOAD_ALL          (0x00)  /* Every node answers (and forgets its registration) */
+#define CMD_RC_PAYLOAD_UNREG        (0x01)  /* Only the unregistered nodes answer */
+#define CMD_RC_PAYLOAD_CHECK        (0x02)  /* Only the registered nodes answer, with their slot (they stay registered) */
+
+#define CMD_RC_SLOT_NONE            (0xFF)  /* The slot in a roll-call response from an unregistered node */
+
 #define CMD_SW_PAYLOAD_DEACTIVATE   (0x00)
 #define CMD_SW_PAYLOAD_ACTIVATE     (0x01)
 
+#define CMD_SEQ_STEPS_MAX           (32)    /* The steps in a cmd_set_sequence (the node keeps a bit for each) */
+
 /******************************************************************************
 Struct & Unions
 ******************************************************************************/
 
-typedef enum command_e
-{/* command id                  #      Description                        MOSI Payload  Response (MISO) Payload */
-    cmd_none                = 0x00, /* Placeholder (RVN - ping?)           none             none */
-    
-    cmd_roll_call           = 0x01, /* Requests a Slave Roll-call          1 byte          none                */
-
-    cmd_bcast_address_mask  = 0x02, /* Indicates the indices of            uint32_t         none
-                                         intended recipients of the 
-                                         broadcast message
-                                        IMPORTANT: This should be the 1st cmd in any broadcast message (dst == 0xFF)*/
-
-
-    cmd_set_rgb_0           = 0x10, /* Set the primary LED colour          24 bits          none                */
-    cmd_set_rgb_1           = 0x11, /* Set the secondary LED colour        24 bits          none                */
-    cmd_set_rgb_2           = 0x12, /* Set the 3rd LED colour              24 bits          none                */
-    cmd_set_blink           = 0x13, /* Set the blinking interval           uint32_t         none                */
-    cmd_set_switch          = 0x14, /* Starts the button stopwatch         1 byte           none                */
-    //Skip 0x15, which corresponds to the "get Flags" command
-    cmd_set_dbg_led         = 0x16, /* Set the debug LED state             1 byte           none                */
-    cmd_set_time            = 0x17, /* Set the system time                 uint32_t         none                */
-
-#if CLOCK_CORRECTION_ENABLED == 1
-    cmd_set_sync            = 0x18, /* Start/end the time sync process     uint32_t         none                */
-#endif /* CLOCK_CORRECTION_ENABLED */
-   
-    /* ############# END OF BROADCAST'able COMMANDS!! #############
-        ALL commands values higher than "cmd_set_bitmask_index" can ONLY be sent directly to a node */                                        
-
-    cmd_set_bitmask_index   = 0x30, /* Registers a slave by assigning it   1 byte           none                
-                                        a slot (address bit 0 to 31) */
-
-
-    cmd_new_add             = 0x31, /* Sets a new device address - MUST    1 byte             none                
-                                        IMPORTANT: This must be the LAST cmd in any message                     */
-
-    cmd_get_rgb_0           = 0x40, /* Get the primary LED colour          none             24 bits             */
-    cmd_get_rgb_1           = 0x41, /* Get the secondary LED colour        none             24 bits             */
-    cmd_get_rgb_2           = 0x42, /* Get the 3rd LED colour              none             24 bits             */
-    cmd_get_blink           = 0x43, /* Get the blinking interval           none             uint32_t            */
-    cmd_get_reaction        = 0x44, /* Requests the button reaction time   none             4 bytes             */
-    cmd_get_flags           = 0x45, /* Requests the system flags           none             1 bytes             */
-
-    cmd_get_dbg_led         = 0x46, /* Get the debug LED state             none             1 byte              */
+/* The fixed part of a cmd_set_sequence. Step n starts (lead_ms + n*(on_ms + off_ms)) after the msg was received */
+#pragma pack(push, 1)
+typedef struct
+{
+    uint8_t     steps;      // The number of steps (slots) following this (0 to CMD_SEQ_STEPS_MAX)
+    uint8_t     rgb[3];     // The colour of a step (24-bit RGB, LSB first)
+    uint16_t    lead_ms;    // The time before the 1st step
+    uint16_t    on_ms;      // The time a step is lit
+    uint16_t    off_ms;     // The time between steps
+}cmd_sequence_t;
+#pragma pack(pop)
 
-    cmd_get_time            = 0x47, /* Requests the system runtime         none             4 bytes             */
+/* The one and only list of commands. Everything else (the enum, the descriptor
+ table, the names) is generated from this, so they cannot drift apart.
+    X(arg, command id, #, MOSI payload size, MISO (response) payload size, access flags, name)
+ Commands with no access flags (0) are not "known" to either side, they only 
+ have a name. 
+ IMPORTANT: Commands below cmd_set_bitmask_index are the only ones which may be
+ broadcast (dst == 0xFF) - see CMD_TYPE_BROADCAST */
+#define CMD_LIST(X, a)                                                                                                                                              \
+    /* Placeholder (RVN - ping?) */                                                                                                                                 \
+    X(a, cmd_none,              0x00, 0,                    0,                      0,                                          "none")                         \
+    /* Requests a Slave Roll-call: {All, only Unreg or a Check of the registered} - Response: {Bitmask Slot (CMD_RC_SLOT_NONE if unregistered)} */                  \
+    X(a, cmd_roll_call,         0x01, sizeof(uint8_t),      sizeof(uint8_t),        CMD_TYPE_BROADCAST | CMD_TYPE_RESTRICTED,   "roll_call")                    \
+    /* Indicates the indices of the intended recipients of the broadcast message: {Destination Mask}                                                                \
+        IMPORTANT: This should be the 1st cmd in any broadcast message (dst == 0xFF) */                                                                             \
+    X(a, cmd_bcast_address_mask,0x02, sizeof(uint32_t),     0,                      CMD_TYPE_BROADCAST | CMD_TYPE_RESTRICTED,   "bcast_address_mask")           \
+    /* Set the primary/secondary/3rd LED colour: {24-bit RGB} */                                                                                                    \
+    X(a, cmd_set_rgb_0,         0x10, 3*sizeof(uint8_t),    0,                      CMD_TYPE_BROADCAST | CMD_TYPE_DIRECT,       "set_rgb_0")                    \
+    X(a, cmd_set_rgb_1,         0x11, 3*sizeof(uint8_t),    0,                      CMD_TYPE_BROADCAST | CMD_TYPE_DIRECT,       "set_rgb_1")                    \
+    X(a, cmd_set_rgb_2,         0x12, 3*sizeof(uint8_t),    0,                      CMD_TYPE_BROADCAST | CMD_TYPE_DIRECT,       "set_rgb_2")                    \
+    /* Set the blinking interval: {Blink Rate (ms)} */                                                                                                              \
+    X(a, cmd_set_blink,         0x13, sizeof(uint32_t),     0,                      CMD_TYPE_BROADCAST | CMD_TYPE_DIRECT,       "set_blink")                    \
+    /* Starts the button stopwatch: {Switch State (on/off)} */                                                                                                      \
+    X(a, cmd_set_switch,        0x14, sizeof(uint8_t),      0,                      CMD_TYPE_BROADCAST | CMD_TYPE_DIRECT,       "set_switch")                   \
+    /* Skip 0x15, which corresponds to the "get Flags" command */                                                                                                   \
+    /* Set the debug LED state: {Debug LED State} */                                                                                                                \
+    X(a, cmd_set_dbg_led,       0x16, sizeof(uint8_t),      0,                      CMD_TYPE_BROADCAST | CMD_TYPE_DIRECT,       "set_dbg_led")                  \
+    /* Set the system time: {New Time in ms} */                                                                                                                     \
+    X(a, cmd_set_time,          0x17, sizeof(uint32_t),     0,                      CMD_TYPE_BROADCAST | CMD_TYPE_DIRECT,       "set_time")                     \
+    /* Start/end the time sync process: {ms Elapsed on Master} */                                                                                                   \
+    CMD_LIST_SET_SYNC(X, a)                                                                                                                                         \
+    /* Sets a different colour for each node in the bcast address mask: {colour index (0..2), RGB for each bit set in                                               \
+        the cmd_bcast_address_mask, lowest slot first}. Only the colour index is in the MOSI size, the RGBs follow it.                                              \
+        IMPORTANT: Broadcast ONLY, and the LAST cmd in the message */                                                                                               \
+    X(a, cmd_set_rgb_scatter,   0x19, sizeof(uint8_t),      0,                      CMD_TYPE_BROADCAST,                         "set_rgb_scatter")              \
+    /* Plays a sequence of steps, timed by the node itself from the end of the msg: {cmd_sequence_t, slot of each step}.                                            \
+        A node lights up in the steps with its slot and shows its primary colour in-between. 0 steps stops the playback.                                            \
+        Only the cmd_sequence_t is in the MOSI size, the slots follow it.                                                                                           \
+        IMPORTANT: Broadcast ONLY, and the LAST cmd in the message */                                                                                               \
+    X(a, cmd_set_sequence,      0x1A, sizeof(cmd_sequence_t), 0,                    CMD_TYPE_BROADCAST,                         "set_sequence")                 \
+    /* Reads the reaction time of every node in the bcast address mask. Each of them answers in its own slot, its rank in                                           \
+        the mask (see ROLL_CHECK_TIMOUT_MS()) - Response: {Reaction Time (ms)}                                                                                      \
+        IMPORTANT: Broadcast ONLY */                                                                                                                                \
+    X(a, cmd_poll_reaction,     0x1B, 0,                    sizeof(uint32_t),       CMD_TYPE_BROADCAST,                         "poll_reaction")                \
+                                                                                                                                                                    \
+    /* ############# END OF BROADCAST'able COMMANDS!! ############# */                                                                                              \
+                                                                                                                                                                    \
+    /* Registers a slave by assigning it a slot (address bit 0 to 31): {Registration Slot} */                                                                       \
+    X(a, cmd_set_bitmask_index, 0x30, sizeof(uint8_t),      0,                      CMD_TYPE_DIRECT | CMD_TYPE_RESTRICTED,      "set_bitmask_index")            \
+    /* Sets a new device address: {New Address}                                                                                                                     \
+        IMPORTANT: This must be the LAST cmd in any message */                                                                                                      \
+    X(a, cmd_new_add,           0x31, sizeof(uint8_t),      0,                      CMD_TYPE_DIRECT | CMD_TYPE_RESTRICTED,      "new_add")                      \
+    /* Sets (and saves) the colour calibration of the node: {colour_cal_t} */                                                                                       \
+    X(a, cmd_set_calib,         0x32, sizeof(colour_cal_t), 0,                      CMD_TYPE_DIRECT,                            "set_calib")                    \
+    /* Get the primary/secondary/3rd LED colour: {24-bit RGB} */                                                                                                    \
+    X(a, cmd_get_rgb_0,         0x40, 0,                    3*sizeof(uint8_t),      CMD_TYPE_DIRECT,                            "get_rgb_0")                    \
+    X(a, cmd_get_rgb_1,         0x41, 0,                    3*sizeof(uint8_t),      CMD_TYPE_DIRECT,                            "get_rgb_1")                    \
+    X(a, cmd_get_rgb_2,         0x42, 0,                    3*sizeof(uint8_t),      CMD_TYPE_DIRECT,                            "get_rgb_2")                    \
+    /* Get the blinking interval: {Blink Rate (ms)} */                                                                                                              \
+    X(a, cmd_get_blink,         0x43, 0,                    sizeof(uint32_t),       CMD_TYPE_DIRECT,                            "get_blink")                    \
+    /* Requests the button reaction time: {React Time (ms)} */                                                                                                      \
+    X(a, cmd_get_reaction,      0x44, 0,                    sizeof(uint32_t),       CMD_TYPE_DIRECT,                            "get_sw_time")                  \
+    /* Requests the system flags: {State Flags} */                                                                                                                  \
+    X(a, cmd_get_flags,         0x45, 0,                    sizeof(uint8_t),        CMD_TYPE_DIRECT,                            "get_flags")                    \
+    /* Get the debug LED state: {Debug LED state} */                                                                                                                \
+    X(a, cmd_get_dbg_led,       0x46, 0,                    sizeof(uint8_t),        CMD_TYPE_DIRECT,                            "get_dbg_led")                  \
+    /* Requests the system runtime: {Runtime (ms)} */                                                                                                               \
+    X(a, cmd_get_time,          0x47, 0,                    sizeof(uint32_t),       CMD_TYPE_DIRECT,                            "get_time")                     \
+    /* Requests the time sync value: {correction factor} */                                                                                                         \
+    CMD_LIST_GET_SYNC(X, a)                                                                                                                                         \
+    /* Requests the fw version: {Version} */                                                                                                                        \
+    X(a, cmd_get_version,       0x49, 0,                    sizeof(uint32_t),       CMD_TYPE_DIRECT,                            "get_version")                  \
+    /* Requests the node's link counters: {link_stats_t} */                                                                                                         \
+    X(a, cmd_get_link,          0x4A, 0,                    sizeof(link_stats_t),   CMD_TYPE_DIRECT,                            "get_link")                     \
+    /* Requests the colour calibration: {colour_cal_t} */                                                                                                           \
+    X(a, cmd_get_calib,         0x4B, 0,                    sizeof(colour_cal_t),   CMD_TYPE_DIRECT,                            "get_calib")                    \
+    /* Write to the slave device console (untested) */                                                                                                              \
+    CMD_LIST_REMOTE_CONSOLE(X, a)                                                                                                                                   \
+    /* Dummy command. just fills the data buffer */                                                                                                                 \
+    X(a, cmd_debug_0,           0x80, 0,                    0,                      0,                                          "debug_0")
 
 #if CLOCK_CORRECTION_ENABLED == 1
-    cmd_get_sync            = 0x48, /* Requests the time sync value        none             uint32_t            */
+#define CMD_LIST_SET_SYNC(X, a)     X(a, cmd_set_sync, 0x18, sizeof(uint32_t), 0, CMD_TYPE_BROADCAST | CMD_TYPE_DIRECT, "set_sync")
+#define CMD_LIST_GET_SYNC(X, a)     X(a, cmd_get_sync, 0x48, 0, sizeof(float), CMD_TYPE_DIRECT, "get_sync")
+#else
+#define CMD_LIST_SET_SYNC(X, a)
+#define CMD_LIST_GET_SYNC(X, a)
 #endif /* CLOCK_CORRECTION_ENABLED */
-    cmd_get_version         = 0x49, /* Requests the fw veresion            none             uint32_t            */
-
-#if REMOTE_CONSOLE_SUPPORTED == 1    
-    /* This command cannot be "packed" along with other commands as the entire payload will be used*/
-    cmd_wr_console_cont     = 0x40, /* Write to the slave device console   buffer           none
-                                        1st byte in data is the length 
-                                        of the data to send to the slave 
-                                        console */  
-    cmd_wr_console_done     = 0x41, /* Last part of a write to the slave   buffer           expects a potentially 
-                                        device console. 1st byte in data                    multi-packet response 
-                                        is the length of the data to send 
-                                        to the slave console */  
+
+#if REMOTE_CONSOLE_SUPPORTED == 1
+/* These commands cannot be "packed" along with other commands as the entire payload will be used. The 1st byte in
+ the data is the length of the data to send to the slave console. "done" expects a potentially multi-packet response.
+ RVN - These share their IDs with cmd_get_rgb_0/1, so they have no descriptor (and will need new IDs before they can
+ be used) */
+#define CMD_LIST_REMOTE_CONSOLE(X, a)                                                                                   \
+    X(a, cmd_wr_console_cont,   0x40, 0, 0, 0, "wr_console_cont")                                                       \
+    X(a, cmd_wr_console_done,   0x41, 0, 0, 0, "wr_console_done")
+#else
+#define CMD_LIST_REMOTE_CONSOLE(X, a)
 #endif /* REMOTE_CONSOLE_SUPPORTED */
 
-    cmd_debug_0             = 0x80, /* Dummy command. just fills the data buffer */
+#define _CMD_X_ENUM(a, _cmd, _id, _mosi, _miso, _access, _name)  _cmd = _id,
+
+typedef enum command_e
+{
+    CMD_LIST(_CMD_X_ENUM, ~)
 }master_command_t;
 
 typedef union {
@@ -194,6 +269,15 @@ typedef enum dbg_blink_state_e
     dbg_led_on          = 0xff, /* This is the "on" state, not a blink state */
 }dbg_blink_state_t;
 
+/* Link quality counters as seen by a node (saturating 8-bit counters, cleared when read) */
+typedef struct
+{
+    uint8_t             crc_err; // Frames received with a bad CRC
+    uint8_t             echo_err; // Transmissions where our echo did not match (collision) or never came back
+    uint8_t             tx_retries; // Transmissions that had to be retried
+    uint8_t             tx_abandoned; // Transmissions abandoned after all the retries
+}link_stats_t;
+
 typedef struct
 {
     uint32_t            version; // The address of the node (0x00 to 0x7F)
@@ -205,6 +289,7 @@ typedef struct
     uint8_t             flags; // The system flags
     float               time_factor; // The time factor (used for the time correction)
     bool                sw_active; // Is the button stopwatch active?
+    colour_cal_t        calib; // The colour calibration of the node (read at registration)
 }button_t;
 
 /******************************************************************************
@@ -218,60 +303,135 @@ typedef struct {
     uint8_t id;     // Unique ID/Sequence number of this message (to help sync)
     uint8_t src;    // The source address of the message
     uint8_t dst;    // The destination address of the message
+    uint8_t frag;   // The fragment index, | COMMS_FRAG_MORE if this is not the last fragment
+    uint8_t len;    // The number of data bytes in this frame (excluding the header and CRC)
 }comms_msg_hdr_t;
 
 #define RGB_BTN_MSG_MAX_DATA_LEN     (RGB_BTN_MSG_MAX_LEN - sizeof(comms_msg_hdr_t) - sizeof(uint8_t)) // The maximum data length of the message, excluding the header and CRC
 
+// The number of RGB values which fit into a single cmd_set_rgb_scatter broadcast (after the address mask cmd, scatter cmd, colour index and CRC)
+#define RGB_BTN_SCATTER_MAX_NODES    ((RGB_BTN_MSG_MAX_DATA_LEN - (sizeof(uint8_t) + sizeof(uint32_t)) - (2*sizeof(uint8_t)) - sizeof(uint8_t)) / (3*sizeof(uint8_t)))
+
 typedef struct {
     comms_msg_hdr_t hdr;
     uint8_t data[RGB_BTN_MSG_MAX_DATA_LEN];
     uint8_t crc;    // Not necessarily the last byte of the message, but we should allow for it
 }comms_msg_t;
+
+#define RGB_BTN_FRAME_MAX_DATA_LEN   (RGB_BTN_FRAME_MAX_LEN - sizeof(comms_msg_hdr_t) - sizeof(uint8_t)) // The maximum data length of a single frame, excluding the header and CRC
+
+typedef struct {
+    comms_msg_hdr_t hdr;
+    uint8_t data[RGB_BTN_FRAME_MAX_DATA_LEN];
+    uint8_t crc;    // Not necessarily the last byte of the frame, but we should allow for it
+}comms_frame_t;
 #pragma pack(pop)
 
-typedef struct command_s
-{
-    master_command_t cmd; /* The command ID */
-    uint8_t mosi_sz;      /* The size of the payload of cmds FROM the Master TO the Slave */
-    uint8_t miso_sz;      /* The size of the payload of cmd responses FROM the slave TO the master */
-    uint8_t access_flags; /* A mask indicating how this command can be accessed */
-}command_payload_size_t;
+/* The command descriptor, packed into 16 bits:
+    bits 0-3:   MOSI payload size (0 to 15 bytes)
+    bits 4-7:   MISO (OK response) payload size (0 to 15 bytes)
+    bits 8-10:  Access flags (CMD_TYPE_xxx), 0 if the command is not known */
+typedef uint16_t cmd_desc_t;
+
+#define CMD_DESC_PACK(_mosi, _miso, _access)    ((cmd_desc_t)(((_mosi) & 0x0F) | (((_miso) & 0x0F) << 4) | (((_access) & 0x07) << 8)))
+#define CMD_DESC_MOSI_SZ(_desc)                 ((uint8_t)((_desc) & 0x0F))
+#define CMD_DESC_MISO_SZ(_desc)                 ((uint8_t)(((_desc) >> 4) & 0x0F))
+#define CMD_DESC_ACCESS(_desc)                  ((uint8_t)(((_desc) >> 8) & 0x07))
+
+#define CMD_DESC_TABLE_SIZE     (256)   /* Directly indexed by the command ID */
+
+/* The descriptor (and name) of the command with ID _i, as a constant expression */
+#define _CMD_X_DESC(_i, _cmd, _id, _mosi, _miso, _access, _name)     ((_i) == (_id))? CMD_DESC_PACK(_mosi, _miso, _access) :
+#define _CMD_X_NAME(_i, _cmd, _id, _mosi, _miso, _access, _name)     ((_i) == (_id))? _name :
+#define CMD_DESC_AT(_i)         (CMD_LIST(_CMD_X_DESC, _i) (cmd_desc_t)0)
+#define CMD_NAME_AT(_i)         (CMD_LIST(_CMD_X_NAME, _i) (const char *)0)
+
+/* Expands M(0) M(1) ... M(255) */
+#define _CMD_REP4(M, b)         M((b)+0) M((b)+1) M((b)+2) M((b)+3)
+#define _CMD_REP16(M, b)        _CMD_REP4(M, (b)+0) _CMD_REP4(M, (b)+4) _CMD_REP4(M, (b)+8) _CMD_REP4(M, (b)+12)
+#define _CMD_REP64(M, b)        _CMD_REP16(M, (b)+0) _CMD_REP16(M, (b)+16) _CMD_REP16(M, (b)+32) _CMD_REP16(M, (b)+48)
+#define _CMD_REP256(M)          _CMD_REP64(M, 0) _CMD_REP64(M, 64) _CMD_REP64(M, 128) _CMD_REP64(M, 192)
+
+#define _CMD_DESC_ENTRY(_i)     CMD_DESC_AT(_i),
+#define _CMD_NAME_ENTRY(_i)     CMD_NAME_AT(_i),
+#define _CMD_KNOWN_AT(_i)       + (CMD_DESC_ACCESS(CMD_DESC_AT(_i)) != 0)
+#define _CMD_X_KNOWN(a, _cmd, _id, _mosi, _miso, _access, _name)     + ((_access) != 0)
+#define _CMD_X_FITS(a, _cmd, _id, _mosi, _miso, _access, _name)      && ((_mosi) <= 0x0F) && ((_miso) <= 0x0F) && ((_id) < CMD_DESC_TABLE_SIZE)
+
+/* On the AVR the table lives in flash */
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#define CMD_DESC_MEM            PROGMEM
+#define CMD_DESC_READ(_p)       ((cmd_desc_t)pgm_read_word(_p))
+#else
+#define CMD_DESC_MEM
+#define CMD_DESC_READ(_p)       (*(_p))
+#endif
+
+/* The names are only used by the master (console and traces) */
+#ifndef __AVR__
+#define CMD_NAMES_ENABLED       (1)
+#endif
 
 #ifdef __NOT_EXTERN__
-const command_payload_size_t cmd_table[] = 
-{
- /* Command ID                 MOSI Payload                                  MISO Payload                             */
-    {cmd_roll_call,           sizeof(uint8_t)   /* All or only Unreg     */, 0                   /* Nothing           */, CMD_TYPE_BROADCAST                   | CMD_TYPE_RESTRICTED},
-    {cmd_bcast_address_mask,  sizeof(uint32_t)  /* Destination Mask      */, 0                   /* Nothing           */, CMD_TYPE_BROADCAST                   | CMD_TYPE_RESTRICTED},
-    {cmd_set_rgb_0,           3*sizeof(uint8_t) /* RGB colour Code       */, 0                   /* Nothing           */, CMD_TYPE_BROADCAST | CMD_TYPE_DIRECT},
-    {cmd_set_rgb_1,           3*sizeof(uint8_t) /* RGB colour Code       */, 0                   /* Nothing           */, CMD_TYPE_BROADCAST | CMD_TYPE_DIRECT},
-    {cmd_set_rgb_2,           3*sizeof(uint8_t) /* RGB colour Code       */, 0                   /* Nothing           */, CMD_TYPE_BROADCAST | CMD_TYPE_DIRECT},
-    {cmd_set_blink,           sizeof(uint32_t)  /* Blink Rate (ms)       */, 0                   /* Nothing           */, CMD_TYPE_BROADCAST | CMD_TYPE_DIRECT},
-    {cmd_set_switch,          sizeof(uint8_t)   /* Switch State (on/off) */, 0                   /* Nothing           */, CMD_TYPE_BROADCAST | CMD_TYPE_DIRECT},
-    {cmd_set_dbg_led,         sizeof(uint8_t)   /* Debug LED State       */, 0                   /* Nothing           */, CMD_TYPE_BROADCAST | CMD_TYPE_DIRECT},
-    {cmd_set_time,            sizeof(uint32_t)  /* New Time in ms        */, 0                   /* Nothing           */, CMD_TYPE_BROADCAST | CMD_TYPE_DIRECT},
-#if CLOCK_CORRECTION_ENABLED == 1
-    {cmd_set_sync,            sizeof(uint32_t)  /* ms Elapsed on Master  */, 0                   /* Nothing           */, CMD_TYPE_BROADCAST | CMD_TYPE_DIRECT},
-#endif /* CLOCK_CORRECTION_ENABLED */
-    {cmd_set_bitmask_index,   sizeof(uint8_t)   /* Registration Slot     */, 0                   /* Nothing           */, CMD_TYPE_BROADCAST                  },
-    {cmd_new_add,             sizeof(uint8_t)   /* New Address           */, 0                   /* Nothing           */,                      CMD_TYPE_DIRECT | CMD_TYPE_RESTRICTED},
-    {cmd_get_rgb_0,           0                 /* Nothing               */, 3*sizeof(uint8_t)   /* RGB Colour Code   */,                      CMD_TYPE_DIRECT},
-    {cmd_get_rgb_1,           0                 /* Nothing               */, 3*sizeof(uint8_t)   /* RGB Colour Code   */,                      CMD_TYPE_DIRECT},
-    {cmd_get_rgb_2,           0                 /* Nothing               */, 3*sizeof(uint8_t)   /* RGB Colour Code   */,                      CMD_TYPE_DIRECT},
-    {cmd_get_blink,           0                 /* Nothing               */, sizeof(uint32_t)    /* Blink Rate (ms)   */,                      CMD_TYPE_DIRECT},
-    {cmd_get_reaction,        0                 /* Nothing               */, sizeof(uint32_t)    /* React Time (ms)   */,                      CMD_TYPE_DIRECT},
-    {cmd_get_flags,           0                 /* Nothing               */, sizeof(uint8_t)     /* State Flags       */,                      CMD_TYPE_DIRECT},
-    {cmd_get_dbg_led,         0                 /* Nothing               */, sizeof(uint8_t)     /* Debug LED state   */,                      CMD_TYPE_DIRECT},
-    {cmd_get_time,            0                 /* Nothing               */, sizeof(uint32_t)    /* Runtime (ms)      */,                      CMD_TYPE_DIRECT},
-#if CLOCK_CORRECTION_ENABLED == 1
-    {cmd_get_sync,            0                 /* Nothing               */, sizeof(float)       /* correction factor */,                      CMD_TYPE_DIRECT},
-#endif /* CLOCK_CORRECTION_ENABLED */
-    {cmd_get_version,         0                 /* Nothing               */, sizeof(uint32_t)    /* Version           */,                      CMD_TYPE_DIRECT},
-};
+const cmd_desc_t cmd_desc_table[CMD_DESC_TABLE_SIZE] CMD_DESC_MEM = { _CMD_REP256(_CMD_DESC_ENTRY) };
+#ifdef CMD_NAMES_ENABLED
+const char * const cmd_name_table[CMD_DESC_TABLE_SIZE] = { _CMD_REP256(_CMD_NAME_ENTRY) };
+#endif /* CMD_NAMES_ENABLED */
+
+/* Every known command has its own slot in the table (no 2 commands with the same ID), and its payload sizes fit */
+COMMON_STATIC_ASSERT((0 _CMD_REP256(_CMD_KNOWN_AT)) == (0 CMD_LIST(_CMD_X_KNOWN, ~)), "Two commands share an ID");
+COMMON_STATIC_ASSERT((1 CMD_LIST(_CMD_X_FITS, ~)), "Command ID or payload size out of range");
 #else
-extern const command_payload_size_t cmd_table[];
+extern const cmd_desc_t cmd_desc_table[CMD_DESC_TABLE_SIZE] CMD_DESC_MEM;
+#ifdef CMD_NAMES_ENABLED
+extern const char * const cmd_name_table[CMD_DESC_TABLE_SIZE];
+#endif /* CMD_NAMES_ENABLED */
 #endif /* __NOT_EXTERN__ */
 
+/* Compile-time checks for the tables which pick commands from CMD_LIST (e.g. 
+ the console commands of the master), one per entry of the table */
+#define CMD_STATIC_ASSERT_KNOWN(_cmd)       COMMON_STATIC_ASSERT(CMD_DESC_ACCESS(CMD_DESC_AT(_cmd)) != 0, #_cmd " is not in CMD_LIST")
+#define CMD_STATIC_ASSERT_NO_MOSI(_cmd)     COMMON_STATIC_ASSERT(CMD_DESC_MOSI_SZ(CMD_DESC_AT(_cmd)) == 0, #_cmd " takes a payload")
+#define CMD_STATIC_ASSERT_BCST(_cmd, _bcst) COMMON_STATIC_ASSERT(!(_bcst) || ((CMD_DESC_ACCESS(CMD_DESC_AT(_cmd)) & CMD_TYPE_BROADCAST) != 0), #_cmd " may not be broadcast")
+
+/*! \brief Looks up the descriptor of a command (O(1))
+ * \param cmd The command
+ * \return The descriptor (CMD_DESC_ACCESS() is 0 if the command is not known)
+ */
+static inline cmd_desc_t cmd_desc(master_command_t cmd)
+{
+    return CMD_DESC_READ(&cmd_desc_table[(uint8_t)cmd]);
+}
+
+/*! \brief Checks if a command is known (has access flags)
+ */
+static inline bool cmd_is_known(master_command_t cmd)
+{
+    return (CMD_DESC_ACCESS(cmd_desc(cmd)) != 0);
+}
+
+/*! \brief Checks if a command may be sent in a broadcast message
+ */
+static inline bool cmd_is_bcst(master_command_t cmd)
+{
+    return ((CMD_DESC_ACCESS(cmd_desc(cmd)) & CMD_TYPE_BROADCAST) != 0);
+}
+
+/*! \brief The size of the payload of a command FROM the master TO the node (0 if not known)
+ */
+static inline uint8_t cmd_mosi_sz(master_command_t cmd)
+{
+    return CMD_DESC_MOSI_SZ(cmd_desc(cmd));
+}
+
+/*! \brief The size of the payload of an OK response FROM the node TO the master (0 if not known)
+ */
+static inline uint8_t cmd_miso_sz(master_command_t cmd)
+{
+    return CMD_DESC_MISO_SZ(cmd_desc(cmd));
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -13,6 +13,38 @@ defines
 //version, while the low nibble denotes the minor version. 0x10 => V1.0
 #define PROJECT_VERSION	0x10 /* Major - Minor*/
 
+/* Compile-time trace levels. Trace points below the level of a module are not 
+ compiled in at all (no format string, no argument evaluation, no call). The 
+ level of a trace point is taken from the first character of its format string:
+    "!..."  - Error
+    "#..."  - Info (tagged line)
+    other   - Debug (untagged lines and partial prints)
+ Trace points with trALWAYS in their flags are always compiled in (console 
+ responses). Everything that is compiled in is still subject to the runtime 
+ trace mask. 
+ The level defaults to CONSOLE_TRACE_LEVEL (set in defines.h or on the command 
+ line), and a module can set its own by redefining TRACE_LEVEL (in the same way
+ as PRINTF_TAG) before its first trace point. */
+#define TRACE_LVL_NONE      (0)     /* Only trALWAYS */
+#define TRACE_LVL_ERROR     (1)     /* + "!" lines */
+#define TRACE_LVL_INFO      (2)     /* + "#" lines */
+#define TRACE_LVL_DEBUG     (3)     /* Everything */
+
+/* True if a trace point should be compiled in - constant for literal format 
+ strings and constant flags, so the compiler drops the disabled trace points */
+#define TRACE_COMPILED(traceflags, always, fmtstr)                                  \
+            ((((traceflags) & (always)) != 0) ||                                    \
+             (TRACE_LEVEL >= TRACE_LVL_DEBUG) ||                                    \
+             ((TRACE_LEVEL >= TRACE_LVL_INFO) && ((fmtstr)[0] == '#')) ||           \
+             ((TRACE_LEVEL >= TRACE_LVL_ERROR) && ((fmtstr)[0] == '!')))
+
+/* A compile-time check that works for the C (ESP32) as well as the C++ (Nano) builds */
+#ifdef __cplusplus
+#define COMMON_STATIC_ASSERT(e, m)  static_assert(e, m)
+#else
+#define COMMON_STATIC_ASSERT(e, m)  _Static_assert(e, m)
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -11,10 +11,6 @@ Author:     Rudolph van Niekerk
  *******************************************************************************/
 
  /* ---------------- RVN / TODO / NOTES / MUSINGS ---------------- 
-    * Consider making a table in common_comms.h that contains the command ID, 
-        the respective payload sized for rd and wr... it could potentially 
-        simplify the code on the button significantly.
-
     * Get rid of the "remote console" commands... just use the "set" and "get" 
         commands. The console commands take up valuable space on the button and 
         can be replaced by the "set" and "get" commands.
@@ -55,6 +51,8 @@ includes
 
 #ifdef CONSOLE_ENABLED
   #include "task_console.h"
+  #include "sys_metrics.h"
+  #include "sys_telemetry.h"
 #endif
 #include "task_rgb_led.h"
 #include "task_comms.h"
@@ -62,6 +60,7 @@ includes
 #include "nodes.h"
 #include "colour.h"
 #include "task_game.h"
+#include "sys_rstats.h"
 
 
 /*******************************************************************************
@@ -72,8 +71,6 @@ includes
 #endif
 #define PRINTF_TAG ("Main") /* This must be undefined at the end of the file*/
 
-#define CMD_TYPE_BROADCAST  0x01
-#define CMD_TYPE_DIRECT     0x02
 /*******************************************************************************
  Local structures
 *******************************************************************************/
@@ -123,6 +120,7 @@ void _sys_handler_list(void);
 bool _sys_handler_read_node_from_str(const char * arg_str_in, uint8_t * node_inout, bool* help_requested);
 void _sys_handler_game(void);
 void _sys_handler_sync(void);
+void _sys_handler_link(void);
 void _sys_handler_rand(void);
 
 /*******************************************************************************
@@ -136,6 +134,7 @@ ConsoleMenuItem_t _task_main_menu_items[] =
     {"get",     _sys_handler_node_get,"Reads information from a specific node (response expected)"},
     {"set",     _sys_handler_node_set,"Writes information to a specific node (response expected)"},
     {"sync",    _sys_handler_sync,    "Time-sync functions for the nodes"},
+    {"link",    _sys_handler_link,    "Displays the link quality (RTT, retries, errors) of the nodes"},
     // {"list",    _sys_handler_list,    "Retrieves a list of all registered nodes"},
     {"game",    _sys_handler_game,    "Game related actions (start, stop, info, etc)"},
     // {"tasks",   _sys_handler_tasks,   "Displays the stack usage of all tasks or a specific task"},
@@ -143,31 +142,44 @@ ConsoleMenuItem_t _task_main_menu_items[] =
     {"reset",   _sys_handler_reset,   "Perform a system reset"},
 };
 
-const command_t get_cmd_table[] = {
-    {cmd_get_rgb_0,   "rgb0",    "l0",   "r0",  false},
-    {cmd_get_rgb_1,   "rgb1",    "l1",   "r1",  false},
-    {cmd_get_rgb_2,   "rgb2",    "l2",   "r2",  false},
-    {cmd_get_blink,   "blink",   "bl",   "b",   false},
-    {cmd_get_reaction,"react",   "sw",   "r",   false},
-    {cmd_get_flags,   "flags",   "fl",   "f",   false},
-    {cmd_get_dbg_led, "dbg",     "db",   "d",   false},
-    {cmd_get_time,    "time",    "cl",   "t",   false},
-    {cmd_get_sync,    "sync",    "cor",  "c",   false},
-    {cmd_get_version, "version", "ver",  "v",   false},
-};
-
+/* The console names of the get and set commands:
+    X(command, name 1, name 2, name 3, may be broadcast) */
+#define GET_CMD_TABLE(X)                                        \
+    X(cmd_get_rgb_0,   "rgb0",    "l0",   "r0",  false)         \
+    X(cmd_get_rgb_1,   "rgb1",    "l1",   "r1",  false)         \
+    X(cmd_get_rgb_2,   "rgb2",    "l2",   "r2",  false)         \
+    X(cmd_get_blink,   "blink",   "bl",   "b",   false)         \
+    X(cmd_get_reaction,"react",   "sw",   "r",   false)         \
+    X(cmd_get_flags,   "flags",   "fl",   "f",   false)         \
+    X(cmd_get_dbg_led, "dbg",     "db",   "d",   false)         \
+    X(cmd_get_time,    "time",    "cl",   "t",   false)         \
+    X(cmd_get_sync,    "sync",    "cor",  "c",   false)         \
+    X(cmd_get_version, "version", "ver",  "v",   false)         \
+    X(cmd_get_calib,   "calib",   "cal",  "k",   false)
+
+#define SET_CMD_TABLE(X)                                        \
+    X(cmd_set_rgb_0,   "rgb0",    "l0",   "r0",  true)          \
+    X(cmd_set_rgb_1,   "rgb1",    "l1",   "r1",  true)          \
+    X(cmd_set_rgb_2,   "rgb2",    "l2",   "r2",  true)          \
+    X(cmd_set_blink,   "blink",   "bl",   "b",   true)          \
+    X(cmd_set_switch,  "switch",  "act",  "a",   false)         \
+    X(cmd_set_dbg_led, "dbg",     "db",   "d",   true)          \
+    X(cmd_set_time,    "time",    "cl",   "t",   true)          \
+    X(cmd_set_sync,    "sync",    "sy",   "s",   true)          \
+    X(cmd_set_calib,   "calib",   "cal",  "k",   false)
+//  X(cmd_new_add,     "new",     "addr", "n",   false)
+
+#define _CMD_TABLE_ENTRY(_cmd, _name_1, _name_2, _name_3, _bcst)   {_cmd, _name_1, _name_2, _name_3, _bcst},
+/* A get takes no payload, and a set may only be broadcast if CMD_LIST allows it */
+#define _GET_CMD_CHECK(_cmd, _name_1, _name_2, _name_3, _bcst)     CMD_STATIC_ASSERT_KNOWN(_cmd); CMD_STATIC_ASSERT_NO_MOSI(_cmd);
+#define _SET_CMD_CHECK(_cmd, _name_1, _name_2, _name_3, _bcst)     CMD_STATIC_ASSERT_KNOWN(_cmd); CMD_STATIC_ASSERT_BCST(_cmd, _bcst);
+
+const command_t get_cmd_table[] = { GET_CMD_TABLE(_CMD_TABLE_ENTRY) };
+const command_t set_cmd_table[] = { SET_CMD_TABLE(_CMD_TABLE_ENTRY) };
+
+GET_CMD_TABLE(_GET_CMD_CHECK)
+SET_CMD_TABLE(_SET_CMD_CHECK)
 
-const command_t set_cmd_table[] = {
-    {cmd_set_rgb_0,          "rgb0",    "l0",   "r0",   true},
-    {cmd_set_rgb_1,          "rgb1",    "l1",   "r1",   true},
-    {cmd_set_rgb_2,          "rgb2",    "l2",   "r2",   true},
-    {cmd_set_blink,          "blink",   "bl",   "b",    true},
-    {cmd_set_switch,         "switch",  "act",  "a",    false},
-    {cmd_set_dbg_led,        "dbg",     "db",   "d",    true},
-    {cmd_set_time,           "time",    "cl",   "t",    true},
-    {cmd_set_sync,           "sync",    "sy",   "s",    true},
-//    {cmd_new_add,            "new",     "addr", "n",    },
-};
 /*******************************************************************************
  Functions
 *******************************************************************************/
@@ -210,7 +222,10 @@ void app_main(void)
 #ifdef CONSOLE_ENABLED
     sys_task_add((TaskInfo_t *)console_init_task());
     console_add_menu("sys", _task_main_menu_items, ARRAY_SIZE(_task_main_menu_items), "System");
+    metrics_init();
+    telemetry_init();
 #endif
+    rstats_init();
     sys_task_add((TaskInfo_t *)rgb_led_init_task());
 
     comms_init_task();
@@ -423,6 +438,7 @@ void _sys_handler_reg(void)
     // not send messages directly on the RS485 bus, but instead send messages to the Comms 
     // task via the msg_queue, using _tx_now()
     bool help_requested = false;
+    bool warm = false;
 
     while (console_arg_cnt() > 0)
 	{
@@ -433,6 +449,12 @@ void _sys_handler_reg(void)
             break; //from while-loop
         }
 
+        if ((!strcasecmp("w", arg)) || (!strcasecmp("warm", arg)))
+        {
+            warm = true;
+            continue;
+        }
+
         // if ((!strcasecmp("f", arg)) || (!strcasecmp("force", arg)))
         // {
         //     continue;;
@@ -446,7 +468,10 @@ void _sys_handler_reg(void)
     if (!help_requested)
     {        
         //This call will block the console task until the roll-call timer expires, before we can register nodes
-        nodes_register_all();
+        if (warm)
+            nodes_register_warm();
+        else
+            nodes_register_all();
 
     }
 
@@ -454,7 +479,10 @@ void _sys_handler_reg(void)
     {
         //                  01234567890123456789012345678901234567890123456789012345678901234567890123456789
         iprintln(trALWAYS, "");
-        iprintln(trALWAYS, "Usage: \"reg\" - Sends a rollcall and registers all responding ");
+        iprintln(trALWAYS, "Usage: \"reg [w|warm]\" - Sends a rollcall and registers all responding ");
+        iprintln(trALWAYS, "                            buttons as nodes");
+        iprintln(trALWAYS, "    [w|warm]:   only checks that the known nodes are still in their slots");
+        iprintln(trALWAYS, "        (a rollcall is only sent if one is missing)");
         // iprintln(trALWAYS, "Usage: \"reg [f|force]\" - Sends a rollcalls and registers all responding ");
         // iprintln(trALWAYS, "                            buttons as nodes");
         // iprintln(trALWAYS, "    [f|force]:  clears all registered nodes before sending the rollcall");
@@ -766,6 +794,23 @@ void _sys_handler_node_set(void)
                     temp_changes = 0x40; //Set the time
                 }
             }
+            else if (cmd == cmd_set_calib)
+            {
+                if (!strcasecmp("default", arg))
+                {
+                    btn.calib = (colour_cal_t)COLOUR_CAL_DEFAULT; //No white balance or brightness limit
+                    temp_changes = 0x80; //Set the calibration
+                }
+                else if (str2uint32(&value, arg, 0))
+                {
+                    //0xRRGGBBMM
+                    btn.calib.red = (uint8_t)(value >> 24);
+                    btn.calib.green = (uint8_t)(value >> 16);
+                    btn.calib.blue = (uint8_t)(value >> 8);
+                    btn.calib.max_lvl = (uint8_t)(value);
+                    temp_changes = 0x80; //Set the calibration
+                }
+            }
 
             //If temp_changes is 0, it means we did not change anything for this command
             if (0 == temp_changes)
@@ -816,6 +861,7 @@ void _sys_handler_node_set(void)
                     case 0x10: msg_success = add_node_msg_set_dbgled(_node, btn.dbg_led_state); break;
                     case 0x20: msg_success = add_node_msg_set_active(_node, btn.sw_active); break;
                     case 0x40: msg_success = add_node_msg_set_time(_node, btn.time_ms); break;
+                    case 0x80: msg_success = add_node_msg_set_calib(_node, &btn.calib); break;
                     default: msg_success = false; break; //Skip any other bits
                 }
 
@@ -844,10 +890,12 @@ void _sys_handler_node_set(void)
         iprintln(trALWAYS, "        \"dbg_led <state>\": sets the debug LED state (off, on, fast, med, slow)");
         iprintln(trALWAYS, "        \"sw (on|off)\": starts or stops the button press timer");
         iprintln(trALWAYS, "        \"time <ms>\": sets the current time (32-bit unsigned ms value)");
+        iprintln(trALWAYS, "        \"calib <0xRRGGBBMM>|default\": sets (and saves) the colour calibration");
+        iprintln(trALWAYS, "            RR/GG/BB: white balance (0xFF = 100%%), MM: max brightness");
     }
 }
 
-#define NODE_MAX_GET_CMDS 10 //Maximum number of GET commands we can request from a node
+#define NODE_MAX_GET_CMDS 11 //Maximum number of GET commands we can request from a node
 void _sys_handler_node_get(void)
 {
     //These functions (_menu_handler...) are called from the console task, so they should 
@@ -869,7 +917,8 @@ void _sys_handler_node_get(void)
                                      0x0040 = time, 
                                      0x0080 = state flags
                                      0x0100 = correction factor 
-                                     0x0200 = Version */
+                                     0x0200 = Version
+                                     0x0400 = Colour calibration */
 
     while (console_arg_cnt() > 0)
 	{
@@ -945,6 +994,10 @@ void _sys_handler_node_get(void)
             {
                 temp_request = BIT_POS(9); //Get the version number
             }
+            else if (cmd == cmd_get_calib)
+            {
+                temp_request = BIT_POS(10); //Get the colour calibration
+            }
             else
             {
                 iprintln(trALWAYS, "Invalid GET command \"%s\" (%s)", arg, cmd_to_str(cmd));
@@ -1006,7 +1059,8 @@ void _sys_handler_node_get(void)
         iprintln(trALWAYS, "      time:  get the current time (32-bit unsigned ms value)");
         iprintln(trALWAYS, "      sync:  get the node's time correction factor");
         iprintln(trALWAYS, "      version: get the node's firmware version");
-        iprintln(trALWAYS, "      all:   get all node parameters (rgb0-2, blink, dbg, sw, flags, time, sync)");
+        iprintln(trALWAYS, "      calib: get the node's colour calibration");
+        iprintln(trALWAYS, "      all:   get all node parameters (rgb0-2, blink, dbg, sw, flags, time, sync, version, calib)");
     }
 }
 
@@ -1048,6 +1102,7 @@ bool _sys_handler_get_node_data(uint8_t node, uint16_t requests)
             case 0x0080: msg_success = add_node_msg_get_flags(node); break;
             case 0x0100: msg_success = add_node_msg_get_correction(node); break;
             case 0x0200: msg_success = add_node_msg_get_version(node); break;
+            case 0x0400: msg_success = add_node_msg_get_calib(node); break;
             default: msg_success = false; break; //Skip any other bits
         }
 
@@ -1152,6 +1207,9 @@ void _sys_handler_display_node_data(uint8_t node, uint16_t requests)
                     (btn->version & 0x00FF0000) >> 16,
                     (btn->version & 0xFF000000) >> 24);
                 break;
+            case 0x0400: 
+                iprintln(trALWAYS,   "Calibration:  R:%d G:%d B:%d Max:%d", btn->calib.red, btn->calib.green, btn->calib.blue, btn->calib.max_lvl);
+                break;
             default: 
                 iprintln(trALWAYS, "Unknown GET mask for node %d (0x%02X)", node, mask);
                 break; //Skip any other bits
@@ -1278,6 +1336,119 @@ void _sys_handler_sync(void)
 
 }
 
+void _sys_handler_link(void)
+{
+    //These functions (_menu_handler...) are called from the console task, so they should 
+    // not send messages directly on the RS485 bus, but instead send messages to the Comms 
+    // task via the msg_queue, using _tx_now()
+    bool help_requested = false;
+    uint8_t _node = 0xff;
+    bool got_poll = false;
+    bool got_reset = false;
+
+    while (console_arg_cnt() > 0)
+	{
+        char *arg = console_arg_pop();
+        if ((!strcasecmp("?", arg)) || (!strcasecmp("help", arg)))
+        {    
+            help_requested = true;
+            break; //from while-loop
+        }
+        if (!strcasecmp("poll", arg))
+        {    
+            got_poll = true;
+            continue; //from while-loop
+        }
+        if ((!strcasecmp("reset", arg)) || (!strcasecmp("clear", arg)))
+        {    
+            got_reset = true;
+            continue; //from while-loop
+        }
+
+        //Check if the argument is a hex value (node address)
+        if (_sys_handler_read_node_from_str(arg, &_node, &help_requested))
+            continue; //Skip the rest of the loop and go to the next argument
+        else if (help_requested)
+            break; //Skip the rest of the loop and go to the next argument        
+
+        iprintln(trALWAYS, "Invalid Argument (\"%s\")", arg);
+        help_requested = true;
+        break;
+    }
+
+    if (!help_requested)
+    {
+        comms_stats_t bus;
+        node_link_stats_t link;
+
+        if (node_count() == 0)
+        {
+            iprintln(trALWAYS, "No nodes registered. Please register some nodes first.");
+            return;
+        }
+
+        for (uint8_t i = 0; i < node_count(); i++)
+        {
+            if ((_node != 0xff) && (i != _node))
+                continue; //Not the node we are looking for
+
+            if (got_poll)
+            {
+                //Fetch the counters kept by the node itself
+                init_node_msg(i);
+                if ((!add_node_msg_get_link(i)) || (!node_msg_tx_now(i)))
+                    iprintln(trALWAYS, "Failed to read the link counters from node %d", i);
+            }
+            if (got_reset)
+                node_link_stats_reset(i);
+        }
+
+        if (got_reset)
+        {
+            if (_node == 0xff)
+                comms_stats_get(NULL, true);
+            iprintln(trALWAYS, "Link counters cleared");
+            return;
+        }
+
+        //                  01234567890123456789012345678901234567890123456789012345678901234567890123456789
+        iprintln(trALWAYS, "                 RTT (ms)          |         Master          |      Node");
+        iprintln(trALWAYS, "  # Addr  SRTT   VAR   RTO  Last |   TX    RX Retry  T/O  CRC |  CRC Echo Rtry Abdn");
+        for (uint8_t i = 0; i < node_count(); i++)
+        {
+            if ((_node != 0xff) && (i != _node))
+                continue; //Not the node we are looking for
+
+            if (!get_node_link_stats(i, &link))
+                continue;
+
+            iprintln(trALWAYS, "% 3d 0x%02X %5.1f %5.1f % 5u % 5u |% 5u % 5u % 5u % 4u % 4u |% 5u % 4u % 4u % 4u", 
+                i, get_node_addr(i), 
+                link.srtt_x8 / 8.0f, link.rttvar_x4 / 4.0f, (unsigned int)link.rto_ms, (unsigned int)link.rtt_last_ms,
+                (unsigned int)link.tx_cnt, (unsigned int)link.rx_cnt, (unsigned int)link.retries, (unsigned int)link.timeouts, (unsigned int)link.crc_err,
+                (unsigned int)link.node_crc_err, (unsigned int)link.node_echo_err, (unsigned int)link.node_tx_retries, (unsigned int)link.node_tx_abandoned);
+        }
+
+        comms_stats_get(&bus, false);
+        iprintln(trALWAYS, "Bus: TX %u, RX %u, CRC %u, Version %u, Length %u, Frag %u, Lost %u, UART %u, Echo %u",
+            (unsigned int)bus.tx_frames, (unsigned int)bus.rx_frames, (unsigned int)bus.crc_err, (unsigned int)bus.version_err, 
+            (unsigned int)bus.length_err, (unsigned int)bus.frag_err, (unsigned int)bus.rx_lost, (unsigned int)bus.uart_err, (unsigned int)bus.echo_err);
+        if (!got_poll)
+            iprintln(trALWAYS, "(Node counters are only updated with \"link poll\")");
+    }
+
+    if (help_requested)
+    {
+        //                  01234567890123456789012345678901234567890123456789012345678901234567890123456789
+        iprintln(trALWAYS, "");
+        iprintln(trALWAYS, "Usage: \"link [<#>] [poll] [reset]\"");
+        iprintln(trALWAYS, "    <#>:    Node number (0 to %d)", RGB_BTN_MAX_NODES);
+        iprintln(trALWAYS, "        if omitted, the stats for all nodes are displayed");
+        iprintln(trALWAYS, "    poll:   reads the counters kept by the node(s) (CRC, echo, retries)");
+        iprintln(trALWAYS, "    reset:  clears the counters (the RTT estimates are retained)");
+    }
+}
+
 bool _sys_handler_read_node_from_str(const char * arg_str_in, uint8_t * node_inout, bool* help_requested)
 {
     uint32_t value;
@@ -18,6 +18,7 @@ includes
 #include "sys_utils.h"
 #include "str_helper.h"
 #include "task_console.h"
+#include "../../../../common/common_colour.h"
 
 #define __NOT_EXTERN__
 #include "colour.h"
@@ -85,6 +86,11 @@ static stColour_t _colour[] =
     {"White",   "Wt",   colWhite},
 };
 
+#if (COLOUR_HUE_WHEEL > 0)
+static uint32_t _hue_wheel[HUE_MAX];
+static bool _hue_wheel_ready = false;
+#endif
+
 /*******************************************************************************
  Local (private) Functions
 *******************************************************************************/
@@ -168,75 +174,42 @@ esp_err_t str2rgb(uint32_t *rgb, const char * str)
 
 uint32_t hue2rgb(uint32_t h)
 {
-    return hsv2rgb(h, SAT_MAX, VAL_MAX);
+#if (COLOUR_HUE_WHEEL > 0)
+    if (!_hue_wheel_ready)
+    {
+        //Built once, on first use. Concurrent callers would simply write the same values.
+        for (uint32_t i = 0; i < HUE_MAX; i++)
+            _hue_wheel[i] = colour_hsv2rgb_h360(i, 0xFF, 0xFF);
+        _hue_wheel_ready = true;
+    }
+    return _hue_wheel[h % HUE_MAX];
+#else
+    return colour_hsv2rgb_h360(h % HUE_MAX, 0xFF, 0xFF);
+#endif
 }
 
 uint32_t hsv2rgb(uint32_t h, uint32_t s, uint32_t v)
 {
-    uint32_t r, g, b;
-
     //Make sure the input values are within the limits
-    h %= 360; // h -> [0,360]
-
     if (s > SAT_MAX)
         s = SAT_MAX; //Clamp to max
 
     if (v > VAL_MAX)
         v = VAL_MAX; //Clamp to max
 
-    uint32_t rgb_max = (v) * 2.55f;
-    uint32_t rgb_min = rgb_max * (100 - s) / 100.0f;
-
-    uint32_t i = h / 60;
-    uint32_t diff = h % 60;
-
-    // RGB adjustment amount by hue
-    uint32_t rgb_adj = (rgb_max - rgb_min) * diff / 60;
-
-    switch (i) {
-    case 0:
-        r = rgb_max;
-        g = rgb_min + rgb_adj;
-        b = rgb_min;
-        break;
-    case 1:
-        r = rgb_max - rgb_adj;
-        g = rgb_max;
-        b = rgb_min;
-        break;
-    case 2:
-        r = rgb_min;
-        g = rgb_max;
-        b = rgb_min + rgb_adj;
-        break;
-    case 3:
-        r = rgb_min;
-        g = rgb_max - rgb_adj;
-        b = rgb_max;
-        break;
-    case 4:
-        r = rgb_min + rgb_adj;
-        g = rgb_min;
-        b = rgb_max;
-        break;
-    default:
-        r = rgb_max;
-        g = rgb_min;
-        b = rgb_max - rgb_adj;
-        break;
-    }
-    return AS_RGB(r, g, b);
+    //Percentages are scaled (rounded) to 0-255 for the fixed point conversion
+    return colour_hsv2rgb_h360(h % HUE_MAX, 
+                               (uint8_t)((s * 0xFF + (SAT_MAX/2)) / SAT_MAX), 
+                               (uint8_t)((v * 0xFF + (VAL_MAX/2)) / VAL_MAX));
 }
 
 void rgb2hsv(uint32_t rgb, uint32_t *h, uint32_t *s, uint32_t *v)
 {
-    //int32_t out_h, out_s, out_v; 
     int r = (int)RED_from_WRGB(rgb);    //Range 0 to 255
     int g = (int)GREEN_from_WRGB(rgb);  //Range 0 to 255
     int b = (int)BLUE_from_WRGB(rgb);   //Range 0 to 255
-    //hsv         out;
-    uint32_t min, max, delta;
-    double h_temp = 0.0f;
+    int min, max, delta;
+    int h_temp;
 
     min = MIN3(r, g, b);                //Min. value of RGB (range 0-255)
     max = MAX3(r, g, b);                //Max. value of RGB (range 1-255)
@@ -244,7 +217,7 @@ void rgb2hsv(uint32_t rgb, uint32_t *h, uint32_t *s, uint32_t *v)
 
     //Value %
     if (v)
-        *v = (uint32_t)(100.0f * max / 0xff);        // Range 0 to 100
+        *v = (uint32_t)((VAL_MAX * max) / 0xff);    // Range 0 to 100
 
     //If the numbers are all the same, then delta will be 0 and the hue and saturation are 0
     if (delta == 0)
@@ -259,20 +232,19 @@ void rgb2hsv(uint32_t rgb, uint32_t *h, uint32_t *s, uint32_t *v)
     {
         //Saturation %
         if (s)
-            *s = (uint32_t)(100.0f * delta / max);     // Range 0 to 100
+            *s = (uint32_t)((SAT_MAX * delta) / max);   // Range 0 to 100
 
         if (h)
         {
-            //Hue (0 to 360 degrees)
+            //Hue (0 to 360 degrees), the sector base is scaled by delta so that the 
+            // numerator is always positive and the division truncates the same way the 
+            // float version did
             if( r == max )      // R is max - hue sits between yellow (60) & magenta (300)
-                h_temp = HUE_RED + ((HUE_MAX/6.0f) * ((int)(g - b)) / delta);   
-                //     =     360 + (     (60)      * (-255 to +255) / (0-255))    -> Range 300 to 420 (60)
+                h_temp = (HUE_RED * delta + (HUE_MAX/6) * (g - b)) / delta;   // Range 300 to 420 (60)
             else if( g == max ) // G is max - hue sits between cyan (180) & yellow (60)
-                h_temp = HUE_GRN + ((HUE_MAX/6.0f) * ((int)(b - r)) / delta);
-                //     =     120 + (     (60)      * (int)(-255 to +255) / (0-255))    -> Range 60 to 180
+                h_temp = (HUE_GRN * delta + (HUE_MAX/6) * (b - r)) / delta;   // Range 60 to 180
             else                // B is max - hue sits between magenta & cyan
-                h_temp = HUE_BLU + ((HUE_MAX/6.0f) * ((int)(r - g)) / delta);
-                //     =     240 + (     (60)      * (int)(-255 to +255) / (0-255))    -> Range 180 to 300
+                h_temp = (HUE_BLU * delta + (HUE_MAX/6) * (r - g)) / delta;   // Range 180 to 300
 
             // Wrap >360 values back into range
             *h = (((uint32_t)h_temp) % HUE_MAX);
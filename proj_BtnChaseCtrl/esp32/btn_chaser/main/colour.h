@@ -37,6 +37,10 @@ Macros
 #define BLUE_from_WRGB(x)   ((uint8_t)((x) & 0xFF))
 
 
+/* Set to 0 to calculate hue2rgb() on every call, iso looking it up in a 
+ * precomputed 360 entry (1440 bytes) hue wheel */
+#define COLOUR_HUE_WHEEL    (1)
+
 #define HUE_MAX             (360)
 #define SAT_MAX             (100)
 #define VAL_MAX             (100)
@@ -136,6 +140,7 @@ const char * rgb2name(uint32_t rgb_value);
 esp_err_t str2rgb(uint32_t *rgb, const char * str);
 
 /*! @brief Simple helper function, converting HSV color space to RGB color space
+ * using integer maths only (see common_colour.h for the 8 and 16-bit hue variants)
  * Wiki: https://en.wikipedia.org/wiki/HSL_and_HSV
  * @param h Hue angle, 0-360
  * @param s Saturation percentage, 0-100
@@ -144,7 +149,8 @@ esp_err_t str2rgb(uint32_t *rgb, const char * str);
 uint32_t hsv2rgb(uint32_t h, uint32_t s, uint32_t v);
 
 /*! @brief Simple helper function, converting Hue (degrees) to RGB color space
- * assuming maximum (100%) saturation and value. As a guide, the hue values 
+ * assuming maximum (100%) saturation and value. Served from the precomputed hue 
+ * wheel if COLOUR_HUE_WHEEL is set. As a guide, the hue values 
  * convert to the following colours:
  *        0: Red
  *       60: Yellow
@@ -14,3 +14,9 @@ Global Defines
 	#define MAIN_DEBUG
 #endif
 
+/* The compile-time trace level (TRACE_LVL_xxx in common_defines.h). Trace 
+ * points below this level are not compiled in at all. A module can set its own 
+ * level by redefining TRACE_LEVEL. */
+#ifndef CONSOLE_TRACE_LEVEL
+	#define CONSOLE_TRACE_LEVEL	(TRACE_LVL_DEBUG)
+#endif
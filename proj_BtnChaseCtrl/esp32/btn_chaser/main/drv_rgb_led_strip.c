@@ -25,6 +25,12 @@ the same NRZ encoding (whatever that abbreviation stands for).
 The ESP32-C3 is equipped with a SK6812 LED strip (of 1 LED) on GPIO 8, which 
 can easily be used for testing and development.
 
+The colours are staged in linear (as set) form. When a strip is flushed, every 
+byte is passed through the strip's output LUT (one per byte in the transfer 
+order), which combines the white balance, the CIE lightness (gamma) correction 
+and the brightness limit - the same pipeline the nodes apply to their PWM - so 
+that a colour looks the same on the controller LEDs and on the buttons.
+
 *******************************************************************************/
 
 /*******************************************************************************
@@ -32,6 +38,7 @@ includes
  *******************************************************************************/
 
 #include <string.h>
+#include <math.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_err.h"
@@ -68,6 +75,8 @@ local defines and constants
 
 #define MAX_LED_NAME_LEN        (16) /* e.g "Debug", "Button:0", "Button:6", etc */
 
+#define LED_STRIP_GAMMA_DEFAULT (true) /* Apply the CIE lightness correction to the strips by default */
+
 /**
  * Macro which can be used to check the condition. If the condition is not 'true', it prints the message,
  * sets the local variable 'ret' to the supplied 'err_code', and then exits by jumping to 'goto_tag'.
@@ -135,8 +144,16 @@ const rgb_drv_config_t rgb_led_drv_cfg[] = {  // Still must match order of `rgb_
 
 typedef struct {
     rgb_drv_types drv_type;                     // Type of LED strip driver (see rgb_led_drv_cfg[]), NEEDS TO BE SETUP BEFORE RMT initialisation
-    uint8_t led_cnt;                            // Number of leds in the strip, NEEDS TO BE SETUP BEFORE RMT initialisation
-    uint8_t * colour_buf;                       // Pointer to the colour buffer, should be bytes_per_led x led_cnt NB: Allocated at initialisation!
+    uint16_t led_cnt;                           // Number of leds in the strip, NEEDS TO BE SETUP BEFORE RMT initialisation
+    uint8_t bytes_per_led;                      // Number of bytes per led (3 or 4), resolved from the colour order at initialisation
+    uint8_t byte_shift[4];                      // The shift of each byte (in transfer order) in a WRGB value, resolved from the colour order at initialisation
+    uint8_t * colour_buf;                       // Pointer to the colour (staging) buffer, should be bytes_per_led x led_cnt NB: Allocated at initialisation!
+    uint8_t * tx_buf;                           // Pointer to the buffer being clocked out by the RMT, same size as colour_buf NB: Allocated at initialisation!
+    uint8_t (* lut)[256];                       // Output LUT for each byte (in transfer order), applied at flush, bytes_per_led x 256 NB: Allocated at initialisation!
+    bool gamma;                                 // The CIE lightness correction is part of the output LUT
+    colour_cal_t calib;                         // The white balance and brightness limit which is part of the output LUT
+    bool dirty;                                 // The colour buffer has changed since the last flush
+    bool tx_busy;                               // A transmission has been started and has not been confirmed as done yet
     rmt_channel_handle_t chan;                  // Pointer to the RMT Channel Config NB: Allocated at RMT initialisation!
     rmt_tx_channel_config_t chan_config;        // RMT Channel Config, NEEDS TO BE SETUP BEFORE RMT initialisation
     rmt_encoder_handle_t rmt_encoder;           // Pointer to the RMT Encoder Config NB: Allocated at RMT initialisation!
@@ -187,6 +204,31 @@ bool _drv_rgb_led_strip_get_strip_index(int * led_index, int * strip_index);
 
 int _drv_rgb_led_strip_count(void);
 
+/*! Resolves the colour order string of the strip's driver into the byte shift table used when packing pixels
+ * @param[in] led_strip LED strip handle
+ * @return ESP_OK if the colour order is supported, ESP_ERR_NOT_SUPPORTED otherwise
+ */
+esp_err_t _drv_rgb_led_strip_resolve_order(led_strip_t * led_strip);
+
+/*! Packs a number of WRGB values into a buffer in the transfer order of the strip
+ * @param[in] led_strip LED strip handle
+ * @param[out] dst The buffer position of the first led to pack
+ * @param[in] wrgb The WRGB values to pack
+ * @param[in] count The number of leds to pack
+ */
+static inline void _drv_rgb_led_strip_pack(const led_strip_t * led_strip, uint8_t * dst, const uint32_t * wrgb, int count);
+
+/*! Converts a linear value to a PWM (duty cycle) value for the same perceived lightness (CIE 1931)
+ * @param[in] x The linear value (0-255)
+ * @return The corrected value (0-255)
+ */
+uint8_t _drv_rgb_led_strip_cie_lightness(uint8_t x);
+
+/*! (Re)builds the output LUTs of the strip from its gamma and calibration settings
+ * @param[in] led_strip LED strip handle
+ */
+void _drv_rgb_led_strip_build_lut(led_strip_t * led_strip);
+
 /*******************************************************************************
 local variables
  *******************************************************************************/
@@ -195,6 +237,10 @@ static led_strip_t dbg_led = {
     .drv_type = SK6812_V1,                              /* Must be set here (see rgb_led_drv_cfg[]) */
     .led_cnt = 1,                                       /* Must be set here - Only 1 led on the Debug RGB LED */
     .colour_buf = NULL,                                 /* Set to NULL, will be alocated at initialisation */
+    .tx_buf = NULL,                                     /* Set to NULL, will be alocated at initialisation */
+    .lut = NULL,                                        /* Set to NULL, will be alocated at initialisation */
+    .gamma = LED_STRIP_GAMMA_DEFAULT,
+    .calib = COLOUR_CAL_DEFAULT,
     .chan = NULL,                                       /* Set to NULL, will be assigned at initialisation */
     .chan_config = {                                    /* RMT TX Chan Config */
         .clk_src = RMT_CLK_SRC_DEFAULT,                 /* select source clock */
@@ -213,6 +259,10 @@ static led_strip_t button_led = {
     .drv_type = SM16703_V1,                             /* Must be set here (see rgb_led_drv_cfg[]) */
     .led_cnt = 5,                                       /* Must be set here - Let's start with 5 leds on the RGB LED Strip */
     .colour_buf = NULL,                                 /* Set to NULL, will be alocated at initialisation */
+    .tx_buf = NULL,                                     /* Set to NULL, will be alocated at initialisation */
+    .lut = NULL,                                        /* Set to NULL, will be alocated at initialisation */
+    .gamma = LED_STRIP_GAMMA_DEFAULT,
+    .calib = COLOUR_CAL_DEFAULT,
     .chan = NULL,                                       /* Set to NULL, will be assigned at initialisation */
     .chan_config = {                                    /* RMT TX Chan Config */
         .clk_src = RMT_CLK_SRC_DEFAULT,                 /* select source clock */
@@ -338,8 +388,114 @@ err:
     return ret;
 }
 
+esp_err_t _drv_rgb_led_strip_resolve_order(led_strip_t * led_strip)
+{
+    const char * col_order = rgb_led_drv_cfg[led_strip->drv_type].col_order;
+    int bytes_per_led = strlen(col_order);
+
+    if ((bytes_per_led < 3) || (bytes_per_led > 4))
+    {
+        iprintln(trLED|trALWAYS, "#Unsupported colour order (\"%s\") for %s strip", col_order, led_strip->name);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    for (int i = 0; i < bytes_per_led; i++)
+    {
+        switch (col_order[i])
+        {
+        case 'R':
+        case 'r':
+            led_strip->byte_shift[i] = 16;
+            break;
+        case 'G':
+        case 'g':
+            led_strip->byte_shift[i] = 8;
+            break;
+        case 'B':
+        case 'b':
+            led_strip->byte_shift[i] = 0;
+            break;
+        case 'W':
+        case 'w':
+            led_strip->byte_shift[i] = 24;
+            break;
+        default:
+            iprintln(trLED|trALWAYS, "#Unsupported char ('%c') in colour order str of %s strip", col_order[i], led_strip->name);
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+    }
+    led_strip->bytes_per_led = bytes_per_led;
+    return ESP_OK;
+}
+
+static inline void _drv_rgb_led_strip_pack(const led_strip_t * led_strip, uint8_t * dst, const uint32_t * wrgb, int count)
+{
+    const uint8_t s0 = led_strip->byte_shift[0];
+    const uint8_t s1 = led_strip->byte_shift[1];
+    const uint8_t s2 = led_strip->byte_shift[2];
+
+    //The byte count is fixed per strip, so we keep the check out of the inner loop
+    if (led_strip->bytes_per_led == 4)
+    {
+        const uint8_t s3 = led_strip->byte_shift[3];
+        for (int i = 0; i < count; i++, dst += 4)
+        {
+            dst[0] = (uint8_t)(wrgb[i] >> s0);
+            dst[1] = (uint8_t)(wrgb[i] >> s1);
+            dst[2] = (uint8_t)(wrgb[i] >> s2);
+            dst[3] = (uint8_t)(wrgb[i] >> s3);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < count; i++, dst += 3)
+        {
+            dst[0] = (uint8_t)(wrgb[i] >> s0);
+            dst[1] = (uint8_t)(wrgb[i] >> s1);
+            dst[2] = (uint8_t)(wrgb[i] >> s2);
+        }
+    }
+}
+
+uint8_t _drv_rgb_led_strip_cie_lightness(uint8_t x)
+{
+    //L* = 0 to 100, Y = 0.0 to 1.0
+    float lightness = (100.0f * x) / 255.0f;
+    float y = (lightness <= 8.0f)? (lightness / 903.3f) : powf((lightness + 16.0f) / 116.0f, 3.0f);
+
+    //Truncated, to match the LUT used by the nodes (CIE_LIGHTNESS_TO_PWM_LUT_256_IN_8BIT_OUT)
+    return (uint8_t)(y * 255.0f);
+}
+
+void _drv_rgb_led_strip_build_lut(led_strip_t * led_strip)
+{
+    if (led_strip->lut == NULL)
+        return;
+
+    for (int i = 0; i < led_strip->bytes_per_led; i++)
+    {
+        uint8_t wb;
+        switch (led_strip->byte_shift[i])
+        {
+            case 16:    wb = led_strip->calib.red;      break;
+            case 8:     wb = led_strip->calib.green;    break;
+            case 0:     wb = led_strip->calib.blue;     break;
+            default:    wb = 0xFF;                      break; //No white balance for the white LED
+        }
+        for (int x = 0; x < 256; x++)
+        {
+            uint8_t y = colour_scale8((uint8_t)x, wb);
+            if (led_strip->gamma)
+                y = _drv_rgb_led_strip_cie_lightness(y);
+            led_strip->lut[i][x] = colour_scale8(y, led_strip->calib.max_lvl);
+        }
+    }
+}
+
 uint32_t _drv_rgb_led_strip_init(led_strip_t * led_strip)
 {    
+    ESP_ERROR_CHECK(_drv_rgb_led_strip_resolve_order(led_strip));
+
     //iprintln(trLED, "#Initialise %s RMT Channel", led_strip->name);
     ESP_ERROR_CHECK(rmt_new_tx_channel(&led_strip->chan_config, &led_strip->chan));
     
@@ -349,10 +505,16 @@ uint32_t _drv_rgb_led_strip_init(led_strip_t * led_strip)
     //iprintln(trLED, "#Enable %s RMT TX channel", led_strip->name);
     ESP_ERROR_CHECK(rmt_enable(led_strip->chan));
 
-    //allocate memory for led_strip->colour_buf
-    int bytes_per_led = strlen(rgb_led_drv_cfg[led_strip->drv_type].col_order);
-    led_strip->colour_buf = (uint8_t *)malloc(led_strip->led_cnt * bytes_per_led);
-    if (led_strip->colour_buf == NULL) {
+    //allocate memory for led_strip->colour_buf and led_strip->tx_buf
+    int bytes_per_led = led_strip->bytes_per_led;
+    led_strip->colour_buf = (uint8_t *)calloc(led_strip->led_cnt, bytes_per_led);
+    led_strip->tx_buf = (uint8_t *)calloc(led_strip->led_cnt, bytes_per_led);
+    led_strip->lut = calloc(bytes_per_led, sizeof(led_strip->lut[0]));
+    _drv_rgb_led_strip_build_lut(led_strip);
+    led_strip->tx_busy = false;
+    //Make sure the strip is cleared on the first flush
+    led_strip->dirty = true;
+    if ((led_strip->colour_buf == NULL) || (led_strip->tx_buf == NULL) || (led_strip->lut == NULL)) {
         iprintln(trLED|trALWAYS, "#No mem for %s buffer", led_strip->name);
         led_strip->init_result = ESP_ERR_NO_MEM;
     }
@@ -368,12 +530,26 @@ uint32_t _drv_rgb_led_strip_init(led_strip_t * led_strip)
 
 void _drv_rgb_led_strip_deinit(led_strip_t * led_strip)
 {    
+    //The RMT could still be reading from the tx buffer
+    if (led_strip->tx_busy)
+        rmt_tx_wait_all_done(led_strip->chan, portMAX_DELAY);
+    led_strip->tx_busy = false;
+    led_strip->dirty = false;
+
     if (led_strip->colour_buf != NULL) {
-        int bytes_per_led = strlen(rgb_led_drv_cfg[led_strip->drv_type].col_order);
-        iprintln(trLED, "#Freed %d bytes for %s RGB LED strip (%d leds x %d bytes)", bytes_per_led*led_strip->led_cnt, led_strip->name, led_strip->led_cnt, bytes_per_led);
+        int bytes_per_led = led_strip->bytes_per_led;
+        iprintln(trLED, "#Freed %d bytes for %s RGB LED strip (%d leds x %d bytes x 2)", 2*bytes_per_led*led_strip->led_cnt, led_strip->name, led_strip->led_cnt, bytes_per_led);
         free(led_strip->colour_buf);
         led_strip->colour_buf = NULL;
     }
+    if (led_strip->tx_buf != NULL) {
+        free(led_strip->tx_buf);
+        led_strip->tx_buf = NULL;
+    }
+    if (led_strip->lut != NULL) {
+        free(led_strip->lut);
+        led_strip->lut = NULL;
+    }
 
     iprintln(trLED, "#Disable %s RMT TX channel", led_strip->name);
     ESP_ERROR_CHECK(rmt_disable(led_strip->chan));
@@ -484,41 +660,131 @@ void drv_rgb_led_strip_set_colour(int led_index, uint32_t rgb)
         return;
     }
 
-    uint8_t * rgb_buf = ColourBuffer(strip_index);
-    const char * col_order = ColOrder(strip_index);
-    int bytes_per_led = strlen(col_order);
-//    led_nr = led_nr % led_strip->led_cnt;
-    
-    // Build RGB colours in the order as they are expeted for the particular driver
-    for (int i = 0; i < bytes_per_led; i++)
+    _drv_rgb_led_strip_pack(led_strip, ColourBuffer(strip_index) + (led_index * led_strip->bytes_per_led), &rgb, 1);
+
+    // Nothing is sent here, the whole strip goes out on the next drv_rgb_led_strip_flush()
+    led_strip->dirty = true;
+};
+
+int drv_rgb_led_strip_set_colours(int led_index, const uint32_t * wrgb, int count)
+{
+    int strip_index = -1;
+    int done = 0;
+
+    if ((wrgb == NULL) || (count <= 0))
+        return 0;
+
+    if (!_drv_rgb_led_strip_get_strip_index(&led_index, &strip_index)) 
+        return 0;
+
+    //The run may continue onto the following strip(s)
+    for (; (strip_index < drv_rgb_led_strip_MAX) && (done < count); strip_index++, led_index = 0)
     {
-        switch (col_order[i])
-        {
-        case 'R':
-        case 'r':
-            rgb_buf[led_index * bytes_per_led + i] = RED_from_WRGB(rgb);
-            break;
-        case 'G':
-        case 'g':
-            rgb_buf[led_index * bytes_per_led + i] = GREEN_from_WRGB(rgb);
-            break;
-        case 'B':
-        case 'b':
-            rgb_buf[led_index * bytes_per_led + i] = BLUE_from_WRGB(rgb);
-            break;
-        case 'W':
-        case 'w':
-            rgb_buf[led_index * bytes_per_led + i] = WHITE_from_WRGB(rgb);
-            break;
-        default:
-            iprintln(trLED, "#Unsupported char ('%c')in colour order str of %s strip", col_order[i], led_strip->name);
+        led_strip_t* led_strip = led_strip_list[strip_index];
+
+        if (led_strip == NULL)
             break;
+
+        int run = min(count - done, led_strip->led_cnt - led_index);
+        if (led_strip->init_result == ESP_OK) 
+        {
+            _drv_rgb_led_strip_pack(led_strip, ColourBuffer(strip_index) + (led_index * led_strip->bytes_per_led), &wrgb[done], run);
+            led_strip->dirty = true;
         }
+        done += run;
     }
-    // Flush RGB values to LEDs
-    ESP_ERROR_CHECK(rmt_transmit(led_strip->chan, led_strip->rmt_encoder, rgb_buf, bytes_per_led * led_strip->led_cnt, &rmt_tx_config));
-    ESP_ERROR_CHECK(rmt_tx_wait_all_done(led_strip->chan, portMAX_DELAY));
-};
+    return done;
+}
+
+int drv_rgb_led_strip_flush(void)
+{
+    int flushed = 0;
+
+    for (int strip_index = 0; strip_index < drv_rgb_led_strip_MAX; strip_index++)
+    {
+        led_strip_t* led_strip = led_strip_list[strip_index];
+
+        if ((led_strip == NULL) || (led_strip->init_result != ESP_OK) || (!led_strip->dirty))
+            continue;
+
+        if (led_strip->tx_busy)
+        {
+            //Don't touch the tx buffer while the RMT is still busy with it... we'll try again on the next flush
+            if (rmt_tx_wait_all_done(led_strip->chan, 0) != ESP_OK)
+                continue;
+            led_strip->tx_busy = false;
+        }
+
+        size_t buf_size = led_strip->bytes_per_led * led_strip->led_cnt;
+        const uint8_t * src = led_strip->colour_buf;
+        uint8_t * dst = led_strip->tx_buf;
+        //The whole strip goes through the output LUTs on its way to the tx buffer
+        if (led_strip->bytes_per_led == 4)
+        {
+            for (int i = 0; i < led_strip->led_cnt; i++, src += 4, dst += 4)
+            {
+                dst[0] = led_strip->lut[0][src[0]];
+                dst[1] = led_strip->lut[1][src[1]];
+                dst[2] = led_strip->lut[2][src[2]];
+                dst[3] = led_strip->lut[3][src[3]];
+            }
+        }
+        else
+        {
+            for (int i = 0; i < led_strip->led_cnt; i++, src += 3, dst += 3)
+            {
+                dst[0] = led_strip->lut[0][src[0]];
+                dst[1] = led_strip->lut[1][src[1]];
+                dst[2] = led_strip->lut[2][src[2]];
+            }
+        }
+        led_strip->dirty = false;
+
+        // Flush RGB values to LEDs (we don't wait for it to complete)
+        esp_err_t err = rmt_transmit(led_strip->chan, led_strip->rmt_encoder, led_strip->tx_buf, buf_size, &rmt_tx_config);
+        if (err != ESP_OK)
+        {
+            iprintln(trLED, "#%s strip flush failed (%s)", led_strip->name, esp_err_to_name(err));
+            led_strip->dirty = true;
+            continue;
+        }
+        led_strip->tx_busy = true;
+        flushed++;
+    }
+    return flushed;
+}
+
+esp_err_t drv_rgb_led_strip_set_calibration(int led_index, bool gamma, const colour_cal_t * cal)
+{
+    int strip_index = -1;
+    const colour_cal_t default_cal = COLOUR_CAL_DEFAULT;
+
+    if (!_drv_rgb_led_strip_get_strip_index(&led_index, &strip_index)) 
+        return ESP_ERR_INVALID_ARG;
+
+    led_strip_t* led_strip = led_strip_list[strip_index];
+
+    led_strip->gamma = gamma;
+    led_strip->calib = (cal == NULL)? default_cal : *cal;
+    //The LUT is only read on a flush (same task as the LED service), at worst one frame goes out half-calibrated
+    _drv_rgb_led_strip_build_lut(led_strip);
+    led_strip->dirty = true;
+    return ESP_OK;
+}
+
+esp_err_t drv_rgb_led_strip_get_calibration(int led_index, bool * gamma, colour_cal_t * cal)
+{
+    int strip_index = -1;
+
+    if (!_drv_rgb_led_strip_get_strip_index(&led_index, &strip_index)) 
+        return ESP_ERR_INVALID_ARG;
+
+    if (gamma)
+        *gamma = led_strip_list[strip_index]->gamma;
+    if (cal)
+        *cal = led_strip_list[strip_index]->calib;
+    return ESP_OK;
+}
 
 bool _drv_rgb_led_strip_get_strip_index(int * led_index, int * strip_index)
 {
@@ -25,6 +25,7 @@ includes
 #include <stdint.h>
 #include "defines.h"
 #include "colour.h"
+#include "../../../../common/common_colour.h"
 
 /******************************************************************************
 Macros
@@ -52,11 +53,49 @@ uint32_t drv_rgb_led_strip_init(void);
 void drv_rgb_led_strip_deinit(void);
 
 /*! @brief Sets the colour of the LED at the specified index
+ * The colour is only staged in the strip's buffer, it is sent to the LEDs 
+ * with the next call to drv_rgb_led_strip_flush()
  * @param _index The index of the LED to set the colour for
  * @param _rgb The 24-bit RGB value to set the LED to
  */
 void drv_rgb_led_strip_set_colour(int led_index, uint32_t rgb);
 
+/*! @brief Sets the colours of a run of consecutive LEDs, starting at the specified index
+ * The run may span more than one strip. As with drv_rgb_led_strip_set_colour(), 
+ * the colours are only staged until the next drv_rgb_led_strip_flush()
+ * @param led_index The index of the first LED to set
+ * @param wrgb The 32-bit WRGB values, one per LED
+ * @param count The number of LEDs to set
+ * @return The number of LEDs set
+ */
+int drv_rgb_led_strip_set_colours(int led_index, const uint32_t * wrgb, int count);
+
+/*! @brief Sends the staged colours of every strip that has changed to the LEDs
+ * The transmission is started in the background (not waited on). If a strip 
+ * is still busy with the previous transmission it is left for the next flush.
+ * @return The number of strips for which a transmission was started
+ */
+int drv_rgb_led_strip_flush(void);
+
+/*! @brief Sets the output correction of the strip containing the specified LED
+ * The white balance, CIE lightness (gamma) correction and brightness limit are
+ * combined into the strip's output LUTs, which are applied to every byte when 
+ * the strip is flushed
+ * @param led_index The index of any LED in the strip
+ * @param gamma true to apply the CIE lightness correction
+ * @param cal The white balance and brightness limit (NULL for no correction)
+ * @return ESP_OK if successful, ESP_ERR_INVALID_ARG if the LED index is invalid
+ */
+esp_err_t drv_rgb_led_strip_set_calibration(int led_index, bool gamma, const colour_cal_t * cal);
+
+/*! @brief Retrieves the output correction of the strip containing the specified LED
+ * @param led_index The index of any LED in the strip
+ * @param[out] gamma true if the CIE lightness correction is applied (may be NULL)
+ * @param[out] cal The white balance and brightness limit (may be NULL)
+ * @return ESP_OK if successful, ESP_ERR_INVALID_ARG if the LED index is invalid
+ */
+esp_err_t drv_rgb_led_strip_get_calibration(int led_index, bool * gamma, colour_cal_t * cal);
+
 /*! Returns a pointer to a string with the name of the LED strip type
  * @param[in] led_index The index of the LED to set the colour for
  * @return A pointer to the string with the name of the LED strip type
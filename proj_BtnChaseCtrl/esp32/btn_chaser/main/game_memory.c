@@ -10,7 +10,9 @@ This game will work as follows:
         In the 1st round, the 1st button of the sequence is displayed and the user needs to press it.
         In the 2nd round, the 1st button and then the second button is displayed and the user needs to press them in the same order.
         This will continue until the user has pressed all buttons in the sequence correctly for the last round.
-    2. A round starts with the system blinking the first <ROUND_NR> of buttons in order.
+    2. A round starts with the system blinking the first <ROUND_NR> of buttons in order. The whole sequence is 
+        uploaded in one broadcast and the nodes play it back themselves (see bcst_sequence()), so the blinks are 
+        evenly timed however long the sequence gets, and the master simply waits for it to end.
     3. Then flashes blue to indicate the start of the user input stage
     4. The user then needs to press the buttons in the same order as they were displayed.
         If the user presses the wrong button, the round will be reset and the user will have to start over after the buttons has been displayed again.
@@ -42,6 +44,7 @@ includes
 #include "task_game.h"
 #include "colour.h"
 #include "esp_random.h"
+#include "sys_rstats.h"
 
 #define __NOT_EXTERN__
 #include "game_memory.h"
@@ -66,6 +69,12 @@ local defines
 
 #define GAME_MEMORY_LEVELS                  20
 
+#define GAME_MEMORY_TMR                     0   /* The game timer for the blink periods */
+
+#if (GAME_MEMORY_LEVELS + 1) > CMD_SEQ_STEPS_MAX
+#error "The longest sequence does not fit into a single cmd_set_sequence"
+#endif
+
 typedef struct
 {
     uint8_t btn;
@@ -77,8 +86,7 @@ typedef enum
 {
     _mem_state_start = 0,
     _mem_state_start_on,
-    _mem_state_blink_off,
-    _mem_state_blink_on,
+    _mem_state_playback,
     _mem_state_usr_input_wait,
     _mem_state_user_blink_off,   
     _mem_state_win,   
@@ -91,17 +99,18 @@ local function prototypes
 void _memory_blink_all_on_off(uint32_t colour, uint32_t time_ms);
 void _memory_blink_node_on_off(uint8_t btn, uint32_t colour, uint32_t time_ms);
 _memory_state_t _memory_usr_input_stage_start(void);
+void _memory_playback_start(void);
 
 /*******************************************************************************
 local variables
  *******************************************************************************/
 uint32_t _memory_col_list[] = {colNavy, colBlue, colGreen, colTeal, colLime, colCyan, colMaroon, colPurple, colMagenta, colRed, colOrange, colYellow, colWhite};
-_memory_round_t _round[GAME_MEMORY_LEVELS] = {0}; // The array of rounds
+_memory_round_t _round[GAME_MEMORY_LEVELS + 1] = {0}; // The array of rounds (levels 0 to GAME_MEMORY_LEVELS, so 1 step more than the levels)
 
 
 uint8_t _btn_pressed = 0xff; //The button the user pressed (0 to node_count()-1 or 0xff for no button pressed)
+uint32_t _btn_reaction_ms = 0; //The reaction time of the button the user pressed
 uint8_t _game_level = 0; // The current level of the game
-uint8_t _game_level_display = 0; // The current level of the game
 uint8_t _user_level = 0; // The current level of the user
 
 
@@ -109,28 +118,26 @@ uint32_t _tmp_blink_ms;
 //uint32_t _tmp_blink_wait_ms;
 uint32_t _blink_ms = GAME_MEMORY_BLINK_PERIOD_DEF_MS; // The blink period in milliseconds
 _memory_state_t _memory_state = _mem_state_start; // The current state of the memory game
-Timer_ms_t _memory_tmr = {0}; // Timer for the memory game
 /*******************************************************************************
 Local (private) Functions
 *******************************************************************************/
 void _memory_blink_all_on_off(uint32_t colour, uint32_t time_ms)
 {
-    init_bcst_msg(); //Initialize the broadcast message
-    add_bcst_msg_set_rgb(0, colour); //Set the first RGB colour to green
-    bcst_msg_tx_now(); //Send the message to the nodes
+    for (int i = 0; i < node_count(); i++)
+        node_target_set_rgb(i, 0, colour); //Set the first RGB colour
+    nodes_target_flush(); //Send the changes to the nodes (as a broadcast)
     if (time_ms > 0)
-        sys_poll_tmr_start(&_memory_tmr, time_ms, false); //Start
+        game_timer_start(GAME_MEMORY_TMR, time_ms); //Start
 }
 
 void _memory_blink_node_on_off(uint8_t btn, uint32_t colour, uint32_t time_ms)
 {
     //if (colour != colBlack)
     //iprintln(trGAME, "#Round %d/%d: %d - %s (%d ms)", _game_level_display, _game_level, _round[_game_level_display].btn, rgb2name(colour), time_ms);
-    init_node_msg(btn); //Initialize the node message with the selected node address
-    add_node_msg_set_rgb(btn, 0, colour); //Set the first RGB colour to black
-    node_msg_tx_now(btn); //Send the message to the node
+    node_target_set_rgb(btn, 0, colour); //Set the first RGB colour
+    nodes_target_flush(); //Send the changes to the node(s)
     if (time_ms > 0)
-        sys_poll_tmr_start(&_memory_tmr, time_ms, false); //Start the timer for the blink period
+        game_timer_start(GAME_MEMORY_TMR, time_ms); //Start the timer for the blink period
 }
 
 _memory_state_t _memory_usr_input_stage_start(void)
@@ -138,48 +145,50 @@ _memory_state_t _memory_usr_input_stage_start(void)
     //Great, this is the start of the user input stage... Actiavate all the buttons and set their 3rd colour to either red or green (for the correct button)
     for (int i = 0; i < node_count(); i++)
     {
-        init_node_msg(i); //Initialize the node message with the selected node address
-        add_node_msg_set_blink(i, 0);
-        add_node_msg_set_rgb(i, 0, colBlack); //Set the first RGB colour to black
-        add_node_msg_set_rgb(i, 2, (_round[_user_level].btn == i)? colGreen : colRed); //Set the the colour
-        add_node_msg_set_active(i, true); //Set the node as active
-        node_msg_tx_now(i); //Send the message to the node
-        sys_stopwatch_ms_start(&_round[_user_level].sw, UINT32_MAX); //Start the stopwatch for the button press
+        node_target_set_blink(i, 0);
+        node_target_set_rgb(i, 0, colBlack); //Set the first RGB colour to black
+        node_target_set_rgb(i, 2, (_round[_user_level].btn == i)? colGreen : colRed); //Set the the colour
+        node_target_set_active(i, true); //Set the node as active
     }
+    nodes_target_flush(); //Shared colours are broadcast, the rest is sent to each node
+    sys_stopwatch_ms_start(&_round[_user_level].sw, UINT32_MAX); //Start the stopwatch for the button press
     _btn_pressed = 0xff; //Reset the button pressed to no button pressed            
+    _btn_reaction_ms = 0;
     iprintln(trGAME, "#Round %d/%d, Waiting for user input (%d)", _user_level, _game_level, _round[_user_level].btn);
     return _mem_state_usr_input_wait; //Move to the wait user input state
 }
+
+void _memory_playback_start(void)
+{
+    uint8_t slots[GAME_MEMORY_LEVELS + 1];
+    uint8_t steps = _game_level + 1;
+    //The nodes take it from here... the last step ends (lead + on) + (steps-1)*(on + off) after the broadcast
+    uint32_t playback_ms = _blink_ms + ((steps - 1) * (_blink_ms + GAME_MEMORY_BLINK_PERIOD_OFF_MS)) + _blink_ms;
+
+    for (int i = 0; i < steps; i++)
+        slots[i] = _round[i].btn;
+    if (!bcst_sequence(slots, steps, colBlue, _blink_ms, _blink_ms, GAME_MEMORY_BLINK_PERIOD_OFF_MS))
+        iprintln(trGAME|trALWAYS, "!Could not upload the sequence of level %d", _game_level);
+    game_timer_start(GAME_MEMORY_TMR, playback_ms);
+}
 /*******************************************************************************
 Global (public) Functions
 *******************************************************************************/
 void game_memory_main(void)
 {
+    //This function is called every tick, and as soon as the game timer expires (see game_memory_event())
     switch (_memory_state)
     {
         case _mem_state_start:
         {
-            if (sys_poll_tmr_started(&_memory_tmr))
-            {
-                if (!sys_poll_tmr_expired(&_memory_tmr))
-                    break;
-                // else, happy to fall through now.
-            } // else, fall through
+            if (game_timer_running(GAME_MEMORY_TMR))
+                break;
+            // else, happy to fall through now.
 
 
-            //Make sure all buttons are deactivated and set to black
-            for (int i = 0; i < node_count(); i++)
-            {
-                init_node_msg(i); //Initialize the node message with the selected node address
-                add_node_msg_set_blink(i, 0); //Set the node to blink
-                add_node_msg_set_rgb(i, 0, colBlack); //Set the first RGB colour
-                add_node_msg_set_rgb(i, 1, colBlack); //Set the second RGB colour
-                add_node_msg_set_rgb(i, 2, colBlack); //Set the third RGB colour
-                add_node_msg_set_active(i, false); //Set the node as inactive
-                node_msg_tx_now(i); //Send the message to the node
-            }
-            _game_level_display = 0; //Reset the game level display to 0
-            iprintln(trGAME, "#Starting level %d (%d)", _game_level, _round[_game_level_display].btn);
+            //Make sure all buttons are deactivated and set to black... in a single broadcast (only a node still active gets its own msg)
+            nodes_reset(NODES_MASK_ALL);
+            iprintln(trGAME, "#Starting level %d (%d)", _game_level, _round[0].btn);
             //RVN - TODO - Depending ont the retry count, this colour could be green... orange.... red.
             _memory_blink_all_on_off(colGreen, _blink_ms);
             _memory_state =  _mem_state_start_on;
@@ -187,98 +196,62 @@ void game_memory_main(void)
         }
         case _mem_state_start_on:
         {
-            if (sys_poll_tmr_expired(&_memory_tmr)) //Check if the timer has expired
+            if (!game_timer_running(GAME_MEMORY_TMR)) //Check if the timer has expired
             {
-                _memory_blink_all_on_off(colBlack, _blink_ms);
-                _memory_state =  _mem_state_blink_off;
+                //The green goes off, and the nodes show the sequence after the same (blink) period
+                _memory_blink_all_on_off(colBlack, 0);
+                _memory_playback_start();
+                _memory_state =  _mem_state_playback;
             }    
             break;
         }
-        case _mem_state_blink_off:
+        case _mem_state_playback:
         {
-            //This state is only entered if (_game_level_display < _game_level)
-            if (!sys_poll_tmr_expired(&_memory_tmr)) //Check if the timer has expired
-                break; //If the timer has not expired, we are still waiting for the blink period to end
-
-            //We should clear the buttons which are all displaying green now...
-            if (0 == _game_level_display)
+            if (!game_timer_running(GAME_MEMORY_TMR)) //The last step of the sequence is done
             {
-                init_bcst_msg();
-                add_bcst_msg_set_rgb(0, colBlack);
-                bcst_msg_tx_now();
-            }
-
-            _memory_blink_node_on_off(_round[_game_level_display].btn, colBlue, _blink_ms);
-            _memory_state = _mem_state_blink_on;
-            break;
-        }
-        case _mem_state_blink_on:
-        {
-            if (sys_poll_tmr_expired(&_memory_tmr)) //OK, blink period expired....  we can turn the button off and then  we need to decide  if we are displayign the next button or are we moving to the user input stage
-            {
-                //OK, blink period expired.... we can blink the next button
-                if (_game_level_display < _game_level)
-                {
-                    _memory_blink_node_on_off(_round[_game_level_display].btn, colBlack, GAME_MEMORY_BLINK_PERIOD_OFF_MS);
-                    _memory_state = _mem_state_blink_off;
-                    _game_level_display++; //Increment the game level display count
-                }
-                else
-                {
-                    _user_level = 0; //Reset the user level count to 0
-                    _memory_state = _memory_usr_input_stage_start(); //Move to the wait user input state
-                }
+                _user_level = 0; //Reset the user level count to 0
+                _memory_state = _memory_usr_input_stage_start(); //Move to the wait user input state
             }
-            break; //If the timer has not expired, we are still waiting for the blink ON period to end
+            break; //Nothing to do while the nodes are playing back the sequence
         }
 
         case _mem_state_usr_input_wait:
         {
             uint32_t time_since_button_pressed = 0;
-            uint32_t time_to_btn_pressed = UINT32_MAX;
+            uint32_t time_to_btn_pressed = _btn_reaction_ms;
 
-            //Run through all the nodes since more than one button could hav been pressed... we need to know which one was pressed first
-            for (int i = 0; i < node_count(); i++)
+            if (_btn_pressed == 0xff) //If no button was pressed (yet)
             {
-                init_node_msg(i); //Initialize the node message with the selected node address
-                add_node_msg_get_reaction(i); //Read the flags state before we set them active to prevent false positives
-                node_msg_tx_now(i); //Send the message to the node
-
-                uint32_t ttbp = get_node_btn_reaction_ms(i);
-                if (ttbp == 0) //If the node has no reaction time, it was not pressed
-                    continue; //Skip this node
-
-                if (ttbp < time_to_btn_pressed) //If this node has a reaction time shorter than the current shortest reaction time
+                //Run through all the nodes... the presses come back as events, and more than one button could have 
+                // been pressed, so game_memory_event() keeps the one that was pressed first
+                for (int i = 0; i < node_count(); i++)
                 {
-                    time_to_btn_pressed = ttbp; //Set the new shortest reaction time
-                    _btn_pressed = i; //Set the button pressed to the node address
+                    init_node_msg(i); //Initialize the node message with the selected node address
+                    add_node_msg_get_reaction(i); //Read the flags state before we set them active to prevent false positives
+                    node_msg_tx_now(i); //Send the message to the node
                 }
-                //else, we have the shortest time already
-            }
-            
-            if (_btn_pressed == 0xff) //If no button was pressed
                 break; //Exit the switch
+            }
+
+            if (_btn_pressed == _round[_user_level].btn)
+                rstats_add(0, _btn_pressed, time_to_btn_pressed); //Only the right buttons count
 
-            sys_poll_tmr_start(&_memory_tmr, MAX(1, _blink_ms-time_since_button_pressed), false); //Start the timer for the blink period
             // Make sure that only the button that was pressed is turned on (either green or red depending on if it was the correct button) and ALL other buttons are turned off
             for (int i = 0; i < node_count(); i++)
             {
                 if ((i == _btn_pressed))
                     continue; //Skip this node... it is already pressed and activated
                 uint32_t _col = (i == _btn_pressed)? ((_btn_pressed == _round[_user_level].btn)? colGreen : colRed) : colBlack;
-                init_node_msg(i); //Initialize the node message with the selected node address                
-                add_node_msg_set_rgb(i, 0, _col); //Set the 1st RGB colour for the buttons already pressed
-                add_node_msg_set_rgb(i, 2, _col); //Set the 3rd RGB colour for the buttons we are going to deactivate now
-                add_node_msg_set_active(i, false); //Set all the nodes as inactive
-                node_msg_tx_now(i); //Send the message to the node
-
-                //RVN -TODO consider doing this with a very special broadcast message instead of individual messages
+                node_target_set_rgb(i, 0, _col); //Set the 1st RGB colour for the buttons already pressed
+                node_target_set_rgb(i, 2, _col); //Set the 3rd RGB colour for the buttons we are going to deactivate now
+                node_target_set_active(i, false); //Set all the nodes as inactive
             }
+            nodes_target_flush(); //Send the changes to the nodes
 
             time_since_button_pressed = sys_stopwatch_ms_stop(&_round[_user_level].sw) - time_to_btn_pressed; //Get the time since the button was pressed
             //iprintln(trGAME, "#Button %d pressed %d ms ago (reaction time: %d ms)", _btn_pressed, time_since_button_pressed, time_to_btn_pressed);
             //Make sure the button is lit for a period of time
-            sys_poll_tmr_start(&_memory_tmr, MAX(GAME_MEMORY_BLINK_PERIOD_MIN_MS, _blink_ms-time_since_button_pressed), false); //Start the timer for the blink period
+            game_timer_start(GAME_MEMORY_TMR, MAX(GAME_MEMORY_BLINK_PERIOD_MIN_MS, _blink_ms-time_since_button_pressed)); //Start the timer for the blink period
             _memory_state = _mem_state_user_blink_off; //Move to the win state
             break;
         }
@@ -286,10 +259,9 @@ void game_memory_main(void)
         case _mem_state_user_blink_off:
         {
             // At this point, the only button lit should be the button that was pressed, and it should be green or red., and the timer should have been started...
-            if (sys_poll_tmr_expired(&_memory_tmr)) //OK, blink period expired....  we can turn the button off and then  we need to decide  if we are displayign the next button or are we moving to the user input stage
+            if (!game_timer_running(GAME_MEMORY_TMR)) //OK, blink period expired....  we can turn the button off and then  we need to decide  if we are displayign the next button or are we moving to the user input stage
             {
                 _memory_blink_node_on_off(_btn_pressed, colBlack, 0);
-                _memory_state = _mem_state_blink_off;
             }
 
             if (_btn_pressed == _round[_user_level].btn) //If the button pressed is the correct button, it would already be turned the correct colour
@@ -335,6 +307,35 @@ void game_memory_main(void)
     }
 }
 
+void game_memory_event(const game_event_t *evt)
+{
+    switch (evt->type)
+    {
+        case game_evt_press:
+        {
+            if (_memory_state != _mem_state_usr_input_wait)
+                break;
+
+            //Keep the button that was pressed first
+            if ((_btn_pressed == 0xff) || (evt->value < _btn_reaction_ms))
+            {
+                _btn_pressed = (uint8_t)evt->slot;
+                _btn_reaction_ms = evt->value;
+            }
+            //Carry on once the rest of the presses from this round of reads are in
+            game_timer_start(GAME_MEMORY_TMR, 0);
+            break;
+        }
+        case game_evt_timer:
+        {
+            game_memory_main(); //The next step, without waiting for the next tick
+            break;
+        }
+        default:
+            break;
+    }
+}
+
 void game_memory_init(bool startup, bool new_game_params)
 {
     //This function is called once to initialise the game.
@@ -352,13 +353,13 @@ void game_memory_init(bool startup, bool new_game_params)
         _blink_ms = (new_game_params)? _tmp_blink_ms : GAME_MEMORY_BLINK_PERIOD_DEF_MS; //Get the blink period from the parameters or use the default value
         //_blink_wait_ms = (new_game_params)? _blink_ms : GAME_MEMORY_BLINK_WAIT_PERIOD_DEF_MS; //Get the blink wait period from the parameters or use the default value
         iprintln(trGAME, "#Starting up with a blink period of %d ms:", _blink_ms);
-        for (int i = 0; i < GAME_MEMORY_LEVELS; i++)
+        for (int i = 0; i <= GAME_MEMORY_LEVELS; i++)
         {
             _round[i].btn = (uint8_t)(esp_random() % node_count()); //Generate a random level value between 0 and the number of nodes
             // _round[i].colour =  _memory_col_list[(esp_random() % ARRAY_SIZE(_memory_col_list))]; //Set the colour for the level
             iprintln(trGAME, "#Level %d: %d", i, _round[i].btn);
         }
-        sys_poll_tmr_stop(&_memory_tmr);
+        game_timer_stop(GAME_MEMORY_TMR);
     }
     else if (new_game_params)
     {
@@ -375,6 +376,8 @@ void game_memory_teardown(void)
 {
     //This function is called once to tear down the game.
     //It can be used to free any resources allocated during the game.
+    if (_memory_state == _mem_state_playback)
+        bcst_sequence(NULL, 0, colBlack, 0, 0, 0); //Don't leave the nodes playing back the sequence
     _game_level = 0; //Reset the level count to 0
     _user_level = 0; //Reset the user level count to 0
     _memory_state = _mem_state_start; //Reset the memory state to start
@@ -409,7 +412,7 @@ bool game_memory_arg_parser(const char **arg_str_array, int arg_cnt, bool * new_
         if (_memory_state != _mem_state_start)
         {
             iprintln(trALWAYS, "Memory Game Levels:");
-            for (int i = 0; i < GAME_MEMORY_LEVELS; i++)
+            for (int i = 0; i <= GAME_MEMORY_LEVELS; i++)
                 iprintln(trGAME, "#%d: %d", i, _round[i].btn);
         }
         else
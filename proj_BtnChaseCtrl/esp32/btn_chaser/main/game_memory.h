@@ -13,6 +13,7 @@ Include file for game_memory.c
 includes
 ******************************************************************************/
 #include "defines.h"
+#include "task_game.h"
 
 /******************************************************************************
 Macros
@@ -32,6 +33,7 @@ Global (public) Function prototypes
 ******************************************************************************/
 
 void game_memory_main(void);
+void game_memory_event(const game_event_t *evt);
 void game_memory_init(bool startup, bool new_game_params);
 void game_memory_teardown(void);
 bool game_memory_arg_parser(const char **arg_str_array, int arg_cnt, bool * new_game_params);
@@ -29,8 +29,10 @@ includes
 #include "str_helper.h"
 #include "task_console.h"
 #include "nodes.h"
+#include "task_game.h"
 #include "colour.h"
 #include "esp_random.h"
+#include "sys_rstats.h"
 
 #define __NOT_EXTERN__
 #include "game_random_chase.h"
@@ -55,6 +57,12 @@ Macros and Constants
 #define GAME_RANDOM_CHASE_BTN_TIMEOUT_DEF       10
 
 #define GAME_RANDOM_CHASE_BLINK_UPDATE_CNT      2
+
+#define GAME_RANDOM_CHASE_PLAYERS_MAX           GAME_TIMERS_MAX   /* Each player has a game timer for the button timeout (timer n for player n) */
+#define GAME_RANDOM_CHASE_PLAYERS_DEF           1
+
+/* The blink/hue ramp moves in steps, so that targets on the same step share a broadcast */
+#define GAME_RANDOM_CHASE_RAMP_STEPS            16
 /*******************************************************************************
 local defines 
  *******************************************************************************/
@@ -71,10 +79,49 @@ typedef enum
     _chase_state_set = 0,
     _chase_state_read,    
 } _chase_state_t;
+
+typedef struct
+{
+    uint8_t node;               // The node this player is chasing (ADDR_BROADCAST if none)
+    _chase_state_t state;
+    bool prev_success;          // Was the last node's button successfully pressed?
+    uint32_t last_hue;          // The last blink hue used for the node
+    uint32_t ramp_step;         // The last ramp step sent to the node
+    uint32_t update_cnt;
+    uint32_t total_cnt;
+    /* The score */
+    uint32_t hits;
+    uint32_t timeouts;
+    uint32_t reaction_sum_ms;
+    uint32_t reaction_best_ms;
+} _chase_player_t;
 /*******************************************************************************
 local function prototypes
  *******************************************************************************/
 
+/*! \brief Shows the result on the player's previous node and activates a new (random) node for the player
+ * \param player The player (0 to _players-1)
+ */
+void _chase_next_node(int player);
+
+/*! \brief Deactivates the node a player is chasing, once the button timeout expired
+ * \param player The player (0 to _players-1)
+ */
+void _chase_timeout(int player);
+
+/*! \brief Moves the blink period and hue of all the targets along with their remaining time
+ */
+void _chase_ramp(void);
+
+/*! \brief Deactivates the node of a player (directly, the game might be ending)
+ * \param player The player (0 to _players-1)
+ */
+void _chase_player_off(int player);
+
+/*! \brief Prints the hits, timeouts and reaction times of each player
+ */
+void _chase_score_print(void);
+
 /*******************************************************************************
 local variables
  *******************************************************************************/
@@ -86,196 +133,301 @@ uint32_t _col[3] = {
     GAME_RANDOM_CHASE_OFF_COL_3_DEF
 };
 uint32_t _tmp_btn_timeout = GAME_RANDOM_CHASE_BTN_TIMEOUT_DEF;
+uint32_t _tmp_players = GAME_RANDOM_CHASE_PLAYERS_DEF;
 uint32_t _tmp_btn_blink_hue;
-Timer_ms_t _btn_timer = {0}; // Timer for the button timeout
 // uint8_t _blink_update_cnt = 0; // Counter for the number of times we have updated the blink period and colours
 
 uint32_t _btn_timeout_ms;
-uint8_t _chase_node = ADDR_BROADCAST; // The address of the node we are chasing
-_chase_state_t _chase_state = _chase_state_set; // The current state of the chase game
-bool _prev_node_success = false; // Was the last node's button successfully pressed?
 
-uint32_t _last_blink_rate;
-uint32_t _last_blink_hue = hueLime; // The last blink hue used for the node
+/* The 2nd colour of each player's target (the 1st is the ramp) */
+const uint32_t _chase_player_col[GAME_RANDOM_CHASE_PLAYERS_MAX] = {colMagenta, colBlue, colCyan, colWhite};
 
-uint32_t _blink_update_cnt;
-uint32_t _hue_update_cnt; // Counter for the number of times we have updated the hue
-uint32_t _update_cnt;
-uint32_t _total_cnt;
+_chase_player_t _chase_player[GAME_RANDOM_CHASE_PLAYERS_MAX];
+int _players = GAME_RANDOM_CHASE_PLAYERS_DEF;
 
 /*******************************************************************************
 Local (private) Functions
 *******************************************************************************/
+void _chase_next_node(int player)
+{
+    _chase_player_t *p = &_chase_player[player];
+    uint8_t _candidates[RGB_BTN_MAX_NODES];
+    int _cnt = 0;
+
+    if (p->update_cnt > 0)
+        iprintln(trGAME, "#Node %d updated %d/%d times", p->node, p->update_cnt, p->total_cnt);
+
+    //All the nodes nobody else is chasing are cleared (only those not cleared already will be sent anything)
+    for (int i = 0; i < node_count(); i++)
+    {
+        bool _taken = false;
+        for (int j = 0; j < _players; j++)
+            if ((j != player) && (_chase_player[j].node == i))
+                _taken = true;
+        if (_taken)
+            continue;
+
+        node_target_set_blink(i, 0);
+        node_target_set_rgb(i, 0, colBlack);
+        node_target_set_rgb(i, 1, colBlack);
+        node_target_set_rgb(i, 2, colBlack);
+        node_target_set_active(i, false);
+    }
+    if ((p->node != ADDR_BROADCAST) && (_btn_timeout_ms > 0))
+    {
+        //We have a previous node, so we need to show the result on it (in the player's colour if there are more than 1)
+        uint32_t _success_col = (_players > 1)? _chase_player_col[player] : hue2rgb(p->last_hue);
+        node_target_set_rgb(p->node, 0, p->prev_success? _success_col : colRed); //Set the SUCCESS/FAIL RGB colour
+    }
+
+    //Any node nobody is chasing... rather not the same one again, unless there is no other
+    for (int pass = 0; (pass < 2) && (_cnt == 0); pass++)
+    {
+        for (int i = 0; i < node_count(); i++)
+        {
+            bool _taken = ((pass == 0) && (i == p->node));
+            for (int j = 0; j < _players; j++)
+                if ((j != player) && (_chase_player[j].node == i))
+                    _taken = true;
+            if ((!_taken) && (is_node_valid(i)))
+                _candidates[_cnt++] = (uint8_t)i;
+        }
+    }
+    if (_cnt == 0)
+    {
+        //More players than nodes... this player sits out until a node is freed (or joins)
+        nodes_target_flush();
+        p->node = ADDR_BROADCAST;
+        p->state = _chase_state_set;
+        return;
+    }
+
+    p->node = _candidates[esp_random() % _cnt]; //Get a random node address
+
+    node_target_set_blink(p->node, _blink_period); //Set the node to blink
+    node_target_set_rgb(p->node, 0, hue2rgb(hueLime)); //Set the first RGB colour
+    node_target_set_rgb(p->node, 1, _chase_player_col[player]); //Set the second RGB colour
+    node_target_set_rgb(p->node, 2, colBlack); //Set the third RGB colour
+    node_target_set_active(p->node, true); //Set the node as active
+    if ((nodes_target_flush() < 0) || (!is_node_valid(p->node))) //Send the changes to the nodes
+    {
+        iprintln(trGAME|trALWAYS, "!Could not activate node %d", p->node);
+        //At this point, the node would have been deregistered, so we need to select a new node (on the next tick)
+        game_timer_stop(player);
+        p->state = _chase_state_set; //Move to the new state to select a new node
+    }
+    else
+    {
+        if (_players > 1)
+            iprintln(trGAME, "#Player %d: Press Button #%d", player + 1, p->node);
+        else
+            iprintln(trGAME, "#Press Button #%d", p->node);
+        p->last_hue = hueLime;
+        p->ramp_step = GAME_RANDOM_CHASE_RAMP_STEPS - 1;
+        if (_btn_timeout_ms > 0)
+            game_timer_start(player, _btn_timeout_ms); //Start the timer for the button timeout
+        p->update_cnt = 0;
+        p->total_cnt = 0;
+        p->state = _chase_state_read; //Move to the read state to wait for a response
+    }
+}
+
+void _chase_timeout(int player)
+{
+    _chase_player_t *p = &_chase_player[player];
+
+    //iprintln(trGAME, "#Node %d: Button-press timeout after %d s", p->node, _btn_timeout_ms/1000);
+    node_target_set_blink(p->node, 0); //Set the node to blink no more
+    node_target_set_rgb(p->node, 0, hue2rgb(p->last_hue)); //Set the third RGB colour
+    node_target_set_active(p->node, false); //Set the node as inactive
+    if (nodes_target_flush() < 0) //Send the changes to the node
+        iprintln(trGAME|trALWAYS, "!Could not de-activate node %d", p->node);
+    p->prev_success = false;
+    p->timeouts++;
+}
+
+void _chase_ramp(void)
+{
+    bool _changed = false;
+
+    if (_btn_timeout_ms == 0)
+        return;
+
+    for (int i = 0; i < _players; i++)
+    {
+        _chase_player_t *p = &_chase_player[i];
+        if (p->state != _chase_state_read)
+            continue;
+
+        uint32_t _remaining_time = game_timer_remaining_ms(i); //Get the remaining time in milliseconds
+        if ((_remaining_time == 0) || (_remaining_time >= _btn_timeout_ms))
+            continue;
+
+        //Targets on the same step get the same blink period and hue, so the flush can broadcast it to all of them at once
+        uint32_t _step = (_remaining_time * GAME_RANDOM_CHASE_RAMP_STEPS) / _btn_timeout_ms;
+        p->total_cnt++;
+        if (_step == p->ramp_step)
+            continue;
+
+        //We want to re-adjust the blink period of the node to gradually increase the blinking frequency as the time runs out
+        uint32_t _new_blink_rate = GAME_RANDOM_CHASE_BLINK_PERIOD_MS_MIN + ((_step + 1) * (_blink_period - GAME_RANDOM_CHASE_BLINK_PERIOD_MS_MIN) / GAME_RANDOM_CHASE_RAMP_STEPS);
+        //We are also going to make the blink colour hue change gradually from green (120) to red (0) as the time runs out
+        uint32_t _new_blink_hue = (_step + 1) * (hueLime - hueRed) / GAME_RANDOM_CHASE_RAMP_STEPS;
+
+        node_target_set_blink(p->node, _new_blink_rate);
+        node_target_set_rgb(p->node, 0, hue2rgb(_new_blink_hue));
+        p->last_hue = _new_blink_hue;
+        p->ramp_step = _step;
+        p->update_cnt++;
+        _changed = true;
+    }
+
+    //Only what has changed since the last time is sent (if anything), for all the targets together
+    if ((_changed) && (nodes_target_flush() < 0))
+        iprintln(trGAME|trALWAYS, "!Could not adjust the blink rate and hue of the targets");
+}
+
+void _chase_player_off(int player)
+{
+    uint8_t node = _chase_player[player].node;
+
+    if ((is_node_valid(node)) && (nodes_reset(BIT_POS(node)) < 0))
+        iprintln(trGAME|trALWAYS, "!Could not deactivate node (%d)", node);
+    game_timer_stop(player);
+    _chase_player[player].node = ADDR_BROADCAST;
+    _chase_player[player].state = _chase_state_set;
+}
+
+void _chase_score_print(void)
+{
+    for (int i = 0; i < _players; i++)
+    {
+        _chase_player_t *p = &_chase_player[i];
+        iprint(trALWAYS, "#Player %d: %d hits, %d timeouts", i + 1, p->hits, p->timeouts);
+        if (p->hits > 0)
+            iprint(trALWAYS, ", %d ms avg, %d ms best", p->reaction_sum_ms / p->hits, p->reaction_best_ms);
+        iprintln(trALWAYS, "");
+    }
+}
 
 /*******************************************************************************
 Global (public) Functions
 *******************************************************************************/
 void game_random_chase_main(void)
 {
-    //This function is going to be called repeatedly within a task's while(1) loop.
-    switch (_chase_state)
+    //This function is called every tick, the presses and timeouts are handled in game_random_chase_event() as they happen
+    for (int i = 0; i < _players; i++)
+        if (_chase_player[i].state == _chase_state_set)
+            _chase_next_node(i);
+
+    //We want to read the responses from the active nodes (a press comes back as a game_evt_press)
+    //All the targets are read with a single broadcast every tick, each answering in its own slot
+    uint32_t read_mask = 0;
+    for (int i = 0; i < _players; i++)
+        if (_chase_player[i].state == _chase_state_read)
+            read_mask |= BIT_POS(_chase_player[i].node);
+
+    uint32_t missed_mask = nodes_poll_reaction(read_mask);
+
+    //Those who missed their slot are read directly (which is retried, and deregisters the node if it is gone)
+    for (int i = 0; i < _players; i++)
     {
-        case _chase_state_set:
+        if ((_chase_player[i].state != _chase_state_read) || (!(missed_mask & BIT_POS(_chase_player[i].node))))
+            continue;
+
+        init_node_msg(_chase_player[i].node); //Initialize the node message with the selected node address
+        add_node_msg_get_reaction(_chase_player[i].node); //Get the reaction time from the node
+        if (!node_msg_tx_now(_chase_player[i].node)) //Send the message to the node
         {
-            if (_update_cnt > 0)
-                iprintln(trGAME, "#Node %d updated %d/%d times (blink_rate: %d, hue: %d)", _chase_node, _update_cnt, _total_cnt, _blink_update_cnt, _hue_update_cnt);
+            iprintln(trGAME|trALWAYS, "!Could not read node %d", _chase_player[i].node);
+            //At this point, the node would have been deregistered (game_evt_node_lost), so we need to select a new node
+            game_timer_stop(i);
+            _chase_player[i].state = _chase_state_set; //Move to the new state to select a new node
+        }
+    }
 
-            uint8_t _new_node = _chase_node;
-            bcst_msg_clear_all();
-            if ((_chase_node != ADDR_BROADCAST) && (_btn_timeout_ms > 0))
-            {
-                //We have a previous node, so we need to de-activate it
-                init_node_msg(_chase_node); //Initialize the node message with the previous node address
-                add_node_msg_set_rgb(_chase_node, 0, _prev_node_success? hue2rgb(_last_blink_hue) : colRed); //Set the SUCCESS/FAIL RGB colour
-                if (!node_msg_tx_now(_chase_node)) //Send the message to the node
-                    iprintln(trGAME|trALWAYS, "#Error: Could not set last node (%d) colour to %s", _chase_node, _prev_node_success? "green" : "red");
-            }
-            do
-            {
-                _new_node = (uint8_t)(esp_random() % (node_count())); //Get a random node address, including the broadcast address
-                //_new_node = (uint8_t)(rand() % (node_count())); //Get a random node address
-            } while (_new_node == _chase_node || !is_node_valid(_new_node)); //Ensure we don't select the same node or an invalid node
-
-            _chase_node = _new_node; //Get a random node address, including the broadcast address
-
-            init_node_msg(_chase_node); //Initialize the node message with the selected node address
-            add_node_msg_set_blink(_chase_node, _blink_period); //Set the node to blink
-            add_node_msg_set_rgb(_chase_node, 0, hue2rgb(hueLime)); //Set the first RGB colour
-            add_node_msg_set_rgb(_chase_node, 1, hue2rgb(hueMagenta)); //Set the second RGB colour
-            add_node_msg_set_rgb(_chase_node, 2, colBlack); //Set the third RGB colour
-            add_node_msg_set_active(_chase_node, true); //Set the node as active
-            if (!node_msg_tx_now(_chase_node)) //Send the message to the node
-            {
-                iprintln(trGAME|trALWAYS, "#Error: Could not activate node %d", _chase_node);
-                //At this point, the node would have been deregistered, so we need to select a new node
-                _chase_state = _chase_state_set; //Move to the new state to select a new node
-            }
-            else
+    _chase_ramp();
+}
+
+void game_random_chase_event(const game_event_t *evt)
+{
+    switch (evt->type)
+    {
+        case game_evt_press:
+        {
+            //Whoever's node it is, gets the point
+            for (int i = 0; i < _players; i++)
             {
-                iprintln(trGAME, "#Press Button #%d", _chase_node);
-                if (_tmp_btn_timeout > 0)
-                {
-                    _last_blink_rate = _btn_timeout_ms;
-                    _last_blink_hue = hueLime;
-                    //Start the button timeout timer
-                    // iprint(trGAME, " within %d s", _btn_timeout_ms / 1000);
-                    sys_poll_tmr_start(&_btn_timer, _btn_timeout_ms, false); //Start the timer for the button timeout... remember to convert seconds to milliseconds
-                    _blink_update_cnt = 0;
-                    _hue_update_cnt = 0;
-                }
-                _update_cnt = 0;
-                _total_cnt = 0;
-                // iprintln(trGAME, "");
-                _chase_state = _chase_state_read; //Move to the read state to wait for a response
-                // _chase_node_btn = get_node_button_ptr(_chase_node); //Get the button pointer for the node
-                // _chase_node_btn->reaction_ms = 0; //Reset the reaction time for the "Active" node
+                _chase_player_t *p = &_chase_player[i];
+                if ((p->state != _chase_state_read) || (evt->slot != p->node))
+                    continue; //Not this player's node
+
+                //Whoop Whoop! We got a reaction from the node!
+                //iprintln(trGAME, "#Node %d: Button pressed in %d ms (%d)", p->node, evt->value, p->last_hue);
+                game_timer_stop(i);
+                p->hits++;
+                rstats_add(i, evt->slot, evt->value);
+                p->reaction_sum_ms += evt->value;
+                if ((p->reaction_best_ms == 0) || (evt->value < p->reaction_best_ms))
+                    p->reaction_best_ms = evt->value;
+                p->prev_success = true;
+                _chase_next_node(i); //Straight away, rather than on the next tick
+                break;
             }
+            break;
+        }
+        case game_evt_timer:
+        {
+            if ((evt->value >= (uint32_t)_players) || (_chase_player[evt->value].state != _chase_state_read))
+                break;
 
+            _chase_timeout(evt->value);
+            _chase_next_node(evt->value);
             break;
         }
-        case _chase_state_read:
+        case game_evt_node_lost:
         {
-            //We want to read the responses from the active node
-            init_node_msg(_chase_node); //Initialize the node message with the selected node address
-            add_node_msg_get_reaction(_chase_node); //Get the reaction time from the node
-            if (!node_msg_tx_now(_chase_node)) //Send the message to the node
+            //The nodes after the lost one have all moved up a slot
+            for (int i = 0; i < _players; i++)
             {
-                iprintln(trGAME|trALWAYS, "#Error: Could not read node %d", _chase_node);
-                //At this point, the node would have been deregistered, so we need to select a new node
-                _chase_state = _chase_state_set; //Move to the new state to select a new node
-            }
-            else
-            {
-                uint32_t _reaction_ms = get_node_btn_reaction_ms(_chase_node); //Get the reaction time from the node
-                if (_reaction_ms > 0)
+                _chase_player_t *p = &_chase_player[i];
+                if (p->node == ADDR_BROADCAST)
+                    continue;
+                if (evt->slot == p->node)
                 {
-                    //Whoop Whoop! We got a reaction from the node!
-                    //iprintln(trGAME, "#Node %d: Button pressed in %d ms (%d)", _chase_node, _reaction_ms, _last_blink_hue);
-                    _prev_node_success = true;
-                    _chase_state = _chase_state_set; //Move to the new state to select a new node
-                }
-                else if (_btn_timeout_ms != 0)
-                {
-                    if (!sys_poll_tmr_expired(&_btn_timer))
-                    {
-                        uint32_t _remaining_time = _btn_timer.ms_expire - sys_poll_tmr_ms(); //Get the remaining time in milliseconds
-                        if (_remaining_time < _btn_timeout_ms)
-                        {
-                            //We want to re-adjust the blink period of the node to gradually increase the blinking frequency as the time runs out
-                            uint32_t _new_blink_rate = GAME_RANDOM_CHASE_BLINK_PERIOD_MS_MIN + (_remaining_time * (_blink_period - GAME_RANDOM_CHASE_BLINK_PERIOD_MS_MIN)/_btn_timeout_ms); //Calculate the new blink rate based on the remaining time
-                            //iprintln(trGAME|trALWAYS, "#New Blink Rate: %d ms", _new_blink_rate);
-                            //We are also going to make the blink colour hue change gradually from green (120) to red (0) as the time runs out
-                            uint32_t _new_blink_hue = _remaining_time * (hueLime - hueRed) / _btn_timeout_ms; //Calculate the hue based on the remaining time
-
-                            if ((_new_blink_rate != _last_blink_rate) || (_new_blink_hue != _last_blink_hue))
-                            {
-                                init_node_msg(_chase_node); //Initialize the node message with the selected node address
-                                if (_new_blink_rate != _last_blink_rate)
-                                {
-                                    add_node_msg_set_blink(_chase_node, _new_blink_rate); //Set the node to blink no more
-                                    _blink_update_cnt++;
-                                }
-                                if (_new_blink_hue != _last_blink_hue)
-                                {
-                                    add_node_msg_set_rgb(_chase_node, 0, hue2rgb(_new_blink_hue)); //Set the node to blink no more
-                                    add_node_msg_set_rgb(_chase_node, 1, hue2rgb((_new_blink_hue + 180)%360)); //Complimentary colour
-                                    _hue_update_cnt++;
-                                }
-                                _update_cnt++;
-                                //We need to update the blink rate and colour of the node
-                                if (!node_msg_tx_now(_chase_node)) //Send the message to the node
-                                    iprintln(trGAME|trALWAYS, "#Error: Could not adjust blink rate of node %d to %d ms, or hue to %s degrees", _chase_node, _new_blink_rate, _new_blink_hue);
-                                    // iprintln(trGAME|trALWAYS, "#Error: Could not adjust blink rate of node %d to %d ms", _chase_node, _new_blink_rate);
-                                _last_blink_rate = _new_blink_rate;
-                                _last_blink_hue = _new_blink_hue;
-                            }
-                            //else, no need to update the blink rate and colour, as they are already set to the correct values
-                            _chase_state = _chase_state_read; //Move to the new state to select a new node
-                            _total_cnt++;
-                            break;
-
-                        }
-                        //else, this means the "sys_poll_tmr_ms() - _btn_timer.ms_expire" resulted in a negative value, which means the timer has expired?!?!?!?!!?!
-                        iprintln(trGAME|trALWAYS, "#HOW?!?!?!? did the timer expire? (%d ms)", _remaining_time - _btn_timeout_ms);
-                    }
-                    //Reaching this point means that the timer has expired
-                    //iprintln(trGAME|trALWAYS, "#Timer expired (%d ms)", _btn_timeout_ms);
-
-                    //iprintln(trGAME, "#Node %d: Button-press timeout after %d s", _chase_node, _btn_timeout_ms/1000);
-                    init_node_msg(_chase_node); //Initialize the node message with the selected node address
-                    add_node_msg_set_blink(_chase_node, 0); //Set the node to blink no more
-                    add_node_msg_set_rgb(_chase_node, 0, hue2rgb(_last_blink_hue)); //Set the third RGB colour
-                    add_node_msg_set_active(_chase_node, false); //Set the node as inactive
-                    if (!node_msg_tx_now(_chase_node)) //Send the message to the node
-                        iprintln(trGAME|trALWAYS, "#Error: Could not de-activate node %d", _chase_node);
-                    _prev_node_success = false;
-
-                    _chase_state = _chase_state_set; //Move to the new state to select a new node
-                }
-                else
-                {
-                    _chase_state = _chase_state_read; //Move to the read state to wait for a response
+                    game_timer_stop(i);
+                    p->node = ADDR_BROADCAST;
+                    p->state = _chase_state_set; //Select a new node on the next tick
                 }
+                else if (evt->slot < p->node)
+                    p->node--;
             }
             break;
         }
         default:
-        {
-            iprintln(trGAME|trALWAYS, "#Unknown chase state: %d", _chase_state);
             break;
-        }
     }
 }
 
 void game_random_chase_init(bool startup, bool new_game_params)
 {
-    //The 1st thing we need to do is select one of the nodes to activate
+    //The 1st thing we need to do is select one of the nodes to activate for each player
     if (startup)
     {
-        _chase_state = _chase_state_set; // The current state of the chase game
         _blink_period = GAME_RANDOM_CHASE_BLINK_PERIOD_MS_DEF;
         _btn_timeout_ms = ((new_game_params)? _tmp_btn_timeout :  GAME_RANDOM_CHASE_BTN_TIMEOUT_DEF) * 1000; //Convert the timeout to milliseconds
+        _players = (new_game_params)? _tmp_players : GAME_RANDOM_CHASE_PLAYERS_DEF;
+        memset(_chase_player, 0, sizeof(_chase_player));
+        for (int i = 0; i < GAME_RANDOM_CHASE_PLAYERS_MAX; i++)
+        {
+            _chase_player[i].node = ADDR_BROADCAST;
+            _chase_player[i].state = _chase_state_set;
+        }
+        //The targets mostly share their ramp steps, so let those go out as broadcasts
+        nodes_target_bcst_active(true);
         iprintln(trGAME|trALWAYS, "#Starting with a button timeout of %d s", _btn_timeout_ms / 1000);
+        if (_players > 1)
+            iprintln(trGAME|trALWAYS, "#%d players", _players);
     }
     else if (new_game_params)
     {
@@ -283,6 +435,21 @@ void game_random_chase_init(bool startup, bool new_game_params)
         iprintln(trGAME|trALWAYS, "#Changing button timeout to %d s", _btn_timeout_ms / 1000);
 
         //RVN -TODO.... if this changes from a non-zero value to a zero value, we need to stop any blinking that might be happening
+
+        if (_tmp_players != _players)
+        {
+            //The players who are leaving switch their nodes off, the new ones start on the next tick
+            for (int i = _tmp_players; i < _players; i++)
+                _chase_player_off(i);
+            for (int i = _players; i < _tmp_players; i++)
+            {
+                memset(&_chase_player[i], 0, sizeof(_chase_player_t));
+                _chase_player[i].node = ADDR_BROADCAST;
+                _chase_player[i].state = _chase_state_set;
+            }
+            _players = _tmp_players;
+            iprintln(trGAME|trALWAYS, "#Changing to %d players", _players);
+        }
     }
     else
     {
@@ -296,21 +463,20 @@ void game_random_chase_teardown(void)
     //This function is called once to tear down the game.
     //It can be used to free any resources allocated during the game.
     _tmp_btn_timeout = GAME_RANDOM_CHASE_BTN_TIMEOUT_DEF;
-    if (_chase_node < node_count())
+    _tmp_players = GAME_RANDOM_CHASE_PLAYERS_DEF;
+    _chase_score_print();
+    //All the targets (and the rest of the nodes) go off together... only the active ones need a msg of their own
+    if (nodes_reset(NODES_MASK_ALL) < 0)
+        iprintln(trGAME|trALWAYS, "!Could not deactivate all the nodes");
+    for (int i = 0; i < _players; i++)
     {
-        init_node_msg(_chase_node); //Initialize the node message with the selected node address
-        add_node_msg_set_blink(_chase_node, 0); //Set the node to blink
-        add_node_msg_set_rgb(_chase_node, 0, colBlack); //Set the first RGB colour
-        add_node_msg_set_rgb(_chase_node, 1, colBlack); //Set the first RGB colour
-        add_node_msg_set_rgb(_chase_node, 2, colBlack); //Set the first RGB colour
-        add_node_msg_set_active(_chase_node, false); //Set the node as active
-        if (!node_msg_tx_now(_chase_node)) //Send the message to the node
-            iprintln(trGAME|trALWAYS, "#Error: Could not deactivate node (%d)", _chase_node);
+        game_timer_stop(i);
+        _chase_player[i].node = ADDR_BROADCAST;
+        _chase_player[i].state = _chase_state_set;
+        _chase_player[i].prev_success = false; // Was the last node's button successfully pressed?
     }
-    bcst_msg_clear_all();
-    _chase_node = ADDR_BROADCAST; // The address of the node we are chasing
-    _chase_state = _chase_state_set; // The current state of the chase game
-    _prev_node_success = false; // Was the last node's button successfully pressed?
+    nodes_target_bcst_active(false);
+    _players = GAME_RANDOM_CHASE_PLAYERS_DEF;
     _blink_period = GAME_RANDOM_CHASE_BLINK_PERIOD_MS_DEF;
 }
 
@@ -318,6 +484,7 @@ bool game_random_chase_arg_parser(const char **arg_str_array, int arg_cnt, bool
 {
     bool help_requested = false;
     uint32_t value = 0;
+    uint32_t players = GAME_RANDOM_CHASE_PLAYERS_DEF;
     
     const char *arg = *arg_str_array++;
 
@@ -334,6 +501,14 @@ bool game_random_chase_arg_parser(const char **arg_str_array, int arg_cnt, bool
         // break; //from while-loop
     }
 
+    else if (!strcasecmp("score", arg))
+    {
+        _chase_score_print();
+        if (new_game_params != NULL)
+            *new_game_params = false;
+        return true;
+    }
+
     else if ((!strcasecmp("0", arg)) || (!strcasecmp("off", arg)))
     {
         value = 0;
@@ -364,14 +539,29 @@ bool game_random_chase_arg_parser(const char **arg_str_array, int arg_cnt, bool
         // break; //Skip the rest of the arguments... we only cater for 1
     }
 
-    if (arg_cnt > 1)
+    if ((arg_cnt > 1) && (!help_requested))
+    {
+        //The 2nd argument is the number of players
+        arg = *arg_str_array++;
+        if ((!str2uint32(&players, arg, 0)) || (players < 1) || (players > GAME_RANDOM_CHASE_PLAYERS_MAX))
+        {
+            iprintln(trALWAYS, "Invalid number of players (\"%s\"). Options are: 1 to %d", arg, GAME_RANDOM_CHASE_PLAYERS_MAX);
+            help_requested = true;
+        }
+        else if ((int)players >= node_count())
+        {
+            iprintln(trALWAYS, "#%d players, but only %d nodes: some players will have to wait for a node", players, node_count());
+        }
+    }
+
+    if (arg_cnt > 2)
     {
         iprint(trALWAYS, "#Ignoring ");
-        if (arg_cnt > 2)
+        if (arg_cnt > 3)
         {
             iprint(trALWAYS, "the rest of the arguments (");
-            for (int i = 1; i < arg_cnt; i++)
-                iprint(trALWAYS, "%s\"%s\"", (i > 1)? ", " : "", arg_str_array[i-1]);
+            for (int i = 2; i < arg_cnt; i++)
+                iprint(trALWAYS, "%s\"%s\"", (i > 2)? ", " : "", arg_str_array[i-2]);
             iprintln(trALWAYS, ")"); //Print the rest of the arguments
         }
         else
@@ -386,8 +576,9 @@ bool game_random_chase_arg_parser(const char **arg_str_array, int arg_cnt, bool
     {
         uint32_t new_val = MIN(value, GAME_RANDOM_CHASE_BTN_TIMEOUT_MAX);
         if (new_game_params != NULL)
-            *new_game_params = (_tmp_btn_timeout != new_val)? true : false; //Indicate that a new parameters have been set
+            *new_game_params = ((_tmp_btn_timeout != new_val) || (_tmp_players != players))? true : false; //Indicate that a new parameters have been set
         _tmp_btn_timeout = new_val;
+        _tmp_players = players;
     }
 
     if (help_requested)
@@ -398,6 +589,9 @@ bool game_random_chase_arg_parser(const char **arg_str_array, int arg_cnt, bool
         iprintln(trALWAYS, " <timeout>: The period to wait for a btn to be pressed in s (0 to %d)", GAME_RANDOM_CHASE_BTN_TIMEOUT_MAX);
         iprintln(trALWAYS, "        If omitted, a default period of %d s is used", GAME_RANDOM_CHASE_BTN_TIMEOUT_DEF);
         iprintln(trALWAYS, "        If set to 0, the game will wait indefinitely for a button press");
+        iprintln(trALWAYS, " <players>: The number of players chasing their own node at the same time");
+        iprintln(trALWAYS, "        (1 to %d, default %d), each with a colour of its own", GAME_RANDOM_CHASE_PLAYERS_MAX, GAME_RANDOM_CHASE_PLAYERS_DEF);
+        iprintln(trALWAYS, " score: Shows the hits, timeouts and reaction times of each player");
     }
     return true;
 }
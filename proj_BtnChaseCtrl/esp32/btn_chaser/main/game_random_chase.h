@@ -13,6 +13,7 @@ Include file for game_random_chase.c
 includes
 ******************************************************************************/
 #include "defines.h"
+#include "task_game.h"
 
 /******************************************************************************
 Macros
@@ -32,6 +33,7 @@ Global (public) Function prototypes
 ******************************************************************************/
 
 void game_random_chase_main(void);
+void game_random_chase_event(const game_event_t *evt);
 void game_random_chase_init(bool startup, bool new_game_params);
 void game_random_chase_teardown(void);
 bool game_random_chase_arg_parser(const char **arg_str_array, int arg_cnt, bool * new_game_params);
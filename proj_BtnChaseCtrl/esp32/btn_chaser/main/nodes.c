@@ -33,6 +33,8 @@ includes
 #include "esp_chip_info.h"
 #include "esp_flash.h"
 #include "esp_system.h"
+#include "esp_random.h"
+#include "nvs.h"
 
 #include "defines.h"
 #include "sys_utils.h"
@@ -50,6 +52,9 @@ includes
 #undef __NOT_EXTERN__
 
 #include "task_comms.h"
+#include "sys_metrics.h"
+#include "task_game.h"
+#include "sys_telemetry.h"
 
 /*******************************************************************************
 Macros and Constants
@@ -63,9 +68,37 @@ Macros and Constants
 local defines 
  *******************************************************************************/
 
-#define CMD_RESPONSE_TIMEOUT_MS (50LL) // The timeout for a command response in ms
-
-#define MAX_NODE_RETRIES         (3) // The maximum number of retries for a node
+#define CMD_RESPONSE_TIMEOUT_MS (50LL) // The timeout for a command response in ms (until we have measured the node's RTT)
+
+#define NODE_RETRY_BUDGET_MS     (3000LL) // How long we keep on retrying an unanswered msg before the node is deregistered
+
+/* Adaptive response timeout (RTO), in the style of TCP (RFC 6298):
+    SRTT   = SRTT + (RTT - SRTT)/8
+    RTTVAR = RTTVAR + (|RTT - SRTT| - RTTVAR)/4
+    RTO    = SRTT + max(G, 4*RTTVAR)
+  Every retry doubles the timeout (capped at RTO_MAX_MS) and adds a bit of jitter. A node is only
+  given up on once its msg has gone unanswered for NODE_RETRY_BUDGET_MS, however many retries that
+  takes, so a marginal node is waited for rather than dropped mid-game */
+#define RTO_MIN_MS               (20LL)  // The lower limit for the adaptive response timeout
+#define RTO_MAX_MS               (500LL) // The upper limit for the adaptive response timeout (also caps the backoff)
+#define RTO_BACKOFF_SHIFT_MAX    (5)     // Doublings beyond this are capped by RTO_MAX_MS anyway (RTO_MIN_MS << 5 > RTO_MAX_MS)
+#define RTO_GRANULARITY_MS       (10LL)  // We only get to see the responses once every tick
+#define RTT_ALPHA_SHIFT          (3)     // SRTT gain of 1/8
+#define RTT_BETA_SHIFT           (2)     // RTTVAR gain of 1/4
+
+/* The button fields which can be set as a target for a node (see nodes_target_flush()) */
+#define NODE_FIELD_RGB_0         BIT_POS(0)
+#define NODE_FIELD_RGB_1         BIT_POS(1)
+#define NODE_FIELD_RGB_2         BIT_POS(2)
+#define NODE_FIELD_BLINK         BIT_POS(3)
+#define NODE_FIELD_ACTIVE        BIT_POS(4) // Changes are always sent directly (only nodes_apply_state() broadcasts it as well)
+
+#define NODE_FLUSH_BCST_MIN      (2) // The number of nodes needing the same change before we rather broadcast it
+
+/* The node registry (see nodes_register_warm()) is kept in NVS */
+#define NODES_NVS_NAMESPACE      "nodes"
+#define NODES_NVS_KEY            "registry"
+#define NODES_NVS_VERSION        (1) // Bump this if the registry changes (an older one is then ignored)
 
 /*******************************************************************************
  Local structure
@@ -73,10 +106,35 @@ local defines
 typedef struct
 {
     uint8_t     list[RGB_BTN_MAX_NODES+1]; // The response list for the roll-call
+    uint8_t     slot[RGB_BTN_MAX_NODES+1]; // The slot each node reported (CMD_RC_SLOT_NONE if it is not registered)
     int         cnt; // The number of slave nodes
     Timer_ms_t  timer;
 }rollcall_t;
 
+typedef struct
+{
+    uint32_t    pending; // The slots of the nodes which have not answered the reaction poll yet
+    Timer_ms_t  timer; // Running while we are waiting for the last slot of the poll
+}reaction_poll_t;
+
+/* The registered nodes, as saved in NVS (the index is the slot) */
+#pragma pack(push, 1)
+typedef struct
+{
+    uint8_t         address;
+    uint32_t        version;
+    float           time_factor;
+    colour_cal_t    calib;
+}node_reg_entry_t;
+
+typedef struct
+{
+    uint8_t             version; // NODES_NVS_VERSION
+    uint8_t             cnt;
+    node_reg_entry_t    list[RGB_BTN_MAX_NODES];
+}node_registry_t;
+#pragma pack(pop)
+
 typedef struct
 {
     master_command_t cmd;
@@ -89,12 +147,21 @@ typedef struct
 {
     cmd_data_t cmd_data[NODE_CMD_CNT_MAX]; // The commands we are waiting for a response to
     uint8_t cnt; // The number of commands in this command list
-    uint8_t retry_cnt; // The number of times we have retried sending a message to this node
+    uint8_t retry_cnt; // The number of times we have retried sending a message to this node (until NODE_RETRY_BUDGET_MS runs out)
     uint64_t expiry;
     uint32_t exp_rx_len; // The length of the response data we are waiting for 
     uint8_t  exp_rx_cnt; // The number of responses we are waiting for
+    uint8_t  seq; // The sequence number of the msg carrying these commands (resends re-use it, so the node can spot a duplicate)
 }slave_node_cmd_t;
 
+typedef struct
+{
+    uint32_t            rgb_colour[3]; // The colours we want the node to have
+    uint32_t            blink_ms; // The blink period we want the node to have
+    bool                active; // Do we want the node to be active?
+    uint8_t             wanted; // The fields (NODE_FIELD_xxx) a target has been set for
+}node_target_t;
+
 typedef struct
 {
     uint8_t             address; // The address of the node
@@ -104,6 +171,10 @@ typedef struct
     button_t            btn; // The button data for this node
     uint64_t            last_update_time; // The last time we have updated this node's data
     comms_tx_msg_t      msg; // The message we are currently building to send to this node
+    node_link_stats_t   link; // RTT estimates and link quality counters for this node
+    node_target_t       target; // The state the game wants this node to be in
+    uint8_t             known; // The btn fields (NODE_FIELD_xxx) which we know match the node (acknowledged or read back)
+    bool                reindex; // The node moved down a slot (a node below it was lost), but has not been told yet
 }slave_node_t;
 
 typedef struct
@@ -115,12 +186,14 @@ typedef struct
 /*******************************************************************************
  Local function prototypes
  *******************************************************************************/
-/*! \brief Start a roll-call for all nodes.
- * \param all If true, the function will reset the roll-call list and start a new roll-call for all nodes.
+/*! \brief Start a roll-call.
+ * \param type CMD_RC_PAYLOAD_ALL, CMD_RC_PAYLOAD_UNREG or CMD_RC_PAYLOAD_CHECK. For ALL and CHECK all the 
+ * nodes are deregistered here first (a CHECK restores the ones still in their slots afterwards).
+ * \param wait_ms The time the nodes have to respond in
  * This function sends a roll-call command to all nodes and waits for their responses.
  * It is used to discover all (or new) nodes in the network and register them.
  */
-bool _bcst_rollcall(bool all);
+bool _bcst_rollcall(uint8_t type, uint32_t wait_ms);
 
 /*! \brief Wait for the roll-call timer to expire.
  * \param blocking If true, the function will block until the roll-call timer expires.
@@ -136,20 +209,75 @@ void _deregister_node(int node);
 
 bool _add_cmd_to_node_msg(uint8_t node, master_command_t cmd, uint8_t *data, bool restart);
 bool _bcst_append(uint8_t cmd, uint8_t * data);
-void _rollcall_handler(uint8_t addr);
+void _rollcall_handler(uint8_t addr, uint8_t slot);
 
 void _check_all_pending_node_responses(void);
 void _response_handler(int slot, master_command_t resp_cmd, response_code_t resp, uint8_t *resp_data, size_t resp_data_len);
+
+/*! \brief Handles a node's answer to a reaction poll (see nodes_poll_reaction())
+ */
+void _poll_handler(int slot, response_code_t resp, uint8_t *resp_data, size_t resp_data_len);
+
+/*! \brief Follows up on a reaction time read from a node: if it was pressed while active, the press is posted to 
+ * the game and the node (and its targets) is taken as inactive and not blinking, as it did that by itself
+ */
+void _reaction_update(int slot);
 size_t _miso_payload_size(master_command_t cmd, response_code_t resp);
 int _responses_pending(int slot);
 bool _resend_unresponsive_cmds(int slot);
+void _exp_response_add(int slot, master_command_t cmd);
+int _pending_cmd_index(int slot, master_command_t cmd);
+void _pending_cmd_ack(int slot, int index);
 
 uint8_t _register_addr(uint8_t addr);
 
+/*! \brief Registers everyone in the roll-call list and saves the registry
+ */
+void _register_rollcall(void);
+
+/*! \brief Puts a node from the registry back in the next slot, without any msgs (it confirmed it is still there)
+ * \param entry The node, as it was saved
+ */
+void _restore_node(const node_reg_entry_t * entry);
+
+/*! \brief Reads the registry from NVS
+ * \param reg Where to put it
+ * \return True if there is a valid registry
+ */
+bool _registry_load(node_registry_t * reg);
+
+/*! \brief Fills a registry with the nodes currently registered
+ * \param reg Where to put it
+ */
+void _registry_get(node_registry_t * reg);
+
+/*! \brief Saves the currently registered nodes to NVS (if they changed)
+ */
+void _registry_save(void);
+
 uint32_t _inactive_nodes_mask(void);
 
 void * _get_node_btn_data_generic(int slot, master_command_t cmd);
 
+void _link_rtt_update(int slot, uint32_t rtt_ms);
+uint64_t _link_response_timeout(int slot);
+
+void _init_bcst_msg_mask(uint32_t mask);
+
+/*! \brief Tells the nodes which moved down a slot (see _deregister_node()) about their new slot (cmd_set_bitmask_index).
+ * Until then they still act on the bit of their old slot in a masked broadcast, so this is done before every one.
+ * \return false if a node was lost while doing so
+ */
+bool _nodes_reindex(void);
+void _node_view_update(int slot, master_command_t cmd, uint32_t value);
+uint8_t _node_target_dirty(int slot);
+uint32_t _node_target_value(int slot, uint8_t field);
+
+/*! \brief Does the work for nodes_apply_state(), with the option to set the debug LEDs in the same broadcast
+ * \param dbg_led The debug LED state, or -1 to leave it
+ */
+int _nodes_apply_state(uint32_t mask, const node_state_t * state, int dbg_led);
+
 /*******************************************************************************
  Local variables
  *******************************************************************************/
@@ -157,14 +285,36 @@ void * _get_node_btn_data_generic(int slot, master_command_t cmd);
 nodes_t nodes = {0}; // The structure containing all registered nodes
 
 comms_tx_msg_t bcst_msg = {0};
+uint32_t bcst_mask = 0; // The nodes the broadcast msg currently being built is meant for
+bool bcst_active_targets = false; // May nodes_target_flush() broadcast colours and blink to active nodes too?
+const node_state_t node_state_off = {.rgb_colour = {0, 0, 0}, .blink_ms = 0, .active = false}; // Black, not blinking and inactive
 
 rollcall_t rollcall = {0}; // The structure containing information for all who respond on rollcalls
+reaction_poll_t reaction_poll = {0}; // The nodes we are waiting on for a reaction poll
 
 //RVN - Technically I  should maintain a separate stopwatch for each node, but 
 //  holy crap that is adding sooooooooo much more complexity (e.g. a sw is 
 //  started for a node and stopped using a broadcast... or vice versa... 
 // ... Aaaaaaargh! Can open.... worms everywhere!)
 Stopwatch_ms_t sync_stopwatch;
+
+/* The link counters of all the nodes together (the per node values are shown by "link", but are lost when a node is deregistered) */
+struct {
+    uint32_t tx_cnt;
+    uint32_t rx_cnt;
+    uint32_t retries;
+    uint32_t timeouts;
+    metric_hist_t rtt;
+}_nodes_metrics = {.rtt = METRIC_HIST_INIT(2, 5, 10, 20, 50, 100, 200)};
+
+const metric_item_t _nodes_metric_items[] =
+{
+    {"msgs_tx",     NULL,   metric_counter, &_nodes_metrics.tx_cnt},
+    {"responses",   NULL,   metric_counter, &_nodes_metrics.rx_cnt},
+    {"retries",     NULL,   metric_counter, &_nodes_metrics.retries},
+    {"timeouts",    NULL,   metric_counter, &_nodes_metrics.timeouts},
+    {"rtt",         "ms",   metric_hist,    &_nodes_metrics.rtt},
+};
 /*******************************************************************************
  Local (private) Functions
  *******************************************************************************/
@@ -237,23 +387,7 @@ bool _add_cmd_to_node_msg(uint8_t node, master_command_t cmd, uint8_t *data, boo
             memset(nodes.list[node].responses.cmd_data[i].payload.data, 0, sizeof(nodes.list[node].responses.cmd_data[i].payload.data)); //If no data, then just zero the data buffer
         nodes.list[node].responses.cnt++; //Increment the command count for this node
 
-
-        //RVN - TODO. I guess we can calculate how long the response will be and if it might be 
-        //received over several messages, in which case we will need to extend the message timeout
-        uint32_t response_len = _miso_payload_size(cmd, resp_ok);
-        response_len = MIN(response_len, RGB_BTN_MSG_MAX_DATA_LEN) + (2 * sizeof(uint8_t)); //Get the expected response length for this command + 2 bytes for the response code and command ID
-        //iprintln(trNODE, "#Expecting %d bytes for \"%s\" (%d - %d)", response_len, cmd_to_str(cmd), nodes.list[node].responses.exp_rx_len, nodes.list[node].responses.exp_rx_cnt);
-
-        if ((nodes.list[node].responses.exp_rx_len + response_len) > RGB_BTN_MSG_MAX_DATA_LEN)
-        {
-            nodes.list[node].responses.exp_rx_cnt++;
-            iprintln(trNODE, "#Response will span over %d msgs (%d > %d)", nodes.list[node].responses.exp_rx_cnt, nodes.list[node].responses.exp_rx_len + response_len, RGB_BTN_MSG_MAX_DATA_LEN);            
-            nodes.list[node].responses.exp_rx_len = response_len; //Reset the response length to the expected response length
-        }
-        else
-        {
-            nodes.list[node].responses.exp_rx_len += response_len; //Add the expected response length to the total response length
-        }
+        _exp_response_add(node, cmd);
         // nodes.list[node].responses.expiry = (uint64_t)sys_poll_tmr_ms() + CMD_RESPONSE_TIMEOUT_MS;//timeout_ms; //Store the timestamp of when we sent the command
         nodes.list[node].responses.retry_cnt = 0;
         //if we run out of space... well, heck, then we will not wait for that response...
@@ -263,6 +397,26 @@ bool _add_cmd_to_node_msg(uint8_t node, master_command_t cmd, uint8_t *data, boo
     return false; //Failed to append the command
 }
 
+void _exp_response_add(int slot, master_command_t cmd)
+{
+    //RVN - TODO. I guess we can calculate how long the response will be and if it might be 
+    //received over several messages, in which case we will need to extend the message timeout
+    uint32_t response_len = _miso_payload_size(cmd, resp_ok);
+    response_len = MIN(response_len, RGB_BTN_MSG_MAX_DATA_LEN) + (2 * sizeof(uint8_t)); //Get the expected response length for this command + 2 bytes for the response code and command ID
+    //iprintln(trNODE, "#Expecting %d bytes for \"%s\" (%d - %d)", response_len, cmd_to_str(cmd), nodes.list[slot].responses.exp_rx_len, nodes.list[slot].responses.exp_rx_cnt);
+
+    if ((nodes.list[slot].responses.exp_rx_len + response_len) > RGB_BTN_MSG_MAX_DATA_LEN)
+    {
+        nodes.list[slot].responses.exp_rx_cnt++;
+        iprintln(trNODE, "#Response will span over %d msgs (%d > %d)", nodes.list[slot].responses.exp_rx_cnt, nodes.list[slot].responses.exp_rx_len + response_len, RGB_BTN_MSG_MAX_DATA_LEN);            
+        nodes.list[slot].responses.exp_rx_len = response_len; //Reset the response length to the expected response length
+    }
+    else
+    {
+        nodes.list[slot].responses.exp_rx_len += response_len; //Add the expected response length to the total response length
+    }
+}
+
 bool _bcst_append(uint8_t cmd, uint8_t * data)
 {
     //Must be preceeded by a comms_bcst_start() command
@@ -274,7 +428,7 @@ bool _bcst_append(uint8_t cmd, uint8_t * data)
         return false;
     }
 
-    if (cmd >= cmd_set_bitmask_index) //If this is a command that can only be sent to a node, then we cannot append it to the broadcast message
+    if (!cmd_is_bcst(cmd)) //If this is a command that can only be sent to a node, then we cannot append it to the broadcast message
     {
         iprintln(trNODE, "#Cannot append command %s (0x%02X) to broadcast message", cmd_to_str(cmd), cmd);
         return false; //Cannot append this command to the broadcast message
@@ -285,19 +439,85 @@ bool _bcst_append(uint8_t cmd, uint8_t * data)
         // Oooh.... this is a special case, since this command will activate ALL the nodes on the network
     }
 
-    return comms_tx_msg_append(&bcst_msg, ADDR_BROADCAST, cmd, data, cmd_mosi_payload_size(cmd), false);
+    if (!comms_tx_msg_append(&bcst_msg, ADDR_BROADCAST, cmd, data, cmd_mosi_payload_size(cmd), false))
+        return false;
+
+    //Broadcasts are fire-and-forget, so we have to trust that the nodes got it
+    uint32_t value = 0;
+    memcpy(&value, data, MIN(cmd_mosi_payload_size(cmd), sizeof(uint32_t)));
+    for (int i = 0; i < nodes.cnt; i++)
+        if (bcst_mask & BIT_POS(i))
+            _node_view_update(i, cmd, value);
+
+    return true;
+}
+
+void _node_view_update(int slot, master_command_t cmd, uint32_t value)
+{
+    switch (cmd)
+    {
+        case cmd_set_rgb_0:
+        case cmd_set_rgb_1:
+        case cmd_set_rgb_2:
+            nodes.list[slot].btn.rgb_colour[cmd - cmd_set_rgb_0] = (value & 0x00FFFFFF);
+            nodes.list[slot].known |= (NODE_FIELD_RGB_0 << (cmd - cmd_set_rgb_0));
+            break;
+        case cmd_set_blink:
+            nodes.list[slot].btn.blink_ms = value;
+            nodes.list[slot].known |= NODE_FIELD_BLINK;
+            break;
+        case cmd_set_switch:
+            //nodes.list[slot].active is already handled with the response
+            nodes.list[slot].known |= NODE_FIELD_ACTIVE;
+            break;
+        default:
+            break; //Not tracked
+    }
+}
+
+uint32_t _node_target_value(int slot, uint8_t field)
+{
+    switch (field)
+    {
+        case NODE_FIELD_RGB_0:  return nodes.list[slot].target.rgb_colour[0];
+        case NODE_FIELD_RGB_1:  return nodes.list[slot].target.rgb_colour[1];
+        case NODE_FIELD_RGB_2:  return nodes.list[slot].target.rgb_colour[2];
+        case NODE_FIELD_BLINK:  return nodes.list[slot].target.blink_ms;
+        case NODE_FIELD_ACTIVE: return nodes.list[slot].target.active? 1 : 0;
+        default:                return 0;
+    }
+}
+
+uint8_t _node_target_dirty(int slot)
+{
+    uint8_t dirty = 0;
+    slave_node_t *node = &nodes.list[slot];
+
+    for (int i = 0; i < 3; i++)
+        if (node->btn.rgb_colour[i] != node->target.rgb_colour[i])
+            dirty |= (NODE_FIELD_RGB_0 << i);
+    if (node->btn.blink_ms != node->target.blink_ms)
+        dirty |= NODE_FIELD_BLINK;
+    if (node->active != node->target.active)
+        dirty |= NODE_FIELD_ACTIVE;
+
+    //Whatever we are not sure of, we send anyway... but only the fields the game cares about
+    return ((dirty | ~node->known) & node->target.wanted);
 }
 
 bool _resend_unresponsive_cmds(int slot)
 {
     //So now what, do we resend this command?
-    if (nodes.list[slot].responses.retry_cnt >= MAX_NODE_RETRIES) //If we have retried this command more than 3 times, we give up
+    //The budget runs from when the msg was 1st sent (resends do not restart it)
+    if ((sys_poll_tmr_ms() - nodes.list[slot].link.tx_time) >= NODE_RETRY_BUDGET_MS)
         return false; //Give up on this node
 
-    iprintln(trNODE, "#Resending last command to node 0x%02X (%d)", nodes.list[slot].address, slot);
+    iprintln(trNODE, "#Resending %d unanswered cmd(s) to node 0x%02X (%d), seq %d", nodes.list[slot].responses.cnt, nodes.list[slot].address, slot, nodes.list[slot].responses.seq);
 
-    //Resend the command
+    //Resend the command(s)... only those we have not had a response for are still in the list.
     nodes.list[slot].responses.retry_cnt++; //Increment the retry count
+    nodes.list[slot].responses.exp_rx_len = 0; //The response will (probably) be shorter this time round
+    nodes.list[slot].responses.exp_rx_cnt = 1;
     comms_tx_msg_init(&nodes.list[slot].msg, nodes.list[slot].address); //Initialize the message for this node
     //init_node_msg((uint8_t)slot, false);
     for (int i = 0; i < nodes.list[slot].responses.cnt; i++)
@@ -306,19 +526,68 @@ bool _resend_unresponsive_cmds(int slot)
         if (!comms_tx_msg_append(&nodes.list[slot].msg, nodes.list[slot].address, cmd_data->cmd, &cmd_data->payload.data[0], cmd_mosi_payload_size(cmd_data->cmd), false))
         {
             //RVN - TODO - Not liking how I am handling this failure... but what the heck am I supposed to do... another retry counter for this as well?
-            iprintln(trNODE, "#Error: Could not reload \"%s\" (%d bytes) to node %d (0x%02X) during resend", cmd_to_str(cmd_data->cmd), cmd_mosi_payload_size(cmd_data->cmd), slot, nodes.list[slot].address);
+            iprintln(trNODE, "!Could not reload \"%s\" (%d bytes) to node %d (0x%02X) during resend", cmd_to_str(cmd_data->cmd), cmd_mosi_payload_size(cmd_data->cmd), slot, nodes.list[slot].address);
             return false; //Failed to append the command, so we cannot resend it
         }
+        _exp_response_add(slot, cmd_data->cmd);
     }
-    comms_tx_msg_send(&nodes.list[slot].msg); //Send the message immediately
-    nodes.list[slot].responses.expiry = sys_poll_tmr_ms() + CMD_RESPONSE_TIMEOUT_MS;
+    //Same seq as the original msg: if the node did get it the 1st time round, it will replay its 
+    // responses iso executing the commands again
+    comms_tx_msg_send_seq(&nodes.list[slot].msg, nodes.list[slot].responses.seq); //Send the message immediately
+    nodes.list[slot].link.tx_cnt++;
+    nodes.list[slot].link.retries++;
+    _nodes_metrics.tx_cnt++;
+    _nodes_metrics.retries++;
+    //Back off... a marginal node is given more time with every retry
+    nodes.list[slot].responses.expiry = sys_poll_tmr_ms() + _link_response_timeout(slot);
     return true; //Command resent successfully
 }
 
-void _rollcall_handler(uint8_t addr)
+void _link_rtt_update(int slot, uint32_t rtt_ms)
+{
+    node_link_stats_t *link = &nodes.list[slot].link;
+
+    if (link->rtt_samples == 0)
+    {
+        //First sample: SRTT = RTT, RTTVAR = RTT/2
+        link->srtt_x8 = rtt_ms << RTT_ALPHA_SHIFT;
+        link->rttvar_x4 = (rtt_ms << RTT_BETA_SHIFT) / 2;
+    }
+    else
+    {
+        int32_t err = (int32_t)rtt_ms - (int32_t)(link->srtt_x8 >> RTT_ALPHA_SHIFT);
+        link->srtt_x8 = (uint32_t)((int32_t)link->srtt_x8 + err); //SRTT += err/8
+        link->rttvar_x4 = (uint32_t)((int32_t)link->rttvar_x4 + abs(err) - (int32_t)(link->rttvar_x4 >> RTT_BETA_SHIFT)); //RTTVAR += (|err| - RTTVAR)/4
+    }
+    link->rtt_samples++;
+    link->rtt_last_ms = rtt_ms;
+    metric_hist_add(&_nodes_metrics.rtt, rtt_ms);
+    tlm_send(tlm_rtt, slot, nodes.list[slot].address, rtt_ms);
+
+    //The scaled RTTVAR is already 4*RTTVAR
+    uint32_t rto = (link->srtt_x8 >> RTT_ALPHA_SHIFT) + max((uint32_t)RTO_GRANULARITY_MS, link->rttvar_x4);
+    link->rto_ms = constrain(rto, (uint32_t)RTO_MIN_MS, (uint32_t)RTO_MAX_MS);
+}
+
+uint64_t _link_response_timeout(int slot)
 {
-    //if we are not busy waiting for a roll-call response, then we can just ignore this
-    if (!sys_poll_tmr_is_running(&rollcall.timer))
+    uint64_t rto = (nodes.list[slot].link.rto_ms > 0)? nodes.list[slot].link.rto_ms : CMD_RESPONSE_TIMEOUT_MS;
+
+    //Exponential backoff on every retry, but within reason
+    rto = min(rto << min(nodes.list[slot].responses.retry_cnt, RTO_BACKOFF_SHIFT_MAX), (uint64_t)RTO_MAX_MS);
+
+    //Jitter (up to 25%) so that our retries do not line up with whatever upset the previous attempt
+    if (nodes.list[slot].responses.retry_cnt > 0)
+        rto += esp_random() % ((rto / 4) + 1);
+
+    //Responses spanning several msgs take proportionally longer
+    return rto * max(1, nodes.list[slot].responses.exp_rx_cnt);
+}
+
+void _rollcall_handler(uint8_t addr, uint8_t slot)
+{
+    //if we are not busy with a roll-call, then we can just ignore this (the timer is only stopped once all the answers are read)
+    if (!sys_poll_tmr_started(&rollcall.timer))
         return;
 
     //Add this address to the response list
@@ -349,6 +618,8 @@ void _rollcall_handler(uint8_t addr)
         if (rollcall.list[i] == 0) 
         {
             int cnt = _add_rc_address(addr);
+            if (rollcall.list[i] == addr)
+                rollcall.slot[i] = slot;
             iprintln(trNODE, "#Got RC Reply #%d from 0x%02X (%d)", cnt, addr, i);
             return; //We found a slot, no need to continue
         }
@@ -369,14 +640,9 @@ size_t _miso_payload_size(master_command_t cmd, response_code_t resp)
         return 0; //Nothing 
 
     //means the response is OK, so we need to return the payload size based on the command
-    for (int i = 0; i < ARRAY_SIZE(cmd_table); i++)
-    {
-        if (cmd_table[i].cmd == cmd)
-        {
-            //Found the command, so return the payload size
-            return cmd_table[i].miso_sz;
-        }
-    }
+    if (cmd_is_known(cmd))
+        return cmd_miso_sz(cmd);
+
     return (size_t)-1; //the remainder of data in the message (minus the 2 bytes for the response code and command)
 }
 
@@ -385,6 +651,8 @@ void _deregister_node(int node)
     if (!is_node_valid(node))
         return; //No button registered at this slot
 
+    game_event_post(game_evt_node_lost, node, nodes.list[node].address);
+
     //Is this the last node we are deregistering?
     int last_node_index = node_count() - 1; //Get the last node index
     if (node < last_node_index)
@@ -393,6 +661,14 @@ void _deregister_node(int node)
     memset(&nodes.list[last_node_index], 0, sizeof(slave_node_t)); //Reset the rest of the node list
     nodes.cnt--; //Decrement the node count
 
+    //The nodes above the gap have moved down a slot, but they only find out with the next masked broadcast (we 
+    // could be deep inside another node's transaction here). Whatever broadcast they got, is not known for sure either.
+    for (int i = node; i < nodes.cnt; i++)
+    {
+        nodes.list[i].reindex = true;
+        nodes.list[i].known = 0;
+    }
+
     iprintln(trNODE, "#Deregistered node %d (0x%02X) - %d Nodes remain:", node, nodes.list[node].address, nodes.cnt);
     for (int i = 0; i < nodes.cnt; i++)
     {
@@ -414,9 +690,12 @@ void _check_all_pending_node_responses(void)
         if (nodes.list[node].responses.expiry > sys_poll_tmr_ms())
             continue; //No timeout (yet)
 
+        nodes.list[node].link.timeouts++;
+        _nodes_metrics.timeouts++;
+
         if (!_resend_unresponsive_cmds(node))
         {
-            iprintln(trNODE, "# %d failed retries for node %d (0x%02X), %d cmds:", nodes.list[node].responses.retry_cnt, node, nodes.list[node].address, nodes.list[node].responses.cnt);
+            iprintln(trNODE, "# %d failed retries (%d ms) for node %d (0x%02X), %d cmds:", nodes.list[node].responses.retry_cnt, (int)(sys_poll_tmr_ms() - nodes.list[node].link.tx_time), node, nodes.list[node].address, nodes.list[node].responses.cnt);
             for (int j = 0; j < nodes.list[node].responses.cnt; j++)
                 iprintln(trNODE, "#   %d - \"%s\" (%d bytes)", j+1, 
                     cmd_to_str(nodes.list[node].responses.cmd_data[j].cmd), 
@@ -468,22 +747,22 @@ void _response_handler(int slot, master_command_t resp_cmd, response_code_t resp
     if (_pending_responses == 0)
         return; //No pending responses for this node, so we can return
 
-    //We should be getting the responses in the same order as we sent the commands
-
-    master_command_t waiting_tx_cmd = nodes.list[slot].responses.cmd_data[0].cmd;
-    cmd_payload_u *waiting_tx_data = &nodes.list[slot].responses.cmd_data[0].payload; //Get the data that was sent with the command
-
-    if (resp_cmd != waiting_tx_cmd)
+    //We should be getting the responses in the same order as we sent the commands, but after a resend we 
+    // could still get (late) responses to commands that have been ticked off already
+    int cmd_index = _pending_cmd_index(slot, resp_cmd);
+    if (cmd_index < 0)
     {
         //Oops... this is not right?!?!?!
-        iprintln(trNODE, "#Error: Node %d (0x%02X) sent response (0x%02X) for \"%s\" iso \"%s\"", slot, get_node_addr(slot), resp, cmd_to_str(resp_cmd), cmd_to_str(waiting_tx_cmd));
+        iprintln(trNODE, "!Node %d (0x%02X) sent response (0x%02X) for \"%s\" iso \"%s\"", slot, get_node_addr(slot), resp, cmd_to_str(resp_cmd), cmd_to_str(nodes.list[slot].responses.cmd_data[0].cmd));
         return; //Skip this response, we can't handle it
     }
 
+    cmd_payload_u *waiting_tx_data = &nodes.list[slot].responses.cmd_data[cmd_index].payload; //Get the data that was sent with the command
+
     if (resp != resp_ok)
     {
         //We got an error response, so we can handle it
-        //iprintln(trNODE, "#Node %d (0x%02X) sent error response (0x%02X) for \"%s\"", slot, get_node_addr(slot), resp, cmd_to_str(resp_cmd));
+        iprintln(trNODE, "#Node %d (0x%02X) sent error response (0x%02X) for \"%s\"", slot, get_node_addr(slot), resp, cmd_to_str(resp_cmd));
         if (resp_data_len > 0)
         {
             iprint(trNODE, "# Additional data: ");
@@ -491,12 +770,24 @@ void _response_handler(int slot, master_command_t resp_cmd, response_code_t resp
                 iprintf("%02X ", resp_data[i]);
             iprintln(trNODE, "");
         }
+        //The node did get the command, so resending it will not change the outcome
+        _pending_cmd_ack(slot, cmd_index);
         return; //Skip this response, we can't handle it
     }
     //else (_resp == resp_ok)
 
+    if (resp_cmd == cmd_get_link)
+    {
+        //The node clears its counters once read, so we keep the running total
+        link_stats_t _node_link = {0};
+        memcpy(&_node_link, resp_data, MIN(resp_data_len, sizeof(link_stats_t)));
+        nodes.list[slot].link.node_crc_err += _node_link.crc_err;
+        nodes.list[slot].link.node_echo_err += _node_link.echo_err;
+        nodes.list[slot].link.node_tx_retries += _node_link.tx_retries;
+        nodes.list[slot].link.node_tx_abandoned += _node_link.tx_abandoned;
+    }
     //If this was a response to a read command, then we want to "save" the data returned from the node
-    if (resp_data_len > 0) //Only GET's will have a response data length greater than 0
+    else if (resp_data_len > 0) //Only GET's will have a response data length greater than 0
     {
         unsigned int member_offset = 0;
         switch (resp_cmd)
@@ -511,6 +802,7 @@ void _response_handler(int slot, master_command_t resp_cmd, response_code_t resp
             case cmd_get_time:      member_offset = offsetof(button_t, time_ms);            break;
             case cmd_get_sync:      member_offset = offsetof(button_t, time_factor);        break;
             case cmd_get_version:   member_offset = offsetof(button_t, version);            break;
+            case cmd_get_calib:     member_offset = offsetof(button_t, calib);              break;
             default:
                 //We don't have any data to save for these commands
                 return; //Skip this response, we can't handle it
@@ -522,6 +814,10 @@ void _response_handler(int slot, master_command_t resp_cmd, response_code_t resp
         //Update the button member with the new value
         memcpy(((uint8_t *)&nodes.list[slot].btn) + (size_t)member_offset, (void *)resp_data, resp_data_len);
         nodes.list[slot].last_update_time = sys_poll_tmr_ms(); //Update the last update time for this node
+        if ((resp_cmd >= cmd_get_rgb_0) && (resp_cmd <= cmd_get_rgb_2))
+            nodes.list[slot].known |= (NODE_FIELD_RGB_0 << (resp_cmd - cmd_get_rgb_0));
+        else if (resp_cmd == cmd_get_blink)
+            nodes.list[slot].known |= NODE_FIELD_BLINK;
 
         //RVN - TODO - Maybe we should maintain a timestamp for every field?
     }
@@ -535,52 +831,109 @@ void _response_handler(int slot, master_command_t resp_cmd, response_code_t resp
         nodes.list[slot].active = (waiting_tx_data->u8_val == CMD_SW_PAYLOAD_ACTIVATE); //Set the active state of the node based on the response data
         //iprintln(trNODE, "#Node %d (0x%02X) is now %s", slot, nodes.list[slot].address, (nodes.list[slot].active) ? "active" : "deactivated");
     }
+    if (resp_cmd == cmd_set_calib)
+    {
+        //The node saved the calibration we sent it, so that is now what it has
+        memcpy(&nodes.list[slot].btn.calib, waiting_tx_data->data, sizeof(colour_cal_t));
+        _registry_save();
+    }
     if (resp_cmd == cmd_get_reaction)
+        _reaction_update(slot);
+
+
+    //The node now has what we sent it
+    _node_view_update(slot, resp_cmd, waiting_tx_data->u32_val);
+
+    //We got an OK response, so we can drop that command from the list
+    _pending_cmd_ack(slot, cmd_index);
+}
+
+void _poll_handler(int slot, response_code_t resp, uint8_t *resp_data, size_t resp_data_len)
+{
+    //A late answer (after the poll has timed out) is left to the direct read the game falls back on
+    if ((!sys_poll_tmr_is_running(&reaction_poll.timer)) || (!(reaction_poll.pending & BIT_POS(slot))))
+        return;
+
+    if ((resp != resp_ok) || (resp_data_len < sizeof(uint32_t)))
     {
-        //If the slot "was" active and the button read returned a positive reaction time, then we can assume that the button is not active anymore
-        if ((nodes.list[slot].btn.reaction_ms != 0) && (nodes.list[slot].active)) //If the reaction time is not zero and the node was active
-        {
-            nodes.list[slot].active = false; //Set the node to inactive
-            //iprintln(trNODE, "#Node %d (0x%02X) deactivated itself", slot, nodes.list[slot].address);
-        }
+        iprintln(trNODE, "#Node %d (0x%02X) answered the reaction poll with error %d", slot, nodes.list[slot].address, resp);
+        return;
+    }
+
+    reaction_poll.pending &= ~BIT_POS(slot);
+    memcpy(&nodes.list[slot].btn.reaction_ms, resp_data, sizeof(uint32_t));
+    nodes.list[slot].last_update_time = sys_poll_tmr_ms();
+    _reaction_update(slot);
+}
 
+void _reaction_update(int slot)
+{
+    //If the slot "was" active and the button read returned a positive reaction time, then we can assume that the button is not active anymore
+    if ((nodes.list[slot].btn.reaction_ms != 0) && (nodes.list[slot].active)) //If the reaction time is not zero and the node was active
+    {
+        tlm_send(tlm_reaction, slot, nodes.list[slot].address, nodes.list[slot].btn.reaction_ms);
+        game_event_post(game_evt_press, slot, nodes.list[slot].btn.reaction_ms);
+        nodes.list[slot].active = false; //Set the node to inactive
+        //The node also stopped blinking and is showing its 3rd colour now, so the primary colour has to be sent again to be seen
+        nodes.list[slot].btn.blink_ms = 0;
+        nodes.list[slot].known |= (NODE_FIELD_ACTIVE | NODE_FIELD_BLINK);
+        nodes.list[slot].known &= ~NODE_FIELD_RGB_0;
+        //The node did this by itself, so the targets follow suit (otherwise the next flush would undo it)
+        nodes.list[slot].target.active = false;
+        nodes.list[slot].target.blink_ms = 0;
+        //iprintln(trNODE, "#Node %d (0x%02X) deactivated itself", slot, nodes.list[slot].address);
     }
+}
 
+int _pending_cmd_index(int slot, master_command_t cmd)
+{
+    //The 1st pending entry for this command (the same command could be in the list more than once)
+    for (int i = 0; i < nodes.list[slot].responses.cnt; i++)
+        if (nodes.list[slot].responses.cmd_data[i].cmd == cmd)
+            return i;
 
-    //We got an OK response, so we can drop that command from the list
+    return -1; //Not waiting on a response for this command
+}
+
+void _pending_cmd_ack(int slot, int index)
+{
+    if ((index < 0) || (index >= nodes.list[slot].responses.cnt))
+        return;
 
-    if (nodes.list[slot].responses.cnt > 1)//Delete the entry at index 0 and move the rest of the entries down
-        memmove(&nodes.list[slot].responses.cmd_data[0], &nodes.list[slot].responses.cmd_data[1], (nodes.list[slot].responses.cnt - 1) * sizeof(cmd_data_t));
+    if (index < (nodes.list[slot].responses.cnt - 1))//Delete the entry at index and move the rest of the entries down
+        memmove(&nodes.list[slot].responses.cmd_data[index], &nodes.list[slot].responses.cmd_data[index + 1], (nodes.list[slot].responses.cnt - 1 - index) * sizeof(cmd_data_t));
 
     memset(&nodes.list[slot].responses.cmd_data[nodes.list[slot].responses.cnt - 1], 0, sizeof(cmd_data_t)); //Reset the last entry
 
     nodes.list[slot].responses.cnt--;
     if (nodes.list[slot].responses.cnt == 0)
     {
+        //Only sample the RTT if the msg was not resent (Karn's algorithm), otherwise we cannot tell which attempt got the response.
+        // A response spanning several msgs also includes the node's gaps between them, so that is no RTT sample either
+        if ((nodes.list[slot].responses.retry_cnt == 0) && (nodes.list[slot].responses.exp_rx_cnt <= 1))
+            _link_rtt_update(slot, (uint32_t)(sys_poll_tmr_ms() - nodes.list[slot].link.tx_time));
         nodes.list[slot].responses.retry_cnt = 0; //Reset the retry count
         nodes.list[slot].responses.expiry = 0; //Reset the expiry time
     }
 }
 
-bool _bcst_rollcall(bool all)
+bool _bcst_rollcall(uint8_t type, uint32_t wait_ms)
 {
-    uint8_t data = 0xFF;
+    memset(&rollcall, 0, sizeof(rollcall_t)); //Reset the roll-call list
 
-    if (all)
+    if (type != CMD_RC_PAYLOAD_UNREG)
     {
-        data = 0x00; //If we are doing a roll-call for all nodes, we set the data to 0x00
-        memset(&rollcall, 0, sizeof(rollcall_t)); //Reset the roll-call list
         memset(nodes.list, 0, sizeof(nodes.list)); //Reset all buttons to unregistered state
         nodes.cnt = 0; //Reset the node count
     }
 
-    if (comms_tx_msg_append(&bcst_msg, ADDR_BROADCAST, cmd_roll_call, &data, sizeof(uint8_t), true))
+    if (comms_tx_msg_append(&bcst_msg, ADDR_BROADCAST, cmd_roll_call, &type, sizeof(uint8_t), true))
     {
         //This is all that is needed... this command can be sent immediately
         if (comms_tx_msg_send(&bcst_msg))
         {
             //The maximum time we could afford to wait for a response.
-            sys_poll_tmr_start(&rollcall.timer, ROLL_CALL_TIMOUT_MS(ADDR_BROADCAST, ADDR_BROADCAST) + BUS_SILENCE_MIN_MS, false);
+            sys_poll_tmr_start(&rollcall.timer, wait_ms + BUS_SILENCE_MIN_MS, false);
             return true;
         }
     }
@@ -606,6 +959,7 @@ void * _get_node_btn_data_generic(int slot, master_command_t cmd)
         case cmd_get_time:      member_offset = offsetof(button_t, time_ms);            break;
         case cmd_get_sync:      member_offset = offsetof(button_t, time_factor);        break;
         case cmd_get_version:   member_offset = offsetof(button_t, version);            break;
+        case cmd_get_calib:     member_offset = offsetof(button_t, calib);              break;
         default:
             //We don't have any data to save for these commands
             return NULL; //Skip this response, we can't handle it
@@ -654,23 +1008,108 @@ uint8_t _register_addr(uint8_t addr)
     //LEt's assume this is going to be all good
     memset(&nodes.list[nodes.cnt], 0, sizeof(slave_node_t)); //Reset the slot to zero
     nodes.list[nodes.cnt].address = addr; //Set the address of this node
+    //Start at a random seq, so that a node which remembers our last msg (e.g. if we were reset) does not take our 1st msg for a resend
+    nodes.list[nodes.cnt].responses.seq = (uint8_t)esp_random();
     nodes.cnt++; //Increment the node count
 
     init_node_msg(slot_index); //Initialize the message for this node
-    if (add_node_msg_register(slot_index))
+    //The node uploads its colour calibration (from its NV store) along with the registration
+    if ((add_node_msg_register(slot_index)) && (add_node_msg_get_calib(slot_index)))
     {
         if (node_msg_tx_now(slot_index))
         {
             //iprintln(trNODE, "#Registered 0x%02X @ %d (%d/%d nodes)", nodes.list[slot_index].address, slot_index, nodes.cnt, rollcall.cnt);
+            game_event_post(game_evt_node_joined, slot_index, addr);
             return addr; //Continue to the next address
         }
     }
-    memset(&nodes.list[slot_index], 0, sizeof(slave_node_t)); //Reset the slot to zero
-    nodes.cnt--; //Decrement the node count... this registration failed
+    //If we ran out of retries, the node has already been de-registered
+    if (nodes.list[slot_index].address == addr)
+    {
+        memset(&nodes.list[slot_index], 0, sizeof(slave_node_t)); //Reset the slot to zero
+        nodes.cnt--; //Decrement the node count... this registration failed
+    }
     iprintln(trNODE|trALWAYS, "#Registration failed for 0x%02X @ %d (%d/%d nodes)", addr, slot_index, nodes.cnt, rollcall.cnt);
     return 0x00;
 }
 
+void _register_rollcall(void)
+{
+    for (int i = 0; i < rollcall.cnt; i++)
+    {
+        if (_register_addr(rollcall.list[i]) != rollcall.list[i])
+            iprintln(trNODE|trALWAYS, "#Failed to register node 0x%02X", rollcall.list[i]);
+    }
+    iprintln(trNODE, "#Registered %d/%d nodes", node_count(), rollcall.cnt);
+    _registry_save();
+}
+
+void _restore_node(const node_reg_entry_t * entry)
+{
+    int slot = nodes.cnt;
+
+    memset(&nodes.list[slot], 0, sizeof(slave_node_t));
+    nodes.list[slot].address = entry->address;
+    nodes.list[slot].responses.seq = (uint8_t)esp_random(); //As for _register_addr()
+    nodes.list[slot].btn.version = entry->version;
+    nodes.list[slot].btn.time_factor = entry->time_factor;
+    memcpy(&nodes.list[slot].btn.calib, &entry->calib, sizeof(colour_cal_t));
+    nodes.cnt++;
+
+    game_event_post(game_evt_node_joined, slot, entry->address);
+}
+
+bool _registry_load(node_registry_t * reg)
+{
+    nvs_handle_t nvs;
+    size_t len = sizeof(node_registry_t);
+    bool ok = false;
+
+    if (nvs_open(NODES_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+        return false; //Nothing saved yet (or NVS is not available)
+
+    if (nvs_get_blob(nvs, NODES_NVS_KEY, reg, &len) == ESP_OK)
+        ok = ((len == sizeof(node_registry_t)) && (reg->version == NODES_NVS_VERSION) && (reg->cnt <= RGB_BTN_MAX_NODES));
+    nvs_close(nvs);
+    return ok;
+}
+
+void _registry_get(node_registry_t * reg)
+{
+    memset(reg, 0, sizeof(node_registry_t));
+    reg->version = NODES_NVS_VERSION;
+    reg->cnt = (uint8_t)nodes.cnt;
+    for (int i = 0; i < nodes.cnt; i++)
+    {
+        reg->list[i].address = nodes.list[i].address;
+        reg->list[i].version = nodes.list[i].btn.version;
+        reg->list[i].time_factor = nodes.list[i].btn.time_factor;
+        memcpy(&reg->list[i].calib, &nodes.list[i].btn.calib, sizeof(colour_cal_t));
+    }
+}
+
+void _registry_save(void)
+{
+    node_registry_t reg;
+    node_registry_t saved;
+    nvs_handle_t nvs;
+
+    _registry_get(&reg);
+
+    //Most registrations find the same nodes as before, so spare the flash
+    if ((_registry_load(&saved)) && (memcmp(&reg, &saved, sizeof(node_registry_t)) == 0))
+        return;
+
+    if (nvs_open(NODES_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK)
+    {
+        iprintln(trNODE|trALWAYS, "!Could not open the node registry");
+        return;
+    }
+    if ((nvs_set_blob(nvs, NODES_NVS_KEY, &reg, sizeof(node_registry_t)) != ESP_OK) || (nvs_commit(nvs) != ESP_OK))
+        iprintln(trNODE|trALWAYS, "!Could not save the node registry");
+    nvs_close(nvs);
+}
+
 int node_count(void)
 {
     return nodes.cnt;
@@ -702,15 +1141,29 @@ void init_node_msg(uint8_t node/*, bool reset_response_data*/)
 
 bool node_msg_tx_now(uint8_t node)
 {
+    comms_stats_t _bus_stats;
+    uint32_t _crc_err_start;
+    uint8_t _node_addr;
+
     if (!is_node_valid(node))
         return false;
 
-    //We should only set the expiry time for the message at this point...
-    nodes.list[node].responses.expiry = (uint64_t)sys_poll_tmr_ms() + (nodes.list[node].responses.exp_rx_cnt * CMD_RESPONSE_TIMEOUT_MS);
+    _node_addr = nodes.list[node].address;
+    comms_stats_get(&_bus_stats, false);
+    _crc_err_start = _bus_stats.crc_err;
 
-    if (!comms_tx_msg_send(&nodes.list[node].msg)) //Send the message immediately
+    //We should only set the expiry time for the message at this point...
+    nodes.list[node].link.tx_time = sys_poll_tmr_ms();
+    nodes.list[node].responses.expiry = nodes.list[node].link.tx_time + _link_response_timeout(node);
+    nodes.list[node].link.tx_cnt++;
+    _nodes_metrics.tx_cnt++;
+
+    //Every new msg to a node gets the next seq for that node, only resends re-use a seq
+    nodes.list[node].responses.seq++;
+    if (!comms_tx_msg_send_seq(&nodes.list[node].msg, nodes.list[node].responses.seq)) //Send the message immediately
     {
-        iprintln(trNODE, "#Error: Could not send message to node %d (0x%02X)", node, nodes.list[node].address);
+        iprintln(trNODE, "!Could not send message to node %d (0x%02X)", node, nodes.list[node].address);
+        game_event_post(game_evt_txn_done, node, false);
         return false; //Failed to send the message
     }
 
@@ -722,10 +1175,23 @@ bool node_msg_tx_now(uint8_t node)
     {
         //Just wait here... and keep on processing the responses... the response handler will do retries on timeouts
         node_parse_rx_msg(); //Process any received messages, this will also update the nodes.list[x].btn fields with the responses
-        //if a timeout occurs after all the retries, the node will be de-registered and the while loop will exit
+        //if the node stays silent for NODE_RETRY_BUDGET_MS (however many retries that takes), it will be de-registered and the while loop will exit
         vTaskDelay(1); //Wait a bit before checking again
     }
 
+    //If the node was de-registered, this slot now belongs to another node (if any)
+    if (nodes.list[node].address != _node_addr)
+    {
+        game_event_post(game_evt_txn_done, node, false);
+        return false;
+    }
+
+    //We are the only master on the bus, so any corrupted msgs in the meantime would have been this node's responses
+    comms_stats_get(&_bus_stats, false);
+    if (_bus_stats.crc_err > _crc_err_start)
+        nodes.list[node].link.crc_err += (_bus_stats.crc_err - _crc_err_start);
+
+    game_event_post(game_evt_txn_done, node, true);
     return true; //Response received
 }
 
@@ -759,16 +1225,6 @@ bool add_node_msg_new_addr(uint8_t node, uint8_t new_addr)
      return _add_cmd_to_node_msg(node, cmd_new_add, &new_addr, true);
 }
 
-// bool is_direct_node_cmd(master_command_t cmd)
-// {
-//     //Check if the command can be broadcast
-//     for (int i = 0; i < ARRAY_SIZE(cmd_table); i++)
-//         if (cmd_table[i].cmd == cmd)//Found the command, so return true if it can be broadcast
-//             return ((cmd_table[i].access_flags & CMD_TYPE_DIRECT) == CMD_TYPE_DIRECT)? true : false;
-
-//     return false; //Command not found
-// }
-
 bool add_node_msg_set_rgb(uint8_t node, uint8_t index, uint32_t rgb_col)
 {
     if (index > 2)
@@ -856,78 +1312,83 @@ bool add_node_msg_get_version(uint8_t node)
     return _add_cmd_to_node_msg(node, cmd_get_version, NULL, false);
 }
 
+bool add_node_msg_get_link(uint8_t node)
+{
+    return _add_cmd_to_node_msg(node, cmd_get_link, NULL, false);
+}
+
+bool add_node_msg_set_calib(uint8_t node, const colour_cal_t * cal)
+{
+    return _add_cmd_to_node_msg(node, cmd_set_calib, (uint8_t *)cal, false);
+}
+
+bool add_node_msg_get_calib(uint8_t node)
+{
+    return _add_cmd_to_node_msg(node, cmd_get_calib, NULL, false);
+}
+
 size_t cmd_mosi_payload_size(master_command_t cmd)
 {
-    //means the response is OK, so we need to return the payload size based on the command
-    for (int i = 0; i < ARRAY_SIZE(cmd_table); i++)
-    {
-        if (cmd_table[i].cmd == cmd)
-        {
-            //Found the command, so return the payload size
-            return cmd_table[i].mosi_sz;
-        }
-    }
-    return 0; //the remainder of data in the message (minus the 2 bytes for the response code and command)
+    return cmd_mosi_sz(cmd); //0 if the command is not known
 }
 
 const char * cmd_to_str(master_command_t cmd)
 {
-    switch (cmd)
+    const char * name = cmd_name_table[(uint8_t)cmd];
+    return (name != NULL)? name : "unknown";
+}
+
+bool _nodes_reindex(void)
+{
+    int _cnt = nodes.cnt;
+    bool moved = false;
+
+    for (int i = 0; i < nodes.cnt; i++)
     {
-        case cmd_none:                  return "none";
-        case cmd_roll_call:             return "roll_call";
-        case cmd_set_bitmask_index:     return "set_bitmask_index";
-        case cmd_bcast_address_mask:    return "bcast_address_mask";
-        case cmd_set_rgb_0:             return "set_rgb_0";
-        case cmd_set_rgb_1:             return "set_rgb_1";
-        case cmd_set_rgb_2:             return "set_rgb_2";
-        case cmd_set_blink:             return "set_blink";
-        case cmd_set_switch:            return "set_switch";
-        case cmd_set_dbg_led:           return "set_dbg_led";
-        case cmd_set_time:              return "set_time";
-        case cmd_set_sync:              return "set_sync";
-        case cmd_new_add:               return "new_add";
-        case cmd_get_rgb_0:             return "get_rgb_0";
-        case cmd_get_rgb_1:             return "get_rgb_1";
-        case cmd_get_rgb_2:             return "get_rgb_2";
-        case cmd_get_blink:             return "get_blink";
-        case cmd_get_reaction:          return "get_sw_time";
-        case cmd_get_flags:             return "get_flags";
-        case cmd_get_dbg_led:           return "get_dbg_led";
-        case cmd_get_time:              return "get_time";
-        case cmd_get_sync:              return "get_sync";
-        case cmd_get_version:           return "get_version";
-#if REMOTE_CONSOLE_SUPPORTED == 1    
-        case cmd_wr_console_cont:       return "wr_console_cont";
-        case cmd_wr_console_done:       return "wr_console_done";
-#endif /* REMOTE_CONSOLE_SUPPORTED */
-        case cmd_debug_0:               return "debug_0";
-        default:                        return "unknown";
-    }
-}
-
-// bool is_bcst_cmd(master_command_t cmd)
-// {
-//     //Check if the command can be broadcast
-//     for (int i = 0; i < ARRAY_SIZE(cmd_table); i++)
-//         if (cmd_table[i].cmd == cmd)//Found the command, so return true if it can be broadcast
-//             return ((cmd_table[i].access_flags & CMD_TYPE_BROADCAST) == CMD_TYPE_BROADCAST)? true : false;
+        if (!nodes.list[i].reindex)
+            continue;
+
+        int _cnt_before = nodes.cnt;
+        nodes.list[i].reindex = false;
+        moved = true;
+        init_node_msg(i);
+        if ((add_node_msg_register(i)) && (node_msg_tx_now(i)))
+            continue;
+
+        iprintln(trNODE|trALWAYS, "!Could not move node %d (0x%02X) to its new slot", i, nodes.list[i].address);
+        //If it was lost, the ones above it have been flagged (again)... so we start over
+        if (nodes.cnt < _cnt_before)
+            i = -1;
+    }
 
-//     return false; //Command not found
-// }
+    //A warm start expects the nodes in the slots they now know
+    if (moved)
+        _registry_save();
 
-void init_bcst_msg(void)
+    return (nodes.cnt == _cnt);
+}
+
+void _init_bcst_msg_mask(uint32_t mask)
 {
-    uint32_t _bcst_mask = _inactive_nodes_mask(); //Start with no excluded nodes (apart from the active node)
+    //The mask is in terms of the slots as they are now, so the nodes have to know theirs
+    if (!_nodes_reindex())
+        mask &= (BIT_POS(nodes.cnt) - 1); //The caller's mask predates the loss, so at least keep it to the nodes that are left
+
+    bcst_mask = mask;
     comms_tx_msg_init(&bcst_msg, ADDR_BROADCAST); //Initialize the broadcast message
-    comms_tx_msg_append(&bcst_msg, ADDR_BROADCAST, cmd_bcast_address_mask, (uint8_t *)&_bcst_mask, sizeof(uint32_t), true); //Append the cmd_bcast_address_mask command
+    comms_tx_msg_append(&bcst_msg, ADDR_BROADCAST, cmd_bcast_address_mask, (uint8_t *)&bcst_mask, sizeof(uint32_t), true); //Append the cmd_bcast_address_mask command
+}
+
+void init_bcst_msg(void)
+{
+    _init_bcst_msg_mask(_inactive_nodes_mask()); //Start with no excluded nodes (apart from the active node)
 }
 
 void bcst_msg_tx_now(void)
 {
     //Apart from Roll-calls, broadcast messages are essentially "fire and forget" messages, so we don't need to wait for a response
     if (!comms_tx_msg_send(&bcst_msg))
-        iprintln(trNODE, "#Error: Could not send broadcast (0x%02X)", bcst_msg.msg.hdr.id);
+        iprintln(trNODE, "!Could not send broadcast (0x%02X)", bcst_msg.msg.hdr.id);
 
     //If one of the commands was the "activate" command, we need to set the appropriate flag for all the currently inactive nodes... 
 }
@@ -980,12 +1441,366 @@ bool add_bcst_msg_sync_end(void)
     uint32_t stop_value = sys_stopwatch_ms_stop(&sync_stopwatch); //Stop the sync and provide our elapsed time
     return _bcst_append(cmd_set_sync, (uint8_t *)&stop_value);
 }
+
+int bcst_scatter_rgb(uint8_t index, uint32_t mask, const uint32_t * rgb_cols)
+{
+    uint8_t payload[1 + (3 * RGB_BTN_SCATTER_MAX_NODES)];
+    uint32_t frame_mask = 0;
+    int frame_cnt = 0;
+    int rgb_cnt = 0;
+
+    if ((index > 2) || (rgb_cols == NULL))
+    {
+        iprintln(trNODE, "#Invalid scatter (index %d)", index);
+        return -1;
+    }
+
+    //Only the registered nodes
+    uint32_t remaining = 0;
+    for (int i = 0; i < nodes.cnt; i++)
+        remaining |= (mask & BIT_POS(i));
+
+    payload[0] = index;
+    for (int i = 0; i < nodes.cnt; i++)
+    {
+        if (!(remaining & BIT_POS(i)))
+            continue;
+
+        //The nodes find their own colour by counting the bits below theirs in the address mask, so we MUST keep to the slot order
+        memcpy(&payload[1 + (3 * rgb_cnt)], &rgb_cols[i], 3);
+        frame_mask |= BIT_POS(i);
+        rgb_cnt++;
+        remaining &= ~BIT_POS(i);
+
+        if ((rgb_cnt < RGB_BTN_SCATTER_MAX_NODES) && (remaining != 0))
+            continue; //Room for more, and there are more to come
+
+        _init_bcst_msg_mask(frame_mask);
+        if (!comms_tx_msg_append(&bcst_msg, ADDR_BROADCAST, cmd_set_rgb_scatter, payload, 1 + (3 * rgb_cnt), false))
+            return -1; //Should never happen
+        bcst_msg_tx_now();
+        frame_cnt++;
+
+        //Fire-and-forget, like any other broadcast
+        for (int j = 0; j <= i; j++)
+            if (frame_mask & BIT_POS(j))
+                _node_view_update(j, cmd_set_rgb_0 + index, rgb_cols[j]);
+
+        frame_mask = 0;
+        rgb_cnt = 0;
+    }
+    return frame_cnt;
+}
+
+bool bcst_sequence(const uint8_t * slots, uint8_t steps, uint32_t rgb_col, uint16_t lead_ms, uint16_t on_ms, uint16_t off_ms)
+{
+    uint8_t payload[sizeof(cmd_sequence_t) + CMD_SEQ_STEPS_MAX];
+    cmd_sequence_t * seq = (cmd_sequence_t *)payload;
+    uint32_t mask = 0;
+
+    if ((steps > CMD_SEQ_STEPS_MAX) || ((steps > 0) && ((slots == NULL) || (on_ms == 0))))
+    {
+        iprintln(trNODE, "#Invalid sequence (%d steps)", steps);
+        return false;
+    }
+
+    seq->steps = steps;
+    memcpy(seq->rgb, &rgb_col, 3);
+    seq->lead_ms = lead_ms;
+    seq->on_ms = on_ms;
+    seq->off_ms = off_ms;
+    for (int i = 0; i < steps; i++)
+    {
+        if (slots[i] >= nodes.cnt)
+        {
+            iprintln(trNODE, "#Invalid sequence (step %d on slot %d)", i, slots[i]);
+            return false;
+        }
+        payload[sizeof(cmd_sequence_t) + i] = slots[i];
+        mask |= BIT_POS(slots[i]);
+    }
+    //Stopping is for everyone, else only the nodes which have a step need to hear about it
+    if (steps == 0)
+        mask = BIT_POS(nodes.cnt) - 1;
+
+    _init_bcst_msg_mask(mask);
+    if (!comms_tx_msg_append(&bcst_msg, ADDR_BROADCAST, cmd_set_sequence, payload, sizeof(cmd_sequence_t) + steps, false))
+        return false; //Should never happen
+    bcst_msg_tx_now();
+    return true;
+}
+
+uint32_t nodes_poll_reaction(uint32_t mask)
+{
+    mask &= (BIT_POS(nodes.cnt) - 1);
+    if (mask == 0)
+        return 0;
+
+    _init_bcst_msg_mask(mask);
+    if ((!comms_tx_msg_append(&bcst_msg, ADDR_BROADCAST, cmd_poll_reaction, NULL, 0, false)) || (!comms_tx_msg_send(&bcst_msg)))
+    {
+        iprintln(trNODE, "!Could not send the reaction poll");
+        return mask;
+    }
+
+    //Each node answers in its own slot (its rank in the mask), so the last one is in by the end of the last slot
+    reaction_poll.pending = mask;
+    sys_poll_tmr_start(&reaction_poll.timer, ROLL_CHECK_TIMOUT_MS(__builtin_popcount(mask)) + BUS_SILENCE_MIN_MS, false);
+    while ((reaction_poll.pending != 0) && (!sys_poll_tmr_expired(&reaction_poll.timer)))
+    {
+        node_parse_rx_msg();
+        vTaskDelay(pdMS_TO_TICKS(BUS_SILENCE_MIN_MS)); //Less than a slot
+    }
+    sys_poll_tmr_stop(&reaction_poll.timer);
+
+    return reaction_poll.pending;
+}
+
 bool is_time_sync_busy(void)
 {
     //Check if the sync stopwatch is running
     return sync_stopwatch.running;
 }
 
+bool node_target_set_rgb(uint8_t node, uint8_t index, uint32_t rgb_col)
+{
+    if ((!is_node_valid(node)) || (index > 2))
+        return false;
+
+    nodes.list[node].target.rgb_colour[index] = (rgb_col & 0x00FFFFFF);
+    nodes.list[node].target.wanted |= (NODE_FIELD_RGB_0 << index);
+    return true;
+}
+
+bool node_target_set_blink(uint8_t node, uint32_t period_ms)
+{
+    if (!is_node_valid(node))
+        return false;
+
+    nodes.list[node].target.blink_ms = period_ms;
+    nodes.list[node].target.wanted |= NODE_FIELD_BLINK;
+    return true;
+}
+
+void nodes_target_bcst_active(bool allow)
+{
+    bcst_active_targets = allow;
+}
+
+bool node_target_set_active(uint8_t node, bool active)
+{
+    if (!is_node_valid(node))
+        return false;
+
+    nodes.list[node].target.active = active;
+    nodes.list[node].target.wanted |= NODE_FIELD_ACTIVE;
+    return true;
+}
+
+int nodes_target_flush(void)
+{
+    uint8_t dirty[RGB_BTN_MAX_NODES] = {0};
+    int msg_cnt = 0;
+    bool failed = false;
+    bool bcst_pending = false;
+
+    for (int i = 0; i < nodes.cnt; i++)
+        dirty[i] = _node_target_dirty(i);
+
+    //1st, the changes shared by several (inactive) nodes go out as masked broadcasts...
+    for (uint8_t field = NODE_FIELD_RGB_0; field <= NODE_FIELD_BLINK; field <<= 1)
+    {
+        for (int i = 0; i < nodes.cnt; i++)
+        {
+            if ((!(dirty[i] & field)) || ((nodes.list[i].active) && (!bcst_active_targets)))
+                continue; //Nothing to do, or not allowed to broadcast to this one
+
+            uint32_t value = _node_target_value(i, field);
+            uint32_t mask = 0;
+            for (int j = i; j < nodes.cnt; j++)
+                if ((dirty[j] & field) && ((!nodes.list[j].active) || (bcst_active_targets)) && (_node_target_value(j, field) == value))
+                    mask |= BIT_POS(j);
+
+            if (__builtin_popcount(mask) < NODE_FLUSH_BCST_MIN)
+                continue; //Cheaper to add it to the direct msg
+
+            //The fields are mostly shared by the same nodes, so we keep adding to the same broadcast while we can
+            if ((bcst_pending) && (mask != bcst_mask))
+            {
+                bcst_msg_tx_now();
+                msg_cnt++;
+                bcst_pending = false;
+            }
+            if (!bcst_pending)
+                _init_bcst_msg_mask(mask);
+
+            master_command_t cmd = (field == NODE_FIELD_BLINK)? cmd_set_blink : (master_command_t)(cmd_set_rgb_0 + __builtin_ctz(field));
+            if (!_bcst_append(cmd, (uint8_t *)&value))
+            {
+                //Full... send what we have and start over
+                bcst_msg_tx_now();
+                msg_cnt++;
+                _init_bcst_msg_mask(mask);
+                if (!_bcst_append(cmd, (uint8_t *)&value))
+                {
+                    bcst_pending = false;
+                    continue; //Leave it for the direct msgs
+                }
+            }
+            bcst_pending = true;
+
+            for (int j = i; j < nodes.cnt; j++)
+                if (mask & BIT_POS(j))
+                    dirty[j] &= ~field;
+        }
+    }
+    if (bcst_pending)
+    {
+        bcst_msg_tx_now();
+        msg_cnt++;
+    }
+
+    //2nd, the colours which differ from node to node are scattered across the inactive nodes
+    for (uint8_t index = 0; index < 3; index++)
+    {
+        uint32_t rgb_cols[RGB_BTN_MAX_NODES];
+        uint32_t mask = 0;
+        for (int i = 0; i < nodes.cnt; i++)
+        {
+            rgb_cols[i] = nodes.list[i].target.rgb_colour[index];
+            if ((dirty[i] & (NODE_FIELD_RGB_0 << index)) && ((!nodes.list[i].active) || (bcst_active_targets)))
+                mask |= BIT_POS(i);
+        }
+
+        if (__builtin_popcount(mask) < NODE_FLUSH_BCST_MIN)
+            continue; //Cheaper to add it to the direct msg
+
+        int frames = bcst_scatter_rgb(index, mask, rgb_cols);
+        if (frames < 0)
+            continue; //Leave it for the direct msgs
+
+        msg_cnt += frames;
+        for (int i = 0; i < nodes.cnt; i++)
+            if (mask & BIT_POS(i))
+                dirty[i] &= ~(NODE_FIELD_RGB_0 << index);
+    }
+
+    //... and then whatever is left is sent directly to the individual nodes
+    for (int i = 0; i < nodes.cnt; i++)
+    {
+        if (dirty[i] == 0)
+            continue;
+
+        init_node_msg(i);
+        if (dirty[i] & NODE_FIELD_BLINK)
+            add_node_msg_set_blink(i, nodes.list[i].target.blink_ms);
+        for (uint8_t index = 0; index < 3; index++)
+            if (dirty[i] & (NODE_FIELD_RGB_0 << index))
+                add_node_msg_set_rgb(i, index, nodes.list[i].target.rgb_colour[index]);
+        if (dirty[i] & NODE_FIELD_ACTIVE) //Last, after the colours have been set
+            add_node_msg_set_active(i, nodes.list[i].target.active);
+
+        int _cnt = nodes.cnt;
+        msg_cnt++;
+        if (!node_msg_tx_now(i))
+        {
+            iprintln(trNODE, "!Could not flush targets to node %d", i);
+            failed = true;
+            if (nodes.cnt < _cnt) //The node was de-registered, the rest moved down by 1
+            {
+                memmove(&dirty[i], &dirty[i + 1], nodes.cnt - i);
+                i--;
+            }
+        }
+    }
+
+    return (failed)? -1 : msg_cnt;
+}
+
+int _nodes_apply_state(uint32_t mask, const node_state_t * state, int dbg_led)
+{
+    uint32_t verify = 0;
+    uint8_t sw = (state->active)? CMD_SW_PAYLOAD_ACTIVATE : CMD_SW_PAYLOAD_DEACTIVATE;
+    uint8_t dbg_state = (uint8_t)dbg_led;
+    int msg_cnt = 0;
+    bool failed = false;
+
+    //Only the registered nodes
+    mask &= (BIT_POS(nodes.cnt) - 1);
+    if (mask == 0)
+        return 0;
+
+    for (int i = 0; i < nodes.cnt; i++)
+    {
+        if (!(mask & BIT_POS(i)))
+            continue;
+        if ((!(nodes.list[i].known & NODE_FIELD_ACTIVE)) || (nodes.list[i].active != state->active))
+            verify |= BIT_POS(i);
+        memcpy(nodes.list[i].target.rgb_colour, state->rgb_colour, sizeof(state->rgb_colour));
+        nodes.list[i].target.blink_ms = state->blink_ms;
+        nodes.list[i].target.active = state->active;
+        nodes.list[i].target.wanted |= (NODE_FIELD_RGB_0 | NODE_FIELD_RGB_1 | NODE_FIELD_RGB_2 | NODE_FIELD_BLINK | NODE_FIELD_ACTIVE);
+    }
+
+    //The nodes already in this state (as far as their switch goes) share a single broadcast, and are trusted to get it...
+    mask &= ~verify;
+    if (mask != 0)
+    {
+        //The blink period goes 1st, so that the colours are not toggled in-between, and the switch last (as in a direct msg)
+        _init_bcst_msg_mask(mask);
+        _bcst_append(cmd_set_blink, (uint8_t *)&state->blink_ms);
+        for (uint8_t index = 0; index < 3; index++)
+            _bcst_append(cmd_set_rgb_0 + index, (uint8_t *)&state->rgb_colour[index]);
+        _bcst_append(cmd_set_switch, &sw);
+        if (dbg_led >= 0)
+            _bcst_append(cmd_set_dbg_led, &dbg_state);
+        bcst_msg_tx_now();
+        msg_cnt++;
+        for (int i = 0; i < nodes.cnt; i++)
+            if (mask & BIT_POS(i))
+                nodes.list[i].active = state->active;
+    }
+
+    //... the rest get it directly, and we only carry on once they have acknowledged it
+    for (int i = nodes.cnt - 1; i >= 0; i--) //From the top, so a de-registered node does not move the ones still to come
+    {
+        if (!(verify & BIT_POS(i)))
+            continue;
+        init_node_msg(i);
+        add_node_msg_set_blink(i, state->blink_ms);
+        for (uint8_t index = 0; index < 3; index++)
+            add_node_msg_set_rgb(i, index, state->rgb_colour[index]);
+        if (dbg_led >= 0)
+            add_node_msg_set_dbgled(i, dbg_state);
+        add_node_msg_set_active(i, state->active);
+        msg_cnt++;
+        if (!node_msg_tx_now(i))
+        {
+            iprintln(trNODE, "!Could not verify the state of node %d", i);
+            failed = true;
+        }
+    }
+
+    return (failed)? -1 : msg_cnt;
+}
+
+int nodes_apply_state(uint32_t mask, const node_state_t * state)
+{
+    return _nodes_apply_state(mask, state, -1);
+}
+
+int nodes_reset(uint32_t mask)
+{
+    return _nodes_apply_state(mask, &node_state_off, -1);
+}
+
+void nodes_target_reset(void)
+{
+    for (int i = 0; i < nodes.cnt; i++)
+        memset(&nodes.list[i].target, 0, sizeof(node_target_t));
+    bcst_active_targets = false;
+}
+
 uint32_t _inactive_nodes_mask(void)
 {
     uint32_t mask = 0x00000000; //Start with all nodes inactive
@@ -1004,7 +1819,7 @@ int active_node_count(void)
             count++; //Count the number of registered buttons
 
     if (count > 1)
-        iprintln(trNODE|trALWAYS, "#Error - %d active nodes found", count);
+        iprintln(trNODE|trALWAYS, "!%d active nodes found", count);
 
     return count;
 }
@@ -1054,12 +1869,39 @@ dbg_blink_state_t get_node_btn_dbg_led_state(int slot)
     return (!is_node_valid(slot))? dbg_led_off : nodes.list[slot].btn.dbg_led_state; //Return the debug LED state for the button
 }
 
+bool get_node_link_stats(int slot, node_link_stats_t * stats)
+{
+    if ((!is_node_valid(slot)) || (stats == NULL))
+        return false;
+
+    memcpy(stats, &nodes.list[slot].link, sizeof(node_link_stats_t));
+    return true;
+}
+
+void node_link_stats_reset(int slot)
+{
+    if (!is_node_valid(slot))
+        return;
+
+    node_link_stats_t *link = &nodes.list[slot].link;
+    //Keep the RTT estimates, they are still valid
+    link->tx_cnt = 0;
+    link->rx_cnt = 0;
+    link->retries = 0;
+    link->timeouts = 0;
+    link->crc_err = 0;
+    link->node_crc_err = 0;
+    link->node_echo_err = 0;
+    link->node_tx_retries = 0;
+    link->node_tx_abandoned = 0;
+}
+
 
 int _add_rc_address(uint8_t addr)
 {
     if (rollcall.cnt >= RGB_BTN_MAX_NODES)
     {
-        iprintln(trNODE, "#Error: Roll-call list is full (%d/%d)", rollcall.cnt, RGB_BTN_MAX_NODES);
+        iprintln(trNODE, "!Roll-call list is full (%d/%d)", rollcall.cnt, RGB_BTN_MAX_NODES);
     }
     else
     {
@@ -1099,18 +1941,23 @@ bool _waiting_for_rollcall(bool blocking)
 
         while (!sys_poll_tmr_expired(&rollcall.timer))
         {
-            node_parse_rx_msg(); //Process any received messages, this will update the nodes.list with the responses
+            while (node_parse_rx_msg()); //Process all the received messages, this will update the nodes.list with the responses
             vTaskDelay(pdMS_TO_TICKS((uint32_t)(MIN(100, BUS_SILENCE_MIN_MS + wait_time)))); //Wait a bit (max 100ms) before we check again
         }
     }
 
+    //A check is over in a single wait, so its answers are all still in the queue
+    while (node_parse_rx_msg());
+    sys_poll_tmr_stop(&rollcall.timer);
+
     return false; //Roll-call is complete, we can register nodes now
 }
 
-void node_parse_rx_msg(void)
+bool node_parse_rx_msg(void)
 {
     comms_msg_t rx_msg;
     size_t rx_msg_size;
+    bool rx = false;
 
     int _data_idx = 0;
     int _cmd_idx = 0;
@@ -1122,6 +1969,7 @@ void node_parse_rx_msg(void)
 
     if (comms_msg_rx_read(&rx_msg, &rx_msg_size))
     {
+        rx = true;
 
         size_t payload_len = rx_msg_size - (sizeof(comms_msg_hdr_t) + sizeof(uint8_t));
 
@@ -1141,16 +1989,27 @@ void node_parse_rx_msg(void)
             // 2) Responses to directed commands sent to a node
             if (_cmd == cmd_roll_call)
             {
-                _rollcall_handler(rx_msg.hdr.src); //Handle the roll-call response
+                _rollcall_handler(rx_msg.hdr.src, (_resp_data_len > 0)? _resp_data[0] : CMD_RC_SLOT_NONE); //Handle the roll-call response
                 //RVN - should we return from here? or continue processing the rest of the message?
-                return;
+                return true;
             }
             else
             {
                 int node_slot = -1;
                 //iprintln(trNODE, "#RX 0x%02X for \"%s\" from Node 0x%02X. %d bytes", _resp, cmd_to_str(_cmd), rx_msg.hdr.src, _resp_data_len);
                 if (_get_adress_node_index(rx_msg.hdr.src, &node_slot))
-                    _response_handler(node_slot, _cmd, _resp, _resp_data, _resp_data_len);
+                {
+                    if (_cmd_idx == 0)
+                    {
+                        nodes.list[node_slot].link.rx_cnt++;
+                        _nodes_metrics.rx_cnt++;
+                    }
+                    //The answers to a reaction poll are not in the node's pending list (the poll was a broadcast)
+                    if (_cmd == cmd_poll_reaction)
+                        _poll_handler(node_slot, _resp, _resp_data, _resp_data_len);
+                    else
+                        _response_handler(node_slot, _cmd, _resp, _resp_data, _resp_data_len);
+                }
                 else //Response to a command sent directly to a node, but we are not waiting for a response (unless we are in a rollcall stage?)?????
                 {
                     if (_resp == resp_ok)
@@ -1167,11 +2026,14 @@ void node_parse_rx_msg(void)
 
     //Check if we have any pending responses that timed out
     _check_all_pending_node_responses();
+    return rx;
 }
 
 bool nodes_register_all(void)
 {
-    if (!_bcst_rollcall(true))
+    metrics_add("nodes", _nodes_metric_items, ARRAY_SIZE(_nodes_metric_items));
+
+    if (!_bcst_rollcall(CMD_RC_PAYLOAD_ALL, ROLL_CALL_TIMOUT_MS(ADDR_BROADCAST, ADDR_BROADCAST)))
     {
         iprintln(trNODE|trALWAYS, "#Failed to send rollcall");
         return false; //Failed to send the roll-call message, so we can't register new buttons
@@ -1183,24 +2045,80 @@ bool nodes_register_all(void)
     //This call will block the console task until the roll-call timer expires, so we can register nodes
     _waiting_for_rollcall(true);
 
-    for (int i = 0; i < rollcall.cnt; i++)
+    _register_rollcall();
+    return (node_count() > 0)? true : false; //Return true if we have any registered nodes
+}
+
+bool nodes_register_warm(void)
+{
+    node_registry_t reg;
+    int i;
+    int slot;
+
+    metrics_add("nodes", _nodes_metric_items, ARRAY_SIZE(_nodes_metric_items));
+
+    //The nodes we registered since we started are the most recent, otherwise it is whatever we saved before we were reset
+    if (node_count() > 0)
+        _registry_get(&reg);
+    else if (!_registry_load(&reg))
+        reg.cnt = 0;
+
+    if (reg.cnt == 0)
+        return nodes_register_all(); //Nothing to check, so we have to enumerate the bus
+
+    //"Are you still in slot X?" - each registered node answers in its own slot, so this is over in (cnt+1) x 10 ms
+    if (!_bcst_rollcall(CMD_RC_PAYLOAD_CHECK, ROLL_CHECK_TIMOUT_MS(reg.cnt)))
     {
-        if (_register_addr(rollcall.list[i]) != rollcall.list[i])
-            iprintln(trNODE|trALWAYS, "#Failed to register node 0x%02X", (uint8_t)rollcall.list[0]);
+        iprintln(trNODE|trALWAYS, "#Failed to send rollcall");
+        return false;
     }
-    iprintln(trNODE, "#Registered %d/%d nodes", node_count(), rollcall.cnt);
+    _waiting_for_rollcall(true);
+
+    //The nodes which are still where we left them are restored without any further msgs...
+    for (slot = 0; slot < reg.cnt; slot++)
+    {
+        for (i = 0; i < rollcall.cnt; i++)
+        {
+            if ((rollcall.list[i] == reg.list[slot].address) && (rollcall.slot[i] == slot))
+                break;
+        }
+        if (i >= rollcall.cnt)
+            break; //This one is missing (or moved), so the slots from here on have to be handed out again
+        _restore_node(&reg.list[slot]);
+        rollcall.slot[i] = CMD_RC_SLOT_NONE; //Done with this one
+    }
+    iprintln(trNODE|trALWAYS, "#%d/%d nodes still in their slots", node_count(), reg.cnt);
+
+    //... the others who answered are registered, but they can be addressed directly, so they are moved to their new slots right away
+    for (i = 0; i < rollcall.cnt; i++)
+    {
+        if ((rollcall.slot[i] != CMD_RC_SLOT_NONE) && (_register_addr(rollcall.list[i]) != rollcall.list[i]))
+            iprintln(trNODE|trALWAYS, "#Failed to register node 0x%02X", rollcall.list[i]);
+    }
+
+    //Only if one of the saved nodes did not answer (e.g. it was reset as well), do we have to enumerate the bus (for the unregistered nodes)
+    if (node_count() < reg.cnt)
+    {
+        iprintln(trNODE|trALWAYS, "#%d node(s) missing - registration will complete in %.03f s.", reg.cnt - node_count(), 
+            (ROLL_CALL_TIMOUT_MS(ADDR_BROADCAST, ADDR_BROADCAST) + BUS_SILENCE_MIN_MS) / 1000.0);
+        if (!_bcst_rollcall(CMD_RC_PAYLOAD_UNREG, ROLL_CALL_TIMOUT_MS(ADDR_BROADCAST, ADDR_BROADCAST)))
+        {
+            iprintln(trNODE|trALWAYS, "#Failed to send rollcall");
+            _registry_save();
+            return (node_count() > 0)? true : false;
+        }
+        _waiting_for_rollcall(true);
+        _register_rollcall();
+    }
+    else
+        _registry_save();
+
     return (node_count() > 0)? true : false; //Return true if we have any registered nodes
 }
 
 void bcst_msg_clear_all(void)
 {
-    init_bcst_msg();
-    add_bcst_msg_set_blink(0); //Turn off blinking
-    add_bcst_msg_set_rgb(0, 0);
-    add_bcst_msg_set_rgb(1, 0);
-    add_bcst_msg_set_rgb(2, 0);
-    add_bcst_msg_set_dbgled(dbg_led_off); //Turn off the debug LED
-    bcst_msg_tx_now();
+    _nodes_apply_state(NODES_MASK_ALL, &node_state_off, dbg_led_off); //Everything off, the debug LED too
 }
 
 #undef PRINTF_TAG
@@ -26,7 +26,8 @@ definitions
 #define EXT extern
 #endif /* __NOT_EXTERN__ */
 
-#define NODE_CMD_CNT_MAX  (10) // The maximum number of commands we can send in a single message
+#define NODE_CMD_CNT_MAX  (16) // The maximum number of commands we can send in a single message
+#define NODES_MASK_ALL    (0xFFFFFFFF) // All the registered nodes (see nodes_apply_state())
 
 /******************************************************************************
 Macros
@@ -35,6 +36,32 @@ Macros
 /******************************************************************************
 Struct & Unions
 ******************************************************************************/
+typedef struct
+{
+    uint32_t    srtt_x8;        // Smoothed round-trip time (ms), scaled by 8
+    uint32_t    rttvar_x4;      // Round-trip time variation (ms), scaled by 4
+    uint32_t    rto_ms;         // The current response timeout (ms) for a single response msg (0 until we have a sample)
+    uint32_t    rtt_samples;    // The number of RTT samples taken
+    uint32_t    rtt_last_ms;    // The last RTT sample (ms)
+    uint64_t    tx_time;        // When the current command list was first sent
+    uint32_t    tx_cnt;         // Messages sent to this node (including retries)
+    uint32_t    rx_cnt;         // Response messages received from this node
+    uint32_t    retries;        // Messages that had to be resent to this node
+    uint32_t    timeouts;       // Response timeouts
+    uint32_t    crc_err;        // CRC errors on the bus while we were waiting on this node
+    uint32_t    node_crc_err;   // CRC errors seen by the node (accumulated from cmd_get_link)
+    uint32_t    node_echo_err;  // Echo mismatches seen by the node (accumulated from cmd_get_link)
+    uint32_t    node_tx_retries;// TX retries done by the node (accumulated from cmd_get_link)
+    uint32_t    node_tx_abandoned; // Transmissions abandoned by the node (accumulated from cmd_get_link)
+}node_link_stats_t;
+
+/* The state nodes_apply_state() puts a set of nodes in */
+typedef struct
+{
+    uint32_t    rgb_colour[3];  // The 3 colours
+    uint32_t    blink_ms;       // The blink period (0 for no blinking)
+    bool        active;         // Is the button stopwatch running?
+}node_state_t;
 
 /******************************************************************************
 Global (public) variables
@@ -49,6 +76,16 @@ Global (public) function definitions
  */
 bool nodes_register_all(void);
 
+/*! \brief Registers the nodes we had before (since boot, or saved in NVS before a reset) without a full roll-call.
+ * A single broadcast asks the registered nodes to confirm their slots, each answering in its own 10 ms slot. 
+ * The nodes still in their slots are restored as they were, the ones that moved are registered again directly, 
+ * and only if a node is missing (e.g. it was reset too) is a roll-call for the unregistered nodes sent.
+ * New nodes which were never registered are not found this way (see nodes_register_all()).
+ * Without a registry, this is nodes_register_all().
+ * \return True if we have any registered nodes
+ */
+bool nodes_register_warm(void);
+
 /*! \brief Get the address of a registered node.
  * \param node The index of the node in the nodes.list.
  * \return The address of the node, or ADDR_BROADCAST if the node is invalid.
@@ -84,7 +121,22 @@ float               get_node_btn_correction_factor(int slot);
 bool                get_node_btn_sw_state(int slot);
 dbg_blink_state_t   get_node_btn_dbg_led_state(int slot);
 
-void node_parse_rx_msg(void);
+/*! \brief Get the link quality information for a node.
+ * \param slot The index of the node in the nodes.list.
+ * \param stats Pointer to where the link information should be copied.
+ * \return True if the node is valid, false otherwise.
+ */
+bool get_node_link_stats(int slot, node_link_stats_t * stats);
+
+/*! \brief Clears the link quality counters of a node (the RTT estimates are retained).
+ * \param slot The index of the node in the nodes.list.
+ */
+void node_link_stats_reset(int slot);
+
+/*! \brief Handles the next msg received from the nodes (if any), and the responses which timed out
+ * \return true if a msg was read
+ */
+bool node_parse_rx_msg(void);
 
 size_t cmd_mosi_payload_size(master_command_t cmd);
 const char * cmd_to_str(master_command_t cmd);
@@ -105,6 +157,7 @@ bool add_node_msg_set_time(uint8_t node, uint32_t new_time_ms);
 bool add_node_msg_sync_reset(uint8_t node);
 bool add_node_msg_sync_start(uint8_t node);
 bool add_node_msg_sync_end(uint8_t node);
+bool add_node_msg_set_calib(uint8_t node, const colour_cal_t * cal);
 
 bool add_node_msg_get_rgb(uint8_t node, uint8_t index);
 bool add_node_msg_get_blink(uint8_t node);
@@ -114,6 +167,8 @@ bool add_node_msg_get_flags(uint8_t node);
 bool add_node_msg_get_time(uint8_t node);
 bool add_node_msg_get_correction(uint8_t node);
 bool add_node_msg_get_version(uint8_t node);
+bool add_node_msg_get_link(uint8_t node);
+bool add_node_msg_get_calib(uint8_t node);
 
 bool node_msg_tx_now(uint8_t node);
 
@@ -130,8 +185,86 @@ bool add_bcst_msg_sync_start(void);
 bool add_bcst_msg_sync_end(void);
 void bcst_msg_tx_now(void);
 
+/*! \brief Sets a different colour on each of the nodes in the mask, using as few broadcasts as possible.
+ * The colours are packed (in slot order) behind the address mask, RGB_BTN_SCATTER_MAX_NODES per broadcast.
+ * \param index The colour index (0 to 2)
+ * \param mask The slots of the nodes to set
+ * \param rgb_cols The colours, indexed by slot (RGB_BTN_MAX_NODES entries)
+ * \return The number of broadcasts sent, or -1 on error
+ */
+int bcst_scatter_rgb(uint8_t index, uint32_t mask, const uint32_t * rgb_cols);
+
+/*! \brief Uploads a sequence which the nodes then play back by themselves (see cmd_set_sequence), in a single broadcast 
+ * to the nodes in the sequence. The nodes time the steps from the end of the broadcast, on their own (sync'ed) clocks.
+ * Their colours are left alone, so nothing changes in the master's view of them.
+ * \param slots The slot of each step (NULL and 0 steps stops the playback on all the nodes)
+ * \param steps The number of steps (up to CMD_SEQ_STEPS_MAX)
+ * \param rgb_col The colour of a step
+ * \param lead_ms The time before the 1st step
+ * \param on_ms The time a step is lit
+ * \param off_ms The time between steps
+ * \return true if the broadcast was sent, false if the sequence is not valid
+ */
+bool bcst_sequence(const uint8_t * slots, uint8_t steps, uint32_t rgb_col, uint16_t lead_ms, uint16_t on_ms, uint16_t off_ms);
+
+/*! \brief Reads the reaction time of a set of nodes with a single broadcast (cmd_poll_reaction). Each node answers in its 
+ * own slot, so this blocks for up to ROLL_CHECK_TIMOUT_MS() of the number of nodes in the mask. A press is handled as 
+ * for a direct read (see add_node_msg_get_reaction()). Nothing is resent, a node which did not answer has to be read directly.
+ * \param mask The slots of the nodes to read
+ * \return The slots of the nodes which did not answer (0 if all of them did)
+ */
+uint32_t nodes_poll_reaction(uint32_t mask);
+
 bool is_time_sync_busy(void);
 
+/*** Desired state ****/
+/*! \brief Sets the colour we want a node to have. Nothing is sent until nodes_target_flush() is called.
+ * \param node The index of the node in the nodes.list.
+ * \param index The colour index (0 to 2)
+ * \param rgb_col The RGB colour
+ * \return True if the node and index are valid, false otherwise.
+ */
+bool node_target_set_rgb(uint8_t node, uint8_t index, uint32_t rgb_col);
+bool node_target_set_blink(uint8_t node, uint32_t period_ms);
+bool node_target_set_active(uint8_t node, bool active);
+
+/*! \brief Brings all the nodes in line with their targets.
+ * Only the fields which differ from what the node has acknowledged (or is not known) are sent. Changes 
+ * shared by several inactive nodes are sent as a single masked broadcast, differing colours on inactive 
+ * nodes are scattered (see bcst_scatter_rgb()) and the rest is sent directly to each node.
+ * \return The number of msgs sent, or -1 if a node failed to respond
+ */
+int nodes_target_flush(void);
+
+/*! \brief Allows the colours and blink period of active nodes to be broadcast by nodes_target_flush() as well.
+ * Broadcasts are not acknowledged, so only use this for cosmetic changes the game can afford to lose (e.g. 
+ * the ramps of several targets). The active state itself is always sent directly. Cleared by nodes_target_reset().
+ * \param allow true to include the active nodes in the broadcasts, false to only broadcast to inactive nodes
+ */
+void nodes_target_bcst_active(bool allow);
+
+/*! \brief Forgets the targets of all the nodes (e.g. when a game ends), nothing is sent until new targets are set.
+ */
+void nodes_target_reset(void);
+
+/*! \brief Puts a set of nodes (active or not) in the same state with a single masked broadcast. Only the nodes whose 
+ * switch (active) state changes, or is not known, get it in a direct (acknowledged) msg instead, since a lost broadcast 
+ * would leave them taking presses (or not). The rest are trusted to get the broadcast, as with any other.
+ * The targets of the nodes are set to the state as well, so nodes_target_flush() keeps it.
+ * \param mask The slots of the nodes (NODES_MASK_ALL for all of them)
+ * \param state The state to put them in
+ * \return The number of msgs sent, or -1 if a node failed to respond
+ */
+int nodes_apply_state(uint32_t mask, const node_state_t * state);
+
+/*! \brief Resets a set of nodes (black, not blinking and inactive), e.g. at the start of a round (see nodes_apply_state())
+ * \param mask The slots of the nodes (NODES_MASK_ALL for all of them)
+ * \return The number of msgs sent, or -1 if a node failed to respond
+ */
+int nodes_reset(uint32_t mask);
+
+/*! \brief Resets all the nodes (see nodes_reset()) and turns their debug LEDs off, in the same broadcast
+ */
 void bcst_msg_clear_all(void);
 
 #ifdef __cplusplus
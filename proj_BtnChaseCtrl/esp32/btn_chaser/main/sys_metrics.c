@@ -0,0 +1,372 @@
+/*******************************************************************************
+Module:     sys_metrics.c
+Purpose:    This file contains the performance counters, gauges and histograms
+Author:     Rudolph van Niekerk
+
+Each module owns (declares and updates) its own metrics and adds them to the
+list as a group (table), in the same way as console menu items. Updating a
+metric is nothing more than an increment or a compare, so it can be done in
+the hot paths. Each metric should only ever be updated from a single task.
+
+The "stats" console command displays the metrics, and can clear them, or take a
+snapshot and display the change since the snapshot was taken.
+
+ *******************************************************************************/
+
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdarg.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+
+#include "defines.h"
+#include "sys_utils.h"
+#include "sys_timers.h"
+#include "task_console.h"
+
+#define __NOT_EXTERN__
+#include "sys_metrics.h"
+#undef __NOT_EXTERN__
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#ifdef PRINTF_TAG
+#undef PRINTF_TAG
+#endif
+#define PRINTF_TAG ("Metrics") /* This must be undefined at the end of the file*/
+
+/*******************************************************************************
+local defines
+ *******************************************************************************/
+#define METRICS_GROUPS_MAX      (8)     /* The max number of metric groups (tables) */
+#define METRICS_ITEMS_MAX       (48)    /* The max number of metrics in all the groups together */
+
+/*******************************************************************************
+ Local structure
+ *******************************************************************************/
+typedef struct
+{
+    const char * name;
+    const metric_item_t * table_ptr;
+    int item_cnt;
+    int first;          // The index of the first item of this group in the snapshot
+}metrics_group_t;
+
+/* The part of a metric that can be compared with an earlier snapshot */
+typedef struct
+{
+    uint32_t value;     // Counter value or gauge level
+    uint32_t cnt;       // Histogram sample count
+    uint32_t sum;       // Histogram sample sum
+    uint32_t bucket[METRIC_HIST_BUCKETS];
+}metrics_snap_t;
+
+typedef struct
+{
+    metrics_group_t group[METRICS_GROUPS_MAX];
+    int group_cnt;
+    int item_cnt;
+    metrics_snap_t snap[METRICS_ITEMS_MAX];
+    int snap_cnt;       // The number of items (in the order they were added) in the snapshot
+    uint64_t snap_time; // When the snapshot was taken (ms)
+}metrics_t;
+
+/*******************************************************************************
+ Local function prototypes
+ *******************************************************************************/
+
+/*! \brief Copies the current value(s) of a metric
+ * \param item The metric
+ * \param snap The copy
+ */
+void _metrics_read(const metric_item_t * item, metrics_snap_t * snap);
+
+/*! \brief Displays a single metric
+ * \param item The metric
+ * \param snap The snapshot to display the difference to (NULL for the absolute values)
+ */
+void _metrics_print_item(const metric_item_t * item, const metrics_snap_t * snap);
+
+/*! \brief Displays, clears or takes a snapshot of the metrics
+ */
+void _metrics_handler_stats(void);
+
+/*******************************************************************************
+ Local variables
+ *******************************************************************************/
+ConsoleMenuItem_t _metrics_menu_items[] =
+{
+                                    //01234567890123456789012345678901234567890123456789012345678901234567890123456789
+    {"stats",   _metrics_handler_stats, "Displays the performance counters and histograms"},
+};
+
+metrics_t _metrics = {0};
+
+/*******************************************************************************
+ Local (private) Functions
+ *******************************************************************************/
+
+void _metrics_read(const metric_item_t * item, metrics_snap_t * snap)
+{
+    memset(snap, 0, sizeof(metrics_snap_t));
+    switch (item->type)
+    {
+        case metric_counter:
+            snap->value = *(uint32_t *)item->data;
+            break;
+        case metric_gauge:
+            snap->value = ((metric_gauge_t *)item->data)->value;
+            break;
+        case metric_hist:
+        {
+            metric_hist_t *hist = (metric_hist_t *)item->data;
+            snap->cnt = hist->cnt;
+            snap->sum = hist->sum;
+            memcpy(snap->bucket, hist->bucket, sizeof(snap->bucket));
+            break;
+        }
+    }
+}
+
+void _metrics_print_item(const metric_item_t * item, const metrics_snap_t * snap)
+{
+    const char *unit = (item->unit)? item->unit : "";
+    metrics_snap_t now;
+
+    _metrics_read(item, &now);
+    //Only the change since the snapshot is of interest (but we cannot go back in time for min/max values)
+    if (snap != NULL)
+    {
+        now.value -= (item->type == metric_counter)? snap->value : 0;
+        now.cnt -= snap->cnt;
+        now.sum -= snap->sum;
+        for (int i = 0; i < METRIC_HIST_BUCKETS; i++)
+            now.bucket[i] -= snap->bucket[i];
+    }
+
+    switch (item->type)
+    {
+        case metric_counter:
+            iprintln(trALWAYS, "  %-14s %10lu %s", item->name, now.value, unit);
+            break;
+
+        case metric_gauge:
+            iprintln(trALWAYS, "  %-14s %10lu %s (max %lu)", item->name, now.value, unit, ((metric_gauge_t *)item->data)->max);
+            break;
+
+        case metric_hist:
+        {
+            metric_hist_t *hist = (metric_hist_t *)item->data;
+            if (now.cnt == 0)
+            {
+                iprintln(trALWAYS, "  %-14s %10s", item->name, "-");
+                break;
+            }
+            iprintln(trALWAYS, "  %-14s %10lu samples, avg %lu%s (min %lu, max %lu)",
+                item->name, now.cnt, now.sum / now.cnt, unit, hist->min, hist->max);
+            iprint(trALWAYS, "  %14s", "");
+            for (int i = 0; i < METRIC_HIST_BUCKETS - 1; i++)
+                iprint(trALWAYS, " <=%lu:%lu", hist->bounds[i], now.bucket[i]);
+            iprintln(trALWAYS, " >%lu:%lu", hist->bounds[METRIC_HIST_BUCKETS - 2], now.bucket[METRIC_HIST_BUCKETS - 1]);
+            break;
+        }
+    }
+}
+
+void _metrics_handler_stats(void)
+{
+    bool help_requested = false;
+    bool got_reset = false;
+    bool got_snap = false;
+    bool got_diff = false;
+    metrics_group_t *only_group = NULL;
+
+    while (console_arg_cnt() > 0)
+	{
+        char *arg = console_arg_pop();
+        if ((!strcasecmp("?", arg)) || (!strcasecmp("help", arg)))
+        {
+            help_requested = true;
+            break; //from while-loop
+        }
+        if ((!strcasecmp("reset", arg)) || (!strcasecmp("clear", arg)))
+        {
+            got_reset = true;
+            continue; //from while-loop
+        }
+        if (!strcasecmp("snap", arg))
+        {
+            got_snap = true;
+            continue; //from while-loop
+        }
+        if (!strcasecmp("diff", arg))
+        {
+            got_diff = true;
+            continue; //from while-loop
+        }
+        for (int i = 0; i < _metrics.group_cnt; i++)
+        {
+            if (!strcasecmp(_metrics.group[i].name, arg))
+                only_group = &_metrics.group[i];
+        }
+        if (only_group != NULL)
+            continue; //from while-loop
+
+        iprintln(trALWAYS, "Invalid Argument (\"%s\")", arg);
+        help_requested = true;
+        break;
+    }
+
+    if (help_requested)
+    {
+        //                  01234567890123456789012345678901234567890123456789012345678901234567890123456789
+        iprintln(trALWAYS, "Usage: \"stats [reset|snap|diff] [<group>]\"");
+        iprintln(trALWAYS, "    no args: Displays all the metrics");
+        iprintln(trALWAYS, "    reset:   Clears all the metrics");
+        iprintln(trALWAYS, "    snap:    Takes a snapshot of the metrics (see \"diff\")");
+        iprintln(trALWAYS, "    diff:    Displays the change in the metrics since the last snapshot");
+        iprintln(trALWAYS, "    <group>: Only displays the metrics in this group:");
+        for (int i = 0; i < _metrics.group_cnt; i++)
+            iprintln(trALWAYS, "              %s (%d)", _metrics.group[i].name, _metrics.group[i].item_cnt);
+        iprintln(trALWAYS, "    Groups are added once the module using them has started");
+        return;
+    }
+
+    if (got_reset)
+    {
+        metrics_reset();
+        iprintln(trALWAYS, "Metrics cleared");
+        return;
+    }
+
+    if (got_snap)
+    {
+        for (int i = 0; i < _metrics.group_cnt; i++)
+        {
+            for (int j = 0; j < _metrics.group[i].item_cnt; j++)
+                _metrics_read(&_metrics.group[i].table_ptr[j], &_metrics.snap[_metrics.group[i].first + j]);
+        }
+        _metrics.snap_cnt = _metrics.item_cnt;
+        _metrics.snap_time = sys_poll_tmr_ms();
+        iprintln(trALWAYS, "Snapshot taken of %d metrics", _metrics.snap_cnt);
+        return;
+    }
+
+    if ((got_diff) && (_metrics.snap_cnt == 0))
+    {
+        iprintln(trALWAYS, "No snapshot taken yet (\"stats snap\")");
+        return;
+    }
+
+    if (got_diff)
+        iprintln(trALWAYS, "Change over the last %llu ms:", sys_poll_tmr_ms() - _metrics.snap_time);
+
+    for (int i = 0; i < _metrics.group_cnt; i++)
+    {
+        metrics_group_t *grp = &_metrics.group[i];
+        if ((only_group != NULL) && (only_group != grp))
+            continue;
+
+        iprintln(trALWAYS, "%s:", grp->name);
+        for (int j = 0; j < grp->item_cnt; j++)
+        {
+            int index = grp->first + j;
+            //Items added after the snapshot was taken started at 0
+            static const metrics_snap_t _zero = {0};
+            const metrics_snap_t *snap = (!got_diff)? NULL : (index < _metrics.snap_cnt)? &_metrics.snap[index] : &_zero;
+            _metrics_print_item(&grp->table_ptr[j], snap);
+        }
+    }
+}
+
+/*******************************************************************************
+ Global (public) Functions
+ *******************************************************************************/
+
+void metrics_init(void)
+{
+	console_add_menu("met", _metrics_menu_items, ARRAY_SIZE(_metrics_menu_items), "Performance Metrics");
+}
+
+int metrics_add(const char * _group_name, const metric_item_t * _tbl, size_t _cnt)
+{
+    for (int i = 0; i < _metrics.group_cnt; i++)
+    {
+        if (_metrics.group[i].table_ptr == _tbl)
+            return 0; //Already added
+    }
+
+    if ((_metrics.group_cnt >= METRICS_GROUPS_MAX) || ((_metrics.item_cnt + _cnt) > METRICS_ITEMS_MAX))
+    {
+        iprintln(trALWAYS, "!No space for metrics \"%s\" (%d)", _group_name, _cnt);
+        return 0;
+    }
+
+    //Groups are kept in the order they are added, so that the snapshot indices never move
+    _metrics.group[_metrics.group_cnt].name = _group_name;
+    _metrics.group[_metrics.group_cnt].table_ptr = _tbl;
+    _metrics.group[_metrics.group_cnt].item_cnt = _cnt;
+    _metrics.group[_metrics.group_cnt].first = _metrics.item_cnt;
+    _metrics.item_cnt += _cnt;
+    _metrics.group_cnt++;
+
+    return _cnt;
+}
+
+void metric_hist_add(metric_hist_t * hist, uint32_t value)
+{
+    int i = 0;
+
+    while ((i < (METRIC_HIST_BUCKETS - 1)) && (value > hist->bounds[i]))
+        i++;
+    hist->bucket[i]++;
+
+    if ((hist->cnt == 0) || (value < hist->min))
+        hist->min = value;
+    if (value > hist->max)
+        hist->max = value;
+    hist->cnt++;
+    hist->sum += value;
+}
+
+void metrics_reset(void)
+{
+    for (int i = 0; i < _metrics.group_cnt; i++)
+    {
+        for (int j = 0; j < _metrics.group[i].item_cnt; j++)
+        {
+            const metric_item_t *item = &_metrics.group[i].table_ptr[j];
+            switch (item->type)
+            {
+                case metric_counter:
+                    *(uint32_t *)item->data = 0;
+                    break;
+                case metric_gauge:
+                    //The level is still the level, only the high water mark starts over
+                    ((metric_gauge_t *)item->data)->max = ((metric_gauge_t *)item->data)->value;
+                    break;
+                case metric_hist:
+                {
+                    metric_hist_t *hist = (metric_hist_t *)item->data;
+                    memset(hist->bucket, 0, sizeof(hist->bucket));
+                    hist->cnt = 0;
+                    hist->sum = 0;
+                    hist->min = 0;
+                    hist->max = 0;
+                    break;
+                }
+            }
+        }
+    }
+    _metrics.snap_cnt = 0;
+}
+
+#undef PRINTF_TAG
+#undef EXT
+/*************************** END OF FILE *************************************/
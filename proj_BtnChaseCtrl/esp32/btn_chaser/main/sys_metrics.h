@@ -0,0 +1,124 @@
+/*****************************************************************************
+
+sys_metrics.h
+
+Include file for sys_metrics.c
+
+******************************************************************************/
+#ifndef __sys_metrics_H__
+#define __sys_metrics_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************
+includes
+******************************************************************************/
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/******************************************************************************
+definitions
+******************************************************************************/
+#ifdef __NOT_EXTERN__
+#define EXT
+#else
+#define EXT extern
+#endif /* __NOT_EXTERN__ */
+
+/******************************************************************************
+Macros
+******************************************************************************/
+#define METRIC_HIST_BUCKETS     (8)     /* 7 upper bounds + 1 overflow bucket */
+
+/* Declares a histogram with its (ascending) bucket upper bounds, e.g.
+    metric_hist_t _rtt_hist = METRIC_HIST_INIT(2, 5, 10, 20, 50, 100, 200); */
+#define METRIC_HIST_INIT(b0, b1, b2, b3, b4, b5, b6) {.bounds = {b0, b1, b2, b3, b4, b5, b6}}
+
+/******************************************************************************
+Struct & Unions
+******************************************************************************/
+typedef enum
+{
+    metric_counter,     // A uint32_t that only counts up (until it is reset)
+    metric_gauge,       // A metric_gauge_t - the current level and its high water mark
+    metric_hist,        // A metric_hist_t - a fixed bucket histogram (e.g. latencies)
+}metric_type_t;
+
+typedef struct
+{
+    uint32_t value;     // The current level
+    uint32_t max;       // The highest level since the last reset
+}metric_gauge_t;
+
+typedef struct
+{
+    uint32_t bounds[METRIC_HIST_BUCKETS - 1];   // The (inclusive) upper bound of each bucket, the last bucket takes the rest
+    uint32_t bucket[METRIC_HIST_BUCKETS];
+    uint32_t cnt;       // Number of samples
+    uint32_t sum;       // Sum of all the samples (for the average)
+    uint32_t min;
+    uint32_t max;
+}metric_hist_t;
+
+typedef struct
+{
+    const char * name;
+    const char * unit;  // Displayed with the value (may be NULL)
+    metric_type_t type;
+    void * data;        // A uint32_t *, metric_gauge_t * or metric_hist_t *, depending on type
+}metric_item_t;
+
+/******************************************************************************
+Global (public) variables
+******************************************************************************/
+
+/******************************************************************************
+Global (public) function definitions
+******************************************************************************/
+
+/*! \brief Adds the "stats" command to the console
+ */
+void metrics_init(void);
+
+/*! \brief Adds a group (table) of metrics. The metrics themselves are owned
+ *          (statically declared and updated) by the calling module.
+ *          Adding the same table again does nothing, so a module can add its
+ *          table from the function that first needs it.
+ * \param _group_name The name of the group (e.g. "comms")
+ * \param _tbl The table of metrics
+ * \param _cnt The number of metrics in the table
+ * \return The number of metrics added (0 if the table could not be added)
+ */
+int metrics_add(const char * _group_name, const metric_item_t * _tbl, size_t _cnt);
+
+/*! \brief Adds a sample to a histogram
+ * \param hist The histogram
+ * \param value The sample
+ */
+void metric_hist_add(metric_hist_t * hist, uint32_t value);
+
+/*! \brief Sets the level of a gauge (and updates its high water mark)
+ * \param gauge The gauge
+ * \param value The new level
+ */
+static inline void metric_gauge_set(metric_gauge_t * gauge, uint32_t value)
+{
+    gauge->value = value;
+    if (value > gauge->max)
+        gauge->max = value;
+}
+
+/*! \brief Clears all the metrics (counters, high water marks and histograms)
+ */
+void metrics_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef EXT
+#endif /* __sys_metrics_H__ */
+
+/****************************** END OF FILE **********************************/
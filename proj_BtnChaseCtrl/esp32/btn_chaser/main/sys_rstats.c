@@ -0,0 +1,573 @@
+/*******************************************************************************
+Module:     sys_rstats.c
+Purpose:    This file contains the reaction time statistics and the leaderboard
+Author:     Rudolph van Niekerk
+
+The games add every reaction time they score to the current session (started
+and ended by the game task), which keeps an aggregate for the session, each
+player and each node (by address, so it survives the nodes moving slots). Adding
+a sample is a handful of adds and a short search of the bucket bounds.
+
+The nodes run their clocks at the master's rate once they have been synced
+(CLOCK_CORRECTION_ENABLED), so the reaction times are not corrected again here.
+The sync factor of each node is kept with its statistics instead (as the ppm
+its clock is off by), along with the presses read before it was synced, so a
+node whose times cannot be trusted stands out.
+
+NVS store (namespace RSTATS_NVS_NAMESPACE), written once at the end of a session:
+    "seq"       The number of the next session (u32)
+    "sNN"       The summary of session seq % RSTATS_NVS_SESSIONS (blob)
+    "board"     The leaderboard (blob), only written when it changed
+Each session is a new entry in the NVS log, so the writes are spread over the
+NVS pages. Only the summaries are kept, so RAM use does not grow with history.
+
+ *******************************************************************************/
+
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdarg.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <math.h>
+#include "nvs_flash.h"
+#include "nvs.h"
+
+#include "defines.h"
+#include "sys_utils.h"
+#include "sys_timers.h"
+#include "task_console.h"
+#include "task_game.h"
+#include "nodes.h"
+
+#define __NOT_EXTERN__
+#include "sys_rstats.h"
+#undef __NOT_EXTERN__
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#ifdef PRINTF_TAG
+#undef PRINTF_TAG
+#endif
+#define PRINTF_TAG ("RStats") /* This must be undefined at the end of the file*/
+
+/*******************************************************************************
+local defines
+ *******************************************************************************/
+#define RSTATS_NVS_NAMESPACE    "rstats"
+#define RSTATS_NVS_VERSION      (1)     /* Bump this if the records change (older ones are then ignored) */
+
+/*******************************************************************************
+ Local structure
+ *******************************************************************************/
+typedef struct
+{
+    uint8_t address;        // 0 if the entry is free
+    float factor;           // The last sync factor of the node (0 if never synced)
+    uint32_t unsynced;      // The presses read before the node was synced
+    rstats_agg_t agg;
+}rstats_node_t;
+
+#pragma pack(push, 1)
+/* The summary of an aggregate, as saved in NVS */
+typedef struct
+{
+    uint16_t cnt;
+    uint16_t mean_ms;
+    uint16_t sd_ms;
+    uint16_t min_ms;
+    uint16_t max_ms;
+    uint16_t p50_ms;
+    uint16_t p90_ms;
+    uint16_t p99_ms;
+}rstats_summary_t;
+
+typedef struct
+{
+    uint8_t version;
+    uint8_t game;
+    uint8_t players;        // The players who scored
+    uint8_t nodes;          // The nodes pressed
+    uint32_t seq;
+    uint32_t duration_s;
+    rstats_summary_t all;
+    rstats_summary_t player[RSTATS_PLAYERS_MAX];
+}rstats_session_rec_t;
+
+typedef struct
+{
+    uint32_t seq;           // The session
+    uint8_t game;
+    uint8_t player;
+    uint16_t cnt;
+    uint16_t mean_ms;       // Ranked on this
+    uint16_t best_ms;
+}rstats_board_entry_t;
+
+typedef struct
+{
+    uint8_t version;
+    uint8_t cnt;
+    rstats_board_entry_t entry[RSTATS_BOARD_LEN];
+}rstats_board_t;
+#pragma pack(pop)
+
+typedef struct
+{
+    uint16_t bound[RSTATS_SKETCH_BINS];    // The (inclusive) upper bound of each bucket, the last one takes the rest
+    nvs_handle_t nvs;
+    bool nvs_ok;
+    /* The current session */
+    bool running;
+    int game;
+    uint64_t start_ms;
+    rstats_agg_t all;
+    rstats_agg_t player[RSTATS_PLAYERS_MAX];
+    rstats_node_t node[RGB_BTN_MAX_NODES];
+}rstats_t;
+
+/*******************************************************************************
+ Local function prototypes
+ *******************************************************************************/
+
+/*! \brief Works out the bucket bounds of the sketch (once)
+ */
+void _rstats_bounds_init(void);
+
+/*! \brief Finds the entry of a node, or takes a free one
+ * \param address The address of the node
+ * \return The entry, or NULL if there is no space
+ */
+rstats_node_t * _rstats_node_get(uint8_t address);
+
+/*! \brief Summarises an aggregate (for NVS or the console)
+ */
+void _rstats_summarise(const rstats_agg_t * agg, rstats_summary_t * sum);
+
+/*! \brief Puts the players of the session on the leaderboard, if they are good enough
+ * \param rec The session
+ * \return true if the leaderboard changed
+ */
+bool _rstats_board_update(const rstats_session_rec_t * rec);
+
+/*! \brief Reads a blob from NVS, if it is there and of the right size and version
+ * \return true if the blob was read
+ */
+bool _rstats_nvs_read(const char * key, void * blob, size_t size);
+
+/*! \brief Displays a summary as a single line
+ * \param name The name of the line
+ * \param sum The summary
+ */
+void _rstats_print_summary(const char * name, const rstats_summary_t * sum);
+
+/*! \brief Displays the current session, the saved sessions or the leaderboard
+ */
+void _rstats_handler_rstat(void);
+
+/*******************************************************************************
+ Local variables
+ *******************************************************************************/
+ConsoleMenuItem_t _rstats_menu_items[] =
+{
+                                    //01234567890123456789012345678901234567890123456789012345678901234567890123456789
+    {"rstat",   _rstats_handler_rstat,  "Displays the reaction time statistics and the leaderboard"},
+};
+
+rstats_t _rstats = {.game = -1};
+
+/*******************************************************************************
+ Local (private) Functions
+ *******************************************************************************/
+
+void _rstats_bounds_init(void)
+{
+    float bound = RSTATS_SKETCH_MIN_MS;
+
+    if (_rstats.bound[0] != 0)
+        return; //Already done
+
+    for (int i = 0; i < RSTATS_SKETCH_BINS; i++)
+    {
+        _rstats.bound[i] = (bound < 0xFFFF)? (uint16_t)bound : 0xFFFF;
+        bound *= RSTATS_SKETCH_GAMMA;
+    }
+}
+
+rstats_node_t * _rstats_node_get(uint8_t address)
+{
+    rstats_node_t *free_node = NULL;
+
+    for (int i = 0; i < RGB_BTN_MAX_NODES; i++)
+    {
+        if (_rstats.node[i].address == address)
+            return &_rstats.node[i];
+        if ((free_node == NULL) && (_rstats.node[i].address == 0))
+            free_node = &_rstats.node[i];
+    }
+    if (free_node != NULL)
+        free_node->address = address;
+    return free_node;
+}
+
+void _rstats_summarise(const rstats_agg_t * agg, rstats_summary_t * sum)
+{
+    memset(sum, 0, sizeof(rstats_summary_t));
+    if (agg->cnt == 0)
+        return;
+
+    uint32_t mean = agg->sum / agg->cnt;
+    uint64_t var = 0;
+    if (agg->cnt > 1)
+    {
+        uint64_t sq_mean = ((uint64_t)agg->sum * agg->sum) / agg->cnt;
+        var = (agg->sum_sq > sq_mean)? (agg->sum_sq - sq_mean) / (agg->cnt - 1) : 0;
+    }
+
+    sum->cnt = (uint16_t)MIN(agg->cnt, 0xFFFF);
+    sum->mean_ms = (uint16_t)MIN(mean, 0xFFFF);
+    sum->sd_ms = (uint16_t)MIN((uint32_t)(sqrtf((float)var) + 0.5f), 0xFFFF);
+    sum->min_ms = (uint16_t)MIN(agg->min, 0xFFFF);
+    sum->max_ms = (uint16_t)MIN(agg->max, 0xFFFF);
+    sum->p50_ms = (uint16_t)MIN(rstats_agg_quantile(agg, 50), 0xFFFF);
+    sum->p90_ms = (uint16_t)MIN(rstats_agg_quantile(agg, 90), 0xFFFF);
+    sum->p99_ms = (uint16_t)MIN(rstats_agg_quantile(agg, 99), 0xFFFF);
+}
+
+bool _rstats_board_update(const rstats_session_rec_t * rec)
+{
+    rstats_board_t board;
+    bool changed = false;
+
+    if (!_rstats_nvs_read("board", &board, sizeof(board)))
+    {
+        memset(&board, 0, sizeof(board));
+        board.version = RSTATS_NVS_VERSION;
+    }
+
+    for (int p = 0; p < RSTATS_PLAYERS_MAX; p++)
+    {
+        const rstats_summary_t *sum = &rec->player[p];
+        if (sum->cnt < RSTATS_BOARD_MIN_CNT)
+            continue;
+
+        //Ranked on the mean (lowest first), the board is kept sorted
+        int pos = 0;
+        while ((pos < board.cnt) && (board.entry[pos].mean_ms <= sum->mean_ms))
+            pos++;
+        if (pos >= RSTATS_BOARD_LEN)
+            continue; //Not good enough
+
+        int last = MIN(board.cnt, RSTATS_BOARD_LEN - 1);
+        memmove(&board.entry[pos + 1], &board.entry[pos], (last - pos) * sizeof(rstats_board_entry_t));
+        board.entry[pos].seq = rec->seq;
+        board.entry[pos].game = rec->game;
+        board.entry[pos].player = (uint8_t)p;
+        board.entry[pos].cnt = sum->cnt;
+        board.entry[pos].mean_ms = sum->mean_ms;
+        board.entry[pos].best_ms = sum->min_ms;
+        board.cnt = (uint8_t)MIN(board.cnt + 1, RSTATS_BOARD_LEN);
+        iprintln(trALWAYS, "#Player %d is #%d on the leaderboard (%d ms)", p + 1, pos + 1, sum->mean_ms);
+        changed = true;
+    }
+
+    if ((changed) && (nvs_set_blob(_rstats.nvs, "board", &board, sizeof(board)) != ESP_OK))
+    {
+        iprintln(trALWAYS, "!Could not save the leaderboard");
+        return false;
+    }
+    return changed;
+}
+
+bool _rstats_nvs_read(const char * key, void * blob, size_t size)
+{
+    size_t len = size;
+
+    if ((!_rstats.nvs_ok) || (nvs_get_blob(_rstats.nvs, key, blob, &len) != ESP_OK))
+        return false;
+
+    //Both record types start with the version
+    return ((len == size) && (((uint8_t *)blob)[0] == RSTATS_NVS_VERSION));
+}
+
+void _rstats_print_summary(const char * name, const rstats_summary_t * sum)
+{
+    if (sum->cnt == 0)
+    {
+        iprintln(trALWAYS, "  %-10s %5s", name, "-");
+        return;
+    }
+    iprintln(trALWAYS, "  %-10s %5u %6u %6u %6u %6u %6u %6u %6u", name, sum->cnt, sum->mean_ms, sum->sd_ms,
+        sum->min_ms, sum->p50_ms, sum->p90_ms, sum->p99_ms, sum->max_ms);
+}
+
+void _rstats_handler_rstat(void)
+{
+    bool help_requested = false;
+    char name[16];
+    rstats_summary_t sum;
+
+    if (console_arg_cnt() > 0)
+    {
+        char *arg = console_arg_pop();
+
+        if (!strcasecmp("hist", arg))
+        {
+            uint32_t seq = 0;
+            rstats_session_rec_t rec;
+
+            if ((!_rstats.nvs_ok) || (nvs_get_u32(_rstats.nvs, "seq", &seq) != ESP_OK) || (seq == 0))
+            {
+                iprintln(trALWAYS, "No sessions saved");
+                return;
+            }
+            iprintln(trALWAYS, "  %-10s %5s %6s %6s %6s %6s %6s %6s %6s", "Session", "cnt", "mean", "sd", "min", "p50", "p90", "p99", "max");
+            for (uint32_t i = (seq > RSTATS_NVS_SESSIONS)? seq - RSTATS_NVS_SESSIONS : 0; i < seq; i++)
+            {
+                snprintf(name, sizeof(name), "s%02lu", i % RSTATS_NVS_SESSIONS);
+                if ((!_rstats_nvs_read(name, &rec, sizeof(rec))) || (rec.seq != i))
+                    continue;
+                snprintf(name, sizeof(name), "%lu", rec.seq);
+                _rstats_print_summary(name, &rec.all);
+                iprintln(trALWAYS, "  %10s %s, %lu s, %d player(s), %d node(s)", "",
+                    (rec.game < games_cnt())? game_name(rec.game) : "?", rec.duration_s, rec.players, rec.nodes);
+            }
+            return;
+        }
+
+        if (!strcasecmp("board", arg))
+        {
+            rstats_board_t board;
+
+            if ((!_rstats_nvs_read("board", &board, sizeof(board))) || (board.cnt == 0))
+            {
+                iprintln(trALWAYS, "The leaderboard is empty");
+                return;
+            }
+            iprintln(trALWAYS, "  #   %-10s %-8s %7s %5s %6s %6s", "Game", "Session", "Player", "cnt", "mean", "best");
+            for (int i = 0; i < board.cnt; i++)
+            {
+                rstats_board_entry_t *e = &board.entry[i];
+                iprintln(trALWAYS, "  %-3d %-10s %-8lu %7d %5u %6u %6u", i + 1, (e->game < games_cnt())? game_name(e->game) : "?",
+                    e->seq, e->player + 1, e->cnt, e->mean_ms, e->best_ms);
+            }
+            return;
+        }
+
+        if ((!strcasecmp("clear", arg)) || (!strcasecmp("reset", arg)))
+        {
+            if ((_rstats.nvs_ok) && (nvs_erase_all(_rstats.nvs) == ESP_OK) && (nvs_commit(_rstats.nvs) == ESP_OK))
+                iprintln(trALWAYS, "Saved sessions and leaderboard cleared");
+            else
+                iprintln(trALWAYS, "!Could not clear the saved sessions");
+            return;
+        }
+
+        if ((strcasecmp("?", arg)) && (strcasecmp("help", arg)))
+            iprintln(trALWAYS, "Invalid Argument (\"%s\")", arg);
+        help_requested = true;
+    }
+
+    if (help_requested)
+    {
+        //                  01234567890123456789012345678901234567890123456789012345678901234567890123456789
+        iprintln(trALWAYS, "Usage: \"rstat [hist|board|clear]\"");
+        iprintln(trALWAYS, "    no args: The reaction times (ms) of the current (or last) session,");
+        iprintln(trALWAYS, "             per player and per node");
+        iprintln(trALWAYS, "    hist:    The last %d sessions (saved in NVS)", RSTATS_NVS_SESSIONS);
+        iprintln(trALWAYS, "    board:   The leaderboard (the best %d mean reaction times with at", RSTATS_BOARD_LEN);
+        iprintln(trALWAYS, "             least %d presses in a session)", RSTATS_BOARD_MIN_CNT);
+        iprintln(trALWAYS, "    clear:   Erases the saved sessions and the leaderboard");
+        return;
+    }
+
+    if (_rstats.game < 0)
+    {
+        iprintln(trALWAYS, "No session yet");
+        return;
+    }
+
+    iprintln(trALWAYS, "%s (%s), %llu s:", game_name(_rstats.game), (_rstats.running)? "running" : "ended",
+        (sys_poll_tmr_ms() - _rstats.start_ms) / 1000);
+    iprintln(trALWAYS, "  %-10s %5s %6s %6s %6s %6s %6s %6s %6s", "", "cnt", "mean", "sd", "min", "p50", "p90", "p99", "max");
+    _rstats_summarise(&_rstats.all, &sum);
+    _rstats_print_summary("All", &sum);
+    for (int p = 0; p < RSTATS_PLAYERS_MAX; p++)
+    {
+        if (_rstats.player[p].cnt == 0)
+            continue;
+        snprintf(name, sizeof(name), "Player %d", p + 1);
+        _rstats_summarise(&_rstats.player[p], &sum);
+        _rstats_print_summary(name, &sum);
+    }
+    for (int i = 0; i < RGB_BTN_MAX_NODES; i++)
+    {
+        rstats_node_t *node = &_rstats.node[i];
+        if (node->address == 0)
+            continue;
+        snprintf(name, sizeof(name), "Node 0x%02X", node->address);
+        _rstats_summarise(&node->agg, &sum);
+        _rstats_print_summary(name, &sum);
+        if (node->factor == 0.0f)
+            iprintln(trALWAYS, "  %10s not synced", "");
+        else
+            iprintln(trALWAYS, "  %10s clock %+ld ppm, %lu presses before the sync", "",
+                (int32_t)((node->factor - 1.0f) * 1000000.0f), node->unsynced);
+    }
+}
+
+/*******************************************************************************
+ Global (public) Functions
+ *******************************************************************************/
+
+void rstats_init(void)
+{
+    esp_err_t err = nvs_flash_init();
+
+    _rstats_bounds_init();
+
+    if ((err == ESP_ERR_NVS_NO_FREE_PAGES) || (err == ESP_ERR_NVS_NEW_VERSION_FOUND))
+    {
+        //The NVS partition was truncated or is from another version of the IDF... start over
+        iprintln(trALWAYS, "!NVS erased (%s)", esp_err_to_name(err));
+        if (nvs_flash_erase() == ESP_OK)
+            err = nvs_flash_init();
+    }
+    if (err == ESP_OK)
+        err = nvs_open(RSTATS_NVS_NAMESPACE, NVS_READWRITE, &_rstats.nvs);
+    _rstats.nvs_ok = (err == ESP_OK);
+    if (!_rstats.nvs_ok)
+        iprintln(trALWAYS, "!The reaction times will not be saved (%s)", esp_err_to_name(err));
+
+    console_add_menu("rstat", _rstats_menu_items, ARRAY_SIZE(_rstats_menu_items), "Reaction Statistics");
+}
+
+void rstats_session_start(int game)
+{
+    _rstats_bounds_init();
+
+    memset(&_rstats.all, 0, sizeof(_rstats.all));
+    memset(_rstats.player, 0, sizeof(_rstats.player));
+    memset(_rstats.node, 0, sizeof(_rstats.node));
+    _rstats.game = game;
+    _rstats.start_ms = sys_poll_tmr_ms();
+    _rstats.running = true;
+}
+
+void rstats_session_end(void)
+{
+    rstats_session_rec_t rec = {0};
+    char key[8];
+
+    if (!_rstats.running)
+        return;
+    _rstats.running = false;
+
+    if ((_rstats.all.cnt == 0) || (!_rstats.nvs_ok))
+        return; //Nothing to save (or nowhere to save it)
+
+    if (nvs_get_u32(_rstats.nvs, "seq", &rec.seq) != ESP_OK)
+        rec.seq = 0;
+    rec.version = RSTATS_NVS_VERSION;
+    rec.game = (uint8_t)_rstats.game;
+    rec.duration_s = (uint32_t)((sys_poll_tmr_ms() - _rstats.start_ms) / 1000);
+    _rstats_summarise(&_rstats.all, &rec.all);
+    for (int p = 0; p < RSTATS_PLAYERS_MAX; p++)
+    {
+        _rstats_summarise(&_rstats.player[p], &rec.player[p]);
+        if (rec.player[p].cnt > 0)
+            rec.players++;
+    }
+    for (int i = 0; i < RGB_BTN_MAX_NODES; i++)
+        if (_rstats.node[i].agg.cnt > 0)
+            rec.nodes++;
+
+    snprintf(key, sizeof(key), "s%02lu", rec.seq % RSTATS_NVS_SESSIONS);
+    if ((nvs_set_blob(_rstats.nvs, key, &rec, sizeof(rec)) != ESP_OK) ||
+        (nvs_set_u32(_rstats.nvs, "seq", rec.seq + 1) != ESP_OK))
+    {
+        iprintln(trALWAYS, "!Could not save session %lu", rec.seq);
+        return;
+    }
+    _rstats_board_update(&rec);
+    if (nvs_commit(_rstats.nvs) != ESP_OK)
+        iprintln(trALWAYS, "!Could not save session %lu", rec.seq);
+    else
+        iprintln(trALWAYS, "#Session %lu saved (%d presses, %d ms avg)", rec.seq, rec.all.cnt, rec.all.mean_ms);
+}
+
+void rstats_add(int player, int slot, uint32_t reaction_ms)
+{
+    rstats_node_t *node;
+
+    if ((!_rstats.running) || (reaction_ms == 0))
+        return;
+
+    rstats_agg_add(&_rstats.all, reaction_ms);
+    if ((player >= 0) && (player < RSTATS_PLAYERS_MAX))
+        rstats_agg_add(&_rstats.player[player], reaction_ms);
+
+    if ((!is_node_valid(slot)) || ((node = _rstats_node_get(get_node_addr(slot))) == NULL))
+        return;
+    rstats_agg_add(&node->agg, reaction_ms);
+    node->factor = get_node_btn_correction_factor(slot);
+    if (node->factor == 0.0f)
+        node->unsynced++;
+}
+
+void rstats_agg_add(rstats_agg_t * agg, uint32_t value)
+{
+    int i = 0;
+
+    //The bounds only go up to ~14 s, so this is a short walk
+    while ((i < (RSTATS_SKETCH_BINS - 1)) && (value > _rstats.bound[i]))
+        i++;
+    if (agg->bin[i] < 0xFFFF)
+        agg->bin[i]++;
+
+    if ((agg->cnt == 0) || (value < agg->min))
+        agg->min = value;
+    if (value > agg->max)
+        agg->max = value;
+    agg->cnt++;
+    agg->sum += value;
+    agg->sum_sq += (uint64_t)value * value;
+}
+
+uint32_t rstats_agg_quantile(const rstats_agg_t * agg, uint32_t pct)
+{
+    uint32_t total = 0;
+    uint32_t seen = 0;
+
+    for (int i = 0; i < RSTATS_SKETCH_BINS; i++)
+        total += agg->bin[i];
+    if (total == 0)
+        return 0;
+
+    //The rank we are looking for (1 based)
+    uint32_t rank = MAX(1, (total * MIN(pct, 100) + 99) / 100);
+    for (int i = 0; i < RSTATS_SKETCH_BINS; i++)
+    {
+        seen += agg->bin[i];
+        if (seen < rank)
+            continue;
+
+        //Spread evenly over the bucket, but never outside what was seen
+        uint32_t lower = MAX((i > 0)? _rstats.bound[i - 1] : 0, agg->min);
+        uint32_t upper = MIN((i < (RSTATS_SKETCH_BINS - 1))? _rstats.bound[i] : agg->max, agg->max);
+        if (upper <= lower)
+            return lower;
+        return lower + ((upper - lower) * (rank - (seen - agg->bin[i]))) / agg->bin[i];
+    }
+    return agg->max;
+}
+
+#undef PRINTF_TAG
+#undef EXT
+/*************************** END OF FILE *************************************/
@@ -0,0 +1,113 @@
+/*****************************************************************************
+
+sys_rstats.h
+
+Include file for sys_rstats.c
+
+The reaction time statistics of the current session (game), per player and
+per node: count, mean, standard deviation, min/max and the P50/P90/P99 from a
+quantile sketch. The sketch is a histogram with log spaced buckets (each
+RSTATS_SKETCH_GAMMA wider than the one before), so the quantiles are within
+a bucket (15%) of the real value, in a fixed amount of RAM. The samples are
+taken to be spread evenly over a bucket, which is mostly a lot closer.
+
+When a session ends, its summary is saved to NVS (the last RSTATS_NVS_SESSIONS
+sessions) and the best players go on the leaderboard.
+
+******************************************************************************/
+#ifndef __sys_rstats_H__
+#define __sys_rstats_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************
+includes
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************
+definitions
+******************************************************************************/
+#ifdef __NOT_EXTERN__
+#define EXT
+#else
+#define EXT extern
+#endif /* __NOT_EXTERN__ */
+
+/******************************************************************************
+Macros
+******************************************************************************/
+#define RSTATS_PLAYERS_MAX      (4)     /* The players kept apart in a session */
+#define RSTATS_SKETCH_BINS      (48)    /* The buckets of the quantile sketch */
+#define RSTATS_SKETCH_MIN_MS    (20)    /* The upper bound of the 1st bucket */
+#define RSTATS_SKETCH_GAMMA     (1.15f) /* The ratio between the bounds of adjacent buckets (up to ~14 s) */
+
+#define RSTATS_NVS_SESSIONS     (16)    /* The session summaries kept in NVS (the oldest is overwritten) */
+#define RSTATS_BOARD_LEN        (10)    /* The entries on the leaderboard */
+#define RSTATS_BOARD_MIN_CNT    (5)     /* The presses a player needs in a session to make the leaderboard */
+
+/******************************************************************************
+Struct & Unions
+******************************************************************************/
+/* A streaming aggregate of reaction times */
+typedef struct
+{
+    uint32_t cnt;
+    uint32_t sum;                       // ms
+    uint64_t sum_sq;                    // ms^2 (for the variance)
+    uint32_t min;
+    uint32_t max;
+    uint16_t bin[RSTATS_SKETCH_BINS];   // The quantile sketch (saturates at 0xFFFF)
+}rstats_agg_t;
+
+/******************************************************************************
+Global (public) variables
+******************************************************************************/
+
+/******************************************************************************
+Global (public) function definitions
+******************************************************************************/
+
+/*! \brief Opens the statistics store in NVS and adds the "rstat" command to the console
+ */
+void rstats_init(void);
+
+/*! \brief Starts a new session, clearing the statistics of the previous one
+ * \param game The index of the game being played
+ */
+void rstats_session_start(int game);
+
+/*! \brief Ends the session, saving its summary (if there were any presses) to NVS
+ */
+void rstats_session_end(void);
+
+/*! \brief Adds a reaction time to the session, the player and the node
+ * \param player The player who pressed the button (0 to RSTATS_PLAYERS_MAX-1)
+ * \param slot The node the button was pressed on
+ * \param reaction_ms The reaction time (as read from the node)
+ */
+void rstats_add(int player, int slot, uint32_t reaction_ms);
+
+/*! \brief Adds a sample to an aggregate
+ * \param agg The aggregate
+ * \param value The sample
+ */
+void rstats_agg_add(rstats_agg_t * agg, uint32_t value);
+
+/*! \brief Estimates a quantile from the sketch of an aggregate
+ * \param agg The aggregate
+ * \param pct The quantile (0 to 100)
+ * \return The estimate (0 if there are no samples)
+ */
+uint32_t rstats_agg_quantile(const rstats_agg_t * agg, uint32_t pct);
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef EXT
+#endif /* __sys_rstats_H__ */
+
+/****************************** END OF FILE **********************************/
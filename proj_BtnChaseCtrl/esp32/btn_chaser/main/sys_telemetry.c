@@ -0,0 +1,227 @@
+/*******************************************************************************
+Module:     sys_telemetry.c
+Purpose:    This file contains the machine readable telemetry stream
+Author:     Rudolph van Niekerk
+
+The records (reaction times, RTT samples, bus counters and game events) are
+written to the console port as they happen, stamped with the master time. They
+are meant to be captured on the host and decoded offline (see
+tools/telemetry_decode.py), so the format is in sys_telemetry.h.
+
+Each record goes out with a single printf/fwrite, so it is not broken up by
+console text from another task.
+
+ *******************************************************************************/
+
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdarg.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include "esp_timer.h"
+
+#include "defines.h"
+#include "sys_utils.h"
+#include "sys_timers.h"
+#include "task_console.h"
+#include "../../../../common/common_comms.h"
+#include "task_comms.h"
+
+#define __NOT_EXTERN__
+#include "sys_telemetry.h"
+#undef __NOT_EXTERN__
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#ifdef PRINTF_TAG
+#undef PRINTF_TAG
+#endif
+#define PRINTF_TAG ("Tlm") /* This must be undefined at the end of the file*/
+
+/*******************************************************************************
+local defines
+ *******************************************************************************/
+#define TLM_FIELDS_MAX      (8)     /* The max number of fields in a record */
+
+/*******************************************************************************
+ Local structure
+ *******************************************************************************/
+typedef struct
+{
+    tlm_mode_t mode;
+    esp_timer_handle_t bus_tmr;
+    comms_stats_t bus_prev;     // The bus counters at the start of the current period
+    uint64_t bus_prev_ms;
+}telemetry_t;
+
+/*******************************************************************************
+ Local function prototypes
+ *******************************************************************************/
+
+/*! \brief Reports the bus counters for the period that just ended
+ * \param arg Not used
+ */
+void _telemetry_bus_report(void *arg);
+
+/*! \brief Selects (or displays) the telemetry output
+ */
+void _telemetry_handler_tlm(void);
+
+/*******************************************************************************
+ Local variables
+ *******************************************************************************/
+ConsoleMenuItem_t _telemetry_menu_items[] =
+{
+                                    //01234567890123456789012345678901234567890123456789012345678901234567890123456789
+    {"tlm",     _telemetry_handler_tlm, "Streams telemetry records (for offline analysis)"},
+};
+
+static const char * _tlm_mode_str[] = {"off", "csv", "bin"};
+
+static esp_timer_create_args_t _tlm_bus_tmr_args = {
+    .callback = _telemetry_bus_report,
+    .name = "tlm_bus_tmr",
+};
+
+telemetry_t _tlm = {0};
+
+/*******************************************************************************
+ Local (private) Functions
+ *******************************************************************************/
+
+void _telemetry_bus_report(void *arg)
+{
+    comms_stats_t now;
+    uint64_t now_ms = sys_poll_tmr_ms();
+
+    comms_stats_get(&now, false);
+
+    uint32_t errors = (now.crc_err + now.version_err + now.length_err + now.frag_err + now.rx_lost + now.uart_err + now.echo_err) -
+        (_tlm.bus_prev.crc_err + _tlm.bus_prev.version_err + _tlm.bus_prev.length_err + _tlm.bus_prev.frag_err +
+         _tlm.bus_prev.rx_lost + _tlm.bus_prev.uart_err + _tlm.bus_prev.echo_err);
+
+    tlm_send(tlm_bus,
+        (uint32_t)(now_ms - _tlm.bus_prev_ms),
+        now.tx_bytes - _tlm.bus_prev.tx_bytes,
+        now.rx_bytes - _tlm.bus_prev.rx_bytes,
+        now.tx_frames - _tlm.bus_prev.tx_frames,
+        now.rx_frames - _tlm.bus_prev.rx_frames,
+        errors);
+
+    memcpy(&_tlm.bus_prev, &now, sizeof(comms_stats_t));
+    _tlm.bus_prev_ms = now_ms;
+}
+
+void _telemetry_handler_tlm(void)
+{
+    bool help_requested = false;
+
+    if (console_arg_cnt() > 0)
+	{
+        char *arg = console_arg_pop();
+        help_requested = true;
+        for (int i = 0; i < ARRAY_SIZE(_tlm_mode_str); i++)
+        {
+            if (!strcasecmp(_tlm_mode_str[i], arg))
+            {
+                telemetry_mode_set((tlm_mode_t)i);
+                help_requested = false;
+            }
+        }
+        if ((help_requested) && (strcasecmp("?", arg)) && (strcasecmp("help", arg)))
+            iprintln(trALWAYS, "Invalid Argument (\"%s\")", arg);
+    }
+
+    if (help_requested)
+    {
+        //                  01234567890123456789012345678901234567890123456789012345678901234567890123456789
+        iprintln(trALWAYS, "Usage: \"tlm [off|csv|bin]\"");
+        iprintln(trALWAYS, "    no args: Displays the current telemetry output");
+        iprintln(trALWAYS, "    off:     No telemetry");
+        iprintln(trALWAYS, "    csv:     Streams \"%s,<type>,<time_ms>,...\" lines", TLM_CSV_PREFIX);
+        iprintln(trALWAYS, "    bin:     Streams binary frames (starting with 0x%02X)", TLM_FRAME_SYNC);
+        iprintln(trALWAYS, "    The bus counters are reported every %d ms", TLM_BUS_PERIOD_MS);
+        return;
+    }
+
+    iprintln(trALWAYS, "Telemetry: %s", _tlm_mode_str[_tlm.mode]);
+}
+
+/*******************************************************************************
+ Global (public) Functions
+ *******************************************************************************/
+
+void telemetry_init(void)
+{
+    if (_tlm.bus_tmr == NULL)
+        ESP_ERROR_CHECK(esp_timer_create(&_tlm_bus_tmr_args, &_tlm.bus_tmr));
+
+	console_add_menu("tlm", _telemetry_menu_items, ARRAY_SIZE(_telemetry_menu_items), "Telemetry");
+}
+
+void telemetry_mode_set(tlm_mode_t mode)
+{
+    if (mode == _tlm.mode)
+        return;
+
+    if ((_tlm.mode == tlm_off) && (_tlm.bus_tmr != NULL))
+    {
+        //The first period starts now
+        comms_stats_get(&_tlm.bus_prev, false);
+        _tlm.bus_prev_ms = sys_poll_tmr_ms();
+        esp_timer_start_periodic(_tlm.bus_tmr, TLM_BUS_PERIOD_MS * 1000LL);
+    }
+    else if ((mode == tlm_off) && (_tlm.bus_tmr != NULL))
+        esp_timer_stop(_tlm.bus_tmr);
+
+    _tlm.mode = mode;
+}
+
+bool telemetry_enabled(void)
+{
+    return (_tlm.mode != tlm_off);
+}
+
+void telemetry_record(tlm_type_t type, const uint32_t * fields, int cnt)
+{
+    uint32_t time_ms = (uint32_t)sys_poll_tmr_ms();
+
+    cnt = min(cnt, TLM_FIELDS_MAX);
+
+    if (_tlm.mode == tlm_csv)
+    {
+        char line[sizeof(TLM_CSV_PREFIX) + 4 + ((TLM_FIELDS_MAX + 1) * 11) + 2];
+        int len = snprintf(line, sizeof(line), TLM_CSV_PREFIX ",%c,%lu", (char)type, time_ms);
+        for (int i = 0; i < cnt; i++)
+            len += snprintf(&line[len], sizeof(line) - len, ",%lu", fields[i]);
+        printf("%s\n", line);
+    }
+    else if (_tlm.mode == tlm_bin)
+    {
+        uint8_t frame[3 + ((TLM_FIELDS_MAX + 1) * sizeof(uint32_t)) + 1];
+        int len = 0;
+        frame[len++] = TLM_FRAME_SYNC;
+        frame[len++] = (uint8_t)type;
+        frame[len++] = (uint8_t)((cnt + 1) * sizeof(uint32_t));
+        //The ESP32 is little endian, so the fields are copied as is
+        memcpy(&frame[len], &time_ms, sizeof(uint32_t));
+        len += sizeof(uint32_t);
+        memcpy(&frame[len], fields, cnt * sizeof(uint32_t));
+        len += cnt * sizeof(uint32_t);
+        frame[len] = crc8_n(0, &frame[1], len - 1);
+        len++;
+        fwrite(frame, 1, len, stdout);
+        fflush(stdout);
+    }
+}
+
+#undef PRINTF_TAG
+#undef EXT
+/*************************** END OF FILE *************************************/
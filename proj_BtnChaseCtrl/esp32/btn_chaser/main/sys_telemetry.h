@@ -0,0 +1,122 @@
+/*****************************************************************************
+
+sys_telemetry.h
+
+Include file for sys_telemetry.c
+
+Telemetry records are streamed on the console port, mixed in with the normal
+console text, either as:
+    - CSV lines:     "$TLM,<type>,<time_ms>,<field>,<field>,...\n"
+    - binary frames: TLM_FRAME_SYNC, <type>, <len>, <payload (len bytes)>, <crc8>
+                     The CRC (crc8_n) is over type, len and the payload. The
+                     payload starts with the 32-bit time (ms), followed by the
+                     fields of the record, all little endian.
+
+The fields of each record type (in order, all unsigned) are:
+    tlm_reaction:   node (slot), address, reaction time (ms)
+    tlm_rtt:        node (slot), address, round trip time (ms)
+    tlm_bus:        period (ms), tx bytes, rx bytes, frames tx, frames rx, errors
+    tlm_game:       event (tlm_game_event_t), game index, argument
+
+tools/telemetry_decode.py turns a captured stream into summary statistics.
+
+******************************************************************************/
+#ifndef __sys_telemetry_H__
+#define __sys_telemetry_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************
+includes
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************
+definitions
+******************************************************************************/
+#ifdef __NOT_EXTERN__
+#define EXT
+#else
+#define EXT extern
+#endif /* __NOT_EXTERN__ */
+
+/******************************************************************************
+Macros
+******************************************************************************/
+#define TLM_FRAME_SYNC          (0xA5)  /* The first byte of a binary telemetry frame */
+#define TLM_CSV_PREFIX          "$TLM"  /* The start of a CSV telemetry line */
+#define TLM_BUS_PERIOD_MS       (1000)  /* How often the bus counters are reported */
+
+/******************************************************************************
+Struct & Unions
+******************************************************************************/
+typedef enum
+{
+    tlm_off = 0,        // No telemetry (default)
+    tlm_csv,            // CSV lines
+    tlm_bin,            // Binary frames
+}tlm_mode_t;
+
+typedef enum
+{
+    tlm_reaction    = 'P',  // A button press (reaction time)
+    tlm_rtt         = 'R',  // A node RTT sample
+    tlm_bus         = 'B',  // Bus counters over the last period
+    tlm_game        = 'G',  // A game event
+}tlm_type_t;
+
+typedef enum
+{
+    tlm_game_start = 0,     // arg: 0
+    tlm_game_registered,    // arg: number of nodes registered
+    tlm_game_running,       // arg: 0
+    tlm_game_paused,        // arg: 0
+    tlm_game_resumed,       // arg: 0
+    tlm_game_end,           // arg: 0
+}tlm_game_event_t;
+
+/******************************************************************************
+Global (public) variables
+******************************************************************************/
+
+/******************************************************************************
+Global (public) function definitions
+******************************************************************************/
+
+/*! \brief Adds the "tlm" command to the console and starts the timer that
+ *          reports the bus counters (while the telemetry is enabled)
+ */
+void telemetry_init(void);
+
+/*! \brief Selects the telemetry output
+ * \param mode tlm_off, tlm_csv or tlm_bin
+ */
+void telemetry_mode_set(tlm_mode_t mode);
+
+/*! \brief Checks if telemetry records are being streamed
+ * \return true if the telemetry is enabled
+ */
+bool telemetry_enabled(void);
+
+/*! \brief Streams a telemetry record (does nothing if the telemetry is off)
+ * \param type The type of record
+ * \param fields The fields of the record (see the list above)
+ * \param cnt The number of fields
+ */
+void telemetry_record(tlm_type_t type, const uint32_t * fields, int cnt);
+
+/*! \brief Streams a telemetry record, e.g. tlm_send(tlm_rtt, slot, addr, rtt_ms);
+ */
+#define tlm_send(type, ...) do { if (telemetry_enabled()) \
+    telemetry_record((type), (const uint32_t []){__VA_ARGS__}, sizeof((const uint32_t []){__VA_ARGS__})/sizeof(uint32_t)); } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef EXT
+#endif /* __sys_telemetry_H__ */
+
+/****************************** END OF FILE **********************************/
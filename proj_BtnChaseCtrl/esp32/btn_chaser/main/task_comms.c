@@ -31,6 +31,7 @@ includes
 #include "freertos/task.h"
 
 #include "task_console.h"
+#include "sys_metrics.h"
 
 #include "driver/uart.h"
 #include "esp_timer.h"
@@ -76,6 +77,9 @@ Macros and Constants
 #define COMMS_MSG_RX_Q_LEN           (32)
 
 #define RESPONSE_MSG_SIZE_MIN_SIZE (sizeof(comms_msg_hdr_t) + sizeof(uint8_t) + 2) // Minimum size of a response message is the header + 1 byte crc, cmd and response, respectively
+#define FRAGMENT_SIZE_MIN_SIZE     (sizeof(comms_msg_hdr_t) + sizeof(uint8_t) + 1) // The last fragment of a message can carry as little as 1 byte
+
+#define COMMS_FRAG_GAP_MS           (BUS_SILENCE_MIN_MS) /* Gives the nodes time to empty their (single) frame buffer between fragments */
 
 /*******************************************************************************
 local defines 
@@ -109,6 +113,7 @@ typedef struct{
 	TaskInfo_t task;
     task_comms_rs485_t rs485;
     rgb_button_t btn[32];
+    comms_stats_t stats;
 }comms_t;
 
 typedef enum e_comms_msg_rx_state
@@ -119,13 +124,19 @@ typedef enum e_comms_msg_rx_state
 }comms_rx_state_t;
 
 typedef struct {
-    comms_msg_t msg;
+    comms_frame_t msg;
     size_t length;
     size_t data_length;
     // int8_t data_rd_index;
     comms_rx_state_t state;
 }comms_rx_msg_t;
 
+typedef struct {
+    comms_msg_t msg;        // The message being reassembled
+    size_t data_length;     // The data received so far
+    uint8_t next_frag;      // The index of the next fragment we expect (0 if we are not busy with a message)
+}comms_reassembly_t;
+
 typedef struct {
     comms_msg_t msg;
     size_t msg_size;
@@ -141,6 +152,8 @@ void _rx_msg_handler(uart_event_t *rx_event);
 void _tx_msg_handler(comms_msg_queue_item_t *tx_event);
 void _comms_deinit(void);
 bool _rx_data_process(uint8_t rx_data);
+bool _rx_reassemble(comms_msg_queue_item_t * rx_q_item);
+bool _tx_queue_wait(void);
 void _bus_silence_expired(void *arg);
 
 void _comms_handler_rc(void);
@@ -202,10 +215,29 @@ static esp_timer_handle_t _bus_silence_tmr = NULL;
 const int comms_uart_buffer_size = (1024);//(RGB_BTN_MSG_MAX_LEN);// + 2; //Absolute worst case scenario... every character in the msg escaped, plus STX and ETX
 
 comms_rx_msg_t _rx = {0};
+comms_reassembly_t _reassembly = {0};
 
 //comms_tx_msg_t _tx = {0};
 uint8_t _tx_seq = 0; //Sequence number for the next message to be sent
 
+metric_hist_t _bus_wait_hist = METRIC_HIST_INIT(0, 1, 2, 5, 10, 20, 50);  // Time spent waiting for the bus to go silent before a TX (ms)
+metric_gauge_t _rx_q_gauge = {0};                                       // Msgs waiting in the RX queue for the application
+
+const metric_item_t _comms_metrics[] =
+{
+    {"tx_frames",   NULL,   metric_counter, &_comms.stats.tx_frames},
+    {"rx_frames",   NULL,   metric_counter, &_comms.stats.rx_frames},
+    {"crc_err",     NULL,   metric_counter, &_comms.stats.crc_err},
+    {"version_err", NULL,   metric_counter, &_comms.stats.version_err},
+    {"length_err",  NULL,   metric_counter, &_comms.stats.length_err},
+    {"frag_err",    NULL,   metric_counter, &_comms.stats.frag_err},
+    {"rx_lost",     NULL,   metric_counter, &_comms.stats.rx_lost},
+    {"uart_err",    NULL,   metric_counter, &_comms.stats.uart_err},
+    {"echo_err",    NULL,   metric_counter, &_comms.stats.echo_err},
+    {"rx_queue",    "msgs", metric_gauge,   &_rx_q_gauge},
+    {"bus_wait",    "ms",   metric_hist,    &_bus_wait_hist},
+};
+
 /*******************************************************************************
  Local (private) Functions
  *******************************************************************************/
@@ -215,7 +247,7 @@ void _bus_silence_expired(void *arg)
     // Obviously a transmission was interrupted and we need to start over again.
     if (_rx.state != rx_listen)
     {
-        iprintln(trCOMMS, "#Bus silent for 15ms (0x%02X)", _rx.state);
+        itrace(trCOMMS, "#Bus silent for 15ms (0x%02X)", _rx.state);
         _rx.state = rx_listen;
     }
 }
@@ -227,7 +259,7 @@ void _comms_main_func(void * pvParameters)
 
 
     // Setup UART buffered IO with event queue
-    ESP_ERROR_CHECK(uart_driver_install(UART_NUM_1, comms_uart_buffer_size, 0, (2 * RGB_BTN_MSG_MAX_LEN) + 2, &_comms.rs485.rx_queue, 0));
+    ESP_ERROR_CHECK(uart_driver_install(UART_NUM_1, comms_uart_buffer_size, 0, (2 * RGB_BTN_FRAME_MAX_LEN) + 2, &_comms.rs485.rx_queue, 0));
     /* From the function prototype description:     tx_buffer_size -- UART TX ring buffer size. If set to zero, driver will not use TX buffer, 
                                                                         TX function will block task until all data have been sent out.  
         But this does not seem to ring true in pratical terms... can be tested by setting USE_BUILTIN_RS485_UART to 0*/
@@ -280,16 +312,17 @@ void _comms_main_func(void * pvParameters)
             if (_rx.state == rx_listen)
             { 
                 //This means 15ms of bus silence has passed and we have not received an echo of the message we just sent
+                _comms.stats.echo_err++;
                 if ( _tx.retry_cnt < 5)
                 {
                     // tx_q_msg should still contain the message we want to (re)send.
-                    iprintln(trCOMMS, "#No ECHO Rx'd (seq %d)", tx_q_msg.msg.hdr.id);
+                    itrace(trCOMMS, "#No ECHO Rx'd (seq %d)", tx_q_msg.msg.hdr.id);
                     _tx_msg_handler(&tx_q_msg); //Handle the message to be transmitted
                 }
                 else
                 {
                     //We have retried this message too many times, so we need to give up and move on
-                    iprintln(trCOMMS, "#TX Abandonded after %d tries (0x%02X)", _tx.retry_cnt, tx_q_msg.msg.hdr.id);
+                    itrace(trCOMMS, "#TX Abandonded after %d tries (0x%02X)", _tx.retry_cnt, tx_q_msg.msg.hdr.id);
                     _tx.state = tx_idle; //Return to an idle state, so that we can start a new message
                     ESP_ERROR_CHECK(gpio_set_level(output_RS485_DE, 0)); // Set RS485 DE pin to low
                 }
@@ -319,6 +352,7 @@ void _rx_msg_handler(uart_event_t *rx_event)
         case UART_DATA:
             // Data received
             //iprintln(trCOMMS, "#Data received: (%d bytes)", rx_event->size);
+            _comms.stats.rx_bytes += rx_event->size;
             for (int i = 0; i < rx_event->size; i++)
             {
                 uint8_t data = 0;
@@ -329,28 +363,42 @@ void _rx_msg_handler(uart_event_t *rx_event)
                     uint8_t crc = crc8_n(0, (uint8_t *)&_rx.msg, _rx.length);
                     if (crc != 0)
                     {
-                        iprintln(trCOMMS, "#RX Error: CRC (0x%02X vs 0x%02X)", ((uint8_t*)&_rx.msg)[_rx.length-1], (uint8_t)crc8_n(0, (uint8_t *)&_rx.msg, _rx.length-1));
+                        _comms.stats.crc_err++;
+                        itrace(trCOMMS, "!RX: CRC (0x%02X vs 0x%02X)", ((uint8_t*)&_rx.msg)[_rx.length-1], (uint8_t)crc8_n(0, (uint8_t *)&_rx.msg, _rx.length-1));
                     }
-                    else if (_rx.msg.hdr.version > RGB_BTN_MSG_VERSION)
+                    else if (_rx.msg.hdr.version != RGB_BTN_MSG_VERSION)
                     {
-                        iprintln(trCOMMS, "#RX Error: Msg version > %d (%d)", RGB_BTN_MSG_VERSION, _rx.msg.hdr.version);
+                        _comms.stats.version_err++;
+                        itrace(trCOMMS, "!RX: Msg version != %d (%d)", RGB_BTN_MSG_VERSION, _rx.msg.hdr.version);
                     }
-                    else if (_rx.length < RESPONSE_MSG_SIZE_MIN_SIZE)
+                    else if (_rx.length < ((_rx.msg.hdr.frag == 0)? RESPONSE_MSG_SIZE_MIN_SIZE : FRAGMENT_SIZE_MIN_SIZE))
                     {
-                        iprintln(trCOMMS, "#RX Error: Msg too short > %d (%d)", RESPONSE_MSG_SIZE_MIN_SIZE, _rx.length);
+                        _comms.stats.length_err++;
+                        itrace(trCOMMS, "!RX: Msg too short > %d (%d)", RESPONSE_MSG_SIZE_MIN_SIZE, _rx.length);
+                    }
+                    else if (_rx.msg.hdr.len != (_rx.length - sizeof(comms_msg_hdr_t) - sizeof(uint8_t)))
+                    {
+                        _comms.stats.length_err++;
+                        itrace(trCOMMS, "!RX: Msg length %d vs %d", _rx.msg.hdr.len, (_rx.length - sizeof(comms_msg_hdr_t) - sizeof(uint8_t)));
                     }
                     else //CRC is good, Version is Good, Sync # is good - I guess we are done?
                     {
                         comms_msg_queue_item_t _rx_msg_q_item = {0};
-                        iprintln(trCOMMS, "#RX Msg: ");
-                        console_print_memory(trCOMMS, (uint8_t *)&_rx.msg, 0, _rx.length);
-                        memcpy(&_rx_msg_q_item.msg, &_rx.msg, _rx.length); //Copy the message to the queue item
-                        _rx_msg_q_item.msg_size = _rx.length; //Set the message size
+                        itrace(trCOMMS, "#RX Msg: ");
+                        console_trace_memory(trCOMMS, PRINTF_TAG, (uint8_t *)&_rx.msg, 0, _rx.length);
+                        if (!_rx_reassemble(&_rx_msg_q_item))
+                            continue; //Waiting for more fragments (or a fragment was dropped)
                         //This message can be passed up the queue to the application
                         if (xQueueSend(_comms.rs485.rx_msg_queue, (void *)&_rx_msg_q_item, 0) != pdTRUE)
                         {
-                            iprintln(trCOMMS, "#Msg Lost (queue full): ");
-                            console_print_memory(trCOMMS, (uint8_t *)&_rx.msg, 0, _rx.length);                            
+                            _comms.stats.rx_lost++;
+                            itrace(trCOMMS, "#Msg Lost (queue full): ");
+                            console_trace_memory(trCOMMS, PRINTF_TAG, (uint8_t *)&_rx_msg_q_item.msg, 0, _rx_msg_q_item.msg_size);
+                        }
+                        else
+                        {
+                            _comms.stats.rx_frames++;
+                            metric_gauge_set(&_rx_q_gauge, uxQueueMessagesWaiting(_comms.rs485.rx_msg_queue));
                         }
                     }
                 }
@@ -358,47 +406,52 @@ void _rx_msg_handler(uart_event_t *rx_event)
             break;
         case UART_FRAME_ERR:
             // UART frame error detected
-            iprintln(trCOMMS, "#Frame error detected");
+            _comms.stats.uart_err++;
+            itrace(trCOMMS, "#Frame error detected");
             break;                    
         case UART_FIFO_OVF:
             // UART RX FIFO overflow
-            iprintln(trCOMMS, "#RX FIFO overflow");
+            _comms.stats.uart_err++;
+            itrace(trCOMMS, "#RX FIFO overflow");
             uart_flush_input(UART_NUM_1);
             break;
         case UART_BUFFER_FULL:
             // UART RX buffer full
-            iprintln(trCOMMS, "#RX buffer full");
+            _comms.stats.uart_err++;
+            itrace(trCOMMS, "#RX buffer full");
             uart_flush_input(UART_NUM_1);
             break;
         case UART_BREAK:
             // UART RX break detected
-            iprintln(trCOMMS, "#RX break detected");
+            itrace(trCOMMS, "#RX break detected");
             break;
         default:
-            iprintln(trCOMMS, "#??? Event: 0x%04X", rx_event->type);
+            itrace(trCOMMS, "#??? Event: 0x%04X", rx_event->type);
             break;
     }
 }
 
 void _tx_msg_handler(comms_msg_queue_item_t *tx_q_msg)
 {
-    uint8_t tx_data[2 + (2*RGB_BTN_MSG_MAX_LEN)];
+    uint8_t tx_data[2 + (2*RGB_BTN_FRAME_MAX_LEN)];
     size_t tx_data_len = 0;
     //No data received on the RS485 bus, but we have a message to send
 #if USE_BUILTIN_RS485_UART == 0    
     _tx.retry_cnt++;
-    iprintln(trCOMMS, "#TX: %d bytes (%d), attempt %d", tx_q_msg->msg_size, tx_q_msg->msg.hdr.id, _tx.retry_cnt);
+    itrace(trCOMMS, "#TX: %d bytes (%d), attempt %d", tx_q_msg->msg_size, tx_q_msg->msg.hdr.id, _tx.retry_cnt);
 #else
-    iprintln(trCOMMS, "#TX: %d bytes (%d)", tx_q_msg->msg_size, tx_q_msg->msg.hdr.id);
-    console_print_memory(trCOMMS, (uint8_t *)&tx_q_msg->msg, 0, tx_q_msg->msg_size);
+    itrace(trCOMMS, "#TX: %d bytes (%d)", tx_q_msg->msg_size, tx_q_msg->msg.hdr.id);
+    console_trace_memory(trCOMMS, PRINTF_TAG, (uint8_t *)&tx_q_msg->msg, 0, tx_q_msg->msg_size);
 #endif
 
     //wait here for the bus to go silent!
+    uint64_t _wait_start_us = esp_timer_get_time();
     while (_rx.state != rx_listen)
     {
         //Wait for the bus to be free (if not already free, it should happen in no more than 15ms)
         vTaskDelay(1); //Wait for 1 tick
     }
+    metric_hist_add(&_bus_wait_hist, (uint32_t)((esp_timer_get_time() - _wait_start_us) / 1000));
 
     //Handle the framing and escaping of the message here....
     tx_data_len = 0;
@@ -421,6 +474,8 @@ void _tx_msg_handler(comms_msg_queue_item_t *tx_q_msg)
     ESP_ERROR_CHECK(gpio_set_level(output_RS485_DE, 1)); // Set RS485 DE pin to low
 #endif    
     uart_write_bytes(UART_NUM_1, tx_data, tx_data_len); //Send the message
+    _comms.stats.tx_frames++;
+    _comms.stats.tx_bytes += tx_data_len;
     //Since we provided no tx buffer size, this action is supposed to block until the message is sent out
     //However, measuring the data line switching on the scope, it seems like the message is sent through a buffer 
     // since the next line executes before the first byte is even sent.
@@ -433,7 +488,7 @@ void _comms_deinit(void)
     {
         uart_driver_delete(UART_NUM_1);
         _comms.task.init_done = false;
-        iprintln(trCOMMS, "#Driver de-initialised");
+        itrace(trCOMMS, "#Driver de-initialised");
     }
 }
 
@@ -457,7 +512,7 @@ bool _rx_data_process(uint8_t rx_data)
             if (_tx.state == tx_wait_for_echo)
             {
                 // if we were sending just now, we want to check if our rx and tx buffers match
-                if (memcmp((uint8_t *)&_rx.msg, (uint8_t *)&_tx.msg, min(_rx.length, RGB_BTN_MSG_MAX_LEN)) == 0)
+                if (memcmp((uint8_t *)&_rx.msg, (uint8_t *)&_tx.msg, min(_rx.length, RGB_BTN_FRAME_MAX_LEN)) == 0)
                 {
                     //No need to check this message in the application... we are done with it
                     _tx.state = tx_idle;
@@ -480,7 +535,7 @@ bool _rx_data_process(uint8_t rx_data)
         }
         else 
         {
-            if (_rx.length < RGB_BTN_MSG_MAX_LEN)
+            if (_rx.length < RGB_BTN_FRAME_MAX_LEN)
                 ((uint8_t *)&_rx.msg)[_rx.length++] = rx_data;
             // _rx_state = rx_busy;
             //iprintln(trCOMMS, "#RX: 0x%02X", rx_data);
@@ -488,7 +543,7 @@ bool _rx_data_process(uint8_t rx_data)
     }
     else if (_rx.state == rx_escaping)
     {
-        if (_rx.length < RGB_BTN_MSG_MAX_LEN)
+        if (_rx.length < RGB_BTN_FRAME_MAX_LEN)
             ((uint8_t *)&_rx.msg)[_rx.length++] = rx_data^DLE;
         //iprintln(trCOMMS, "#RX: 0x%02X *", rx_data);
         _rx.state = rx_busy;
@@ -497,15 +552,67 @@ bool _rx_data_process(uint8_t rx_data)
     return return_value;
 }
 
-bool _tx_now(comms_tx_msg_t * tx_msg)
+bool _rx_reassemble(comms_msg_queue_item_t * rx_q_item)
+{
+    uint8_t frag = (_rx.msg.hdr.frag & COMMS_FRAG_INDEX_MASK);
+
+    if ((frag == 0) && (!(_rx.msg.hdr.frag & COMMS_FRAG_MORE)))
+    {
+        //Not fragmented, pass it on as is
+        _reassembly.next_frag = 0;
+        memcpy(&rx_q_item->msg, &_rx.msg, _rx.length);
+        rx_q_item->msg_size = _rx.length;
+        return true;
+    }
+
+    if (frag == 0)
+    {
+        //The start of a new message (any incomplete message is dropped)
+        memcpy(&_reassembly.msg.hdr, &_rx.msg.hdr, sizeof(comms_msg_hdr_t));
+        _reassembly.data_length = 0;
+        _reassembly.next_frag = 0;
+    }
+    else if ((_reassembly.next_frag != frag) || 
+             (_reassembly.msg.hdr.id != _rx.msg.hdr.id) || 
+             (_reassembly.msg.hdr.src != _rx.msg.hdr.src))
+    {
+        _comms.stats.frag_err++;
+        itrace(trCOMMS, "!RX: Fragment %d (0x%02X) out of sequence", frag, _rx.msg.hdr.id);
+        _reassembly.next_frag = 0;
+        return false;
+    }
+
+    if ((_reassembly.data_length + _rx.msg.hdr.len) > RGB_BTN_MSG_MAX_DATA_LEN)
+    {
+        _comms.stats.frag_err++;
+        itrace(trCOMMS, "!RX: Reassembled msg too long (0x%02X)", _rx.msg.hdr.id);
+        _reassembly.next_frag = 0;
+        return false;
+    }
+
+    memcpy(&_reassembly.msg.data[_reassembly.data_length], _rx.msg.data, _rx.msg.hdr.len);
+    _reassembly.data_length += _rx.msg.hdr.len;
+    _reassembly.next_frag = frag + 1;
+
+    if (_rx.msg.hdr.frag & COMMS_FRAG_MORE)
+        return false; //Not done yet
+
+    //Done, the application sees this as a single (unfragmented) message
+    _reassembly.next_frag = 0;
+    _reassembly.msg.hdr.frag = 0;
+    _reassembly.msg.hdr.len = (uint8_t)_reassembly.data_length;
+    //The CRC follows the data (in msg.crc for a msg of RGB_BTN_MSG_MAX_DATA_LEN)
+    ((uint8_t *)&_reassembly.msg)[sizeof(comms_msg_hdr_t) + _reassembly.data_length] = crc8_n(0, ((uint8_t *)&_reassembly.msg), sizeof(comms_msg_hdr_t) + _reassembly.data_length);
+    rx_q_item->msg_size = sizeof(comms_msg_hdr_t) + _reassembly.data_length + sizeof(uint8_t);
+    memcpy(&rx_q_item->msg, &_reassembly.msg, rx_q_item->msg_size);
+    return true;
+}
+
+bool _tx_queue_wait(void)
 {
-    comms_msg_queue_item_t _tx_msg_q_item = {0};
     Stopwatch_ms_t _sw = {0};
     uint32_t _elapsed_ms = 0;
 
-    if ((tx_msg->data_length == 0) || (!tx_msg->msg_busy))
-        return true; //Nothing to send, but the user might as well think all is well
-
     //If the transmit queue is not empty, we cannot send a new message
     sys_stopwatch_ms_start(&_sw, UINT16_MAX); /* Do not count past 0xFFFF */
     while (uxQueueMessagesWaiting(_comms.rs485.tx_msg_queue) > 0)
@@ -515,28 +622,59 @@ bool _tx_now(comms_tx_msg_t * tx_msg)
         if (_elapsed_ms > (2 * BUS_SILENCE_MIN_MS))
         {
             //We have waited long enough, this TX is not going to happen
-            iprintln(trCOMMS, "#TX FAIL: queue busy for %dms", _elapsed_ms);
+            itrace(trCOMMS, "#TX FAIL: queue busy for %dms", _elapsed_ms);
             return false;
         }
         vTaskDelay(max(1, pdMS_TO_TICKS(BUS_SILENCE_MIN_MS))); //Wait for 1 bus silence period or 1 tick (whichever is longer)
     }
+    return true;
+}
 
-    tx_msg->msg.hdr.id = _tx_seq++; //Set the message ID to the current sequence number
-    //This gets incremented every time we send a message, even on retries
-    
-    //Now we calculate the CRC over the message header and the data
-    tx_msg->msg.data[tx_msg->data_length] = crc8_n(0, ((uint8_t *)&tx_msg->msg), sizeof(comms_msg_hdr_t) + tx_msg->data_length); //Calculate the CRC for the newly added data in the message
+bool _tx_now(comms_tx_msg_t * tx_msg)
+{
+    comms_msg_queue_item_t _tx_msg_q_item = {0};
+    size_t _offset = 0;
+    uint8_t _frag = 0;
+
+    if ((tx_msg->data_length == 0) || (!tx_msg->msg_busy))
+        return true; //Nothing to send, but the user might as well think all is well
+
+    if (!tx_msg->seq_fixed)
+        tx_msg->seq = _tx_seq++; //Use the current sequence number
+    //This gets incremented every time we send a message, unless the caller chose the sequence number
+    tx_msg->msg.hdr.id = tx_msg->seq; //Set the message ID
+
+    //Messages longer than a frame are split into fragments (with the same ID)
+    do
+    {
+        size_t _len = min(tx_msg->data_length - _offset, RGB_BTN_FRAME_MAX_DATA_LEN);
+
+        if (_frag > 0)
+            vTaskDelay(max(1, pdMS_TO_TICKS(COMMS_FRAG_GAP_MS)));
+
+        if (!_tx_queue_wait())
+            return false;
 
-    _tx_msg_q_item.msg_size = (sizeof(comms_msg_hdr_t) + tx_msg->data_length + sizeof(uint8_t));
-    memcpy((uint8_t *)&_tx_msg_q_item.msg, (uint8_t *)&tx_msg->msg, _tx_msg_q_item.msg_size); //Copy the message to the buffer
+        memcpy(&_tx_msg_q_item.msg.hdr, &tx_msg->msg.hdr, sizeof(comms_msg_hdr_t));
+        _tx_msg_q_item.msg.hdr.frag = _frag | (((_offset + _len) < tx_msg->data_length)? COMMS_FRAG_MORE : 0);
+        _tx_msg_q_item.msg.hdr.len = (uint8_t)_len;
+        memcpy(_tx_msg_q_item.msg.data, &tx_msg->msg.data[_offset], _len);
 
+        //Now we calculate the CRC over the frame header and the data
+        _tx_msg_q_item.msg.data[_len] = crc8_n(0, ((uint8_t *)&_tx_msg_q_item.msg), sizeof(comms_msg_hdr_t) + _len);
+        _tx_msg_q_item.msg_size = (sizeof(comms_msg_hdr_t) + _len + sizeof(uint8_t));
 
-    //Send the message to the queue
-    xQueueSend(_comms.rs485.tx_msg_queue, (void *)&_tx_msg_q_item, 0); 
+        //Send the frame to the queue
+        xQueueSend(_comms.rs485.tx_msg_queue, (void *)&_tx_msg_q_item, 0); 
+
+        _offset += _len;
+        _frag++;
+    }while (_offset < tx_msg->data_length);
 
     //Clear the counters and flags indicating that we are busy with a message
     tx_msg->data_length = 0;
     tx_msg->msg_busy = false; 
+    tx_msg->seq_fixed = false;
 
     return true; //Message was queued successfully
 }
@@ -579,6 +717,7 @@ void * comms_init_task(void)
 #ifdef CONSOLE_ENABLED
     // console_add_menu("comms", _comms_menu_items, ARRAY_SIZE(_comms_menu_items), "Comms Control");
 #endif    
+    metrics_add("comms", _comms_metrics, ARRAY_SIZE(_comms_metrics));
 
     iprintln(trALWAYS, "#Init OK");
 
@@ -589,14 +728,14 @@ esp_err_t task_comms_tx(uint8_t *tx_data, size_t tx_size)
 {
     if (!_comms.task.init_done)
     {
-        iprintln(trCOMMS, "#Driver not initialised");
+        itrace(trCOMMS, "#Driver not initialised");
         return ESP_FAIL;
     }
     // Write data to UART.
     int tx_cnt = uart_write_bytes(uart_num, (const char*)tx_data, tx_size);
     if (tx_cnt < ((int)tx_size))
     {
-        iprintln(trCOMMS, "#Failed to write ALL data: %d/%d", tx_cnt, ((int)tx_size));
+        itrace(trCOMMS, "#Failed to write ALL data: %d/%d", tx_cnt, ((int)tx_size));
         return ESP_FAIL;
     }
 
@@ -627,6 +766,7 @@ void comms_tx_msg_init(comms_tx_msg_t * tx_msg, uint8_t node_addr)
     tx_msg->msg_busy = true; //We are busy building a message
 
     tx_msg->msg.hdr.version = RGB_BTN_MSG_VERSION;  //Superfluous, but just in case
+    tx_msg->msg.hdr.frag = 0;                       //Set per frame when the message is sent
     tx_msg->msg.hdr.src = ADDR_MASTER;              //Our Address (might have changed since our last message)
     tx_msg->msg.hdr.dst = node_addr;                //We only ever talk to the master!!!!!
 }
@@ -639,20 +779,18 @@ bool comms_tx_msg_append(comms_tx_msg_t * tx_msg, uint8_t node_addr, master_comm
 
     if ((tx_msg->msg_busy) && (node_addr != tx_msg->msg.hdr.dst))
     {
-        iprintln(trCOMMS, "#ERROR: Node addr (0x%02X) different than msg init (0x%02X). Cmd = 0x%02X", node_addr, tx_msg->msg.hdr.dst, cmd);
+        iprintln(trCOMMS, "!Node addr (0x%02X) different than msg init (0x%02X). Cmd = 0x%02X", node_addr, tx_msg->msg.hdr.dst, cmd);
         return false; //We are not busy building a message, so we cannot add anything to it
     }
 
     //We *know* we will be adding at least 2 bytes (cmd and crc)
     if ((uint8_t)(tx_msg->data_length + data_len + 2) > sizeof(tx_msg->msg.data))
     {
-        iprintln(trCOMMS, "#ERROR: Not enough space for cmd 0x%02X, len = %d (dst: 0x%02X, available space = %d)", cmd, data_len, node_addr, (sizeof(tx_msg->msg.data) - tx_msg->data_length));
+        iprintln(trCOMMS, "!Not enough space for cmd 0x%02X, len = %d (dst: 0x%02X, available space = %d)", cmd, data_len, node_addr, (sizeof(tx_msg->msg.data) - tx_msg->data_length));
         return false; //This is NEVER gonna fit!!!
     }
     
-    //The master should not bother with "breaking" the message up into smaller chunks. 
-    // Currently the system does not support fragmented messages to the nodes
-    
+    //No need to worry about the frame size here, _tx_now() will split the message into fragments if needed
     tx_msg->msg.data[tx_msg->data_length++] = cmd;
     if ((data) && (data_len > 0))
     {
@@ -669,7 +807,7 @@ bool comms_tx_msg_send(comms_tx_msg_t * tx_msg)
     //We are not busy building a message, so we cannot send anything
     if (!tx_msg->msg_busy)
     {
-        iprintln(trCOMMS, "#ERROR: No message to send");
+        iprintln(trCOMMS, "!No message to send");
         return false;
     }
 
@@ -677,6 +815,29 @@ bool comms_tx_msg_send(comms_tx_msg_t * tx_msg)
     return _tx_now(tx_msg);
 }
 
+bool comms_tx_msg_send_seq(comms_tx_msg_t * tx_msg, uint8_t seq)
+{
+    //We are not busy building a message, so we cannot send anything
+    if (!tx_msg->msg_busy)
+    {
+        iprintln(trCOMMS, "!No message to send");
+        return false;
+    }
+
+    tx_msg->seq = seq;
+    tx_msg->seq_fixed = true;
+    return _tx_now(tx_msg);
+}
+
+void comms_stats_get(comms_stats_t * stats, bool clear)
+{
+    if (stats != NULL)
+        memcpy(stats, &_comms.stats, sizeof(comms_stats_t));
+
+    if (clear)
+        memset(&_comms.stats, 0, sizeof(comms_stats_t));
+}
+
 #undef PRINTF_TAG
 #undef EXT
 /*************************** END OF FILE *************************************/
@@ -45,12 +45,27 @@ typedef struct {
 #if USE_BUILTIN_RS485_UART == 0    
     uint8_t retry_cnt;
 #endif    
-    uint8_t seq;
+    uint8_t seq;        // The sequence number (ID) the msg was sent with
+    bool seq_fixed;     // The caller has set the seq (e.g. for a resend), so we should not assign a new one
     size_t data_length;
     bool msg_busy;
     comms_tx_state_t state;
 }comms_tx_msg_t;
 
+typedef struct {
+    uint32_t tx_frames;     // Frames handed to the UART
+    uint32_t rx_frames;     // Valid (reassembled) msgs passed up to the application
+    uint32_t crc_err;       // Frames dropped due to a bad CRC
+    uint32_t version_err;   // Frames dropped due to an unsupported version
+    uint32_t length_err;    // Frames dropped because they were too short (or the length did not match)
+    uint32_t frag_err;      // Messages dropped because a fragment was missing or out of sequence
+    uint32_t rx_lost;       // Valid frames dropped because the RX queue was full
+    uint32_t uart_err;      // UART frame errors, FIFO overflows, etc.
+    uint32_t echo_err;      // Echo mismatches/timeouts (only when not using the builtin RS485 UART mode)
+    uint32_t tx_bytes;      // Bytes written to the bus (incl framing and escaping)
+    uint32_t rx_bytes;      // Bytes read from the bus (incl framing, escaping and our own echo)
+}comms_stats_t;
+
 /******************************************************************************
 Global (public) variables
 ******************************************************************************/
@@ -74,6 +89,19 @@ bool comms_tx_msg_append(comms_tx_msg_t * node_msg, uint8_t node_addr, master_co
 
 bool comms_tx_msg_send(comms_tx_msg_t * tx_msg);
 
+/*! \brief Sends a message with a specific sequence number (ID) iso the next one in line
+ * \param tx_msg The message to send
+ * \param seq The sequence number to use, e.g. that of the original msg when resending
+ * \return True if the message was queued successfully
+ */
+bool comms_tx_msg_send_seq(comms_tx_msg_t * tx_msg, uint8_t seq);
+
+/*! \brief Reads the bus level counters maintained by the comms task
+ * \param stats Pointer to where the counters should be copied
+ * \param clear Set to true to reset the counters once read
+ */
+void comms_stats_get(comms_stats_t * stats, bool clear);
+
 // bool comms_bcst_set_rgb(uint8_t index, uint32_t rgb_col);
 // bool comms_bcst_set_blink(uint32_t period_ms);
 
@@ -65,10 +65,18 @@ local defines and constants
                                     contain the remainder of the argument string 
                                     as it was received on the console */
 
-#define task_console_MAX_MENU_ITEMS_MAX 5 /* The maximum number of menu groups/tables */
+#define task_console_MAX_MENU_ITEMS_MAX 8 /* The maximum number of menu groups/tables */
 
 #define CONSOLE_READ_INTERVAL_MS      100     /* Task cycles at a 10Hz rate*/
 
+#define CONSOLE_TRACE_STACK_SIZE    3072
+#define CONSOLE_TRACE_RINGS         (6)     /* The max number of tasks that can use itrace() */
+#define CONSOLE_TRACE_RING_LEN      (32)    /* Records per task - Keep as a power of 2 */
+#define CONSOLE_TRACE_DATA_MAX      (16)    /* Bytes per memory dump record (one line of console_print_memory) */
+#define CONSOLE_TRACE_INTERVAL_MS   (10)    /* The trace task drains the rings at a 100Hz rate */
+#define CONSOLE_TRACE_LINE_LEN      (160)   /* The longest formatted trace line */
+#define CONSOLE_TAG_LEN             (48)    /* The timestamp and [tag] at the start of a line */
+
 
 const char BACKSPACE_ECHO[] = {0x08, 0x20, 0x08, 0x00};
 
@@ -122,6 +130,42 @@ typedef struct
 }	
 sPrintFlagActionItem;
 
+typedef struct
+{
+	uint32_t time_ms;   /* Low 32 bits of sys_poll_tmr_ms() when the record was made */
+	const char *fmt;    /* The format string - NULL for a memory dump record */
+	const char *tag;
+	uint8_t flags;
+	uint8_t cnt;        /* Number of args (or bytes of data in a memory dump record) */
+	uint16_t offset;    /* The offset of the data in a memory dump record */
+	union
+	{
+		uint32_t arg[CONSOLE_TRACE_ARGS_MAX];
+		uint8_t data[CONSOLE_TRACE_DATA_MAX];
+	};
+}console_trace_rec_t;
+
+/* A single producer (the owner task), single consumer (the trace task) ring. 
+    The producer only ever writes head and the consumer only ever writes tail, 
+    so neither side needs a lock. */
+typedef struct
+{
+	TaskHandle_t owner;
+	uint32_t head;      /* Free running count of records written (producer) */
+	uint32_t tail;      /* Free running count of records read (consumer) */
+	uint32_t drops;     /* Records lost because the ring was full (producer) */
+	uint32_t high_water;/* The most records waiting in the ring at once (producer) */
+	console_trace_rec_t rec[CONSOLE_TRACE_RING_LEN];
+}console_trace_ring_t;
+
+typedef struct
+{
+	console_trace_ring_t ring[CONSOLE_TRACE_RINGS];
+	uint32_t drops;     /* Records lost because no ring was available for the task */
+	portMUX_TYPE lock;  /* Only used to hand out the rings, never when tracing */
+	TaskHandle_t handle;
+}console_trace_t;
+
 typedef struct
 {
     //bool init_done;
@@ -242,7 +286,7 @@ void _console_handler_version(void);
  */
 void _console_handler_dump(void);
 
-/*! Prints an entire line (or not). A leading '#' is replaced with the PRINTF_TAG, 
+/*! Prints an entire line (or not). A leading '#' (or '!') is replaced with the PRINTF_TAG, 
  * and the print is concluded with an newline character.
  * The passed traceflags is compared with the system set trace print flag(s) to
  * determine if the print can happen or not.
@@ -269,6 +313,59 @@ void console_printline(uint8_t traceflags, const char * tag, const char *fmt, ..
  */ 
 void _console_handler_trace_iprint_action(eTraceFlagAction def_act);
 
+/*! The main function for the trace task, which drains the trace rings
+ */
+void _console_trace_main_func(void * pvParameters);
+
+/*! Finds (or assigns) the trace ring of the calling task
+ * @return A pointer to the ring, NULL if called from an ISR or if all the rings 
+ *          are taken
+ */
+console_trace_ring_t * _console_trace_ring(void);
+
+/*! Reserves the next record in the ring of the calling task
+ * @param[in] traceflags The trace flags of the record
+ * @param[in] tag The tag of the calling module
+ * @param[out] _ring The ring in which the record is reserved
+ * @return A pointer to the record, NULL if the ring is full (the drop is counted)
+ */
+console_trace_rec_t * _console_trace_reserve(uint8_t traceflags, const char * tag, console_trace_ring_t ** _ring);
+
+/*! Makes the record reserved with _console_trace_reserve() available to the 
+ *   trace task
+ * @param[in] ring The ring in which the record was reserved
+ */
+void _console_trace_commit(console_trace_ring_t * ring);
+
+/*! Formats and prints the oldest record across all the rings
+ * @return true if a record was printed, false if all the rings are empty
+ */
+bool _console_trace_drain_one(void);
+
+/*! Formats a single line of a memory dump (up to 16 bytes)
+ * @param[out] buff The buffer to format the line into
+ * @param[in] size The size of the buffer
+ * @param[in] src The bytes to display
+ * @param[in] address The address to display for the first byte
+ * @param[in] len The number of bytes to display
+ */
+void _console_format_memory_line(char * buff, size_t size, const uint8_t * src, unsigned long address, int len);
+
+/*! Prints the trace ring usage and drop counters
+ */
+void _console_trace_stats(void);
+
+/*! Formats the timestamp and tag at the start of a line, if the format string 
+ *   starts with '#' (or '!' for an error)
+ * @param[out] buff The buffer to format the tag into
+ * @param[in] size The size of the buffer
+ * @param[in] fmt The format string of the line
+ * @param[in] tag The tag to print
+ * @param[in] time_ms The timestamp to print
+ * @return The number of characters written, 0 if the line has no tag
+ */
+int _console_format_tag(char * buff, size_t size, const char * fmt, const char * tag, uint64_t time_ms);
+
 /*******************************************************************************
 local variables
  *******************************************************************************/
@@ -304,6 +401,10 @@ ConsoleMenuItem_t _console_menu_items[] =
 		{"trace",   _console_handler_trace,     "Displays the status, or Enables/Disables print traces"},
 };
 
+static console_trace_t _trace = {
+	.lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
 static DeviceConsole_t _console = {
     .menu_grp_list.cnt = 0,
 	.tracemask = trALL&(~trCOMMS),//trCONSOLE|trAPP|trLED|trCOMMS,
@@ -356,6 +457,173 @@ void _console_main_func(void * pvParameters)
     _console_task_deinit();
 }
 
+void _console_trace_main_func(void * pvParameters)
+{
+	while (1)
+	{
+        TickType_t xLastWakeTime = xTaskGetTickCount();
+
+		//Print everything that has been recorded since the last time around
+		while (_console_trace_drain_one())
+			;
+
+        xTaskDelayUntil(&xLastWakeTime, MAX(1, pdMS_TO_TICKS(CONSOLE_TRACE_INTERVAL_MS))); 
+	}
+}
+
+console_trace_ring_t * _console_trace_ring(void)
+{
+	TaskHandle_t self;
+	console_trace_ring_t *ring = NULL;
+
+	//The rings are owned by tasks, so we cannot trace from an ISR
+	if (xPortInIsrContext())
+		return NULL;
+
+	self = xTaskGetCurrentTaskHandle();
+
+	//Fast path - the task already owns a ring
+	for (int i = 0; i < CONSOLE_TRACE_RINGS; i++)
+	{
+		if (_trace.ring[i].owner == self)
+			return &_trace.ring[i];
+	}
+
+	//First trace from this task, assign it the next free ring (this happens only once per task)
+	taskENTER_CRITICAL(&_trace.lock);
+	for (int i = 0; i < CONSOLE_TRACE_RINGS; i++)
+	{
+		if (_trace.ring[i].owner == NULL)
+		{
+			ring = &_trace.ring[i];
+			ring->owner = self;
+			break;
+		}
+	}
+	taskEXIT_CRITICAL(&_trace.lock);
+
+	return ring;
+}
+
+console_trace_rec_t * _console_trace_reserve(uint8_t traceflags, const char * tag, console_trace_ring_t ** _ring)
+{
+	console_trace_ring_t *ring = _console_trace_ring();
+	console_trace_rec_t *rec;
+	uint32_t used;
+
+	if (ring == NULL)
+	{
+		_trace.drops++;
+		return NULL;
+	}
+
+	used = ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	if (used >= CONSOLE_TRACE_RING_LEN)
+	{
+		ring->drops++;
+		return NULL;
+	}
+	if (used >= ring->high_water)
+		ring->high_water = used + 1;
+
+	rec = &ring->rec[ring->head % CONSOLE_TRACE_RING_LEN];
+	rec->time_ms = (uint32_t)sys_poll_tmr_ms();
+	rec->tag = tag;
+	rec->flags = traceflags;
+	*_ring = ring;
+	return rec;
+}
+
+void _console_trace_commit(console_trace_ring_t * ring)
+{
+	//Publish the record only once it is completely written
+	__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+bool _console_trace_drain_one(void)
+{
+	console_trace_ring_t *oldest = NULL;
+	console_trace_rec_t *rec;
+	char line[CONSOLE_TRACE_LINE_LEN];
+	int len;
+
+	//The rings are merged in time order, oldest first
+	for (int i = 0; i < CONSOLE_TRACE_RINGS; i++)
+	{
+		console_trace_ring_t *ring = &_trace.ring[i];
+		if (ring->tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+			continue;
+		if ((oldest == NULL) || 
+			((int32_t)(ring->rec[ring->tail % CONSOLE_TRACE_RING_LEN].time_ms - oldest->rec[oldest->tail % CONSOLE_TRACE_RING_LEN].time_ms) < 0))
+			oldest = ring;
+	}
+
+	if (oldest == NULL)
+		return false;
+
+	rec = &oldest->rec[oldest->tail % CONSOLE_TRACE_RING_LEN];
+
+	//The trace mask could have changed since the record was made
+	if (((trALWAYS | _console.tracemask) & rec->flags) != trNONE)
+	{
+		if (rec->fmt == NULL)
+			_console_format_memory_line(line, sizeof(line), rec->data, rec->offset, rec->cnt);
+		else
+		{
+			//Same as console_print(), the line starts with the tag if the format string starts with "#" (or "!")
+			len = _console_format_tag(line, sizeof(line), rec->fmt, rec->tag, rec->time_ms);
+			snprintf(&line[len], sizeof(line) - len, &rec->fmt[(len > 0)? 1 : 0], rec->arg[0], rec->arg[1], rec->arg[2], rec->arg[3]);
+		}
+
+		//A single printf, so that the line does not get chopped up by prints from other tasks
+		printf("%s\n", line);
+	}
+
+	//Hand the slot back to the producer
+	__atomic_store_n(&oldest->tail, oldest->tail + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+void _console_format_memory_line(char * buff, size_t size, const uint8_t * src, unsigned long address, int len)
+{
+	int pos = snprintf(buff, size, "%06lX : ", address);
+
+	// hex data
+	for (int x = 0; (x < 16) && (pos < size); x++)
+	{
+		if (x < len)
+			pos += snprintf(&buff[pos], size - pos, "%02X%c", src[x], ((x == 7) ? '-' : ' '));
+		else
+			pos += snprintf(&buff[pos], size - pos, "  %c", ((x == 7) ? '-' : ' '));
+	}
+	// ASCII data
+	if (pos < size)
+		pos += snprintf(&buff[pos], size - pos, " ");
+	for (int x = 0; (x < len) && (x < 16) && (pos < (size - 1)); x++)
+		buff[pos++] = ((src[x] >= 0x20) && (src[x] <= 0x7f))? src[x] : '.';
+	if (pos < size)
+		buff[pos] = 0;
+}
+
+void _console_trace_stats(void)
+{
+	iprintln(trALWAYS, "Trace rings (%d records each):", CONSOLE_TRACE_RING_LEN);
+	for (int i = 0; i < CONSOLE_TRACE_RINGS; i++)
+	{
+		console_trace_ring_t *ring = &_trace.ring[i];
+		if (ring->owner == NULL)
+			continue;
+		iprintln(trALWAYS, " %15s - %lu records, %lu waiting, max %lu, %lu dropped", 
+				pcTaskGetName(ring->owner),
+				ring->head,
+				ring->head - ring->tail,
+				ring->high_water,
+				ring->drops);
+	}
+	if (_trace.drops)
+		iprintln(trALWAYS, " %15s - %lu dropped", "(no ring)", _trace.drops);
+}
+
 void _parse_rx_line(void)
 {
 //	iprintln(PRINT_TR_CONSOLE, "Parseline() called for \"%s\"", _console.rx.buff);
@@ -853,6 +1121,8 @@ void _console_handler_trace(void)
 				/* Add an asterisk if this trace flag has been changed in this operation */
 				((tmp_tracemask & trace_mask) != (_console.tracemask & trace_mask))? "*" : "");
 	}
+
+	_console_trace_stats();
 }
 
 void _console_handler_version(void)
@@ -1078,6 +1348,10 @@ void * console_init_task(void)
 
 	configASSERT(_console.task.handle);
 
+	//The trace task runs at the lowest priority, so that formatting and printing traces never holds up the real work
+	if (xTaskCreate( _console_trace_main_func, "Trace", CONSOLE_TRACE_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, &_trace.handle ) != pdPASS)
+		iprintln(trALWAYS, "#Unable to start Trace Task!");
+
     _console.task.init_done = true;
 
     _console_handler_version();
@@ -1200,58 +1474,82 @@ int console_add_menu(const char *_group_name, ConsoleMenuItem_t *_tbl, size_t _c
 
 void console_print_memory(int Flags, void * Src, unsigned long Address, int Len)
 {
-uint8_t *s;
-uint8_t x;
-int cnt;
-//RAMSTART     (0x100)
-//RAMEND       0x8FF     /* Last On-Chip SRAM Location */
-
-	s = (uint8_t *)Src;
+	uint8_t *s = (uint8_t *)Src;
+	char line[CONSOLE_TRACE_LINE_LEN];
+	int cnt;
 
-	while(Len)
+	while (Len > 0)
 	{
-		// print offset
-		iprint(Flags, "%06lX : ", Address);
-		// print hex data
-		for(x = 0; x < 16; x++)
-		{
-			if (x < Len)
-                iprint(Flags, "%02X%c", (uint8_t)s[x], (uint8_t)((x == 7) ? '-' : ' '));
-			else
-                iprint(Flags, "  %c", (uint8_t)((x == 7) ? '-' : ' '));
-
-		}
-		// print ASCII data
-		iprint(Flags, " ");
-		for(x = 0; x < 16; x++)
-		{
-			if (x < Len)
-                iprint(Flags, "%c", (uint8_t)(((s[x] >= 0x20) && (s[x] <= 0x7f))? s[x] : '.'));
-			else
-				break;
-		}
-		// goto next line
 		cnt = (Len > 16) ? 16 : Len;
+		_console_format_memory_line(line, sizeof(line), s, Address, cnt);
+		iprintln(Flags, "%s", line);
 		s       += cnt;
 		Len     -= cnt;
-		iprintln(Flags, "");
 		Address += 16;
 	}
+}
+
+void console_trace_memory(uint8_t traceflags, const char * tag, const void * src, unsigned long address, size_t len)
+{
+	const uint8_t *s = (const uint8_t *)src;
+	console_trace_ring_t *ring;
+	console_trace_rec_t *rec;
+
+	if (((trALWAYS | _console.tracemask) & traceflags) == trNONE)
+		return;
+
+	//One record per line of the dump
+	for (size_t offset = 0; offset < len; offset += CONSOLE_TRACE_DATA_MAX)
+	{
+		if ((rec = _console_trace_reserve(traceflags, tag, &ring)) == NULL)
+			return;
+		rec->fmt = NULL;
+		rec->offset = (uint16_t)(address + offset);
+		rec->cnt = (uint8_t)MIN(CONSOLE_TRACE_DATA_MAX, len - offset);
+		memcpy(rec->data, &s[offset], rec->cnt);
+		_console_trace_commit(ring);
+	}
+}
+
+void console_trace(uint8_t traceflags, const char * tag, const char *fmt, const uint32_t *args, size_t cnt)
+{
+	console_trace_ring_t *ring;
+	console_trace_rec_t *rec;
+
+	if (((trALWAYS | _console.tracemask) & traceflags) == trNONE)
+		return;
+
+	if ((rec = _console_trace_reserve(traceflags, tag, &ring)) == NULL)
+		return;
 
-//  iprintf(Flags, "\n");
+	rec->fmt = fmt;
+	rec->cnt = (uint8_t)MIN(CONSOLE_TRACE_ARGS_MAX, cnt);
+	for (int i = 0; i < CONSOLE_TRACE_ARGS_MAX; i++)
+		rec->arg[i] = (i < rec->cnt)? args[i] : 0;
+	_console_trace_commit(ring);
+}
+
+int _console_format_tag(char * buff, size_t size, const char * fmt, const char * tag, uint64_t time_ms)
+{
+	if (fmt[0] == '#')
+		return snprintf(buff, size, "%08llu [%s]", time_ms, tag);
+	if (fmt[0] == '!')
+		return snprintf(buff, size, "%08llu [%s ERROR]", time_ms, tag);
+	return 0;
 }
 
 void console_print(uint8_t traceflags, const char * tag, const char *fmt, ...)
 {
 	va_list ap;
+	char tag_str[CONSOLE_TAG_LEN];
 
 	if (((trALWAYS | _console.tracemask) & traceflags) == trNONE)
 		return;
 
-	//A line starts with the tag if the format string starts with "#"
-	if (fmt[0] == '#')
+	//A line starts with the tag if the format string starts with "#" (or "!")
+	if (_console_format_tag(tag_str, sizeof(tag_str), fmt, tag, sys_poll_tmr_ms()) > 0)
 	{
-		printf("%08llu [%s]", (uint64_t)sys_poll_tmr_ms(), tag);
+		printf("%s", tag_str);
 		fmt++; // Now skip the '#'
 	}
 
@@ -1262,9 +1560,24 @@ void console_print(uint8_t traceflags, const char * tag, const char *fmt, ...)
 
 void console_printline(uint8_t traceflags, const char * tag, const char *fmt, ...)
 {
-    console_print(traceflags, tag, fmt);
+	va_list ap;
+	char tag_str[CONSOLE_TAG_LEN];
+
+	if (((trALWAYS | _console.tracemask) & traceflags) == trNONE)
+		return;
+
+	//A line starts with the tag if the format string starts with "#" (or "!")
+	if (_console_format_tag(tag_str, sizeof(tag_str), fmt, tag, sys_poll_tmr_ms()) > 0)
+	{
+		printf("%s", tag_str);
+		fmt++; // Now skip the '#'
+	}
+
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
 	//Ends with a newline.
-    console_print(traceflags, tag, "\n");
+	printf("\n");
 }
 
 
@@ -24,6 +24,7 @@ Macros
 #define EXT extern
 extern void console_printline(uint8_t traceflags, const char * tag, const char *fmt, ...);
 extern void console_print(uint8_t traceflags, const char * tag, const char *fmt, ...);
+extern void console_trace(uint8_t traceflags, const char * tag, const char *fmt, const uint32_t *args, size_t cnt);
 #endif /* __NOT_EXTERN__ */
 
 #define trAPP		((uint8_t)BIT_POS(0))
@@ -38,17 +39,42 @@ extern void console_print(uint8_t traceflags, const char * tag, const char *fmt,
 #define trALL		((uint8_t)(~trALWAYS))
 #define trNONE		((uint8_t)0)
 
+/* The compile-time trace level of a module - undefine and redefine it at the 
+    top of a c-file to override (see common_defines.h) */
+#define TRACE_LEVEL     (CONSOLE_TRACE_LEVEL)
+
 /******************************************************************************
-Print an entire line (or not). A leading '#' is replaced with the PRINTF_TAG, 
- and the print is concluded with an newline character.
+Print an entire line (or not). A leading '#' is replaced with the PRINTF_TAG 
+ (a leading '!' with the PRINTF_TAG and "ERROR"), and the print is concluded 
+ with an newline character.
 The passed traceflags is compared with the system set trace print flag(s) to
  determine if the print can happen or not.
+Trace points below the TRACE_LEVEL of the module are not compiled in at all.
 ******************************************************************************/
-#define iprintln(traceflags, fmtstr, ...) console_printline(traceflags, PRINTF_TAG, fmtstr, ##__VA_ARGS__)
+#define iprintln(traceflags, fmtstr, ...) do { if (TRACE_COMPILED(traceflags, trALWAYS, fmtstr)) \
+                                                console_printline(traceflags, PRINTF_TAG, fmtstr, ##__VA_ARGS__); } while (0)
 /******************************************************************************
 "Incomplete" version of iprintln... no "\n" added at the end
 ******************************************************************************/
-#define iprint(traceflags, fmtstr, ...) console_print(traceflags, PRINTF_TAG, fmtstr, ##__VA_ARGS__)
+#define iprint(traceflags, fmtstr, ...) do { if (TRACE_COMPILED(traceflags, trALWAYS, fmtstr)) \
+                                                console_print(traceflags, PRINTF_TAG, fmtstr, ##__VA_ARGS__); } while (0)
+
+#define CONSOLE_TRACE_ARGS_MAX      (4)     /* Max number of arguments in a single itrace() record */
+
+/******************************************************************************
+Deferred (binary) version of iprintln, for use in time critical code.
+Only the format string pointer, the tag and up to CONSOLE_TRACE_ARGS_MAX 
+ (32-bit) integer arguments are recorded in a lock-free ring owned by the 
+ calling task. The line is formatted and printed later by the (low priority) 
+ trace task, so the caller never waits on the console.
+IMPORTANT: The format string must be a literal, and the arguments must be 
+ integers (no "%s", "%f" or "%llu") - they are only formatted once the caller 
+ has long since moved on.
+******************************************************************************/
+#define itrace(traceflags, fmtstr, ...) do { if (TRACE_COMPILED(traceflags, trALWAYS, fmtstr)) \
+                                                console_trace(traceflags, PRINTF_TAG, fmtstr, \
+                                                    (const uint32_t []){0, ##__VA_ARGS__} + 1, \
+                                                    (sizeof((const uint32_t []){0, ##__VA_ARGS__})/sizeof(uint32_t)) - 1); } while (0)
 
 /******************************************************************************
 Struct & Unions
@@ -110,6 +136,27 @@ int console_arg_cnt(void);
  */
 void console_print_memory(int Flags, void * Src, unsigned long Address, int Len);
 
+/*! Records a section of memory in the trace ring of the calling task (the 
+ *   deferred version of console_print_memory). Memory is copied, so the source 
+ *   may be re-used as soon as the function returns.
+ * @param[in] traceflags The trace flags to compare with the system trace flags
+ * @param[in] tag The tag of the calling module
+ * @param[in] src The memory to dump
+ * @param[in] address The address to display for the first byte
+ * @param[in] len The number of bytes to dump
+ */
+void console_trace_memory(uint8_t traceflags, const char * tag, const void * src, unsigned long address, size_t len);
+
+/*! Records a single line in the trace ring of the calling task - use the 
+ *   itrace() macro rather than calling this directly.
+ * @param[in] traceflags The trace flags to compare with the system trace flags
+ * @param[in] tag The tag of the calling module
+ * @param[in] fmt The format string (must be a literal)
+ * @param[in] args The integer arguments for the format string
+ * @param[in] cnt The number of arguments (only CONSOLE_TRACE_ARGS_MAX are kept)
+ */
+void console_trace(uint8_t traceflags, const char * tag, const char *fmt, const uint32_t *args, size_t cnt);
+
 
 #undef EXT
 #endif /* __task_console_H__ */
@@ -4,6 +4,12 @@ Module:     task_game.c
 Purpose:    This file contains the RGB LED driver task
 Author:     Rudolph van Niekerk
 
+The game task is event driven. Events (button presses, nodes joining or being
+lost, game timers expiring and node msgs completing) are queued with
+game_event_post() and passed on to the game as they arrive. In between, the
+game's cb_main() is called every tick_ms, with the next tick due one period
+after the previous one was due (not after it was done). Ticks that are missed
+because the game overran are skipped and counted, rather than bunched up.
 
  *******************************************************************************/
 
@@ -21,6 +27,7 @@ includes
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "esp_err.h"
 #include "esp_timer.h"
 #include "sys_utils.h"
@@ -28,6 +35,9 @@ includes
 #include "sys_task_utils.h"
 #include "str_helper.h"
 #include "task_console.h"
+#include "sys_metrics.h"
+#include "sys_telemetry.h"
+#include "sys_rstats.h"
 #include "nodes.h"
 
 #define __NOT_EXTERN__
@@ -43,9 +53,9 @@ Macros and Constants
  *******************************************************************************/
 const game_t games_list[] =
 {
-    {"Demo",    game_demo_main,         game_demo_init,         game_demo_teardown,         game_demo_arg_parser        },
-    {"Chaser",  game_random_chase_main, game_random_chase_init, game_random_chase_teardown, game_random_chase_arg_parser},
-    {"Memory",  game_memory_main,     game_memory_init,         game_memory_teardown,       game_memory_arg_parser      },
+    {"Demo",    game_demo_main,         game_demo_init,         game_demo_teardown,         game_demo_arg_parser,           NULL,                       TASK_GAME_INTERVAL_MS},
+    {"Chaser",  game_random_chase_main, game_random_chase_init, game_random_chase_teardown, game_random_chase_arg_parser,   game_random_chase_event,    TASK_GAME_INTERVAL_MS},
+    {"Memory",  game_memory_main,       game_memory_init,       game_memory_teardown,       game_memory_arg_parser,         game_memory_event,          TASK_GAME_INTERVAL_MS},
 };
 
 #ifdef PRINTF_TAG
@@ -55,6 +65,8 @@ const game_t games_list[] =
 
 #define RGB_STACK_SIZE 4096
 
+#define GAME_EVT_QUEUE_LEN          (RGB_BTN_MAX_NODES * 2) /* A press and a txn_done from every node in a single tick */
+
 /*******************************************************************************
 local defines 
  *******************************************************************************/
@@ -74,6 +86,10 @@ typedef struct
 	TaskInfo_t task;
     int current_game; // Index of the current game being run
     game_state_e state; // Current state of the game task
+    QueueHandle_t evt_queue; // Events waiting to be passed on to the game
+    uint64_t next_tick_ms; // When the next tick is due
+    uint64_t tmr_expiry[GAME_TIMERS_MAX]; // When each game timer expires (0 if not running)
+    uint64_t paused_ms; // When the game was paused (the deadlines are moved on by the time spent paused)
 } GameTask_t;
 /*******************************************************************************
 local function prototypes
@@ -81,6 +97,17 @@ local function prototypes
 void _task_game_mainfunc(void * pvParameters);
 void _task_game_setup(void);
 
+/*! \brief Waits for the next event or deadline (whichever comes first) and passes it on to the running game
+ * \param game The running game
+ */
+void _game_run_next(const game_t * game);
+
+/*! \brief Calls one of the game callbacks, and accounts for the time it took
+ * \param game The running game
+ * \param evt The event to pass on to cb_event(), or NULL to call cb_main()
+ */
+void _game_callback(const game_t * game, const game_event_t * evt);
+
 
 /*******************************************************************************
 local variables
@@ -99,6 +126,32 @@ GameTask_t _game = {
 bool _pause_flag = false; //Flag to indicate that the game is paused
 bool _new_params = false; //Flag to indicate that new parameters have been set
 
+/* How long the game callbacks take to run (while the game is running), and how well the deadlines are kept */
+struct {
+    metric_hist_t loop;         // Time spent in each game callback
+    metric_hist_t late;         // How late ticks and timers were passed on to the game
+    metric_hist_t latency;      // From an event being posted to the game getting it
+    uint32_t overruns;          // Ticks skipped because the game was still busy
+    uint32_t overrun_ms;
+    uint32_t events;
+    uint32_t evt_drops;         // Events lost because the queue was full
+}_game_metrics = {
+    .loop = METRIC_HIST_INIT(1, 2, 5, 10, 20, TASK_GAME_INTERVAL_MS, 100),
+    .late = METRIC_HIST_INIT(0, 1, 2, 5, 10, 20, TASK_GAME_INTERVAL_MS),
+    .latency = METRIC_HIST_INIT(0, 1, 2, 5, 10, 20, TASK_GAME_INTERVAL_MS),
+};
+
+const metric_item_t _game_metric_items[] =
+{
+    {"loop",        "ms",   metric_hist,    &_game_metrics.loop},
+    {"late",        "ms",   metric_hist,    &_game_metrics.late},
+    {"evt_latency", "ms",   metric_hist,    &_game_metrics.latency},
+    {"overruns",    NULL,   metric_counter, &_game_metrics.overruns},
+    {"overrun_time","ms",   metric_counter, &_game_metrics.overrun_ms},
+    {"events",      NULL,   metric_counter, &_game_metrics.events},
+    {"evt_drops",   NULL,   metric_counter, &_game_metrics.evt_drops},
+};
+
 /*******************************************************************************
 Local (private) Functions
 *******************************************************************************/
@@ -120,11 +173,9 @@ void _task_game_mainfunc(void * pvParameters)
 
         while (all_good) 
         {
-            TickType_t xLastWakeTime = xTaskGetTickCount();
-
             if ((node_count() <= 0) && (_game.state > game_state_node_reg)) //Check if there are any nodes registered
             {
-                iprintln(trNODE, "#Error: No nodes registered");
+                iprintln(trNODE, "!No nodes registered");
                 all_good = false; //Set the all_good flag to false to exit the loop
                 continue; //Skip the rest of the loop and wait for the next iteration
             }
@@ -134,7 +185,9 @@ void _task_game_mainfunc(void * pvParameters)
             if (_pause_flag)
             {
                 _game.state = game_state_paused; //Set the game state to paused
+                _game.paused_ms = sys_poll_tmr_ms();
                 _pause_flag = false; //Reset the pause flag
+                tlm_send(tlm_game, tlm_game_paused, _game.current_game, 0);
             }
             
             switch (_game.state) //Replace with a meaningful condition
@@ -142,11 +195,12 @@ void _task_game_mainfunc(void * pvParameters)
                 case game_state_node_reg:
                 {
                     iprintln(trGAME, "#Starting Registration...");
-                    if (!nodes_register_all())
+                    if (!nodes_register_warm())
                     {    
                         iprintln(trGAME|trALWAYS, "#Failed to register nodes");
                         all_good = false; //Set the all_good flag to false to exit the loop
                     }
+                    tlm_send(tlm_game, tlm_game_registered, _game.current_game, node_count());
                     _game.state = (games_list[_game.current_game].cb_init)? game_state_init : game_state_running;
                     break;
                 }
@@ -160,6 +214,8 @@ void _task_game_mainfunc(void * pvParameters)
                     _game.state = game_state_running;
                     //Start with a clean slate
                     bcst_msg_clear_all();
+                    _game.next_tick_ms = sys_poll_tmr_ms(); //The 1st tick is due straight away
+                    tlm_send(tlm_game, tlm_game_running, _game.current_game, 0);
                     break;
                 }
                 
@@ -170,9 +226,9 @@ void _task_game_mainfunc(void * pvParameters)
                         iprintln(trGAME|trALWAYS, "#Invalid game index: %d", _game.current_game);
                         all_good = false; //Set the all_good flag to false to exit the loop
                     }
-                    else if (!games_list[_game.current_game].cb_main)
+                    else if ((!games_list[_game.current_game].cb_main) && (!games_list[_game.current_game].cb_event))
                     {
-                        iprintln(trGAME|trALWAYS, "#No main function for game %s", games_list[_game.current_game].name);
+                        iprintln(trGAME|trALWAYS, "#No main or event function for game %s", games_list[_game.current_game].name);
                         all_good = false; //Set the all_good flag to false to exit the loop
                     }
                     else
@@ -184,7 +240,7 @@ void _task_game_mainfunc(void * pvParameters)
                                 games_list[_game.current_game].cb_init(false, _new_params); //Call the game initialisation function if one is defined
                             _new_params = false; //Reset the new parameters flag
                         }
-                        games_list[_game.current_game].cb_main();
+                        _game_run_next(&games_list[_game.current_game]);
                     }
                     break;
                 }
@@ -192,6 +248,7 @@ void _task_game_mainfunc(void * pvParameters)
                 case game_state_paused:
                 {
                     //Do nothing here... we *might* get resumed... just wait for the next iteration
+                    vTaskDelay(pdMS_TO_TICKS(TASK_GAME_INTERVAL_MS));
                     break;
                 }
                 
@@ -201,7 +258,6 @@ void _task_game_mainfunc(void * pvParameters)
                     break;
             }
 
-            xTaskDelayUntil(&xLastWakeTime, MAX(1, pdMS_TO_TICKS(TASK_GAME_INTERVAL_MS)));  //vTaskDelay(pdMS_TO_TICKS(EXAMPLE_CHASE_SPEED_MS));
             /* Inspect our own high water mark on entering the task. */
             _game.task.stack_unused = uxTaskGetStackHighWaterMark2( NULL );
         }
@@ -214,6 +270,88 @@ void _task_game_mainfunc(void * pvParameters)
 
 
 
+void _game_run_next(const game_t * game)
+{
+    game_event_t evt;
+    uint64_t now_ms = sys_poll_tmr_ms();
+    uint64_t deadline_ms = now_ms + TASK_GAME_INTERVAL_MS; //We check for a pause at least this often
+    bool tick_due = false;
+    int tmr_due = -1;
+
+    //The earliest deadline is the one we wait for
+    if ((game->tick_ms > 0) && (_game.next_tick_ms <= deadline_ms))
+    {
+        deadline_ms = _game.next_tick_ms;
+        tick_due = true;
+    }
+    for (int i = 0; i < GAME_TIMERS_MAX; i++)
+    {
+        if ((_game.tmr_expiry[i] != 0) && (_game.tmr_expiry[i] <= deadline_ms))
+        {
+            deadline_ms = _game.tmr_expiry[i];
+            tmr_due = i;
+            tick_due = false;
+        }
+    }
+
+    //Events are passed on as they arrive, and all the events already queued go before the next deadline
+    TickType_t _wait = (deadline_ms > now_ms)? (TickType_t)((deadline_ms - now_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS) : 0;
+    if (xQueueReceive(_game.evt_queue, &evt, _wait) == pdTRUE)
+    {
+        _game_metrics.events++;
+        metric_hist_add(&_game_metrics.latency, (uint32_t)(sys_poll_tmr_ms() - evt.time_ms));
+        _game_callback(game, &evt);
+        return;
+    }
+
+    now_ms = sys_poll_tmr_ms();
+    if (now_ms < deadline_ms)
+        return; //Nothing due yet
+
+    if (tmr_due >= 0)
+    {
+        _game.tmr_expiry[tmr_due] = 0;
+        metric_hist_add(&_game_metrics.late, (uint32_t)(now_ms - deadline_ms));
+        evt.type = game_evt_timer;
+        evt.slot = -1;
+        evt.value = tmr_due;
+        evt.time_ms = deadline_ms;
+        _game_callback(game, &evt);
+    }
+    else if (tick_due)
+    {
+        metric_hist_add(&_game_metrics.late, (uint32_t)(now_ms - deadline_ms));
+        _game_callback(game, NULL);
+
+        //The next tick is due a period after this one was due... if we are past that already, the game overran 
+        // and the ticks we missed are skipped (rather than called back to back to catch up)
+        _game.next_tick_ms += game->tick_ms;
+        now_ms = sys_poll_tmr_ms();
+        if (now_ms >= _game.next_tick_ms)
+        {
+            uint32_t _missed = (uint32_t)((now_ms - _game.next_tick_ms) / game->tick_ms) + 1;
+            _game_metrics.overruns += _missed;
+            _game_metrics.overrun_ms += (uint32_t)(now_ms - _game.next_tick_ms);
+            _game.next_tick_ms += (uint64_t)_missed * game->tick_ms;
+        }
+    }
+}
+
+void _game_callback(const game_t * game, const game_event_t * evt)
+{
+    int64_t _start_us = esp_timer_get_time();
+
+    if (evt == NULL)
+    {
+        if (game->cb_main)
+            game->cb_main();
+    }
+    else if (game->cb_event)
+        game->cb_event(evt);
+
+    metric_hist_add(&_game_metrics.loop, (uint32_t)((esp_timer_get_time() - _start_us) / 1000));
+}
+
 /*******************************************************************************
 Global (public) Functions
 *******************************************************************************/
@@ -243,6 +381,18 @@ void * game_start(int index)
         return NULL; //Nothing to do further
     }
 
+    metrics_add("game", _game_metric_items, ARRAY_SIZE(_game_metric_items));
+
+    if (_game.evt_queue == NULL)
+        _game.evt_queue = xQueueCreate(GAME_EVT_QUEUE_LEN, sizeof(game_event_t));
+    if (_game.evt_queue == NULL)
+    {
+		iprintln(trGAME|trALWAYS, "#Unable to create the event queue for \"%s\"!", games_list[index].name);
+        return NULL;
+    }
+    xQueueReset(_game.evt_queue); //Nothing left over from the previous game
+    memset(_game.tmr_expiry, 0, sizeof(_game.tmr_expiry));
+
     _game.current_game = index;
     _game.state = game_state_node_reg; //Set the game state to node registration
     _pause_flag = false; //Reset the pause flag
@@ -259,7 +409,12 @@ void * game_start(int index)
 		return NULL;
 	}
 
-    iprintln(trGAME|trALWAYS, "#Started \"%s\" @ %d Hz", games_list[_game.current_game].name, (1000/TASK_GAME_INTERVAL_MS));
+    if (games_list[_game.current_game].tick_ms > 0)
+        iprintln(trGAME|trALWAYS, "#Started \"%s\" @ %d Hz", games_list[_game.current_game].name, (1000/games_list[_game.current_game].tick_ms));
+    else
+        iprintln(trGAME|trALWAYS, "#Started \"%s\" (events only)", games_list[_game.current_game].name);
+    tlm_send(tlm_game, tlm_game_start, _game.current_game, 0);
+    rstats_session_start(_game.current_game);
 
     configASSERT(_game.task.handle);
 
@@ -279,8 +434,11 @@ void game_end(void)
             _new_params = false; //Reset the new parameters flag
             //Turn off all the LED's, as a matter of courtesy
             bcst_msg_clear_all();
+            nodes_target_reset(); //The next game starts with a clean slate
             vTaskDelete(_game.task.handle);
             iprintln(trGAME|trALWAYS, "#\"%s\" Stopped", games_list[_game.current_game].name);
+            tlm_send(tlm_game, tlm_game_end, _game.current_game, 0);
+            rstats_session_end();
         }
 
         _game.current_game = -1;
@@ -353,8 +511,17 @@ bool game_resume(void)
         iprintln(trGAME|trALWAYS, "#Game \"%s\" is not paused (flag: %s)", games_list[_game.current_game].name, (_pause_flag) ? "set" : "cleared");
         return true; //Return true to indicate that the game was resumed successfully
     }
+    //The deadlines carry on from where they were when we paused
+    uint64_t _paused_ms = sys_poll_tmr_ms() - _game.paused_ms;
+    _game.next_tick_ms += _paused_ms;
+    for (int i = 0; i < GAME_TIMERS_MAX; i++)
+    {
+        if (_game.tmr_expiry[i] != 0)
+            _game.tmr_expiry[i] += _paused_ms;
+    }
     _game.state = game_state_running;
     _pause_flag = false; //Reset the pause flag
+    tlm_send(tlm_game, tlm_game_resumed, _game.current_game, 0);
     iprintln(trGAME|trALWAYS, "#Resuming \"%s\" (%d)", games_list[_game.current_game].name, _game.current_game);
     vTaskResume(_game.task.handle); //Resume the task
     return true;
@@ -396,6 +563,56 @@ bool game_parse_args(int game_index, const char **arg_str_array, int arg_cnt)
     return games_list[game_index].cb_arg_parse(arg_str_array, arg_cnt, &_new_params);
 }
 
+bool game_event_post(game_evt_type_t type, int slot, uint32_t value)
+{
+    game_event_t evt = {.type = type, .slot = slot, .value = value, .time_ms = sys_poll_tmr_ms()};
+
+    //Only a game that has been initialised gets events
+    if ((_game.evt_queue == NULL) || (_game.state < game_state_init))
+        return false;
+
+    if (xQueueSend(_game.evt_queue, &evt, 0) != pdTRUE)
+    {
+        _game_metrics.evt_drops++;
+        return false;
+    }
+    return true;
+}
+
+void game_timer_start(int id, uint32_t period_ms)
+{
+    if ((id < 0) || (id >= GAME_TIMERS_MAX))
+        return;
+
+    _game.tmr_expiry[id] = sys_poll_tmr_ms() + period_ms;
+}
+
+void game_timer_stop(int id)
+{
+    if ((id < 0) || (id >= GAME_TIMERS_MAX))
+        return;
+
+    _game.tmr_expiry[id] = 0;
+}
+
+bool game_timer_running(int id)
+{
+    if ((id < 0) || (id >= GAME_TIMERS_MAX))
+        return false;
+
+    return (_game.tmr_expiry[id] != 0);
+}
+
+uint32_t game_timer_remaining_ms(int id)
+{
+    uint64_t now_ms = sys_poll_tmr_ms();
+
+    if ((!game_timer_running(id)) || (_game.tmr_expiry[id] <= now_ms))
+        return 0;
+
+    return (uint32_t)(_game.tmr_expiry[id] - now_ms);
+}
+
 #undef PRINTF_TAG
 
 /*************************** END OF FILE *************************************/
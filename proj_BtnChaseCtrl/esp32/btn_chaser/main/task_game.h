@@ -25,16 +25,37 @@ Macros
 
 #define TASK_GAME_INTERVAL_MS      (50)     /* Task cycles at a 25Hz rate*/
 
+#define GAME_TIMERS_MAX             (4)      /* The number of game timers (game_timer_start()) */
+
 /******************************************************************************
 variables
 ******************************************************************************/
+typedef enum
+{
+    game_evt_press = 0,     // A button was pressed: slot, value = reaction time (ms)
+    game_evt_node_joined,   // A node was registered: slot, value = address
+    game_evt_node_lost,     // A node was deregistered: slot (now used by the next node, if any), value = address
+    game_evt_timer,         // A game timer expired: value = timer id
+    game_evt_txn_done,      // A msg to a node is done: slot, value = true if the node responded
+} game_evt_type_t;
+
+typedef struct
+{
+    game_evt_type_t type;
+    int slot;               // The node the event is about (-1 if none)
+    uint32_t value;         // Depends on the type (see above)
+    uint64_t time_ms;       // When the event happened
+} game_event_t;
+
 typedef struct
 {
     const char *name;
-	void (*cb_main)(void);
+	void (*cb_main)(void);                              // Called every tick_ms
 	void (*cb_init)(bool startup, bool new_game_params);
 	void (*cb_teardown)(void);
     bool (*cb_arg_parse)(const char **arg_str_array, int arg_cnt, bool * new_game_params);
+    void (*cb_event)(const game_event_t *evt);          // Called for every event, as it arrives (may be NULL)
+    uint32_t tick_ms;                                   // The period at which cb_main is called (0 for no ticks)
 } game_t;
 
 /******************************************************************************
@@ -61,6 +82,38 @@ const char * game_name(int index);
 
 bool game_parse_args(int game_index, const char **arg_str_array, int arg_cnt);
 
+/*! \brief Passes an event on to the running game. Safe to call from any task.
+ * \param type The type of event
+ * \param slot The node the event is about (-1 if none)
+ * \param value Depends on the type of event
+ * \return true if the event was queued, false if no game is running (or the queue is full)
+ */
+bool game_event_post(game_evt_type_t type, int slot, uint32_t value);
+
+/*! \brief Starts (or restarts) a game timer, a game_evt_timer is passed to the game when it expires.
+ * Only to be called from the game callbacks.
+ * \param id The timer (0 to GAME_TIMERS_MAX-1)
+ * \param period_ms The time to expiry (0 expires as soon as the queued events have been handled)
+ */
+void game_timer_start(int id, uint32_t period_ms);
+
+/*! \brief Stops a game timer (no event is passed to the game)
+ * \param id The timer (0 to GAME_TIMERS_MAX-1)
+ */
+void game_timer_stop(int id);
+
+/*! \brief Checks if a game timer is still running
+ * \param id The timer (0 to GAME_TIMERS_MAX-1)
+ * \return true if the timer has been started and its game_evt_timer has not been passed on yet
+ */
+bool game_timer_running(int id);
+
+/*! \brief Reads the time left on a game timer
+ * \param id The timer (0 to GAME_TIMERS_MAX-1)
+ * \return The time left in ms (0 if it is not running)
+ */
+uint32_t game_timer_remaining_ms(int id);
+
 #undef EXT
 #endif /* __task_game_H__ */
 
@@ -28,6 +28,7 @@ includes
 #include "sys_task_utils.h"
 #include "str_helper.h"
 #include "task_console.h"
+#include "sys_metrics.h"
 #include "drv_rgb_led_strip.h"
 #include "esp_random.h"
 
@@ -53,6 +54,15 @@ Macros and Constants
 #define LED_RAINBOW_PER_MAX_MS      (0xFFFF * LED_UPDATE_INTERVAL_MS)    /* Cycling through the spectrum in 21m 50.7s */
 #define LED_RAINBOW_PERIOD_MS_DEF   3800
 
+#define LED_EFFECT_PERIOD_MS_MIN    200     /* The shortest period for breathe, chase, comet and sparkle */
+#define LED_EFFECT_PERIOD_MS_DEF    2000
+
+#define LED_FX_MAX                  16      /* The max number of effect instances running at the same time */
+#define LED_FX_NONE                 0xFF    /* The LED shows a static colour */
+
+#define LED_SEGMENTS_MAX            8       /* The max number of named segments */
+#define LED_SEGMENT_NAME_LEN        12      /* Including the terminator */
+
 /*******************************************************************************
 local defines 
  *******************************************************************************/
@@ -61,17 +71,9 @@ typedef enum
     led_bit_dbg = 0,        /* Debug LED (only 1) */
     led_bit_btn_0 = 1,      /* Start of Button LEDs */
     /* Keep this at the end*/
-    led_bit_max = 16,       /* Allows for up to 16 LEDs in total (dbg + 15) */
+    led_bit_max = 16,       /* Address masks only reach the first 16 LEDs (dbg + 15), use ranges beyond that */
 }led_addr_bit_index;
 
-typedef enum
-{
-    led_state_off = 0,
-    led_state_on = 1,
-    led_state_blink = 2,
-    led_state_rainbow = 3,
-}rgb_led_state_t;
-
 typedef enum {
     led_action_nop,         /* No value required */
     led_action_off,         /* No value required */
@@ -79,6 +81,10 @@ typedef enum {
     led_action_blink,       /* blink period in ms (0 to 16,777,215/4h39m37.215s) */
     led_action_rainbow,     /* rotation period in ms (0 to 16,777,215/4h39m37.215s) */
     led_action_status,      /* No value required */
+    led_action_breathe,     /* fade in and out, period in ms */
+    led_action_chase,       /* a single LED running along the LEDs, period in ms (for one lap) */
+    led_action_comet,       /* a LED with a fading tail running along the LEDs, period in ms (for one lap) */
+    led_action_sparkle,     /* LEDs flashing at random moments, period in ms */
     /* Keep this at the end*/
     led_action_total,
 }rgb_led_action_cmd;
@@ -91,28 +97,56 @@ typedef enum {
  */
 
 typedef struct {
-    union 
-    {
-        struct 
-        {
-            uint16_t cmd;       // 0 = off, 1 = on/colour, 2 = blink, 3 = rainbow (4, to 0xFFFF spare)
-            uint16_t led_addr;  // bit-map address for the affected LEDs
-        };
-        /* data */
-        uint32_t cmd_and_addr;
-    };
+    uint16_t cmd;           // 0 = off, 1 = on/colour, 2 = blink, 3 = rainbow (4, to 0xFFFF spare)
+    uint16_t range_cnt;     // The number of ranges in use
+    rgb_led_range_t range[RGB_LED_RANGES_MAX]; // The affected LEDs
     uint32_t val_0;         // based on action. Max requirement: 24 bits for colour value
     uint32_t val_1;         // based on action. Max requirement: 24 bits for colour value
     uint32_t val_2;         // based on action. Max requirement: 24 bits for colour value
-} rgb_led_action_msg_t;     // 32 bits
+} rgb_led_action_msg_t;
 
+/*! An effect instance is started by a single action msg and drives all of the LEDs 
+ * addressed by that msg. The colour of a LED is worked out from the time elapsed 
+ * since the instance was started (not from the number of task cycles).
+ */
 typedef struct {
-//    uint32_t id;            // 0 to 15
-    uint32_t col_1;         // 24 bit RGB value
-    uint32_t col_2;         // 24 bit RGB value (used for blink)
-    rgb_led_state_t state;
-    Timer_ms_t timer;
-} rgb_led_t;     // 32 bits
+    uint16_t action;        // The rgb_led_action_cmd which started the effect
+    uint16_t users;         // The number of LEDs still driven by this instance (0 = free)
+    uint16_t count;         // The number of LEDs the effect was started on
+    uint32_t col_1;         // 24 bit RGB value (the primary colour)
+    uint32_t col_2;         // 24 bit RGB value (the secondary/background colour)
+    uint32_t period_ms;     // The period of the effect
+    uint64_t start_ms;      // When the effect was started
+} rgb_led_fx_t;
+
+/*! Returns the colour of a LED in an effect
+ * @param fx The effect instance
+ * @param pos The position of the LED in the effect (0 to fx->count-1)
+ * @param t_ms The time since the effect was started
+ */
+typedef uint32_t (*rgb_led_fx_render_t)(const rgb_led_fx_t * fx, uint16_t pos, uint32_t t_ms);
+
+typedef struct {
+    const char * name;
+    rgb_led_fx_render_t render; // NULL if this action is not an effect
+    uint8_t colours;            // The number of colours taken by the action
+    uint32_t period_min_ms;
+    uint32_t period_def_ms;
+} rgb_led_action_desc_t;
+
+/*! The per-LED state is kept in separate (compact) arrays, allocated as a single 
+ * block at setup, iso an array of structs with a timer for every LED.
+ */
+typedef struct {
+    uint32_t * col;         // 24 bit RGB value (the current colour)
+    uint16_t * pos;         // The position of the LED in its effect
+    uint8_t * fx;           // The effect instance driving the LED (LED_FX_NONE for a static colour)
+} rgb_led_arrays_t;
+
+typedef struct {
+    char name[LED_SEGMENT_NAME_LEN];
+    rgb_led_range_t range;
+} rgb_led_segment_t;
 
 // typedef struct
 // {
@@ -124,7 +158,10 @@ typedef struct
 {
     bool init_done;
     int cnt;
-    rgb_led_t * array;    
+    rgb_led_arrays_t led;
+    void * led_mem;         // The block holding all of the led arrays
+    rgb_led_fx_t fx[LED_FX_MAX];
+    rgb_led_segment_t segment[LED_SEGMENTS_MAX];
 	TaskInfo_t task;
     QueueHandle_t msg_queue;
 
@@ -168,18 +205,66 @@ void _read_msg_queue(void);
  */
 void _led_service(void);
 
-/*! @brief Sets the colour of the LED at the specified index
- * @param _index The index of the LED to set the colour for
- * @param _rgb The 24-bit RGB value to set the LED to
+/*! @brief Detaches a LED from the effect driving it (if any)
+ * @param _led_nr The index of the LED
+ */
+void _led_release(int _led_nr);
+
+/*! @brief Finds an unused effect instance
+ * @return The index of the instance, or -1 if all are in use
+ */
+int _led_fx_alloc(void);
+
+/*! @brief Blends two colours
+ * @param from The colour at level 0
+ * @param to The colour at level 255
+ * @param level The blend level (0 to 255)
+ * @return The blended 24 bit RGB colour
+ */
+uint32_t _led_blend(uint32_t from, uint32_t to, uint32_t level);
+
+/*! @brief The effect renderers (see rgb_led_fx_render_t)
  */
-void _set_colour(led_addr_bit_index _index, uint32_t _rgb);
+uint32_t _led_fx_blink(const rgb_led_fx_t * fx, uint16_t pos, uint32_t t_ms);
+uint32_t _led_fx_rainbow(const rgb_led_fx_t * fx, uint16_t pos, uint32_t t_ms);
+uint32_t _led_fx_breathe(const rgb_led_fx_t * fx, uint16_t pos, uint32_t t_ms);
+uint32_t _led_fx_chase(const rgb_led_fx_t * fx, uint16_t pos, uint32_t t_ms);
+uint32_t _led_fx_comet(const rgb_led_fx_t * fx, uint16_t pos, uint32_t t_ms);
+uint32_t _led_fx_sparkle(const rgb_led_fx_t * fx, uint16_t pos, uint32_t t_ms);
+
+/*! @brief Adds a range of LEDs to an action msg, merging it with the last range if they touch
+ * @param msg The action msg
+ * @param first The index of the first LED in the range
+ * @param count The number of LEDs in the range
+ * @return true if successful, false if the msg has no space for another range
+ */
+bool _led_msg_add_range(rgb_led_action_msg_t * msg, int first, int count);
+
+/*! @brief Adds the LEDs in a 16 bit address mask to an action msg
+ * @param msg The action msg
+ * @param address_mask The address mask
+ */
+void _led_msg_add_mask(rgb_led_action_msg_t * msg, uint16_t address_mask);
+
+/*! @brief Validates and queues an action msg to the LED task
+ * @param msg The action msg
+ * @param caller The name of the calling function (for error reporting)
+ * @return ESP_OK if the msg was queued
+ */
+esp_err_t _led_msg_queue(rgb_led_action_msg_t * msg, const char * caller);
+
+/*! @brief Looks up a named segment
+ * @param name The name of the segment
+ * @return A pointer to the segment, or NULL if not found
+ */
+rgb_led_segment_t * _led_segment_find(const char * name);
 
-/*! @brief Parses the arguments in the string and converts it to set bits in the address mask
- * @param[out] addr_mask The address mask if successful, otherwise unchanged
+/*! @brief Parses the arguments in the string and adds the LEDs it refers to, to the msg
+ * @param[out] led_msg The action msg to add the address range(s) to
  * @param[in] arg_str The string containing the arguments to parse
  * @return ESP_OK if successful, otherwise an error code
  */
-esp_err_t _handler_parse_address_str(uint32_t * addr_mask, const char * str);
+esp_err_t _handler_parse_address_str(rgb_led_action_msg_t * led_msg, const char * str);
 
 /*! @brief Common action handler for LED actions
  */
@@ -197,6 +282,19 @@ void _led_handler_status(void);
  */
 void _led_handler_reset(void);
 
+/*! @brief Console menu handler to list and define named LED segments
+ */
+void _led_handler_segment(void);
+
+/*! @brief Console menu handler to display or set the output correction of the LED strips
+ */
+void _led_handler_calib(void);
+
+/*! @brief Prints the usage of <led_addr> for the console menu handlers
+ * @param action The name of the action being described
+ */
+void _led_print_addr_usage(const char * action);
+
 /*******************************************************************************
 local variables
  *******************************************************************************/
@@ -207,14 +305,35 @@ ConsoleMenuItem_t _led_menu_items[] =
         {"on",      _led_handler_common_action, "Sets LEDs to a specific colour"},
         {"blink",   _led_handler_common_action, "Blinks LEDs at a specified rate and colour(s)"},
         {"rainbow", _led_handler_common_action, "Apply rainbow effect on LEDs"},
+        {"breathe", _led_handler_common_action, "Fades LEDs in and out"},
+        {"chase",   _led_handler_common_action, "Runs a single LED along the LEDs"},
+        {"comet",   _led_handler_common_action, "Runs a LED with a fading tail along the LEDs"},
+        {"sparkle", _led_handler_common_action, "Flashes LEDs at random moments"},
         {"rgb",     _led_handler_col_list,      "Displays the RGB hex values for predefined colours"},
 		{"status",  _led_handler_status,        "Displays the status of the LEDs"},
 		{"reset",   _led_handler_reset,         "Resets the state of the LEDs"},
+		{"segment", _led_handler_segment,       "Lists or defines named LED segments"},
+		{"calib",   _led_handler_calib,         "Displays or sets the LED strip colour correction"},
+};
+
+/*! Everything the console, the msg queue and the renderer needs to know about each action
+ */
+static const rgb_led_action_desc_t _led_action_desc[led_action_total] = {
+    [led_action_nop]        = {.name = "nop"},
+    [led_action_off]        = {.name = "off"},
+    [led_action_colour]     = {.name = "on",      .colours = 1},
+    [led_action_blink]      = {.name = "blink",   .render = _led_fx_blink,   .colours = 2, .period_min_ms = LED_BLINK_PERIOD_MS_MIN*2, .period_def_ms = LED_BLINK_PERIOD_MS_DEF},
+    [led_action_rainbow]    = {.name = "rainbow", .render = _led_fx_rainbow, .colours = 0, .period_min_ms = LED_RAINBOW_PER_MIN_MS,    .period_def_ms = LED_RAINBOW_PERIOD_MS_DEF},
+    [led_action_status]     = {.name = "status"},
+    [led_action_breathe]    = {.name = "breathe", .render = _led_fx_breathe, .colours = 2, .period_min_ms = LED_EFFECT_PERIOD_MS_MIN,  .period_def_ms = LED_EFFECT_PERIOD_MS_DEF},
+    [led_action_chase]      = {.name = "chase",   .render = _led_fx_chase,   .colours = 2, .period_min_ms = LED_EFFECT_PERIOD_MS_MIN,  .period_def_ms = LED_EFFECT_PERIOD_MS_DEF},
+    [led_action_comet]      = {.name = "comet",   .render = _led_fx_comet,   .colours = 2, .period_min_ms = LED_EFFECT_PERIOD_MS_MIN,  .period_def_ms = LED_EFFECT_PERIOD_MS_DEF},
+    [led_action_sparkle]    = {.name = "sparkle", .render = _led_fx_sparkle, .colours = 2, .period_min_ms = LED_EFFECT_PERIOD_MS_MIN,  .period_def_ms = LED_EFFECT_PERIOD_MS_DEF},
 };
 
 static DeviceRgb_t _rgb_led = {
     .cnt = 0,
-    .array = NULL,
+    .led_mem = NULL,
 	.task = {   
         .init_done = false,
         .handle = NULL,
@@ -226,6 +345,18 @@ static DeviceRgb_t _rgb_led = {
     .msg_queue = NULL,
 };
 
+/* How long it takes to render and flush a frame, vs the LED_UPDATE_INTERVAL_MS it has */
+struct {
+    metric_hist_t frame;
+    uint32_t overruns;
+}_led_metrics = {.frame = METRIC_HIST_INIT(100, 200, 500, 1000, 2000, 5000, 10000)};
+
+const metric_item_t _led_metric_items[] =
+{
+    {"frame",       "us",   metric_hist,    &_led_metrics.frame},
+    {"overruns",    NULL,   metric_counter, &_led_metrics.overruns},
+};
+
 /*******************************************************************************
 Local (private) Functions
 *******************************************************************************/
@@ -251,11 +382,20 @@ void _led_main_func(void * pvParameters)
 
     while (1) 
     {
+        int64_t _frame_start_us = esp_timer_get_time();
 
         _read_msg_queue();
         
         _led_service();
 
+        //All the changes made during this tick go out in one go
+        drv_rgb_led_strip_flush();
+
+        uint32_t _frame_us = (uint32_t)(esp_timer_get_time() - _frame_start_us);
+        metric_hist_add(&_led_metrics.frame, _frame_us);
+        if (_frame_us > (LED_UPDATE_INTERVAL_MS * 1000))
+            _led_metrics.overruns++;
+
         xTaskDelayUntil(&xLastWakeTime, MAX(1, pdMS_TO_TICKS(LED_UPDATE_INTERVAL_MS)));  //vTaskDelay(pdMS_TO_TICKS(EXAMPLE_CHASE_SPEED_MS));
     
         /* Inspect our own high water mark on entering the task. */
@@ -282,6 +422,7 @@ void _led_setup(void)
 #ifdef CONSOLE_ENABLED
     console_add_menu("led", _led_menu_items, ARRAY_SIZE(_led_menu_items), "LED Control");
 #endif
+    metrics_add("led", _led_metric_items, ARRAY_SIZE(_led_metric_items));
 
     //We need to create a message queue for the LED task, let's make it double to the total led_action_total count
     _rgb_led.msg_queue = xQueueCreate(led_action_total*2, sizeof(rgb_led_action_msg_t));
@@ -292,26 +433,29 @@ void _led_setup(void)
         assert(0);
     }
 
-    //We also need to create a timer for each LED (for blinking)
-    _rgb_led.array = (rgb_led_t *)malloc(_rgb_led.cnt * sizeof(rgb_led_t));
-    if (_rgb_led.array == NULL)
+    //We also need to keep the state of each LED (for blinking, etc)... all zero is black and off
+    _rgb_led.led_mem = calloc(_rgb_led.cnt, sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint8_t));
+    if (_rgb_led.led_mem == NULL)
     {
-        // Queue was not created and must not be used.
-        iprintln(trLED|trALWAYS, "#Unable to create Timers for LED task");
+        // Array was not created and must not be used.
+        iprintln(trLED|trALWAYS, "#Unable to create LED arrays for LED task");
         assert(0);
     }
     else
     {
-        //Build the content of the array to match the LEDs
-        for (int i = 0; i < _rgb_led.cnt; i++)
-        {
-            _rgb_led.array[i].col_1 = colBlack;
-            _rgb_led.array[i].col_2 = colBlack;
-            _rgb_led.array[i].state = led_state_off;
-            sys_poll_tmr_stop(&_rgb_led.array[i].timer);
-        }
-        //memset(_rgb_led.array, 0, _rgb_led.cnt * sizeof(rgb_led_t));
+        //Carve the block up, widest type first to keep the alignment
+        _rgb_led.led.col = (uint32_t *)_rgb_led.led_mem;
+        _rgb_led.led.pos = (uint16_t *)(_rgb_led.led.col + _rgb_led.cnt);
+        _rgb_led.led.fx = (uint8_t *)(_rgb_led.led.pos + _rgb_led.cnt);
+        memset(_rgb_led.led.fx, LED_FX_NONE, _rgb_led.cnt);
     }
+    memset(_rgb_led.fx, 0, sizeof(_rgb_led.fx));
+
+    //The effects look up the hue wheel (see colour.c) - make sure it is built before the first frame
+    (void)hue2rgb(0);
+
+    //No named segments yet (the strip names are handled by the driver)
+    memset(_rgb_led.segment, 0, sizeof(_rgb_led.segment));
 
     _rgb_led.task.init_done = true;
 
@@ -326,16 +470,12 @@ void _led_setup(void)
 
 void _led_teardown(void)
 {
-    for (int _led = 0; _led < _rgb_led.cnt; _led++)
-        sys_poll_tmr_stop(&_rgb_led.array[_led].timer);
-
-    //memset(_rgb_led.array, 0, _rgb_led.cnt * sizeof(rgb_led_t));
-
     //Free the allocated memory
-    if (_rgb_led.array != NULL)
+    if (_rgb_led.led_mem != NULL)
     {
-        free(_rgb_led.array);
-        _rgb_led.array = NULL;
+        free(_rgb_led.led_mem);
+        _rgb_led.led_mem = NULL;
+        memset(&_rgb_led.led, 0, sizeof(_rgb_led.led));
     }
 
     _rgb_led.cnt = 0;
@@ -347,229 +487,385 @@ void _led_teardown(void)
 void _read_msg_queue(void)
 {     
     rgb_led_action_msg_t rx_msg;
+    rgb_led_arrays_t * led = &_rgb_led.led;
 
     //Check if there is a message in the queue
     while (xQueueReceive(_rgb_led.msg_queue, &rx_msg, 0) == pdTRUE)
     {
-        if (rx_msg.led_addr == 0)
+        if ((rx_msg.range_cnt == 0) || (rx_msg.cmd >= led_action_total))
         {
-            iprintln(trLED, "#Empty address list msg rx'd in queue: action", rx_msg.cmd);
+            iprintln(trLED, "#Empty address list msg rx'd in queue: action %d", rx_msg.cmd);
             continue;  //No LEDs are affected by this message
         }
+        const rgb_led_action_desc_t * desc = &_led_action_desc[rx_msg.cmd];
 
-        //We have a message, let's process it for every LED that it affects
-        for (uint32_t _led_nr = 0; _led_nr < _rgb_led.cnt; _led_nr++)
+        if (rx_msg.cmd == led_action_nop)
+            continue;   //Does nothing except use up a space in the msg queue
+
+        if (rx_msg.cmd == led_action_status)
         {
+            for (int r = 0; r < rx_msg.range_cnt; r++)
+            {
+                int last = min(_rgb_led.cnt, rx_msg.range[r].first + rx_msg.range[r].count);
+                for (int _led_nr = rx_msg.range[r].first; _led_nr < last; _led_nr++)
+                    _led_info_print(_led_nr);
+            }
+            iprintln(trALWAYS, "");
+            continue;
+        }
 
-            if ((rx_msg.led_addr & BIT(_led_nr)) == 0)
-                continue;   //This LED is not affected by the message
+        //Detach all of the LEDs first, so that the instances they were using can be reused
+        for (int r = 0; r < rx_msg.range_cnt; r++)
+        {
+            int last = min(_rgb_led.cnt, rx_msg.range[r].first + rx_msg.range[r].count);
+            for (int _led_nr = rx_msg.range[r].first; _led_nr < last; _led_nr++)
+                _led_release(_led_nr);
+        }
 
-            //This LED is affected by the message
-            switch (rx_msg.cmd)
+        int fx_index = -1;
+        rgb_led_fx_t * fx = NULL;
+        if (desc->render != NULL)
+        {
+            fx_index = _led_fx_alloc();
+            if (fx_index < 0)
+            {
+                iprintln(trLED|trALWAYS, "#No free effect instance for %s (max %d)", desc->name, LED_FX_MAX);
+                continue;
+            }
+            fx = &_rgb_led.fx[fx_index];
+
+            //Val_0 is the 1st (primary) colour
+            //Val_1 is the period (in ms)
+            //Val_2 is the 2nd (alternating/background) colour
+            fx->action = rx_msg.cmd;
+            fx->users = 0;
+            fx->col_1 = (rx_msg.val_0 & 0x00FFFFFF);
+            fx->col_2 = (rx_msg.val_2 & 0x00FFFFFF);
+            fx->period_ms = max(desc->period_min_ms, min(rx_msg.val_1, LED_RAINBOW_PER_MAX_MS));
+            fx->start_ms = sys_poll_tmr_ms();
+        }
+
+        //We have a message, let's process it for every LED that it affects
+        uint16_t pos = 0;
+        for (int r = 0; r < rx_msg.range_cnt; r++)
+        {
+            int last = min(_rgb_led.cnt, rx_msg.range[r].first + rx_msg.range[r].count);
+            for (int _led_nr = rx_msg.range[r].first; _led_nr < last; _led_nr++)
             {
-                case led_action_nop:
-                    //Does nothing except use up a space in the msg queue
-                    break;
-                case led_action_off:
-                    iprintln(trLED, "#%s -> OFF", drv_rgb_led_strip_index2name(_led_nr));
-                    //Val_0, Val_1 and Val_2 are not used
-                    _rgb_led.array[_led_nr].col_1 = 0;
-                    drv_rgb_led_strip_set_colour(_led_nr, 0);
-                    _rgb_led.array[_led_nr].state = led_state_off;
-                    sys_poll_tmr_stop(&_rgb_led.array[_led_nr].timer);
-                    break;
-                case led_action_colour:
-                    iprintln(trLED, "#%s -> ON (colour: %06X)", drv_rgb_led_strip_index2name(_led_nr), rx_msg.val_0);
-                    //Val_0 is the colour
-                    //Val_1 and Val_2 are not used
-                    _rgb_led.array[_led_nr].col_1 = rx_msg.val_0;
-                    drv_rgb_led_strip_set_colour(_led_nr, rx_msg.val_0);
-                    _rgb_led.array[_led_nr].state = (rx_msg.val_0 == 0)? led_state_off : led_state_on; //If the colour is black, then the state is off, otherwise it is on
-                    sys_poll_tmr_stop(&_rgb_led.array[_led_nr].timer);
-                    break;
-                case led_action_blink:            
-                    iprintln(trLED, "#%s -> Set to Blink (%06X <-> %06X) at %dms", drv_rgb_led_strip_index2name(_led_nr), rx_msg.val_0, (rx_msg.val_2 & 0x00FFFFFF), rx_msg.val_1);
-                    //Val_0 is the 1st (primary) colour
-                    //Val_1 is the period (in ms)
-                    //Val_2 is the 2nd/alternating  colour
-                    //First make sure the blink timer period is good
-                    // Since the task is running at 20ms intervals, we can only set the timer to multiples of 20ms
-                    if ((rx_msg.val_1%LED_UPDATE_INTERVAL_MS) > 0)
-                        rx_msg.val_1 = (LED_UPDATE_INTERVAL_MS * ((rx_msg.val_1/LED_UPDATE_INTERVAL_MS)+1));
-                        // rx_msg.val_1 += (LED_UPDATE_INTERVAL_MS - (rx_msg.val_1%LED_UPDATE_INTERVAL_MS));
-
-                    //Blinking faster than 10Hz is not really useful
-                    if (rx_msg.val_1 < LED_BLINK_PERIOD_MS_MIN)
-                        rx_msg.val_1 = LED_BLINK_PERIOD_MS_MIN;
-
-                        //Start the timer and assign the primary colour
-                    drv_rgb_led_strip_set_colour(_led_nr, rx_msg.val_0);
-                    //Swop the primary and secondary colours for the next iteration
-                    _rgb_led.array[_led_nr].col_1 = (rx_msg.val_2 & 0x00FFFFFF);
-                    _rgb_led.array[_led_nr].col_2 = (rx_msg.val_0 & 0x00FFFFFF);
-                    _rgb_led.array[_led_nr].state = led_state_blink;
-                    sys_poll_tmr_start(&_rgb_led.array[_led_nr].timer, (uint64_t)rx_msg.val_1/2, true);
-                    break;
-                case led_action_rainbow:
-                    iprintln(trLED, "#%s LED -> Rainbow at %dms", drv_rgb_led_strip_index2name(_led_nr), rx_msg.val_1);
-                    //Val_0 is not used
-                    //Val_1 is the period (in ms)
-                    //Val_2 is not used
-                    //First make sure the timer period is good
-                    // Since the task is running at 20ms intervals, we can only set the timer to multiples of 20ms
-                    if ((rx_msg.val_1%LED_UPDATE_INTERVAL_MS) > 0)
-                        rx_msg.val_1 = (LED_UPDATE_INTERVAL_MS * ((rx_msg.val_1/LED_UPDATE_INTERVAL_MS)+1));
-                        //rx_msg.val_1 += (LED_UPDATE_INTERVAL_MS - (rx_msg.val_1%LED_UPDATE_INTERVAL_MS));
-
-                    //Blinking faster than 10Hz is not really useful
-                    if (rx_msg.val_1 < LED_RAINBOW_PER_MIN_MS)
-                        rx_msg.val_1 = LED_RAINBOW_PER_MIN_MS;
-                    if (rx_msg.val_1 > LED_RAINBOW_PER_MAX_MS)
-                        rx_msg.val_1 = LED_RAINBOW_PER_MAX_MS;
-                    
-                    drv_rgb_led_strip_set_colour(_led_nr, 0);
-                    //The minimum timer value is 20ms (LED_UPDATE_INTERVAL_MS).
-                    //Dividing the period by LED_UPDATE_INTERVAL_MS gives us a count of how many task cycles it takes to loop through the 360 degree hue spectrum,
-                    //No need to start a timer... we use the task cycle interval to update the hue (if needed)
-                    _rgb_led.array[_led_nr].col_1 = 0;
-                    _rgb_led.array[_led_nr].col_2 = (rx_msg.val_1/LED_UPDATE_INTERVAL_MS) & 0xFFFF;
-                    // iprintln(trLED, "#%s LED: Rainbow effect at %dms (%d x %d = %d)", 
-                    //     drv_rgb_led_strip_index2name(_led_nr), rx_msg.val_1, _rgb_led.array[_led_nr].col_2, LED_UPDATE_INTERVAL_MS, _rgb_led.array[_led_nr].col_2 * LED_UPDATE_INTERVAL_MS);
-                    _rgb_led.array[_led_nr].state = led_state_rainbow;
-                    // sys_stopwatch_ms_start(&_rgb_led.sw);
-                    sys_poll_tmr_stop(&_rgb_led.array[_led_nr].timer);
-                    break;
-                case led_action_status:
+                if (fx != NULL)
                 {
-                    _led_info_print(_led_nr);
-                    if (_led_nr == (_rgb_led.cnt - 1))
-                        iprintln(trALWAYS, "");
-                    break;
+                    //The colour is rendered in _led_service()
+                    if (led->fx[_led_nr] != fx_index)
+                        fx->users++;
+                    led->fx[_led_nr] = fx_index;
+                    led->pos[_led_nr] = pos++;
+                }
+                else
+                {
+                    //Off or a static colour
+                    led->col[_led_nr] = (rx_msg.cmd == led_action_colour)? (rx_msg.val_0 & 0x00FFFFFF) : colBlack;
+                    drv_rgb_led_strip_set_colour(_led_nr, led->col[_led_nr]);
                 }
-                default:
-                    break;
             }
         }
+        if (fx != NULL)
+            fx->count = max(1, pos);
+
+        //drv_rgb_led_strip_index2name() uses a static buffer, so only once per line
+        iprintln(trLED, "#%s -> %s (%d range(s))", drv_rgb_led_strip_index2name(rx_msg.range[0].first), desc->name, rx_msg.range_cnt);
+    }
+}
+
+void _led_release(int _led_nr)
+{
+    uint8_t fx_index = _rgb_led.led.fx[_led_nr];
+
+    if (fx_index == LED_FX_NONE)
+        return;
+
+    if (_rgb_led.fx[fx_index].users > 0)
+        _rgb_led.fx[fx_index].users--;
+    _rgb_led.led.fx[_led_nr] = LED_FX_NONE;
+}
+
+int _led_fx_alloc(void)
+{
+    for (int i = 0; i < LED_FX_MAX; i++)
+    {
+        if (_rgb_led.fx[i].users == 0)
+            return i;
+    }
+    return -1;
+}
+
+uint32_t _led_blend(uint32_t from, uint32_t to, uint32_t level)
+{
+    uint32_t rgb = 0;
+
+    if (level >= 255)
+        return to;
+
+    //Channel by channel, from the top (red) byte down
+    for (int shift = 16; shift >= 0; shift -= 8)
+    {
+        int32_t f = (from >> shift) & 0xFF;
+        int32_t t = (to >> shift) & 0xFF;
+        rgb |= (uint32_t)(f + (((t - f) * (int32_t)level) / 255)) << shift;
     }
+    return rgb;
+}
+
+uint32_t _led_fx_blink(const rgb_led_fx_t * fx, uint16_t pos, uint32_t t_ms)
+{
+    //Starts with the primary colour, swopping every half period
+    return ((t_ms / (fx->period_ms/2)) & 0x01)? fx->col_2 : fx->col_1;
+}
+
+uint32_t _led_fx_rainbow(const rgb_led_fx_t * fx, uint16_t pos, uint32_t t_ms)
+{
+    //All of the LEDs cycle through the spectrum together
+    return hue2rgb(((t_ms % fx->period_ms) * HUE_MAX) / fx->period_ms);
+}
+
+uint32_t _led_fx_breathe(const rgb_led_fx_t * fx, uint16_t pos, uint32_t t_ms)
+{
+    //A triangle from the secondary to the primary colour and back, squared to look smoother to the eye
+    uint32_t phase = t_ms % fx->period_ms;
+    uint32_t half = fx->period_ms / 2;
+    uint32_t level = (phase < half)? (phase * 255) / half : ((fx->period_ms - phase) * 255) / (fx->period_ms - half);
+    return _led_blend(fx->col_2, fx->col_1, (level * level) / 255);
+}
+
+uint32_t _led_fx_chase(const rgb_led_fx_t * fx, uint16_t pos, uint32_t t_ms)
+{
+    uint32_t head = (uint32_t)(((uint64_t)(t_ms % fx->period_ms) * fx->count) / fx->period_ms);
+    return (pos == head)? fx->col_1 : fx->col_2;
+}
+
+uint32_t _led_fx_comet(const rgb_led_fx_t * fx, uint16_t pos, uint32_t t_ms)
+{
+    //The tail covers a third of the LEDs (at least 1), fading towards the background colour
+    uint32_t head = (uint32_t)(((uint64_t)(t_ms % fx->period_ms) * fx->count) / fx->period_ms);
+    uint32_t tail = max(1, fx->count / 3);
+    uint32_t dist = (head + fx->count - pos) % fx->count;
+    if (dist >= tail)
+        return fx->col_2;
+    return _led_blend(fx->col_2, fx->col_1, 255 - ((dist * 255) / tail));
+}
+
+uint32_t _led_fx_sparkle(const rgb_led_fx_t * fx, uint16_t pos, uint32_t t_ms)
+{
+    //Every LED flashes once per period, at a (fixed) pseudo random offset, then fades over a quarter period
+    uint32_t offset = ((((uint32_t)(pos + 1) * 2654435761UL) >> 24) * fx->period_ms) / 256;
+    uint32_t phase = (t_ms + offset) % fx->period_ms;
+    uint32_t flash = max(1, fx->period_ms / 4);
+    if (phase >= flash)
+        return fx->col_2;
+    return _led_blend(fx->col_2, fx->col_1, 255 - ((phase * 255) / flash));
 }
 
 void _led_service(void)
 {     
-    static uint32_t hue = 0;
+    rgb_led_arrays_t * led = &_rgb_led.led;
+    uint64_t now = sys_poll_tmr_ms();
 
+    //Render every LED driven by an effect, only passing those that changed on to the driver
     for (int _led_nr = 0; _led_nr < _rgb_led.cnt; _led_nr++)
     {
-        rgb_led_t * rgb_led = &_rgb_led.array[_led_nr];
-        switch (rgb_led->state)
+        if (led->fx[_led_nr] == LED_FX_NONE)
+            continue;
+
+        const rgb_led_fx_t * fx = &_rgb_led.fx[led->fx[_led_nr]];
+        uint32_t rgb = _led_action_desc[fx->action].render(fx, led->pos[_led_nr], (uint32_t)(now - fx->start_ms));
+        if (rgb != led->col[_led_nr])
         {
-            //We only really need to deal with the blink and rainbow states (timer based)
-            case led_state_blink:
-                if (sys_poll_tmr_expired(&rgb_led->timer))
-                {
-                    uint32_t _temp_col = rgb_led->col_1;
-                    //Set the current colour                    
-                    drv_rgb_led_strip_set_colour(_led_nr, rgb_led->col_1);
-                    //Swop the primary and secondary colours for the next iteration
-                    rgb_led->col_1 = rgb_led->col_2;
-                    rgb_led->col_2 = _temp_col;
-                    //Timer should be running on auto-reload, so no need to reset it
-                }
-                hue = 0;
-                break;
-            case led_state_rainbow:
-                //This is assumed to run at the task interval period of 20ms (not using a timer)
-                uint32_t _total = (rgb_led->col_2 & 0x0000FFFF);
-                uint32_t _count = (rgb_led->col_2 >> 16) & 0x0000FFFF;
-                hue = (HUE_MAX *_count/_total)%HUE_MAX;
-                rgb_led->col_1 = hue2rgb(hue);
-                drv_rgb_led_strip_set_colour(_led_nr, rgb_led->col_1);
-                //iprintln(trLED, "#Rainbow: %d/%d - H: %d -> 0x%06x)", _count, _total, hue, rgb_led->col_1);
-                _count++;
-                if (_count >= _total)
-                {
-                    // uint32_t _lap = sys_stopwatch_ms_reset(&_rgb_led.sw);
-                    // iprintln(trLED, "#Rainbow (re)starting after %dms", _lap);
-                    _count = 0;
-                }
-                rgb_led->col_2 = ((((uint32_t)_count) << 16) & 0xFFFF0000) | ((uint32_t)_total & 0x0000FFFF);
-                break;
-            // case led_state_off:
-            // case led_state_on:
-            default:
-                //Do nothing
-                hue = 0;
-                break;
+            led->col[_led_nr] = rgb;
+            drv_rgb_led_strip_set_colour(_led_nr, rgb);
         }
     }
 }
 
 void _led_info_print(int _index)
 {
-    rgb_led_t * rgb_led = &_rgb_led.array[_index];
-    switch (rgb_led->state)
+    rgb_led_arrays_t * led = &_rgb_led.led;
+
+    if (led->fx[_index] == LED_FX_NONE)
     {
-        case led_state_off:
+        if (led->col[_index] == colBlack)
             iprintln(trALWAYS, "%s LED - OFF", drv_rgb_led_strip_index2name(_index));
+        else
+            iprintln(trALWAYS, "%s LED - ON (%06X)", drv_rgb_led_strip_index2name(_index), led->col[_index]);
+        return;
+    }
+
+    rgb_led_fx_t * fx = &_rgb_led.fx[led->fx[_index]];
+    switch (fx->action)
+    {
+        case led_action_blink:
+            iprintln(trALWAYS, "%s LED - Blinking (%06X <-> %06X), %.2f Hz", drv_rgb_led_strip_index2name(_index), fx->col_1, fx->col_2, (1000.0f/fx->period_ms));
             break;
-        case led_state_on:
-            iprintln(trALWAYS, "%s LED - ON (%06X)", drv_rgb_led_strip_index2name(_index), rgb_led->col_1, rgb_led->state);
-            break;
-        case led_state_blink:
-            //Remember, the timer period is half the blink period (on/off)
-            iprintln(trALWAYS, "%s LED - Blinking (%06X <-> %06X), %.2f Hz", drv_rgb_led_strip_index2name(_index), rgb_led->col_1, rgb_led->col_2, (500.0f/rgb_led->timer.ms_period));
-            break;
-        case led_state_rainbow:
-            //Remember, the bottom 16 bits of col_2 is the total count... x LED_UPDATE_INTERVAL_MS gives the period
-            iprintln(trALWAYS, "%s LED - Rainbow, %dms", drv_rgb_led_strip_index2name(_index), (rgb_led->col_2 & 0xFFFF) * LED_UPDATE_INTERVAL_MS);
+        case led_action_rainbow:
+            iprintln(trALWAYS, "%s LED - Rainbow, %dms", drv_rgb_led_strip_index2name(_index), fx->period_ms);
             break;
         default:
-            iprintln(trALWAYS, "%s LED - UNKNOWN State (%d)", drv_rgb_led_strip_index2name(_index), rgb_led->state);
-        break;
+            iprintln(trALWAYS, "%s LED - %s (%06X on %06X), %dms, LED %d/%d", drv_rgb_led_strip_index2name(_index), _led_action_desc[fx->action].name, 
+                fx->col_1, fx->col_2, fx->period_ms, led->pos[_index]+1, fx->count);
+            break;
+    }
+}
+
+bool _led_msg_add_range(rgb_led_action_msg_t * msg, int first, int count)
+{
+    if (count <= 0)
+        return true;    //Nothing to add
+
+    //Do we simply extend the last range?
+    if (msg->range_cnt > 0)
+    {
+        rgb_led_range_t * last = &msg->range[msg->range_cnt-1];
+        if ((first >= last->first) && (first <= (last->first + last->count)))
+        {
+            last->count = max(last->count, (first + count) - last->first);
+            return true;
+        }
+    }
+
+    if (msg->range_cnt >= RGB_LED_RANGES_MAX)
+        return false;
+
+    msg->range[msg->range_cnt].first = first;
+    msg->range[msg->range_cnt].count = count;
+    msg->range_cnt++;
+    return true;
+}
+
+void _led_msg_add_mask(rgb_led_action_msg_t * msg, uint16_t address_mask)
+{
+    //Turn every run of set bits into a range (at most 8 runs in 16 bits)
+    for (int i = 0; (i < led_bit_max) && (i < _rgb_led.cnt); i++)
+    {
+        if ((address_mask & BIT(i)) == 0)
+            continue;
+        int first = i;
+        while ((i < led_bit_max) && (i < _rgb_led.cnt) && (address_mask & BIT(i)))
+            i++;
+        _led_msg_add_range(msg, first, i - first);
     }
+}
+
+esp_err_t _led_msg_queue(rgb_led_action_msg_t * msg, const char * caller)
+{
+    if (!_rgb_led.task.init_done)
+        return ESP_ERR_INVALID_STATE;
 
+    if (msg->range_cnt == 0)
+        return ESP_OK;  //Technically not an error... but nothing to do
+
+    if (xQueueSend(_rgb_led.msg_queue, msg, 0) == pdTRUE)
+        return ESP_OK;
+
+    iprintln(trLED, "#Failed to queue message (%s)", caller);
+    return ESP_FAIL;
 }
 
-esp_err_t _handler_parse_address_str(uint32_t * addr_mask, const char * str)
+rgb_led_segment_t * _led_segment_find(const char * name)
+{
+    for (int i = 0; i < LED_SEGMENTS_MAX; i++)
+    {
+        if ((_rgb_led.segment[i].name[0] != 0) && (strcasecmp(_rgb_led.segment[i].name, name) == 0))
+            return &_rgb_led.segment[i];
+    }
+    return NULL;
+}
+
+esp_err_t _handler_parse_address_str(rgb_led_action_msg_t * led_msg, const char * str)
 {
     uint32_t value;
+    int32_t first, last;
     int index;
     int count;
-
-    //Righto, the address can be in one of three valid formats:
-    // 1. A single number (0 to 15)
-    // 2. A hexadecimal number (0xHHHH), e.g. "0x003", "0x0F0", etc
-    // 3. A string containing "Debug|Dbg|Button|Btn" optionally followed with a colon (:) and a number, e.g. "debug", "btn:1", etc
+    char * dash;
+    rgb_led_segment_t * segment;
+
+    //Righto, the address can be in one of the following valid formats:
+    // 1. A single number (0 to cnt-1)
+    // 2. A range of numbers (<first>-<last>), e.g. "1-5", "0-299", etc
+    // 3. A hexadecimal number (0xHHHH), e.g. "0x003", "0x0F0", etc (only the first 16 LEDs)
+    // 4. A string containing "Debug|Dbg|Button|Btn" optionally followed with a colon (:) and a number, e.g. "debug", "btn:1", etc
+    // 5. The name of a segment, or "all"
     
-    if (str2int32((int32_t*)&value, str, 0))
+    if (str2int32(&first, str, 0))
     {
         //This would be a single led index
-        if (value >= led_bit_max)
+        if ((first < 0) || (first >= _rgb_led.cnt))
         {
-            iprintln(trALWAYS, "Invalid LED Address (\"%s\" -> %d)", str, value);
+            iprintln(trALWAYS, "Invalid LED Address (\"%s\" -> %d)", str, first);
             return ESP_ERR_INVALID_ARG;
         }
-        *addr_mask = BIT(value);
-        return ESP_OK;
+        index = first;
+        count = 1;
     }
-    
-    if (hex2u32(&value, str, 4))
+    else if (((dash = strchr(str, '-')) != NULL) && (dash != str))
+    {
+        char first_str[12];
+        snprintf(first_str, min(sizeof(first_str), (size_t)(dash - str + 1)), "%s", str);
+        if ((!str2int32(&first, first_str, 0)) || (!str2int32(&last, dash+1, 0)))
+            return ESP_ERR_NOT_FOUND;
+
+        if ((first < 0) || (last < first) || (last >= _rgb_led.cnt))
+        {
+            iprintln(trALWAYS, "Invalid LED Range (\"%s\" -> %d to %d)", str, first, last);
+            return ESP_ERR_INVALID_ARG;
+        }
+        index = first;
+        count = last - first + 1;
+    }
+    else if (hex2u32(&value, str, 4))
     {
         //This could be several led indices (the whole mask)
-        *addr_mask = value;
-        return ESP_OK;
+        uint16_t range_cnt = led_msg->range_cnt;
+        _led_msg_add_mask(led_msg, (uint16_t)value);
+        if (led_msg->range_cnt > range_cnt)
+            return ESP_OK;
+        iprintln(trALWAYS, "Invalid LED Address (\"%s\")", str);
+        return ESP_ERR_INVALID_ARG;
+    }
+    else if (strcasecmp(str, "all") == 0)
+    {
+        index = 0;
+        count = _rgb_led.cnt;
+    }
+    else if ((segment = _led_segment_find(str)) != NULL)
+    {
+        index = segment->range.first;
+        count = segment->range.count;
     }
-
     //The strip name parsing is handled by the driver
-    if (drv_rgb_led_strip_name2index(str, &index, &count))
-    {        
-        //This could be a single led index or a whole mask
-        for (int i = index; i < (index + count); i++)
-            *addr_mask |= BIT(i);
-        return ESP_OK;
+    else if (!drv_rgb_led_strip_name2index(str, &index, &count))
+    {
+        //Reaching this point means this is NOT an LED address
+        return ESP_ERR_NOT_FOUND;
     }
 
-    //Reaching this point means this is NOT an LED address
-    return ESP_ERR_NOT_FOUND;
+    if (_led_msg_add_range(led_msg, index, count))
+        return ESP_OK;
+
+    iprintln(trALWAYS, "Too many LED addresses (max %d ranges)", RGB_LED_RANGES_MAX);
+    return ESP_ERR_INVALID_ARG;
+}
+
+void _led_print_addr_usage(const char * action)
+{
+    iprintln(trALWAYS, "    <led_addr>: <#>      - a single index (0 to %d), e.g. 0, 1, 2, 3, etc", _rgb_led.cnt-1);
+    iprintln(trALWAYS, "                <#>-<#>  - a range of indices, e.g. \"1-5\"");
+    iprintln(trALWAYS, "                0xHHHH   - a 16 bit mask of the LEDs to affect, e.g. \"0x003\"");
+    iprintln(trALWAYS, "                \"<strip>[:<nr>]\" - a string and number (seperated by a colon)");
+    iprintln(trALWAYS, "                            indicating the LED strip and LED # to use");
+    iprintln(trALWAYS, "                            e.g. \"debug\", \"button:1\", \"button:2\", etc");
+    iprintln(trALWAYS, "                  If <nr> is omitted, %s applies to the entire strip", action);
+    iprintln(trALWAYS, "                \"<segment>\" - the name of a segment (see \"segment\"), or \"all\"");
+    iprintln(trALWAYS, "        If <led_addr> is omitted, \"debug\" is assumed");
+    iprintln(trALWAYS, " Multiple <led_addr> values can be specified, separated by spaces (max %d ranges)", RGB_LED_RANGES_MAX);
 }
 
 void _led_handler_common_action(void/*rgb_led_action_cmd action*/)
@@ -578,21 +874,23 @@ void _led_handler_common_action(void/*rgb_led_action_cmd action*/)
     // not manupiluate the RGB task variables directly, but instead send messages to the RGB 
     // task via the msg_queue
     bool help_requested = false;
-    rgb_led_action_msg_t led_msg = {.led_addr = 0, .val_0 = -1, .val_1 = 0, .val_2 = -1};//Indicating "not set yet"
+    rgb_led_action_msg_t led_msg = {.range_cnt = 0, .val_0 = -1, .val_1 = 0, .val_2 = -1};//Indicating "not set yet"
     esp_err_t err = ESP_OK;
     uint32_t parse_value = 0;//addr_mask = 0;
     rgb_led_action_cmd action = led_action_nop;
+    const rgb_led_action_desc_t * desc = NULL;
     char *arg = console_arg_peek(-1);
 
-    if (strcasecmp(arg, "off") == 0)
-        action = led_action_off;
-    else if (strcasecmp(arg, "on") == 0)
-        action = led_action_colour;
-    else if (strcasecmp(arg, "blink") == 0)
-        action = led_action_blink;
-    else if (strcasecmp(arg, "rainbow") == 0)
-        action = led_action_rainbow;
-    else
+    for (int i = led_action_off; i < led_action_total; i++)
+    {
+        if ((i != led_action_status) && (strcasecmp(arg, _led_action_desc[i].name) == 0))
+        {
+            action = i;
+            desc = &_led_action_desc[i];
+            break;
+        }
+    }
+    if (desc == NULL)
         return; //Nothing to do... (how did we get here?)
 
     while (console_arg_cnt() > 0)
@@ -605,14 +903,13 @@ void _led_handler_common_action(void/*rgb_led_action_cmd action*/)
         }
         parse_value = 0;
 
-        //Check for period first - BLINK and RAINBOW
-        if ((action == led_action_blink) || (action == led_action_rainbow))
+        //Check for period first - all the effects
+        if (desc->render != NULL)
         {
             if (str2uint32(&parse_value, arg, 0))
             {
                 //This could be the period OR an address
-                if (((parse_value >= LED_BLINK_PERIOD_MS_MIN*2) && (action == led_action_blink)) ||
-                    ((parse_value >= LED_RAINBOW_PER_MIN_MS) && (action == led_action_rainbow)))
+                if (parse_value >= desc->period_min_ms)
                 {
                     //Ooooh... this could be a period
                     if (led_msg.val_1 != 0)
@@ -624,20 +921,20 @@ void _led_handler_common_action(void/*rgb_led_action_cmd action*/)
             //else not a good period value... maybe it is a colour or a LED address
         }
 
-        //Then we check for colour(s) - ON and BLINK
-        if ((action == led_action_colour) || (action == led_action_blink))
+        //Then we check for colour(s) - ON and the effects which take colours
+        if (desc->colours > 0)
         {
             err = parse_str_to_colour(&parse_value, arg);
             if (err == ESP_OK)
             {
-                if (action == led_action_colour)
+                if (desc->colours == 1)
                 {
                     if (led_msg.val_0 != (uint32_t)-1)
                         iprintln(trALWAYS, "Overwriting previously set colour (%06X) with \"%s\" (%06X)", led_msg.val_0, arg, parse_value);
     
                     led_msg.val_0 = parse_value;
                 }
-                else if (action == led_action_blink)
+                else
                 {
                     if (led_msg.val_0 == (uint32_t)-1)
                     {
@@ -661,12 +958,9 @@ void _led_handler_common_action(void/*rgb_led_action_cmd action*/)
         }
 
         //Then we check for LED addressing - ALL
-        err = _handler_parse_address_str(&parse_value, arg);
+        err = _handler_parse_address_str(&led_msg, arg);
         if (err == ESP_OK)
-        {
-            led_msg.led_addr |= parse_value;
             continue;
-        }
         else if (err == ESP_ERR_INVALID_ARG)
         {
             //Looked like an address, but it was invalid
@@ -681,7 +975,7 @@ void _led_handler_common_action(void/*rgb_led_action_cmd action*/)
 
     if (!help_requested)
     {
-        if (action == led_action_colour)
+        if ((desc->colours == 1) || ((desc->colours == 2) && (action != led_action_blink)))
         {
             if (led_msg.val_0 == (uint32_t)-1)
             {
@@ -689,6 +983,9 @@ void _led_handler_common_action(void/*rgb_led_action_cmd action*/)
                 led_msg.val_0 = hue2rgb((uint32_t)(esp_random()%360L));
                 iprintln(trALWAYS, "No Colour specified, using %06X", led_msg.val_0);
             }
+            //The effects fade to, or run on, a black background by default
+            if ((desc->colours == 2) && (led_msg.val_2 == (uint32_t)-1))
+                led_msg.val_2 = colBlack;
         }
         else if (action == led_action_blink)
         {
@@ -711,18 +1008,18 @@ void _led_handler_common_action(void/*rgb_led_action_cmd action*/)
             }
         }        
 
-        if ((action == led_action_blink) || (action == led_action_rainbow))
+        if (desc->render != NULL)
         {
             if (led_msg.val_1 == 0)
             {
-                // No period? We'll assign one using a very silly RNG based on the time since boot in us (mod 360)
-                led_msg.val_1 = (action == led_action_rainbow) ? LED_RAINBOW_PERIOD_MS_DEF : LED_BLINK_PERIOD_MS_DEF;
+                // No period? We'll use the default for the effect
+                led_msg.val_1 = desc->period_def_ms;
                 iprintln(trALWAYS, "Using default period of %dms", led_msg.val_1);
             }
         }
 
-        if (led_msg.led_addr == 0)
-            led_msg.led_addr = BIT(0);             // No LED Address(es) specified... let's apply debug
+        if (led_msg.range_cnt == 0)
+            _led_msg_add_range(&led_msg, led_bit_dbg, 1);   // No LED Address(es) specified... let's apply debug
 
         led_msg.cmd = action;
         xQueueSend(_rgb_led.msg_queue, &led_msg, 0);
@@ -736,22 +1033,22 @@ void _led_handler_common_action(void/*rgb_led_action_cmd action*/)
     {
         //Opening line
         iprint(trALWAYS, "Usage: \"%s ", arg);        
-        if (action == led_action_colour)    iprint(trALWAYS, "[<colour>] ");
-        if ((action == led_action_rainbow) || (action == led_action_blink))   iprint(trALWAYS, "[<period>] ");
-        if (action == led_action_blink)     iprint(trALWAYS, "[<colour_1>] [<colour_2>]");        
+        if (desc->colours == 1)             iprint(trALWAYS, "[<colour>] ");
+        if (desc->render != NULL)           iprint(trALWAYS, "[<period>] ");
+        if (desc->colours == 2)             iprint(trALWAYS, "[<colour_1>] [<colour_2>]");        
         iprintln(trALWAYS, " [<led_addr>]\"");
 
 
         // Describe "period"
-        if ((action == led_action_blink) || (action == led_action_rainbow))
+        if (desc->render != NULL)
         {
             iprintln(trALWAYS, "    <period>:   A value indicating the period of the %s cycle in ms", arg);
-            iprintln(trALWAYS, "                            (min: %dms)", (action == led_action_blink)? LED_BLINK_PERIOD_MS_DEF*2 : LED_RAINBOW_PER_MIN_MS);
-            iprintln(trALWAYS, "        If <period> is omitted, a default period of %dms is used", (action == led_action_blink)? LED_BLINK_PERIOD_MS_DEF*2 : LED_RAINBOW_PER_MIN_MS);
+            iprintln(trALWAYS, "                            (min: %dms)", desc->period_min_ms);
+            iprintln(trALWAYS, "        If <period> is omitted, a default period of %dms is used", desc->period_def_ms);
         }
 
         // Describe "colour"
-        if ((action == led_action_colour) || (action == led_action_blink))
+        if (desc->colours > 0)
         {
             iprintln(trALWAYS, "    <colour>:   String   - Any one of the assigned colour names");
             iprintln(trALWAYS, "                            e.g. \"Black\", \"wh\", etc");
@@ -761,19 +1058,14 @@ void _led_handler_common_action(void/*rgb_led_action_cmd action*/)
             iprintln(trALWAYS, "                  If <s> or <v> is omitted, it will be set to 100%%");
             if (action == led_action_blink)
                 iprintln(trALWAYS, "        If one or both <colour> are omitted, they will be selected at random");
+            else if (desc->colours == 2)
+                iprintln(trALWAYS, "        If <colour_1> is omitted, one will be selected at random, <colour_2> defaults to black");
             else
                 iprintln(trALWAYS, "        If <colour> is omitted, one will be selected at random");
         }
 
         // Describe "led_addr"
-        iprintln(trALWAYS, "    <led_addr>: <#>      - a single index (0 to %d), e.g. 0, 1, 2, 3, etc", _rgb_led.cnt-1);
-        iprintln(trALWAYS, "                0xHHHH   - a 16 bit mask of the LEDs to affect, e.g. \"0x003\"");
-        iprintln(trALWAYS, "                \"<strip>[:<nr>]\" - a string and number (seperated by a colon)");
-        iprintln(trALWAYS, "                            indicating the LED strip and LED # to use");
-        iprintln(trALWAYS, "                            e.g. \"debug\", \"button:1\", \"button:2\", etc");
-        iprintln(trALWAYS, "                  If <nr> is omitted, %s applies to the entire strip", arg);
-        iprintln(trALWAYS, "        If <led_addr> is omitted, \"debug\" is assumed");
-        iprintln(trALWAYS, " Multiple <led_addr> values can be specified, separated by spaces");
+        _led_print_addr_usage(arg);
     }
 }
 
@@ -783,10 +1075,8 @@ void _led_handler_status(void)
     // not manupiluate the RGB task variables directly, but instead send messages to the RGB 
     // task via the msg_queue
     bool help_requested = false;
-    rgb_led_action_msg_t led_msg = {.led_addr = 0};//Indicating "not set yet"
+    rgb_led_action_msg_t led_msg = {.range_cnt = 0};//Indicating "not set yet"
     esp_err_t err = ESP_OK;
-    uint32_t parse_value = 0;
-//    uint32_t addr_mask = 0;
 
     while (console_arg_cnt() > 0)
 	{
@@ -796,13 +1086,9 @@ void _led_handler_status(void)
             help_requested = true;
             break; //from while-loop
         }
-        parse_value = 0;
-        err = _handler_parse_address_str(&parse_value, arg);
+        err = _handler_parse_address_str(&led_msg, arg);
         if (err == ESP_OK)
-        {
-            led_msg.led_addr |= parse_value;
             continue;
-        }
         if (err == ESP_ERR_NOT_FOUND)   //ESP_ERR_INVALID_ARG has already been handled ito user feedback
             iprintln(trALWAYS, "Invalid Argument (\"%s\")", arg);
         // help_requested = true;
@@ -811,8 +1097,8 @@ void _led_handler_status(void)
 
     if ((!help_requested))
     {
-        if (led_msg.led_addr == 0)
-            led_msg.led_addr = BIT(0);             // No LED Address(es) specified... let's apply debug
+        if (led_msg.range_cnt == 0)
+            _led_msg_add_range(&led_msg, led_bit_dbg, 1);   // No LED Address(es) specified... let's apply debug
 
         led_msg.cmd = led_action_status;
         // for (int i = 0; i < _rgb_led.cnt; i++)
@@ -824,14 +1110,7 @@ void _led_handler_status(void)
     {
         //                  01234567890123456789012345678901234567890123456789012345678901234567890123456789
         iprintln(trALWAYS, "Usage: \"ledstat [<led_addr>]\"");        
-        iprintln(trALWAYS, "    <led_addr>: <#>      - a single index (0 to %d), e.g. 0, 1, 2, 3, etc", _rgb_led.cnt-1);
-        iprintln(trALWAYS, "                0xHHHH   - a 16 bit mask of the LEDs to affect, e.g. \"0x003\"");
-        iprintln(trALWAYS, "                \"<strip>[:<nr>]\" - a string and number (seperated by a colon)");
-        iprintln(trALWAYS, "                            indicating the LED strip and LED # to use");
-        iprintln(trALWAYS, "                            e.g. \"debug\", \"button:1\", \"button:2\", etc");
-        iprintln(trALWAYS, "                  If <nr> is omitted, %s applies to the entire strip", "STATUS");
-        iprintln(trALWAYS, "        If <led_addr> is omitted, \"debug\" is assumed");
-        iprintln(trALWAYS, " Multiple <led_addr> values can be specified, separated by spaces");
+        _led_print_addr_usage("STATUS");
         //        iprintln(trALWAYS, "   e.g. \"off 0 1 2 3\", \"off debug:0 button:1...\" etc");
     }
 }
@@ -978,9 +1257,8 @@ void _led_handler_reset(void)
     // not manupiluate the RGB task variables directly, but instead send messages to the RGB 
     // task via the msg_queue
     bool help_requested = false;
-    rgb_led_action_msg_t led_msg = {.led_addr = 0, .val_1 = 0};//Indicating "not set yet"
+    rgb_led_action_msg_t led_msg = {.range_cnt = 0, .val_1 = 0};//Indicating "not set yet"
     esp_err_t err = ESP_OK;
-    uint32_t parse_value = 0;//addr_mask = 0;
 
     while (console_arg_cnt() > 0)
 	{
@@ -990,14 +1268,10 @@ void _led_handler_reset(void)
             help_requested = true;
             break; //from while-loop
         }
-        parse_value = 0;
         //Check for LED addressing
-        err = _handler_parse_address_str(&parse_value, arg);
+        err = _handler_parse_address_str(&led_msg, arg);
         if (err == ESP_OK)
-        {
-            led_msg.led_addr |= parse_value;
             continue;
-        }
         else if (err == ESP_ERR_INVALID_ARG)
         {
             //Looked like an address, but it was invalid
@@ -1012,8 +1286,8 @@ void _led_handler_reset(void)
 
     if (!help_requested)
     {
-        if (led_msg.led_addr == 0)
-            led_msg.led_addr = BIT(0);             // No LED Address(es) specified... let's apply debug
+        if (led_msg.range_cnt == 0)
+            _led_msg_add_range(&led_msg, led_bit_dbg, 1);   // No LED Address(es) specified... let's apply debug
 
         led_msg.val_1 = LED_RAINBOW_PERIOD_MS_DEF;
         led_msg.cmd = led_action_rainbow;
@@ -1029,17 +1303,147 @@ void _led_handler_reset(void)
     {
         //                  01234567890123456789012345678901234567890123456789012345678901234567890123456789
         iprintln(trALWAYS, "Usage: \"reset [<led_addr>]\"");        
-        iprintln(trALWAYS, "    <led_addr>: <#>      - a single index (0 to %d), e.g. 0, 1, 2, 3, etc", _rgb_led.cnt-1);
-        iprintln(trALWAYS, "                0xHHHH   - a 16 bit mask of the LEDs to affect, e.g. \"0x003\"");
-        iprintln(trALWAYS, "                \"<strip>[:<nr>]\" - a string and number (seperated by a colon)");
-        iprintln(trALWAYS, "                            indicating the LED strip and LED # to use");
-        iprintln(trALWAYS, "                            e.g. \"debug\", \"button:1\", \"button:2\", etc");
-        iprintln(trALWAYS, "                  If <nr> is omitted, %s applies to the entire strip", "RESET");
-        iprintln(trALWAYS, "        If <led_addr> is omitted, \"debug\" is assumed");
-        iprintln(trALWAYS, " Multiple <led_addr> values can be specified, separated by spaces");
+        _led_print_addr_usage("RESET");
 //        iprintln(trALWAYS, "   e.g. \"off 0 1 2 3\", \"off debug:0 button:1...\" etc");
     }
 }
+void _led_handler_segment(void)
+{
+    //Segments are only read by this (console) task and rgb_led_segment_add(), so we don't go through the msg_queue
+    bool help_requested = false;
+    char *name = NULL;
+    rgb_led_action_msg_t range_msg = {.range_cnt = 0};
+
+    if (console_arg_cnt() == 0)
+    {
+        //No arguments... list the segments
+        iprintln(trALWAYS, "LED Segments (%d LEDs in total):", _rgb_led.cnt);
+        for (int i = 0; i < LED_SEGMENTS_MAX; i++)
+        {
+            if (_rgb_led.segment[i].name[0] == 0)
+                continue;
+            iprintln(trALWAYS, " % 12s -> %d to %d (%d LEDs)", _rgb_led.segment[i].name, _rgb_led.segment[i].range.first, 
+                _rgb_led.segment[i].range.first + _rgb_led.segment[i].range.count - 1, _rgb_led.segment[i].range.count);
+        }
+        return;
+    }
+
+    name = console_arg_pop();
+    if ((!strcasecmp("?", name)) || (!strcasecmp("help", name)))
+        help_requested = true;
+    else if (console_arg_cnt() == 0)
+    {
+        //Only a name... remove the segment
+        rgb_led_segment_t * segment = _led_segment_find(name);
+        if (segment == NULL)
+            iprintln(trALWAYS, "Segment \"%s\" not found", name);
+        else
+        {
+            iprintln(trALWAYS, "Segment \"%s\" removed", name);
+            memset(segment, 0, sizeof(rgb_led_segment_t));
+        }
+        return;
+    }
+    else
+    {
+        char *arg = console_arg_pop();
+        //A segment is a single (contiguous) range
+        if ((_handler_parse_address_str(&range_msg, arg) != ESP_OK) || (range_msg.range_cnt != 1) || (console_arg_cnt() > 0))
+        {
+            iprintln(trALWAYS, "Invalid Argument (\"%s\")", arg);
+            help_requested = true;
+        }
+        else if (rgb_led_segment_add(name, range_msg.range[0].first, range_msg.range[0].count) != ESP_OK)
+            help_requested = true;
+    }
+
+    if (help_requested)
+    {
+        //                  01234567890123456789012345678901234567890123456789012345678901234567890123456789
+        iprintln(trALWAYS, "Usage: \"segment [<name> [<range>]]\"");        
+        iprintln(trALWAYS, "    <name>:     The name of the segment (max %d chars)", LED_SEGMENT_NAME_LEN-1);
+        iprintln(trALWAYS, "    <range>:    <#>-<#>  - the range of LEDs in the segment, e.g. \"1-60\"");
+        iprintln(trALWAYS, "                \"<strip>\" - the name of a LED strip");
+        iprintln(trALWAYS, "        If <range> is omitted, the segment is removed");
+        iprintln(trALWAYS, "        If <name> is omitted, all the segments are listed");
+    }
+}
+
+void _led_handler_calib(void)
+{
+    bool help_requested = false;
+    int led_index = 0;
+    int led_cnt = 0;
+    bool gamma;
+    colour_cal_t cal;
+    uint32_t value;
+
+    if (console_arg_cnt() == 0)
+    {
+        //No arguments... list the correction of every strip
+        iprintln(trALWAYS, "LED strip colour correction:");
+        while ((led_index < _rgb_led.cnt) && (drv_rgb_led_strip_get_calibration(led_index, &gamma, &cal) == ESP_OK))
+        {
+            char name[LED_SEGMENT_NAME_LEN];
+            snprintf(name, sizeof(name), "%s", drv_rgb_led_strip_index2name(led_index));
+            //Only the strip name, not the LED number
+            if (strchr(name, ':') != NULL)
+                *strchr(name, ':') = 0;
+            iprintln(trALWAYS, " % 12s -> %s, R:%3d G:%3d B:%3d Max:%3d", name, gamma? "CIE" : "linear", cal.red, cal.green, cal.blue, cal.max_lvl);
+            if (!drv_rgb_led_strip_name2index(name, &led_index, &led_cnt))
+                break;
+            led_index += led_cnt;
+        }
+        return;
+    }
+
+    char *arg = console_arg_pop();
+    if ((!strcasecmp("?", arg)) || (!strcasecmp("help", arg)))
+        help_requested = true;
+    else if (!drv_rgb_led_strip_name2index(arg, &led_index, &led_cnt))
+        help_requested = true;
+    else
+    {
+        //Start from the current correction of the strip, and change only what is given
+        drv_rgb_led_strip_get_calibration(led_index, &gamma, &cal);
+        while ((console_arg_cnt() > 0) && (!help_requested))
+        {
+            arg = console_arg_pop();
+            if (!strcasecmp("gamma", arg))
+                gamma = true;
+            else if (!strcasecmp("linear", arg))
+                gamma = false;
+            else if (!strcasecmp("default", arg))
+                cal = (colour_cal_t)COLOUR_CAL_DEFAULT;
+            else if (str2uint32(&value, arg, 0))
+            {
+                cal.red = (uint8_t)(value >> 24);
+                cal.green = (uint8_t)(value >> 16);
+                cal.blue = (uint8_t)(value >> 8);
+                cal.max_lvl = (uint8_t)(value);
+            }
+            else
+            {
+                iprintln(trALWAYS, "Invalid Argument (\"%s\")", arg);
+                help_requested = true;
+            }
+        }
+        if (!help_requested)
+            drv_rgb_led_strip_set_calibration(led_index, gamma, &cal);
+    }
+
+    if (help_requested)
+    {
+        //                  01234567890123456789012345678901234567890123456789012345678901234567890123456789
+        iprintln(trALWAYS, "Usage: \"calib [<strip> [gamma|linear] [<0xRRGGBBMM>|default]]\"");
+        iprintln(trALWAYS, "    <strip>:    The name of the LED strip");
+        iprintln(trALWAYS, "    gamma|linear: with or without the CIE lightness correction");
+        iprintln(trALWAYS, "    <0xRRGGBBMM>: Red, Green and Blue scale (0xFF = 100%%) and Max brightness");
+        iprintln(trALWAYS, "    default:    No white balance or brightness limit");
+        iprintln(trALWAYS, "        If <strip> is omitted, the correction of all the strips is listed");
+    }
+}
+
 /*******************************************************************************
 Global (public) Functions
 *******************************************************************************/
@@ -1068,45 +1472,66 @@ void * rgb_led_init_task(void)
 
 esp_err_t rgb_led_off(uint16_t address_mask)
 {
-    //This function can be called from ANY task
-    rgb_led_action_msg_t led_msg = {
-        .led_addr = 0, 
-        .cmd = led_action_nop, 
-        .val_0 = -1, 
-    };//Indicating "not set yet"
+    rgb_led_range_t range[RGB_LED_RANGES_MAX];
+    return rgb_led_off_range(range, rgb_led_mask2range(range, address_mask));
+}
 
-    if (!_rgb_led.task.init_done)
-        return ESP_ERR_INVALID_STATE;
+esp_err_t rgb_led_on(uint16_t address_mask, uint32_t rgb_colour)
+{
+    rgb_led_range_t range[RGB_LED_RANGES_MAX];
+    return rgb_led_on_range(range, rgb_led_mask2range(range, address_mask), rgb_colour);
+}
 
-    if (address_mask == 0)
-        return ESP_OK;  //Technically not an error... but nothing to do
+esp_err_t rgb_led_blink(uint16_t address_mask, uint32_t period, uint32_t rgb_colour_1, uint32_t rgb_colour_2)
+{
+    rgb_led_range_t range[RGB_LED_RANGES_MAX];
+    return rgb_led_blink_range(range, rgb_led_mask2range(range, address_mask), period, rgb_colour_1, rgb_colour_2);
+}
 
-    for (int i = 0; i < _rgb_led.cnt; i++)
-        led_msg.led_addr |= (BIT(i) & address_mask);
+esp_err_t rgb_led_demo(uint16_t address_mask, uint32_t period)
+{
+    rgb_led_range_t range[RGB_LED_RANGES_MAX];
+    return rgb_led_demo_range(range, rgb_led_mask2range(range, address_mask), period);
+}
 
-    led_msg.val_0 = colBlack;
-    led_msg.cmd = led_action_off;
-    if (xQueueSend(_rgb_led.msg_queue, &led_msg, 0) == pdTRUE)
-        return ESP_OK;
+int rgb_led_mask2range(rgb_led_range_t * range, uint16_t address_mask)
+{
+    rgb_led_action_msg_t led_msg = {.range_cnt = 0};
 
-    iprintln(trLED, "#Failed to queue message (%s)", __FUNCTION__);
-    return ESP_FAIL;
+    _led_msg_add_mask(&led_msg, address_mask);
+    memcpy(range, led_msg.range, led_msg.range_cnt * sizeof(rgb_led_range_t));
+    return led_msg.range_cnt;
 }
 
-esp_err_t rgb_led_on(uint16_t address_mask, uint32_t rgb_colour)
+esp_err_t rgb_led_off_range(const rgb_led_range_t * range, int range_cnt)
 {
     //This function can be called from ANY task
     rgb_led_action_msg_t led_msg = {
-        .led_addr = 0, 
+        .range_cnt = 0, 
+        .cmd = led_action_off, 
+        .val_0 = colBlack, 
+    };
+
+    if ((range_cnt < 0) || (range_cnt > RGB_LED_RANGES_MAX))
+        return ESP_ERR_INVALID_ARG;
+
+    for (int i = 0; i < range_cnt; i++)
+        _led_msg_add_range(&led_msg, range[i].first, range[i].count);
+
+    return _led_msg_queue(&led_msg, __FUNCTION__);
+}
+
+esp_err_t rgb_led_on_range(const rgb_led_range_t * range, int range_cnt, uint32_t rgb_colour)
+{
+    //This function can be called from ANY task
+    rgb_led_action_msg_t led_msg = {
+        .range_cnt = 0, 
         .cmd = led_action_nop, 
         .val_0 = -1, 
     };//Indicating "not set yet"
 
-    if (!_rgb_led.task.init_done)
-        return ESP_ERR_INVALID_STATE;
-
-    if (address_mask == 0)
-        return ESP_OK;  //Technically not an error... but nothing to do
+    if ((range_cnt < 0) || (range_cnt > RGB_LED_RANGES_MAX))
+        return ESP_ERR_INVALID_ARG;
 
     if (rgb_colour == (uint32_t)-1)
     {
@@ -1119,33 +1544,26 @@ esp_err_t rgb_led_on(uint16_t address_mask, uint32_t rgb_colour)
         return ESP_ERR_INVALID_ARG;
     }
 
-    for (int i = 0; i < _rgb_led.cnt; i++)
-        led_msg.led_addr |= (BIT(i) & address_mask);
+    for (int i = 0; i < range_cnt; i++)
+        _led_msg_add_range(&led_msg, range[i].first, range[i].count);
 
     led_msg.val_0 = rgb_colour;
     led_msg.cmd = (rgb_colour == colBlack)? led_action_off : led_action_colour;
-    if (xQueueSend(_rgb_led.msg_queue, &led_msg, 0) == pdTRUE)
-        return ESP_OK;
-
-    iprintln(trLED, "#Failed to queue message (%s)", __FUNCTION__);
-    return ESP_FAIL;
+    return _led_msg_queue(&led_msg, __FUNCTION__);
 }
 
-esp_err_t rgb_led_blink(uint16_t address_mask, uint32_t period, uint32_t rgb_colour_1, uint32_t rgb_colour_2)
+esp_err_t rgb_led_blink_range(const rgb_led_range_t * range, int range_cnt, uint32_t period, uint32_t rgb_colour_1, uint32_t rgb_colour_2)
 {
     rgb_led_action_msg_t led_msg = {
-        .led_addr = 0, 
+        .range_cnt = 0, 
         .cmd = led_action_nop, 
         .val_0 = -1, 
         .val_1 = 0, 
         .val_2 = -1
     };//Indicating "not set yet"
 
-    if (!_rgb_led.task.init_done)
-        return ESP_ERR_INVALID_STATE;
-
-    if (address_mask == 0)
-        return ESP_OK;  //Technically not an error... but nothing to do
+    if ((range_cnt < 0) || (range_cnt > RGB_LED_RANGES_MAX))
+        return ESP_ERR_INVALID_ARG;
 
     if (period < (LED_BLINK_PERIOD_MS_MIN*2))
     {
@@ -1181,33 +1599,26 @@ esp_err_t rgb_led_blink(uint16_t address_mask, uint32_t period, uint32_t rgb_col
         return ESP_ERR_INVALID_ARG;
     }
 
-    for (int i = 0; i < _rgb_led.cnt; i++)
-        led_msg.led_addr |= (BIT(i) & address_mask);
+    for (int i = 0; i < range_cnt; i++)
+        _led_msg_add_range(&led_msg, range[i].first, range[i].count);
 
     led_msg.val_0 = rgb_colour_1;
     led_msg.val_1 = period;
     led_msg.val_2 = rgb_colour_2;
     led_msg.cmd = led_action_blink;
-    if (xQueueSend(_rgb_led.msg_queue, &led_msg, 0) == pdTRUE)
-        return ESP_OK;
-
-    iprintln(trLED, "#Failed to queue message (%s)", __FUNCTION__);
-    return ESP_FAIL;
+    return _led_msg_queue(&led_msg, __FUNCTION__);
 }
 
-esp_err_t rgb_led_demo(uint16_t address_mask, uint32_t period)
+esp_err_t rgb_led_demo_range(const rgb_led_range_t * range, int range_cnt, uint32_t period)
 {
-    if (!_rgb_led.task.init_done)
-        return ESP_ERR_INVALID_STATE;
-
     rgb_led_action_msg_t led_msg = {
-        .led_addr = 0, 
+        .range_cnt = 0, 
         .cmd = led_action_nop, 
         .val_1 = 0, 
     };//Indicating "not set yet"
 
-    if (address_mask == 0)
-        return ESP_OK;  //Technically not an error... but nothing to do
+    if ((range_cnt < 0) || (range_cnt > RGB_LED_RANGES_MAX))
+        return ESP_ERR_INVALID_ARG;
 
     if (period < (LED_BLINK_PERIOD_MS_MIN*2))
     {
@@ -1215,16 +1626,104 @@ esp_err_t rgb_led_demo(uint16_t address_mask, uint32_t period)
         return ESP_ERR_INVALID_ARG;
     }
 
-    for (int i = 0; i < _rgb_led.cnt; i++)
-        led_msg.led_addr |= (BIT(i) & address_mask);
+    for (int i = 0; i < range_cnt; i++)
+        _led_msg_add_range(&led_msg, range[i].first, range[i].count);
 
     led_msg.val_1 = period;
     led_msg.cmd = led_action_rainbow;
-    if (xQueueSend(_rgb_led.msg_queue, &led_msg, 0) == pdTRUE)
-        return ESP_OK;
+    return _led_msg_queue(&led_msg, __FUNCTION__);
+}
 
-    iprintln(trLED, "#Failed to queue message (%s)", __FUNCTION__);
-    return ESP_FAIL;
+esp_err_t rgb_led_fx_range(const rgb_led_range_t * range, int range_cnt, rgb_led_fx_type_t fx_type, uint32_t period, uint32_t rgb_colour_1, uint32_t rgb_colour_2)
+{
+    static const rgb_led_action_cmd fx_action[] = {
+        [rgb_led_fx_breathe]    = led_action_breathe,
+        [rgb_led_fx_chase]      = led_action_chase,
+        [rgb_led_fx_comet]      = led_action_comet,
+        [rgb_led_fx_sparkle]    = led_action_sparkle,
+    };
+    rgb_led_action_msg_t led_msg = {
+        .range_cnt = 0, 
+        .cmd = led_action_nop, 
+    };
+
+    if ((range_cnt < 0) || (range_cnt > RGB_LED_RANGES_MAX) || (fx_type >= ARRAY_SIZE(fx_action)))
+        return ESP_ERR_INVALID_ARG;
+
+    const rgb_led_action_desc_t * desc = &_led_action_desc[fx_action[fx_type]];
+    if (period == 0)
+        period = desc->period_def_ms;
+    if (period < desc->period_min_ms)
+    {
+        iprintln(trLED, "#Min %s period = %dms (got %dms)", desc->name, desc->period_min_ms, period);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (rgb_colour_1 == (uint32_t)-1)
+        rgb_colour_1 = hue2rgb((uint32_t)(esp_random()%360L));
+    if (rgb_colour_2 == (uint32_t)-1)
+        rgb_colour_2 = colBlack;
+
+    if ((rgb_colour_1 > RGB_MAX) || (rgb_colour_2 > RGB_MAX))
+    {
+        iprintln(trLED, "#Invalid RGB value (0x%08X, 0x%08X)", rgb_colour_1, rgb_colour_2);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (int i = 0; i < range_cnt; i++)
+        _led_msg_add_range(&led_msg, range[i].first, range[i].count);
+
+    led_msg.val_0 = rgb_colour_1;
+    led_msg.val_1 = period;
+    led_msg.val_2 = rgb_colour_2;
+    led_msg.cmd = fx_action[fx_type];
+    return _led_msg_queue(&led_msg, __FUNCTION__);
+}
+
+esp_err_t rgb_led_segment_add(const char * name, uint16_t first, uint16_t count)
+{
+    rgb_led_segment_t * segment;
+
+    if ((name == NULL) || (name[0] == 0) || (strlen(name) >= LED_SEGMENT_NAME_LEN))
+    {
+        iprintln(trALWAYS, "Invalid segment name (max %d chars)", LED_SEGMENT_NAME_LEN-1);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if ((count == 0) || ((first + count) > _rgb_led.cnt))
+    {
+        iprintln(trALWAYS, "Invalid segment range (%d, %d LEDs)", first, count);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    //Replace an existing segment with the same name, otherwise use the first free one
+    segment = _led_segment_find(name);
+    for (int i = 0; (segment == NULL) && (i < LED_SEGMENTS_MAX); i++)
+    {
+        if (_rgb_led.segment[i].name[0] == 0)
+            segment = &_rgb_led.segment[i];
+    }
+    if (segment == NULL)
+    {
+        iprintln(trALWAYS, "No space for segment \"%s\" (max %d)", name, LED_SEGMENTS_MAX);
+        return ESP_ERR_NO_MEM;
+    }
+
+    snprintf(segment->name, LED_SEGMENT_NAME_LEN, "%s", name);
+    segment->range.first = first;
+    segment->range.count = count;
+    return ESP_OK;
+}
+
+bool rgb_led_segment_get(const char * name, rgb_led_range_t * range)
+{
+    rgb_led_segment_t * segment = _led_segment_find(name);
+
+    if (segment == NULL)
+        return false;
+
+    *range = segment->range;
+    return true;
 }
 
 #undef PRINTF_TAG
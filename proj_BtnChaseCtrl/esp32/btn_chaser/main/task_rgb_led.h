@@ -23,6 +23,23 @@ Macros
 #define EXT extern
 #endif /* __NOT_EXTERN__ */
 
+#define RGB_LED_RANGES_MAX          8       /* The max number of ranges per action (a 16 bit mask has at most 8 runs) */
+
+/******************************************************************************
+Struct & Unions
+******************************************************************************/
+typedef struct {
+    uint16_t first;         // The index of the first LED in the range
+    uint16_t count;         // The number of LEDs in the range
+} rgb_led_range_t;
+
+typedef enum {
+    rgb_led_fx_breathe,     // Fades between colour 2 and colour 1 and back
+    rgb_led_fx_chase,       // A single LED (colour 1) running along the LEDs (colour 2)
+    rgb_led_fx_comet,       // As chase, but with a tail fading into colour 2
+    rgb_led_fx_sparkle,     // Each LED flashes colour 1 at a random moment once per period
+} rgb_led_fx_type_t;
+
 /******************************************************************************
 variables
 ******************************************************************************/
@@ -70,6 +87,56 @@ esp_err_t rgb_led_blink(uint16_t address_mask, uint32_t  period, uint32_t rgb_co
  */
 esp_err_t rgb_led_demo(uint16_t address_mask, uint32_t  period);
 
+/*! Converts a 16 bit address mask to a list of ranges (one per run of set bits)
+ * @param[out] range The ranges (must have space for RGB_LED_RANGES_MAX entries)
+ * @param[in] address_mask The address mask
+ * @return The number of ranges
+ */
+int rgb_led_mask2range(rgb_led_range_t * range, uint16_t address_mask);
+
+/*! The _range versions of the functions above address the LEDs with a list of 
+ * (up to RGB_LED_RANGES_MAX) ranges iso a 16 bit mask, and are not limited to 
+ * the first 16 LEDs. All the LEDs in all of the ranges are handled by a single 
+ * action, so time-based effects stay in step.
+ * @param[in] range The list of ranges
+ * @param[in] range_cnt The number of ranges in the list
+ */
+esp_err_t rgb_led_off_range(const rgb_led_range_t * range, int range_cnt);
+esp_err_t rgb_led_on_range(const rgb_led_range_t * range, int range_cnt, uint32_t rgb_colour);
+esp_err_t rgb_led_blink_range(const rgb_led_range_t * range, int range_cnt, uint32_t period, uint32_t rgb_colour_1, uint32_t rgb_colour_2);
+esp_err_t rgb_led_demo_range(const rgb_led_range_t * range, int range_cnt, uint32_t period);
+
+/*! Starts an effect on a list of LED ranges. The effect runs on the LEDs as one 
+ * group, in the order of the ranges (e.g. a chase runs from the first LED in 
+ * the first range to the last LED in the last range).
+ * @param[in] range The list of ranges
+ * @param[in] range_cnt The number of ranges in the list
+ * @param[in] fx_type The effect
+ * @param[in] period The period of the effect in ms (0 for the default)
+ * @param[in] rgb_colour_1 The primary colour (-1 for a random colour)
+ * @param[in] rgb_colour_2 The background colour (-1 for black)
+ * @return ESP_OK if msg was queued successful, otherwise an error code
+ */
+esp_err_t rgb_led_fx_range(const rgb_led_range_t * range, int range_cnt, rgb_led_fx_type_t fx_type, uint32_t period, uint32_t rgb_colour_1, uint32_t rgb_colour_2);
+
+/*! Defines (or redefines) a named segment of consecutive LEDs, which can then 
+ * be addressed by name from the console, or with rgb_led_segment_get()
+ * NOTE: Segments are meant to be set up once (e.g. at startup), not while 
+ *  the console could be using them.
+ * @param[in] name The name of the segment
+ * @param[in] first The index of the first LED in the segment
+ * @param[in] count The number of LEDs in the segment
+ * @return ESP_OK if successful, otherwise an error code
+ */
+esp_err_t rgb_led_segment_add(const char * name, uint16_t first, uint16_t count);
+
+/*! Gets the range of a named segment
+ * @param[in] name The name of the segment
+ * @param[out] range The range of the segment
+ * @return true if the segment was found
+ */
+bool rgb_led_segment_get(const char * name, rgb_led_range_t * range);
+
 #undef EXT
 #endif /* __task_rgb_led_H__ */
 
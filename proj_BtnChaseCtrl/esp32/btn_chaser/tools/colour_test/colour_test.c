@@ -0,0 +1,192 @@
+/*******************************************************************************
+
+Module:     colour_test.c
+Purpose:    This file contains the host test for the common HSV <-> RGB maths
+Author:     Rudolph van Niekerk
+
+Checks the error bounds promised in common/common_colour.h:
+    HSV -> RGB      Every channel within 2 LSB of the equivalent float
+                    calculation, for all of the hue flavours:
+                        h360    every hue, saturation and value (exhaustive)
+                        h8      every hue, saturation and value (exhaustive)
+                        h16     every hue, on a grid of saturations and values
+                                (or all of them with -f, which takes a minute)
+    RGB -> HSV -> RGB
+                    Every channel back within 1 LSB of where it started, for
+                    every one of the 16.7M RGB values (exhaustive), through the
+                    16-bit hue
+The worst error of each is reported, with the HSV (or RGB) it was found at.
+
+Build (from btn_chaser/, with any host C compiler):
+    gcc -O2 -o colour_test -I ../../../common tools/colour_test/colour_test.c -lm
+
+Use:
+    ./colour_test [-f]
+    The exit code is the number of bounds exceeded (0 if all of them held).
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "common_colour.h"
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#define HSV2RGB_ERR_MAX     (2.0)   /* LSB, vs the float calculation */
+#define ROUND_TRIP_ERR_MAX  (1)     /* LSB */
+#define H16_SV_STEP         (5)     /* The saturation and value step for h16 (without -f) */
+
+/*******************************************************************************
+Local structure
+ *******************************************************************************/
+typedef struct
+{
+    double err;         /* The worst error so far */
+    uint32_t h;         /* ...and where it was found */
+    uint8_t s;
+    uint8_t v;
+} _ct_worst_t;
+
+/*******************************************************************************
+Local function prototypes
+ *******************************************************************************/
+/*! The float HSV -> RGB, which the integer versions are checked against
+ * @param hue The hue as a fraction of a full turn (0.0 to <1.0)
+ * @param s Saturation, 0-255
+ * @param v Value, 0-255
+ * @param[out] rgb The (unrounded) red, green and blue
+ */
+void _ct_hsv2rgb_ref(double hue, uint8_t s, uint8_t v, double rgb[3]);
+
+/*! Checks a single integer HSV -> RGB result against the float one
+ * @param worst The worst error to update
+ * @param out The 24-bit RGB value from the integer conversion
+ * @param hue The hue as a fraction of a full turn
+ * @param h The hue (in the flavour checked), s and v, to report the worst error at
+ */
+void _ct_check_hsv2rgb(_ct_worst_t * worst, uint32_t out, double hue, uint32_t h, uint8_t s, uint8_t v);
+
+/*******************************************************************************
+Local (private) Functions
+ *******************************************************************************/
+void _ct_hsv2rgb_ref(double hue, uint8_t s, uint8_t v, double rgb[3])
+{
+    double hh = hue * COLOUR_HUE_SECTORS;
+    int sector = (int)hh;
+    double max = v;
+    double min = v - (v * s) / 255.0;
+    double adj = (max - min) * (hh - sector);
+
+    switch (sector)
+    {
+    case 0:  rgb[0] = max;       rgb[1] = min + adj; rgb[2] = min;       break;
+    case 1:  rgb[0] = max - adj; rgb[1] = max;       rgb[2] = min;       break;
+    case 2:  rgb[0] = min;       rgb[1] = max;       rgb[2] = min + adj; break;
+    case 3:  rgb[0] = min;       rgb[1] = max - adj; rgb[2] = max;       break;
+    case 4:  rgb[0] = min + adj; rgb[1] = min;       rgb[2] = max;       break;
+    default: rgb[0] = max;       rgb[1] = min;       rgb[2] = max - adj; break;
+    }
+}
+
+void _ct_check_hsv2rgb(_ct_worst_t * worst, uint32_t out, double hue, uint32_t h, uint8_t s, uint8_t v)
+{
+    double ref[3];
+
+    _ct_hsv2rgb_ref(hue, s, v, ref);
+    for (int c = 0; c < 3; c++)
+    {
+        double err = fabs((double)((out >> (16 - 8 * c)) & 0xFF) - ref[c]);
+        if (err > worst->err)
+        {
+            worst->err = err;
+            worst->h = h;
+            worst->s = s;
+            worst->v = v;
+        }
+    }
+}
+
+static int _ct_report(const char * name, const _ct_worst_t * worst)
+{
+    bool pass = (worst->err <= HSV2RGB_ERR_MAX);
+
+    printf("%s  hsv2rgb_%-4s worst %.3f LSB (max %.0f) at h %lu, s %u, v %u\n", pass? "pass" : "FAIL", name,
+        worst->err, HSV2RGB_ERR_MAX, (unsigned long)worst->h, worst->s, worst->v);
+    return pass? 0 : 1;
+}
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+int main(int argc, char * argv[])
+{
+    int sv_step = H16_SV_STEP;
+    int fails = 0;
+    _ct_worst_t worst;
+
+    if ((argc > 1) && (strcmp(argv[1], "-f") == 0))
+        sv_step = 1;
+    else if (argc > 1)
+    {
+        printf("Usage: %s [-f]\n", argv[0]);
+        printf("    -f  Checks the 16-bit hue at every saturation and value as well\n");
+        return -1;
+    }
+
+    memset(&worst, 0, sizeof(worst));
+    for (uint32_t h = 0; h < 360; h++)
+        for (uint32_t s = 0; s <= 0xFF; s++)
+            for (uint32_t v = 0; v <= 0xFF; v++)
+                _ct_check_hsv2rgb(&worst, colour_hsv2rgb_h360(h, s, v), h / 360.0, h, s, v);
+    fails += _ct_report("h360", &worst);
+
+    memset(&worst, 0, sizeof(worst));
+    for (uint32_t h = 0; h <= 0xFF; h++)
+        for (uint32_t s = 0; s <= 0xFF; s++)
+            for (uint32_t v = 0; v <= 0xFF; v++)
+                _ct_check_hsv2rgb(&worst, colour_hsv2rgb_h8(h, s, v), h / 256.0, h, s, v);
+    fails += _ct_report("h8", &worst);
+
+    //The grid always includes 0 and 255 (255 is a multiple of the default step)
+    memset(&worst, 0, sizeof(worst));
+    for (uint32_t s = 0; s <= 0xFF; s += sv_step)
+        for (uint32_t v = 0; v <= 0xFF; v += sv_step)
+            for (uint32_t h = 0; h <= 0xFFFF; h++)
+                _ct_check_hsv2rgb(&worst, colour_hsv2rgb_h16(h, s, v), h / 65536.0, h, s, v);
+    fails += _ct_report("h16", &worst);
+
+    int rt_worst = 0;
+    uint32_t rt_rgb = 0;
+    for (uint32_t rgb = 0; rgb <= 0xFFFFFF; rgb++)
+    {
+        uint16_t h;
+        uint8_t s, v;
+
+        colour_rgb2hsv_h16(rgb, &h, &s, &v);
+        uint32_t out = colour_hsv2rgb_h16(h, s, v);
+        for (int shift = 0; shift <= 16; shift += 8)
+        {
+            int err = abs((int)((out >> shift) & 0xFF) - (int)((rgb >> shift) & 0xFF));
+            if (err > rt_worst)
+            {
+                rt_worst = err;
+                rt_rgb = rgb;
+            }
+        }
+    }
+    printf("%s  round trip   worst %d LSB (max %d) at %06lX\n", (rt_worst <= ROUND_TRIP_ERR_MAX)? "pass" : "FAIL",
+        rt_worst, ROUND_TRIP_ERR_MAX, (unsigned long)rt_rgb);
+    if (rt_worst > ROUND_TRIP_ERR_MAX)
+        fails++;
+
+    printf("%s (%d failed)\n", (fails == 0)? "PASSED" : "FAILED", fails);
+    return fails;
+}
@@ -0,0 +1,393 @@
+/*******************************************************************************
+
+Module:     comms_test.c
+Purpose:    This file contains the host test for the bus framing and reassembly
+Author:     Rudolph van Niekerk
+
+Sends msgs through the fragmenter of the comms task (_tx_now() and
+_tx_msg_handler(), which escape and frame them onto the simulated bus), splits
+what went onto the bus back into frames, and plays the frames (as they are,
+or reordered, changed or dropped) into the receiver (_rx_msg_handler() and
+_rx_reassemble()). Checks:
+  - Msgs from a single frame (a cmd and a response code) up to
+    RGB_BTN_MSG_MAX_DATA_LEN come out as they went in, with every byte value
+    (incl. STX, DLE and ETX) in the data, and with a last fragment of only 1
+    byte.
+  - The reassembled msg is a single frame to the application (frag 0, the
+    total len) with a CRC of its own over the whole msg.
+  - Fragments out of order, a fragment lost, a fragment with a bad CRC, and a
+    fragment with the src or the id of another msg in the middle of a msg:
+    the msg is dropped (frag_err or crc_err) and the next one gets through.
+  - A new msg (fragment 0) in the middle of another: the first is dropped.
+  - A msg longer than RGB_BTN_MSG_MAX_DATA_LEN (more fragments than fit) is
+    dropped (the check is made before the fragment is copied in).
+
+The comms task is included (not linked), so that the test can get to its
+local functions and state. The UART, FreeRTOS, the timers and the console are
+stood in for by stub/, tools/game_sim/stub/ and sim_uart.c.
+
+Build (from btn_chaser/, with any host C compiler):
+    gcc -O2 -o comms_test -I tools/comms_test/stub -I tools/game_sim/stub \
+        -I main tools/comms_test/comms_test.c tools/comms_test/sim_uart.c
+
+Use:
+    ./comms_test [-v]
+    -v prints the trace of the comms task. The exit code is the number of
+    failed checks (0 if all passed).
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "task_comms.c"
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#ifdef PRINTF_TAG
+#undef PRINTF_TAG
+#endif
+#define PRINTF_TAG ("Test") /* This must be undefined at the end of the file*/
+
+#define TEST_FRAMES_MAX     (16)
+#define TEST_NODE_ADDR      (0x42)
+#define TEST_OTHER_ADDR     (0x43)
+
+/*******************************************************************************
+Local structure
+ *******************************************************************************/
+typedef struct
+{
+    uint8_t data[RGB_BTN_FRAME_MAX_LEN];
+    size_t len;
+} _test_frame_t;
+
+typedef struct
+{
+    _test_frame_t frame[TEST_FRAMES_MAX];
+    size_t cnt;
+} _test_frames_t;
+
+/*******************************************************************************
+Global (public) variables
+ *******************************************************************************/
+extern bool sim_console_verbose;
+extern uint8_t sim_bus[];
+extern size_t sim_bus_len;
+extern void (*sim_delay_hook)(void);
+void sim_uart_rx(const uint8_t * data, size_t len);
+
+/*******************************************************************************
+Local function prototypes
+ *******************************************************************************/
+
+/*! \brief Does the work of the comms task: sends whatever is in the TX queue onto the bus
+ */
+void _test_comms_task(void);
+
+/*! \brief Sends a msg through the fragmenter and splits what went onto the bus back into frames
+ * \param frames The frames of the msg (unescaped, without the STX and ETX)
+ * \param id The id to send the msg with
+ * \param len The number of data bytes (the data is _test_data() from the id)
+ */
+void _test_send(_test_frames_t * frames, uint8_t id, size_t len);
+
+/*! \brief Fills a msg's data from its id (every value from 0x00 to 0xFF turns up in a long enough msg)
+ */
+void _test_data(uint8_t * data, uint8_t id, size_t len);
+
+/*! \brief Recalculates the CRC of a frame after the test changed its header
+ */
+void _test_frame_crc(_test_frame_t * frame);
+
+/*! \brief Plays a frame into the receiver (escaped, between STX and ETX)
+ */
+void _test_rx(const _test_frame_t * frame);
+
+/*! \brief Reads the next msg passed up to the application
+ * \return true if there was one
+ */
+bool _test_read(comms_msg_t * msg, size_t * msg_size);
+
+/*! \brief Checks that the next msg passed up to the application is the one sent with this id and length
+ * \return true if it is
+ */
+bool _test_read_ok(uint8_t id, size_t len);
+
+/*! \brief Reports the outcome of a check
+ */
+void _test_check(bool ok, const char * name, const char * fmt, ...);
+
+/*******************************************************************************
+Local variables
+ *******************************************************************************/
+static int _test_fails = 0;
+
+/*******************************************************************************
+Local (private) Functions
+ *******************************************************************************/
+void _test_comms_task(void)
+{
+    comms_msg_queue_item_t _item;
+
+    while (xQueueReceive(_comms.rs485.tx_msg_queue, &_item, 0) == pdTRUE)
+        _tx_msg_handler(&_item);
+}
+
+void _test_send(_test_frames_t * frames, uint8_t id, size_t len)
+{
+    comms_tx_msg_t _tx_msg;
+    uint8_t _data[RGB_BTN_MSG_MAX_DATA_LEN];
+    bool _escaping = false;
+    _test_frame_t * _frame = NULL;
+
+    _test_data(_data, id, len);
+    comms_tx_msg_init(&_tx_msg, TEST_NODE_ADDR);
+    memcpy(_tx_msg.msg.data, _data, len);
+    _tx_msg.data_length = len;
+
+    sim_bus_len = 0;
+    comms_tx_msg_send_seq(&_tx_msg, id);
+    _test_comms_task(); //The last fragment is still in the queue
+
+    //Split the bus back into frames
+    frames->cnt = 0;
+    for (size_t i = 0; i < sim_bus_len; i++)
+    {
+        uint8_t _d = sim_bus[i];
+        if (_d == STX)
+        {
+            _frame = &frames->frame[frames->cnt++];
+            _frame->len = 0;
+        }
+        else if (_d == ETX)
+            _frame = NULL;
+        else if (_d == DLE)
+            _escaping = true;
+        else if (_frame != NULL)
+        {
+            _frame->data[_frame->len++] = (_escaping)? (_d ^ DLE) : _d;
+            _escaping = false;
+        }
+    }
+}
+
+void _test_data(uint8_t * data, uint8_t id, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        data[i] = (uint8_t)((i * 37) + id);
+}
+
+void _test_frame_crc(_test_frame_t * frame)
+{
+    frame->data[frame->len - 1] = crc8_n(0, frame->data, frame->len - 1);
+}
+
+void _test_rx(const _test_frame_t * frame)
+{
+    uint8_t _bytes[2 + (2 * RGB_BTN_FRAME_MAX_LEN)];
+    size_t _len = 0;
+    uart_event_t _event = {.type = UART_DATA};
+
+    _bytes[_len++] = STX;
+    for (size_t i = 0; i < frame->len; i++)
+    {
+        uint8_t _d = frame->data[i];
+        if ((_d == STX) || (_d == DLE) || (_d == ETX))
+        {
+            _bytes[_len++] = DLE;
+            _d ^= DLE;
+        }
+        _bytes[_len++] = _d;
+    }
+    _bytes[_len++] = ETX;
+
+    sim_uart_rx(_bytes, _len);
+    _event.size = _len;
+    _rx_msg_handler(&_event);
+}
+
+bool _test_read(comms_msg_t * msg, size_t * msg_size)
+{
+    return comms_msg_rx_read(msg, msg_size);
+}
+
+bool _test_read_ok(uint8_t id, size_t len)
+{
+    comms_msg_t _msg;
+    size_t _msg_size = 0;
+    uint8_t _data[RGB_BTN_MSG_MAX_DATA_LEN];
+
+    if (!_test_read(&_msg, &_msg_size))
+        return false;
+
+    _test_data(_data, id, len);
+    return ((_msg_size == (sizeof(comms_msg_hdr_t) + len + sizeof(uint8_t))) &&
+            (_msg.hdr.version == RGB_BTN_MSG_VERSION) && (_msg.hdr.id == id) &&
+            (_msg.hdr.src == ADDR_MASTER) && (_msg.hdr.dst == TEST_NODE_ADDR) &&
+            (_msg.hdr.frag == 0) && (_msg.hdr.len == len) &&
+            (memcmp(_msg.data, _data, len) == 0) &&
+            (crc8_n(0, (uint8_t *)&_msg, _msg_size) == 0));  //The CRC of the whole msg, not of the last fragment
+}
+
+void _test_check(bool ok, const char * name, const char * fmt, ...)
+{
+    va_list args;
+
+    if (!ok)
+        _test_fails++;
+    printf("%s  %-12s ", ok? "pass" : "FAIL", name);
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+    printf("\n");
+}
+
+static void _test_in_order(void)
+{
+    static const size_t _lens[] = {2, RGB_BTN_FRAME_MAX_DATA_LEN, RGB_BTN_FRAME_MAX_DATA_LEN + 1,
+                                   2 * RGB_BTN_FRAME_MAX_DATA_LEN, 100, RGB_BTN_MSG_MAX_DATA_LEN};
+    _test_frames_t _frames;
+
+    for (size_t i = 0; i < ARRAY_SIZE(_lens); i++)
+    {
+        uint8_t _id = (uint8_t)(0x10 + i);
+
+        _test_send(&_frames, _id, _lens[i]);
+        for (size_t f = 0; f < _frames.cnt; f++)
+            _test_rx(&_frames.frame[f]);
+        bool ok = _test_read_ok(_id, _lens[i]) && (!_test_read(NULL, NULL));
+        _test_check(ok, "in order", "%3zu bytes in %zu frame(s): reassembled, CRC of the whole msg ok", _lens[i], _frames.cnt);
+    }
+}
+
+static void _test_dropped(const char * name, const char * desc, const size_t * order, size_t cnt, void (*change)(_test_frames_t *), uint32_t * err_cnt)
+{
+    _test_frames_t _frames;
+    uint32_t _errs = *err_cnt;
+
+    //A msg of 3 fragments, played into the receiver in this order (and changed)
+    _test_send(&_frames, 0x20, RGB_BTN_MSG_MAX_DATA_LEN);
+    if (change)
+        change(&_frames);
+    for (size_t i = 0; i < cnt; i++)
+        _test_rx(&_frames.frame[order[i]]);
+    bool ok = (!_test_read(NULL, NULL)) && (*err_cnt > _errs);
+
+    //... and the next msg gets through
+    _test_send(&_frames, 0x21, RGB_BTN_MSG_MAX_DATA_LEN);
+    for (size_t f = 0; f < _frames.cnt; f++)
+        _test_rx(&_frames.frame[f]);
+    ok &= _test_read_ok(0x21, RGB_BTN_MSG_MAX_DATA_LEN);
+    _test_check(ok, name, "%s: dropped (%u errors), the next msg ok", desc, *err_cnt - _errs);
+}
+
+static void _test_change_src(_test_frames_t * frames)
+{
+    frames->frame[1].data[offsetof(comms_msg_hdr_t, src)] = TEST_OTHER_ADDR;
+    _test_frame_crc(&frames->frame[1]);
+}
+
+static void _test_change_id(_test_frames_t * frames)
+{
+    frames->frame[1].data[offsetof(comms_msg_hdr_t, id)]++;
+    _test_frame_crc(&frames->frame[1]);
+}
+
+static void _test_change_crc(_test_frames_t * frames)
+{
+    frames->frame[1].data[sizeof(comms_msg_hdr_t)] ^= 0x01;
+}
+
+static void _test_out_of_order(void)
+{
+    static const size_t _order_021[] = {0, 2, 1};
+    static const size_t _order_102[] = {1, 0, 2};
+    static const size_t _order_02[] = {0, 2};
+    static const size_t _order_012[] = {0, 1, 2};
+
+    _test_dropped("order", "fragments 0, 2, 1", _order_021, ARRAY_SIZE(_order_021), NULL, &_comms.stats.frag_err);
+    _test_dropped("order", "fragments 1, 0, 2", _order_102, ARRAY_SIZE(_order_102), NULL, &_comms.stats.frag_err);
+    _test_dropped("lost", "fragments 0, 2", _order_02, ARRAY_SIZE(_order_02), NULL, &_comms.stats.frag_err);
+    _test_dropped("src", "fragment 1 from another src", _order_012, ARRAY_SIZE(_order_012), _test_change_src, &_comms.stats.frag_err);
+    _test_dropped("id", "fragment 1 with another id", _order_012, ARRAY_SIZE(_order_012), _test_change_id, &_comms.stats.frag_err);
+    _test_dropped("crc", "fragment 1 with a bad CRC", _order_012, ARRAY_SIZE(_order_012), _test_change_crc, &_comms.stats.crc_err);
+}
+
+static void _test_restart(void)
+{
+    _test_frames_t _first;
+    _test_frames_t _second;
+    uint32_t _errs = _comms.stats.frag_err;
+
+    //The 1st fragment of a msg, and then a whole new msg (e.g. the rest of the 1st was lost)
+    _test_send(&_first, 0x30, RGB_BTN_MSG_MAX_DATA_LEN);
+    _test_send(&_second, 0x31, RGB_BTN_MSG_MAX_DATA_LEN);
+    _test_rx(&_first.frame[0]);
+    for (size_t f = 0; f < _second.cnt; f++)
+        _test_rx(&_second.frame[f]);
+    bool ok = _test_read_ok(0x31, RGB_BTN_MSG_MAX_DATA_LEN) && (!_test_read(NULL, NULL)) && (_comms.stats.frag_err == _errs);
+
+    //... and the rest of the 1st one is ignored
+    _test_rx(&_first.frame[1]);
+    _test_rx(&_first.frame[2]);
+    ok &= (!_test_read(NULL, NULL));
+    _test_check(ok, "restart", "fragment 0 of a new msg in the middle of another: only the new one");
+}
+
+static void _test_overlong(void)
+{
+    _test_frames_t _frames;
+    uint32_t _errs = _comms.stats.frag_err;
+
+    //The fragmenter never sends more than RGB_BTN_MSG_MAX_DATA_LEN, so the 3 full frames are made up: 0 and 1 of a
+    // long msg, and 1 again as fragment 2 (with more to follow)
+    _test_send(&_frames, 0x40, 2 * RGB_BTN_FRAME_MAX_DATA_LEN);
+    _frames.frame[0].data[offsetof(comms_msg_hdr_t, frag)] |= COMMS_FRAG_MORE;
+    _test_frame_crc(&_frames.frame[0]);
+    _frames.frame[2] = _frames.frame[1];
+    _frames.frame[1].data[offsetof(comms_msg_hdr_t, frag)] = 1 | COMMS_FRAG_MORE;
+    _test_frame_crc(&_frames.frame[1]);
+    _frames.frame[2].data[offsetof(comms_msg_hdr_t, frag)] = 2;
+    _test_frame_crc(&_frames.frame[2]);
+
+    for (size_t f = 0; f < 3; f++)
+        _test_rx(&_frames.frame[f]);
+    bool ok = (!_test_read(NULL, NULL)) && (_comms.stats.frag_err > _errs) && (_reassembly.next_frag == 0);
+    _test_check(ok, "overlong", "%d data bytes in 3 fragments (max %d): dropped", 3 * RGB_BTN_FRAME_MAX_DATA_LEN, RGB_BTN_MSG_MAX_DATA_LEN);
+}
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+int main(int argc, char * argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-v"))
+            sim_console_verbose = true;
+    }
+
+    //What _comms_main_func() sets up, the test does the work of the task itself
+    _comms.rs485.tx_msg_queue = xQueueCreate(COMMS_MSG_TX_Q_LEN, sizeof(comms_msg_queue_item_t));
+    _comms.rs485.rx_msg_queue = xQueueCreate(COMMS_MSG_RX_Q_LEN, sizeof(comms_msg_queue_item_t));
+    sim_delay_hook = _test_comms_task;
+
+    printf("Comms: frames of %d bytes (%d data), msgs of %d data bytes\n", RGB_BTN_FRAME_MAX_LEN, (int)RGB_BTN_FRAME_MAX_DATA_LEN, (int)RGB_BTN_MSG_MAX_DATA_LEN);
+    _test_in_order();
+    _test_out_of_order();
+    _test_restart();
+    _test_overlong();
+
+    printf("%s (%d failed)\n", (_test_fails == 0)? "PASSED" : "FAILED", _test_fails);
+    return _test_fails;
+}
+
+#undef PRINTF_TAG
+/*************************** END OF FILE *************************************/
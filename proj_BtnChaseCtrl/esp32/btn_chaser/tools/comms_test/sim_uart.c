@@ -0,0 +1,303 @@
+/*******************************************************************************
+
+Module:     sim_uart.c
+Purpose:    This file contains the host stand-ins for the comms test
+Author:     Rudolph van Niekerk
+
+The UART (see stub/driver/uart.h), the FreeRTOS queues and delays, the timers,
+the metrics and the console, just enough to run task_comms.c on the host
+(comms_test.c). Everything written to the UART is kept on the simulated bus
+(sim_bus[]), and the bytes read from it are the ones handed to sim_uart_rx().
+Nothing runs by itself: a delay calls sim_delay_hook (if set), which is where
+the test does the work of the comms task.
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "driver/uart.h"
+#include "driver/gpio.h"
+#include "sys_utils.h"
+#include "sys_timers.h"
+#include "sys_metrics.h"
+#include "task_console.h"
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#define SIM_BUS_SIZE    (4096)
+
+/*******************************************************************************
+Local structure
+ *******************************************************************************/
+struct sim_queue_t
+{
+    uint8_t * items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t cnt;
+};
+
+struct sim_esp_timer_t
+{
+    esp_timer_create_args_t args;
+    bool active;
+};
+
+/*******************************************************************************
+Global (public) variables
+ *******************************************************************************/
+bool sim_console_verbose = false;
+uint8_t sim_bus[SIM_BUS_SIZE];          /* Everything written to the UART */
+size_t sim_bus_len = 0;
+void (*sim_delay_hook)(void) = NULL;    /* Called on every delay (the comms task gets to run) */
+
+/*******************************************************************************
+Local variables
+ *******************************************************************************/
+static const uint8_t * _sim_rx_data = NULL;
+static size_t _sim_rx_len = 0;
+static uint64_t _sim_now_us = 0;
+
+/*******************************************************************************
+Local (private) Functions
+ *******************************************************************************/
+static void _sim_console_vprint(uint8_t traceflags, const char * tag, const char * fmt, va_list args, bool line)
+{
+    if (!sim_console_verbose)
+        return;
+    if (line)
+        printf("      [%s] ", tag);
+    vprintf(fmt, args);
+    if (line)
+        printf("\n");
+}
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+void sim_uart_rx(const uint8_t * data, size_t len)
+{
+    _sim_rx_data = data;
+    _sim_rx_len = len;
+}
+
+int uart_read_bytes(uart_port_t uart_num, void * buf, uint32_t length, TickType_t ticks_to_wait)
+{
+    size_t _len = (length < _sim_rx_len)? length : _sim_rx_len;
+
+    memcpy(buf, _sim_rx_data, _len);
+    _sim_rx_data += _len;
+    _sim_rx_len -= _len;
+    return (int)_len;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void * src, size_t size)
+{
+    if ((sim_bus_len + size) > sizeof(sim_bus))
+        return -1;
+    memcpy(&sim_bus[sim_bus_len], src, size);
+    sim_bus_len += size;
+    return (int)size;
+}
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size, int queue_size, QueueHandle_t * uart_queue, int intr_alloc_flags)
+{
+    *uart_queue = xQueueCreate(queue_size, sizeof(uart_event_t));
+    return ESP_OK;
+}
+
+esp_err_t uart_driver_delete(uart_port_t uart_num) { return ESP_OK; }
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t * uart_config) { return ESP_OK; }
+esp_err_t uart_set_pin(uart_port_t uart_num, int tx_io_num, int rx_io_num, int rts_io_num, int cts_io_num) { return ESP_OK; }
+esp_err_t uart_set_mode(uart_port_t uart_num, uart_mode_t mode) { return ESP_OK; }
+esp_err_t uart_flush_input(uart_port_t uart_num) { return ESP_OK; }
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) { return ESP_OK; }
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t queue = calloc(1, sizeof(struct sim_queue_t));
+
+    queue->items = calloc(length, item_size);
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void * item, TickType_t wait)
+{
+    if (queue->cnt >= queue->length)
+        return pdFALSE;
+    memcpy(&queue->items[((queue->head + queue->cnt) % queue->length) * queue->item_size], item, queue->item_size);
+    queue->cnt++;
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void * item, TickType_t wait)
+{
+    if (queue->cnt == 0)
+        return pdFALSE;
+    memcpy(item, &queue->items[queue->head * queue->item_size], queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->cnt--;
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    queue->head = 0;
+    queue->cnt = 0;
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return queue->cnt;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char * name, configSTACK_DEPTH_TYPE stack_depth, void * param, UBaseType_t priority, TaskHandle_t * handle)
+{
+    //The test runs the comms task's work itself (see sim_delay_hook)
+    *handle = (TaskHandle_t)1;
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    _sim_now_us += (uint64_t)ticks * 1000;
+    if (sim_delay_hook)
+        sim_delay_hook();
+}
+
+BaseType_t xTaskDelayUntil(TickType_t * prev_wake, TickType_t ticks)
+{
+    *prev_wake += ticks;
+    vTaskDelay(ticks);
+    return pdTRUE;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(_sim_now_us / 1000);
+}
+
+configSTACK_DEPTH_TYPE uxTaskGetStackHighWaterMark2(TaskHandle_t handle)
+{
+    return 0;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)_sim_now_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t * create_args, esp_timer_handle_t * out_handle)
+{
+    *out_handle = calloc(1, sizeof(struct sim_esp_timer_t));
+    (*out_handle)->args = *create_args;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    timer->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_restart(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    timer->active = true;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    return timer->active;
+}
+
+const char * esp_err_to_name(esp_err_t code)
+{
+    return (code == ESP_OK)? "ESP_OK" : "ESP_FAIL";
+}
+
+void sys_stopwatch_ms_start(Stopwatch_ms_t* sw, uint32_t max_time)
+{
+    sw->tick_start = xTaskGetTickCount();
+    sw->running = true;
+    sw->max_time = max_time;
+}
+
+uint32_t sys_stopwatch_ms_lap(Stopwatch_ms_t* sw)
+{
+    return (sw->running)? xTaskGetTickCount() - sw->tick_start : 0;
+}
+
+int metrics_add(const char * _group_name, const metric_item_t * _tbl, size_t _cnt)
+{
+    return 0;
+}
+
+void metric_hist_add(metric_hist_t * hist, uint32_t value) {}
+
+void console_printline(uint8_t traceflags, const char * tag, const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    _sim_console_vprint(traceflags, tag, fmt, args, true);
+    va_end(args);
+}
+
+void console_print(uint8_t traceflags, const char * tag, const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    _sim_console_vprint(traceflags, tag, fmt, args, false);
+    va_end(args);
+}
+
+void console_trace(uint8_t traceflags, const char * tag, const char *fmt, const uint32_t *args, size_t cnt)
+{
+    uint32_t a[CONSOLE_TRACE_ARGS_MAX] = {0};
+
+    for (size_t i = 0; (i < cnt) && (i < CONSOLE_TRACE_ARGS_MAX); i++)
+        a[i] = args[i];
+    console_printline(traceflags, tag, fmt, a[0], a[1], a[2], a[3]);
+}
+
+void console_trace_memory(uint8_t traceflags, const char * tag, const void * src, unsigned long address, size_t len) {}
+
+uint8_t crc8_n(uint8_t crc_start, const uint8_t *data, size_t len)
+{
+    //The same as in sys_utils.c (the rest of which is the chip and the NVS)
+    uint8_t crc = crc_start;
+    while (len--)
+    {
+        uint8_t extract = *data++;
+        for (size_t i = 8; i; i--)
+        {
+            uint8_t sum = (crc ^ extract) & 0x01;
+            crc >>= 1;
+            if (sum)
+                crc ^= CRC_8_POLYNOMIAL;
+            extract >>= 1;
+        }
+    }
+    return crc;
+}
+
+/*************************** END OF FILE *************************************/
@@ -0,0 +1,23 @@
+/*****************************************************************************
+
+driver/gpio.h
+
+Host stand-in for the ESP-IDF GPIO driver, only the pin numbers task_comms.c
+uses (see tools/comms_test/comms_test.c)
+
+******************************************************************************/
+#ifndef __sim_gpio_H__
+#define __sim_gpio_H__
+
+#include "esp_err.h"
+
+typedef enum
+{
+    GPIO_NUM_4 = 4,
+    GPIO_NUM_5 = 5,
+    GPIO_NUM_6 = 6,
+} gpio_num_t;
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level);
+
+#endif /* __sim_gpio_H__ */
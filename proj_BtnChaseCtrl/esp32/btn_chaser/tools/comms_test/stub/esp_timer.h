@@ -0,0 +1,38 @@
+/*****************************************************************************
+
+esp_timer.h
+
+Host stand-in for the ESP-IDF high resolution timer, only what task_comms.c
+uses (see tools/comms_test/comms_test.c). The timers never fire by themselves,
+the test calls the callback when the bus has been silent long enough.
+
+******************************************************************************/
+#ifndef __sim_esp_timer_H__
+#define __sim_esp_timer_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef void (*esp_timer_cb_t)(void * arg);
+
+typedef struct
+{
+    esp_timer_cb_t callback;
+    void * arg;
+    const char * name;
+} esp_timer_create_args_t;
+
+typedef struct sim_esp_timer_t * esp_timer_handle_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t * create_args, esp_timer_handle_t * out_handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_restart(esp_timer_handle_t timer, uint64_t timeout_us);
+bool esp_timer_is_active(esp_timer_handle_t timer);
+
+/*! \brief The time since the simulation started
+ * \return The time in us
+ */
+int64_t esp_timer_get_time(void);
+
+#endif /* __sim_esp_timer_H__ */
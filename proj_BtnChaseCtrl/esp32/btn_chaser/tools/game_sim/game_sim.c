@@ -0,0 +1,1024 @@
+/*******************************************************************************
+
+Module:     game_sim.c
+Purpose:    This file contains the host game harness (a benchmark for the games)
+Author:     Rudolph van Niekerk
+
+Runs the game task (task_game.c) and a game from games_list[] on the host, on
+a virtual clock, against simulated nodes (sim_nodes.c) and a simulated player.
+Nothing waits on a real clock, so minutes of play take milliseconds, and the
+same seed (or the same recorded presses) gives exactly the same run.
+
+The player presses the node to press (the only active one, or the one with a
+green 3rd colour in the Memory game) after a random reaction time, misses a
+round now and then (--miss) or presses the wrong node (--wrong). A round is
+every time the nodes go from all inactive to (some) active. The presses can be
+recorded (--record) and replayed (--replay) as "<round> <slot> <delay_ms>"
+lines, the delay being from the start of the round. A replayed run presses
+exactly the same, even if the game has changed in the meantime.
+
+With --per-node the player presses every node on its own instead (e.g. the
+players of a multi-target Chaser): each time a node is activated, it gets a
+press after a reaction time of its own, and every activation is a round.
+
+With --lose a node drops off the bus part of the way into the game. The master
+has to find out (a direct msg runs out of retries), deregister it, tell the
+nodes above it about their new slots and carry on. poll_missed and view_errors
+count the times the master and the nodes disagree on who is in which slot;
+they must stay 0 (exit code 3 if not).
+
+The report (on stdout) is a list of key=value lines, e.g.:
+    tx_per_round    The msgs on the bus per round (direct and broadcast)
+    bus_util_pct    The time the bus was busy
+    detect_ms_*     From a press to the game reading it
+    feedback_ms_*   From a press to the end of the 1st msg changing a LED after that
+    game.*          The game task metrics (task_game.c)
+Save it, and pass it back with --baseline to check a change: any of the costs
+which got worse by more than --tolerance (%) is a regression (exit code 2).
+
+Build (from btn_chaser/, with any host C compiler):
+    gcc -O2 -o game_sim -I tools/game_sim/stub -I main \
+        tools/game_sim/game_sim.c tools/game_sim/sim_nodes.c \
+        main/task_game.c main/game_demo.c main/game_random_chase.c \
+        main/game_memory.c main/colour.c main/str_helper.c
+
+Use:
+    ./game_sim -g chaser -t 600 --record chase.txt > chase_base.txt
+    (change the game)
+    ./game_sim -g chaser -t 600 --replay chase.txt --baseline chase_base.txt
+    ./game_sim -g chaser -a 10 -a 3 --per-node -n 8 --lose 2@30
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <getopt.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "sys_utils.h"
+#include "sys_timers.h"
+#include "task_console.h"
+#include "sys_metrics.h"
+#include "sys_telemetry.h"
+#include "sys_rstats.h"
+#include "task_game.h"
+#include "nodes.h"
+
+#include "game_sim.h"
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#ifdef PRINTF_TAG
+#undef PRINTF_TAG
+#endif
+#define PRINTF_TAG ("Sim") /* This must be undefined at the end of the file*/
+
+#define SIM_TIME_S_DEF          (120)
+#define SIM_REACT_MIN_MS_DEF    (300)
+#define SIM_REACT_MAX_MS_DEF    (700)
+#define SIM_TOLERANCE_PCT_DEF   (5)
+#define SIM_TOLERANCE_ABS       (1.0)       /* Below this, a change is noise (a count or a ms) */
+#define SIM_GAME_ARGS_MAX       (4)
+#define SIM_METRIC_GROUPS_MAX   (4)
+#define SIM_KV_MAX              (64)
+#define SIM_STALL_MAX           (100000)    /* Calls without the clock moving on before we call it a hang */
+
+/* The costs checked against the baseline (higher is worse) */
+static const char * _sim_cost_keys[] = {
+    "tx_per_round", "tx_per_s", "bus_util_pct",
+    "detect_ms_avg", "detect_ms_p90", "feedback_ms_avg", "feedback_ms_p90",
+    "game.loop_max", "game.late_max", "game.overruns", "game.evt_drops",
+};
+
+/* The settings which have to match for a baseline to mean anything */
+static const char * _sim_scenario_keys[] = {"game", "nodes", "time_s", "seed"};
+
+/*******************************************************************************
+local defines
+ *******************************************************************************/
+typedef enum
+{
+    _press_hit = 0,     // The node to press
+    _press_wrong,       // Any other active node
+    _press_slot,        // A replayed press (on the recorded node)
+} _sim_press_kind_t;
+
+typedef struct
+{
+    uint32_t round;
+    int slot;
+    uint32_t delay_ms;
+} _sim_replay_t;
+
+typedef struct
+{
+    uint64_t us;                // When the press is due (0 if none)
+    _sim_press_kind_t kind;
+    int slot;                   // The node for a replayed press
+    uint32_t round;             // The round it belongs to
+    uint64_t round_us;          // ... and when that round started
+} _sim_press_t;
+
+typedef struct
+{
+    char key[32];
+    char value[48];
+} _sim_kv_t;
+
+/*******************************************************************************
+local function prototypes
+ *******************************************************************************/
+
+/*! \brief Presses a button for the player (the one due now)
+ * \param press The press
+ * \param target The node to press (-1 if none is active)
+ */
+void _sim_player_press(_sim_press_t * press, int target);
+
+/*! \brief Decides if, when and where the player presses in a new round (or replays the recorded press)
+ * \param press The press to set up
+ */
+void _sim_player_schedule(_sim_press_t * press);
+
+/*! \brief Finds the press due first
+ * \param slot Set to the node for a --per-node press, -1 for the press of the round
+ * \return The press, or NULL if none is pending
+ */
+_sim_press_t * _sim_player_next(int * slot);
+
+/*! \brief A random number for the player (not the same sequence as esp_random(), which the games use)
+ */
+uint32_t _sim_player_rand(void);
+
+/*! \brief Reads the presses to replay
+ * \return true if the file could be read
+ */
+bool _sim_replay_load(const char * filename);
+
+/*! \brief Adds a line to the report
+ */
+void _sim_kv_add(_sim_kv_t * kv, int * cnt, const char * key, const char * fmt, ...);
+
+/*! \brief Adds the count, average, p50, p90 and max of a list of samples to the report
+ */
+void _sim_kv_add_samples(_sim_kv_t * kv, int * cnt, const char * name, sim_samples_t * samples);
+
+/*! \brief Compares the report with a previous one
+ * \return The number of regressions, or -1 if the baseline could not be read
+ */
+int _sim_baseline_check(const char * filename, const _sim_kv_t * kv, int cnt, double tolerance_pct);
+
+/*! \brief Runs the game task until the (virtual) time is up
+ */
+void _sim_run(void);
+
+void _sim_usage(const char * name);
+
+/*******************************************************************************
+local variables
+ *******************************************************************************/
+sim_stats_t sim_stats;
+
+struct {
+    uint64_t now_us;
+    uint64_t end_us;
+    uint64_t last_us;           // The clock when xQueueReceive() was last called (to spot a hang)
+    uint32_t stall_cnt;
+    bool stalled;
+    bool verbose;
+    uint64_t lose_us;           // When to lose a node (--lose, 0 if not)
+    int lose_slot;
+    jmp_buf end;
+    uint32_t rnd;               // esp_random()
+} _clk;
+
+struct {
+    TaskFunction_t fn;
+    void * param;
+} _task;
+
+struct sim_queue_t {
+    uint8_t * buff;
+    UBaseType_t len;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t cnt;
+};
+
+struct {
+    const char * name;
+    const metric_item_t * tbl;
+    size_t cnt;
+} _sim_metrics[SIM_METRIC_GROUPS_MAX];
+int _sim_metric_cnt = 0;
+
+struct {
+    uint32_t rnd;
+    uint32_t react_min_ms;
+    uint32_t react_max_ms;
+    uint32_t miss_pct;
+    uint32_t wrong_pct;
+    uint64_t round_us;          // When the current round started
+    bool round_pressed;
+    _sim_press_t press;         // The press of the current round
+    bool per_node;              // Each node is pressed on its own (--per-node)
+    _sim_press_t node_press[RGB_BTN_MAX_NODES];
+    bool node_pressed[RGB_BTN_MAX_NODES];
+    bool node_used[RGB_BTN_MAX_NODES];
+    _sim_replay_t * replay;
+    size_t replay_cnt;
+    size_t replay_idx;
+    FILE * record;
+} _player = {
+    .react_min_ms = SIM_REACT_MIN_MS_DEF,
+    .react_max_ms = SIM_REACT_MAX_MS_DEF,
+};
+
+/*******************************************************************************
+Local (private) Functions
+*******************************************************************************/
+void _sim_player_press(_sim_press_t * press, int target)
+{
+    int slot = (press->kind == _press_slot)? press->slot :
+               (press->kind == _press_wrong)? sim_nodes_other(target, _sim_player_rand()) : target;
+
+    if ((slot < 0) || (!sim_nodes_press(slot)))
+    {
+        //Too late (e.g. the game timed out the round), or the recorded node is not active in this run
+        sim_stats.strays++;
+        iprintln(trGAME, "#Round %d: stray press on node %d", press->round, slot);
+    }
+    else
+    {
+        sim_stats.presses++;
+        _player.round_pressed = true;
+        if (_player.per_node)
+            _player.node_pressed[target] = true;
+        if (slot != target)
+            sim_stats.wrong++;
+    }
+    if ((_player.record) && (slot >= 0))
+        fprintf(_player.record, "%u %d %u\n", press->round, slot, (uint32_t)((_clk.now_us - press->round_us) / 1000));
+}
+
+void _sim_player_schedule(_sim_press_t * press)
+{
+    press->us = 0;
+    press->round = sim_stats.rounds;
+    press->round_us = _clk.now_us;
+
+    if (_player.replay)
+    {
+        while ((_player.replay_idx < _player.replay_cnt) && (_player.replay[_player.replay_idx].round < sim_stats.rounds))
+            _player.replay_idx++;
+        if ((_player.replay_idx < _player.replay_cnt) && (_player.replay[_player.replay_idx].round == sim_stats.rounds))
+        {
+            press->kind = _press_slot;
+            press->slot = _player.replay[_player.replay_idx].slot;
+            press->us = _clk.now_us + (_player.replay[_player.replay_idx].delay_ms * 1000ULL);
+            _player.replay_idx++;
+        }
+        return;
+    }
+
+    if ((_sim_player_rand() % 100) < _player.miss_pct)
+        return;
+
+    uint32_t react_ms = _player.react_min_ms + (_sim_player_rand() % (_player.react_max_ms - _player.react_min_ms + 1));
+    press->kind = ((_sim_player_rand() % 100) < _player.wrong_pct)? _press_wrong : _press_hit;
+    press->us = _clk.now_us + (react_ms * 1000ULL);
+}
+
+_sim_press_t * _sim_player_next(int * slot)
+{
+    _sim_press_t *next = (_player.press.us != 0)? &_player.press : NULL;
+
+    *slot = -1;
+    for (int i = 0; i < RGB_BTN_MAX_NODES; i++)
+    {
+        if ((_player.node_press[i].us != 0) && ((next == NULL) || (_player.node_press[i].us < next->us)))
+        {
+            next = &_player.node_press[i];
+            *slot = i;
+        }
+    }
+    return next;
+}
+
+uint32_t _sim_player_rand(void)
+{
+    //xorshift32
+    _player.rnd ^= _player.rnd << 13;
+    _player.rnd ^= _player.rnd >> 17;
+    _player.rnd ^= _player.rnd << 5;
+    return _player.rnd;
+}
+
+static int _sim_replay_cmp(const void * a, const void * b)
+{
+    const _sim_replay_t *_a = (const _sim_replay_t *)a;
+    const _sim_replay_t *_b = (const _sim_replay_t *)b;
+    return (_a->round > _b->round) - (_a->round < _b->round);
+}
+
+bool _sim_replay_load(const char * filename)
+{
+    FILE *f = fopen(filename, "r");
+    char line[128];
+    size_t size = 0;
+
+    if (f == NULL)
+        return false;
+
+    while (fgets(line, sizeof(line), f))
+    {
+        _sim_replay_t entry;
+        if ((line[0] == '#') || (sscanf(line, "%u %d %u", &entry.round, &entry.slot, &entry.delay_ms) != 3))
+            continue;
+        if (_player.replay_cnt >= size)
+        {
+            size = (size > 0)? size * 2 : 256;
+            _player.replay = realloc(_player.replay, size * sizeof(_sim_replay_t));
+        }
+        _player.replay[_player.replay_cnt++] = entry;
+    }
+    fclose(f);
+    //The presses of parallel rounds (--per-node) are recorded as they happen, not in round order
+    if (_player.replay_cnt > 0)
+        qsort(_player.replay, _player.replay_cnt, sizeof(_sim_replay_t), _sim_replay_cmp);
+    return true;
+}
+
+void _sim_kv_add(_sim_kv_t * kv, int * cnt, const char * key, const char * fmt, ...)
+{
+    va_list args;
+
+    if (*cnt >= SIM_KV_MAX)
+        return;
+
+    snprintf(kv[*cnt].key, sizeof(kv[*cnt].key), "%s", key);
+    va_start(args, fmt);
+    vsnprintf(kv[*cnt].value, sizeof(kv[*cnt].value), fmt, args);
+    va_end(args);
+    (*cnt)++;
+}
+
+static int _sim_u32_cmp(const void * a, const void * b)
+{
+    uint32_t _a = *(const uint32_t *)a;
+    uint32_t _b = *(const uint32_t *)b;
+    return (_a > _b) - (_a < _b);
+}
+
+void _sim_kv_add_samples(_sim_kv_t * kv, int * cnt, const char * name, sim_samples_t * samples)
+{
+    char key[32];
+    uint64_t sum = 0;
+    size_t n = samples->cnt;
+
+    snprintf(key, sizeof(key), "%s_cnt", name);
+    _sim_kv_add(kv, cnt, key, "%u", (uint32_t)n);
+    if (n == 0)
+        return;
+
+    qsort(samples->value, n, sizeof(uint32_t), _sim_u32_cmp);
+    for (size_t i = 0; i < n; i++)
+        sum += samples->value[i];
+
+    snprintf(key, sizeof(key), "%s_avg", name);
+    _sim_kv_add(kv, cnt, key, "%.1f", (double)sum / n);
+    snprintf(key, sizeof(key), "%s_p50", name);
+    _sim_kv_add(kv, cnt, key, "%u", samples->value[(n - 1) / 2]);
+    snprintf(key, sizeof(key), "%s_p90", name);
+    _sim_kv_add(kv, cnt, key, "%u", samples->value[MIN(n - 1, (n * 9) / 10)]);
+    snprintf(key, sizeof(key), "%s_max", name);
+    _sim_kv_add(kv, cnt, key, "%u", samples->value[n - 1]);
+}
+
+static const char * _sim_kv_find(const _sim_kv_t * kv, int cnt, const char * key)
+{
+    for (int i = 0; i < cnt; i++)
+        if (!strcmp(kv[i].key, key))
+            return kv[i].value;
+    return NULL;
+}
+
+int _sim_baseline_check(const char * filename, const _sim_kv_t * kv, int cnt, double tolerance_pct)
+{
+    FILE *f = fopen(filename, "r");
+    _sim_kv_t base[SIM_KV_MAX];
+    int base_cnt = 0;
+    int regressions = 0;
+    char line[128];
+
+    if (f == NULL)
+        return -1;
+
+    while ((fgets(line, sizeof(line), f)) && (base_cnt < SIM_KV_MAX))
+    {
+        char *eq = strchr(line, '=');
+        if (eq == NULL)
+            continue;
+        *eq = '\0';
+        line[strcspn(line, " \t")] = '\0';
+        eq[1 + strcspn(&eq[1], "\r\n")] = '\0';
+        _sim_kv_add(base, &base_cnt, line, "%s", &eq[1]);
+    }
+    fclose(f);
+
+    for (int i = 0; i < ARRAY_SIZE(_sim_scenario_keys); i++)
+    {
+        const char *was = _sim_kv_find(base, base_cnt, _sim_scenario_keys[i]);
+        const char *now = _sim_kv_find(kv, cnt, _sim_scenario_keys[i]);
+        if ((was) && (now) && (strcmp(was, now)))
+            fprintf(stderr, "warning: %s was %s in %s (now %s), the runs are not comparable\n", _sim_scenario_keys[i], was, filename, now);
+    }
+
+    fprintf(stderr, "%-18s %12s %12s\n", "vs baseline", "was", "now");
+    for (int i = 0; i < ARRAY_SIZE(_sim_cost_keys); i++)
+    {
+        const char *was = _sim_kv_find(base, base_cnt, _sim_cost_keys[i]);
+        const char *now = _sim_kv_find(kv, cnt, _sim_cost_keys[i]);
+        if ((was == NULL) || (now == NULL))
+            continue;
+
+        double _was = strtod(was, NULL);
+        double _now = strtod(now, NULL);
+        bool worse = (_now > (_was + MAX(_was * tolerance_pct / 100.0, SIM_TOLERANCE_ABS)));
+        fprintf(stderr, "%-18s %12s %12s%s\n", _sim_cost_keys[i], was, now, worse? "   REGRESSION" : "");
+        if (worse)
+            regressions++;
+    }
+    return regressions;
+}
+
+void _sim_run(void)
+{
+    //The stubs jump back here once the time is up (or the game hangs)
+    if (setjmp(_clk.end) == 0)
+    {
+        _task.fn(_task.param);
+        fprintf(stderr, "The game task ended at %.3f s\n", (_clk.now_us - (SIM_START_MS * 1000ULL)) / 1000000.0);
+    }
+}
+
+void _sim_usage(const char * name)
+{
+    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "  -g, --game NAME|INDEX   The game to run (default Chaser)\n");
+    fprintf(stderr, "  -a, --arg ARG           A game argument, as on the console (up to %d)\n", SIM_GAME_ARGS_MAX);
+    fprintf(stderr, "  -n, --nodes N           The number of nodes (default %d)\n", SIM_NODES_DEF);
+    fprintf(stderr, "  -t, --time S            The time to play for (default %d s)\n", SIM_TIME_S_DEF);
+    fprintf(stderr, "  -s, --seed N            The random seed, for the game and the player (default 1)\n");
+    fprintf(stderr, "  -r, --react MIN[:MAX]   The player's reaction time (default %d:%d ms)\n", SIM_REACT_MIN_MS_DEF, SIM_REACT_MAX_MS_DEF);
+    fprintf(stderr, "  -m, --miss PCT          The rounds the player does not press at all (default 0)\n");
+    fprintf(stderr, "  -w, --wrong PCT         The presses on the wrong node (default 0)\n");
+    fprintf(stderr, "      --per-node          Presses every activated node on its own (several targets at once)\n");
+    fprintf(stderr, "  -b, --baud N            The bus baud rate (default %d)\n", SIM_BAUD_DEF);
+    fprintf(stderr, "      --lose SLOT@S       Takes the node in SLOT off the bus after S seconds\n");
+    fprintf(stderr, "      --record FILE       Writes the presses to FILE\n");
+    fprintf(stderr, "      --replay FILE       Presses as recorded in FILE (iso the player model)\n");
+    fprintf(stderr, "      --baseline FILE     Compares the report with FILE (a previous report)\n");
+    fprintf(stderr, "      --tolerance PCT     How much worse a cost may get (default %d)\n", SIM_TOLERANCE_PCT_DEF);
+    fprintf(stderr, "  -v, --verbose           Prints the console output of the game (stderr)\n");
+}
+
+/*******************************************************************************
+Global (public) Functions (the harness)
+*******************************************************************************/
+uint64_t sim_now_us(void)
+{
+    return _clk.now_us;
+}
+
+void sim_advance_us(uint64_t us)
+{
+    uint64_t target_us = _clk.now_us + us;
+    _sim_press_t *press;
+    int slot;
+
+    if ((_clk.lose_us != 0) && (target_us >= _clk.lose_us))
+    {
+        _clk.lose_us = 0;
+        if (sim_nodes_lose(_clk.lose_slot))
+            iprintln(trALWAYS, "#Node %d is off the bus", _clk.lose_slot);
+    }
+
+    while (((press = _sim_player_next(&slot)) != NULL) && (press->us <= target_us) && (press->us < _clk.end_us))
+    {
+        _clk.now_us = press->us;
+        press->us = 0;
+        _sim_player_press(press, (slot >= 0)? slot : sim_nodes_target());
+    }
+    _clk.now_us = target_us;
+
+    if (_clk.now_us >= _clk.end_us)
+    {
+        _clk.now_us = _clk.end_us;
+        longjmp(_clk.end, 1);
+    }
+}
+
+void sim_sample_add(sim_samples_t * samples, uint32_t value)
+{
+    if (samples->cnt >= samples->size)
+    {
+        samples->size = (samples->size > 0)? samples->size * 2 : 256;
+        samples->value = realloc(samples->value, samples->size * sizeof(uint32_t));
+    }
+    samples->value[samples->cnt++] = value;
+}
+
+void sim_round_start(void)
+{
+    if (_player.per_node)
+        return; //The rounds are counted per node (sim_node_activated())
+
+    if ((sim_stats.rounds > 0) && (!_player.round_pressed))
+        sim_stats.missed++;
+
+    sim_stats.rounds++;
+    _player.round_us = _clk.now_us;
+    _player.round_pressed = false;
+    _sim_player_schedule(&_player.press);
+}
+
+void sim_node_activated(int slot)
+{
+    if ((!_player.per_node) || (slot < 0) || (slot >= RGB_BTN_MAX_NODES))
+        return;
+
+    if ((_player.node_used[slot]) && (!_player.node_pressed[slot]))
+        sim_stats.missed++;
+
+    sim_stats.rounds++;
+    _player.node_used[slot] = true;
+    _player.node_pressed[slot] = false;
+    _sim_player_schedule(&_player.node_press[slot]);
+}
+
+void sim_node_removed(int slot)
+{
+    //The node's own press goes with it, and the ones above it move down a slot
+    for (int i = slot; i < (RGB_BTN_MAX_NODES - 1); i++)
+    {
+        _player.node_press[i] = _player.node_press[i + 1];
+        _player.node_pressed[i] = _player.node_pressed[i + 1];
+        _player.node_used[i] = _player.node_used[i + 1];
+    }
+    memset(&_player.node_press[RGB_BTN_MAX_NODES - 1], 0, sizeof(_sim_press_t));
+    _player.node_pressed[RGB_BTN_MAX_NODES - 1] = false;
+    _player.node_used[RGB_BTN_MAX_NODES - 1] = false;
+}
+
+void sim_press_detected(int slot, uint64_t press_us)
+{
+    sim_sample_add(&sim_stats.detect_ms, (uint32_t)((_clk.now_us - press_us) / 1000));
+}
+
+/*******************************************************************************
+Global (public) Functions (the platform, on the virtual clock)
+*******************************************************************************/
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)_clk.now_us;
+}
+
+uint32_t esp_random(void)
+{
+    //xorshift32, a different sequence from the player's
+    _clk.rnd ^= _clk.rnd << 13;
+    _clk.rnd ^= _clk.rnd >> 17;
+    _clk.rnd ^= _clk.rnd << 5;
+    return _clk.rnd;
+}
+
+uint64_t sys_poll_tmr_ms(void)
+{
+    return _clk.now_us / 1000;
+}
+
+uint64_t sys_poll_tmr_seconds(void)
+{
+    return _clk.now_us / 1000000;
+}
+
+void sys_stopwatch_ms_start(Stopwatch_ms_t* sw, uint32_t max_time)
+{
+    sw->tick_start = (uint32_t)sys_poll_tmr_ms();
+    sw->max_time = max_time;
+    sw->running = true;
+    sw->max_time_reached = false;
+}
+
+uint32_t sys_stopwatch_ms_lap(Stopwatch_ms_t* sw)
+{
+    uint32_t elapsed = (sw->running)? (uint32_t)sys_poll_tmr_ms() - sw->tick_start : 0;
+
+    if ((sw->running) && (sw->max_time > 0) && (elapsed >= sw->max_time))
+    {
+        sw->max_time_reached = true;
+        return sw->max_time;
+    }
+    return elapsed;
+}
+
+uint32_t sys_stopwatch_ms_stop(Stopwatch_ms_t* sw)
+{
+    uint32_t elapsed = sys_stopwatch_ms_lap(sw);
+    sw->running = false;
+    return elapsed;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char * name, configSTACK_DEPTH_TYPE stack_depth, void * param, UBaseType_t priority, TaskHandle_t * handle)
+{
+    //Only the game task, which main() runs once the game has started
+    _task.fn = fn;
+    _task.param = param;
+    if (handle)
+        *handle = (TaskHandle_t)&_task;
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t handle) {}
+void vTaskSuspend(TaskHandle_t handle) {}
+void vTaskResume(TaskHandle_t handle) {}
+
+void vTaskDelay(TickType_t ticks)
+{
+    sim_advance_us((uint64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(_clk.now_us / (portTICK_PERIOD_MS * 1000));
+}
+
+configSTACK_DEPTH_TYPE uxTaskGetStackHighWaterMark2(TaskHandle_t handle)
+{
+    return 0;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t queue = calloc(1, sizeof(struct sim_queue_t));
+    queue->buff = calloc(length, item_size);
+    queue->len = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void * item, TickType_t wait)
+{
+    //There is no other task to make room, so we never wait
+    if (queue->cnt >= queue->len)
+        return pdFALSE;
+
+    memcpy(&queue->buff[((queue->head + queue->cnt) % queue->len) * queue->item_size], item, queue->item_size);
+    queue->cnt++;
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void * item, TickType_t wait)
+{
+    if (_clk.now_us == _clk.last_us)
+    {
+        if (++_clk.stall_cnt > SIM_STALL_MAX)
+        {
+            _clk.stalled = true;
+            longjmp(_clk.end, 1);
+        }
+    }
+    else
+        _clk.stall_cnt = 0;
+    _clk.last_us = _clk.now_us;
+
+    if (queue->cnt == 0)
+    {
+        //Nothing can arrive while we wait (the presses are only found when the game reads the nodes)
+        sim_advance_us((uint64_t)wait * portTICK_PERIOD_MS * 1000);
+        return pdFALSE;
+    }
+
+    memcpy(item, &queue->buff[queue->head * queue->item_size], queue->item_size);
+    queue->head = (queue->head + 1) % queue->len;
+    queue->cnt--;
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    queue->head = 0;
+    queue->cnt = 0;
+    return pdPASS;
+}
+
+static void _sim_console_vprint(uint8_t traceflags, const char * tag, const char * fmt, va_list args, bool line)
+{
+    if (!_clk.verbose)
+        return;
+
+    if (line)
+    {
+        fprintf(stderr, "%9.3f ", _clk.now_us / 1000000.0);
+        if ((fmt[0] == '#') || (fmt[0] == '!'))
+            fprintf(stderr, "%s%s: ", tag, (fmt[0] == '!')? " ERROR" : "");
+        if ((fmt[0] == '#') || (fmt[0] == '!'))
+            fmt++;
+    }
+    vfprintf(stderr, fmt, args);
+    if (line)
+        fputc('\n', stderr);
+}
+
+void console_printline(uint8_t traceflags, const char * tag, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    _sim_console_vprint(traceflags, tag, fmt, args, true);
+    va_end(args);
+}
+
+void console_print(uint8_t traceflags, const char * tag, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    _sim_console_vprint(traceflags, tag, fmt, args, false);
+    va_end(args);
+}
+
+void console_trace(uint8_t traceflags, const char * tag, const char *fmt, const uint32_t *args, size_t cnt)
+{
+    uint32_t a[CONSOLE_TRACE_ARGS_MAX] = {0};
+
+    if (!_clk.verbose)
+        return;
+
+    memcpy(a, args, MIN(cnt, CONSOLE_TRACE_ARGS_MAX) * sizeof(uint32_t));
+    console_printline(traceflags, tag, fmt, a[0], a[1], a[2], a[3]);
+}
+
+int metrics_add(const char * _group_name, const metric_item_t * _tbl, size_t _cnt)
+{
+    for (int i = 0; i < _sim_metric_cnt; i++)
+        if (_sim_metrics[i].tbl == _tbl)
+            return 0;
+    if (_sim_metric_cnt >= SIM_METRIC_GROUPS_MAX)
+        return 0;
+
+    _sim_metrics[_sim_metric_cnt].name = _group_name;
+    _sim_metrics[_sim_metric_cnt].tbl = _tbl;
+    _sim_metrics[_sim_metric_cnt].cnt = _cnt;
+    _sim_metric_cnt++;
+    return (int)_cnt;
+}
+
+void metric_hist_add(metric_hist_t * hist, uint32_t value)
+{
+    int i = 0;
+
+    while ((i < (METRIC_HIST_BUCKETS - 1)) && (value > hist->bounds[i]))
+        i++;
+    hist->bucket[i]++;
+
+    if ((hist->cnt == 0) || (value < hist->min))
+        hist->min = value;
+    if (value > hist->max)
+        hist->max = value;
+    hist->cnt++;
+    hist->sum += value;
+}
+
+bool telemetry_enabled(void)
+{
+    return false;
+}
+
+void telemetry_record(tlm_type_t type, const uint32_t * fields, int cnt) {}
+
+void rstats_session_start(int game) {}
+
+void rstats_session_end(void) {}
+
+void rstats_add(int player, int slot, uint32_t reaction_ms) {}
+
+/*******************************************************************************
+main
+*******************************************************************************/
+int main(int argc, char * argv[])
+{
+    static const struct option long_opts[] = {
+        {"game",        required_argument,  NULL, 'g'},
+        {"arg",         required_argument,  NULL, 'a'},
+        {"nodes",       required_argument,  NULL, 'n'},
+        {"time",        required_argument,  NULL, 't'},
+        {"seed",        required_argument,  NULL, 's'},
+        {"react",       required_argument,  NULL, 'r'},
+        {"miss",        required_argument,  NULL, 'm'},
+        {"wrong",       required_argument,  NULL, 'w'},
+        {"per-node",    no_argument,        NULL, 'N'},
+        {"baud",        required_argument,  NULL, 'b'},
+        {"record",      required_argument,  NULL, 'R'},
+        {"replay",      required_argument,  NULL, 'P'},
+        {"baseline",    required_argument,  NULL, 'B'},
+        {"tolerance",   required_argument,  NULL, 'T'},
+        {"lose",        required_argument,  NULL, 'L'},
+        {"verbose",     no_argument,        NULL, 'v'},
+        {"help",        no_argument,        NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    const char * game_str = "Chaser";
+    const char * game_args[SIM_GAME_ARGS_MAX];
+    int game_arg_cnt = 0;
+    int nodes = SIM_NODES_DEF;
+    uint32_t time_s = SIM_TIME_S_DEF;
+    uint32_t seed = 1;
+    uint32_t baud = SIM_BAUD_DEF;
+    const char * record = NULL;
+    const char * replay = NULL;
+    const char * baseline = NULL;
+    double tolerance_pct = SIM_TOLERANCE_PCT_DEF;
+    uint32_t lose_s = 0;
+    int game = -1;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "g:a:n:t:s:r:m:w:b:vh", long_opts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'g': game_str = optarg; break;
+            case 'a':
+                if (game_arg_cnt < SIM_GAME_ARGS_MAX)
+                    game_args[game_arg_cnt++] = optarg;
+                break;
+            case 'n': nodes = atoi(optarg); break;
+            case 't': time_s = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 's': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'r':
+                if (sscanf(optarg, "%u:%u", &_player.react_min_ms, &_player.react_max_ms) == 1)
+                    _player.react_max_ms = _player.react_min_ms;
+                break;
+            case 'm': _player.miss_pct = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'w': _player.wrong_pct = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'N': _player.per_node = true; break;
+            case 'b': baud = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'R': record = optarg; break;
+            case 'P': replay = optarg; break;
+            case 'B': baseline = optarg; break;
+            case 'T': tolerance_pct = strtod(optarg, NULL); break;
+            case 'L':
+                if ((sscanf(optarg, "%d@%u", &_clk.lose_slot, &lose_s) != 2) || (lose_s == 0))
+                    lose_s = UINT32_MAX; //Invalid
+                break;
+            case 'v': _clk.verbose = true; break;
+            case 'h':
+            default:
+                _sim_usage(argv[0]);
+                return (opt == 'h')? 0 : 1;
+        }
+    }
+
+    for (int i = 0; i < games_cnt(); i++)
+        if ((!strcasecmp(game_str, game_name(i))) || ((game_str[0] >= '0') && (game_str[0] <= '9') && (atoi(game_str) == i)))
+            game = i;
+
+    if ((game < 0) || (nodes < 1) || (nodes > RGB_BTN_MAX_NODES) || (time_s == 0) || (baud == 0) || (_player.react_max_ms < _player.react_min_ms) ||
+        ((lose_s != 0) && ((lose_s >= time_s) || (_clk.lose_slot < 0) || (_clk.lose_slot >= nodes))))
+    {
+        fprintf(stderr, "Invalid settings\n");
+        _sim_usage(argv[0]);
+        return 1;
+    }
+    if ((replay) && (!_sim_replay_load(replay)))
+    {
+        fprintf(stderr, "Could not read %s\n", replay);
+        return 1;
+    }
+    if ((record) && ((_player.record = fopen(record, "w")) == NULL))
+    {
+        fprintf(stderr, "Could not write %s\n", record);
+        return 1;
+    }
+    if (_player.record)
+        fprintf(_player.record, "# game_sim presses (%s, %d nodes, seed %u): <round> <slot> <delay_ms>\n", game_name(game), nodes, seed);
+
+    _clk.now_us = SIM_START_MS * 1000ULL;
+    _clk.end_us = _clk.now_us + (time_s * 1000000ULL);
+    _clk.lose_us = (lose_s != 0)? _clk.now_us + (lose_s * 1000000ULL) : 0;
+    _clk.rnd = (seed != 0)? seed : 1;
+    _player.rnd = _clk.rnd ^ 0x9E3779B9;
+    sim_nodes_init(nodes, baud);
+
+    if ((game_arg_cnt > 0) && (!game_parse_args(game, game_args, game_arg_cnt)))
+        return 1;
+
+    if ((game_start(game) == NULL) || (_task.fn == NULL))
+    {
+        fprintf(stderr, "Could not start %s\n", game_name(game));
+        return 1;
+    }
+
+    _sim_run();
+    if (_clk.stalled)
+    {
+        fprintf(stderr, "The game is not moving the clock on (stuck at %.3f s)\n", (_clk.now_us - (SIM_START_MS * 1000ULL)) / 1000000.0);
+        return 1;
+    }
+    if (_player.record)
+        fclose(_player.record);
+
+    //The report
+    _sim_kv_t kv[SIM_KV_MAX];
+    int kv_cnt = 0;
+    uint32_t tx = sim_stats.tx_direct + sim_stats.tx_bcst;
+
+    _sim_kv_add(kv, &kv_cnt, "game", "%s", game_name(game));
+    _sim_kv_add(kv, &kv_cnt, "nodes", "%d", nodes);
+    _sim_kv_add(kv, &kv_cnt, "time_s", "%u", time_s);
+    _sim_kv_add(kv, &kv_cnt, "seed", "%u", seed);
+    _sim_kv_add(kv, &kv_cnt, "replay", "%s", (replay)? replay : "-");
+    _sim_kv_add(kv, &kv_cnt, "rounds", "%u", sim_stats.rounds);
+    _sim_kv_add(kv, &kv_cnt, "presses", "%u", sim_stats.presses);
+    _sim_kv_add(kv, &kv_cnt, "wrong", "%u", sim_stats.wrong);
+    _sim_kv_add(kv, &kv_cnt, "missed", "%u", sim_stats.missed);
+    _sim_kv_add(kv, &kv_cnt, "strays", "%u", sim_stats.strays);
+    _sim_kv_add(kv, &kv_cnt, "lost", "%u", sim_stats.lost);
+    _sim_kv_add(kv, &kv_cnt, "poll_missed", "%u", sim_stats.poll_missed);
+    _sim_kv_add(kv, &kv_cnt, "view_errors", "%u", sim_stats.view_errors);
+    _sim_kv_add(kv, &kv_cnt, "tx_failed", "%u", sim_stats.tx_failed);
+    _sim_kv_add(kv, &kv_cnt, "tx_direct", "%u", sim_stats.tx_direct);
+    _sim_kv_add(kv, &kv_cnt, "tx_bcst", "%u", sim_stats.tx_bcst);
+    _sim_kv_add(kv, &kv_cnt, "tx_per_round", "%.2f", (sim_stats.rounds > 0)? (double)tx / sim_stats.rounds : 0.0);
+    _sim_kv_add(kv, &kv_cnt, "tx_per_s", "%.2f", (double)tx / time_s);
+    _sim_kv_add(kv, &kv_cnt, "bus_util_pct", "%.2f", (sim_stats.bus_busy_us * 100.0) / (time_s * 1000000.0));
+    _sim_kv_add_samples(kv, &kv_cnt, "detect_ms", &sim_stats.detect_ms);
+    _sim_kv_add_samples(kv, &kv_cnt, "feedback_ms", &sim_stats.feedback_ms);
+    for (int g = 0; g < _sim_metric_cnt; g++)
+    {
+        for (size_t i = 0; i < _sim_metrics[g].cnt; i++)
+        {
+            const metric_item_t *item = &_sim_metrics[g].tbl[i];
+            char key[32];
+            if (item->type == metric_hist)
+            {
+                metric_hist_t *hist = (metric_hist_t *)item->data;
+                snprintf(key, sizeof(key), "%s.%s_avg", _sim_metrics[g].name, item->name);
+                _sim_kv_add(kv, &kv_cnt, key, "%.1f", (hist->cnt > 0)? (double)hist->sum / hist->cnt : 0.0);
+                snprintf(key, sizeof(key), "%s.%s_max", _sim_metrics[g].name, item->name);
+                _sim_kv_add(kv, &kv_cnt, key, "%u", hist->max);
+            }
+            else if (item->type == metric_gauge)
+            {
+                snprintf(key, sizeof(key), "%s.%s_max", _sim_metrics[g].name, item->name);
+                _sim_kv_add(kv, &kv_cnt, key, "%u", ((metric_gauge_t *)item->data)->max);
+            }
+            else
+            {
+                snprintf(key, sizeof(key), "%s.%s", _sim_metrics[g].name, item->name);
+                _sim_kv_add(kv, &kv_cnt, key, "%u", *(uint32_t *)item->data);
+            }
+        }
+    }
+
+    for (int i = 0; i < kv_cnt; i++)
+        printf("%s=%s\n", kv[i].key, kv[i].value);
+
+    if (baseline)
+    {
+        int regressions = _sim_baseline_check(baseline, kv, kv_cnt, tolerance_pct);
+        if (regressions < 0)
+        {
+            fprintf(stderr, "Could not read %s\n", baseline);
+            return 1;
+        }
+        if (regressions > 0)
+        {
+            fprintf(stderr, "%d regression(s) against %s\n", regressions, baseline);
+            return 2;
+        }
+        fprintf(stderr, "No regressions against %s\n", baseline);
+    }
+    if ((sim_stats.poll_missed > 0) || (sim_stats.view_errors > 0))
+    {
+        fprintf(stderr, "The master and the nodes do not agree on the slots (%u missed in a poll, %u view errors)\n",
+                sim_stats.poll_missed, sim_stats.view_errors);
+        return 3;
+    }
+    return 0;
+}
+
+#undef PRINTF_TAG
+/*************************** END OF FILE *************************************/
@@ -0,0 +1,139 @@
+/*****************************************************************************
+
+game_sim.h
+
+Include file for game_sim.c and sim_nodes.c (the host game harness)
+
+The virtual clock, the bus accounting and the player hooks shared by the
+harness (game_sim.c) and the simulated nodes (sim_nodes.c).
+
+******************************************************************************/
+#ifndef __game_sim_H__
+#define __game_sim_H__
+
+/******************************************************************************
+includes
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/******************************************************************************
+Macros
+******************************************************************************/
+#define SIM_START_MS            (1000)      /* The virtual clock starts here (a game timer at 0 means "stopped") */
+#define SIM_NODES_DEF           (6)
+#define SIM_BAUD_DEF            (115200)    /* COMMS_BAUD_RATE */
+#define SIM_TURNAROUND_US       (1000)      /* From the end of a msg to the start of the node's response */
+#define SIM_BCST_GAP_US         (200)       /* Bus idle time after a broadcast */
+
+/******************************************************************************
+Struct & Unions
+******************************************************************************/
+typedef struct
+{
+    uint32_t * value;
+    size_t cnt;
+    size_t size;
+} sim_samples_t;
+
+typedef struct
+{
+    uint32_t tx_direct;         // Msgs sent to a single node (and answered, or not)
+    uint32_t tx_bcst;           // Broadcasts (incl. scatter frames)
+    uint32_t tx_failed;         // Direct msgs the node did not answer
+    uint32_t bus_bytes;         // Bytes on the bus (both directions)
+    uint64_t bus_busy_us;       // Time the bus was in use
+    uint32_t rounds;            // The number of times the nodes went from all inactive to (some) active
+    uint32_t presses;           // Presses on an active node
+    uint32_t wrong;             // ... of which the player chose the wrong node (model only)
+    uint32_t missed;            // Rounds without a press
+    uint32_t strays;            // Presses on a node which was not active (any more)
+    uint32_t lost;              // Nodes the master gave up on (and deregistered)
+    uint32_t poll_missed;       // Nodes on the bus which did not answer a reaction poll they were in
+    uint32_t view_errors;       // LED colours the master knows, which are not what the node shows (per msg)
+    sim_samples_t detect_ms;    // Press to the game getting it (the poll that read the reaction time)
+    sim_samples_t feedback_ms;  // Press to the end of the first msg changing a LED after the press was read
+} sim_stats_t;
+
+/******************************************************************************
+Global (public) variables
+******************************************************************************/
+extern sim_stats_t sim_stats;
+
+/******************************************************************************
+Global (public) function definitions
+******************************************************************************/
+
+/*! \brief The virtual time
+ * \return The time in us since the start of the simulation (starts at SIM_START_MS)
+ */
+uint64_t sim_now_us(void);
+
+/*! \brief Moves the virtual clock on, pressing the buttons that are due on the way.
+ * Jumps back to the harness once the simulated time is up (does not return then).
+ * \param us The time to move on by
+ */
+void sim_advance_us(uint64_t us);
+
+/*! \brief Adds a sample to a list
+ */
+void sim_sample_add(sim_samples_t * samples, uint32_t value);
+
+/*! \brief Called by the nodes when the first node is activated after all of them were inactive
+ */
+void sim_round_start(void);
+
+/*! \brief Called by the nodes when a node's button is activated (the start of a round with --per-node)
+ * \param slot The node
+ */
+void sim_node_activated(int slot);
+
+/*! \brief Called by the nodes when the master deregistered a node (the ones above it move down a slot)
+ * \param slot The node
+ */
+void sim_node_removed(int slot);
+
+/*! \brief Called by the nodes when the game read a press (the first step in the feedback)
+ * \param slot The node
+ * \param press_us When the button was pressed
+ */
+void sim_press_detected(int slot, uint64_t press_us);
+
+/*! \brief Sets up the simulated nodes (nothing is registered until nodes_register_all() or nodes_register_warm())
+ * \param cnt The number of nodes (1 to RGB_BTN_MAX_NODES)
+ * \param baud The bus baud rate (for the bus time of each msg)
+ */
+void sim_nodes_init(int cnt, uint32_t baud);
+
+/*! \brief Presses the button of a node, now
+ * \param slot The node
+ * \return true if the node was active (and latched the reaction time), false for a stray press
+ */
+bool sim_nodes_press(int slot);
+
+/*! \brief Finds the node the player should press
+ * \return The active node showing green as its 3rd colour (or the 1st active node if none), -1 if none is active
+ */
+int sim_nodes_target(void);
+
+/*! \brief Picks any active node other than the target (for a wrong press)
+ * \param target The node not to pick
+ * \param rnd A random number
+ * \return The node, or target if there is no other active node
+ */
+int sim_nodes_other(int target, uint32_t rnd);
+
+/*! \brief The number of nodes with their button active (as the nodes see it)
+ */
+int sim_nodes_active_cnt(void);
+
+/*! \brief Takes a node off the bus (e.g. a flat battery): it answers nothing from now on
+ * \param slot The node
+ * \return true if it was there to lose
+ */
+bool sim_nodes_lose(int slot);
+
+#endif /* __game_sim_H__ */
+
+/****************************** END OF FILE **********************************/
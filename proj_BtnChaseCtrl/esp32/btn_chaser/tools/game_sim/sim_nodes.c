@@ -0,0 +1,1098 @@
+/*******************************************************************************
+
+Module:     sim_nodes.c
+Purpose:    This file contains the simulated nodes (buttons) of the host game harness
+Author:     Rudolph van Niekerk
+
+This is the nodes.h API the games use, without a bus: every msg takes as long
+as its bytes would at the bus baud rate (plus the node's turnaround for direct
+msgs) on the virtual clock, and always gets through.
+
+Each node is kept twice: what the master knows of it (btn, known, active and
+the targets, as in nodes.c) and what the node itself is doing (hw). A press
+only changes the hw side (the node latches the reaction time and deactivates
+itself), the game only finds out when it reads the reaction time.
+
+nodes_target_flush() follows the same rules as the one in nodes.c, so the
+msg counts are those the controller would send... keep the two in step.
+
+A node can drop off the bus (sim_nodes_lose()): from then on it answers
+nothing, and the master gives up on it and deregisters it as nodes.c does,
+moving the nodes above it down a slot. Each node keeps the slot it was told
+(its bit in a masked broadcast) and only acts on the broadcasts with that bit
+set, so a node the master did not tell about its new slot shows up as
+poll_missed (the master polled the slot, nobody answered) or as view_errors
+(the master's view of a node's LEDs is not what the node shows).
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "sys_utils.h"
+#include "sys_timers.h"
+#include "task_console.h"
+#include "task_game.h"
+#include "colour.h"
+
+/* The command table lives with the nodes (as in nodes.c) */
+#define __NOT_EXTERN__
+#include "../../../../../common/common_comms.h"
+#undef __NOT_EXTERN__
+#include "nodes.h"
+
+#include "game_sim.h"
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#ifdef PRINTF_TAG
+#undef PRINTF_TAG
+#endif
+#define PRINTF_TAG ("SimNodes") /* This must be undefined at the end of the file*/
+
+/* The same as in nodes.c */
+#define NODE_FIELD_RGB_0         BIT_POS(0)
+#define NODE_FIELD_RGB_1         BIT_POS(1)
+#define NODE_FIELD_RGB_2         BIT_POS(2)
+#define NODE_FIELD_BLINK         BIT_POS(3)
+#define NODE_FIELD_ACTIVE        BIT_POS(4) // Always sent directly, never broadcast
+#define NODE_FLUSH_BCST_MIN      (2)
+#define NODE_RETRY_BUDGET_MS     (3000)
+#define RTO_MIN_MS               (20)
+#define RTO_MAX_MS               (500)
+
+#define SIM_ADDR_FIRST           (0x10)     /* The address given to the 1st node */
+
+/*******************************************************************************
+local defines
+ *******************************************************************************/
+typedef struct
+{
+    master_command_t cmd;
+    uint32_t value;
+} sim_cmd_t;
+
+typedef struct
+{
+    sim_cmd_t cmd[NODE_CMD_CNT_MAX];
+    int cnt;
+    size_t len;             // The data bytes of the msg
+} sim_msg_t;
+
+typedef struct
+{
+    uint32_t rgb_colour[3];
+    uint32_t blink_ms;
+    bool active;
+    uint8_t wanted;
+} sim_target_t;
+
+typedef struct
+{
+    uint8_t address;
+    /* What the master knows */
+    button_t btn;
+    bool active;
+    uint8_t known;
+    sim_target_t target;
+    sim_msg_t msg;
+    bool reindex;               // Moved down a slot, but not told yet
+    /* What the node is doing */
+    struct {
+        int slot;               // The slot it was told (cmd_set_bitmask_index)
+        bool lost;              // Off the bus (answers nothing)
+        uint32_t rgb_colour[3];
+        uint32_t blink_ms;
+        bool active;
+        uint64_t active_us;     // When the button was activated
+        uint64_t press_us;      // When it was pressed (0 if not since it was activated)
+        uint32_t reaction_ms;
+    } hw;
+} sim_node_t;
+
+/*******************************************************************************
+local function prototypes
+ *******************************************************************************/
+
+/*! \brief Moves the clock on by the time a msg takes on the bus, and counts it
+ * \param data_len The data bytes in the msg (excl. the header and CRC)
+ * \param resp_len The data bytes in the response (-1 for a broadcast)
+ */
+void _sim_bus_msg(size_t data_len, int resp_len);
+
+/*! \brief Moves the clock on by the time a node's msg takes on the bus (one not in response to a direct msg, e.g. 
+ * in its slot of a reaction poll)
+ * \param data_len The data bytes in the msg (excl. the header and CRC)
+ */
+void _sim_bus_node_msg(size_t data_len);
+
+/*! \brief Applies a set command on the node (hw) side
+ * \return true if it changed what the LED shows (or the button state)
+ */
+bool _sim_node_apply(int slot, master_command_t cmd, uint32_t value);
+
+/*! \brief The master's view of a node after a set command got through
+ */
+void _sim_view_update(int slot, master_command_t cmd, uint32_t value);
+
+/*! \brief Checks if the nodes went from all inactive to (some) active, or if the game has shown a reaction to a press
+ * \param led_changed true if the msg changed what a LED shows
+ */
+void _sim_msg_done(int active_before, bool led_changed);
+
+/*! \brief The master's side of a reaction time read (as _reaction_update() in nodes.c)
+ */
+void _sim_reaction_update(int slot);
+
+/*! \brief Checks that the master's view of the LED colours matches what the nodes show (counts view_errors)
+ */
+void _sim_view_check(void);
+
+/*! \brief Checks if a node acts on a masked broadcast (by the slot it was told, which is not the master's if it was
+ * not told that it moved)
+ * \param slot The node (the master's slot)
+ * \param mask The broadcast's address mask
+ */
+bool _sim_node_in_mask(int slot, uint32_t mask);
+
+/*! \brief The rank of a node in a masked broadcast (its place in a scatter frame or a reaction poll)
+ * \param mask The broadcast's address mask
+ * \param bit The bit (slot) of the node
+ */
+int _sim_mask_rank(uint32_t mask, int bit);
+
+/*! \brief A direct msg to a lost node: resent (with the backoff of nodes.c) until the retry budget runs out, after
+ * which the node is deregistered
+ * \param slot The node
+ */
+void _sim_node_lost_msg(int slot);
+
+/*! \brief Removes a node, and moves the ones above it down a slot (as _deregister_node() in nodes.c)
+ * \param slot The node
+ */
+void _sim_deregister(int slot);
+
+/*! \brief Tells the nodes which moved down a slot about their new slot (as _nodes_reindex() in nodes.c)
+ * \return true if all of them got it, false if one was lost (and deregistered) on the way
+ */
+bool _sim_reindex(void);
+
+static bool _sim_node_msg_append(uint8_t node, master_command_t cmd, uint32_t value);
+
+uint8_t _sim_target_dirty(int slot);
+uint32_t _sim_target_value(int slot, uint8_t field);
+bool _sim_bcst_append(master_command_t cmd, uint32_t value);
+void _sim_init_bcst_mask(uint32_t mask);
+uint32_t _sim_inactive_mask(void);
+int _sim_apply_state(uint32_t mask, const node_state_t * state, int dbg_led);
+
+/*******************************************************************************
+local variables
+ *******************************************************************************/
+struct {
+    sim_node_t list[RGB_BTN_MAX_NODES];
+    int cnt;                // Registered nodes
+    int sim_cnt;            // Nodes on the (virtual) bus
+    uint32_t baud;
+    int press_pending;      // The node whose press was read, until the game changes a LED (-1 if none)
+    bool bcst_active;       // nodes_target_bcst_active()
+} _sim = {.press_pending = -1};
+
+struct {
+    sim_msg_t msg;
+    uint32_t mask;
+} _bcst;
+
+/*******************************************************************************
+Local (private) Functions
+*******************************************************************************/
+void _sim_bus_msg(size_t data_len, int resp_len)
+{
+    size_t bytes = sizeof(comms_msg_hdr_t) + data_len + sizeof(uint8_t);
+    uint64_t us = SIM_BCST_GAP_US;
+
+    if (resp_len >= 0)
+    {
+        bytes += sizeof(comms_msg_hdr_t) + (size_t)resp_len + sizeof(uint8_t);
+        us = SIM_TURNAROUND_US;
+        sim_stats.tx_direct++;
+    }
+    else
+        sim_stats.tx_bcst++;
+
+    //8N1: 10 bits per byte
+    us += ((uint64_t)bytes * 10 * 1000000) / _sim.baud;
+    sim_stats.bus_bytes += bytes;
+    sim_stats.bus_busy_us += us;
+    sim_advance_us(us);
+}
+
+void _sim_bus_node_msg(size_t data_len)
+{
+    size_t bytes = sizeof(comms_msg_hdr_t) + data_len + sizeof(uint8_t);
+    uint64_t us = ((uint64_t)bytes * 10 * 1000000) / _sim.baud;
+
+    sim_stats.bus_bytes += bytes;
+    sim_stats.bus_busy_us += us;
+    sim_advance_us(us);
+}
+
+bool _sim_node_apply(int slot, master_command_t cmd, uint32_t value)
+{
+    sim_node_t *node = &_sim.list[slot];
+
+    switch (cmd)
+    {
+        case cmd_set_rgb_0:
+        case cmd_set_rgb_1:
+        case cmd_set_rgb_2:
+            if (node->hw.rgb_colour[cmd - cmd_set_rgb_0] == (value & 0x00FFFFFF))
+                return false;
+            node->hw.rgb_colour[cmd - cmd_set_rgb_0] = (value & 0x00FFFFFF);
+            return true;
+        case cmd_set_blink:
+            if (node->hw.blink_ms == value)
+                return false;
+            node->hw.blink_ms = value;
+            return true;
+        case cmd_set_switch:
+            if (node->hw.active == (value == CMD_SW_PAYLOAD_ACTIVATE))
+                return false;
+            node->hw.active = (value == CMD_SW_PAYLOAD_ACTIVATE);
+            if (node->hw.active)
+            {
+                node->hw.active_us = sim_now_us();
+                node->hw.press_us = 0;
+                node->hw.reaction_ms = 0;
+                sim_node_activated(slot);
+            }
+            return true;
+        case cmd_set_bitmask_index:
+            node->hw.slot = (int)value;
+            return false;
+        default:
+            return false;
+    }
+}
+
+void _sim_view_update(int slot, master_command_t cmd, uint32_t value)
+{
+    sim_node_t *node = &_sim.list[slot];
+
+    switch (cmd)
+    {
+        case cmd_set_rgb_0:
+        case cmd_set_rgb_1:
+        case cmd_set_rgb_2:
+            node->btn.rgb_colour[cmd - cmd_set_rgb_0] = (value & 0x00FFFFFF);
+            node->known |= (NODE_FIELD_RGB_0 << (cmd - cmd_set_rgb_0));
+            break;
+        case cmd_set_blink:
+            node->btn.blink_ms = value;
+            node->known |= NODE_FIELD_BLINK;
+            break;
+        case cmd_set_switch:
+            node->known |= NODE_FIELD_ACTIVE;
+            break;
+        default:
+            break;
+    }
+}
+
+void _sim_msg_done(int active_before, bool led_changed)
+{
+    _sim_view_check();
+
+    if ((active_before == 0) && (sim_nodes_active_cnt() > 0))
+        sim_round_start();
+
+    if ((led_changed) && (_sim.press_pending >= 0))
+    {
+        sim_sample_add(&sim_stats.feedback_ms, (uint32_t)((sim_now_us() - _sim.list[_sim.press_pending].hw.press_us) / 1000));
+        _sim.press_pending = -1;
+    }
+}
+
+void _sim_reaction_update(int slot)
+{
+    sim_node_t *n = &_sim.list[slot];
+
+    n->btn.reaction_ms = n->hw.reaction_ms;
+    if ((n->btn.reaction_ms != 0) && (n->active))
+    {
+        game_event_post(game_evt_press, slot, n->btn.reaction_ms);
+        sim_press_detected(slot, n->hw.press_us);
+        _sim.press_pending = slot;
+        n->active = false;
+        n->btn.blink_ms = 0;
+        n->known |= (NODE_FIELD_ACTIVE | NODE_FIELD_BLINK);
+        n->known &= ~NODE_FIELD_RGB_0;
+        n->target.active = false;
+        n->target.blink_ms = 0;
+    }
+}
+
+void _sim_view_check(void)
+{
+    for (int i = 0; i < _sim.cnt; i++)
+    {
+        sim_node_t *n = &_sim.list[i];
+        for (int c = 0; c < 3; c++)
+            if ((!n->hw.lost) && (n->known & (NODE_FIELD_RGB_0 << c)) && (n->btn.rgb_colour[c] != n->hw.rgb_colour[c]))
+                sim_stats.view_errors++;
+    }
+}
+
+bool _sim_node_in_mask(int slot, uint32_t mask)
+{
+    return (!_sim.list[slot].hw.lost) && ((mask & BIT_POS(_sim.list[slot].hw.slot)) != 0);
+}
+
+int _sim_mask_rank(uint32_t mask, int bit)
+{
+    return __builtin_popcount(mask & (BIT_POS(bit) - 1));
+}
+
+void _sim_node_lost_msg(int slot)
+{
+    sim_node_t *n = &_sim.list[slot];
+    size_t bytes = sizeof(comms_msg_hdr_t) + n->msg.len + sizeof(uint8_t);
+    uint32_t rto_ms = RTO_MIN_MS;
+
+    //Nothing comes back, so each try costs the msg and an RTO (doubled every time)
+    for (uint32_t spent_ms = 0; spent_ms < NODE_RETRY_BUDGET_MS; spent_ms += rto_ms, rto_ms = MIN(rto_ms * 2, RTO_MAX_MS))
+    {
+        uint64_t us = ((uint64_t)bytes * 10 * 1000000) / _sim.baud;
+        sim_stats.tx_direct++;
+        sim_stats.tx_failed++;
+        sim_stats.bus_bytes += bytes;
+        sim_stats.bus_busy_us += us;
+        sim_advance_us(us + (rto_ms * 1000ULL));
+    }
+    n->msg.cnt = 0;
+    n->msg.len = 0;
+    _sim_deregister(slot);
+}
+
+void _sim_deregister(int slot)
+{
+    game_event_post(game_evt_node_lost, slot, _sim.list[slot].address);
+    sim_node_removed(slot);
+    sim_stats.lost++;
+
+    memmove(&_sim.list[slot], &_sim.list[slot + 1], (_sim.cnt - slot - 1) * sizeof(sim_node_t));
+    _sim.cnt--;
+    _sim.sim_cnt--;
+    memset(&_sim.list[_sim.cnt], 0, sizeof(sim_node_t));
+
+    //Same as nodes.c: the ones above it are told about their new slot before the next masked broadcast
+    for (int i = slot; i < _sim.cnt; i++)
+    {
+        _sim.list[i].reindex = true;
+        _sim.list[i].known = 0;
+    }
+
+    if (_sim.press_pending == slot)
+        _sim.press_pending = -1;
+    else if (_sim.press_pending > slot)
+        _sim.press_pending--;
+}
+
+bool _sim_reindex(void)
+{
+    int cnt = _sim.cnt;
+
+    for (int i = 0; i < _sim.cnt; i++)
+    {
+        if (!_sim.list[i].reindex)
+            continue;
+
+        _sim.list[i].reindex = false;
+        init_node_msg(i);
+        _sim_node_msg_append(i, cmd_set_bitmask_index, i);
+        if ((!node_msg_tx_now(i)) && (_sim.cnt < cnt))
+            i = -1; //Lost on the way, so the ones above it have moved again
+    }
+    return (_sim.cnt == cnt);
+}
+
+uint8_t _sim_target_dirty(int slot)
+{
+    uint8_t dirty = 0;
+    sim_node_t *node = &_sim.list[slot];
+
+    for (int i = 0; i < 3; i++)
+        if (node->btn.rgb_colour[i] != node->target.rgb_colour[i])
+            dirty |= (NODE_FIELD_RGB_0 << i);
+    if (node->btn.blink_ms != node->target.blink_ms)
+        dirty |= NODE_FIELD_BLINK;
+    if (node->active != node->target.active)
+        dirty |= NODE_FIELD_ACTIVE;
+
+    return ((dirty | ~node->known) & node->target.wanted);
+}
+
+uint32_t _sim_target_value(int slot, uint8_t field)
+{
+    switch (field)
+    {
+        case NODE_FIELD_RGB_0:  return _sim.list[slot].target.rgb_colour[0];
+        case NODE_FIELD_RGB_1:  return _sim.list[slot].target.rgb_colour[1];
+        case NODE_FIELD_RGB_2:  return _sim.list[slot].target.rgb_colour[2];
+        case NODE_FIELD_BLINK:  return _sim.list[slot].target.blink_ms;
+        case NODE_FIELD_ACTIVE: return _sim.list[slot].target.active? 1 : 0;
+        default:                return 0;
+    }
+}
+
+bool _sim_bcst_append(master_command_t cmd, uint32_t value)
+{
+    if ((_bcst.msg.cnt >= NODE_CMD_CNT_MAX) || ((_bcst.msg.len + 1 + cmd_mosi_sz(cmd)) > RGB_BTN_MSG_MAX_DATA_LEN))
+        return false;
+
+    _bcst.msg.cmd[_bcst.msg.cnt].cmd = cmd;
+    _bcst.msg.cmd[_bcst.msg.cnt].value = value;
+    _bcst.msg.cnt++;
+    _bcst.msg.len += 1 + cmd_mosi_sz(cmd);
+    return true;
+}
+
+void _sim_init_bcst_mask(uint32_t mask)
+{
+    if (!_sim_reindex())
+        mask &= (BIT_POS(_sim.cnt) - 1);
+    _bcst.mask = mask;
+    _bcst.msg.cnt = 0;
+    _bcst.msg.len = 1 + cmd_mosi_sz(cmd_bcast_address_mask);
+}
+
+uint32_t _sim_inactive_mask(void)
+{
+    uint32_t mask = 0;
+    for (int i = 0; i < _sim.cnt; i++)
+        if (!_sim.list[i].active)
+            mask |= BIT_POS(i);
+    return mask;
+}
+
+/*******************************************************************************
+Global (public) Functions (the harness)
+*******************************************************************************/
+void sim_nodes_init(int cnt, uint32_t baud)
+{
+    memset(&_sim, 0, sizeof(_sim));
+    _sim.sim_cnt = cnt;
+    _sim.baud = baud;
+    _sim.press_pending = -1;
+}
+
+bool sim_nodes_press(int slot)
+{
+    sim_node_t *node;
+
+    if ((slot < 0) || (slot >= _sim.cnt) || (!_sim.list[slot].hw.active) || (_sim.list[slot].hw.lost))
+        return false;
+
+    node = &_sim.list[slot];
+
+    //The node latches the reaction time, stops blinking and shows its 3rd colour
+    node->hw.press_us = sim_now_us();
+    node->hw.reaction_ms = (uint32_t)((node->hw.press_us - node->hw.active_us) / 1000);
+    if (node->hw.reaction_ms == 0)
+        node->hw.reaction_ms = 1;
+    node->hw.active = false;
+    node->hw.blink_ms = 0;
+    return true;
+}
+
+int sim_nodes_target(void)
+{
+    int first = -1;
+
+    for (int i = 0; i < _sim.cnt; i++)
+    {
+        if ((!_sim.list[i].hw.active) || (_sim.list[i].hw.lost))
+            continue;
+        if (_sim.list[i].hw.rgb_colour[2] == colGreen)
+            return i;
+        if (first < 0)
+            first = i;
+    }
+    return first;
+}
+
+int sim_nodes_other(int target, uint32_t rnd)
+{
+    int others[RGB_BTN_MAX_NODES];
+    int cnt = 0;
+
+    for (int i = 0; i < _sim.cnt; i++)
+        if ((_sim.list[i].hw.active) && (!_sim.list[i].hw.lost) && (i != target))
+            others[cnt++] = i;
+
+    return (cnt > 0)? others[rnd % cnt] : target;
+}
+
+int sim_nodes_active_cnt(void)
+{
+    int cnt = 0;
+    for (int i = 0; i < _sim.cnt; i++)
+        if ((_sim.list[i].hw.active) && (!_sim.list[i].hw.lost))
+            cnt++;
+    return cnt;
+}
+
+bool sim_nodes_lose(int slot)
+{
+    if ((slot < 0) || (slot >= _sim.cnt) || (_sim.list[slot].hw.lost))
+        return false;
+
+    //The master only finds out the next time it sends the node a direct msg
+    _sim.list[slot].hw.lost = true;
+    _sim.list[slot].hw.active = false;
+    return true;
+}
+
+/*******************************************************************************
+Global (public) Functions (nodes.h)
+*******************************************************************************/
+bool nodes_register_all(void)
+{
+    //The roll-call itself is not part of the game, so it takes no time
+    for (int i = _sim.cnt; i < _sim.sim_cnt; i++)
+    {
+        memset(&_sim.list[i], 0, sizeof(sim_node_t));
+        _sim.list[i].address = (uint8_t)(SIM_ADDR_FIRST + i);
+        _sim.list[i].hw.slot = i;
+        _sim.cnt++;
+        game_event_post(game_evt_node_joined, i, _sim.list[i].address);
+    }
+    iprintln(trNODE, "#%d nodes registered", _sim.cnt);
+    return (_sim.cnt > 0);
+}
+
+bool nodes_register_warm(void)
+{
+    //The simulated nodes are never reset, so the check always finds them where they were
+    return nodes_register_all();
+}
+
+uint8_t get_node_addr(uint8_t node)
+{
+    return is_node_valid(node)? _sim.list[node].address : ADDR_BROADCAST;
+}
+
+int node_count(void)
+{
+    return _sim.cnt;
+}
+
+bool is_node_valid(uint8_t node)
+{
+    return (node < _sim.cnt);
+}
+
+int active_node_count(void)
+{
+    int count = 0;
+    for (int i = 0; i < _sim.cnt; i++)
+        if (_sim.list[i].active)
+            count++;
+    return count;
+}
+
+uint32_t get_node_btn_reaction_ms(int slot)
+{
+    return (!is_node_valid(slot))? 0 : _sim.list[slot].btn.reaction_ms;
+}
+
+void init_node_msg(uint8_t node)
+{
+    if (!is_node_valid(node))
+        return;
+    _sim.list[node].msg.cnt = 0;
+    _sim.list[node].msg.len = 0;
+}
+
+static bool _sim_node_msg_append(uint8_t node, master_command_t cmd, uint32_t value)
+{
+    sim_msg_t *msg;
+
+    if (!is_node_valid(node))
+        return false;
+
+    msg = &_sim.list[node].msg;
+    if ((msg->cnt >= NODE_CMD_CNT_MAX) || ((msg->len + 1 + cmd_mosi_sz(cmd)) > RGB_BTN_MSG_MAX_DATA_LEN))
+        return false;
+
+    msg->cmd[msg->cnt].cmd = cmd;
+    msg->cmd[msg->cnt].value = value;
+    msg->cnt++;
+    msg->len += 1 + cmd_mosi_sz(cmd);
+    return true;
+}
+
+bool add_node_msg_set_rgb(uint8_t node, uint8_t index, uint32_t rgb_col)
+{
+    return (index <= 2) && _sim_node_msg_append(node, (master_command_t)(cmd_set_rgb_0 + index), rgb_col);
+}
+bool add_node_msg_set_blink(uint8_t node, uint32_t period_ms)
+{
+    return _sim_node_msg_append(node, cmd_set_blink, period_ms);
+}
+bool add_node_msg_set_active(uint8_t node, bool start)
+{
+    return _sim_node_msg_append(node, cmd_set_switch, start? CMD_SW_PAYLOAD_ACTIVATE : CMD_SW_PAYLOAD_DEACTIVATE);
+}
+bool add_node_msg_set_dbgled(uint8_t node, uint8_t state)
+{
+    return _sim_node_msg_append(node, cmd_set_dbg_led, state);
+}
+bool add_node_msg_get_reaction(uint8_t node)
+{
+    return _sim_node_msg_append(node, cmd_get_reaction, 0);
+}
+
+bool node_msg_tx_now(uint8_t node)
+{
+    sim_node_t *n;
+    int resp_len = 0;
+    int active_before = sim_nodes_active_cnt();
+    bool led_changed = false;
+
+    if (!is_node_valid(node))
+        return false;
+
+    n = &_sim.list[node];
+    if (n->hw.lost)
+    {
+        _sim_node_lost_msg(node);
+        game_event_post(game_evt_txn_done, node, false);
+        return false;
+    }
+
+    for (int i = 0; i < n->msg.cnt; i++)
+        resp_len += 1 + cmd_miso_sz(n->msg.cmd[i].cmd);
+    _sim_bus_msg(n->msg.len, resp_len);
+
+    //The node executes the cmds in order, and the master handles the responses
+    for (int i = 0; i < n->msg.cnt; i++)
+    {
+        master_command_t cmd = n->msg.cmd[i].cmd;
+        uint32_t value = n->msg.cmd[i].value;
+
+        if (cmd == cmd_get_reaction)
+        {
+            _sim_reaction_update(node);
+            continue;
+        }
+
+        led_changed |= _sim_node_apply(node, cmd, value);
+        _sim_view_update(node, cmd, value);
+        if (cmd == cmd_set_switch)
+            n->active = (value == CMD_SW_PAYLOAD_ACTIVATE);
+    }
+    n->msg.cnt = 0;
+    n->msg.len = 0;
+
+    game_event_post(game_evt_txn_done, node, true);
+    _sim_msg_done(active_before, led_changed);
+    return true;
+}
+
+void init_bcst_msg(void)
+{
+    _sim_init_bcst_mask(_sim_inactive_mask());
+}
+
+bool add_bcst_msg_set_rgb(uint8_t index, uint32_t rgb_col)
+{
+    return (index <= 2) && _sim_bcst_append((master_command_t)(cmd_set_rgb_0 + index), rgb_col);
+}
+bool add_bcst_msg_set_blink(uint32_t period_ms)
+{
+    return _sim_bcst_append(cmd_set_blink, period_ms);
+}
+bool add_bcst_msg_set_dbgled(uint8_t dbg_blink_state)
+{
+    return _sim_bcst_append(cmd_set_dbg_led, dbg_blink_state);
+}
+
+void bcst_msg_tx_now(void)
+{
+    int active_before = sim_nodes_active_cnt();
+    bool led_changed = false;
+
+    _sim_bus_msg(_bcst.msg.len, -1);
+
+    //Fire-and-forget, so the master assumes all the nodes in the mask got it (and in the sim they do, if they know
+    //which bit is theirs)
+    for (int i = 0; i < _sim.cnt; i++)
+    {
+        for (int c = 0; c < _bcst.msg.cnt; c++)
+        {
+            if (_sim_node_in_mask(i, _bcst.mask))
+                led_changed |= _sim_node_apply(i, _bcst.msg.cmd[c].cmd, _bcst.msg.cmd[c].value);
+            if (_bcst.mask & BIT_POS(i))
+                _sim_view_update(i, _bcst.msg.cmd[c].cmd, _bcst.msg.cmd[c].value);
+        }
+    }
+    _bcst.msg.cnt = 0;
+    _sim_msg_done(active_before, led_changed);
+}
+
+int bcst_scatter_rgb(uint8_t index, uint32_t mask, const uint32_t * rgb_cols)
+{
+    uint32_t frame_mask = 0;
+    int frame_cnt = 0;
+    int rgb_cnt = 0;
+
+    if ((index > 2) || (rgb_cols == NULL))
+        return -1;
+
+    for (int i = 0; i < _sim.cnt; i++)
+    {
+        if (!(mask & BIT_POS(i)))
+            continue;
+
+        frame_mask |= BIT_POS(i);
+        rgb_cnt++;
+        mask &= ~BIT_POS(i);
+        if ((rgb_cnt < RGB_BTN_SCATTER_MAX_NODES) && ((mask & (BIT_POS(_sim.cnt) - 1)) != 0))
+            continue;
+
+        _sim_init_bcst_mask(frame_mask);
+        int active_before = sim_nodes_active_cnt();
+        bool led_changed = false;
+        _sim_bus_msg(1 + cmd_mosi_sz(cmd_bcast_address_mask) + 1 + 1 + (3 * rgb_cnt), -1);
+        for (int j = 0; j < _sim.cnt; j++)
+        {
+            //A node takes the colour at its rank in the frame
+            if (_sim_node_in_mask(j, _bcst.mask))
+            {
+                uint32_t m = frame_mask;
+                for (int r = _sim_mask_rank(_bcst.mask, _sim.list[j].hw.slot); r > 0; r--)
+                    m &= (m - 1);
+                if (m != 0)
+                    led_changed |= _sim_node_apply(j, (master_command_t)(cmd_set_rgb_0 + index), rgb_cols[__builtin_ctz(m)]);
+            }
+            if (frame_mask & BIT_POS(j))
+                _sim_view_update(j, (master_command_t)(cmd_set_rgb_0 + index), rgb_cols[j]);
+        }
+        _sim_msg_done(active_before, led_changed);
+        frame_cnt++;
+        frame_mask = 0;
+        rgb_cnt = 0;
+    }
+    return frame_cnt;
+}
+
+bool bcst_sequence(const uint8_t * slots, uint8_t steps, uint32_t rgb_col, uint16_t lead_ms, uint16_t on_ms, uint16_t off_ms)
+{
+    if ((steps > CMD_SEQ_STEPS_MAX) || ((steps > 0) && ((slots == NULL) || (on_ms == 0))))
+        return false;
+    for (int i = 0; i < steps; i++)
+        if (slots[i] >= _sim.cnt)
+            return false;
+
+    //The nodes play it back by themselves, and their colours (and the master's view of them) are left alone
+    _sim_reindex();
+    int active_before = sim_nodes_active_cnt();
+    _sim_bus_msg(1 + cmd_mosi_sz(cmd_bcast_address_mask) + 1 + sizeof(cmd_sequence_t) + steps, -1);
+    _sim_msg_done(active_before, (steps > 0));
+    return true;
+}
+
+uint32_t nodes_poll_reaction(uint32_t mask)
+{
+    int active_before = sim_nodes_active_cnt();
+    uint32_t pending;
+    int rank = 0;
+
+    mask &= (BIT_POS(_sim.cnt) - 1);
+    if (mask == 0)
+        return 0;
+
+    pending = mask;
+    _sim_init_bcst_mask(mask);
+    _sim_bus_msg(1 + cmd_mosi_sz(cmd_bcast_address_mask) + 1, -1);
+    uint64_t start_us = sim_now_us();
+
+    //Each node answers at the start of its slot (its rank in the mask, by the slot it was told), and the master takes
+    //the answer by its address
+    for (uint32_t m = _bcst.mask; m != 0; m &= (m - 1), rank++)
+    {
+        int i;
+        for (i = 0; i < _sim.cnt; i++)
+            if ((!_sim.list[i].hw.lost) && (_sim.list[i].hw.slot == __builtin_ctz(m)))
+                break;
+        if (i >= _sim.cnt)
+            continue; //Nobody thinks this bit is theirs
+
+        uint64_t slot_us = start_us + (uint64_t)ROLL_CHECK_TIMOUT_MS(rank) * 1000;
+        if (slot_us > sim_now_us())
+            sim_advance_us(slot_us - sim_now_us());
+        _sim_bus_node_msg(2 + cmd_miso_sz(cmd_poll_reaction));
+        if (!(pending & BIT_POS(i)))
+            continue; //Not one we asked
+        pending &= ~BIT_POS(i);
+        _sim_reaction_update(i);
+    }
+
+    //The master waits out all the slots if anyone is missing
+    if (pending != 0)
+    {
+        uint64_t end_us = start_us + (uint64_t)(ROLL_CHECK_TIMOUT_MS(__builtin_popcount(mask)) + BUS_SILENCE_MIN_MS) * 1000;
+        if (end_us > sim_now_us())
+            sim_advance_us(end_us - sim_now_us());
+        for (int i = 0; i < _sim.cnt; i++)
+            if ((pending & BIT_POS(i)) && (!_sim.list[i].hw.lost))
+                sim_stats.poll_missed++;
+    }
+    _sim_msg_done(active_before, false);
+    return pending;
+}
+
+int _sim_apply_state(uint32_t mask, const node_state_t * state, int dbg_led)
+{
+    uint32_t verify = 0;
+    int msg_cnt = 0;
+    bool failed = false;
+
+    mask &= (BIT_POS(_sim.cnt) - 1);
+    if (mask == 0)
+        return 0;
+
+    for (int i = 0; i < _sim.cnt; i++)
+    {
+        if (!(mask & BIT_POS(i)))
+            continue;
+        if ((!(_sim.list[i].known & NODE_FIELD_ACTIVE)) || (_sim.list[i].active != state->active))
+            verify |= BIT_POS(i);
+        memcpy(_sim.list[i].target.rgb_colour, state->rgb_colour, sizeof(state->rgb_colour));
+        _sim.list[i].target.blink_ms = state->blink_ms;
+        _sim.list[i].target.active = state->active;
+        _sim.list[i].target.wanted |= (NODE_FIELD_RGB_0 | NODE_FIELD_RGB_1 | NODE_FIELD_RGB_2 | NODE_FIELD_BLINK | NODE_FIELD_ACTIVE);
+    }
+
+    //The same split as in nodes.c: a broadcast for the nodes whose switch stays as it is, a direct msg for the rest
+    mask &= ~verify;
+    if (mask != 0)
+    {
+        _sim_init_bcst_mask(mask);
+        _sim_bcst_append(cmd_set_blink, state->blink_ms);
+        for (uint8_t index = 0; index < 3; index++)
+            _sim_bcst_append((master_command_t)(cmd_set_rgb_0 + index), state->rgb_colour[index]);
+        _sim_bcst_append(cmd_set_switch, state->active? CMD_SW_PAYLOAD_ACTIVATE : CMD_SW_PAYLOAD_DEACTIVATE);
+        if (dbg_led >= 0)
+            _sim_bcst_append(cmd_set_dbg_led, (uint32_t)dbg_led);
+        bcst_msg_tx_now();
+        msg_cnt++;
+        for (int i = 0; i < _sim.cnt; i++)
+            if (mask & BIT_POS(i))
+                _sim.list[i].active = state->active;
+    }
+
+    for (int i = _sim.cnt - 1; i >= 0; i--)
+    {
+        if (!(verify & BIT_POS(i)))
+            continue;
+        init_node_msg(i);
+        add_node_msg_set_blink(i, state->blink_ms);
+        for (uint8_t index = 0; index < 3; index++)
+            add_node_msg_set_rgb(i, index, state->rgb_colour[index]);
+        if (dbg_led >= 0)
+            add_node_msg_set_dbgled(i, (uint8_t)dbg_led);
+        add_node_msg_set_active(i, state->active);
+        msg_cnt++;
+        if (!node_msg_tx_now(i))
+            failed = true;
+    }
+    return (failed)? -1 : msg_cnt;
+}
+
+int nodes_apply_state(uint32_t mask, const node_state_t * state)
+{
+    return _sim_apply_state(mask, state, -1);
+}
+
+int nodes_reset(uint32_t mask)
+{
+    const node_state_t _off = {.rgb_colour = {0, 0, 0}, .blink_ms = 0, .active = false};
+    return _sim_apply_state(mask, &_off, -1);
+}
+
+void bcst_msg_clear_all(void)
+{
+    const node_state_t _off = {.rgb_colour = {0, 0, 0}, .blink_ms = 0, .active = false};
+    _sim_apply_state(NODES_MASK_ALL, &_off, dbg_led_off);
+}
+
+bool node_target_set_rgb(uint8_t node, uint8_t index, uint32_t rgb_col)
+{
+    if ((!is_node_valid(node)) || (index > 2))
+        return false;
+
+    _sim.list[node].target.rgb_colour[index] = (rgb_col & 0x00FFFFFF);
+    _sim.list[node].target.wanted |= (NODE_FIELD_RGB_0 << index);
+    return true;
+}
+
+bool node_target_set_blink(uint8_t node, uint32_t period_ms)
+{
+    if (!is_node_valid(node))
+        return false;
+
+    _sim.list[node].target.blink_ms = period_ms;
+    _sim.list[node].target.wanted |= NODE_FIELD_BLINK;
+    return true;
+}
+
+void nodes_target_bcst_active(bool allow)
+{
+    _sim.bcst_active = allow;
+}
+
+bool node_target_set_active(uint8_t node, bool active)
+{
+    if (!is_node_valid(node))
+        return false;
+
+    _sim.list[node].target.active = active;
+    _sim.list[node].target.wanted |= NODE_FIELD_ACTIVE;
+    return true;
+}
+
+int nodes_target_flush(void)
+{
+    uint8_t dirty[RGB_BTN_MAX_NODES] = {0};
+    int msg_cnt = 0;
+    bool bcst_pending = false;
+    bool failed = false;
+
+    for (int i = 0; i < _sim.cnt; i++)
+        dirty[i] = _sim_target_dirty(i);
+
+    //1st, the changes shared by several (inactive) nodes go out as masked broadcasts...
+    for (uint8_t field = NODE_FIELD_RGB_0; field <= NODE_FIELD_BLINK; field <<= 1)
+    {
+        for (int i = 0; i < _sim.cnt; i++)
+        {
+            if ((!(dirty[i] & field)) || ((_sim.list[i].active) && (!_sim.bcst_active)))
+                continue;
+
+            uint32_t value = _sim_target_value(i, field);
+            uint32_t mask = 0;
+            for (int j = i; j < _sim.cnt; j++)
+                if ((dirty[j] & field) && ((!_sim.list[j].active) || (_sim.bcst_active)) && (_sim_target_value(j, field) == value))
+                    mask |= BIT_POS(j);
+
+            if (__builtin_popcount(mask) < NODE_FLUSH_BCST_MIN)
+                continue;
+
+            if ((bcst_pending) && (mask != _bcst.mask))
+            {
+                bcst_msg_tx_now();
+                msg_cnt++;
+                bcst_pending = false;
+            }
+            if (!bcst_pending)
+                _sim_init_bcst_mask(mask);
+
+            master_command_t cmd = (field == NODE_FIELD_BLINK)? cmd_set_blink : (master_command_t)(cmd_set_rgb_0 + __builtin_ctz(field));
+            if (!_sim_bcst_append(cmd, value))
+            {
+                bcst_msg_tx_now();
+                msg_cnt++;
+                _sim_init_bcst_mask(mask);
+                if (!_sim_bcst_append(cmd, value))
+                {
+                    bcst_pending = false;
+                    continue;
+                }
+            }
+            bcst_pending = true;
+
+            for (int j = i; j < _sim.cnt; j++)
+                if (mask & BIT_POS(j))
+                    dirty[j] &= ~field;
+        }
+    }
+    if (bcst_pending)
+    {
+        bcst_msg_tx_now();
+        msg_cnt++;
+    }
+
+    //2nd, the colours which differ from node to node are scattered across the inactive nodes
+    for (uint8_t index = 0; index < 3; index++)
+    {
+        uint32_t rgb_cols[RGB_BTN_MAX_NODES];
+        uint32_t mask = 0;
+        for (int i = 0; i < _sim.cnt; i++)
+        {
+            rgb_cols[i] = _sim.list[i].target.rgb_colour[index];
+            if ((dirty[i] & (NODE_FIELD_RGB_0 << index)) && ((!_sim.list[i].active) || (_sim.bcst_active)))
+                mask |= BIT_POS(i);
+        }
+
+        if (__builtin_popcount(mask) < NODE_FLUSH_BCST_MIN)
+            continue;
+
+        int frames = bcst_scatter_rgb(index, mask, rgb_cols);
+        if (frames < 0)
+            continue;
+
+        msg_cnt += frames;
+        for (int i = 0; i < _sim.cnt; i++)
+            if (mask & BIT_POS(i))
+                dirty[i] &= ~(NODE_FIELD_RGB_0 << index);
+    }
+
+    //... and then whatever is left is sent directly to the individual nodes
+    for (int i = 0; i < _sim.cnt; i++)
+    {
+        if (dirty[i] == 0)
+            continue;
+
+        init_node_msg(i);
+        if (dirty[i] & NODE_FIELD_BLINK)
+            add_node_msg_set_blink(i, _sim.list[i].target.blink_ms);
+        for (uint8_t index = 0; index < 3; index++)
+            if (dirty[i] & (NODE_FIELD_RGB_0 << index))
+                add_node_msg_set_rgb(i, index, _sim.list[i].target.rgb_colour[index]);
+        if (dirty[i] & NODE_FIELD_ACTIVE)
+            add_node_msg_set_active(i, _sim.list[i].target.active);
+
+        int cnt = _sim.cnt;
+        msg_cnt++;
+        if (!node_msg_tx_now(i))
+        {
+            failed = true;
+            if (_sim.cnt < cnt) //The node was deregistered, the rest moved down by 1
+            {
+                memmove(&dirty[i], &dirty[i + 1], _sim.cnt - i);
+                i--;
+            }
+        }
+    }
+
+    return (failed)? -1 : msg_cnt;
+}
+
+void nodes_target_reset(void)
+{
+    for (int i = 0; i < _sim.cnt; i++)
+        memset(&_sim.list[i].target, 0, sizeof(sim_target_t));
+    _sim.bcst_active = false;
+}
+
+#undef PRINTF_TAG
+/*************************** END OF FILE *************************************/
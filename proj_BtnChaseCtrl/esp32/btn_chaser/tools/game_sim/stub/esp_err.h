@@ -0,0 +1,31 @@
+/*****************************************************************************
+
+esp_err.h
+
+Host stand-in for the ESP-IDF error codes (see tools/game_sim/game_sim.c)
+
+******************************************************************************/
+#ifndef __sim_esp_err_H__
+#define __sim_esp_err_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK                  (0)
+#define ESP_FAIL                (-1)
+#define ESP_ERR_NO_MEM          (0x101)
+#define ESP_ERR_INVALID_ARG     (0x102)
+#define ESP_ERR_INVALID_STATE   (0x103)
+#define ESP_ERR_INVALID_SIZE    (0x104)
+#define ESP_ERR_NOT_FOUND       (0x105)
+#define ESP_ERR_NOT_SUPPORTED   (0x106)
+#define ESP_ERR_TIMEOUT         (0x107)
+
+const char * esp_err_to_name(esp_err_t code);
+
+#define ESP_ERROR_CHECK(x)      do { esp_err_t _rc = (x); if (_rc != ESP_OK) { fprintf(stderr, "ESP_ERROR_CHECK: %d (%s:%d)\n", _rc, __FILE__, __LINE__); abort(); } } while (0)
+
+#endif /* __sim_esp_err_H__ */
@@ -0,0 +1,16 @@
+/*****************************************************************************
+
+esp_random.h
+
+Host stand-in for the ESP-IDF random number generator: a seeded (repeatable)
+sequence, so the same seed gives the same game (see tools/game_sim/game_sim.c)
+
+******************************************************************************/
+#ifndef __sim_esp_random_H__
+#define __sim_esp_random_H__
+
+#include <stdint.h>
+
+uint32_t esp_random(void);
+
+#endif /* __sim_esp_random_H__ */
@@ -0,0 +1,19 @@
+/*****************************************************************************
+
+esp_timer.h
+
+Host stand-in for the ESP-IDF high resolution timer: the time is the virtual
+clock of tools/game_sim/game_sim.c
+
+******************************************************************************/
+#ifndef __sim_esp_timer_H__
+#define __sim_esp_timer_H__
+
+#include <stdint.h>
+
+/*! \brief The virtual time since the simulation started
+ * \return The time in us
+ */
+int64_t esp_timer_get_time(void);
+
+#endif /* __sim_esp_timer_H__ */
@@ -0,0 +1,42 @@
+/*****************************************************************************
+
+freertos/FreeRTOS.h
+
+Host stand-in for the FreeRTOS header, only what the game code uses (see
+tools/game_sim/game_sim.c). The tick is 1 ms, like on the controller.
+
+******************************************************************************/
+#ifndef __sim_FreeRTOS_H__
+#define __sim_FreeRTOS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_err.h"     /* As the IDF one does (indirectly) */
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t configSTACK_DEPTH_TYPE;
+
+#define pdTRUE                  (1)
+#define pdFALSE                 (0)
+#define pdPASS                  (pdTRUE)
+#define pdFAIL                  (pdFALSE)
+#define portMAX_DELAY           ((TickType_t)0xFFFFFFFF)
+#define portTICK_PERIOD_MS      (1)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+
+#define configASSERT(x)         do { if (!(x)) { fprintf(stderr, "assert: %s (%s:%d)\n", #x, __FILE__, __LINE__); abort(); } } while (0)
+
+/* ESP-IDF brings these in with sys/param.h */
+#ifndef MAX
+#define MAX(a, b)               (((a) > (b))? (a) : (b))
+#endif
+#ifndef MIN
+#define MIN(a, b)               (((a) < (b))? (a) : (b))
+#endif
+
+#endif /* __sim_FreeRTOS_H__ */
@@ -0,0 +1,22 @@
+/*****************************************************************************
+
+freertos/queue.h
+
+Host stand-in for the FreeRTOS queue API. A receive on an empty queue moves
+the virtual clock on by the time it would have blocked.
+
+******************************************************************************/
+#ifndef __sim_queue_H__
+#define __sim_queue_H__
+
+#include "FreeRTOS.h"
+
+typedef struct sim_queue_t * QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSend(QueueHandle_t queue, const void * item, TickType_t wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void * item, TickType_t wait);
+BaseType_t xQueueReset(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+#endif /* __sim_queue_H__ */
@@ -0,0 +1,30 @@
+/*****************************************************************************
+
+freertos/task.h
+
+Host stand-in for the FreeRTOS task API. There is only one task (the game
+task), which game_sim.c runs itself, and every delay moves the virtual clock on.
+
+******************************************************************************/
+#ifndef __sim_task_H__
+#define __sim_task_H__
+
+#include "FreeRTOS.h"
+
+typedef void * TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+typedef struct
+{
+    const char * pcTaskName;
+} TaskStatus_t;
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char * name, configSTACK_DEPTH_TYPE stack_depth, void * param, UBaseType_t priority, TaskHandle_t * handle);
+void vTaskDelete(TaskHandle_t handle);
+void vTaskSuspend(TaskHandle_t handle);
+void vTaskResume(TaskHandle_t handle);
+void vTaskDelay(TickType_t ticks);
+BaseType_t xTaskDelayUntil(TickType_t * prev_wake, TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+configSTACK_DEPTH_TYPE uxTaskGetStackHighWaterMark2(TaskHandle_t handle);
+
+#endif /* __sim_task_H__ */
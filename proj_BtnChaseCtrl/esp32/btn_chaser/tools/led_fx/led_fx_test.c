@@ -0,0 +1,230 @@
+/*******************************************************************************
+
+Module:     led_fx_test.c
+Purpose:    This file contains the golden frame test for the LED effects
+Author:     Rudolph van Niekerk
+
+Renders frames of every effect in _led_action_desc[] (blink, rainbow, breathe,
+chase, comet and sparkle) at fixed times since the start of the effect, with
+the renderers of task_rgb_led.c, and compares every LED of every frame with
+the colours stored in the golden file (led_fx_golden.txt).
+
+A frame per line in the golden file:
+    <effect> <period_ms> <col_1> <col_2> <t_ms>: <LED 0> <LED 1> ... <LED n-1>
+with all of the colours in hex. A change to a renderer (or to hue2rgb()) which
+is meant to change the way an effect looks, needs the golden file to be
+recorded again (--record), and the diff of it to be looked at.
+
+The task is included (not linked), so that the test can get to its local
+renderers and descriptors. Nothing of the task is run, the few RTOS, console
+and timer functions it links to are stood in for at the bottom of this file
+(and the LED strip driver by tools/led_strip/sim_rmt.c).
+
+Build (from btn_chaser/, with any host C compiler):
+    gcc -O2 -o led_fx_test -I tools/led_strip/stub -I tools/game_sim/stub \
+        -I main tools/led_fx/led_fx_test.c tools/led_strip/sim_rmt.c \
+        main/drv_rgb_led_strip.c main/colour.c main/str_helper.c -lm
+
+Use:
+    ./led_fx_test [-g <golden file>]
+    ./led_fx_test --record [-g <golden file>]
+    The golden file is tools/led_fx/led_fx_golden.txt by default. The exit code
+    is the number of frames which differ (0 if all of them match).
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+/* From esp_bit_defs.h and the IDF FreeRTOS task API, which the task gets
+    from the IDF headers */
+#define BIT(nr)                 (1UL << (nr))
+BaseType_t xTaskDelayUntil(TickType_t * const prev_wake_time, const TickType_t time_increment);
+
+#include "task_rgb_led.c"
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#ifdef PRINTF_TAG
+#undef PRINTF_TAG
+#endif
+#define PRINTF_TAG ("FxTest") /* This must be undefined at the end of the file*/
+
+#define FX_TEST_GOLDEN_DEF      "tools/led_fx/led_fx_golden.txt"
+#define FX_TEST_LED_CNT         (10)
+#define FX_TEST_LINE_LEN        (256)
+
+/*******************************************************************************
+Local structure
+ *******************************************************************************/
+typedef struct
+{
+    rgb_led_action_cmd action;
+    uint32_t period_ms;
+    uint32_t col_1;
+    uint32_t col_2;
+} _fx_test_case_t;
+
+/*******************************************************************************
+Local function prototypes
+ *******************************************************************************/
+/*! Writes a single frame, in the golden file format, to a string
+ * @param[out] line The string to write the frame to (FX_TEST_LINE_LEN)
+ * @param[in] tc The effect
+ * @param[in] t_ms The time since the start of the effect
+ */
+void _fx_test_frame(char * line, const _fx_test_case_t * tc, uint32_t t_ms);
+
+/*******************************************************************************
+Local variables
+ *******************************************************************************/
+
+/* Every effect at its default period, and at an odd one which doesn't divide
+    evenly into the LED count */
+static const _fx_test_case_t _fx_test_cases[] = {
+    {led_action_blink,   LED_BLINK_PERIOD_MS_DEF,   0xFF0000, 0x000020},
+    {led_action_blink,   333,                       0x00FF00, 0x000000},
+    {led_action_rainbow, LED_RAINBOW_PERIOD_MS_DEF, 0x000000, 0x000000},
+    {led_action_rainbow, 1999,                      0x000000, 0x000000},
+    {led_action_breathe, LED_EFFECT_PERIOD_MS_DEF,  0x00FFFF, 0x100000},
+    {led_action_breathe, 333,                       0xFFFFFF, 0x000000},
+    {led_action_chase,   LED_EFFECT_PERIOD_MS_DEF,  0xFFFF00, 0x000010},
+    {led_action_chase,   333,                       0xFF00FF, 0x000000},
+    {led_action_comet,   LED_EFFECT_PERIOD_MS_DEF,  0xFF8000, 0x000000},
+    {led_action_comet,   333,                       0x20FF40, 0x100010},
+    {led_action_sparkle, LED_EFFECT_PERIOD_MS_DEF,  0xFFFFFF, 0x000008},
+    {led_action_sparkle, 333,                       0x8080FF, 0x000000},
+};
+
+/* The frame times, as a fraction of the period (in 1/16ths), plus an offset in ms */
+static const struct { uint16_t sixteenths; int16_t ms; } _fx_test_times[] = {
+    {0, 0}, {0, 1}, {0, 37}, {2, 0}, {4, 0}, {5, 3}, {8, -1}, {8, 0}, {11, 0},
+    {12, 0}, {15, 0}, {16, -1}, {16, 0}, {23, 11}, {160, 7},
+};
+
+/*******************************************************************************
+Local (private) Functions
+ *******************************************************************************/
+void _fx_test_frame(char * line, const _fx_test_case_t * tc, uint32_t t_ms)
+{
+    rgb_led_fx_t fx = {
+        .action = tc->action,
+        .users = FX_TEST_LED_CNT,
+        .count = FX_TEST_LED_CNT,
+        .col_1 = tc->col_1,
+        .col_2 = tc->col_2,
+        .period_ms = tc->period_ms,
+        .start_ms = 0,
+    };
+    int len = snprintf(line, FX_TEST_LINE_LEN, "%s %lu %06lX %06lX %lu:", _led_action_desc[tc->action].name,
+        (unsigned long)tc->period_ms, (unsigned long)tc->col_1, (unsigned long)tc->col_2, (unsigned long)t_ms);
+
+    for (uint16_t pos = 0; pos < FX_TEST_LED_CNT; pos++)
+        len += snprintf(&line[len], FX_TEST_LINE_LEN - len, " %06lX", (unsigned long)_led_action_desc[tc->action].render(&fx, pos, t_ms));
+}
+
+static void _fx_test_usage(const char * name)
+{
+    printf("Usage: %s [--record] [-g <golden file>]\n", name);
+    printf("    --record  Writes the golden file iso checking against it\n");
+    printf("    -g        The golden file (default %s)\n", FX_TEST_GOLDEN_DEF);
+}
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+int main(int argc, char * argv[])
+{
+    const char * golden = FX_TEST_GOLDEN_DEF;
+    bool record = false;
+    char line[FX_TEST_LINE_LEN];
+    char exp[FX_TEST_LINE_LEN];
+    int frames = 0;
+    int fails = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--record") == 0)
+            record = true;
+        else if ((strcmp(argv[i], "-g") == 0) && (i + 1 < argc))
+            golden = argv[++i];
+        else
+        {
+            _fx_test_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    FILE * fp = fopen(golden, record? "w" : "r");
+    if (fp == NULL)
+    {
+        printf("Could not open %s\n", golden);
+        return -1;
+    }
+
+    for (int c = 0; c < (int)(sizeof(_fx_test_cases)/sizeof(_fx_test_cases[0])); c++)
+    {
+        const _fx_test_case_t * tc = &_fx_test_cases[c];
+        for (int t = 0; t < (int)(sizeof(_fx_test_times)/sizeof(_fx_test_times[0])); t++)
+        {
+            uint32_t t_ms = (uint32_t)(((uint64_t)tc->period_ms * _fx_test_times[t].sixteenths) / 16 + _fx_test_times[t].ms);
+
+            _fx_test_frame(line, tc, t_ms);
+            frames++;
+            if (record)
+            {
+                fprintf(fp, "%s\n", line);
+                continue;
+            }
+            if (fgets(exp, sizeof(exp), fp) == NULL)
+                exp[0] = '\0';
+            exp[strcspn(exp, "\r\n")] = '\0';
+            if (strcmp(line, exp) != 0)
+            {
+                fails++;
+                printf("FAIL\n    got: %s\n    exp: %s\n", line, exp);
+            }
+        }
+    }
+    fclose(fp);
+
+    if (record)
+        printf("Recorded %d frames to %s\n", frames, golden);
+    else
+        printf("%s (%d of %d frames differ)\n", (fails == 0)? "PASSED" : "FAILED", fails, frames);
+    return fails;
+}
+
+/*******************************************************************************
+Host stand-ins, for what the (not used) rest of the task links to
+ *******************************************************************************/
+BaseType_t xTaskCreate(TaskFunction_t fn, const char * name, configSTACK_DEPTH_TYPE stack_depth, void * param, UBaseType_t priority, TaskHandle_t * handle) { return pdFAIL; }
+void vTaskDelete(TaskHandle_t handle) {}
+BaseType_t xTaskDelayUntil(TickType_t * const prev_wake_time, const TickType_t time_increment) { return pdTRUE; }
+TickType_t xTaskGetTickCount(void) { return 0; }
+configSTACK_DEPTH_TYPE uxTaskGetStackHighWaterMark2(TaskHandle_t handle) { return 0; }
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) { return NULL; }
+BaseType_t xQueueSend(QueueHandle_t queue, const void * item, TickType_t wait) { return pdFAIL; }
+BaseType_t xQueueReceive(QueueHandle_t queue, void * item, TickType_t wait) { return pdFAIL; }
+int64_t esp_timer_get_time(void) { return 0; }
+uint32_t esp_random(void) { return 0; }
+uint64_t sys_poll_tmr_ms(void) { return 0; }
+int metrics_add(const char * _group_name, const metric_item_t * _tbl, size_t _cnt) { return 0; }
+void metric_hist_add(metric_hist_t * hist, uint32_t value) {}
+int console_add_menu(const char * group, ConsoleMenuItem_t * items, size_t cnt, const char * desc) { return 0; }
+int console_arg_cnt(void) { return 0; }
+char * console_arg_peek(int index) { return ""; }
+char * console_arg_pop(void) { return ""; }
+
+#undef PRINTF_TAG
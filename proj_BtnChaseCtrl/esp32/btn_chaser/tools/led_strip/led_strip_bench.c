@@ -0,0 +1,288 @@
+/*******************************************************************************
+
+Module:     led_strip_bench.c
+Purpose:    This file contains the host benchmark for the LED strip pixel packer
+Author:     Rudolph van Niekerk
+
+Stages the same frames into a strip in 3 ways and reports the pixels/s of each:
+    old     The per-pixel path from before the packer: the colour order string
+            is walked (strlen() and a switch on every byte) for every pixel
+    pixel   drv_rgb_led_strip_set_colour(), one call per pixel (packer of 1)
+    bulk    drv_rgb_led_strip_set_colours(), one call per frame
+The frames are then checked to be the same for all 3. The flush (through the
+output LUTs) is the same for all of them, so it is timed (and reported) on
+its own.
+
+The host is a lot faster than the ESP32-C3, so only the ratios between the
+paths mean something, not the numbers themselves.
+
+The driver is included (not linked), so that the benchmark can size the strip
+under test. The RMT and the console are stood in for by sim_rmt.c.
+
+Build (from btn_chaser/, with any host C compiler):
+    gcc -O2 -o led_strip_bench -I tools/led_strip/stub -I tools/game_sim/stub \
+        -I main tools/led_strip/led_strip_bench.c tools/led_strip/sim_rmt.c \
+        main/str_helper.c -lm
+
+Use:
+    ./led_strip_bench [-d grb|rgb|rgbw] [-n <leds>] [-f <frames>]
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "drv_rgb_led_strip.c"
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#ifdef PRINTF_TAG
+#undef PRINTF_TAG
+#endif
+#define PRINTF_TAG ("Bench") /* This must be undefined at the end of the file*/
+
+#define BENCH_LED_CNT_DEFAULT       (300)
+#define BENCH_FRAME_CNT_DEFAULT     (20000)
+
+/*******************************************************************************
+Local structure
+ *******************************************************************************/
+typedef enum {
+    BENCH_OLD,
+    BENCH_PIXEL,
+    BENCH_BULK,
+    /* Keep this at the end */
+    BENCH_MAX
+} _bench_path_t;
+
+/*******************************************************************************
+Local function prototypes
+ *******************************************************************************/
+/*! The per-pixel path of drv_rgb_led_strip_set_colour() from before the packer,
+ * kept here as the reference to measure against
+ */
+void _bench_set_colour_old(int led_index, uint32_t rgb);
+
+/*! Stages a number of frames along one of the paths
+ * @return The time taken in seconds
+ */
+double _bench_run(_bench_path_t path, const uint32_t * frames, int frame_cnt, int led_cnt);
+
+/*******************************************************************************
+Local variables
+ *******************************************************************************/
+static const char * const _bench_path_name[BENCH_MAX] = {"old", "pixel", "bulk"};
+
+/*******************************************************************************
+Local (private) Functions
+ *******************************************************************************/
+static double _bench_now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void _bench_set_colour_old(int led_index, uint32_t rgb)
+{
+    int strip_index = -1;
+
+    if (!_drv_rgb_led_strip_get_strip_index(&led_index, &strip_index))
+        return;
+
+    led_strip_t* led_strip = led_strip_list[strip_index];
+
+    if (led_strip->init_result != ESP_OK)
+    {
+        iprintln(trLED, "#%s strip not initialised", led_strip->name);
+        return;
+    }
+
+    uint8_t * rgb_buf = ColourBuffer(strip_index);
+    const char * col_order = ColOrder(strip_index);
+    int bytes_per_led = strlen(col_order);
+
+    // Build RGB colours in the order as they are expeted for the particular driver
+    for (int i = 0; i < bytes_per_led; i++)
+    {
+        switch (col_order[i])
+        {
+        case 'R':
+        case 'r':
+            rgb_buf[led_index * bytes_per_led + i] = RED_from_WRGB(rgb);
+            break;
+        case 'G':
+        case 'g':
+            rgb_buf[led_index * bytes_per_led + i] = GREEN_from_WRGB(rgb);
+            break;
+        case 'B':
+        case 'b':
+            rgb_buf[led_index * bytes_per_led + i] = BLUE_from_WRGB(rgb);
+            break;
+        case 'W':
+        case 'w':
+            rgb_buf[led_index * bytes_per_led + i] = WHITE_from_WRGB(rgb);
+            break;
+        default:
+            iprintln(trLED, "#Unsupported char ('%c')in colour order str of %s strip", col_order[i], led_strip->name);
+            break;
+        }
+    }
+    led_strip->dirty = true;
+}
+
+double _bench_run(_bench_path_t path, const uint32_t * frames, int frame_cnt, int led_cnt)
+{
+    double start = _bench_now_s();
+
+    for (int f = 0; f < frame_cnt; f++)
+    {
+        //Every frame is different (and from a different spot in the pattern), so nothing can be hoisted out
+        const uint32_t * frame = &frames[f % led_cnt];
+        switch (path)
+        {
+            case BENCH_OLD:
+                for (int i = 0; i < led_cnt; i++)
+                    _bench_set_colour_old(i, frame[i]);
+                break;
+            case BENCH_PIXEL:
+                for (int i = 0; i < led_cnt; i++)
+                    drv_rgb_led_strip_set_colour(i, frame[i]);
+                break;
+            case BENCH_BULK:
+                drv_rgb_led_strip_set_colours(0, frame, led_cnt);
+                break;
+            default:
+                break;
+        }
+    }
+    return _bench_now_s() - start;
+}
+
+static void _bench_usage(const char * name)
+{
+    printf("Usage: %s [-d grb|rgb|rgbw] [-n <leds>] [-f <frames>]\n", name);
+    printf("    -d  The colour order of the strip (default grb)\n");
+    printf("    -n  The number of leds in the strip (default %d)\n", BENCH_LED_CNT_DEFAULT);
+    printf("    -f  The number of frames to stage on each path (default %d)\n", BENCH_FRAME_CNT_DEFAULT);
+}
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+int main(int argc, char * argv[])
+{
+    int led_cnt = BENCH_LED_CNT_DEFAULT;
+    int frame_cnt = BENCH_FRAME_CNT_DEFAULT;
+    rgb_drv_types drv_type = SK6812_V1;
+    double secs[BENCH_MAX + 1];
+    uint8_t * ref = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:n:f:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'd':
+                for (drv_type = 0; drv_type < RGB_DRV_MAX; drv_type++)
+                    if (strcasecmp(optarg, rgb_led_drv_cfg[drv_type].col_order) == 0)
+                        break;
+                if (drv_type == RGB_DRV_MAX)
+                {
+                    _bench_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'n':
+                led_cnt = atoi(optarg);
+                break;
+            case 'f':
+                frame_cnt = atoi(optarg);
+                break;
+            default:
+                _bench_usage(argv[0]);
+                return 1;
+        }
+    }
+    if ((led_cnt <= 0) || (led_cnt > UINT16_MAX) || (frame_cnt <= 0))
+    {
+        _bench_usage(argv[0]);
+        return 1;
+    }
+
+    //The debug strip is the only one in the list, so it is turned into the strip under test
+    dbg_led.drv_type = drv_type;
+    dbg_led.led_cnt = led_cnt;
+    if (drv_rgb_led_strip_init() != (uint32_t)led_cnt)
+    {
+        printf("Could not initialise a %d led strip\n", led_cnt);
+        return 1;
+    }
+    size_t buf_size = dbg_led.bytes_per_led * led_cnt;
+
+    //Two strip lengths of pattern, so that every frame can start somewhere else in it
+    uint32_t * frames = malloc(2 * led_cnt * sizeof(uint32_t));
+    ref = malloc(buf_size);
+    if ((frames == NULL) || (ref == NULL))
+    {
+        printf("Out of memory\n");
+        return 1;
+    }
+    srand(1);
+    for (int i = 0; i < 2 * led_cnt; i++)
+        frames[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+
+    int fails = 0;
+    for (_bench_path_t path = 0; path < BENCH_MAX; path++)
+    {
+        memset(dbg_led.colour_buf, 0, buf_size);
+        secs[path] = _bench_run(path, frames, frame_cnt, led_cnt);
+        //All the paths must leave the same (last) frame behind
+        if (path == BENCH_OLD)
+            memcpy(ref, dbg_led.colour_buf, buf_size);
+        else if (memcmp(ref, dbg_led.colour_buf, buf_size) != 0)
+        {
+            printf("!The %s path staged a different frame than the old one\n", _bench_path_name[path]);
+            fails++;
+        }
+    }
+
+    double start = _bench_now_s();
+    for (int f = 0; f < frame_cnt; f++)
+    {
+        dbg_led.dirty = true;
+        drv_rgb_led_strip_flush();
+    }
+    secs[BENCH_MAX] = _bench_now_s() - start;
+
+    double pixels = (double)led_cnt * frame_cnt;
+    printf("col_order       %s\n", rgb_led_drv_cfg[drv_type].col_order);
+    printf("leds            %d\n", led_cnt);
+    printf("frames          %d\n", frame_cnt);
+    for (_bench_path_t path = 0; path < BENCH_MAX; path++)
+    {
+        char key[16];
+        snprintf(key, sizeof(key), "%s_px_per_s", _bench_path_name[path]);
+        printf("%-15s %.0f\n", key, pixels / secs[path]);
+    }
+    printf("flush_px_per_s  %.0f\n", pixels / secs[BENCH_MAX]);
+    printf("pixel_vs_old    %.2f\n", secs[BENCH_OLD] / secs[BENCH_PIXEL]);
+    printf("bulk_vs_old     %.2f\n", secs[BENCH_OLD] / secs[BENCH_BULK]);
+
+    drv_rgb_led_strip_deinit();
+    free(frames);
+    free(ref);
+    return fails;
+}
+
+#undef PRINTF_TAG
@@ -0,0 +1,198 @@
+/*******************************************************************************
+
+Module:     led_strip_test.c
+Purpose:    This file contains the host test for the LED strip pixel packer
+Author:     Rudolph van Niekerk
+
+Packs known WRGB values for every colour order in rgb_led_drv_cfg[] ("grb",
+"rgb" and "rgbw") and checks the bytes, first straight through the packer
+(_drv_rgb_led_strip_pack()) and then through the public API, from
+drv_rgb_led_strip_set_colour()/drv_rgb_led_strip_set_colours() to the buffer
+handed to the RMT by drv_rgb_led_strip_flush() (without a calibration, so the
+output LUT leaves the bytes as is).
+
+The driver is included (not linked), so that the test can get to its local
+functions and strips. The RMT and the console are stood in for by sim_rmt.c.
+
+Build (from btn_chaser/, with any host C compiler):
+    gcc -O2 -o led_strip_test -I tools/led_strip/stub -I tools/game_sim/stub \
+        -I main tools/led_strip/led_strip_test.c tools/led_strip/sim_rmt.c \
+        main/str_helper.c -lm
+
+Use:
+    ./led_strip_test [-v]
+    The exit code is the number of failed checks (0 if all passed).
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "drv_rgb_led_strip.c"
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#ifdef PRINTF_TAG
+#undef PRINTF_TAG
+#endif
+#define PRINTF_TAG ("Test") /* This must be undefined at the end of the file*/
+
+#define TEST_LED_CNT    (4)
+#define TEST_GUARD      (0x5A)  /* Fills the bytes around the packed leds, which must not be touched */
+
+/*******************************************************************************
+Local structure
+ *******************************************************************************/
+typedef struct
+{
+    rgb_drv_types drv_type;
+    uint8_t bytes_per_led;
+    uint8_t bytes[TEST_LED_CNT * 4];    /* The expected bytes for _test_wrgb[] */
+} _test_case_t;
+
+/*******************************************************************************
+Global (public) variables
+ *******************************************************************************/
+extern bool sim_console_verbose;
+
+/*******************************************************************************
+Local variables
+ *******************************************************************************/
+static const uint32_t _test_wrgb[TEST_LED_CNT] = {
+    0x11223344,     /* W 0x11, R 0x22, G 0x33, B 0x44 */
+    0xA1B2C3D4,
+    0x00FF0000,     /* Red only */
+    0xFF000000,     /* White only */
+};
+
+static const _test_case_t _test_cases[] = {
+    {SK6812_V1,  3, {0x33, 0x22, 0x44,  0xC3, 0xB2, 0xD4,  0x00, 0xFF, 0x00,  0x00, 0x00, 0x00}},
+    {SM16703_V1, 3, {0x22, 0x33, 0x44,  0xB2, 0xC3, 0xD4,  0xFF, 0x00, 0x00,  0x00, 0x00, 0x00}},
+    {SK6812W_V1, 4, {0x22, 0x33, 0x44, 0x11,  0xB2, 0xC3, 0xD4, 0xA1,  0xFF, 0x00, 0x00, 0x00,  0x00, 0x00, 0x00, 0xFF}},
+};
+
+static int _test_fails = 0;
+
+/*******************************************************************************
+Local (private) Functions
+ *******************************************************************************/
+static void _test_check(const char * name, const char * what, const uint8_t * got, const uint8_t * exp, size_t len)
+{
+    if (memcmp(got, exp, len) == 0)
+    {
+        printf("pass  %-8s %s\n", name, what);
+        return;
+    }
+
+    _test_fails++;
+    printf("FAIL  %-8s %s\n", name, what);
+    printf("      got:");
+    for (size_t i = 0; i < len; i++)
+        printf(" %02X", got[i]);
+    printf("\n      exp:");
+    for (size_t i = 0; i < len; i++)
+        printf(" %02X", exp[i]);
+    printf("\n");
+}
+
+static void _test_packer(const _test_case_t * tc)
+{
+    const char * name = rgb_led_drv_cfg[tc->drv_type].name;
+    led_strip_t strip = {.drv_type = tc->drv_type, .name = name};
+    size_t len = TEST_LED_CNT * tc->bytes_per_led;
+    uint8_t buf[1 + TEST_LED_CNT * 4 + 1];
+    uint8_t exp[sizeof(buf)];
+
+    if ((_drv_rgb_led_strip_resolve_order(&strip) != ESP_OK) || (strip.bytes_per_led != tc->bytes_per_led))
+    {
+        _test_fails++;
+        printf("FAIL  %-8s colour order \"%s\" (%d bytes per led)\n", name, rgb_led_drv_cfg[tc->drv_type].col_order, strip.bytes_per_led);
+        return;
+    }
+
+    //All the leds in one go
+    memset(buf, TEST_GUARD, sizeof(buf));
+    memset(exp, TEST_GUARD, sizeof(exp));
+    memcpy(&exp[1], tc->bytes, len);
+    _drv_rgb_led_strip_pack(&strip, &buf[1], _test_wrgb, TEST_LED_CNT);
+    _test_check(name, "pack (bulk)", buf, exp, len + 2);
+
+    //One led at a time, last to first
+    memset(buf, TEST_GUARD, sizeof(buf));
+    for (int i = TEST_LED_CNT - 1; i >= 0; i--)
+        _drv_rgb_led_strip_pack(&strip, &buf[1 + i * tc->bytes_per_led], &_test_wrgb[i], 1);
+    _test_check(name, "pack (per led)", buf, exp, len + 2);
+}
+
+static void _test_public_api(const _test_case_t * tc)
+{
+    const char * name = rgb_led_drv_cfg[tc->drv_type].name;
+    size_t len = TEST_LED_CNT * tc->bytes_per_led;
+    size_t tx_len = 0;
+    const uint8_t * tx;
+
+    //The debug strip is the only one in the list, so it is turned into the strip under test
+    dbg_led.drv_type = tc->drv_type;
+    dbg_led.led_cnt = TEST_LED_CNT;
+    if (drv_rgb_led_strip_init() != TEST_LED_CNT)
+    {
+        _test_fails++;
+        printf("FAIL  %-8s init\n", name);
+        return;
+    }
+    drv_rgb_led_strip_set_calibration(0, false, NULL);
+
+    drv_rgb_led_strip_set_colours(0, _test_wrgb, TEST_LED_CNT);
+    drv_rgb_led_strip_flush();
+    tx = sim_rmt_last_tx(&tx_len);
+    if (tx_len != len)
+    {
+        _test_fails++;
+        printf("FAIL  %-8s flush (set_colours) sent %d bytes, expected %d\n", name, (int)tx_len, (int)len);
+    }
+    else
+        _test_check(name, "flush (set_colours)", tx, tc->bytes, len);
+
+    for (int i = 0; i < TEST_LED_CNT; i++)
+        drv_rgb_led_strip_set_colour(i, 0);
+    drv_rgb_led_strip_flush();
+    for (int i = 0; i < TEST_LED_CNT; i++)
+        drv_rgb_led_strip_set_colour(i, _test_wrgb[i]);
+    drv_rgb_led_strip_flush();
+    tx = sim_rmt_last_tx(&tx_len);
+    if (tx_len != len)
+    {
+        _test_fails++;
+        printf("FAIL  %-8s flush (set_colour) sent %d bytes, expected %d\n", name, (int)tx_len, (int)len);
+    }
+    else
+        _test_check(name, "flush (set_colour)", tx, tc->bytes, len);
+
+    drv_rgb_led_strip_deinit();
+}
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+int main(int argc, char * argv[])
+{
+    if ((argc > 1) && (strcmp(argv[1], "-v") == 0))
+        sim_console_verbose = true;
+
+    for (int i = 0; i < (int)(sizeof(_test_cases)/sizeof(_test_cases[0])); i++)
+    {
+        _test_packer(&_test_cases[i]);
+        _test_public_api(&_test_cases[i]);
+    }
+
+    printf("%s (%d failed)\n", (_test_fails == 0)? "PASSED" : "FAILED", _test_fails);
+    return _test_fails;
+}
+
+#undef PRINTF_TAG
@@ -0,0 +1,210 @@
+/*******************************************************************************
+
+Module:     sim_rmt.c
+Purpose:    This file contains the host stand-ins for the LED strip tools
+Author:     Rudolph van Niekerk
+
+The RMT TX driver (see stub/driver/rmt_tx.h) and the console, just enough to
+run drv_rgb_led_strip.c on the host (led_strip_test.c and led_strip_bench.c).
+A transmit only keeps a copy of the buffer it is given, and the console is
+quiet unless sim_console_verbose is set.
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/rmt_tx.h"
+#include "task_console.h"
+
+/*******************************************************************************
+Local structure
+ *******************************************************************************/
+struct sim_rmt_channel_t
+{
+    rmt_tx_channel_config_t config;
+    bool enabled;
+};
+
+/*******************************************************************************
+Global (public) variables
+ *******************************************************************************/
+bool sim_console_verbose = false;
+
+/*******************************************************************************
+Local variables
+ *******************************************************************************/
+static uint8_t * _sim_tx_buf = NULL;
+static size_t _sim_tx_len = 0;
+
+/*******************************************************************************
+Local (private) Functions
+ *******************************************************************************/
+static size_t _sim_rmt_encode(rmt_encoder_t *encoder, rmt_channel_handle_t channel, const void *primary_data, size_t data_size, rmt_encode_state_t *ret_state)
+{
+    *ret_state = RMT_ENCODING_COMPLETE;
+    return data_size;
+}
+
+static esp_err_t _sim_rmt_encoder_del(rmt_encoder_t *encoder)
+{
+    free(encoder);
+    return ESP_OK;
+}
+
+static esp_err_t _sim_rmt_encoder_reset(rmt_encoder_t *encoder)
+{
+    return ESP_OK;
+}
+
+static esp_err_t _sim_rmt_new_encoder(rmt_encoder_handle_t *ret_encoder)
+{
+    rmt_encoder_t * encoder = calloc(1, sizeof(rmt_encoder_t));
+
+    if (encoder == NULL)
+        return ESP_ERR_NO_MEM;
+    encoder->encode = _sim_rmt_encode;
+    encoder->del = _sim_rmt_encoder_del;
+    encoder->reset = _sim_rmt_encoder_reset;
+    *ret_encoder = encoder;
+    return ESP_OK;
+}
+
+static void _sim_console_vprint(const char * tag, const char *fmt, va_list args, bool line)
+{
+    if (!sim_console_verbose)
+        return;
+
+    if ((line) && ((fmt[0] == '#') || (fmt[0] == '!')))
+    {
+        fprintf(stderr, "%s%s: ", tag, (fmt[0] == '!')? " ERROR" : "");
+        fmt++;
+    }
+    vfprintf(stderr, fmt, args);
+    if (line)
+        fputc('\n', stderr);
+}
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+esp_err_t rmt_new_tx_channel(const rmt_tx_channel_config_t *config, rmt_channel_handle_t *ret_chan)
+{
+    rmt_channel_handle_t chan = calloc(1, sizeof(struct sim_rmt_channel_t));
+
+    if (chan == NULL)
+        return ESP_ERR_NO_MEM;
+    chan->config = *config;
+    *ret_chan = chan;
+    return ESP_OK;
+}
+
+esp_err_t rmt_del_channel(rmt_channel_handle_t channel)
+{
+    free(channel);
+    return ESP_OK;
+}
+
+esp_err_t rmt_enable(rmt_channel_handle_t channel)
+{
+    channel->enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t rmt_disable(rmt_channel_handle_t channel)
+{
+    channel->enabled = false;
+    return ESP_OK;
+}
+
+esp_err_t rmt_transmit(rmt_channel_handle_t channel, rmt_encoder_handle_t encoder, const void *payload, size_t payload_bytes, const rmt_transmit_config_t *config)
+{
+    if (!channel->enabled)
+        return ESP_ERR_INVALID_STATE;
+
+    uint8_t * buf = realloc(_sim_tx_buf, payload_bytes);
+    if (buf == NULL)
+        return ESP_ERR_NO_MEM;
+    memcpy(buf, payload, payload_bytes);
+    _sim_tx_buf = buf;
+    _sim_tx_len = payload_bytes;
+    return ESP_OK;
+}
+
+esp_err_t rmt_tx_wait_all_done(rmt_channel_handle_t channel, int timeout_ms)
+{
+    //The transfer is "done" as soon as it is started
+    return ESP_OK;
+}
+
+esp_err_t rmt_new_bytes_encoder(const rmt_bytes_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder)
+{
+    return _sim_rmt_new_encoder(ret_encoder);
+}
+
+esp_err_t rmt_new_copy_encoder(const rmt_copy_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder)
+{
+    return _sim_rmt_new_encoder(ret_encoder);
+}
+
+esp_err_t rmt_del_encoder(rmt_encoder_handle_t encoder)
+{
+    return encoder->del(encoder);
+}
+
+esp_err_t rmt_encoder_reset(rmt_encoder_handle_t encoder)
+{
+    return encoder->reset(encoder);
+}
+
+void * rmt_alloc_encoder_mem(size_t size)
+{
+    return calloc(1, size);
+}
+
+const uint8_t * sim_rmt_last_tx(size_t * len)
+{
+    *len = _sim_tx_len;
+    return _sim_tx_buf;
+}
+
+const char * esp_err_to_name(esp_err_t code)
+{
+    static char name[16];
+
+    if (code == ESP_OK)
+        return "ESP_OK";
+    snprintf(name, sizeof(name), "ERR 0x%x", code);
+    return name;
+}
+
+void console_printline(uint8_t traceflags, const char * tag, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    _sim_console_vprint(tag, fmt, args, true);
+    va_end(args);
+}
+
+void console_print(uint8_t traceflags, const char * tag, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    _sim_console_vprint(tag, fmt, args, false);
+    va_end(args);
+}
+
+void console_trace(uint8_t traceflags, const char * tag, const char *fmt, const uint32_t *args, size_t cnt)
+{
+    uint32_t a[CONSOLE_TRACE_ARGS_MAX] = {0};
+
+    memcpy(a, args, ((cnt < CONSOLE_TRACE_ARGS_MAX)? cnt : CONSOLE_TRACE_ARGS_MAX) * sizeof(uint32_t));
+    console_printline(traceflags, tag, fmt, a[0], a[1], a[2], a[3]);
+}
@@ -0,0 +1,106 @@
+/*****************************************************************************
+
+driver/rmt_tx.h
+
+Host stand-in for the ESP-IDF RMT TX driver, only what drv_rgb_led_strip.c
+uses (see tools/led_strip/led_strip_test.c). Nothing is clocked out, the last
+buffer passed to rmt_transmit() is kept for the test to look at.
+
+******************************************************************************/
+#ifndef __sim_rmt_tx_H__
+#define __sim_rmt_tx_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define SOC_RMT_GROUPS                      (1)     /* As on the ESP32-C3 */
+#define SOC_RMT_TX_CANDIDATES_PER_GROUP     (2)
+#define SOC_RMT_MEM_WORDS_PER_CHANNEL       (48)
+
+#define RMT_CLK_SRC_DEFAULT     (0)
+#define GPIO_NUM_8              (8)
+#define GPIO_NUM_9              (9)
+
+#define RMT_ENCODING_RESET      (0)
+#define RMT_ENCODING_COMPLETE   (1)
+#define RMT_ENCODING_MEM_FULL   (2)
+
+/* From esp_compiler.h, which the IDF brings in with the driver headers */
+#ifndef likely
+#define likely(x)               __builtin_expect(!!(x), 1)
+#define unlikely(x)             __builtin_expect(!!(x), 0)
+#endif
+
+#ifndef __containerof
+#define __containerof(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+#endif
+
+typedef struct
+{
+    unsigned level0;
+    unsigned duration0;
+    unsigned level1;
+    unsigned duration1;
+} rmt_symbol_word_t;
+
+typedef struct
+{
+    rmt_symbol_word_t bit0;
+    rmt_symbol_word_t bit1;
+    struct {
+        unsigned msb_first;
+    } flags;
+} rmt_bytes_encoder_config_t;
+
+typedef struct
+{
+    int dummy;
+} rmt_copy_encoder_config_t;
+
+typedef struct
+{
+    int clk_src;
+    int gpio_num;
+    size_t mem_block_symbols;
+    uint32_t resolution_hz;
+    size_t trans_queue_depth;
+} rmt_tx_channel_config_t;
+
+typedef struct
+{
+    int loop_count;
+} rmt_transmit_config_t;
+
+typedef struct sim_rmt_channel_t * rmt_channel_handle_t;
+typedef int rmt_encode_state_t;
+typedef struct rmt_encoder_t rmt_encoder_t;
+typedef rmt_encoder_t * rmt_encoder_handle_t;
+
+struct rmt_encoder_t
+{
+    size_t (*encode)(rmt_encoder_t *encoder, rmt_channel_handle_t channel, const void *primary_data, size_t data_size, rmt_encode_state_t *ret_state);
+    esp_err_t (*reset)(rmt_encoder_t *encoder);
+    esp_err_t (*del)(rmt_encoder_t *encoder);
+};
+
+esp_err_t rmt_new_tx_channel(const rmt_tx_channel_config_t *config, rmt_channel_handle_t *ret_chan);
+esp_err_t rmt_del_channel(rmt_channel_handle_t channel);
+esp_err_t rmt_enable(rmt_channel_handle_t channel);
+esp_err_t rmt_disable(rmt_channel_handle_t channel);
+esp_err_t rmt_transmit(rmt_channel_handle_t channel, rmt_encoder_handle_t encoder, const void *payload, size_t payload_bytes, const rmt_transmit_config_t *config);
+esp_err_t rmt_tx_wait_all_done(rmt_channel_handle_t channel, int timeout_ms);
+
+esp_err_t rmt_new_bytes_encoder(const rmt_bytes_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder);
+esp_err_t rmt_new_copy_encoder(const rmt_copy_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder);
+esp_err_t rmt_del_encoder(rmt_encoder_handle_t encoder);
+esp_err_t rmt_encoder_reset(rmt_encoder_handle_t encoder);
+void * rmt_alloc_encoder_mem(size_t size);
+
+/*! Returns the last buffer passed to rmt_transmit() (on any channel)
+ * @param[out] len The number of bytes in the buffer
+ * @return A pointer to a copy of the buffer
+ */
+const uint8_t * sim_rmt_last_tx(size_t * len);
+
+#endif /* __sim_rmt_tx_H__ */
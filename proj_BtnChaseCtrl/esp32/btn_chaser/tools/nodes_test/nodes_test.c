@@ -0,0 +1,727 @@
+/*******************************************************************************
+
+Module:     nodes_test.c
+Purpose:    This file contains the host test for the node management of the master
+Author:     Rudolph van Niekerk
+
+Runs nodes.c and the comms task (task_comms.c) against a bus of simulated
+nodes. The nodes are registered with a real roll-call, and from then on they
+act on what the master sends them: a direct msg is answered (in a msg of its
+own, fragmented if need be), a masked broadcast is only acted on by the nodes
+in the mask. Every msg the master sent is logged, so the checks are made on
+both the traffic and the state the nodes end up in. Checks:
+  - nodes_reset() on nodes of which the switch state is not known yet: a
+    direct msg to each (acknowledged), no broadcast.
+  - nodes_apply_state() on nodes which are known to be inactive: a single
+    masked broadcast carrying the blink period, the 3 colours and the switch.
+  - A node which is active: it gets a direct msg, the others share the
+    broadcast (its bit is not in the mask).
+  - The targets are set as well, so a nodes_target_flush() sends nothing
+    (targets a game set before the reset are not brought back).
+  - Only the nodes in the mask are touched, and a mask without any registered
+    nodes sends nothing.
+  - bcst_msg_clear_all(): everything off, the debug LED too, on the active
+    nodes as well.
+  - A node which does not acknowledge its direct msg: -1, and it is
+    deregistered (the others still got the broadcast).
+  - The registry of the nodes is saved in NVS once they are registered (with
+    their addresses and calibration), and not written again by a roll-call
+    which finds the same nodes.
+  - nodes_register_warm() after a reset of the master, with the nodes still
+    in their slots: a single CHECK roll-call, no direct msgs, all restored in
+    their slots (calibration too) in a fraction of the time of a roll-call.
+  - One of them was reset as well: the nodes before it are restored, those
+    after it are moved up directly, and it is found by an UNREG roll-call.
+  - Nodes which answer from another slot than the one saved are registered
+    directly (not restored), without a roll-call.
+  - Nothing saved: the bus is enumerated with a full roll-call.
+
+Both nodes.c and the comms task are included (not linked), so that the test
+can get to their local functions and state (nodes.c 1st, it defines the
+command tables). The UART, FreeRTOS, the NVS, the timers, the game and the
+console are stood in for by stub/, tools/comms_test/, tools/rstats_test/,
+tools/game_sim/stub/ and sim_master.c.
+
+Build (from btn_chaser/, with any host C compiler):
+    gcc -O2 -DCLOCK_CORRECTION_ENABLED=1 -o nodes_test -I tools/nodes_test/stub \
+        -I tools/rstats_test/stub -I tools/comms_test/stub -I tools/game_sim/stub \
+        -I main tools/nodes_test/nodes_test.c tools/nodes_test/sim_master.c \
+        tools/comms_test/sim_uart.c tools/rstats_test/sim_nvs.c
+
+Use:
+    ./nodes_test [-v]
+    -v prints the trace of nodes.c and the comms task. The exit code is the
+    number of failed checks (0 if all passed).
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "nodes.c"
+#include "task_comms.c"
+#include "nvs_flash.h"
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#ifdef PRINTF_TAG
+#undef PRINTF_TAG
+#endif
+#define PRINTF_TAG ("Test") /* This must be undefined at the end of the file*/
+
+#define TEST_NODES          (6)
+#define TEST_NODE_ADDR      (0x20)  /* The address of the 1st node, the rest follow */
+#define TEST_LOG_MAX        (64)
+
+/*******************************************************************************
+Local structure
+ *******************************************************************************/
+typedef struct
+{
+    uint8_t address;
+    bool present;           // On the bus (it answers)
+    uint8_t slot;           // CMD_RC_SLOT_NONE if it is not registered
+    uint32_t rgb[3];
+    uint32_t blink_ms;
+    bool active;
+    uint8_t dbg_led;
+    colour_cal_t calib;
+}_test_node_t;
+
+typedef struct
+{
+    uint8_t dst;
+    uint8_t data[RGB_BTN_MSG_MAX_DATA_LEN];
+    size_t len;
+}_test_log_t;
+
+/*******************************************************************************
+Global (public) variables
+ *******************************************************************************/
+extern bool sim_console_verbose;
+extern uint8_t sim_bus[];
+extern size_t sim_bus_len;
+extern void (*sim_delay_hook)(void);
+extern int sim_game_evt_cnt[];
+extern int sim_nvs_writes(const char * key);
+void sim_uart_rx(const uint8_t * data, size_t len);
+
+/*******************************************************************************
+Local function prototypes
+ *******************************************************************************/
+
+/*! \brief Does the work of the comms task and the nodes: sends whatever is in the TX queue onto the bus, where
+ * the nodes act on it (and answer)
+ */
+void _test_bus_service(void);
+
+/*! \brief Feeds a byte from the bus to the nodes' receiver (the framing, the CRC and the reassembly)
+ */
+void _test_bus_byte(uint8_t data);
+
+/*! \brief A msg from the master, as it was put back together: logged, and handed to the node(s) it is meant for
+ */
+void _test_msg(const comms_msg_t * msg, size_t len);
+
+/*! \brief Executes a command on a node
+ * \param payload The payload following the command
+ * \param len The bytes left in the msg
+ * \param resp If not NULL, where the response data (cmd, resp code and payload) is put
+ * \return The payload length of the command
+ */
+size_t _test_node_exec(_test_node_t * node, master_command_t cmd, const uint8_t * payload, size_t len, uint8_t * resp, size_t * resp_len);
+
+/*! \brief Sends a msg from a node to the master (in as many frames as it needs)
+ */
+void _test_node_tx(const _test_node_t * node, uint8_t id, const uint8_t * data, size_t len);
+
+/*! \brief Sets up the bus with cnt nodes, all unregistered and off
+ */
+void _test_nodes_init(int cnt);
+
+/*! \brief Clears the log of msgs sent by the master
+ */
+void _test_log_clear(void);
+
+/*! \brief Counts the msgs in the log
+ * \param bcst true to count the broadcasts, false to count the direct msgs
+ */
+int _test_log_cnt(bool bcst);
+
+/*! \brief Finds the nth broadcast in the log
+ * \return The log entry, NULL if there is no such broadcast
+ */
+const _test_log_t * _test_log_bcst(int n);
+
+/*! \brief The address mask of a broadcast (0 if it is not a masked broadcast)
+ */
+uint32_t _test_bcst_mask(const _test_log_t * bcst);
+
+/*! \brief Checks if a broadcast contains a command (after the address mask)
+ */
+bool _test_bcst_has(const _test_log_t * bcst, master_command_t cmd);
+
+/*! \brief Checks if the nodes in mask are in a state
+ */
+bool _test_nodes_in(uint32_t mask, const node_state_t * state);
+
+/*! \brief Checks if the nodes on the bus are in the slots given (CMD_RC_SLOT_NONE for an unregistered node), and
+ * registered as such by the master (with their calibration)
+ */
+bool _test_slots_are(const uint8_t * slots);
+
+/*! \brief Simulates a reset of the master (the nodes keep their slots)
+ * \return The time nodes_register_warm() took after it, in ms
+ */
+uint32_t _test_warm_start(bool * ok);
+
+/*! \brief Reports the outcome of a check
+ */
+void _test_check(bool ok, const char * name, const char * fmt, ...);
+
+/*******************************************************************************
+Local variables
+ *******************************************************************************/
+static int _test_fails = 0;
+
+static _test_node_t _test_nodes[RGB_BTN_MAX_NODES];
+static int _test_node_cnt = 0;
+
+static _test_log_t _test_log[TEST_LOG_MAX];
+static int _test_log_len = 0;
+
+/* The nodes' receiver */
+static comms_frame_t _test_frame;
+static size_t _test_frame_len = 0;
+static bool _test_frame_busy = false;
+static bool _test_frame_escaping = false;
+static comms_msg_t _test_rx_msg;
+static size_t _test_rx_len = 0;
+
+static const node_state_t _test_state_rgb = {.rgb_colour = {0xFF0000, 0x00FF00, 0x0000FF}, .blink_ms = 250, .active = false};
+static const node_state_t _test_state_active = {.rgb_colour = {0xFFFF00, 0x000000, 0x00FFFF}, .blink_ms = 100, .active = true};
+
+/*******************************************************************************
+Local (private) Functions
+ *******************************************************************************/
+void _test_bus_service(void)
+{
+    static bool _busy = false;
+    comms_msg_queue_item_t _item;
+
+    //A node's answer could be waited for from in here (e.g. by the comms task for a quiet bus)
+    if (_busy)
+        return;
+    _busy = true;
+
+    while (xQueueReceive(_comms.rs485.tx_msg_queue, &_item, 0) == pdTRUE)
+        _tx_msg_handler(&_item);
+
+    for (size_t i = 0; i < sim_bus_len; i++)
+        _test_bus_byte(sim_bus[i]);
+    sim_bus_len = 0;
+
+    _busy = false;
+}
+
+void _test_bus_byte(uint8_t data)
+{
+    if (data == STX)
+    {
+        _test_frame_len = 0;
+        _test_frame_busy = true;
+        _test_frame_escaping = false;
+        return;
+    }
+    if (!_test_frame_busy)
+        return;
+    if (data == DLE)
+    {
+        _test_frame_escaping = true;
+        return;
+    }
+    if (data != ETX)
+    {
+        if (_test_frame_len < sizeof(comms_frame_t))
+            ((uint8_t *)&_test_frame)[_test_frame_len++] = (_test_frame_escaping)? (data ^ DLE) : data;
+        _test_frame_escaping = false;
+        return;
+    }
+
+    //A whole frame
+    _test_frame_busy = false;
+    if ((_test_frame_len <= sizeof(comms_msg_hdr_t)) || (crc8_n(0, (uint8_t *)&_test_frame, _test_frame_len) != 0))
+        return;
+
+    if ((_test_frame.hdr.frag & COMMS_FRAG_INDEX_MASK) == 0)
+    {
+        memcpy(&_test_rx_msg.hdr, &_test_frame.hdr, sizeof(comms_msg_hdr_t));
+        _test_rx_len = 0;
+    }
+    memcpy(&_test_rx_msg.data[_test_rx_len], _test_frame.data, _test_frame.hdr.len);
+    _test_rx_len += _test_frame.hdr.len;
+    if (!(_test_frame.hdr.frag & COMMS_FRAG_MORE))
+        _test_msg(&_test_rx_msg, _test_rx_len);
+}
+
+void _test_msg(const comms_msg_t * msg, size_t len)
+{
+    if (_test_log_len < TEST_LOG_MAX)
+    {
+        _test_log[_test_log_len].dst = msg->hdr.dst;
+        memcpy(_test_log[_test_log_len].data, msg->data, len);
+        _test_log[_test_log_len].len = len;
+        _test_log_len++;
+    }
+
+    for (int n = 0; n < _test_node_cnt; n++)
+    {
+        _test_node_t * node = &_test_nodes[n];
+        uint8_t resp[RGB_BTN_MSG_MAX_DATA_LEN];
+        size_t resp_len = 0;
+        size_t i = 0;
+
+        if (!node->present)
+            continue;
+
+        if (msg->hdr.dst == node->address)
+        {
+            while (i < len)
+            {
+                master_command_t cmd = (master_command_t)msg->data[i++];
+                i += _test_node_exec(node, cmd, &msg->data[i], len - i, resp, &resp_len);
+            }
+            _test_node_tx(node, msg->hdr.id, resp, resp_len);
+        }
+        else if ((msg->hdr.dst == ADDR_BROADCAST) && (msg->data[0] == cmd_roll_call) && (len >= 2))
+        {
+            //All answer (and forget their slots), only the unregistered answer, or only the registered answer
+            bool answer = (msg->data[1] == CMD_RC_PAYLOAD_ALL) ||
+                          ((msg->data[1] == CMD_RC_PAYLOAD_UNREG) && (node->slot == CMD_RC_SLOT_NONE)) ||
+                          ((msg->data[1] == CMD_RC_PAYLOAD_CHECK) && (node->slot != CMD_RC_SLOT_NONE));
+            if (msg->data[1] == CMD_RC_PAYLOAD_ALL)
+                node->slot = CMD_RC_SLOT_NONE;
+            if (!answer)
+                continue;
+            resp[0] = cmd_roll_call;
+            resp[1] = resp_ok;
+            resp[2] = node->slot;
+            _test_node_tx(node, msg->hdr.id, resp, 3);
+        }
+        else if ((msg->hdr.dst == ADDR_BROADCAST) && (msg->data[0] == cmd_bcast_address_mask) && (len >= 5))
+        {
+            uint32_t mask;
+            memcpy(&mask, &msg->data[1], sizeof(uint32_t));
+            if ((node->slot == CMD_RC_SLOT_NONE) || (!(mask & BIT_POS(node->slot))))
+                continue;
+            for (i = 5; i < len; )
+            {
+                master_command_t cmd = (master_command_t)msg->data[i++];
+                i += _test_node_exec(node, cmd, &msg->data[i], len - i, NULL, NULL);
+            }
+        }
+    }
+}
+
+size_t _test_node_exec(_test_node_t * node, master_command_t cmd, const uint8_t * payload, size_t len, uint8_t * resp, size_t * resp_len)
+{
+    size_t mosi = cmd_mosi_sz(cmd);
+    size_t miso = cmd_miso_sz(cmd);
+    uint32_t value = 0;
+
+    if ((!cmd_is_known(cmd)) || (mosi > len) || (cmd == cmd_set_rgb_scatter) || (cmd == cmd_set_sequence))
+        return len; //Not one the test needs, the rest of the msg is skipped
+
+    memcpy(&value, payload, MIN(mosi, sizeof(uint32_t)));
+    switch (cmd)
+    {
+        case cmd_set_rgb_0:
+        case cmd_set_rgb_1:
+        case cmd_set_rgb_2:         node->rgb[cmd - cmd_set_rgb_0] = value; break;
+        case cmd_set_blink:         node->blink_ms = value;                 break;
+        case cmd_set_switch:        node->active = (value == CMD_SW_PAYLOAD_ACTIVATE); break;
+        case cmd_set_dbg_led:       node->dbg_led = (uint8_t)value;         break;
+        case cmd_set_bitmask_index: node->slot = (uint8_t)value;            break;
+        default:                                                            break;
+    }
+
+    if (resp != NULL)
+    {
+        resp[(*resp_len)++] = cmd;
+        resp[(*resp_len)++] = resp_ok;
+        memset(&resp[*resp_len], 0, miso);
+        if (cmd == cmd_get_calib)
+            memcpy(&resp[*resp_len], &node->calib, sizeof(colour_cal_t));
+        *resp_len += miso;
+    }
+    return mosi;
+}
+
+void _test_node_tx(const _test_node_t * node, uint8_t id, const uint8_t * data, size_t len)
+{
+    size_t offset = 0;
+    uint8_t frag = 0;
+
+    do
+    {
+        comms_frame_t frame;
+        uint8_t bytes[2 + (2 * RGB_BTN_FRAME_MAX_LEN)];
+        size_t frame_len = MIN(len - offset, RGB_BTN_FRAME_MAX_DATA_LEN);
+        size_t bytes_len = 0;
+        uart_event_t event = {.type = UART_DATA};
+
+        frame.hdr.version = RGB_BTN_MSG_VERSION;
+        frame.hdr.id = id;
+        frame.hdr.src = node->address;
+        frame.hdr.dst = ADDR_MASTER;
+        frame.hdr.frag = frag | (((offset + frame_len) < len)? COMMS_FRAG_MORE : 0);
+        frame.hdr.len = (uint8_t)frame_len;
+        memcpy(frame.data, &data[offset], frame_len);
+        frame.data[frame_len] = crc8_n(0, (uint8_t *)&frame, sizeof(comms_msg_hdr_t) + frame_len);
+
+        bytes[bytes_len++] = STX;
+        for (size_t i = 0; i < (sizeof(comms_msg_hdr_t) + frame_len + sizeof(uint8_t)); i++)
+        {
+            uint8_t d = ((uint8_t *)&frame)[i];
+            if ((d == STX) || (d == DLE) || (d == ETX))
+            {
+                bytes[bytes_len++] = DLE;
+                d ^= DLE;
+            }
+            bytes[bytes_len++] = d;
+        }
+        bytes[bytes_len++] = ETX;
+
+        sim_uart_rx(bytes, bytes_len);
+        event.size = bytes_len;
+        _rx_msg_handler(&event);
+
+        offset += frame_len;
+        frag++;
+    } while (offset < len);
+}
+
+void _test_nodes_init(int cnt)
+{
+    memset(_test_nodes, 0, sizeof(_test_nodes));
+    for (int i = 0; i < cnt; i++)
+    {
+        _test_nodes[i].address = TEST_NODE_ADDR + i;
+        _test_nodes[i].present = true;
+        _test_nodes[i].slot = CMD_RC_SLOT_NONE;
+        _test_nodes[i].calib.red = (uint8_t)(0xF0 + i);
+        _test_nodes[i].calib.green = 0xFF;
+        _test_nodes[i].calib.blue = 0xFF;
+    }
+    _test_node_cnt = cnt;
+}
+
+void _test_log_clear(void)
+{
+    _test_log_len = 0;
+}
+
+int _test_log_cnt(bool bcst)
+{
+    int cnt = 0;
+
+    for (int i = 0; i < _test_log_len; i++)
+        if ((_test_log[i].dst == ADDR_BROADCAST) == bcst)
+            cnt++;
+    return cnt;
+}
+
+const _test_log_t * _test_log_bcst(int n)
+{
+    for (int i = 0; i < _test_log_len; i++)
+        if ((_test_log[i].dst == ADDR_BROADCAST) && (n-- == 0))
+            return &_test_log[i];
+    return NULL;
+}
+
+uint32_t _test_bcst_mask(const _test_log_t * bcst)
+{
+    uint32_t mask = 0;
+
+    if ((bcst != NULL) && (bcst->len >= 5) && (bcst->data[0] == cmd_bcast_address_mask))
+        memcpy(&mask, &bcst->data[1], sizeof(uint32_t));
+    return mask;
+}
+
+bool _test_bcst_has(const _test_log_t * bcst, master_command_t cmd)
+{
+    if (bcst == NULL)
+        return false;
+    for (size_t i = 5; i < bcst->len; i += cmd_mosi_sz((master_command_t)bcst->data[i]) + 1)
+        if (bcst->data[i] == cmd)
+            return true;
+    return false;
+}
+
+bool _test_nodes_in(uint32_t mask, const node_state_t * state)
+{
+    for (int i = 0; i < _test_node_cnt; i++)
+    {
+        const _test_node_t * node = &_test_nodes[i];
+        if ((node->slot == CMD_RC_SLOT_NONE) || (!(mask & BIT_POS(node->slot))))
+            continue;
+        for (int c = 0; c < 3; c++)
+            if (node->rgb[c] != (state->rgb_colour[c] & 0x00FFFFFF))
+                return false;
+        if ((node->blink_ms != state->blink_ms) || (node->active != state->active))
+            return false;
+    }
+    return true;
+}
+
+bool _test_slots_are(const uint8_t * slots)
+{
+    for (int i = 0; i < _test_node_cnt; i++)
+    {
+        const _test_node_t * node = &_test_nodes[i];
+        if (node->slot != slots[i])
+            return false;
+        if (node->slot == CMD_RC_SLOT_NONE)
+            continue;
+        if ((node->slot >= node_count()) || (nodes.list[node->slot].address != node->address) ||
+            (memcmp(&nodes.list[node->slot].btn.calib, &node->calib, sizeof(colour_cal_t)) != 0))
+            return false;
+    }
+    return true;
+}
+
+uint32_t _test_warm_start(bool * ok)
+{
+    int64_t start_us;
+
+    memset(&nodes, 0, sizeof(nodes));
+    _test_log_clear();
+    start_us = esp_timer_get_time();
+    *ok = nodes_register_warm();
+    return (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+}
+
+void _test_check(bool ok, const char * name, const char * fmt, ...)
+{
+    va_list args;
+
+    if (!ok)
+        _test_fails++;
+    printf("%s  %-12s ", ok? "pass" : "FAIL", name);
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+    printf("\n");
+}
+
+static void _test_register(void)
+{
+    bool ok;
+
+    _test_nodes_init(TEST_NODES);
+    ok = nodes_register_all();
+    _test_check(ok && (node_count() == TEST_NODES) && (_test_nodes[TEST_NODES - 1].slot == TEST_NODES - 1), "register",
+        "roll-call: %d/%d nodes, the last in slot %d", node_count(), TEST_NODES, _test_nodes[TEST_NODES - 1].slot);
+}
+
+static void _test_reset(void)
+{
+    const uint32_t all = BIT_POS(TEST_NODES) - 1;
+    const _test_log_t * bcst;
+    int ret;
+
+    //Nothing is known about the nodes' switches after the registration, so each is told (and has to answer)
+    _test_log_clear();
+    ret = nodes_reset(NODES_MASK_ALL);
+    _test_bus_service(); //A broadcast is not waited for
+    _test_check((ret == TEST_NODES) && (_test_log_cnt(true) == 0) && (_test_log_cnt(false) == TEST_NODES) && _test_nodes_in(all, &node_state_off),
+        "unknown", "nodes_reset() = %d: %d bcst, %d direct", ret, _test_log_cnt(true), _test_log_cnt(false));
+
+    //Now they are known to be inactive, so they all share a broadcast
+    _test_log_clear();
+    ret = nodes_apply_state(NODES_MASK_ALL, &_test_state_rgb);
+    _test_bus_service(); //A broadcast is not waited for
+    bcst = _test_log_bcst(0);
+    _test_check((ret == 1) && (_test_log_cnt(true) == 1) && (_test_log_cnt(false) == 0) && (_test_bcst_mask(bcst) == all) &&
+        _test_bcst_has(bcst, cmd_set_blink) && _test_bcst_has(bcst, cmd_set_rgb_0) && _test_bcst_has(bcst, cmd_set_rgb_1) &&
+        _test_bcst_has(bcst, cmd_set_rgb_2) && _test_bcst_has(bcst, cmd_set_switch) && (!_test_bcst_has(bcst, cmd_set_dbg_led)) &&
+        _test_nodes_in(all, &_test_state_rgb),
+        "shared", "nodes_apply_state() = %d: %d bcst (mask 0x%02X, %d bytes), %d direct",
+        ret, _test_log_cnt(true), _test_bcst_mask(bcst), (bcst != NULL)? (int)bcst->len : 0, _test_log_cnt(false));
+
+    //The switch of an active node changes, so it is told directly (a game left targets of its own as well)
+    nodes_apply_state(BIT_POS(2), &_test_state_active);
+    node_target_set_rgb(0, 0, 0x123456);
+    node_target_set_blink(1, 500);
+    node_target_set_active(4, true);
+    _test_log_clear();
+    ret = nodes_reset(NODES_MASK_ALL);
+    _test_bus_service(); //A broadcast is not waited for
+    bcst = _test_log_bcst(0);
+    _test_check((ret == 2) && (_test_log_cnt(true) == 1) && (_test_log_cnt(false) == 1) && (_test_bcst_mask(bcst) == (all & ~BIT_POS(2))) &&
+        (_test_log[_test_log_len - 1].dst == _test_nodes[2].address) && _test_nodes_in(all, &node_state_off),
+        "switch", "node 2 active, nodes_reset() = %d: %d bcst (mask 0x%02X), %d direct",
+        ret, _test_log_cnt(true), _test_bcst_mask(bcst), _test_log_cnt(false));
+
+    //The targets followed (the game's too), so there is nothing left to flush
+    _test_log_clear();
+    ret = nodes_target_flush();
+    _test_bus_service(); //A broadcast is not waited for
+    _test_check((ret == 0) && (_test_log_len == 0), "targets", "nodes_target_flush() after a reset = %d: %d msgs", ret, _test_log_len);
+
+    //Only the nodes in the mask
+    _test_log_clear();
+    ret = nodes_apply_state(BIT_POS(1) | BIT_POS(4), &_test_state_rgb);
+    _test_bus_service(); //A broadcast is not waited for
+    _test_check((ret == 1) && (_test_bcst_mask(_test_log_bcst(0)) == (BIT_POS(1) | BIT_POS(4))) &&
+        _test_nodes_in(BIT_POS(1) | BIT_POS(4), &_test_state_rgb) && _test_nodes_in(all & ~(BIT_POS(1) | BIT_POS(4)), &node_state_off),
+        "subset", "nodes 1 and 4 = %d: mask 0x%02X, the others still off", ret, _test_bcst_mask(_test_log_bcst(0)));
+
+    _test_log_clear();
+    ret = nodes_reset(0) + nodes_reset(BIT_POS(TEST_NODES) | BIT_POS(20));
+    _test_bus_service(); //A broadcast is not waited for
+    _test_check((ret == 0) && (_test_log_len == 0), "none", "no registered nodes in the mask = %d: %d msgs", ret, _test_log_len);
+}
+
+static void _test_clear_all(void)
+{
+    const uint32_t all = BIT_POS(TEST_NODES) - 1;
+    const _test_log_t * bcst;
+    bool dbg_off = true;
+
+    nodes_apply_state(BIT_POS(3), &_test_state_active);
+    for (int i = 0; i < TEST_NODES; i++)
+        _test_nodes[i].dbg_led = dbg_led_blink;
+
+    _test_log_clear();
+    bcst_msg_clear_all();
+    _test_bus_service(); //A broadcast is not waited for
+    bcst = _test_log_bcst(0);
+    for (int i = 0; i < TEST_NODES; i++)
+        dbg_off &= (_test_nodes[i].dbg_led == dbg_led_off);
+    _test_check((_test_log_cnt(true) == 1) && (_test_log_cnt(false) == 1) && (_test_bcst_mask(bcst) == (all & ~BIT_POS(3))) &&
+        _test_bcst_has(bcst, cmd_set_dbg_led) && dbg_off && _test_nodes_in(all, &node_state_off),
+        "clear all", "node 3 active: %d bcst (mask 0x%02X), %d direct, debug LEDs %s",
+        _test_log_cnt(true), _test_bcst_mask(bcst), _test_log_cnt(false), dbg_off? "off" : "not off");
+}
+
+static void _test_lost(void)
+{
+    const uint32_t all = BIT_POS(TEST_NODES) - 1;
+    int lost = sim_game_evt_cnt[game_evt_node_lost];
+    int ret;
+
+    //The last node is active, and then goes quiet
+    nodes_apply_state(BIT_POS(TEST_NODES - 1), &_test_state_active);
+    _test_nodes[TEST_NODES - 1].present = false;
+    _test_log_clear();
+    ret = nodes_reset(NODES_MASK_ALL);
+    _test_bus_service(); //A broadcast is not waited for
+    _test_check((ret == -1) && (node_count() == TEST_NODES - 1) && (sim_game_evt_cnt[game_evt_node_lost] == lost + 1) &&
+        (_test_bcst_mask(_test_log_bcst(0)) == (all & ~BIT_POS(TEST_NODES - 1))) && _test_nodes_in(all & ~BIT_POS(TEST_NODES - 1), &node_state_off),
+        "lost", "node %d silent: nodes_reset() = %d, %d/%d nodes left, the others off", TEST_NODES - 1, ret, node_count(), TEST_NODES);
+    _test_nodes[TEST_NODES - 1].present = true;
+}
+
+static void _test_registry(void)
+{
+    static const uint8_t _slots[TEST_NODES] = {0, 1, 2, 3, 4, 5};
+    node_registry_t reg;
+    bool same;
+    bool ok;
+
+    //Saved by the 1st registration (_test_register()), the same nodes again are not written
+    _test_nodes_init(TEST_NODES);
+    ok = nodes_register_all();
+    same = _registry_load(&reg) && (reg.cnt == TEST_NODES);
+    for (int i = 0; (i < TEST_NODES) && same; i++)
+        same = (reg.list[i].address == _test_nodes[i].address) && (reg.list[i].calib.red == _test_nodes[i].calib.red);
+    _test_check(ok && same && _test_slots_are(_slots) && (sim_nvs_writes(NODES_NVS_KEY) == 1), "saved",
+        "%d nodes in the registry (%s), written %d time(s) by 2 roll-calls", reg.cnt, same? "as registered" : "not as registered",
+        sim_nvs_writes(NODES_NVS_KEY));
+}
+
+static void _test_warm(void)
+{
+    static const uint8_t _slots[TEST_NODES] = {0, 1, 2, 3, 4, 5};
+    static const uint8_t _slots_moved[TEST_NODES] = {0, 1, 5, 2, 3, 4};
+    const _test_log_t * bcst;
+    int joined = sim_game_evt_cnt[game_evt_node_joined];
+    int writes = sim_nvs_writes(NODES_NVS_KEY);
+    uint32_t ms;
+    bool ok;
+
+    //The nodes are where we left them, so they only have to say so
+    ms = _test_warm_start(&ok);
+    bcst = _test_log_bcst(0);
+    _test_check(ok && _test_slots_are(_slots) && (_test_log_cnt(true) == 1) && (_test_log_cnt(false) == 0) &&
+        (bcst->data[0] == cmd_roll_call) && (bcst->data[1] == CMD_RC_PAYLOAD_CHECK) && (ms < ROLL_CALL_TIMOUT_MS(ADDR_BROADCAST, ADDR_BROADCAST)) &&
+        (sim_game_evt_cnt[game_evt_node_joined] == joined + TEST_NODES) && (sim_nvs_writes(NODES_NVS_KEY) == writes),
+        "warm", "%d/%d nodes restored in %u ms: %d bcst, %d direct, %d joined", node_count(), TEST_NODES, ms,
+        _test_log_cnt(true), _test_log_cnt(false), sim_game_evt_cnt[game_evt_node_joined] - joined);
+
+    //Node 2 was reset too: 0 and 1 are restored, 3 to 5 move up a slot, and 2 is found by the roll-call of the unregistered
+    _test_nodes[2].slot = CMD_RC_SLOT_NONE;
+    ms = _test_warm_start(&ok);
+    bcst = _test_log_bcst(1);
+    _test_check(ok && _test_slots_are(_slots_moved) && (_test_log_cnt(true) == 2) && (_test_log_cnt(false) == TEST_NODES - 2) &&
+        (_test_log_bcst(0)->data[1] == CMD_RC_PAYLOAD_CHECK) && (bcst != NULL) && (bcst->data[1] == CMD_RC_PAYLOAD_UNREG) &&
+        (sim_nvs_writes(NODES_NVS_KEY) == writes + 1),
+        "missing", "node 2 reset: %d/%d nodes in %u ms, node 2 in slot %d: %d bcst, %d direct", node_count(), TEST_NODES, ms,
+        _test_nodes[2].slot, _test_log_cnt(true), _test_log_cnt(false));
+
+    //Nodes 0 and 1 answer from each other's slots, so none of them is where we left it, and all are registered directly
+    _test_nodes[0].slot = 1;
+    _test_nodes[1].slot = 0;
+    ms = _test_warm_start(&ok);
+    _test_check(ok && _test_slots_are(_slots) && (_test_log_cnt(true) == 1) && (_test_log_cnt(false) == TEST_NODES),
+        "moved", "nodes 0 and 1 swapped: %d/%d nodes in %u ms: %d bcst, %d direct", node_count(), TEST_NODES, ms,
+        _test_log_cnt(true), _test_log_cnt(false));
+
+    //Nothing saved (or the NVS was erased), so we have to enumerate the bus
+    nvs_flash_erase();
+    nvs_flash_init();
+    ms = _test_warm_start(&ok);
+    bcst = _test_log_bcst(0);
+    _test_check(ok && _test_slots_are(_slots) && (bcst->data[0] == cmd_roll_call) && (bcst->data[1] == CMD_RC_PAYLOAD_ALL) &&
+        (sim_nvs_writes(NODES_NVS_KEY) == 1),
+        "no registry", "%d/%d nodes in %u ms: a full roll-call", node_count(), TEST_NODES, ms);
+}
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+int main(int argc, char * argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-v"))
+            sim_console_verbose = true;
+    }
+
+    //What _comms_main_func() sets up, the test does the work of the task (and the nodes) itself
+    _comms.rs485.tx_msg_queue = xQueueCreate(COMMS_MSG_TX_Q_LEN, sizeof(comms_msg_queue_item_t));
+    _comms.rs485.rx_msg_queue = xQueueCreate(COMMS_MSG_RX_Q_LEN, sizeof(comms_msg_queue_item_t));
+    sim_delay_hook = _test_bus_service;
+    nvs_flash_init();
+
+    printf("Nodes: %d nodes on the bus\n", TEST_NODES);
+    _test_register();
+    _test_reset();
+    _test_clear_all();
+    _test_lost();
+    _test_registry();
+    _test_warm();
+
+    printf("%s (%d failed)\n", (_test_fails == 0)? "PASSED" : "FAILED", _test_fails);
+    return _test_fails;
+}
+
+#undef PRINTF_TAG
+/*************************** END OF FILE *************************************/
@@ -0,0 +1,119 @@
+/*******************************************************************************
+
+Module:     sim_master.c
+Purpose:    This file contains the host stand-ins for the nodes test
+Author:     Rudolph van Niekerk
+
+What nodes.c needs on top of the comms task (tools/comms_test/sim_uart.c) and
+the NVS (tools/rstats_test/sim_nvs.c): the poll timers and stopwatches (on the
+simulated clock of sim_uart.c, which only moves with a delay), the random
+numbers, the game events (counted in sim_game_evt_cnt[], so the test can tell
+which nodes joined or were lost) and the telemetry (always off).
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "defines.h"
+#include "sys_utils.h"
+#include "sys_timers.h"
+#include "task_console.h"
+#include "task_game.h"
+#include "sys_telemetry.h"
+
+/*******************************************************************************
+Global (public) variables
+ *******************************************************************************/
+int sim_game_evt_cnt[game_evt_txn_done + 1];    /* The game events posted so far, by type */
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+uint64_t sys_poll_tmr_ms(void)
+{
+    return (uint64_t)(esp_timer_get_time() / 1000);
+}
+
+void sys_poll_tmr_start(Timer_ms_t *t, uint32_t interval, bool auto_reload)
+{
+    t->ms_expire = sys_poll_tmr_ms() + (uint64_t)interval;
+    t->ms_period = interval;
+    t->expired = false;
+    t->reload_mode = auto_reload;
+    t->started = true;
+}
+
+void sys_poll_tmr_stop(Timer_ms_t *t)
+{
+    t->started = false;
+}
+
+bool sys_poll_tmr_expired(Timer_ms_t *t)
+{
+    uint64_t now_ms = sys_poll_tmr_ms();
+
+    if (!(t->started))
+        return false;
+    if (now_ms >= t->ms_expire)
+    {
+        if (t->reload_mode)
+            t->ms_expire = now_ms - ((now_ms - t->ms_expire) % ((uint64_t)t->ms_period)) + (uint64_t)t->ms_period;
+        else
+            t->expired = true;
+        return true;
+    }
+    return t->expired;
+}
+
+bool sys_poll_tmr_started(Timer_ms_t *t)
+{
+    return t->started;
+}
+
+bool sys_poll_tmr_is_running(Timer_ms_t *t)
+{
+    return (t->started)? (sys_poll_tmr_ms() < t->ms_expire) : false;
+}
+
+uint32_t sys_stopwatch_ms_stop(Stopwatch_ms_t* sw)
+{
+    uint32_t elapsed = sys_stopwatch_ms_lap(sw);
+
+    sw->running = false;
+    return elapsed;
+}
+
+uint32_t esp_random(void)
+{
+    return (uint32_t)rand();
+}
+
+bool game_event_post(game_evt_type_t type, int slot, uint32_t value)
+{
+    sim_game_evt_cnt[type]++;
+    return true;
+}
+
+bool telemetry_enabled(void)
+{
+    return false;
+}
+
+void telemetry_record(tlm_type_t type, const uint32_t * fields, int cnt) {}
+
+int iprintf(const char * fmt, ...)
+{
+    return 0;
+}
+
+/*************************** END OF FILE *************************************/
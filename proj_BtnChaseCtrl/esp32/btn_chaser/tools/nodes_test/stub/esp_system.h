@@ -0,0 +1,12 @@
+/*****************************************************************************
+
+esp_system.h
+
+Host stand-in for the ESP-IDF header of the same name. Nothing in it is used
+by nodes.c (see tools/nodes_test/nodes_test.c).
+
+******************************************************************************/
+#ifndef __sim_esp_system_H__
+#define __sim_esp_system_H__
+
+#endif /* __sim_esp_system_H__ */
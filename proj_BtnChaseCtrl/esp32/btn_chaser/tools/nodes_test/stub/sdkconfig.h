@@ -0,0 +1,16 @@
+/*****************************************************************************
+
+sdkconfig.h
+
+Host stand-in for the ESP-IDF project configuration (see
+tools/nodes_test/nodes_test.c). None of the settings are used by nodes.c,
+but it does use newlib's integer-only iprintf(), which the host's stdio.h
+does not declare (stdio.h is always included before this).
+
+******************************************************************************/
+#ifndef __sim_sdkconfig_H__
+#define __sim_sdkconfig_H__
+
+int iprintf(const char * fmt, ...);
+
+#endif /* __sim_sdkconfig_H__ */
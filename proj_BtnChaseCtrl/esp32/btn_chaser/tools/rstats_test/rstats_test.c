@@ -0,0 +1,543 @@
+/*******************************************************************************
+
+Module:     rstats_test.c
+Purpose:    This file contains the host test for the reaction time statistics
+Author:     Rudolph van Niekerk
+
+Feeds (seeded) reaction times into the aggregates and sessions of
+sys_rstats.c and checks what comes out against the exact values, worked out
+here from the samples themselves. Checks:
+  - The count, mean, sd, min and max of an aggregate are the exact ones (the
+    mean and sd to within the 1 ms they are rounded to).
+  - The P50/P90/P99 from the sketch are within a bucket (15%) of the exact
+    quantiles, for an even spread, a bell and a spread with a long tail of
+    slow presses. No samples gives 0, a single sample gives that sample, and
+    samples below the first and above the last bound are still counted (in
+    the first and the last bucket, which end at the min and the max seen).
+  - A session adds every press to the session and the player (if there is
+    one), and to the node by its address: a node that moves slots keeps its
+    statistics, and the presses before it was synced are counted.
+  - The end of a session saves it to "sNN" and bumps "seq", over more than
+    RSTATS_NVS_SESSIONS sessions (the oldest is overwritten). A session
+    without presses is not saved.
+  - The leaderboard is kept sorted on the mean (a tie goes after the ones
+    already there), holds the best RSTATS_BOARD_LEN, leaves out players with
+    fewer than RSTATS_BOARD_MIN_CNT presses and is only written when it
+    changed. A record of the wrong size or version is ignored.
+  - A truncated NVS partition is erased and used, one that cannot be opened
+    leaves the statistics in RAM only.
+  - "rstat hist" lists the last RSTATS_NVS_SESSIONS sessions, "rstat board"
+    the leaderboard.
+
+The statistics are included (not linked), so that the test can get to their
+local functions and state. The NVS, the nodes, the games, the poll timer and
+the console are stood in for by stub/, tools/game_sim/stub/, sim_nvs.c and
+sim_rstats.c.
+
+Build (from btn_chaser/, with any host C compiler):
+    gcc -O2 -o rstats_test -I tools/rstats_test/stub -I tools/game_sim/stub \
+        -I main tools/rstats_test/rstats_test.c tools/rstats_test/sim_nvs.c \
+        tools/rstats_test/sim_rstats.c -lm
+
+Use:
+    ./rstats_test [-v]
+    -v prints the trace of the statistics. The exit code is the number of
+    failed checks (0 if all passed).
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "sys_rstats.c"
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#ifdef PRINTF_TAG
+#undef PRINTF_TAG
+#endif
+#define PRINTF_TAG ("Test") /* This must be undefined at the end of the file*/
+
+#define TEST_SAMPLES_MAX    (2000)
+
+/*******************************************************************************
+Local structure
+ *******************************************************************************/
+typedef enum
+{
+    test_spread_even,       // 150 to 900 ms
+    test_spread_bell,       // Around 450 ms (the sum of 4 even spreads)
+    test_spread_tail,       // Mostly around 300 ms, 1 in 8 a slow 800 to 2500 ms
+} _test_spread_t;
+
+/*******************************************************************************
+Global (public) variables
+ *******************************************************************************/
+extern bool sim_console_verbose;
+extern int sim_console_lines;
+extern esp_err_t sim_nvs_init_err;
+extern bool sim_nvs_broken;
+extern uint64_t sim_now_ms;
+extern uint8_t sim_node_addr[];
+extern float sim_node_factor[];
+int sim_nvs_writes(const char * key);
+void sim_console_args_set(const char * arg);
+
+/*******************************************************************************
+Local function prototypes
+ *******************************************************************************/
+
+/*! \brief A seeded (repeatable) random number
+ * \return 0 to 0x7FFF
+ */
+uint32_t _test_rand(void);
+
+/*! \brief Fills a buffer with reaction times
+ * \param samples The buffer
+ * \param cnt The number of samples
+ * \param spread How the samples are spread
+ */
+void _test_samples(uint32_t * samples, int cnt, _test_spread_t spread);
+
+/*! \brief The exact quantile of a set of (sorted) samples, with the rank worked out as the sketch does
+ */
+uint32_t _test_exact_quantile(const uint32_t * sorted, int cnt, uint32_t pct);
+
+/*! \brief Runs a session in which each player presses the same reaction time a number of times
+ * \param game The game played
+ * \param mean_ms The reaction time of each player (0 if the player does not press)
+ * \param cnt The presses of each player
+ */
+void _test_session_run(int game, const uint32_t mean_ms[RSTATS_PLAYERS_MAX], const int cnt[RSTATS_PLAYERS_MAX]);
+
+/*! \brief Reads the leaderboard from NVS
+ * \return true if it is there
+ */
+bool _test_board_read(rstats_board_t * board);
+
+/*! \brief Runs the console command "rstat" (with a single argument, or none)
+ * \return The lines it printed
+ */
+int _test_console(const char * arg);
+
+/*! \brief Checks the statistics of an aggregate against the exact ones of the samples
+ */
+void _test_agg_spread(const char * name, _test_spread_t spread, int cnt);
+
+/*! \brief Checks the quantiles with no samples, a single sample and samples out of the range of the bounds
+ */
+void _test_agg_edges(void);
+
+/*! \brief Checks that a press is added to the session, the player and the node
+ */
+void _test_session(void);
+
+/*! \brief Checks the session records saved to NVS
+ */
+void _test_nvs_sessions(void);
+
+/*! \brief Checks the leaderboard
+ */
+void _test_board(void);
+
+/*! \brief Checks the NVS partition coming up truncated, and not at all
+ */
+void _test_nvs_init(void);
+
+/*! \brief Reports the outcome of a check
+ */
+void _test_check(bool ok, const char * name, const char * fmt, ...);
+
+/*******************************************************************************
+Local variables
+ *******************************************************************************/
+static int _test_fails = 0;
+static uint32_t _test_seed = 1;
+
+/*******************************************************************************
+Local (private) Functions
+ *******************************************************************************/
+uint32_t _test_rand(void)
+{
+    _test_seed = (_test_seed * 1103515245) + 12345;
+    return (_test_seed >> 16) & 0x7FFF;
+}
+
+void _test_samples(uint32_t * samples, int cnt, _test_spread_t spread)
+{
+    for (int i = 0; i < cnt; i++)
+    {
+        switch (spread)
+        {
+            case test_spread_even:
+                samples[i] = 150 + (_test_rand() % 751);
+                break;
+            case test_spread_bell:
+                samples[i] = 150 + ((_test_rand() % 151) + (_test_rand() % 151) + (_test_rand() % 151) + (_test_rand() % 151));
+                break;
+            case test_spread_tail:
+                if ((_test_rand() % 8) == 0)
+                    samples[i] = 800 + (_test_rand() % 1701);
+                else
+                    samples[i] = 220 + (_test_rand() % 81) + (_test_rand() % 81);
+                break;
+        }
+    }
+}
+
+static int _test_cmp_u32(const void * a, const void * b)
+{
+    uint32_t _a = *(const uint32_t *)a;
+    uint32_t _b = *(const uint32_t *)b;
+
+    return (_a > _b) - (_a < _b);
+}
+
+uint32_t _test_exact_quantile(const uint32_t * sorted, int cnt, uint32_t pct)
+{
+    uint32_t rank = MAX(1, ((uint32_t)cnt * pct + 99) / 100);
+
+    return sorted[rank - 1];
+}
+
+void _test_session_run(int game, const uint32_t mean_ms[RSTATS_PLAYERS_MAX], const int cnt[RSTATS_PLAYERS_MAX])
+{
+    rstats_session_start(game);
+    for (int p = 0; p < RSTATS_PLAYERS_MAX; p++)
+        for (int i = 0; (mean_ms[p] > 0) && (i < cnt[p]); i++)
+            rstats_add(p, p, mean_ms[p]);
+    sim_now_ms += 30000;
+    rstats_session_end();
+}
+
+bool _test_board_read(rstats_board_t * board)
+{
+    return _rstats_nvs_read("board", board, sizeof(rstats_board_t));
+}
+
+int _test_console(const char * arg)
+{
+    int lines = sim_console_lines;
+
+    sim_console_args_set(arg);
+    _rstats_handler_rstat();
+    return sim_console_lines - lines;
+}
+
+void _test_agg_spread(const char * name, _test_spread_t spread, int cnt)
+{
+    static uint32_t samples[TEST_SAMPLES_MAX];
+    static const uint32_t pct[] = {50, 90, 99};
+    rstats_agg_t agg = {0};
+    rstats_summary_t sum;
+    double mean = 0.0;
+    double var = 0.0;
+    bool ok = true;
+    char text[128];
+    int len = 0;
+
+    _test_samples(samples, cnt, spread);
+    for (int i = 0; i < cnt; i++)
+    {
+        rstats_agg_add(&agg, samples[i]);
+        mean += samples[i];
+    }
+    mean /= cnt;
+    for (int i = 0; i < cnt; i++)
+        var += (samples[i] - mean) * (samples[i] - mean);
+    var /= (cnt - 1);
+    qsort(samples, cnt, sizeof(uint32_t), _test_cmp_u32);
+
+    _rstats_summarise(&agg, &sum);
+    _test_check((sum.cnt == cnt) && (sum.min_ms == samples[0]) && (sum.max_ms == samples[cnt - 1]) &&
+        (fabs(sum.mean_ms - mean) <= 1.0) && (fabs(sum.sd_ms - sqrt(var)) <= 1.0), name,
+        "n %u, mean %u (%.1f), sd %u (%.1f), min %u (%u), max %u (%u)", sum.cnt, sum.mean_ms, mean,
+        sum.sd_ms, sqrt(var), sum.min_ms, samples[0], sum.max_ms, samples[cnt - 1]);
+
+    //Within a bucket of the exact one (the bucket it is in is at most RSTATS_SKETCH_GAMMA wide)
+    for (size_t i = 0; i < ARRAY_SIZE(pct); i++)
+    {
+        uint32_t est = rstats_agg_quantile(&agg, pct[i]);
+        uint32_t exact = _test_exact_quantile(samples, cnt, pct[i]);
+        if (fabs((double)est - exact) > (exact * (RSTATS_SKETCH_GAMMA - 1.0f)))
+            ok = false;
+        len += snprintf(&text[len], sizeof(text) - len, "%sP%u %u (%u)", (i == 0)? "" : ", ", pct[i], est, exact);
+    }
+    _test_check(ok, name, "%s", text);
+}
+
+void _test_agg_edges(void)
+{
+    rstats_agg_t agg = {0};
+    rstats_summary_t sum;
+
+    _rstats_summarise(&agg, &sum);
+    _test_check((rstats_agg_quantile(&agg, 50) == 0) && (sum.cnt == 0) && (sum.p99_ms == 0), "empty",
+        "P50 %u, cnt %u", rstats_agg_quantile(&agg, 50), sum.cnt);
+
+    rstats_agg_add(&agg, 345);
+    _rstats_summarise(&agg, &sum);
+    _test_check((sum.p50_ms == 345) && (sum.p90_ms == 345) && (sum.p99_ms == 345) && (sum.sd_ms == 0) && (sum.mean_ms == 345),
+        "single", "P50 %u, P90 %u, P99 %u, sd %u", sum.p50_ms, sum.p90_ms, sum.p99_ms, sum.sd_ms);
+
+    //Below the first bound and above the last one (~14 s)
+    memset(&agg, 0, sizeof(agg));
+    rstats_agg_add(&agg, 5);
+    rstats_agg_add(&agg, 20000);
+    rstats_agg_add(&agg, 30000);
+    _test_check((agg.bin[0] == 1) && (agg.bin[RSTATS_SKETCH_BINS - 1] == 2) && (rstats_agg_quantile(&agg, 100) == 30000) &&
+        (rstats_agg_quantile(&agg, 50) >= _rstats.bound[RSTATS_SKETCH_BINS - 2]) && (rstats_agg_quantile(&agg, 50) <= 30000) &&
+        (rstats_agg_quantile(&agg, 1) <= _rstats.bound[0]), "range", "first bin %u, last bin %u, P1 %u, P50 %u, P100 %u (last bound %u)",
+        agg.bin[0], agg.bin[RSTATS_SKETCH_BINS - 1], rstats_agg_quantile(&agg, 1), rstats_agg_quantile(&agg, 50),
+        rstats_agg_quantile(&agg, 100), _rstats.bound[RSTATS_SKETCH_BINS - 2]);
+}
+
+void _test_session(void)
+{
+    rstats_node_t *node;
+
+    memset(sim_node_addr, 0, RGB_BTN_MAX_NODES);
+    memset(sim_node_factor, 0, RGB_BTN_MAX_NODES * sizeof(float));
+    sim_node_addr[0] = 0x20;
+    sim_node_addr[3] = 0x21;
+    sim_node_factor[0] = 1.0001f;
+
+    //Nothing is added outside a session
+    rstats_add(0, 0, 300);
+    rstats_session_start(0);
+    _test_check(_rstats.all.cnt == 0, "session", "press before the start: %u", _rstats.all.cnt);
+
+    rstats_add(0, 0, 300);
+    rstats_add(1, 0, 400);
+    rstats_add(-1, 3, 500);                     //No player (a node pressed out of turn)
+    rstats_add(RSTATS_PLAYERS_MAX, 3, 600);     //Not a player kept apart
+    rstats_add(1, 5, 700);                      //Not a node
+    rstats_add(1, 0, 0);                        //Not a reaction time
+    _test_check((_rstats.all.cnt == 5) && (_rstats.all.sum == 2500) && (_rstats.player[0].cnt == 1) &&
+        (_rstats.player[1].cnt == 2) && (_rstats.player[1].sum == 1100) && (_rstats.player[2].cnt == 0) &&
+        (_rstats.player[3].cnt == 0), "session", "all %u (%u ms), players %u %u %u %u",
+        _rstats.all.cnt, _rstats.all.sum, _rstats.player[0].cnt, _rstats.player[1].cnt, _rstats.player[2].cnt, _rstats.player[3].cnt);
+
+    //The node at 0x21 moves from slot 3 to slot 7 (and gets synced there)
+    sim_node_addr[3] = 0;
+    sim_node_addr[7] = 0x21;
+    sim_node_factor[7] = 0.9999f;
+    rstats_add(2, 7, 800);
+    node = _rstats_node_get(0x21);
+    _test_check((node->agg.cnt == 3) && (node->agg.sum == 1900) && (node->unsynced == 2) && (node->factor == 0.9999f),
+        "node", "0x21: %u presses (%u ms), %u before the sync", node->agg.cnt, node->agg.sum, node->unsynced);
+    node = _rstats_node_get(0x20);
+    _test_check((node->agg.cnt == 2) && (node->agg.sum == 700) && (node->unsynced == 0), "node",
+        "0x20: %u presses (%u ms), %u before the sync", node->agg.cnt, node->agg.sum, node->unsynced);
+
+    //The title, the header, all, 3 players and 2 nodes (2 lines each)
+    int lines = _test_console(NULL);
+    _test_check(lines == 10, "session", "\"rstat\": %d lines", lines);
+
+    //A new session starts from scratch
+    rstats_session_end();
+    rstats_session_start(1);
+    _test_check((_rstats.all.cnt == 0) && (_rstats.player[1].cnt == 0) && (_rstats.node[0].address == 0) && (_rstats.game == 1),
+        "session", "restart: all %u, player 2 %u, node 0x%02X", _rstats.all.cnt, _rstats.player[1].cnt, _rstats.node[0].address);
+    rstats_session_end();
+}
+
+void _test_nvs_sessions(void)
+{
+    static const uint32_t mean_ms[RSTATS_PLAYERS_MAX] = {400, 500, 0, 0};
+    static const int cnt[RSTATS_PLAYERS_MAX] = {3, 2, 0, 0};
+    const int sessions = RSTATS_NVS_SESSIONS + 4;
+    rstats_session_rec_t rec;
+    uint32_t seq = 0;
+    char key[8];
+    int bad = 0;
+
+    nvs_erase_all(_rstats.nvs);
+    memset(sim_node_addr, 0, RGB_BTN_MAX_NODES);
+    sim_node_addr[0] = 0x20;
+    sim_node_addr[1] = 0x21;
+
+    //Nothing to save
+    rstats_session_start(0);
+    rstats_session_end();
+    _test_check(nvs_get_u32(_rstats.nvs, "seq", &seq) == ESP_ERR_NVS_NOT_FOUND, "sessions", "empty session not saved");
+
+    for (int s = 0; s < sessions; s++)
+        _test_session_run(s % 2, mean_ms, cnt);
+
+    nvs_get_u32(_rstats.nvs, "seq", &seq);
+    for (uint32_t i = seq - RSTATS_NVS_SESSIONS; i < seq; i++)
+    {
+        snprintf(key, sizeof(key), "s%02u", i % RSTATS_NVS_SESSIONS);
+        if ((!_rstats_nvs_read(key, &rec, sizeof(rec))) || (rec.seq != i) || (rec.game != (i % 2)) ||
+            (rec.all.cnt != 5) || (rec.all.mean_ms != 440) || (rec.player[0].cnt != 3) || (rec.player[1].mean_ms != 500) ||
+            (rec.players != 2) || (rec.nodes != 2) || (rec.duration_s != 30))
+            bad++;
+    }
+    _test_check((seq == (uint32_t)sessions) && (bad == 0) && (sim_nvs_writes("s00") == 2) && (sim_nvs_writes("s15") == 1),
+        "sessions", "%d sessions: seq %u, %d bad record(s), s00 written %d times", sessions, seq, bad, sim_nvs_writes("s00"));
+
+    //The header and 2 lines per session
+    int lines = _test_console("hist");
+    _test_check(lines == (1 + (2 * RSTATS_NVS_SESSIONS)), "sessions", "\"rstat hist\": %d lines", lines);
+}
+
+void _test_board(void)
+{
+    rstats_board_t board;
+    uint32_t mean_ms[RSTATS_PLAYERS_MAX];
+    int cnt[RSTATS_PLAYERS_MAX];
+    bool sorted = true;
+    int writes;
+
+    nvs_erase_all(_rstats.nvs);
+    for (int i = 0; i < RSTATS_PLAYERS_MAX; i++)
+        sim_node_addr[i] = 0x20 + i;
+
+    //Too few presses for the leaderboard
+    for (int i = 0; i < RSTATS_PLAYERS_MAX; i++)
+    {
+        mean_ms[i] = 300;
+        cnt[i] = RSTATS_BOARD_MIN_CNT - 1;
+    }
+    _test_session_run(0, mean_ms, cnt);
+    _test_check((!_test_board_read(&board)) && (sim_nvs_writes("board") == 0), "board", "%d presses: not on the board",
+        RSTATS_BOARD_MIN_CNT - 1);
+
+    //4 sessions of 4 players (from 900 ms down to 450 ms), only the best RSTATS_BOARD_LEN are kept
+    for (int s = 0; s < 4; s++)
+    {
+        for (int i = 0; i < RSTATS_PLAYERS_MAX; i++)
+        {
+            mean_ms[i] = 900 - (((s * RSTATS_PLAYERS_MAX) + i) * 30);
+            cnt[i] = RSTATS_BOARD_MIN_CNT;
+        }
+        _test_session_run(0, mean_ms, cnt);
+    }
+    _test_board_read(&board);
+    for (int i = 1; i < board.cnt; i++)
+        if (board.entry[i].mean_ms < board.entry[i - 1].mean_ms)
+            sorted = false;
+    _test_check((board.cnt == RSTATS_BOARD_LEN) && (sorted) && (board.entry[0].mean_ms == 450) &&
+        (board.entry[RSTATS_BOARD_LEN - 1].mean_ms == 720) && (board.entry[0].player == 3) && (board.entry[0].seq == 4),
+        "board", "%d entries, %s, #1 %u ms (session %u, player %d), #%d %u ms", board.cnt, (sorted)? "sorted" : "NOT sorted",
+        board.entry[0].mean_ms, board.entry[0].seq, board.entry[0].player + 1, RSTATS_BOARD_LEN, board.entry[RSTATS_BOARD_LEN - 1].mean_ms);
+
+    //Nobody good enough: the board is not written again
+    writes = sim_nvs_writes("board");
+    for (int i = 0; i < RSTATS_PLAYERS_MAX; i++)
+        mean_ms[i] = 1500;
+    _test_session_run(0, mean_ms, cnt);
+    _test_check(sim_nvs_writes("board") == writes, "board", "not good enough: %d write(s) (%d before)", sim_nvs_writes("board"), writes);
+
+    //A tie goes after the one already there (the first to get there keeps the place)
+    memset(mean_ms, 0, sizeof(mean_ms));
+    mean_ms[1] = 450;
+    _test_session_run(1, mean_ms, cnt);
+    _test_board_read(&board);
+    _test_check((board.entry[0].seq == 4) && (board.entry[1].mean_ms == 450) && (board.entry[1].seq == 6) &&
+        (board.entry[1].game == 1) && (board.entry[RSTATS_BOARD_LEN - 1].mean_ms == 690), "board",
+        "tie: #1 session %u, #2 session %u (%u ms), #%d %u ms", board.entry[0].seq, board.entry[1].seq, board.entry[1].mean_ms,
+        RSTATS_BOARD_LEN, board.entry[RSTATS_BOARD_LEN - 1].mean_ms);
+
+    //The header and a line per entry
+    int lines = _test_console("board");
+    _test_check(lines == (1 + RSTATS_BOARD_LEN), "board", "\"rstat board\": %d lines", lines);
+
+    //A board of another version (or size) is ignored, and starts over
+    board.version = RSTATS_NVS_VERSION + 1;
+    nvs_set_blob(_rstats.nvs, "board", &board, sizeof(board));
+    mean_ms[1] = 800;
+    _test_session_run(0, mean_ms, cnt);
+    _test_board_read(&board);
+    _test_check((board.cnt == 1) && (board.entry[0].mean_ms == 800), "board", "other version: %d entries, #1 %u ms",
+        board.cnt, board.entry[0].mean_ms);
+    nvs_set_blob(_rstats.nvs, "board", &board, sizeof(board) - sizeof(rstats_board_entry_t));
+    mean_ms[1] = 850;
+    _test_session_run(0, mean_ms, cnt);
+    _test_board_read(&board);
+    _test_check((board.cnt == 1) && (board.entry[0].mean_ms == 850), "board", "other size: %d entries, #1 %u ms",
+        board.cnt, board.entry[0].mean_ms);
+
+    _test_console("clear");
+    lines = _test_console("board");
+    _test_check((!_test_board_read(&board)) && (lines == 1), "board", "cleared: \"rstat board\": %d line(s)", lines);
+}
+
+void _test_nvs_init(void)
+{
+    static const uint32_t mean_ms[RSTATS_PLAYERS_MAX] = {400, 0, 0, 0};
+    static const int cnt[RSTATS_PLAYERS_MAX] = {RSTATS_BOARD_MIN_CNT, 0, 0, 0};
+    uint32_t seq = 0;
+
+    //Truncated (or from another IDF): erased and used
+    nvs_set_u32(_rstats.nvs, "seq", 7);
+    sim_nvs_init_err = ESP_ERR_NVS_NO_FREE_PAGES;
+    rstats_init();
+    _test_session_run(0, mean_ms, cnt);
+    nvs_get_u32(_rstats.nvs, "seq", &seq);
+    _test_check((_rstats.nvs_ok) && (seq == 1), "init", "no free pages: erased, seq %u", seq);
+
+    //Cannot be opened: nothing is saved, but the session is kept in RAM
+    sim_nvs_broken = true;
+    rstats_init();
+    _test_session_run(0, mean_ms, cnt);
+    sim_nvs_broken = false;
+    nvs_flash_init();
+    nvs_get_u32(_rstats.nvs, "seq", &seq);
+    int lines = _test_console("hist");
+    _test_check((!_rstats.nvs_ok) && (seq == 1) && (_rstats.all.cnt == RSTATS_BOARD_MIN_CNT) && (lines == 1),
+        "init", "broken: seq %u, %u presses in RAM, \"rstat hist\": %d line(s)", seq, _rstats.all.cnt, lines);
+}
+
+void _test_check(bool ok, const char * name, const char * fmt, ...)
+{
+    va_list args;
+
+    printf("  %s  %-12s ", (ok)? "pass" : "FAIL", name);
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+    printf("\n");
+    if (!ok)
+        _test_fails++;
+}
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+int main(int argc, char * argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-v"))
+            sim_console_verbose = true;
+    }
+
+    rstats_init();
+
+    printf("RStats: %d buckets (%d ms to %u ms), %d sessions, %d on the board\n", RSTATS_SKETCH_BINS, RSTATS_SKETCH_MIN_MS,
+        _rstats.bound[RSTATS_SKETCH_BINS - 2], RSTATS_NVS_SESSIONS, RSTATS_BOARD_LEN);
+    _test_agg_spread("even", test_spread_even, 500);
+    _test_agg_spread("bell", test_spread_bell, 500);
+    _test_agg_spread("tail", test_spread_tail, TEST_SAMPLES_MAX);
+    _test_agg_edges();
+    _test_session();
+    _test_nvs_sessions();
+    _test_board();
+    _test_nvs_init();
+
+    printf("%s (%d failed)\n", (_test_fails == 0)? "PASSED" : "FAILED", _test_fails);
+    return _test_fails;
+}
+
+#undef PRINTF_TAG
+/*************************** END OF FILE *************************************/
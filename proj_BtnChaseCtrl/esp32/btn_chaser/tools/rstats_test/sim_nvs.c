@@ -0,0 +1,190 @@
+/*******************************************************************************
+
+Module:     sim_nvs.c
+Purpose:    This file contains the host stand-in for the NVS
+Author:     Rudolph van Niekerk
+
+The NVS (see stub/nvs.h), kept in RAM: a single namespace of keys, each a u32
+or a blob, which counts its writes so the test can tell when a record was
+saved. The partition can be made to come up the way a truncated one or one
+of another IDF version does (sim_nvs_init_err), or not at all.
+
+Used by the reaction time statistics test (with sim_rstats.c) and the nodes
+test (tools/nodes_test).
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#define SIM_NVS_KEYS        (32)
+#define SIM_NVS_KEY_LEN     (16)    /* NVS_KEY_NAME_MAX_SIZE */
+#define SIM_NVS_BLOB_MAX    (1024)
+
+/*******************************************************************************
+Local structure
+ *******************************************************************************/
+typedef struct
+{
+    char key[SIM_NVS_KEY_LEN];  // "" if the entry is free
+    bool is_blob;
+    uint8_t data[SIM_NVS_BLOB_MAX];
+    size_t len;
+    int writes;
+} sim_nvs_entry_t;
+
+/*******************************************************************************
+Global (public) variables
+ *******************************************************************************/
+esp_err_t sim_nvs_init_err = ESP_OK;                /* What nvs_flash_init() returns (until the partition is erased) */
+bool sim_nvs_broken = false;                        /* nvs_flash_init() fails, erased or not */
+
+/*******************************************************************************
+Local variables
+ *******************************************************************************/
+static sim_nvs_entry_t _sim_nvs[SIM_NVS_KEYS];
+static bool _sim_nvs_init = false;
+
+/*******************************************************************************
+Local (private) Functions
+ *******************************************************************************/
+static sim_nvs_entry_t * _sim_nvs_find(const char * key, bool create)
+{
+    sim_nvs_entry_t *free_entry = NULL;
+
+    for (int i = 0; i < SIM_NVS_KEYS; i++)
+    {
+        if (!strcmp(_sim_nvs[i].key, key))
+            return &_sim_nvs[i];
+        if ((free_entry == NULL) && (_sim_nvs[i].key[0] == '\0'))
+            free_entry = &_sim_nvs[i];
+    }
+    if ((!create) || (free_entry == NULL) || (strlen(key) >= SIM_NVS_KEY_LEN))
+        return NULL;
+    strcpy(free_entry->key, key);
+    return free_entry;
+}
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+int sim_nvs_writes(const char * key)
+{
+    sim_nvs_entry_t *entry = _sim_nvs_find(key, false);
+
+    return (entry == NULL)? 0 : entry->writes;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    if (sim_nvs_broken)
+        return ESP_FAIL;
+    if (sim_nvs_init_err != ESP_OK)
+        return sim_nvs_init_err;
+    _sim_nvs_init = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    memset(_sim_nvs, 0, sizeof(_sim_nvs));
+    sim_nvs_init_err = ESP_OK;
+    _sim_nvs_init = false;
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char * namespace_name, nvs_open_mode_t open_mode, nvs_handle_t * out_handle)
+{
+    if (!_sim_nvs_init)
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char * key, void * out_value, size_t * length)
+{
+    sim_nvs_entry_t *entry = _sim_nvs_find(key, false);
+
+    if (entry == NULL)
+        return ESP_ERR_NVS_NOT_FOUND;
+    if (!entry->is_blob)
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    //As the real one: the length of the blob if there is no buffer, an error if it does not fit
+    if (out_value == NULL)
+    {
+        *length = entry->len;
+        return ESP_OK;
+    }
+    if (*length < entry->len)
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(out_value, entry->data, entry->len);
+    *length = entry->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char * key, const void * value, size_t length)
+{
+    sim_nvs_entry_t *entry;
+
+    if (length > SIM_NVS_BLOB_MAX)
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    if ((entry = _sim_nvs_find(key, true)) == NULL)
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    entry->is_blob = true;
+    memcpy(entry->data, value, length);
+    entry->len = length;
+    entry->writes++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char * key, uint32_t * out_value)
+{
+    sim_nvs_entry_t *entry = _sim_nvs_find(key, false);
+
+    if (entry == NULL)
+        return ESP_ERR_NVS_NOT_FOUND;
+    if (entry->is_blob)
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    memcpy(out_value, entry->data, sizeof(uint32_t));
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char * key, uint32_t value)
+{
+    sim_nvs_entry_t *entry;
+
+    if ((entry = _sim_nvs_find(key, true)) == NULL)
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    entry->is_blob = false;
+    memcpy(entry->data, &value, sizeof(uint32_t));
+    entry->len = sizeof(uint32_t);
+    entry->writes++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    memset(_sim_nvs, 0, sizeof(_sim_nvs));
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    //Every write above is already "in flash"
+    return ESP_OK;
+}
+
+/*************************** END OF FILE *************************************/
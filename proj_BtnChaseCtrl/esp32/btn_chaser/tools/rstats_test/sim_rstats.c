@@ -0,0 +1,142 @@
+/*******************************************************************************
+
+Module:     sim_rstats.c
+Purpose:    This file contains the host stand-ins for the reaction time statistics test
+Author:     Rudolph van Niekerk
+
+What sys_rstats.c needs on top of the NVS (sim_nvs.c): the nodes (a slot holds
+the address in sim_node_addr[], 0 if it is empty, and the sync factor in
+sim_node_factor[]), the games, the poll timer (sim_now_ms) and the console.
+The console counts the lines printed (so the test can tell how much "rstat
+hist" listed) and hands out the arguments in sim_console_args[] to the
+command handler.
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "defines.h"
+#include "sys_utils.h"
+#include "sys_timers.h"
+#include "task_console.h"
+#include "task_game.h"
+#include "nodes.h"
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#define SIM_CONSOLE_ARGS    (4)
+
+/*******************************************************************************
+Global (public) variables
+ *******************************************************************************/
+bool sim_console_verbose = false;
+int sim_console_lines = 0;                          /* The lines printed so far */
+const char * sim_console_args[SIM_CONSOLE_ARGS];    /* The arguments of the next command (NULL terminated) */
+
+uint64_t sim_now_ms = 0;
+uint8_t sim_node_addr[RGB_BTN_MAX_NODES];
+float sim_node_factor[RGB_BTN_MAX_NODES];
+
+/*******************************************************************************
+Local variables
+ *******************************************************************************/
+static int _sim_console_arg = 0;
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+const char * esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+        case ESP_OK:                        return "ESP_OK";
+        case ESP_ERR_NVS_NO_FREE_PAGES:     return "ESP_ERR_NVS_NO_FREE_PAGES";
+        case ESP_ERR_NVS_NEW_VERSION_FOUND: return "ESP_ERR_NVS_NEW_VERSION_FOUND";
+        case ESP_ERR_NVS_NOT_INITIALIZED:   return "ESP_ERR_NVS_NOT_INITIALIZED";
+        default:                            return "ESP_FAIL";
+    }
+}
+
+uint64_t sys_poll_tmr_ms(void)
+{
+    return sim_now_ms;
+}
+
+bool is_node_valid(uint8_t node)
+{
+    return ((node < RGB_BTN_MAX_NODES) && (sim_node_addr[node] != 0));
+}
+
+uint8_t get_node_addr(uint8_t node)
+{
+    return is_node_valid(node)? sim_node_addr[node] : ADDR_BROADCAST;
+}
+
+float get_node_btn_correction_factor(int slot)
+{
+    return ((slot >= 0) && (slot < RGB_BTN_MAX_NODES))? sim_node_factor[slot] : 0.0f;
+}
+
+int games_cnt(void)
+{
+    return 2;
+}
+
+const char * game_name(int index)
+{
+    return (index == 0)? "chaser" : "memory";
+}
+
+int console_add_menu(const char * name, ConsoleMenuItem_t * items, size_t cnt, const char * desc)
+{
+    return 0;
+}
+
+int console_arg_cnt(void)
+{
+    int cnt = 0;
+
+    while ((_sim_console_arg + cnt < SIM_CONSOLE_ARGS) && (sim_console_args[_sim_console_arg + cnt] != NULL))
+        cnt++;
+    return cnt;
+}
+
+char * console_arg_pop(void)
+{
+    if (console_arg_cnt() == 0)
+        return NULL;
+    return (char *)sim_console_args[_sim_console_arg++];
+}
+
+void sim_console_args_set(const char * arg)
+{
+    memset(sim_console_args, 0, sizeof(sim_console_args));
+    sim_console_args[0] = arg;
+    _sim_console_arg = 0;
+}
+
+void console_printline(uint8_t traceflags, const char * tag, const char *fmt, ...)
+{
+    va_list args;
+
+    sim_console_lines++;
+    if (!sim_console_verbose)
+        return;
+    va_start(args, fmt);
+    printf("      [%s] ", tag);
+    vprintf(fmt, args);
+    printf("\n");
+    va_end(args);
+}
+
+/*************************** END OF FILE *************************************/
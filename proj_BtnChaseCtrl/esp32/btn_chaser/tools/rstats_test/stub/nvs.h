@@ -0,0 +1,44 @@
+/*****************************************************************************
+
+nvs.h
+
+Host stand-in for the ESP-IDF NVS library, only what sys_rstats.c and nodes.c
+use (see tools/rstats_test/rstats_test.c and tools/nodes_test/nodes_test.c).
+The store is kept in RAM by sim_nvs.c, with the same rules for the blob
+lengths as the real one.
+
+******************************************************************************/
+#ifndef __sim_nvs_H__
+#define __sim_nvs_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define ESP_ERR_NVS_BASE                (0x1100)
+#define ESP_ERR_NVS_NOT_INITIALIZED     (ESP_ERR_NVS_BASE + 0x01)
+#define ESP_ERR_NVS_NOT_FOUND           (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_TYPE_MISMATCH       (ESP_ERR_NVS_BASE + 0x03)
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE    (ESP_ERR_NVS_BASE + 0x05)
+#define ESP_ERR_NVS_INVALID_LENGTH      (ESP_ERR_NVS_BASE + 0x0c)
+#define ESP_ERR_NVS_NO_FREE_PAGES       (ESP_ERR_NVS_BASE + 0x0d)
+#define ESP_ERR_NVS_NEW_VERSION_FOUND   (ESP_ERR_NVS_BASE + 0x10)
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum
+{
+    NVS_READONLY,
+    NVS_READWRITE
+} nvs_open_mode_t;
+
+esp_err_t nvs_open(const char * namespace_name, nvs_open_mode_t open_mode, nvs_handle_t * out_handle);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char * key, void * out_value, size_t * length);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char * key, const void * value, size_t length);
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char * key, uint32_t * out_value);
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char * key, uint32_t value);
+esp_err_t nvs_erase_all(nvs_handle_t handle);
+esp_err_t nvs_commit(nvs_handle_t handle);
+void nvs_close(nvs_handle_t handle);
+
+#endif /* __sim_nvs_H__ */
@@ -0,0 +1,17 @@
+/*****************************************************************************
+
+nvs_flash.h
+
+Host stand-in for the ESP-IDF NVS partition (see tools/rstats_test/sim_nvs.c)
+
+******************************************************************************/
+#ifndef __sim_nvs_flash_H__
+#define __sim_nvs_flash_H__
+
+#include "esp_err.h"
+#include "nvs.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#endif /* __sim_nvs_flash_H__ */
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""Decodes a captured ButtonChaser telemetry stream into summary statistics.
+
+The controller streams the records on its console port (see "tlm csv" or
+"tlm bin" on the console, and main/sys_telemetry.h for the format). Capture
+the port to a file, e.g. with "idf.py monitor | tee session.log" for CSV, or
+any raw serial capture for binary, then:
+
+    telemetry_decode.py session.log [--baud 115200] [--csv-out records.csv]
+
+Console text in between the records is ignored.
+"""
+
+import argparse
+import statistics
+import struct
+import sys
+from collections import defaultdict
+
+TLM_FRAME_SYNC = 0xA5
+TLM_CSV_PREFIX = b"$TLM,"
+CRC_8_POLYNOMIAL = 0x8C
+
+FIELDS = {
+    "P": ("node", "addr", "reaction_ms"),
+    "R": ("node", "addr", "rtt_ms"),
+    "B": ("period_ms", "tx_bytes", "rx_bytes", "tx_frames", "rx_frames", "errors"),
+    "G": ("event", "game", "arg"),
+}
+
+GAME_EVENTS = ("start", "registered", "running", "paused", "resumed", "end")
+
+
+def crc8_n(data, crc=0):
+    """Same as crc8_n() in sys_utils.c"""
+    for extract in data:
+        for _ in range(8):
+            mix = (crc ^ extract) & 0x01
+            crc >>= 1
+            if mix:
+                crc ^= CRC_8_POLYNOMIAL
+            extract >>= 1
+    return crc
+
+
+def parse_csv(line):
+    parts = line.decode("ascii", errors="replace").strip().split(",")
+    if (len(parts) < 3) or (parts[1] not in FIELDS):
+        return None
+    try:
+        values = [int(p) for p in parts[2:]]
+    except ValueError:
+        return None
+    return (parts[1], values[0], values[1:])
+
+
+def decode(data):
+    """Yields (type, time_ms, fields) for every CSV line and valid binary frame"""
+    i = 0
+    while i < len(data):
+        if data.startswith(TLM_CSV_PREFIX, i):
+            end = data.find(b"\n", i)
+            end = len(data) if end < 0 else end
+            rec = parse_csv(data[i:end])
+            if rec:
+                yield rec
+            i = end + 1
+            continue
+
+        if (data[i] == TLM_FRAME_SYNC) and (i + 3 <= len(data)):
+            rec_type, rec_len = chr(data[i + 1]), data[i + 2]
+            frame_end = i + 3 + rec_len
+            if (rec_type in FIELDS) and (rec_len >= 4) and (rec_len % 4 == 0) and (frame_end < len(data)):
+                if crc8_n(data[i + 1:frame_end]) == data[frame_end]:
+                    values = struct.unpack("<%dI" % (rec_len // 4), data[i + 3:frame_end])
+                    yield (rec_type, values[0], list(values[1:]))
+                    i = frame_end + 1
+                    continue
+        i += 1
+
+
+def summary(name, samples, unit):
+    if not samples:
+        return "  %-12s -" % name
+    s = sorted(samples)
+    p90 = s[min(len(s) - 1, (len(s) * 9) // 10)]
+    return "  %-12s n=%-6d avg=%.1f%s min=%d%s p50=%d%s p90=%d%s max=%d%s" % (
+        name, len(s), statistics.mean(s), unit, s[0], unit, statistics.median_low(s), unit, p90, unit, s[-1], unit)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture", help="The captured console output (- for stdin)")
+    parser.add_argument("--baud", type=int, default=115200, help="The RS-485 bus baud rate (for the utilisation)")
+    parser.add_argument("--csv-out", help="Also write all the records to this file as CSV")
+    args = parser.parse_args()
+
+    data = sys.stdin.buffer.read() if args.capture == "-" else open(args.capture, "rb").read()
+    records = list(decode(data))
+    if not records:
+        print("No telemetry records found")
+        return 1
+
+    if args.csv_out:
+        with open(args.csv_out, "w") as out:
+            out.write("type,time_ms,f1,f2,f3,f4,f5,f6\n")
+            for rec_type, time_ms, fields in records:
+                out.write(",".join([rec_type, str(time_ms)] + [str(f) for f in fields]) + "\n")
+
+    reaction = defaultdict(list)
+    rtt = defaultdict(list)
+    bus_util = []
+    bus_errors = 0
+    events = defaultdict(int)
+
+    for rec_type, time_ms, f in records:
+        if (rec_type == "P") and (len(f) >= 3):
+            reaction[f[1]].append(f[2])
+        elif (rec_type == "R") and (len(f) >= 3):
+            rtt[f[1]].append(f[2])
+        elif (rec_type == "B") and (len(f) >= 6) and (f[0] > 0):
+            # 10 bits per byte (8N1), rx includes our own echo so tx+rx overstates a busy bus a bit
+            bus_util.append((f[1] + f[2]) * 10 * 1000 * 100 // (args.baud * f[0]))
+            bus_errors += f[5]
+        elif (rec_type == "G") and (len(f) >= 1):
+            events[GAME_EVENTS[f[0]] if f[0] < len(GAME_EVENTS) else str(f[0])] += 1
+
+    print("%d records over %.1f s" % (len(records), (records[-1][1] - records[0][1]) / 1000.0))
+    print("Reaction times:")
+    print(summary("all", [r for v in reaction.values() for r in v], "ms"))
+    for addr in sorted(reaction):
+        print(summary("0x%02X" % addr, reaction[addr], "ms"))
+    print("Node RTT:")
+    print(summary("all", [r for v in rtt.values() for r in v], "ms"))
+    for addr in sorted(rtt):
+        print(summary("0x%02X" % addr, rtt[addr], "ms"))
+    print("Bus:")
+    print(summary("util", bus_util, "%"))
+    print("  %-12s %d" % ("errors", bus_errors))
+    print("Game events:")
+    for name in sorted(events):
+        print("  %-12s %d" % (name, events[name]))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
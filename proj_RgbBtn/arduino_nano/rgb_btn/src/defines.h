@@ -55,6 +55,15 @@ const char BUILD_TIME_AND_DATE[] = {__TIME__ " " __DATE__}; /* Used in our start
 
 #define DEV_COMMS_DEBUG       (0)
 
+/* The compile-time trace level (TRACE_LVL_xxx in common_defines.h). Trace points
+ * below this level are not compiled in at all (neither the code nor the PSTR).
+ * A module can set its own level by redefining TRACE_LEVEL.
+ * Build the nano_trace_xxx environments in platformio.ini for the flash/RAM 
+ * usage at each level. */
+#ifndef CONSOLE_TRACE_LEVEL
+    #define CONSOLE_TRACE_LEVEL     (TRACE_LVL_DEBUG)
+#endif
+
 /* Suppresses a bunch of debug prints and console functionality for the RGB LED driver:
     Usage: RAM: 60 bytes, Flash: 2084 bytes */
 #define DEV_RGB_DEBUG       (0)
@@ -49,6 +49,15 @@ The [Header] section of the message contains the following fields:
     [ID]       - Unique ID/Sequence number of this message (to help with sync and collision detection)
     [SRC]      - The source address of the message
     [DST]      - The destination address of the message
+    [FRAG]     - The fragment index, with bit 7 set if more fragments (with the same ID) will follow
+    [LEN]      - The number of [Data] bytes in this frame
+
+Messages longer than a frame (RGB_BTN_FRAME_MAX_LEN) are sent as fragments. We only keep a single frame 
+buffer (RAM is scarce), so the fragments for us are reassembled straight into the caller's buffer (see 
+dev_comms_rx_msg_available()). Our own responses are built in a msg buffer (up to RGB_BTN_MSG_MAX_LEN) and 
+sent a frame at a time, each fragment being queued by dev_comms_service() once the echo of the previous one 
+matched. Responses which do not fit into the msg are not sent: the msg goes out as it is, and the master 
+resends the commands it did not get a response for (replayed from the response cache, if they made it in).
 
 The [Data] section of the message contains 1 or more sequences of commands, each followed by a variable length payload, e.g.:
     [Cmd 1][Data 1]
@@ -80,15 +89,24 @@ Transmission State Machine:
 | State         | Description                                                           |
 +---------------+-----------------------------------------------------------------------+
 | tx_idle       | Waiting for a transmission to start                                   |
+| tx_msg_busy   | A response is being built in the tx buffer                            |
 | tx_queued     | A transmission has been queued, so we waiting for the bus to be free  |
+|               |   - On a retry we first wait out a random backoff period              |
 |               |   - The transmission will be started when the bus is free             |
-| tx_echo_rx  | A transmission has been started, we are now waiting for the message   |
-|               |   to be reflected back to us.                                         |
-| tx_error      | An error occurred during transmission:                                |
-|               |   - The reflected message did not match our transmission              |
-|               |   - We did not get a reflected message back (timout)                  |
+| tx_echo_rx    | A transmission has been started, we are now waiting for the message   |
+|               |   to be reflected back to us. The echo is compared byte by byte in    |
+|               |   the RX IRQ (tx_idle once it matched).                               |
+|               |   If the bus goes quiet without a matching echo (collision or no      |
+|               |   echo at all), we go back to tx_queued for a retry, or give up       |
+|               |   after DEV_COMMS_TX_TRIES_MAX tries (tx_idle).                       |
+| tx_frag_sent  | The echo of a frame matched, but the msg has more fragments to send.  |
+|               |   dev_comms_service() queues the next frame (tx_queued).              |
 +---------------+-----------------------------------------------------------------------+
 
+The transmission state machine is advanced by dev_comms_service() (from the main loop) and the RX IRQ, 
+so the rest of the main loop (button, LEDs, console) keeps running while we wait for the bus (or for the 
+echo of a fragment). Only the actual sending of a frame (< 3ms) is done in one go. The outcome is available from dev_comms_tx_result().
+
 
 
 
@@ -132,6 +150,10 @@ Transmission State Machine:
 /******************************************************************************
 Macros
 ******************************************************************************/
+#define DEV_COMMS_TX_TRIES_MAX      (5)     /* Number of times we attempt a transmission before giving up */
+#define DEV_COMMS_TX_BACKOFF_MS     (BUS_SILENCE_MIN_MS) /* Base backoff period, doubled with every retry */
+#define DEV_COMMS_RESP_CACHE_SIZE   (32)    /* Bytes kept to replay our responses to a resent msg */
+#define DEV_COMMS_RESP_CACHE_MS     (3000)  /* Longer than the master will keep on resending a msg */
 
 /******************************************************************************
 Struct & Unions
@@ -147,14 +169,16 @@ typedef enum e_comms_msg_rx_errors
 {
     rx_err_crc      = (-1),
     rx_err_version  = (-2),
+    rx_err_length   = (-3),
 }comms_msg_rx_error_t;
 
 typedef enum e_comms_msg_tx_state
 {
     tx_idle,        // Waiting for a message to send
     tx_msg_busy,    // We have started to build a message
-//    tx_queued,      // We are busy transmitting a message (between ETX and STX)
+    tx_queued,      // Waiting for the backoff period to expire and the bus to be free
     tx_echo_rx,     // Checking the RX'd msg to see if we had a collision
+    tx_frag_sent,   // The frame went out fine, but there is more of the response to send
 }comms_msg_tx_state_t;
 
 typedef struct dev_comms_blacklist_st
@@ -167,20 +191,41 @@ typedef struct dev_comms_st
 {
     bool init_done = false;
     struct {
-        comms_msg_t msg;
+        comms_frame_t msg;
         int8_t length;
         int8_t data_length;
         // int8_t data_rd_index;
     }rx;
     struct {
-        comms_msg_t msg;
+        uint8_t src;            /* The source of the fragmented msg being reassembled */
+        uint8_t id;             /* The ID of the fragmented msg being reassembled */
+        uint8_t next_frag;      /* The index of the next fragment we expect (0 if not busy) */
+        uint8_t data_length;    /* The data reassembled so far */
+    }reassembly;
+    struct {
+        comms_msg_t msg;        /* The hdr describes the frame being sent (frag and len) */
 //        uint8_t buff[(RGB_BTN_MSG_MAX_LEN*2)+2];    //Absolute worst case scenario
         uint8_t retry_cnt = 0;
         uint8_t seq;
         uint8_t data_length;
+        uint8_t frame_offset;   /* Where the data of the frame being sent starts in msg.data */
+        uint8_t frame_crc;      /* The CRC of the frame being sent */
+        uint8_t frame_length;   /* The (unescaped) length of the frame being sent */
+        uint8_t echo_length;    /* The number of echo bytes received so far */
+        bool echo_ok;           /* All the echo bytes received so far matched */
+        unsigned long backoff_ms; /* The random period to wait before the next try */
     }tx;
     uint8_t addr;           /* My assigned address */
     dev_comms_blacklist_t blacklist; /* List of addresses that are not allowed to be used */
+    link_stats_t link;      /* Link quality counters (reported to the master with cmd_get_link) */
+    struct {
+        uint8_t data[DEV_COMMS_RESP_CACHE_SIZE]; /* [cmd][resp_code][len][data] for every response to the msg */
+        uint8_t len;
+        uint8_t rd_index;       /* Where to continue looking for the next response to replay */
+        uint8_t seq;            /* The ID of the master's msg these responses belong to */
+        bool recording;
+        unsigned long time_ms;  /* When the master's msg was received */
+    }resp_cache;
 }dev_comms_t;
 
 /******************************************************************************
@@ -198,6 +243,13 @@ unsigned int  _dev_comms_response_add_console_resp(uint8_t * data, uint8_t data_
 #endif /* REMOTE_CONSOLE_SUPPORTED */
 unsigned int _dev_comms_response_add_data(uint8_t * data, uint8_t data_len);
 void _dev_comms_response_start(void);
+int8_t _dev_comms_reassemble(uint8_t * _data);
+void _dev_comms_tx_queue(void);
+void _dev_comms_tx_next(void);
+void _dev_comms_tx_send(void);
+uint8_t _dev_comms_tx_frame_byte(uint8_t index);
+void _link_cnt_inc(uint8_t * cnt);
+void _dev_comms_response_cache_add(master_command_t cmd, response_code_t resp_code, uint8_t * data, uint8_t data_len);
 
 /******************************************************************************
 Local variables
@@ -206,6 +258,7 @@ Local variables
 dev_comms_t _comms;
 volatile comms_msg_rx_state_t _rx_state = rx_listen;
 volatile comms_msg_tx_state_t _tx_state = tx_idle;
+volatile dev_comms_tx_result_t _tx_result = tx_result_none;
 
 //RVN - TODO - Consider seperating the MSG transmission state from the MSG state.
 //This would make it easier to buffer messages for transmission as well.
@@ -228,18 +281,24 @@ int8_t _comms_check_rx_msg(int *_data)
         return rx_err_crc;
     }
 
-    if (_comms.rx.msg.hdr.version > RGB_BTN_MSG_VERSION)
+    if (_comms.rx.msg.hdr.version != RGB_BTN_MSG_VERSION)
     {
         // _comms.rx.flag.err_version = 1;
         *_data = _comms.rx.msg.hdr.version;
         return rx_err_version;
     }
 
-    //CRC is good, Version is Good, Sync # is good - I guess we are done?
-
     //Set the length to the size of the payload
     _comms.rx.data_length = _comms.rx.length - sizeof(comms_msg_hdr_t) - sizeof(uint8_t); //CRC
 
+    if ((_comms.rx.data_length < 0) || (_comms.rx.msg.hdr.len != _comms.rx.data_length))
+    {
+        *_data = _comms.rx.msg.hdr.len;
+        return rx_err_length;
+    }
+
+    //CRC is good, Version is Good, Length is good - I guess we are done?
+
     // Our Payload data could be 0.... not much to do then?
     return _comms.rx.data_length;
 }
@@ -248,7 +307,17 @@ bool _dev_comms_rx_handler_add_data_check_overflow(uint8_t rx_data)
 {
     //iprintln(trCOMMS, "#Got 0x%02X (%d)",rx_data, _comms.rx.length);
 
-    if (_comms.rx.length >= RGB_BTN_MSG_MAX_LEN)
+    if (_tx_state == tx_echo_rx)
+    {
+        //Our own echo is checked as it comes in, so that it does not overwrite a msg still waiting in the rx buffer
+        if ((_comms.tx.echo_length >= _comms.tx.frame_length) || (_dev_comms_tx_frame_byte(_comms.tx.echo_length) != rx_data))
+            _comms.tx.echo_ok = false;
+        else
+            _comms.tx.echo_length++;
+        return true;
+    }
+
+    if (_comms.rx.length >= RGB_BTN_FRAME_MAX_LEN)
         return false;
 
     //If we had a message ready, it is goneskies now!
@@ -275,10 +344,20 @@ void _rx_irq_callback(uint8_t rx_data)
     //This is a callback which is called from the serial interrupt handler
     if (rx_data == STX)
     {
-        //Discard any encapsulated messaged we receive while we have an unhandled message in the RX buffer
-        protecting_rx_msg_buffer = _msg_available;
-
-        _comms.rx.length = 0;
+        if (_tx_state == tx_echo_rx)
+        {
+            //Our own echo (we hope), which is not saved in the RX buffer
+            _comms.tx.echo_length = 0;
+            _comms.tx.echo_ok = true;
+            protecting_rx_msg_buffer = false;
+        }
+        else
+        {
+            //Discard any encapsulated messaged we receive while we have an unhandled message in the RX buffer
+            protecting_rx_msg_buffer = _msg_available;
+            if (!protecting_rx_msg_buffer)
+                _comms.rx.length = 0;
+        }
         _rx_state = rx_busy;
     }    
     else if (_rx_state == rx_listen)
@@ -293,15 +372,23 @@ void _rx_irq_callback(uint8_t rx_data)
             // Is this a half-duplex echo of what we were busy transmitting just now?
             if (_tx_state == tx_echo_rx)
             {
-                // if we were sending just now, we want to check if our rx and tx buffers match
-                if (memcmp((uint8_t *)&_comms.rx.msg, (uint8_t *)&_comms.tx.msg, min(_comms.rx.length, RGB_BTN_MSG_MAX_LEN)) == 0)
+                // if we were sending just now, we want to check if all of the echo matched what we sent
+                if ((_comms.tx.echo_ok) && (_comms.tx.echo_length == _comms.tx.frame_length))
                 {
-                    _comms.tx.seq++;
-                    //No need to check this message in the application.... we are done with it
-                    _tx_state = tx_idle;
+                    //The fragments of a msg all share the same seq #
+                    if (!(_comms.tx.msg.hdr.frag & COMMS_FRAG_MORE))
+                        _comms.tx.seq++;
+                    if (_comms.tx.msg.hdr.frag & COMMS_FRAG_MORE)
+                        _tx_state = tx_frag_sent; //dev_comms_service() queues the next frame
+                    else
+                    {
+                        //No need to check this message in the application.... we are done with it
+                        _tx_result = tx_result_ok;
+                        _tx_state = tx_idle;
+                    }
                 }
                 // else  //only reason this would happen is if we had a bus collision
-                // If we remain in this state we will get a timeout once the bus is free again and our retry mechanism will kick in
+                // If we remain in this state, dev_comms_service() will see the bus is free again and our retry mechanism will kick in
             }
             else if (!protecting_rx_msg_buffer)
                 _msg_available = true; //We have a message available, but we need to check if it is valid first
@@ -346,13 +433,8 @@ unsigned int _dev_comms_response_add_data(uint8_t * data, uint8_t data_len)
     if ((data == NULL) || (data_len == 0))
         return 0; //Nothing to do
 
-    uint8_t _crc = _comms.tx.msg.data[_comms.tx.data_length];
-
     memcpy(&_comms.tx.msg.data[_comms.tx.data_length], data, data_len);
 
-    //Calculate the crc of the newly added data in the message
-    _comms.tx.msg.data[_comms.tx.data_length + data_len] = crc8_n(_crc, &_comms.tx.msg.data[_comms.tx.data_length], data_len);
-
     //NOW we can increment the datalenth
     _comms.tx.data_length += data_len; // for the payload
 
@@ -366,35 +448,110 @@ unsigned int  _dev_comms_response_add_console_resp(uint8_t * data, uint8_t data_
     if (_tx_state != tx_msg_busy) //Must be preceded with start()
         return 0;
 
-    if (data_len > (sizeof(_comms.tx.msg.data) - sizeof(uint8_t))) //For the CRC
+    //Console output is not cached, so it cannot be continued in a next msg. Whatever does not fit into 
+    // this one is dropped (leaving room for the cmd_wr_console_done which follows it)
+    if ((_comms.tx.data_length + data_len + 2) > sizeof(_comms.tx.msg.data))
         return 0;
 
-    if ((_comms.tx.data_length + data_len) > sizeof(_comms.tx.msg.data)) //For the CRC
+    return _dev_comms_response_add_data(data, data_len); //The number of bytes added
+}
+#endif /* REMOTE_CONSOLE_SUPPORTED */
+
+void _link_cnt_inc(uint8_t * cnt)
+{
+    //Saturate rather than wrap, a counter reading 0 after a bad spell is worse than useless
+    if (*cnt < UINT8_MAX)
+        (*cnt)++;
+}
+
+void _dev_comms_response_cache_add(master_command_t cmd, response_code_t resp_code, uint8_t * data, uint8_t data_len)
+{
+    if (!_comms.resp_cache.recording)
+        return;
+
+#if REMOTE_CONSOLE_SUPPORTED == 1    
+    //Console output is streamed into the response, we cannot replay that
+    if ((cmd == cmd_wr_console_cont) || (cmd == cmd_wr_console_done))
+        return;
+#endif /* REMOTE_CONSOLE_SUPPORTED */
+
+    if ((_comms.resp_cache.len + 3 + data_len) > DEV_COMMS_RESP_CACHE_SIZE)
     {
-        //Let's send what we have so far, and then start a new message?
-        if (!dev_comms_transmit_now())
-            iprintln(trALWAYS, "!Sending interim console response msg");
-        dev_comms_response_append(cmd_wr_console_cont, resp_ok, NULL, 0);
+        //The commands we could not cache will be executed again if the msg is resent
+        _comms.resp_cache.recording = false;
+        return;
     }
 
-    return _dev_comms_response_add_data(data, data_len); //The number of bytes added
+    _comms.resp_cache.data[_comms.resp_cache.len++] = cmd;
+    _comms.resp_cache.data[_comms.resp_cache.len++] = resp_code;
+    _comms.resp_cache.data[_comms.resp_cache.len++] = data_len;
+    if ((data != NULL) && (data_len > 0))
+        memcpy(&_comms.resp_cache.data[_comms.resp_cache.len], data, data_len);
+    _comms.resp_cache.len += data_len;
 }
-#endif /* REMOTE_CONSOLE_SUPPORTED */
 
 void _dev_comms_response_start(void)
 {
-
     _comms.tx.data_length = 0;//sizeof(comms_msg_hdr_t);         //Reset to the beginning of the data
     _comms.tx.msg.hdr.version = RGB_BTN_MSG_VERSION;    //Superfluous, but just in case
     _comms.tx.msg.hdr.id = _comms.tx.seq;               //Should have incremented after the last transmission
     _comms.tx.msg.hdr.src = _comms.addr;                //Our Address (might have changed since our last message)
     _comms.tx.msg.hdr.dst = ADDR_MASTER;          //We only ever talk to the master!!!!!
-
-    _comms.tx.msg.data[0] = crc8_n(0, ((uint8_t *)&_comms.tx.msg), sizeof(comms_msg_hdr_t));
+    _comms.tx.msg.hdr.frag = 0;                         //Set for every frame once the msg is sent
+    _comms.tx.msg.hdr.len = 0;
 
     _tx_state = tx_msg_busy; //We are starting to build a message
 }
 
+int8_t _dev_comms_reassemble(uint8_t * _data)
+{
+    uint8_t _frag = (_comms.rx.msg.hdr.frag & COMMS_FRAG_INDEX_MASK);
+
+    if ((_frag == 0) && (!(_comms.rx.msg.hdr.frag & COMMS_FRAG_MORE)))
+    {
+        //Not fragmented
+        _comms.reassembly.next_frag = 0;
+        if ((_data != NULL) && (_comms.rx.data_length > 0))
+            memcpy(_data, &_comms.rx.msg.data, _comms.rx.data_length);
+        return _comms.rx.data_length;
+    }
+
+    //We only reassemble msgs meant for us (the fragments of other nodes' msgs are of no use to us)
+    if ((_data == NULL) || ((_comms.rx.msg.hdr.dst != _comms.addr) && (_comms.rx.msg.hdr.dst != ADDR_BROADCAST)))
+        return 0;
+
+    if (_frag == 0)
+    {
+        _comms.reassembly.src = _comms.rx.msg.hdr.src;
+        _comms.reassembly.id = _comms.rx.msg.hdr.id;
+        _comms.reassembly.data_length = 0;
+    }
+    else if ((_frag != _comms.reassembly.next_frag) || 
+             (_comms.rx.msg.hdr.src != _comms.reassembly.src) || 
+             (_comms.rx.msg.hdr.id != _comms.reassembly.id))
+    {
+        itrace(trCOMMS, "#Frag %d lost (0x%02X)", _comms.reassembly.next_frag, _comms.rx.msg.hdr.id);
+        _comms.reassembly.next_frag = 0;
+        return 0;
+    }
+
+    if ((_comms.reassembly.data_length + _comms.rx.data_length) > RGB_BTN_MSG_MAX_DATA_LEN)
+    {
+        _comms.reassembly.next_frag = 0;
+        return 0;
+    }
+
+    memcpy(&_data[_comms.reassembly.data_length], &_comms.rx.msg.data, _comms.rx.data_length);
+    _comms.reassembly.data_length += _comms.rx.data_length;
+    _comms.reassembly.next_frag = _frag + 1;
+
+    if (_comms.rx.msg.hdr.frag & COMMS_FRAG_MORE)
+        return 0; //Not done yet
+
+    _comms.reassembly.next_frag = 0;
+    return _comms.reassembly.data_length;
+}
+
 /******************************************************************************
 Public functions
 ******************************************************************************/
@@ -403,11 +560,13 @@ void dev_comms_init(void)
     if (_comms.init_done)
         return; //Already initialised
 
-    memset(&_comms.rx.msg, 0, sizeof(comms_msg_t));
+    memset(&_comms.rx.msg, 0, sizeof(comms_frame_t));
     _rx_state = rx_listen;
     _tx_state = tx_idle;
 
     dev_comms_blacklist_clear();
+    memset(&_comms.link, 0, sizeof(link_stats_t));
+    memset(&_comms.resp_cache, 0, sizeof(_comms.resp_cache));
     
     //Start with a random sequence number (to help detect bus collisions in the case of 2 nodes with the same address)
     _comms.tx.seq = (uint8_t)sys_random(0, ADDR_BROADCAST);
@@ -426,8 +585,8 @@ void dev_comms_init(void)
     //sys_set_io_mode(output_Debug, OUTPUT);
     sys_cb_tmr_start(&_bus_silence_expiry, BUS_SILENCE_MIN_MS);
 
-    //iprintln(trCOMMS, "#Initialised - Payload size: %d/%d (Seq # %d)", sizeof(_comms.rx.msg.data), sizeof(comms_msg_t), _comms.tx.seq);
-    iprintln(trCOMMS, "#Init %d/%d (Seq # %d)", sizeof(_comms.rx.msg.data), sizeof(comms_msg_t), _comms.tx.seq);
+    //iprintln(trCOMMS, "#Initialised - Payload size: %d/%d (Seq # %d)", sizeof(_comms.rx.msg.data), sizeof(comms_frame_t), _comms.tx.seq);
+    iprintln(trCOMMS, "#Init %d/%d (Seq # %d)", sizeof(_comms.rx.msg.data), sizeof(comms_frame_t), _comms.tx.seq);
 }
 
 bool dev_comms_tx_ready(void)
@@ -447,37 +606,82 @@ unsigned int dev_comms_response_append(master_command_t cmd, response_code_t res
         return 0; //Nothing to do
     //iprintln(trALWAYS, "#Responding to 0x%02X : 0x%02X (%d bytes)", cmd, resp_code, data_len);
 
-    // We cannot send a message if we are not ready to send now, otherwise we will overwrite data being sent
-    if ((_tx_state == tx_idle) || (restart))
+    if ((_tx_state == tx_idle) || ((restart) && (_tx_state == tx_msg_busy)))
         _dev_comms_response_start();
-    
-    //If another message is already in progress (queued or tx_echo_rx), starting a new one
-    // will overwrite the buffered data used ot confirm good transmission
-    if (_tx_state != tx_msg_busy)
-        return 0;
 
-    if ((uint8_t)(_comms.tx.data_length + data_len + 2) > sizeof(_comms.tx.msg.data))
+    if ((_tx_state == tx_msg_busy) && ((uint8_t)(_comms.tx.data_length + data_len + 2) > sizeof(_comms.tx.msg.data)))
     {
-        //iprintln(trALWAYS, "#TX interim msg");
-        //Let's send what we have so far, and then start a new message?
-        if (!dev_comms_transmit_now()) //Send the response message now
-            iprintln(trALWAYS, "!TX interim msg");
-        //We need to "prime" the message first....
-        _dev_comms_response_start();
-        //RVN - TODO - This needs to be tested!!!!
+        //The msg is full, so we send it as it is. The master resends the commands we could not respond to.
+        dev_comms_transmit_now();
     }
 
-    uint8_t _crc = _comms.tx.msg.data[_comms.tx.data_length];
+    if (_tx_state != tx_msg_busy)
+    {
+        //A msg in flight cannot be added to (or restarted), its buffer is still needed for the fragments still to 
+        // be sent and to check the echo. If cached, the response is replayed when the master resends the command.
+        _dev_comms_response_cache_add(cmd, resp_code, data, data_len);
+        return 0;
+    }
 
     _comms.tx.msg.data[_comms.tx.data_length    ] = cmd;
     _comms.tx.msg.data[_comms.tx.data_length + 1] = resp_code;
-    _comms.tx.msg.data[_comms.tx.data_length + 2] = crc8_n(_crc, &_comms.tx.msg.data[_comms.tx.data_length], 2);
     
     _comms.tx.data_length += 2; //For the command and response code
 
+    _dev_comms_response_cache_add(cmd, resp_code, data, data_len);
+
     return (2 + _dev_comms_response_add_data(data, data_len)); //The number of bytes added (+2 for the command and response code)
 }
 
+bool dev_comms_response_cache_start(uint8_t seq)
+{
+    bool _resend = ((_comms.resp_cache.seq == seq) && 
+                    (_comms.resp_cache.time_ms != 0) &&
+                    ((sys_millis() - _comms.resp_cache.time_ms) < DEV_COMMS_RESP_CACHE_MS));
+
+    if (!_resend)
+    {
+        //A new msg... forget about the responses to the previous one
+        _comms.resp_cache.len = 0;
+        _comms.resp_cache.seq = seq;
+        _comms.resp_cache.time_ms = sys_millis();
+    }
+    //When resent, the commands we did not manage to cache will be executed again, and we can add their responses now
+    _comms.resp_cache.rd_index = 0;
+    _comms.resp_cache.recording = true;
+
+    return _resend;
+}
+
+void dev_comms_response_cache_stop(void)
+{
+    _comms.resp_cache.recording = false;
+}
+
+bool dev_comms_response_replay(master_command_t cmd)
+{
+    //The master only resends the commands it did not get a response for, but it keeps them in the original 
+    // order, so we can carry on from where we found the previous one
+    uint8_t _idx = _comms.resp_cache.rd_index;
+
+    while ((_idx + 3) <= _comms.resp_cache.len)
+    {
+        uint8_t _len = _comms.resp_cache.data[_idx + 2];
+        if (_comms.resp_cache.data[_idx] == cmd)
+        {
+            _comms.resp_cache.rd_index = _idx + 3 + _len;
+            //Don't record this one again
+            bool _recording = _comms.resp_cache.recording;
+            _comms.resp_cache.recording = false;
+            dev_comms_response_append(cmd, (response_code_t)_comms.resp_cache.data[_idx + 1], &_comms.resp_cache.data[_idx + 3], _len);
+            _comms.resp_cache.recording = _recording;
+            return true;
+        }
+        _idx += 3 + _len;
+    }
+    return false; //Not in the cache
+}
+
 #if REMOTE_CONSOLE_SUPPORTED == 1    
 size_t dev_comms_response_add_byte(uint8_t data)
 {
@@ -487,117 +691,192 @@ size_t dev_comms_response_add_byte(uint8_t data)
 
 bool dev_comms_transmit_now(void)
 {
-
     if ((_comms.tx.data_length == 0) || (_tx_state != tx_msg_busy)) //Must be preceded with start()
         return true; //Nothing to send, let the user think everything is all good
 
+    //The 1st fragment, dev_comms_service() queues the next ones as the echo of each comes in
+    _comms.tx.frame_offset = 0;
+    _comms.tx.msg.hdr.frag = 0;
+    _dev_comms_tx_queue();
+
+    return true;
+}
+
+dev_comms_tx_result_t dev_comms_tx_result(void)
+{
+    return _tx_result;
+}
+
+void dev_comms_service(void)
+{
+    if (_tx_state == tx_frag_sent)
+    {
+        _dev_comms_tx_next();
+        return;
+    }
+
+    if (_tx_state == tx_queued)
+    {
+        //Any traffic on the bus in the meantime is handled in the RX IRQ
+        if (sys_stopwatch_ms_lap(&_tx_sw) < _comms.tx.backoff_ms)
+            return; //Not yet
+
+        if (_rx_state != rx_listen)
+            return; //Wait for the bus to go silent (should not be more than 15ms)
+
+        _dev_comms_tx_send();
+        return;
+    }
+
+    if (_tx_state != tx_echo_rx)
+        return; //Nothing in flight
+
+    // If our TX state goes into idle, we got it (all handled by the interrupts)
+    // otherwise, if the rx state goes into listen, a completed message has been received, but not matched (bus collision?), 
+    // or the bus silence timer has given up on the message (no echo)
+    // (The rx state is read first, so that an echo completing in between is not mistaken for a collision)
+    if (_rx_state != rx_listen)
+        return; //Still receiving
+
+    if (_tx_state != tx_echo_rx)
+        return; // ECHO RECEIVED - All good, baby!
+
+    _link_cnt_inc(&_comms.link.echo_err);
+    if (_comms.tx.echo_length > 0)
+    {
+        itrace(trCOMMS, "#Bus Collision");
+        itrace(trCOMMS, "#TX Err - %d bytes (seq %d)", _comms.tx.frame_length, _comms.tx.msg.hdr.id);
+        itrace(trCOMMS, "#Echo matched %d bytes", _comms.tx.echo_length);
+#if DEV_COMMS_DEBUG == 1
+        //The raw dump (of the frame data) takes long enough to print to upset the bus timing of the retry
+        console_print_ram(trCOMMS, &_comms.tx.msg.data[_comms.tx.frame_offset], _comms.tx.frame_offset, _comms.tx.msg.hdr.len);
+#endif /* DEV_COMMS_DEBUG */
+    }
+    else
+        itrace(trCOMMS, "#No ECHO Rx'd");
+
+    if (_comms.tx.retry_cnt < DEV_COMMS_TX_TRIES_MAX)
+    {
+        //Every node that lost the collision would otherwise retry the moment the bus goes quiet again (and 
+        // collide again), so we each wait a random period, with the window doubling on every retry.
+        _link_cnt_inc(&_comms.link.tx_retries);
+        _comms.tx.backoff_ms = (unsigned long)sys_random(0, (long)DEV_COMMS_TX_BACKOFF_MS << _comms.tx.retry_cnt);
+        sys_stopwatch_ms_start(&_tx_sw, 0);
+        _tx_state = tx_queued;
+        return;
+    }
+
+    //We have retried this message too many times, so we need to give up and move on
+    _link_cnt_inc(&_comms.link.tx_abandoned);
+    itrace(trCOMMS, "#TX Abandonded after %d tries (0x%02X)", _comms.tx.retry_cnt, _comms.tx.msg.hdr.id);
+
+    //We increment the sequence number, so that the master will know that something went wrong
+    _comms.tx.seq++;
+
+    //Return to an idle state, so that we can start a new message
+    _tx_result = tx_result_failed;
+    _tx_state = tx_idle;
+}
+
+void _dev_comms_tx_queue(void)
+{
+    //The frame starts at frame_offset, its fragment index is already in the hdr
+    uint8_t _len = _comms.tx.data_length - _comms.tx.frame_offset;
+    if (_len > RGB_BTN_FRAME_MAX_DATA_LEN)
+    {
+        _len = RGB_BTN_FRAME_MAX_DATA_LEN;
+        _comms.tx.msg.hdr.frag |= COMMS_FRAG_MORE;
+    }
+    _comms.tx.msg.hdr.len = _len;
+    _comms.tx.frame_crc = crc8_n(crc8_n(0, ((uint8_t *)&_comms.tx.msg.hdr), sizeof(comms_msg_hdr_t)), &_comms.tx.msg.data[_comms.tx.frame_offset], _len);
+    _comms.tx.frame_length = (sizeof(comms_msg_hdr_t) + _len + sizeof(uint8_t));
+
     _comms.tx.retry_cnt = 0; //We are starting a new transmission, so reset the retry count
-//    _tx_state = tx_queued; //Will be started once the bus is free
-
-    do { //while (_comms.tx.retry_cnt < 5)
-
-        // if (_comms.tx.data_length == 0)
-        // {
-        //     //How did we get to this point?
-        //     _tx_state = tx_idle;
-        //     return;
-        // }
-        uint8_t * msg = (uint8_t *)&_comms.tx.msg;
-        uint8_t msg_len = (sizeof(comms_msg_hdr_t) + _comms.tx.data_length + sizeof(uint8_t));
-        //iprintln(trCOMMS, "#TX: %d bytes (%d)", msg_len, _comms.tx.msg.hdr.id);
-        //iprintln(trCOMMS, "#TX: %d bytes (%d) - %d, %d ms", msg_len, _comms.tx.msg.hdr.id, _rx_state, hal_serial_rx_silence_ms());
-    
+    _comms.tx.backoff_ms = 0; //The first try goes as soon as the bus is free
+    sys_stopwatch_ms_start(&_tx_sw, 0);
+    _tx_result = tx_result_busy;
+    _tx_state = tx_queued; //Will be started once the bus is free
+
+    //The bus might well be free already
+    dev_comms_service();
+}
+
+void _dev_comms_tx_next(void)
+{
+    //The next fragment of this msg
+    _comms.tx.frame_offset += _comms.tx.msg.hdr.len;
+    _comms.tx.msg.hdr.frag = (_comms.tx.msg.hdr.frag & COMMS_FRAG_INDEX_MASK) + 1;
+    _dev_comms_tx_queue();
+}
+
+void _dev_comms_tx_send(void)
+{
+    //iprintln(trCOMMS, "#TX: %d bytes (%d) - %d, %d ms", _comms.tx.frame_length, _comms.tx.msg.hdr.id, _rx_state, hal_serial_rx_silence_ms());
+
+    {   //NO PRINT SECTION START            
         //Make sure any console prints are finished before we start sending... 
         // this ensures that the RS-485 is enabled again once the last TX complete IRQ has fired.
         hal_serial_flush(); 
+
+        //We need to enable RS485 RX while we are doing this transmission, 
+        //Will be disabled again once the transmission is done
+        sys_output_write(output_RS485_DE, HIGH);
+
+        //We need to make sure our IRQ callback is processiong the received data/echo correctly. 
+        //This state (tx_echo_rx) is handled in the serial receive IRQ callback
+        _comms.tx.echo_length = 0;
+        _comms.tx.echo_ok = false;
+        _tx_state = tx_echo_rx;
+        hal_serial_write(STX);
     
-        //wait here for the bus to go silent!
-        while (_rx_state != rx_listen)
+        for (uint8_t i = 0; i < _comms.tx.frame_length; i++)
         {
-            //Wait here for the bus to be free again (should not be more than 15ms)
-        }
-        
-        {   //NO PRINT SECTION START            
-            //Make sure any console prints are finished before we start sending... 
-            hal_serial_flush(); 
-
-            //We need to enable RS485 RX while we are doing this transmission, 
-            //Will be disabled again once the transmission is done
-            sys_output_write(output_RS485_DE, HIGH);
-
-            hal_serial_write(STX);
-            //We need to make sure our IRQ callback is processiong the received data/echo correctly. 
-            //This state (tx_echo_rx) is handled in the serial receive IRQ callback
-            _tx_state = tx_echo_rx;
-        
-            for (uint8_t i = 0; i < msg_len; i++)
+            uint8_t tx_data = _dev_comms_tx_frame_byte(i);
+            if ((tx_data == STX) || (tx_data == DLE) || (tx_data == ETX))
             {
-                uint8_t tx_data = msg[i];
-                if ((tx_data == STX) || (tx_data == DLE) || (tx_data == ETX))
-                {
-                    hal_serial_write(DLE);
-                    tx_data ^= DLE;
-                }
-                hal_serial_write(tx_data);
+                hal_serial_write(DLE);
+                tx_data ^= DLE;
             }
-            hal_serial_write(ETX);
-            //Right, we've sent the message (well, actually we've only loaded it into 
-            // the hal_serial tx buffer, but the transmission should have started already), 
-            // now we need to wait and check if we received it correctly (pleasures of half-duplex comms)
-
-            //Make sure the entire message is sent over RS485 before we disable the RS485 again
-            hal_serial_flush(); 
-
-            //We need to disable RS485 RX once the transmission is done, otherwise we will risk a collision on the bus with other nodes
-            sys_output_write(output_RS485_DE, LOW);
-
-            hal_serial_write('\r'); //Just to make sure we have a clean line
-            hal_serial_write('\n'); //Just to make sure we have a clean line for our next printf message
-        
-            _comms.tx.retry_cnt++;
-        } //NO PRINT SECTION END
-    
-        // If our TX state goes into idle, we got it (all handled by the interrupts)
-        // otherwise, if the rx state goes into listen, a completed message has been received, but not matched (bus collision?)
-        // Lastly, if the bus is silent for a period, then everybody is waiting for everybody.
-        do //
-        {
-    
-            if (_tx_state == tx_idle) // ECHO RECEIVED - All good, baby!
-                return true; //we are done here
+            hal_serial_write(tx_data);
+        }
+        hal_serial_write(ETX);
+        //Right, we've sent the message (well, actually we've only loaded it into 
+        // the hal_serial tx buffer, but the transmission should have started already), 
+        // the echo is checked in the RX IRQ and the outcome in dev_comms_service() (pleasures of half-duplex comms)
 
-            if (_rx_state == rx_listen)
-            {
-                iprintln(trCOMMS, "#Bus Collision");
-                iprintln(trCOMMS, "#TX Err - %d bytes (seq %d)", _comms.tx.data_length + sizeof(comms_msg_hdr_t) + sizeof(uint8_t), _comms.tx.msg.hdr.id);
-                console_print_ram(trCOMMS, (uint8_t *)&_comms.tx.msg, 0, _comms.tx.data_length + sizeof(comms_msg_hdr_t) + sizeof(uint8_t));
-                iprintln(trCOMMS, "#Last RX - %d bytes (seq %d)", _comms.rx.length, _comms.rx.msg.hdr.id);
-                console_print_ram(trCOMMS, (uint8_t *)&_comms.rx.msg, 0, _comms.rx.length);
-                break; //from do-while loop
-            }
+        //Make sure the entire message is sent over RS485 before we disable the RS485 again
+        hal_serial_flush(); 
 
-            if (_tx_state == tx_echo_rx)
-            {
-                iprintln(trCOMMS, "#No ECHO Rx'd");
-                break; //from do-while loop
-            }
-            
+        //We need to disable RS485 RX once the transmission is done, otherwise we will risk a collision on the bus with other nodes
+        sys_output_write(output_RS485_DE, LOW);
 
-        }while (_tx_state == tx_echo_rx); //Wait for the echo to be received
+        hal_serial_write('\r'); //Just to make sure we have a clean line
+        hal_serial_write('\n'); //Just to make sure we have a clean line for our next printf message
     
-        //Reaching this point means we have not received an echo of our message, so we need to retry it
-        //We have retried this message too many times, so we need to give up and move on
-    }while (_comms.tx.retry_cnt < 5);//(_tx_state != tx_idle); //Wait for the bus to be free again
+        _comms.tx.retry_cnt++;
+    } //NO PRINT SECTION END
+}
 
-    iprintln(trCOMMS, "#TX Abandonded after %d tries (0x%02X)", _comms.tx.retry_cnt, _comms.tx.msg.hdr.id);
+uint8_t _dev_comms_tx_frame_byte(uint8_t index)
+{
+    //The frame is [hdr][the data of this fragment][CRC], which (past the 1st fragment) is not in one piece in the msg buffer
+    if (index < sizeof(comms_msg_hdr_t))
+        return ((uint8_t *)&_comms.tx.msg.hdr)[index];
 
-    //We increment the sequence number, so that the master will know that something went wrong
-    _comms.tx.seq++;
+    index -= sizeof(comms_msg_hdr_t);
+    if (index < _comms.tx.msg.hdr.len)
+        return _comms.tx.msg.data[_comms.tx.frame_offset + index];
 
-    //Return to an idle state, so that we can start a new message
-    _tx_state = tx_idle;
+    return _comms.tx.frame_crc;
+}
+
+void dev_comms_link_stats(link_stats_t * stats, bool clear)
+{
+    if (stats != NULL)
+        memcpy(stats, &_comms.link, sizeof(link_stats_t));
 
-    return false; //We have failed to send the message
+    if (clear)
+        memset(&_comms.link, 0, sizeof(link_stats_t));
 }
 
 uint8_t dev_comms_addr_get(void)
@@ -679,7 +958,7 @@ uint8_t dev_comms_addr_new(void)
     return _comms.addr;
 }
 
-int8_t dev_comms_rx_msg_available(uint8_t * _src, uint8_t * _dst, uint8_t * _data)
+int8_t dev_comms_rx_msg_available(uint8_t * _src, uint8_t * _dst, uint8_t * _data, uint8_t * _id)
 {
     // static comms_msg_rx_state_t _last_rx_state = rx_listen;
     // static comms_msg_tx_state_t _last_tx_state = tx_idle;
@@ -693,18 +972,22 @@ int8_t dev_comms_rx_msg_available(uint8_t * _src, uint8_t * _dst, uint8_t * _dat
 
     if (ret_val < 0)
     {
-        iprintln(trCOMMS, "#RX Error: %d (%d bytes):", ret_val, /*_comms_rx_error_msg(ret_val, err_data), */ _comms.rx.length);
-        console_print_ram(trCOMMS, &_comms.rx.msg, (unsigned long)&_comms.rx.msg, sizeof(comms_msg_t));
-        memset(&_comms.rx.msg, 0, sizeof(comms_msg_t));
+        if (ret_val == rx_err_crc)
+            _link_cnt_inc(&_comms.link.crc_err);
+        itrace(trCOMMS, "#RX Error: %d (%d bytes)", ret_val, /*_comms_rx_error_msg(ret_val, err_data), */ _comms.rx.length);
+#if DEV_COMMS_DEBUG == 1
+        console_print_ram(trCOMMS, &_comms.rx.msg, (unsigned long)&_comms.rx.msg, sizeof(comms_frame_t));
+#endif /* DEV_COMMS_DEBUG */
+        memset(&_comms.rx.msg, 0, sizeof(comms_frame_t));
     }
-    else
+    else if ((ret_val = _dev_comms_reassemble(_data)) > 0)
     {
         if (_src != NULL)
             *_src = _comms.rx.msg.hdr.src;
         if (_dst != NULL)
             *_dst = _comms.rx.msg.hdr.dst;
-        if ((_data != NULL) && (ret_val > 0))
-            memcpy(_data, &_comms.rx.msg.data, ret_val);
+        if (_id != NULL)
+            *_id = _comms.rx.msg.hdr.id;
     }
 
     //iprintln(trCOMMS, "#RX %d bytes data", ret_val);
@@ -21,6 +21,13 @@ Macros
 /******************************************************************************
 Struct & Unions
 ******************************************************************************/
+typedef enum e_dev_comms_tx_result
+{
+    tx_result_none,     // Nothing has been sent yet
+    tx_result_busy,     // Queued, waiting for the bus or the echo (see dev_comms_service())
+    tx_result_ok,       // The echo matched what we sent
+    tx_result_failed,   // Abandoned after DEV_COMMS_TX_TRIES_MAX tries
+}dev_comms_tx_result_t;
 
 /******************************************************************************
 Public variables
@@ -33,7 +40,13 @@ void dev_comms_init(void);
 
 bool dev_comms_tx_ready(void);
 
-int8_t dev_comms_rx_msg_available(uint8_t * _src, uint8_t * _dst, uint8_t * _data);
+/*! Checks for a received msg, reassembling fragmented msgs (for us) as they come in
+ * @param[out] _src, _dst, _id The header of the msg (only set once the whole msg has been received)
+ * @param[out] _data Where the msg data is copied to, must hold RGB_BTN_MSG_MAX_DATA_LEN bytes and be left 
+ *              untouched between calls, since the fragments are reassembled directly into it
+ * @return The length of the msg data, 0 if there is no (complete) msg yet, or < 0 on error
+*/
+int8_t dev_comms_rx_msg_available(uint8_t * _src, uint8_t * _dst, uint8_t * _data, uint8_t * _id = NULL);
 
 uint8_t dev_comms_addr_get(void);
 void dev_comms_addr_set(uint8_t addr);
@@ -50,8 +63,46 @@ unsigned int dev_comms_response_append(master_command_t cmd, response_code_t res
 size_t dev_comms_response_add_byte(uint8_t data);
 #endif /* REMOTE_CONSOLE_SUPPORTED */
 
+/*! Queues the response msg for transmission, which is done by dev_comms_service() as soon as the bus is free
+ * (a fragment at a time, if longer than a frame)
+ * @return True if queued (or if there is nothing to send), use dev_comms_tx_result() for the outcome
+*/
 bool dev_comms_transmit_now(void);
 
+/*! Reads the outcome of the last transmission
+ * @return tx_result_busy while the transmission is still in progress
+*/
+dev_comms_tx_result_t dev_comms_tx_result(void);
+
+/*! Advances the transmission state machine (backoff, waiting for bus silence, sending and checking the echo, 
+ * queueing the next fragment).
+ * Must be called from the main loop.
+*/
+void dev_comms_service(void);
+
+/*! Starts caching the responses to a direct msg from the master, so that they can be replayed if the 
+ * master resends the msg (i.e. our response got lost) instead of executing the commands again.
+ * @param[in] seq The ID of the master's msg
+ * @return True if this is a resend of the previous msg (use dev_comms_response_replay())
+*/
+bool dev_comms_response_cache_start(uint8_t seq);
+
+/*! Stops caching responses (call once the response to the master's msg is done)
+*/
+void dev_comms_response_cache_stop(void);
+
+/*! Appends the cached response to a command again
+ * @param[in] cmd The command (as resent by the master)
+ * @return True if the response was replayed, false if the command has to be executed (again)
+*/
+bool dev_comms_response_replay(master_command_t cmd);
+
+/*! Reads the link quality counters of this node
+ * @param[out] stats Pointer to where the counters should be copied (can be NULL)
+ * @param[in] clear Set to true to clear the counters once read
+*/
+void dev_comms_link_stats(link_stats_t * stats, bool clear);
+
 
 #endif /* __dev_comms_H__ */
 
@@ -78,6 +78,9 @@ as it was received on the console */
 
 #define CONSOLE_READ_INTERVAL_MS      100     /* Task cycles at a 10Hz rate*/
 
+/* The number of itrace() records that can wait for the main loop - Usage: RAM: 11 bytes/record */
+#define CONSOLE_TRACE_RING_LEN      (8)
+
 
 const char BACKSPACE_ECHO[] = {0x08, 0x20, 0x08, 0x00};
 
@@ -124,6 +127,23 @@ typedef struct
 }	
 sPrintFlagActionItem;
 
+typedef struct
+{
+	const char * fmt;   /* In PROGMEM */
+	const char * tag;
+	uint16_t time;      /* Low 16 bits of the ms timer when the record was made */
+	int arg[2];
+	uint8_t flags;
+}console_trace_rec_t;
+
+typedef struct
+{
+	console_trace_rec_t rec[CONSOLE_TRACE_RING_LEN];
+	volatile uint8_t head;  /* Written only by console_trace() */
+	volatile uint8_t tail;  /* Written only by _console_trace_drain() */
+	uint8_t drops;
+}console_trace_t;
+
 typedef struct
 {
 	uint8_t tracemask;
@@ -260,6 +280,22 @@ void console_printline(uint8_t traceflags, const char * tag, const char *fmt, ..
  */ 
 void _console_handler_trace_action(eTraceFlagAction def_act);
 
+/*! Prints the tag (and timestamp) if the format string starts with '#' or '!'
+ * @param[in] fmt The format string (in PROGMEM)
+ * @param[in] tag The tag to print
+ * @param[in] t_now The timestamp to print
+ * @return true if the tag was printed
+ */
+bool _console_print_tag_at(const char * fmt, const char * tag, uint32_t t_now);
+
+/*! Returns the current ms timer, as used for the timestamps in the prints
+ */
+uint32_t _console_now(void);
+
+/*! Prints all the records waiting in the trace ring
+ */
+void _console_trace_drain(void);
+
 /*******************************************************************************
 local variables
  *******************************************************************************/
@@ -291,6 +327,7 @@ static console_menu_item_t _console_menu_items[] =
 };
 
 DeviceConsole_t _console;
+console_trace_t _trace;
 bool _console_init_done = false;
 FILE _console_stdiostr;
 va_list _console_ap;
@@ -849,6 +886,8 @@ void console_init(size_t (*cb_write)(uint8_t), void (*cb_flush)(void))
 
 void console_service(void)
 {
+    _console_trace_drain();
+
     if (_console.rx.line_end == 0)
 		return;
 
@@ -1095,18 +1134,27 @@ bool console_arg_help_found(void)
 
 const char errstr[] = "ERROR";
 
+uint32_t _console_now(void)
+{
+#if CLOCK_CORRECTION_ENABLED == 1
+    return sys_millis();
+#else
+    return millis();
+#endif /* CLOCK_CORRECTION_ENABLED */
+}
+
 bool console_print_tag(const char * fmt, const char * tag)
+{
+    return _console_print_tag_at(fmt, tag, _console_now());
+}
+
+bool _console_print_tag_at(const char * fmt, const char * tag, uint32_t t_now)
 {
 	//A line starts with the tag if the format string starts with "#"
     //Remember, the format string is in PROGMEM
     char fmt_char = pgm_read_byte(fmt);
     if ((fmt_char == '#') || (fmt_char == '!'))
     {
-#if CLOCK_CORRECTION_ENABLED == 1
-        uint32_t t_now = sys_millis();
-#else
-        uint32_t t_now = millis();
-#endif /* CLOCK_CORRECTION_ENABLED */
         for (uint32_t div = 10000000; div >= 1; div /= 10)
         {
             uint8_t digit = (t_now / div) % 10;
@@ -1191,6 +1239,68 @@ void console_printline(uint8_t traceflags, const char * tag, const char * fmt, .
 //     serialputc('\n', NULL);
 // }
 
+void console_trace(uint8_t traceflags, const char * tag, const char * fmt, int arg0, int arg1)
+{
+    console_trace_rec_t * rec;
+    uint8_t sreg;
+
+    if (((trALWAYS | _console.tracemask) & traceflags) == trNONE)
+		return;
+
+    //This can be called from the main loop as well as from an IRQ, so the slot is claimed with the IRQs off
+    sreg = SREG;
+    cli();
+    if ((uint8_t)(_trace.head - _trace.tail) >= CONSOLE_TRACE_RING_LEN)
+    {
+        if (_trace.drops < UINT8_MAX)
+            _trace.drops++;
+        SREG = sreg;
+        return;
+    }
+    rec = &_trace.rec[_trace.head % CONSOLE_TRACE_RING_LEN];
+    rec->fmt = fmt;
+    rec->tag = tag;
+    rec->time = (uint16_t)_console_now();
+    rec->arg[0] = arg0;
+    rec->arg[1] = arg1;
+    rec->flags = traceflags;
+    _trace.head++;
+    SREG = sreg;
+}
+
+void _console_trace_drain(void)
+{
+#if REMOTE_CONSOLE_SUPPORTED == 1    
+    //Traces are not streamed to the master - they will wait until the console is back on the serial port
+    if (_console.alt_write)
+        return;
+#endif /* REMOTE_CONSOLE_SUPPORTED */
+
+    while (_trace.tail != _trace.head)
+    {
+        console_trace_rec_t * rec = &_trace.rec[_trace.tail % CONSOLE_TRACE_RING_LEN];
+
+        //The trace mask could have changed since the record was made
+        if (((trALWAYS | _console.tracemask) & rec->flags) != trNONE)
+        {
+            //Records never wait more than a few loops, so the 16 bit timestamp is enough to rebuild the full one
+            uint32_t t_now = _console_now();
+            const char * fmt = rec->fmt;
+            if (_console_print_tag_at(fmt, rec->tag, t_now - (uint16_t)((uint16_t)t_now - rec->time)))
+                fmt++;
+            fprintf_P(&_console_stdiostr, fmt, rec->arg[0], rec->arg[1]);
+            serialputc('\n', NULL);
+        }
+        _trace.tail++;
+    }
+
+    if (_trace.drops)
+    {
+        iprintln(trCONSOLE, "#%d traces dropped", _trace.drops);
+        _trace.drops = 0;
+    }
+}
+
 void console_print_ram(int Flags, void * Src, unsigned long Address, int Len)
 {
 uint8_t *s;
@@ -15,6 +15,7 @@ includes
 //#include "defines.h"
 
 #include "sys_utils.h"
+#include "../../../../common/common_defines.h"
 
 /******************************************************************************
 Macros
@@ -44,6 +45,10 @@ extern void console_print(uint8_t traceflags, const char * tag, const char *fmt,
 #define trALL		((uint8_t)(~trALWAYS))
 #define trNONE		((uint8_t)0)
 
+/* The compile-time trace level of a module - undefine and redefine it at the 
+    top of a cpp-file to override (see common_defines.h) */
+#define TRACE_LEVEL     (CONSOLE_TRACE_LEVEL)
+
 #ifndef CONSOLE_ENABLED
 void dummy_print_func(void){/* Do nothing */}
 #endif /* CONSOLE_ENABLED */
@@ -54,10 +59,13 @@ Print an entire line (or not). A leading '#' is replaced with the PRINTF_TAG,
  and the print is concluded with an newline character.
 The passed traceflags is compared with the system set trace print flag(s) to
  determine if the print can happen or not.
+Trace points below the TRACE_LEVEL of the module are not compiled in at all, 
+ which also keeps their PSTR() format strings out of flash.
 ******************************************************************************/
 #ifdef CONSOLE_ENABLED
 //#define err_println(fmtstr, ...) error_printline(PRINTF_TAG, PSTR(fmtstr), ##__VA_ARGS__)
-#define iprintln(traceflags, fmtstr, ...) console_printline(traceflags, PRINTF_TAG, PSTR(fmtstr), ##__VA_ARGS__)
+#define iprintln(traceflags, fmtstr, ...) do { if (TRACE_COMPILED(traceflags, trALWAYS, fmtstr)) \
+                                                console_printline(traceflags, PRINTF_TAG, PSTR(fmtstr), ##__VA_ARGS__); } while (0)
 #else
 #define err_println(fmtstr, ...) dummy_print_func()
 #define iprintln(traceflags, fmtstr, ...) dummy_print_func()
@@ -66,11 +74,25 @@ The passed traceflags is compared with the system set trace print flag(s) to
 "Incomplete" version of dbgPrint.... no "\n" added at the end
 ******************************************************************************/
 #ifdef CONSOLE_ENABLED
-#define iprint(traceflags, fmtstr, ...) console_print(traceflags, PRINTF_TAG, PSTR(fmtstr), ##__VA_ARGS__)
+#define iprint(traceflags, fmtstr, ...) do { if (TRACE_COMPILED(traceflags, trALWAYS, fmtstr)) \
+                                                console_print(traceflags, PRINTF_TAG, PSTR(fmtstr), ##__VA_ARGS__); } while (0)
 #else
 #define iprint(traceflags, fmtstr, ...) dummy_print_func()
 #endif /* CONSOLE_ENABLED */
 
+/******************************************************************************
+Deferred version of iprintln for time critical code (e.g. in the middle of a 
+ bus transaction). Only the format string, tag and up to 2 int arguments are 
+ recorded; the line is printed from console_service() in the main loop.
+IMPORTANT: Integer arguments only (no "%s" or "%ld")
+******************************************************************************/
+#ifdef CONSOLE_ENABLED
+#define itrace(traceflags, fmtstr, ...) do { if (TRACE_COMPILED(traceflags, trALWAYS, fmtstr)) \
+                                                console_trace(traceflags, PRINTF_TAG, PSTR(fmtstr), ##__VA_ARGS__); } while (0)
+#else
+#define itrace(traceflags, fmtstr, ...) dummy_print_func()
+#endif /* CONSOLE_ENABLED */
+
 /******************************************************************************
 Struct & Unions
 ******************************************************************************/
@@ -141,6 +163,16 @@ int console_arg_cnt(void);
  */
 bool console_arg_help_found(void);
 
+/*! Records a line in the trace ring, to be printed from console_service() - 
+ *   use the itrace() macro rather than calling this directly.
+ * @param[in] traceflags The trace flags to compare with the system trace flags
+ * @param[in] tag The tag of the calling module
+ * @param[in] fmt The format string (in PROGMEM)
+ * @param[in] arg0 The first (int) argument of the format string
+ * @param[in] arg1 The second (int) argument of the format string
+ */
+void console_trace(uint8_t traceflags, const char * tag, const char * fmt, int arg0 = 0, int arg1 = 0);
+
 /*! Prints a section of RAM
  */
 void console_print_ram(int Flags, void * Src, unsigned long Address, int Len);
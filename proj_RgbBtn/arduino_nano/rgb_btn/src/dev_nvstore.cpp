@@ -4,18 +4,29 @@ Purpose:    This file contains the Non-Volatile storage functions for the
              arduino nano, which makes use of the 1kB EEPROM to store data.
 Author:     Rudolph van Niekerk
 
-The 8-byte header describes the block of data that follows. The header contains:
+The EEPROM is a log of fixed size blocks (records), each with a key. The 
+7-byte header describes the record that follows. The header contains:
   - A magic number to identify the block
-  - The length of the data in the block
-  - A CRC of the entire block of data
   - The number of times this block has been written to.
-
-At startup, the system will read the EEPROM and check the magic number, and 
-find the last block of data that was written to. This will be the block that
-is used for reading. Writing will always be done to the next block. The block 
-sizes are fixed, to make it easier to manage the EEPROM space and ensure that 
-the system can keep accurate track of the number of times a block has been 
-written.
+  - The key of the record (0 to NVSTORE_KEY_CNT-1)
+The CRC of the entire block is the last byte of the block.
+
+Writing is always done to the next block, so the latest record of a key is the
+last block written with that key. At startup, the system finds the last block 
+written (the head) with a binary search on the write counts (see below), and 
+then walks back from the head (headers only) until it has found the latest 
+record of every key. This index (key -> block) is all that is kept in RAM. 
+The block sizes are fixed, to make it easier to manage the EEPROM space and 
+ensure that the system can keep accurate track of the number of times a block 
+has been written.
+
+The oldest block is always the next one to be overwritten, so the latest 
+record of a key must never be the oldest block. Before a record is written, 
+the latest record of any other key which is next in line is copied to the 
+head first (its old copy is only overwritten after that).
+
+Blocks written by the fw before the keyed records had a version (0x00) where
+the key is now, so they read as records of key 0.
 
 The Write count is used to determine 2 things:
 1) Which was the last block written to (i.e. which data is current)
@@ -30,7 +41,11 @@ The first block written will be 0, the 2nd block will be 1....
 
  At any given point, the block with the highest write count will be the most
  recent block written to, and its write count/64 will be the number of times that 
- block of EEPROM has been written to.
+ block of EEPROM has been written to. 
+ 
+ This also means that the write counts go up from block 0 to the head, and then 
+ drop to those of the previous round (or to blocks never written, which count as 
+ 0), so the head is found in log2(64) = 6 header reads.
 
  By cycling though the entire eeprom, we are creating an inherent "wear levelling"
  mechanism, which should ensure that the EEPROM will last longer than if we were 
@@ -77,7 +92,8 @@ local defines
 #define NVSTORE_BLOCK_CNT       (NVSTORE_SIZE / NVSTORE_BLOCK_SIZE) /* The number of blocks in the EEPROM */
 #define NVSTORE_WR_CNT_MAX      (100000 * NVSTORE_BLOCK_CNT)    /* The maximum number of write cycles in the EEPROM */
 
-#define NVSTORE_DATA_VERSION    (0x00)      /* The current supported version of the data in the block */
+#define NVSTORE_BLOCK_NONE      (0xFF)      /* Not a block (e.g. the index of a key which was never written) */
+#define NVSTORE_KEY_NONE        (0xFF)      /* Not a key (e.g. a block which is not the latest record of a key) */
 
 //#define NVSTORE_MAGIC_BAD       (0x0BAD)    /* A magic number to identify the block as BAD (several CRC failures?) */
 
@@ -89,7 +105,7 @@ typedef struct
     uint16_t magic;         /* A magic number to identify the block */
     uint32_t wr_cnt;        /* The write count of blocks for the entire EEPROM. 
                                 The first block written will be 0, the next block will be 1.... when it comes to the first block again, it will be 64 (1024/block size) */
-    uint8_t version;        /* Version of the data in the block (defines the data content) */
+    uint8_t key;            /* The key of the record (defines the data content) */
 } nvstore_block_header_t;
 
 #define NVSTORE_BLOCK_DATA_SIZE (NVSTORE_BLOCK_SIZE - sizeof(nvstore_block_header_t) - sizeof(uint8_t))
@@ -105,22 +121,26 @@ typedef struct
 {
     struct 
     {
-        uint8_t     last_rd;
         uint8_t     next_wr;
         uint32_t    wr_cnt;
     } current;
-    nvstore_block_t rd_block;
-    bool            new_data;
+    uint8_t         index[NVSTORE_KEY_CNT]; /* The block of the latest record of each key (NVSTORE_BLOCK_NONE if there is none) */
+    uint8_t         new_data;               /* A bit for each key with a record which has not been read yet */
 #if (DEV_NVSTORE_DEBUG == 1)
     stopwatch_ms_t sw;
+    uint16_t        rd_cnt;                 /* The EEPROM bytes read (at startup) */
 #endif /* DEV_NVSTORE_DEBUG */
 } dev_nvstore_t;
 
 /*******************************************************************************
  Local function prototypes
  *******************************************************************************/
-uint8_t _nvstore_write_next_block_data(uint8_t * data);
+uint8_t _nvstore_write_next_block_data(uint8_t key, uint8_t * data);
 uint8_t _nvstore_read_block(uint8_t * data, uint8_t block_nr);
+void _nvstore_read_hdr(nvstore_block_header_t * hdr, uint8_t block_nr);
+uint32_t _nvstore_block_wr_cnt(uint8_t block_nr);
+uint8_t _nvstore_block_key(uint8_t block_nr);
+bool _nvstore_write_record(uint8_t key, uint8_t * data);
 
 void _dev_nvstore_menu_handler_print_block(uint8_t flags, uint8_t block_nr, nvstore_block_t * block, uint8_t calc_crc);
 
@@ -161,10 +181,42 @@ uint8_t _nvstore_read_block(uint8_t * data, uint8_t block_nr)
         data[i] = EEPROM.read(_rd_addr + i);
         block_crc = crc8(block_crc, data[i]);
     }
+#if (DEV_NVSTORE_DEBUG == 1)
+    _nvstore.rd_cnt += NVSTORE_BLOCK_SIZE;
+#endif /* DEV_NVSTORE_DEBUG */
     return block_crc; //Should be 0x00
 }
 
-uint8_t _nvstore_write_next_block_data(uint8_t * data)
+void _nvstore_read_hdr(nvstore_block_header_t * hdr, uint8_t block_nr)
+{
+    int _rd_addr = block_nr * NVSTORE_BLOCK_SIZE;
+
+    for (unsigned int i = 0; i < sizeof(nvstore_block_header_t); i++)
+        ((uint8_t *)hdr)[i] = EEPROM.read(_rd_addr + i);
+#if (DEV_NVSTORE_DEBUG == 1)
+    _nvstore.rd_cnt += sizeof(nvstore_block_header_t);
+#endif /* DEV_NVSTORE_DEBUG */
+}
+
+uint32_t _nvstore_block_wr_cnt(uint8_t block_nr)
+{
+    nvstore_block_header_t hdr;
+
+    _nvstore_read_hdr(&hdr, block_nr);
+    return (hdr.magic == NVSTORE_MAGIC)? hdr.wr_cnt : 0; //A block never written counts as 0
+}
+
+uint8_t _nvstore_block_key(uint8_t block_nr)
+{
+    for (uint8_t key = 0; key < NVSTORE_KEY_CNT; key++)
+    {
+        if (_nvstore.index[key] == block_nr)
+            return key;
+    }
+    return NVSTORE_KEY_NONE;
+}
+
+uint8_t _nvstore_write_next_block_data(uint8_t key, uint8_t * data)
 {
     nvstore_block_t _tmp_block;
     uint8_t         block_nr    = _nvstore.current.next_wr;
@@ -173,7 +225,7 @@ uint8_t _nvstore_write_next_block_data(uint8_t * data)
 
     _tmp_block.hdr.magic = NVSTORE_MAGIC;
     _tmp_block.hdr.wr_cnt = _nvstore.current.wr_cnt + 1;
-    _tmp_block.hdr.version = NVSTORE_DATA_VERSION;
+    _tmp_block.hdr.key = key;
     memcpy(_tmp_block.data, data, NVSTORE_BLOCK_DATA_SIZE);
     _tmp_block.crc = crc8_n(0, (uint8_t *)&_tmp_block, NVSTORE_BLOCK_SIZE-1);
 
@@ -184,13 +236,46 @@ uint8_t _nvstore_write_next_block_data(uint8_t * data)
         EEPROM.write(wr_addr+i, src[i]);
 
     _nvstore.current.next_wr = (block_nr + 1) % NVSTORE_BLOCK_CNT;
-    _nvstore.new_data = true;
 
     iprintln(trNVSTORE, "Next block to write: %d", _nvstore.current.next_wr);
 
     return block_nr;
 }
 
+bool _nvstore_write_record(uint8_t key, uint8_t * data)
+{
+    nvstore_block_t _tmp_block;
+    uint8_t wr_block_nr = 0;
+    uint8_t calc_crc = 0;
+
+    //Now write the EEPROM...
+    wr_block_nr = _nvstore_write_next_block_data(key, data);
+
+    //...and then read it back to confirm it is correctly written.
+    calc_crc = _nvstore_read_block((uint8_t *)&_tmp_block, wr_block_nr);
+    if (calc_crc != 0)
+    {
+        iprintln(trNVSTORE, "#CRC ERR - block %d - 0x%02X (Exp: 0x00)", wr_block_nr, _tmp_block.crc);
+        return false;
+    }
+    if (_tmp_block.hdr.wr_cnt != (_nvstore.current.wr_cnt + 1))
+    {
+        iprintln(trNVSTORE, "#WR Cnt ERR - block %d - %06lu (Exp: %06lu)", wr_block_nr, _tmp_block.hdr.wr_cnt, _nvstore.current.wr_cnt + 1);
+        return false;
+    }
+    if (memcmp(data, &_tmp_block.data, NVSTORE_BLOCK_DATA_SIZE) != 0)
+    {
+        iprintln(trNVSTORE, "#Data mismatch - block %d", wr_block_nr);
+        console_print_ram(trNVSTORE, data, 256 + wr_block_nr, NVSTORE_BLOCK_DATA_SIZE);
+        console_print_ram(trNVSTORE, &_tmp_block.data, wr_block_nr, NVSTORE_BLOCK_SIZE);
+        return false;
+    }
+    _nvstore.current.wr_cnt = _tmp_block.hdr.wr_cnt;
+    _nvstore.index[key] = wr_block_nr;
+    SET_BIT(_nvstore.new_data, key);
+    return true;
+}
+
 void _dev_nvstore_menu_handler_print_block(uint8_t flags, uint8_t block_nr, nvstore_block_t * block, uint8_t calc_crc)
 {
     uint8_t status = 0;
@@ -198,7 +283,7 @@ void _dev_nvstore_menu_handler_print_block(uint8_t flags, uint8_t block_nr, nvst
         SET_BIT(status, 0);
     if (calc_crc != 0)
         SET_BIT(status, 1);
-    if (block->hdr.version != NVSTORE_DATA_VERSION)
+    if (block->hdr.key >= NVSTORE_KEY_CNT)
         SET_BIT(status, 2);
 
     iprint(flags, "NVStore Block %d/%d ", block_nr, NVSTORE_BLOCK_CNT);
@@ -206,11 +291,11 @@ void _dev_nvstore_menu_handler_print_block(uint8_t flags, uint8_t block_nr, nvst
         iprint(flags, "- UNUSED");
     else if (calc_crc != 0)
         iprint(flags, "- BAD CRC (0x%02X)", block->crc);
-    else if (block->hdr.version != NVSTORE_DATA_VERSION)
-        iprint(flags, "- Unknown Version (%d)", block->hdr.version);
+    else if (block->hdr.key >= NVSTORE_KEY_CNT)
+        iprint(flags, "- Unknown Key (%d)", block->hdr.key);
     else //if (status == 0)
     {
-        iprint(flags, "(Wr Cnt: %lu)", block->hdr.wr_cnt/NVSTORE_BLOCK_CNT);
+        iprint(flags, "(Key %d, Wr Cnt: %lu)", block->hdr.key, block->hdr.wr_cnt/NVSTORE_BLOCK_CNT);
         for (unsigned int i = 0; i < NVSTORE_BLOCK_DATA_SIZE; i++)
             iprint(flags, "%02X ", block->data[i]);
     }
@@ -228,16 +313,15 @@ void _dev_nvstore_menu_handler_rd(void)
     uint8_t block_crc = 0;
 
 
-    if (console_arg_cnt() == 0) // Show the current state of the PWM
+    if (console_arg_cnt() == 0) // Show the latest record of each key
     {
-        if (_nvstore.current.last_rd >= NVSTORE_BLOCK_CNT)
+        for (uint8_t key = 0; key < NVSTORE_KEY_CNT; key++)
         {
-            iprintln(trNVSTORE, "No valid block exists in NV Store");
+            if (_nvstore.index[key] == NVSTORE_BLOCK_NONE)
+                continue; //Never written
+            block_crc = _nvstore_read_block((uint8_t *)&_tmp_block, _nvstore.index[key]);
+            _dev_nvstore_menu_handler_print_block(trALWAYS, _nvstore.index[key], &_tmp_block, block_crc);
         }
-        else
-        {
-            _dev_nvstore_menu_handler_print_block(trALWAYS, _nvstore.current.last_rd, &_nvstore.rd_block, 0x00);
-        }        
     }
 
     //Go through every available argument
@@ -281,7 +365,7 @@ void _dev_nvstore_menu_handler_rd(void)
         iprintln(trALWAYS, " Usage: \"read [<block index 0 to %d>]\"", NVSTORE_BLOCK_CNT-1);
 #if REDUCE_CODESIZE==0        
         iprintln(trALWAYS, "    <block #>   - A Block number (0-%d)", NVSTORE_BLOCK_CNT-1);
-        iprintln(trALWAYS, "    If <block #> is omitted, the current block is read");
+        iprintln(trALWAYS, "    If <block #> is omitted, the latest record of each key is read");
         //                //          1         2         3         4         5         6         7         8         9
         //                //0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890
 #endif /* REDUCE_CODESIZE */
@@ -297,11 +381,24 @@ void _dev_nvstore_menu_handler_wr(void)
     unsigned int bytes_to_parse = 0;
     bool buff_full = false;
     char * src;
+    uint32_t key = NVSTORE_KEY_NONE;
 
     while ((console_arg_cnt() > 0) && (!help_requested))
     {
         argStr = console_arg_pop();\
 
+        if (key == NVSTORE_KEY_NONE)
+        {
+            //The 1st argument is the key
+            if ((!str2uint32(&key, argStr, 0)) || (key >= NVSTORE_KEY_CNT))
+            {
+                iprintln(trALWAYS, "Invalid key \"%s\"", argStr);
+                help_requested = true;
+                break;
+            }
+            continue; // with the next argument
+        }
+
         /*if ((0 == strcasecmp(argStr, "help")) || (0 == strcasecmp(argStr, "?"))) //is it a ? or help
         {
             help_requested = true; //Disregard the rest of the arguments
@@ -423,7 +520,7 @@ void _dev_nvstore_menu_handler_wr(void)
         {
             help_requested = true;
         }
-        else if (!dev_nvstore_write(_tmp_data, NVSTORE_BLOCK_DATA_SIZE-space_left))
+        else if (!dev_nvstore_write((uint8_t)key, _tmp_data, NVSTORE_BLOCK_DATA_SIZE-space_left))
         {
             iprintln(trALWAYS, "!! ERROR !! Failed to write data to EEPROM");
         }
@@ -431,14 +528,15 @@ void _dev_nvstore_menu_handler_wr(void)
 
     if (help_requested)
     {
-        iprintln(trALWAYS, " Usage: \"write [<element_1> <element_2> ... <element_%d>]\"", NVSTORE_BLOCK_DATA_SIZE);
+        iprintln(trALWAYS, " Usage: \"write <key> [<element_1> <element_2> ... <element_%d>]\"", NVSTORE_BLOCK_DATA_SIZE);
 #if REDUCE_CODESIZE==0        
+        iprintln(trALWAYS, "    <key>     - The key of the record (0-%d)", NVSTORE_KEY_CNT-1);
         iprintln(trALWAYS, "    <element> - up to %d data elements as hex values (0x..), strings (\"..\") or integers", NVSTORE_BLOCK_DATA_SIZE);
         // iprintln(trALWAYS, "    <element> - up to %d data elements in any of the following formats:", NVSTORE_BLOCK_DATA_SIZE);
         // iprintln(trALWAYS, "              * hex value strings (preceded '0x...')");
         // iprintln(trALWAYS, "              * string(s) (enclosed in \"...\" or '...'");
         // iprintln(trALWAYS, "              * integer values  (e.g \"11 255 -71 23 1290 91\")");
-        iprintln(trALWAYS, "     Multiple elements can be given, seperated by spaces, e.g \"write 11 0xff -7 '23' 1290\"");
+        iprintln(trALWAYS, "     Multiple elements can be given, seperated by spaces, e.g \"write 3 11 0xff -7 '23' 1290\"");
         iprintln(trALWAYS, "     Hex and integer data is stored in big-endian format (i.e. LSB to MSB)");
         //                //          1         2         3         4         5         6         7         8         9
         //                //0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890
@@ -453,74 +551,80 @@ void _dev_nvstore_menu_handler_wr(void)
 
 void dev_nvstore_init(void)
 {
-    //bool found = false;
+    nvstore_block_header_t _hdr;
     nvstore_block_t _tmp_block;
-    uint8_t _calc_block_crc = 0;
+    uint8_t head = 0;
+    uint8_t block_nr;
+    uint8_t keys_left = NVSTORE_KEY_CNT;
+    uint32_t first_wr_cnt;
+    uint32_t prev_wr_cnt;
 #if (DEV_NVSTORE_DEBUG == 1)
     char buff[16];
 
-    //iprintln(trNVSTORE, "#Initialising (Version %d, Block Size %d bytes)", NVSTORE_DATA_VERSION, NVSTORE_BLOCK_SIZE);
+    //iprintln(trNVSTORE, "#Initialising (Block Size %d bytes, %d keys)", NVSTORE_BLOCK_SIZE, NVSTORE_KEY_CNT);
     sys_stopwatch_ms_start(&_nvstore.sw);
+    _nvstore.rd_cnt = 0;
 #endif /* DEV_NVSTORE_DEBUG */
 
-    _nvstore.current.last_rd = (uint8_t)-1;     /* Invalid block number */
     _nvstore.current.wr_cnt = 0;                /* Invalid write count */
     _nvstore.current.next_wr = 0;               /* Start writing at the beginning of the EEPROM */
-    _nvstore.new_data = false;
+    _nvstore.new_data = 0;
+    memset(_nvstore.index, NVSTORE_BLOCK_NONE, sizeof(_nvstore.index));
 
-    //Start at the beginning of the EEPROM
-    for (int block_nr = 0; block_nr < NVSTORE_BLOCK_CNT; block_nr++)
+    first_wr_cnt = _nvstore_block_wr_cnt(0);
+    if (first_wr_cnt != 0)
     {
-        //Read the block and calculate the crc while we are at it
-        _calc_block_crc = _nvstore_read_block((uint8_t *)&_tmp_block, block_nr);
-
-        //Make sure it is legit (Magic Number & the CRC must be correct)
-        if (_tmp_block.hdr.magic != NVSTORE_MAGIC)
-            break; //from for-loop - we have reached the end of the valid blocks
-
-        //Check if the data is valid (CRC is good)
-        if (0 != _calc_block_crc)
+        //Find the last block with a write count of (at least) that of block 0... that is the head
+        uint8_t hi = NVSTORE_BLOCK_CNT - 1;
+        while (head < hi)
         {
-            //iprintln(trNVSTORE, "#CRC mismatch in block %d - Calc: 0x%02X (Expected: 0x00)", block_nr, _tmp_block.crc);
-
-            //The data CRC is a invalid, but maybe we want to start writing at the next block (skipping this block for this round)
-            _nvstore.current.next_wr = (block_nr+1) % NVSTORE_BLOCK_CNT;
-
-            //Skip this block for all other purposes
-            continue;
+            block_nr = (head + hi + 1) / 2;
+            if (_nvstore_block_wr_cnt(block_nr) >= first_wr_cnt)
+                head = block_nr;
+            else
+                hi = block_nr - 1;
         }
 
-        //If we have found a valid block before, check which one is more current
-        if ((_nvstore.new_data) && (_tmp_block.hdr.wr_cnt < _nvstore.rd_block.hdr.wr_cnt))
+        //A write which was interrupted leaves a bad CRC at the head, in which case the block before it is the head
+        for (block_nr = 0; block_nr < NVSTORE_BLOCK_CNT; block_nr++)
         {
-            //Means the previous block was the most recent, so we can stop looking
-            break; //from for-loop
+            if ((_nvstore_read_block((uint8_t *)&_tmp_block, head) == 0) && (_tmp_block.hdr.magic == NVSTORE_MAGIC))
+            {
+                _nvstore.current.wr_cnt = _tmp_block.hdr.wr_cnt;
+                _nvstore.current.next_wr = (head + 1) % NVSTORE_BLOCK_CNT; //Might need the wrap around to block 0
+                break; //from for-loop
+            }
+            head = (head + NVSTORE_BLOCK_CNT - 1) % NVSTORE_BLOCK_CNT;
         }
+    }
 
-        //This block is good and "newer" than the previous one
-        memcpy(&_nvstore.rd_block, &_tmp_block, NVSTORE_BLOCK_SIZE);
-        _nvstore.current.wr_cnt = _tmp_block.hdr.wr_cnt;
-        _nvstore.current.last_rd = block_nr;
-        _nvstore.current.next_wr = (block_nr+1) % NVSTORE_BLOCK_CNT; //Might need the wrap around to block 0
-        _nvstore.new_data = true;
+    //Walk back from the head (headers only) until we have the latest record of each key, or we run out of blocks written
+    prev_wr_cnt = _nvstore.current.wr_cnt + 1;
+    for (block_nr = 0; (block_nr < NVSTORE_BLOCK_CNT) && (keys_left > 0) && (_nvstore.current.wr_cnt > 0); block_nr++)
+    {
+        _nvstore_read_hdr(&_hdr, head);
+        if ((_hdr.magic != NVSTORE_MAGIC) || (_hdr.wr_cnt >= prev_wr_cnt))
+            break; //from for-loop - we have reached the end of the valid blocks
+        prev_wr_cnt = _hdr.wr_cnt;
+
+        //Only the 1st (latest) record of a key counts, and only if its CRC is good (otherwise an older one will have to do)
+        if ((_hdr.key < NVSTORE_KEY_CNT) && (_nvstore.index[_hdr.key] == NVSTORE_BLOCK_NONE) && (_nvstore_read_block((uint8_t *)&_tmp_block, head) == 0))
+        {
+            _nvstore.index[_hdr.key] = head;
+            SET_BIT(_nvstore.new_data, _hdr.key);
+            keys_left--;
+        }
+        head = (head + NVSTORE_BLOCK_CNT - 1) % NVSTORE_BLOCK_CNT;
     }
 
 #if (DEV_NVSTORE_DEBUG == 1)
     unsigned long lap = sys_stopwatch_ms_stop(&_nvstore.sw);
-#endif /* DEV_NVSTORE_DEBUG */
 
     //Now, we need to understand if we have found a valid block or not
     if (_nvstore.new_data)
-    {
-#if (DEV_NVSTORE_DEBUG == 1)
-        iprintln(trNVSTORE, "#(%lu ms) Block: %d/%d (v%d), Wear: %s%%", lap, _nvstore.current.last_rd, NVSTORE_BLOCK_CNT, _nvstore.rd_block.hdr.version, float2str(buff, ((float)_nvstore.current.wr_cnt * 100.0f) / (float)NVSTORE_WR_CNT_MAX, 2, 16));
-#endif /* DEV_NVSTORE_DEBUG */
-    }
-#if (DEV_NVSTORE_DEBUG == 1)
+        iprintln(trNVSTORE, "#(%lu ms, %u rd) Next: %d/%d, Keys: %d/%d, Wear: %s%%", lap, _nvstore.rd_cnt, _nvstore.current.next_wr, NVSTORE_BLOCK_CNT, NVSTORE_KEY_CNT - keys_left, NVSTORE_KEY_CNT, float2str(buff, ((float)_nvstore.current.wr_cnt * 100.0f) / (float)NVSTORE_WR_CNT_MAX, 2, 16));
     else
-    {
-        iprintln(trNVSTORE, "#(%lu ms) No valid block", lap);
-    }
+        iprintln(trNVSTORE, "#(%lu ms, %u rd) No valid block", lap, _nvstore.rd_cnt);
 #endif /* DEV_NVSTORE_DEBUG */
 
 #ifdef CONSOLE_ENABLED
@@ -537,37 +641,40 @@ uint8_t dev_nvstore_data_size(void)
     return NVSTORE_BLOCK_DATA_SIZE;
 }
 
-bool dev_nvstore_read(uint8_t * data, uint8_t len)
+bool dev_nvstore_read(uint8_t key, uint8_t * data, uint8_t len)
 {
+    nvstore_block_t _tmp_block;
+
+    if (key >= NVSTORE_KEY_CNT)
+        return false;
+
     //Clear the "new data" flag
-    _nvstore.new_data = false;
+    CLEAR_BIT(_nvstore.new_data, key);
 
-    if (_nvstore.current.last_rd >= NVSTORE_BLOCK_CNT)
+    if ((_nvstore.index[key] == NVSTORE_BLOCK_NONE) || (_nvstore_read_block((uint8_t *)&_tmp_block, _nvstore.index[key]) != 0))
     {
 #if (DEV_NVSTORE_DEBUG == 1)
-        iprintln(trNVSTORE, "#No valid block");
+        iprintln(trNVSTORE, "#No valid record (key %d)", key);
 #endif /* DEV_NVSTORE_DEBUG */
         return false;
     }
 
-    memcpy(data, _nvstore.rd_block.data, min(NVSTORE_BLOCK_DATA_SIZE, len));
+    memcpy(data, _tmp_block.data, min((uint8_t)NVSTORE_BLOCK_DATA_SIZE, len));
 
     return true;
 }
 
-bool dev_nvstore_new_data_available(void)
+bool dev_nvstore_new_data_available(uint8_t key)
 {
-    return _nvstore.new_data;
+    return (key < NVSTORE_KEY_CNT) && (IS_BIT_SET(_nvstore.new_data, key));
 }
 
-bool dev_nvstore_write(uint8_t * data, uint8_t len)
+bool dev_nvstore_write(uint8_t key, uint8_t * data, uint8_t len)
 {
     nvstore_block_t _tmp_block;
-    uint8_t wr_block_nr = 0;
-    uint8_t calc_crc = 0;
-    //uint8_t _tmp_data[NVSTORE_BLOCK_DATA_SIZE];
+    uint8_t _key;
 
-    if (len == 0)
+    if ((len == 0) || (key >= NVSTORE_KEY_CNT))
     {
         // iprintln(trNVSTORE, "#Nothing to write (%d)", len);
         return false;
@@ -581,40 +688,25 @@ bool dev_nvstore_write(uint8_t * data, uint8_t len)
         return false;
     }
 
+    //The block after the one we are about to write is the oldest one left... if it is the latest record of another key, 
+    // that record is copied to the head first (the copy is written before the old one can be overwritten)
+    while ((_key = _nvstore_block_key((_nvstore.current.next_wr + 1) % NVSTORE_BLOCK_CNT)) != NVSTORE_KEY_NONE)
+    {
+        if (_key == key)
+            break; //We are replacing that one anyway
+        if (_nvstore_read_block((uint8_t *)&_tmp_block, _nvstore.index[_key]) != 0)
+            _nvstore.index[_key] = NVSTORE_BLOCK_NONE; //Gone bad since we found it, so there is nothing to keep
+        else if (!_nvstore_write_record(_key, _tmp_block.data))
+            return false;
+    }
+
     memcpy(_tmp_block.data, data, len);
     //Fill the remainder of the data buffer with 0xFF
     if (len < NVSTORE_BLOCK_DATA_SIZE)
         memset(&_tmp_block.data[len], 0xFF, NVSTORE_BLOCK_DATA_SIZE-len);
 
-    //Now write the EEPROM...
-    wr_block_nr = _nvstore_write_next_block_data(_tmp_block.data);
-
-    //...and then read it back to confirm it is correctly written.
-    calc_crc = _nvstore_read_block((uint8_t *)&_tmp_block, wr_block_nr);
-    if (calc_crc != 0)
-    {
-        iprintln(trNVSTORE, "#CRC ERR - block %d - 0x%02X (Exp: 0x00)", wr_block_nr, _tmp_block.crc);
-        return false;
-    }
-    if (_tmp_block.hdr.wr_cnt != (_nvstore.current.wr_cnt + 1))
-    {
-        iprintln(trNVSTORE, "#WR Cnt ERR - block %d - %06lu (Exp: %06lu)", wr_block_nr, _tmp_block.hdr.wr_cnt, _nvstore.current.wr_cnt + 1);
-        return false;
-    }
-    //Only check the length of data that was written
-    if (memcmp(data, &_tmp_block.data, len) != 0)
-    {
-        iprintln(trNVSTORE, "#Data mismatch - block %d", wr_block_nr);
-        console_print_ram(trNVSTORE, &data, 256 + wr_block_nr, len);
-        console_print_ram(trNVSTORE, &_tmp_block.data, wr_block_nr, NVSTORE_BLOCK_SIZE);
-        return false;
-    }
-    _nvstore.current.wr_cnt = _tmp_block.hdr.wr_cnt;
-    _nvstore.current.last_rd = wr_block_nr;
-    memcpy(&_nvstore.rd_block, &_tmp_block, NVSTORE_BLOCK_SIZE);
-
     // I guess if it fails we can do a couple of retries before we give up and return false
-    return true;
+    return _nvstore_write_record(key, _tmp_block.data);
 }
 
 #undef PRINTF_TAG
@@ -29,6 +29,9 @@ definitions
 /******************************************************************************
 Macros
 ******************************************************************************/
+#define NVSTORE_KEY_CNT         (3)     /* The number of record keys (0 to NVSTORE_KEY_CNT-1), each takes a byte of RAM for the index.
+                                           Keep it to the keys in use (nv_key_t in main.cpp): the walk at startup only stops
+                                           early once it has found a record of every key */
 
 /******************************************************************************
 Struct & Unions
@@ -42,17 +45,34 @@ Global (public) variables
 Global (public) function definitions
 ******************************************************************************/
 
-/*! \brief Initialise the non-volatile storage
+/*! \brief Initialise the non-volatile storage (finds the head of the log and the latest record of each key)
  */
 void dev_nvstore_init(void);
 
+/*! \brief The size of the data in a record
+ */
 uint8_t dev_nvstore_data_size(void);
 
-bool dev_nvstore_new_data_available(void);
+/*! \brief Is there a record for a key which has not been read yet (found at startup or written since)?
+ * \param key The key of the record
+ */
+bool dev_nvstore_new_data_available(uint8_t key);
 
-bool dev_nvstore_read(uint8_t * data, uint8_t len);
+/*! \brief Reads the latest record of a key
+ * \param key The key of the record
+ * \param data Where to put the data
+ * \param len The number of bytes to read (up to dev_nvstore_data_size())
+ * \return True if there is a valid record for the key
+ */
+bool dev_nvstore_read(uint8_t key, uint8_t * data, uint8_t len);
 
-bool dev_nvstore_write(uint8_t * data, uint8_t len);
+/*! \brief Writes a new record for a key (the rest of the record is filled with 0xFF)
+ * \param key The key of the record
+ * \param data The data to write
+ * \param len The number of bytes to write (up to dev_nvstore_data_size())
+ * \return True if the record was written (and read back) successfully
+ */
+bool dev_nvstore_write(uint8_t key, uint8_t * data, uint8_t len);
 
 #ifdef __cplusplus
 }
@@ -17,6 +17,11 @@ been tested yet. Probably won't work as expected.
 The switch ON time for each LED is staggered through the PWM cycle to prevent
 a spike in current draw when all LEDs are switched on at the same time.
 
+Every colour passes through the same pipeline before it reaches the PWM:
+    target -> white balance (per colour) -> CIE lightness LUT -> brightness limit
+The white balance and brightness limit come from the node's calibration (kept 
+in the NV store), so LEDs from different batches can be matched to each other.
+
  ******************************************************************************/
 
 #define __NOT_EXTERN__
@@ -78,6 +83,8 @@ typedef struct
 typedef struct
 {
     colour_pwm_type colour[rgbMAX];
+    uint8_t wb[rgbMAX] = {0xFF, 0xFF, 0xFF};    // White balance scale per colour (255 = 100%)
+    uint8_t max_lvl = 0xFF;                     // Brightness (current) limit on the PWM output (255 = no limit)
 	bool active = false;
 	uint16_t prescaler = 0;
 	uint8_t pin_cnt;			// Counter to keep track of the duty cycle
@@ -203,11 +210,15 @@ void _set_adjusted_duty_cycle(led_colour_type col)
 {
     if (col >= rgbMAX)
         return;
+
+    //White balance the (linear) target, correct it for perceived lightness and then limit the brightness
+    uint8_t lightness = colour_scale8(_rgb.colour[col].pwm.target, _rgb.wb[col]);
+    uint8_t duty_cycle = colour_scale8(pgm_read_byte(&CIE_LIGHTNESS_TO_PWM_LUT_256_IN_8BIT_OUT[lightness]), _rgb.max_lvl);
     
     //We should probably stop the interrupt from reading this value while we are changing it
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE) 
     {
-        _rgb.colour[col].pwm.adjust = pgm_read_byte(&CIE_LIGHTNESS_TO_PWM_LUT_256_IN_8BIT_OUT[_rgb.colour[col].pwm.target]);
+        _rgb.colour[col].pwm.adjust = duty_cycle;
         
         //The switch ON time for each LED has already been staggered through the PWM cycle. 
         //We just need to set the switch OFF time from there
@@ -455,6 +466,21 @@ void dev_rgb_set_colour(uint32_t rgb)
     }
 }
 
+void dev_rgb_set_calibration(const colour_cal_t * cal)
+{
+    if (cal == NULL)
+        return;
+
+    _rgb.wb[rgbRed] = cal->red;
+    _rgb.wb[rgbGreen] = cal->green;
+    _rgb.wb[rgbBlue] = cal->blue;
+    _rgb.max_lvl = cal->max_lvl;
+
+    //Re-apply the current colour through the calibrated pipeline
+    for (int i = 0; i < rgbMAX; i++)
+        _set_adjusted_duty_cycle((led_colour_type)i);
+}
+
 #if (DEV_RGB_DEBUG == 1)
 void dev_rgb_stop() {
 	TIMSK2 &= ~(1<<TOIE2);
@@ -13,6 +13,7 @@ Include file for dev_rgb.c
 includes
 ******************************************************************************/
 #include "Arduino.h"
+#include "../../../../common/common_colour.h"
 
 /******************************************************************************
 Macros
@@ -108,6 +109,11 @@ uint8_t dev_rgb_start(int pin_red, int pin_green, int pin_blue);
 
 void        dev_rgb_set_colour(uint32_t rgb);
 
+/*! \brief Sets the white balance and brightness limit applied to every colour
+ * \param cal The calibration (0xFF in every field is "no correction")
+ */
+void        dev_rgb_set_calibration(const colour_cal_t * cal);
+
 #if (DEV_RGB_DEBUG == 1)
 void        dev_rgb_stop();
 bool        dev_rgb_enabled();
@@ -52,6 +52,8 @@ This (slave) device  is responsible for:
 #endif
 #define PRINTF_TAG ("Main") /* This must be undefined at the end of the file*/
 
+#define NV_STATS_SAVE_MS (30000lu) /* How long after startup the boot count is saved (an EEPROM block write stalls the loop for ~55 ms) */
+
 /*******************************************************************************
  local defines
  *******************************************************************************/
@@ -67,6 +69,39 @@ typedef enum registration_state_e
 /*******************************************************************************
 Structures and unions
  *******************************************************************************/
+/* The keys of the records in the NV store (up to NVSTORE_KEY_CNT) */
+typedef enum
+{
+    nv_key_node     = 0,    // nv_data_t (the only record the fw before the keyed records had)
+    nv_key_clock    = 1,    // The clock correction factor from the last sync (float)
+    nv_key_stats    = 2,    // nv_stats_t
+}nv_key_t;
+
+/* The data we keep in the NV store. The calibration was added after the address, 
+ so it reads as erased (0xFF = no correction) from a block written by older fw */
+typedef struct
+{
+    uint8_t         addr;   // Our comms address
+    colour_cal_t    calib;  // The colour calibration of our RGB LED
+}nv_data_t;
+
+/* Our lifetime statistics in the NV store */
+typedef struct
+{
+    uint32_t        boots;  // The number of times we have started up
+}nv_stats_t;
+
+/* The sequence (cmd_set_sequence) we are playing back */
+typedef struct
+{
+    uint32_t        start_ms;   // When the 1st step starts
+    uint32_t        mine;       // A bit for each of our steps (bit 0 = the 1st step)
+    uint32_t        rgb;        // The colour we show in our steps
+    uint16_t        on_ms;      // The time a step is lit
+    uint16_t        period_ms;  // The time from one step to the next
+    uint8_t         steps;      // The number of steps (0 if we are not playing back)
+    bool            lit;        // Are we showing the step colour?
+}sequence_t;
 
 /*******************************************************************************
  Function prototypes
@@ -78,13 +113,22 @@ void blink_start(unsigned long _period_ms);
 void blink_stop(void);
 void blink_action(void);
 
+void sequence_start(cmd_sequence_t * seq_hdr, uint32_t mine);
+void sequence_stop(void);
+void sequence_service(void);
+
 void deactivate_button(uint8_t method);
 
 void address_update(void);
+bool nv_data_save(void);
+#if CLOCK_CORRECTION_ENABLED == 1
+void clock_factor_save(void);
+#endif /* CLOCK_CORRECTION_ENABLED */
 
 void msg_process(void);
 bool rollcall_msg_handler(master_command_t _cmd, uint8_t _src, uint8_t _dst);
 void send_roll_call_response(void);
+void send_poll_response(void);
 bool read_cmd_payload(master_command_t cmd, uint8_t * dst);
 uint8_t read_msg_data(uint8_t * dst, uint8_t len = 1);
 uint8_t _cmd_rx_payload_size(master_command_t cmd);
@@ -95,6 +139,7 @@ void state_machine_handler(void);
 void _rx_handler_state_un_reg(uint8_t _cmd);
 
 bool is_bcast_msg_for_me(uint32_t bit_mask);
+void colour_set(uint8_t index, uint32_t rgb);
 
 void button_long_press(void);
 void button_double_press(void);
@@ -184,6 +229,9 @@ int8_t my_mask_index = -1; //My address bit mask index, valid values 0 to 31
 stopwatch_ms_s roll_call_sw;
 stopwatch_ms_s sync_sw;
 uint32_t roll_call_time_ms = 0; //The time we have to wait for the roll-call to finish
+bool roll_check = false; //Are we answering a roll-call check (we stay registered while we do)?
+stopwatch_ms_s poll_sw; //Running while we wait for our slot to answer a reaction poll
+uint32_t poll_time_ms = 0; //The start of our slot for the reaction poll
 
 //bool response_msg_due = false;
 
@@ -194,7 +242,8 @@ uint32_t my_version = PROJECT_VERSION; //The version of this device
 typedef struct {
     uint8_t src;    // The source address of the message
     uint8_t dst;    // The destination address of the message
-    uint8_t data[RGB_BTN_MSG_MAX_LEN - sizeof(comms_msg_hdr_t) - sizeof(uint8_t)];
+    uint8_t id;     // The ID (sequence number) of the message
+    uint8_t data[RGB_BTN_MSG_MAX_DATA_LEN]; // The fragments are reassembled directly into this buffer
     uint8_t len;
     uint8_t rd_index;
 } rx_msg_t;
@@ -211,6 +260,12 @@ bool dbg_led_output; //The output state for the debug LED pin
 
 uint32_t time_ms_offset = 0lu; //The time offset for the system time (in ms)
 
+nv_data_t nv_data = {0, COLOUR_CAL_DEFAULT}; //Our copy of the data in the NV store
+nv_stats_t nv_stats = {0}; //Our lifetime statistics (this boot is counted, but only saved later)
+timer_ms_t nv_stats_tmr; //Running until the statistics are due to be saved
+
+sequence_t seq = {0}; //The sequence we are playing back (if any)
+
 /*******************************************************************************
  Functions
  *******************************************************************************/
@@ -229,12 +284,20 @@ void setup() {
     dev_nvstore_init();
 
     //If this is the first run of this firmware, we need to save the comms address
-    if (!dev_nvstore_new_data_available())
+    if (!dev_nvstore_new_data_available(nv_key_node))
     {
-        uint8_t current_addr = dev_comms_addr_get();
-        iprintln(trMAIN, "#1st run - address: 0x%02X", current_addr);
-        dev_nvstore_write(&current_addr, sizeof(uint8_t));                
+        nv_data.addr = dev_comms_addr_get();
+        iprintln(trMAIN, "#1st run - address: 0x%02X", nv_data.addr);
+        nv_data_save();
     }
+
+    //The boot count is a record of its own, so the address and calibration are not rewritten every time... it is 
+    // only written once we are registered and have been up for a while (see state_machine_handler()), so a boot does 
+    // not wait on the EEPROM, and a node which keeps resetting does not wear it out
+    dev_nvstore_read(nv_key_stats, (uint8_t *)&nv_stats, sizeof(nv_stats_t));
+    nv_stats.boots++;
+    sys_poll_tmr_start(&nv_stats_tmr, NV_STATS_SAVE_MS, false);
+    iprintln(trMAIN, "#Boot %lu", nv_stats.boots);
    
     dev_rgb_start(output_Led_Red, output_Led_Green, output_Led_Blue);
 
@@ -243,6 +306,13 @@ void setup() {
 
     dev_button_init(button_down, NULL /*button_release*/, button_press, button_long_press, button_double_press);
 
+#if CLOCK_CORRECTION_ENABLED == 1
+    //The correction from our last sync is a better start than none at all (the timers have been started by now)
+    float _factor;
+    if (dev_nvstore_read(nv_key_clock, (uint8_t *)&_factor, sizeof(float)))
+        sys_time_correction_factor_set(_factor);
+#endif /* CLOCK_CORRECTION_ENABLED */
+
     colour[0].rgb = (uint32_t)colYellow;
     colour[1].rgb = (uint32_t)colBlue;
     colour[2].rgb = (uint32_t)colTeal;
@@ -314,9 +384,15 @@ void loop() {
 
     dev_button_service(); //Check if the button has been pressed and handle it
 
+    //Carry on with any transmission waiting for the bus (or its echo)
+    dev_comms_service();
+
     //Check if our communication address has changed
     address_update();
 
+    //Light up (or not) for the next step of the sequence
+    sequence_service();
+
 	//Check for anything we want to send or may have received on the main comms channnel...
     msg_process(); //... process it
 
@@ -393,32 +469,98 @@ bool blink_colour_index = false;
 void blink_action(void)
 {
     blink_colour_index = !blink_colour_index; //Toggle the colour index
-    //Set the new colour
-    dev_rgb_set_colour(colour[blink_colour_index? 1 : 0].rgb);
+    //Set the new colour (unless a sequence is being played back)
+    if (seq.steps == 0)
+        dev_rgb_set_colour(colour[blink_colour_index? 1 : 0].rgb);
     //Restart the timer    
     if (blink_period_ms == 0)
         sys_cb_tmr_stop(blink_action); // will self-destruct after exiting this function
 }
 
+void sequence_start(cmd_sequence_t * seq_hdr, uint32_t mine)
+{
+    sequence_stop(); //A new sequence replaces the one playing back (if any)
+    if ((mine == 0) || (seq_hdr->on_ms == 0))
+        return; //Nothing for us to show (or just a stop)
+
+    seq.rgb = 0lu;
+    memcpy(&seq.rgb, seq_hdr->rgb, 3);
+    seq.mine = mine;
+    seq.on_ms = seq_hdr->on_ms;
+    seq.period_ms = seq_hdr->on_ms + seq_hdr->off_ms;
+    seq.lit = false;
+    //The steps are timed from now, on our (corrected) clock
+#if CLOCK_CORRECTION_ENABLED == 1
+    seq.start_ms = sys_millis() + seq_hdr->lead_ms;
+#else
+    seq.start_ms = millis() + seq_hdr->lead_ms;
+#endif /* CLOCK_CORRECTION_ENABLED */
+    seq.steps = min(seq_hdr->steps, (uint8_t)CMD_SEQ_STEPS_MAX);
+}
+
+void sequence_stop(void)
+{
+    if (seq.steps == 0)
+        return;
+    seq.steps = 0;
+    //Back to our own colour (when blinking, the next toggle takes care of it)
+    if (blink_period_ms == 0)
+        dev_rgb_set_colour(colour[0].rgb);
+}
+
+void sequence_service(void)
+{
+    if (seq.steps == 0)
+        return;
+
+#if CLOCK_CORRECTION_ENABLED == 1
+    uint32_t elapsed_ms = sys_millis() - seq.start_ms;
+#else
+    uint32_t elapsed_ms = millis() - seq.start_ms;
+#endif /* CLOCK_CORRECTION_ENABLED */
+    if ((int32_t)elapsed_ms < 0)
+        return; //Still in the lead-in
+
+    uint32_t step = elapsed_ms / seq.period_ms;
+    if (step >= seq.steps)
+    {
+        sequence_stop(); //All done
+        return;
+    }
+
+    bool lit = ((seq.mine & (1UL << step)) != 0) && ((elapsed_ms - (step * seq.period_ms)) < seq.on_ms);
+    if (lit == seq.lit)
+        return;
+    seq.lit = lit;
+    dev_rgb_set_colour(lit? seq.rgb : colour[0].rgb);
+}
+
 void address_update(void)
 {
     uint8_t stored_addr;
     uint8_t current_addr;
 
     //Check if our communication address has changed
-    if (!dev_nvstore_new_data_available())
+    if (!dev_nvstore_new_data_available(nv_key_node))
         return;
 
     current_addr = dev_comms_addr_get();
 
-    //Read the address from the NV store
-    dev_nvstore_read(&stored_addr, sizeof(uint8_t));
+    //Read the address (and the calibration) from the NV store
+    dev_nvstore_read(nv_key_node, (uint8_t *)&nv_data, sizeof(nv_data_t));
+    stored_addr = nv_data.addr;
+
+    //The calibration is simply applied, whether it changed or not
+    dev_rgb_set_calibration(&nv_data.calib);
+
+
     //We probably need to make sure that we are not reading an invalid address from the NV store
     if (dev_comms_verify_addr(stored_addr) == false)
     {
         iprintln(trCOMMS, "#Invalid address read: 0x%02X", stored_addr);
         //Write the current address back to the NV store and restart
-        dev_nvstore_write(&current_addr, sizeof(uint8_t)); 
+        nv_data.addr = current_addr;
+        nv_data_save();
         while (1)
         {    
             resetFunc();
@@ -435,6 +577,20 @@ void address_update(void)
     //Reset the comms address to that which we got from the NVstore
 }
 
+bool nv_data_save(void)
+{
+    //The whole block is always written, so that a new address does not wipe the calibration (and vice versa)
+    return dev_nvstore_write(nv_key_node, (uint8_t *)&nv_data, sizeof(nv_data_t));
+}
+
+#if CLOCK_CORRECTION_ENABLED == 1
+void clock_factor_save(void)
+{
+    float _factor = sys_time_correction_factor();
+    dev_nvstore_write(nv_key_clock, (uint8_t *)&_factor, sizeof(float));
+}
+#endif /* CLOCK_CORRECTION_ENABLED */
+
 void msg_process(void)
 {
     cmd_payload_u cmd_payload;
@@ -443,14 +599,22 @@ void msg_process(void)
     master_command_t _cmd;
     uint8_t _myAddr = dev_comms_addr_get();
     bool _can_respond = false; //We are not processing a broadcast message yet
+    bool _resend = false; //The master is resending its last msg to us
+    uint32_t _bcst_mask = 0; //The address mask of the broadcast msg being processed
    
     //If anything requires sending, now is the time to do it
-    if (reg_state == roll_call)
+    if ((reg_state == roll_call) || (roll_check))
         send_roll_call_response();
         //Fall through to ensure we read the other nodes' responses to populate our blacklist
+    if (poll_sw.running)
+        send_poll_response();
+
+    //Our previous response is still waiting for the bus... the next msg stays in the rx buffer until we can respond to it
+    if (dev_comms_tx_result() == tx_result_busy)
+        return;
 
     //Have we received anything?
-    rx_msg.len = dev_comms_rx_msg_available(&rx_msg.src, &rx_msg.dst, rx_msg.data);
+    rx_msg.len = dev_comms_rx_msg_available(&rx_msg.src, &rx_msg.dst, rx_msg.data, &rx_msg.id);
     if (rx_msg.len == 0)
         return; //Nothing to process
 
@@ -459,6 +623,10 @@ void msg_process(void)
     if (rx_msg.dst == _myAddr) 
         _can_respond = true; //We are accepting messages addressed to us
 
+    //If the master resends a msg we have already executed, we replay our responses instead (not all of the commands are idempotent)
+    if ((rx_msg.src == ADDR_MASTER) && (_can_respond) && (reg_state >= waiting))
+        _resend = dev_comms_response_cache_start(rx_msg.id);
+
     //Have we received anything?
     while (read_msg_data((uint8_t *)&_cmd) > 0)
     {
@@ -477,7 +645,7 @@ void msg_process(void)
         if (rx_msg.dst == ADDR_BROADCAST)
         {
             //Even for broadcast msgs there are limits... e.g. no information can be "READ", and no console commands can be executed
-            if (_cmd >= cmd_set_bitmask_index)
+            if (!cmd_is_bcst(_cmd))
             {
                 iprintln(trALWAYS, "!Invalid bcst (0x%02X)", _cmd);
                 return; //We cannot process this message... and since it is a broadcast, we don't want to respond
@@ -497,6 +665,14 @@ void msg_process(void)
         
         //iprintln(trALWAYS, "#Parsing: 0x%02X for 0x%02X", _cmd, rx_msg.dst);
 
+        if ((_resend) && (dev_comms_response_replay(_cmd)))
+        {
+            //Already done, so we just skip over the payload
+            read_msg_data(NULL, _cmd_rx_payload_size(_cmd));
+            _cnt++;
+            continue;
+        }
+
         switch (_cmd)
         {
             case cmd_bcast_address_mask:
@@ -506,6 +682,7 @@ void msg_process(void)
                     //iprint(trALWAYS, "#BCST 0x%08X & 0x%08X : ", BIT_POS(my_mask_index), _u32_val);
                     //We need to check if the broadcast message applies to us or not
                     accept_msg = is_bcast_msg_for_me(cmd_payload.u32_val)? true : false;
+                    _bcst_mask = cmd_payload.u32_val;
                     //iprintln(trALWAYS, "%s", accept_msg? "YES" : "NO");
                 }
                 //else //read failure already handled in read_cmd_payload()
@@ -518,17 +695,66 @@ void msg_process(void)
             {
                 if (read_cmd_payload(_cmd, (uint8_t *)&cmd_payload))
                 {
-                    //Do not change the blinking status, but we should really change the colour atomically
-                    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) 
+                    colour_set(_cmd - cmd_set_rgb_0, cmd_payload.u32_val);
+                    _response_ok_append(_cmd);
+                }
+                //else //read failure already handled in read_cmd_payload()
+                break;
+            }
+
+            case cmd_set_rgb_scatter:
+            {
+                if (rx_msg.dst != ADDR_BROADCAST)
+                {
+                    //Without an address mask we cannot find our colour (and it should be the last cmd anyway)
+                    dev_comms_response_append(_cmd, resp_err_reject_cmd);
+                    read_msg_data(NULL, rx_msg.len - rx_msg.rd_index);
+                    break;
+                }
+                if (read_cmd_payload(_cmd, (uint8_t *)&cmd_payload))
+                {
+                    //{colour index, RGB for each slot in the address mask (lowest first)}
+                    uint8_t _index = cmd_payload.u8_val;
+                    uint8_t _before = 0;
+                    uint8_t _after = 0;
+                    for (int8_t i = 0; i < 32; i++)
                     {
-                        colour[_cmd - cmd_set_rgb_0].rgb = cmd_payload.u32_val;
+                        if ((_bcst_mask & (1UL << i)) == 0)
+                            continue;
+                        if (i < my_mask_index)
+                            _before++;
+                        else if (i > my_mask_index)
+                            _after++;
                     }
-                    //If we are not blinking and we are changing the primary colour, we need to set it now
-                    if ((blink_period_ms == 0) && (_cmd == cmd_set_rgb_0))
-                        dev_rgb_set_colour(colour[0].rgb);
-                    //else, the blinking *should* take care of the colour change
+                    read_msg_data(NULL, 3*_before);
+                    cmd_payload.u32_val = 0;
+                    if ((read_msg_data((uint8_t *)&cmd_payload, 3) == 3) && (_index < 3))
+                        colour_set(_index, cmd_payload.u32_val);
+                    read_msg_data(NULL, 3*_after);
+                }
+                //else //read failure already handled in read_cmd_payload()
+                break;
+            }
 
-                    _response_ok_append(_cmd);
+            case cmd_set_sequence:
+            {
+                cmd_sequence_t _seq_hdr;
+                if (rx_msg.dst != ADDR_BROADCAST)
+                {
+                    //Only the nodes in the address mask hear it (and it should be the last cmd anyway)
+                    dev_comms_response_append(_cmd, resp_err_reject_cmd);
+                    read_msg_data(NULL, rx_msg.len - rx_msg.rd_index);
+                    break;
+                }
+                if (read_cmd_payload(_cmd, (uint8_t *)&_seq_hdr))
+                {
+                    //{cmd_sequence_t, the slot of each step}... we only keep the steps which are ours
+                    uint32_t _mine = 0lu;
+                    uint8_t _slot;
+                    for (uint8_t i = 0; (i < _seq_hdr.steps) && (read_msg_data(&_slot) == 1); i++)
+                        if ((_slot == my_mask_index) && (i < CMD_SEQ_STEPS_MAX))
+                            _mine |= (1UL << i);
+                    sequence_start(&_seq_hdr, _mine);
                 }
                 //else //read failure already handled in read_cmd_payload()
                 break;
@@ -562,6 +788,7 @@ void msg_process(void)
                     }
                     else if (cmd_payload.u8_val == CMD_SW_PAYLOAD_ACTIVATE)
                     {
+                        sequence_stop(); //The sequence has to be done by the time we wait for a press
                         system_flags |= flag_activated;
                         reaction_time_ms = 0lu;
                         sys_stopwatch_ms_start(&reaction_time_sw);
@@ -612,6 +839,7 @@ void msg_process(void)
                     {
                         //This forces a reset of the correction value
                         sys_time_correction_factor_reset(); //Set the time correction factor
+                        clock_factor_save(); //Otherwise the old one is back after a reset
                         iprintln(trALWAYS, "#Correction Factor reset");
                     }
                     else if (cmd_payload.u32_val == 0)
@@ -639,6 +867,7 @@ void msg_process(void)
                         //This is now the end of the sync process.... the value is the time in milliseconds measured by the master
                         _fl_val = (float)cmd_payload.u32_val / (float)my_elapsed_time_ms; //Calculate the time correction factor
                         sys_time_correction_factor_set(_fl_val); //Set the time correction factor
+                        clock_factor_save(); //Keep it for the next time we start up
                         iprintln(trALWAYS, "#Time correction factor: %s", float2str(buff, (float)_fl_val, 8, 16));
                     }
                     _response_ok_append(_cmd);
@@ -684,7 +913,8 @@ void msg_process(void)
                         //Start by resetting the blacklist of addresses
                         dev_comms_blacklist_clear();
                         _u8_val = dev_comms_addr_new();
-                        dev_nvstore_write(&cmd_payload.u8_val, sizeof(uint8_t)); //Save the new address to the NV store
+                        nv_data.addr = cmd_payload.u8_val;
+                        nv_data_save(); //Save the new address to the NV store
                         //Reset right now
                         iprintln(trALWAYS, "#Resetting device (new address: 0x%02X)", cmd_payload.u8_val);
                         console_flush(); //Flush the console output before resetting
@@ -699,7 +929,8 @@ void msg_process(void)
                         dev_comms_response_append(_cmd, resp_err_range, (uint8_t *)&cmd_payload.u16_val, sizeof(uint16_t));
                         break;
                     }
-                    dev_nvstore_write(&cmd_payload.u8_val, sizeof(uint8_t)); //Save the new address to the NV store
+                    nv_data.addr = cmd_payload.u8_val;
+                    nv_data_save(); //Save the new address to the NV store
                     _response_ok_append(_cmd);
                     //This response will still be sent using the old address... it will be updated in the next loop iteration
                     iprintln(trALWAYS, "#New Address set from Master: 0x%02X", cmd_payload.u8_val);
@@ -708,6 +939,21 @@ void msg_process(void)
                 break;
             }
             
+            case cmd_set_calib:
+            {
+                if (read_cmd_payload(_cmd, (uint8_t *)&cmd_payload))
+                {
+                    memcpy(&nv_data.calib, cmd_payload.data, sizeof(colour_cal_t));
+                    //Once saved, address_update() reads it back from the NV store and applies it to the LED
+                    if (nv_data_save())
+                        _response_ok_append(_cmd);
+                    else
+                        dev_comms_response_append(_cmd, resp_err_reject_cmd);
+                }
+                //else //read failure already handled in read_cmd_payload()
+                break;
+            }
+
             case cmd_get_rgb_0:
             case cmd_get_rgb_1:
             case cmd_get_rgb_2:
@@ -728,6 +974,24 @@ void msg_process(void)
                 _response_ok_append(_cmd, (uint8_t*)&reaction_time_ms);
                 break;
             }
+
+            case cmd_poll_reaction:
+            {
+                if (rx_msg.dst != ADDR_BROADCAST)
+                {
+                    //Without an address mask we cannot find our slot (and it should be the last cmd anyway)
+                    dev_comms_response_append(_cmd, resp_err_reject_cmd);
+                    break;
+                }
+                //We answer in our own slot, our rank in the address mask (like a roll-call check), and not as part of this msg
+                uint8_t _rank = 0;
+                for (int8_t i = 0; i < my_mask_index; i++)
+                    if (_bcst_mask & (1UL << i))
+                        _rank++;
+                poll_time_ms = ROLL_CHECK_TIMOUT_MS(_rank);
+                sys_stopwatch_ms_start(&poll_sw, 0);
+                break;
+            }
             
             case cmd_get_flags:
             {
@@ -775,11 +1039,26 @@ void msg_process(void)
                 break;
             }
 
+            case cmd_get_link:
+            {
+                link_stats_t _link;
+                //The counters are cleared once read, so the master only ever gets the delta
+                dev_comms_link_stats(&_link, true);
+                _response_ok_append(_cmd, (uint8_t*)&_link);
+                break;
+            }
+
+            case cmd_get_calib:
+            {
+                _response_ok_append(_cmd, (uint8_t*)&nv_data.calib);
+                break;
+            }
+
 #if REMOTE_CONSOLE_SUPPORTED == 1    
             case cmd_wr_console_cont:
             case cmd_wr_console_done:
             {
-                uint8_t _data[RGB_BTN_MSG_MAX_LEN - sizeof(comms_msg_hdr_t) - sizeof(uint8_t)];
+                uint8_t _data[RGB_BTN_MSG_MAX_DATA_LEN];
                 memset(_data, 0, sizeof(_data));
                 if (read_cmd_payload(_cmd, _data, (rx_msg.len - rx_msg.rd_index)))
                 {
@@ -793,9 +1072,7 @@ void msg_process(void)
                         _response_ok_append(cmd_wr_console_cont);
                         console_read_byte('\n');
                         console_service(); //This *should* pipe the output to the alternate stream and reset it back to stdout once it is done
-                        if (!dev_comms_transmit_now()) //Send the response message now
-                            iprintln(trALWAYS, "!Sending console response rx_msg");
-                        _response_ok_append(cmd_wr_console_done);
+                        _response_ok_append(cmd_wr_console_done); //In the same msg (the console output leaves room for it)
                     }
                 }
                 //else //read failure already handled in read_cmd_payload()
@@ -817,10 +1094,11 @@ void msg_process(void)
 
     }
 
+    dev_comms_response_cache_stop();
+
     //If we have a response ready for a direct message, we need to send it immediately, (without waiting for bus silence)
     if ((rx_msg.src == ADDR_MASTER) && (_can_respond) && (reg_state >= waiting))
-        if (!dev_comms_transmit_now()) //Send the response message now
-            iprintln(trALWAYS, "!Tx response");
+        dev_comms_transmit_now(); //Queue the response message now (a failure is traced in dev_comms)
 }
 
 uint8_t read_msg_data(uint8_t * dst, uint8_t len)
@@ -851,29 +1129,21 @@ uint8_t read_msg_data(uint8_t * dst, uint8_t len)
 
 uint8_t _cmd_rx_payload_size(master_command_t cmd)
 {
-    for (uint8_t i = 0; i < ARRAY_SIZE(cmd_table); i++)
-        if (cmd_table[i].cmd == cmd)
-            return cmd_table[i].mosi_sz;
-
-    return 0; //Command not found, so no payload size
+    return cmd_mosi_sz(cmd); //0 if the command is not known
 }
 
 uint8_t _cmd_ok_tx_payload_size(master_command_t cmd)
 {
-    //We only respond on direct messages OR roll-call messages
-    if ((rx_msg.dst != dev_comms_addr_get()) && (cmd != cmd_roll_call))
-        return 0xff; //Only provide a valid payload for OK response to a direct message (or Rollcalls)
-
-    for (uint8_t i = 0; i < ARRAY_SIZE(cmd_table); i++)
-        if (cmd_table[i].cmd == cmd)
-            return cmd_table[i].miso_sz;
+    //We only respond on direct messages OR roll-call messages (and reaction polls, in our own slot)
+    if ((rx_msg.dst != dev_comms_addr_get()) && (cmd != cmd_roll_call) && (cmd != cmd_poll_reaction))
+        return 0xff; //Only provide a valid payload for OK response to a direct message (or Rollcalls and polls)
 
-    return 0; //Command not found, so no payload size
+    return cmd_miso_sz(cmd); //0 if the command is not known
 }
 
 void _response_ok_append(master_command_t cmd, uint8_t * data)
 {
-    dev_comms_response_append(cmd, resp_ok, data, _cmd_ok_tx_payload_size(cmd), (cmd_roll_call == cmd)? true : false); 
+    dev_comms_response_append(cmd, resp_ok, data, _cmd_ok_tx_payload_size(cmd), ((cmd_roll_call == cmd) || (cmd_poll_reaction == cmd))? true : false); 
 }
 
 bool read_cmd_payload(master_command_t cmd, uint8_t * dst)
@@ -891,44 +1161,80 @@ bool read_cmd_payload(master_command_t cmd, uint8_t * dst)
 
 void send_roll_call_response(void)
 {
-    //function is only called in roll_call state, so this is not neeeded
+    //function is only called in roll_call state (or for a check), so this is not neeeded
     // if (reg_state != roll_call)
     //     return; //We are not in the roll-call state, so we don't need to send a response
+    uint8_t _slot = (roll_check)? (uint8_t)my_mask_index : CMD_RC_SLOT_NONE;
 
-    if (sys_stopwatch_ms_lap(&roll_call_sw) < roll_call_time_ms)// && (roll_call_sw.running == true))
-        return; //Not yet, so wait a bit longer
+    if (roll_call_sw.running)
+    {
+        if (sys_stopwatch_ms_lap(&roll_call_sw) < roll_call_time_ms)
+            return; //Not yet, so wait a bit longer
 
-    sys_stopwatch_ms_stop(&roll_call_sw); //Stop the stopwatch for the roll-call response
+        sys_stopwatch_ms_stop(&roll_call_sw); //Stop the stopwatch for the roll-call response
 
-    //We wait until we are fairly certain that the bus is ready before we send our rollcall response
-    // if (tx_bus_state == 0) //busy
-    //     return;
-    //We are going to try and send the response NOW!
-    if(!dev_comms_tx_ready()) //Start the response message
-    {
-        //Could NOT send it now.... errors/bus is busy... we'll try again in a bit (between 2 and 50 ms)
-        roll_call_time_ms = sys_random(BUS_SILENCE_MIN_MS, BUS_SILENCE_MIN_MS*10);
-        //RVN - TODO - This is a bit of a thumbsuck time period.... maybe come back to this later?
-        sys_stopwatch_ms_start(&roll_call_sw, 0); //Restart the stopwatch for the rollcall response
-        iprintln(trALWAYS, "#RC - wait more (%u ms)", (uint8_t)roll_call_time_ms);
-        return;
+        //We wait until we are fairly certain that the bus is ready before we send our rollcall response
+        // if (tx_bus_state == 0) //busy
+        //     return;
+        //We are going to try and send the response NOW!
+        if(!dev_comms_tx_ready()) //Start the response message
+        {
+            //Could NOT send it now.... errors/bus is busy... we'll try again in a bit (between 2 and 50 ms)
+            roll_call_time_ms = sys_random(BUS_SILENCE_MIN_MS, BUS_SILENCE_MIN_MS*10);
+            //RVN - TODO - This is a bit of a thumbsuck time period.... maybe come back to this later?
+            sys_stopwatch_ms_start(&roll_call_sw, 0); //Restart the stopwatch for the rollcall response
+            iprintln(trALWAYS, "#RC - wait more (%u ms)", (uint8_t)roll_call_time_ms);
+            return;
+        }
+
+        _response_ok_append(cmd_roll_call, &_slot);
+        dev_comms_transmit_now(); //Queue the response message now, we check how it went on the next passes
     }
 
-    _response_ok_append(cmd_roll_call);
-    
-    if (dev_comms_transmit_now()) //Send the response message now
+    switch (dev_comms_tx_result())
     {
-        //Now we wait for the master to register us
-        reg_state = waiting; //We are now in the "waiting for registration" state
-        iprintln(trALWAYS, "#State: WAIT");
-        dbg_led(dbg_led_blink); //Start blinking the debug LED at 200ms intervals
+        case tx_result_busy:
+            return; //Still contending for the bus
+
+        case tx_result_ok:
+            if (roll_check)
+            {
+                roll_check = false; //The master knows we are still here (and where), nothing else changes
+                break;
+            }
+            //Now we wait for the master to register us
+            reg_state = waiting; //We are now in the "waiting for registration" state
+            iprintln(trALWAYS, "#State: WAIT");
+            dbg_led(dbg_led_blink); //Start blinking the debug LED at 200ms intervals
+            break;
+
+        default:
+            iprintln(trALWAYS, "!Tx RC");
+            //The master will not know us after a failed check either... so we rather answer the roll-call that follows it
+            roll_check = false;
+            my_mask_index = -1;
+            reg_state = un_reg; //RVN - TODO - we need to go back to the state we were in before the roll-call started (no necessarily un_reg)
+            dbg_led(dbg_led_blink_slow); //Start blinking the debug LED at 500ms intervals
+            break;
     }
-    else
+}
+
+void send_poll_response(void)
+{
+    if (sys_stopwatch_ms_lap(&poll_sw) < poll_time_ms)
+        return; //Not our slot yet
+
+    sys_stopwatch_ms_stop(&poll_sw);
+
+    //Our slot is short, so there is no waiting for the bus... the master reads us directly if we miss it
+    if (!dev_comms_tx_ready())
     {
-        iprintln(trALWAYS, "!Tx RC");
-        reg_state = un_reg; //RVN - TODO - we need to go back to the state we were in before the roll-call started (no necessarily un_reg)
-        dbg_led(dbg_led_blink_slow); //Start blinking the debug LED at 500ms intervals
+        iprintln(trALWAYS, "#Poll slot missed");
+        return;
     }
+
+    _response_ok_append(cmd_poll_reaction, (uint8_t*)&reaction_time_ms);
+    dev_comms_transmit_now(); //The master does not resend a poll, so there is nothing to check on afterwards
 }
 
 void state_machine_handler(void)
@@ -948,6 +1254,13 @@ void state_machine_handler(void)
 
         case idle:
             system_flags &= ~flag_unreg;
+            //Save the boot count, but not while the button is in play or we are busy on the bus
+            if ((sys_poll_tmr_enabled(&nv_stats_tmr)) && (sys_poll_tmr_expired(&nv_stats_tmr)) && 
+                (!reaction_time_sw.running) && (dev_comms_tx_result() != tx_result_busy))
+            {
+                sys_poll_tmr_stop(&nv_stats_tmr);
+                dev_nvstore_write(nv_key_stats, (uint8_t *)&nv_stats, sizeof(nv_stats_t));
+            }
             break;
     
         default:
@@ -973,7 +1286,20 @@ bool rollcall_msg_handler(master_command_t _cmd, uint8_t _src, uint8_t _dst)
             //The payload of the roll-call message is a single byte, which can be:
             // 0 - Roll call for ALL devices on the bus
             // 1 - Roll call for UNREGISTERED devices only
-            if (_u8_val != 0)   // Roll call for unregistered devices only
+            // 2 - Check of the REGISTERED devices (e.g. the master restarted and wants to know if we are still in our slot)
+            if (_u8_val == CMD_RC_PAYLOAD_CHECK)
+            {
+                //Only registered nodes answer, each in its own slot, so there are no collisions to avoid
+                if (reg_state == idle)
+                {
+                    roll_call_time_ms = ROLL_CHECK_TIMOUT_MS(my_mask_index);
+                    iprintln(trALWAYS, "#RC - Check in %lu ms", roll_call_time_ms);
+                    sys_stopwatch_ms_start(&roll_call_sw, 0);
+                    roll_check = true;
+                }
+                return true; //Handled the roll-call message already (the unregistered nodes ignore it)
+            }
+            else if (_u8_val != CMD_RC_PAYLOAD_ALL)   // Roll call for unregistered devices only
             {
                 // If we are registered and this was meant for unregistered devices, we do NOT respond
                 if (reg_state == idle)
@@ -1072,6 +1398,7 @@ bool rollcall_msg_handler(master_command_t _cmd, uint8_t _src, uint8_t _dst)
 
         iprintln(trALWAYS, "#RC - Answer in %lu ms", roll_call_time_ms);
         sys_stopwatch_ms_start(&roll_call_sw, 0); //Start the stopwatch for the roll-call response
+        roll_check = false; //A roll-call overrides a pending check
         reg_state = roll_call; //We are in the process of responding to a roll-call
         dbg_led(dbg_led_blink_fast); //Start blinking the debug LED at 50ms intervals
         //We should also stop any blinking that was happening before
@@ -1092,7 +1419,8 @@ bool rollcall_msg_handler(master_command_t _cmd, uint8_t _src, uint8_t _dst)
         {
             uint8_t new_addr = dev_comms_addr_new();
             iprintln(trALWAYS, "#Address conflict 0x%02X -> 0x%02X", _src, new_addr);
-            dev_nvstore_write(&new_addr, sizeof(uint8_t)); //Save the new address to the NV store
+            nv_data.addr = new_addr;
+            nv_data_save(); //Save the new address to the NV store
         }
     }
     return true; //Handled the roll-call message already 
@@ -1103,7 +1431,20 @@ bool is_bcast_msg_for_me(uint32_t bit_mask)
     if ((my_mask_index < 0) || (my_mask_index > 31))
         return false; //Not registered yet or.... either way, this is not a valid address
 
-    return ((bit_mask & (1 << my_mask_index)) == 0)? false : true;
+    return ((bit_mask & (1UL << my_mask_index)) == 0)? false : true; //An int is only 16 bits on the AVR
+}
+
+void colour_set(uint8_t index, uint32_t rgb)
+{
+    //Do not change the blinking status, but we should really change the colour atomically
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) 
+    {
+        colour[index].rgb = rgb;
+    }
+    //If we are not blinking (or playing back a sequence) and we are changing the primary colour, we need to set it now
+    if ((blink_period_ms == 0) && (seq.steps == 0) && (index == 0))
+        dev_rgb_set_colour(colour[0].rgb);
+    //else, the blinking *should* take care of the colour change
 }
 
 #ifdef MAIN_DEBUG
@@ -0,0 +1,391 @@
+/*******************************************************************************
+
+Module:     comms_test.cpp
+Purpose:    This file contains the host test for the reassembly of the master's msgs
+Author:     Rudolph van Niekerk
+
+Splits msgs into frames the way the master does (task_comms.c), and plays the
+frames (as they are, or reordered, changed or dropped) into the RX IRQ
+callback of the comms (_rx_irq_callback()), reading them back with
+dev_comms_rx_msg_available() after every frame, as the main loop does. Checks:
+  - Msgs from a single frame up to RGB_BTN_MSG_MAX_DATA_LEN come out as they
+    went in, with every byte value (incl. STX, DLE and ETX) in the data, and
+    with a last fragment of only 1 byte. Broadcasts too.
+  - Fragments out of order, a fragment lost, a fragment with a bad CRC (the
+    CRC is checked per frame, there is no CRC over the reassembled msg), and a
+    fragment with the src or the id of another msg in the middle of a msg: the
+    msg is dropped and the next one gets through.
+  - The fragments of a msg for another node in between those of ours: ours is
+    still reassembled (theirs is not, and does not touch our buffer).
+  - A new msg (fragment 0) in the middle of another: the first is dropped.
+  - A msg longer than RGB_BTN_MSG_MAX_DATA_LEN (more fragments than fit) is
+    dropped, without writing past the end of the caller's buffer.
+
+The comms are included (not linked), so that the test can get to the RX IRQ
+callback. The Arduino core is stood in for by tools/nvstore_test/stub, and the
+serial port, the timers and the console by sim_serial.cpp.
+
+Build (from rgb_btn/, with any host C++ compiler):
+    g++ -O2 -DCLOCK_CORRECTION_ENABLED=1 -o comms_test \
+        -I tools/nvstore_test/stub -I src \
+        tools/comms_test/comms_test.cpp tools/comms_test/sim_serial.cpp
+
+Use:
+    ./comms_test [-v]
+    -v prints the trace of the comms. The exit code is the number of failed
+    checks (0 if all passed).
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "dev_comms.cpp"
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#ifdef PRINTF_TAG
+#undef PRINTF_TAG
+#endif
+#define PRINTF_TAG ("Test") /* This must be undefined at the end of the file*/
+
+#define TEST_FRAMES_MAX     (8)
+#define TEST_NODE_ADDR      (0x42)
+#define TEST_OTHER_ADDR     (0x43)
+#define TEST_GUARD          (0x5A)  /* Fills the bytes after the caller's buffer, which must not be touched */
+
+/*******************************************************************************
+Local structure
+ *******************************************************************************/
+typedef struct
+{
+    uint8_t data[RGB_BTN_FRAME_MAX_LEN];
+    uint8_t len;
+} _test_frame_t;
+
+typedef struct
+{
+    _test_frame_t frame[TEST_FRAMES_MAX];
+    uint8_t cnt;
+} _test_frames_t;
+
+typedef struct
+{
+    uint8_t data[RGB_BTN_MSG_MAX_DATA_LEN];
+    uint8_t guard[16];
+} _test_buff_t;
+
+/*******************************************************************************
+Global (public) variables
+ *******************************************************************************/
+extern bool sim_console_verbose;
+
+/*******************************************************************************
+Local function prototypes
+ *******************************************************************************/
+
+/*! \brief Splits a msg into frames, as the master does (_tx_now() in task_comms.c)
+ * \param frames The frames of the msg (unescaped, without the STX and ETX)
+ * \param dst The node (or ADDR_BROADCAST)
+ * \param id The id of the msg
+ * \param len The number of data bytes (the data is _test_data() from the id)
+ */
+void _test_split(_test_frames_t * frames, uint8_t dst, uint8_t id, uint8_t len);
+
+/*! \brief Fills a msg's data from its id (every value from 0x00 to 0xFF turns up in a long enough msg)
+ */
+void _test_data(uint8_t * data, uint8_t id, uint8_t len);
+
+/*! \brief Recalculates the CRC of a frame after the test changed its header
+ */
+void _test_frame_crc(_test_frame_t * frame);
+
+/*! \brief Plays a frame into the RX IRQ callback (escaped, between STX and ETX), and reads it as the main loop does
+ * \return The value of dev_comms_rx_msg_available(): the msg length once reassembled, 0 if not (yet), < 0 for an error
+ */
+int8_t _test_rx(const _test_frame_t * frame, _test_buff_t * buff);
+
+/*! \brief Plays the frames of a msg into the comms and checks that it comes out as it was sent
+ * \return true if it does
+ */
+bool _test_rx_ok(const _test_frames_t * frames, uint8_t id, uint8_t len);
+
+/*! \brief Reports the outcome of a check
+ */
+void _test_check(bool ok, const char * name, const char * fmt, ...);
+
+/*******************************************************************************
+Local variables
+ *******************************************************************************/
+static int _test_fails = 0;
+static uint8_t _test_src = 0;   /* As given by dev_comms_rx_msg_available() for the last msg */
+static uint8_t _test_dst = 0;
+static uint8_t _test_id = 0;
+
+/*******************************************************************************
+Local (private) Functions
+ *******************************************************************************/
+void _test_split(_test_frames_t * frames, uint8_t dst, uint8_t id, uint8_t len)
+{
+    uint8_t _data[RGB_BTN_MSG_MAX_DATA_LEN];
+    uint8_t _offset = 0;
+
+    _test_data(_data, id, len);
+    frames->cnt = 0;
+    do
+    {
+        _test_frame_t * _frame = &frames->frame[frames->cnt];
+        comms_msg_hdr_t * _hdr = (comms_msg_hdr_t *)_frame->data;
+        uint8_t _len = min((uint8_t)(len - _offset), (uint8_t)RGB_BTN_FRAME_MAX_DATA_LEN);
+
+        _hdr->version = RGB_BTN_MSG_VERSION;
+        _hdr->id = id;
+        _hdr->src = ADDR_MASTER;
+        _hdr->dst = dst;
+        _hdr->frag = frames->cnt | (((_offset + _len) < len)? COMMS_FRAG_MORE : 0);
+        _hdr->len = _len;
+        memcpy(&_frame->data[sizeof(comms_msg_hdr_t)], &_data[_offset], _len);
+        _frame->len = sizeof(comms_msg_hdr_t) + _len + sizeof(uint8_t);
+        _test_frame_crc(_frame);
+
+        _offset += _len;
+        frames->cnt++;
+    }while (_offset < len);
+}
+
+void _test_data(uint8_t * data, uint8_t id, uint8_t len)
+{
+    for (uint8_t i = 0; i < len; i++)
+        data[i] = (uint8_t)((i * 37) + id);
+}
+
+void _test_frame_crc(_test_frame_t * frame)
+{
+    frame->data[frame->len - 1] = crc8_n(0, frame->data, frame->len - 1);
+}
+
+int8_t _test_rx(const _test_frame_t * frame, _test_buff_t * buff)
+{
+    _rx_irq_callback(STX);
+    for (uint8_t i = 0; i < frame->len; i++)
+    {
+        uint8_t _d = frame->data[i];
+        if ((_d == STX) || (_d == DLE) || (_d == ETX))
+        {
+            _rx_irq_callback(DLE);
+            _d ^= DLE;
+        }
+        _rx_irq_callback(_d);
+    }
+    _rx_irq_callback(ETX);
+
+    return dev_comms_rx_msg_available(&_test_src, &_test_dst, buff->data, &_test_id);
+}
+
+bool _test_rx_ok(const _test_frames_t * frames, uint8_t id, uint8_t len)
+{
+    _test_buff_t _buff;
+    uint8_t _data[RGB_BTN_MSG_MAX_DATA_LEN];
+    int8_t _len = 0;
+
+    memset(&_buff, TEST_GUARD, sizeof(_buff));
+    _test_src = _test_dst = _test_id = 0xEE;
+    for (uint8_t f = 0; f < frames->cnt; f++)
+    {
+        //Only the last fragment completes the msg
+        if ((_len = _test_rx(&frames->frame[f], &_buff)) != 0)
+            break;
+    }
+    _test_data(_data, id, len);
+    return ((_len == (int8_t)len) && (memcmp(_buff.data, _data, len) == 0) &&
+            (_test_src == ADDR_MASTER) && ((_test_dst == TEST_NODE_ADDR) || (_test_dst == ADDR_BROADCAST)) && (_test_id == id));
+}
+
+void _test_check(bool ok, const char * name, const char * fmt, ...)
+{
+    va_list args;
+
+    if (!ok)
+        _test_fails++;
+    printf("%s  %-12s ", ok? "pass" : "FAIL", name);
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+    printf("\n");
+}
+
+static void _test_in_order(void)
+{
+    static const uint8_t _lens[] = {2, RGB_BTN_FRAME_MAX_DATA_LEN, RGB_BTN_FRAME_MAX_DATA_LEN + 1,
+                                    2 * RGB_BTN_FRAME_MAX_DATA_LEN, 100, RGB_BTN_MSG_MAX_DATA_LEN};
+    _test_frames_t _frames;
+
+    for (uint8_t i = 0; i < ARRAY_SIZE(_lens); i++)
+    {
+        uint8_t _id = (uint8_t)(0x10 + i);
+
+        _test_split(&_frames, TEST_NODE_ADDR, _id, _lens[i]);
+        bool ok = _test_rx_ok(&_frames, _id, _lens[i]);
+        _test_split(&_frames, ADDR_BROADCAST, _id + 0x40, _lens[i]);
+        ok &= _test_rx_ok(&_frames, _id + 0x40, _lens[i]);
+        _test_check(ok, "in order", "%3d bytes in %d frame(s): reassembled (direct and broadcast)", _lens[i], _frames.cnt);
+    }
+}
+
+static void _test_dropped(const char * name, const char * desc, const uint8_t * order, uint8_t cnt, void (*change)(_test_frames_t *))
+{
+    _test_frames_t _frames;
+    _test_buff_t _buff;
+    bool ok = true;
+
+    //A msg of 3 fragments, played into the comms in this order (and changed)
+    _test_split(&_frames, TEST_NODE_ADDR, 0x20, RGB_BTN_MSG_MAX_DATA_LEN);
+    if (change)
+        change(&_frames);
+    memset(&_buff, TEST_GUARD, sizeof(_buff));
+    for (uint8_t i = 0; i < cnt; i++)
+        ok &= (_test_rx(&_frames.frame[order[i]], &_buff) <= 0);
+
+    //... and the next msg gets through
+    _test_split(&_frames, TEST_NODE_ADDR, 0x21, RGB_BTN_MSG_MAX_DATA_LEN);
+    ok &= _test_rx_ok(&_frames, 0x21, RGB_BTN_MSG_MAX_DATA_LEN);
+    _test_check(ok, name, "%s: dropped, the next msg ok", desc);
+}
+
+static void _test_change_src(_test_frames_t * frames)
+{
+    frames->frame[1].data[offsetof(comms_msg_hdr_t, src)] = TEST_OTHER_ADDR;
+    _test_frame_crc(&frames->frame[1]);
+}
+
+static void _test_change_id(_test_frames_t * frames)
+{
+    frames->frame[1].data[offsetof(comms_msg_hdr_t, id)]++;
+    _test_frame_crc(&frames->frame[1]);
+}
+
+static void _test_change_crc(_test_frames_t * frames)
+{
+    frames->frame[1].data[sizeof(comms_msg_hdr_t)] ^= 0x01;
+}
+
+static void _test_out_of_order(void)
+{
+    static const uint8_t _order_021[] = {0, 2, 1};
+    static const uint8_t _order_102[] = {1, 0, 2};
+    static const uint8_t _order_02[] = {0, 2};
+    static const uint8_t _order_012[] = {0, 1, 2};
+    uint8_t _crc_err = _comms.link.crc_err;
+
+    _test_dropped("order", "fragments 0, 2, 1", _order_021, ARRAY_SIZE(_order_021), NULL);
+    _test_dropped("order", "fragments 1, 0, 2", _order_102, ARRAY_SIZE(_order_102), NULL);
+    _test_dropped("lost", "fragments 0, 2", _order_02, ARRAY_SIZE(_order_02), NULL);
+    _test_dropped("src", "fragment 1 from another src", _order_012, ARRAY_SIZE(_order_012), _test_change_src);
+    _test_dropped("id", "fragment 1 with another id", _order_012, ARRAY_SIZE(_order_012), _test_change_id);
+    _test_dropped("crc", "fragment 1 with a bad CRC", _order_012, ARRAY_SIZE(_order_012), _test_change_crc);
+    _test_check(_comms.link.crc_err == (uint8_t)(_crc_err + 1), "crc", "the bad CRC is counted (link crc_err)");
+}
+
+static void _test_other_node(void)
+{
+    _test_frames_t _ours;
+    _test_frames_t _theirs;
+    _test_buff_t _buff;
+    uint8_t _data[RGB_BTN_MSG_MAX_DATA_LEN];
+    int8_t _len = 0;
+
+    //The master does not interleave msgs, but another node's msg might be on the bus between our fragments
+    _test_split(&_ours, TEST_NODE_ADDR, 0x30, RGB_BTN_MSG_MAX_DATA_LEN);
+    _test_split(&_theirs, TEST_OTHER_ADDR, 0x31, RGB_BTN_MSG_MAX_DATA_LEN);
+    memset(&_buff, TEST_GUARD, sizeof(_buff));
+    bool ok = true;
+    for (uint8_t f = 0; f < _ours.cnt; f++)
+    {
+        ok &= (_test_rx(&_theirs.frame[f], &_buff) == 0);
+        _len = _test_rx(&_ours.frame[f], &_buff);
+        ok &= (_len == (((f + 1) < _ours.cnt)? 0 : (int8_t)RGB_BTN_MSG_MAX_DATA_LEN));
+    }
+    _test_data(_data, 0x30, RGB_BTN_MSG_MAX_DATA_LEN);
+    ok &= (memcmp(_buff.data, _data, RGB_BTN_MSG_MAX_DATA_LEN) == 0);
+    _test_check(ok, "other node", "fragments of a msg for another node in between ours: ours reassembled");
+}
+
+static void _test_restart(void)
+{
+    _test_frames_t _first;
+    _test_frames_t _second;
+    _test_buff_t _buff;
+
+    //The 1st fragment of a msg, and then a whole new msg (e.g. the rest of the 1st was lost)
+    _test_split(&_first, TEST_NODE_ADDR, 0x40, RGB_BTN_MSG_MAX_DATA_LEN);
+    _test_split(&_second, TEST_NODE_ADDR, 0x41, RGB_BTN_MSG_MAX_DATA_LEN);
+    memset(&_buff, TEST_GUARD, sizeof(_buff));
+    bool ok = (_test_rx(&_first.frame[0], &_buff) == 0);
+    ok &= _test_rx_ok(&_second, 0x41, RGB_BTN_MSG_MAX_DATA_LEN);
+
+    //... and the rest of the 1st one is ignored
+    ok &= (_test_rx(&_first.frame[1], &_buff) == 0);
+    ok &= (_test_rx(&_first.frame[2], &_buff) == 0);
+    _test_check(ok, "restart", "fragment 0 of a new msg in the middle of another: only the new one");
+}
+
+static void _test_overlong(void)
+{
+    _test_frames_t _frames;
+    _test_buff_t _buff;
+    bool ok = true;
+
+    //The master never sends more than RGB_BTN_MSG_MAX_DATA_LEN, so the 3 full frames are made up: 0 and 1 of a
+    // long msg, and 1 again as fragment 2 (with more to follow)
+    _test_split(&_frames, TEST_NODE_ADDR, 0x50, 2 * RGB_BTN_FRAME_MAX_DATA_LEN);
+    _frames.frame[0].data[offsetof(comms_msg_hdr_t, frag)] |= COMMS_FRAG_MORE;
+    _test_frame_crc(&_frames.frame[0]);
+    _frames.frame[2] = _frames.frame[1];
+    _frames.frame[1].data[offsetof(comms_msg_hdr_t, frag)] = 1 | COMMS_FRAG_MORE;
+    _test_frame_crc(&_frames.frame[1]);
+    _frames.frame[2].data[offsetof(comms_msg_hdr_t, frag)] = 2;
+    _test_frame_crc(&_frames.frame[2]);
+
+    memset(&_buff, TEST_GUARD, sizeof(_buff));
+    for (uint8_t f = 0; f < 3; f++)
+        ok &= (_test_rx(&_frames.frame[f], &_buff) == 0);
+    for (uint8_t i = 0; i < sizeof(_buff.guard); i++)
+        ok &= (_buff.guard[i] == TEST_GUARD);
+    _test_check(ok, "overlong", "%d data bytes in 3 fragments (max %d): dropped, nothing written past the buffer",
+                3 * (int)RGB_BTN_FRAME_MAX_DATA_LEN, (int)RGB_BTN_MSG_MAX_DATA_LEN);
+}
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+int main(int argc, char * argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-v"))
+            sim_console_verbose = true;
+    }
+
+    dev_comms_init();
+    dev_comms_addr_set(TEST_NODE_ADDR);
+
+    printf("Comms: frames of %d bytes (%d data), msgs of %d data bytes\n", RGB_BTN_FRAME_MAX_LEN, (int)RGB_BTN_FRAME_MAX_DATA_LEN, (int)RGB_BTN_MSG_MAX_DATA_LEN);
+    _test_in_order();
+    _test_out_of_order();
+    _test_other_node();
+    _test_restart();
+    _test_overlong();
+
+    printf("%s (%d failed)\n", (_test_fails == 0)? "PASSED" : "FAILED", _test_fails);
+    return _test_fails;
+}
+
+#undef PRINTF_TAG
+/*************************** END OF FILE *************************************/
@@ -0,0 +1,151 @@
+/*******************************************************************************
+
+Module:     sim_serial.cpp
+Purpose:    This file contains the host stand-ins for the comms test
+Author:     Rudolph van Niekerk
+
+The serial port, the timers, the IO and the console, just enough to run
+dev_comms.cpp on the host (comms_test.cpp, and tools/node_test). Whatever is
+written to the serial port is kept in sim_serial_tx (until it is full), and
+with sim_serial_echo it comes straight back into the RX IRQ callback, as on
+the half-duplex bus (the test plays the rest of the bus into the callback
+itself, which is kept in sim_serial_rx_cb). The callback timers never fire,
+the clock (and so the stopwatches) only moves when the test sets sim_millis,
+and the console trace goes to stdout with -v. The CRC is the same as in sys_utils.cpp
+(the rest of which is AVR ports and the ADC).
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "sys_utils.h"
+#include "hal_timers.h"
+#include "hal_serial.h"
+#include "dev_console.h"
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#define SIM_SERIAL_TX_LEN   (256)
+
+/*******************************************************************************
+Global (public) variables
+ *******************************************************************************/
+bool sim_console_verbose = false;
+unsigned long sim_millis = 0;               /* The (corrected) clock of the node */
+void (*sim_serial_rx_cb)(uint8_t) = NULL;   /* The RX IRQ callback of the comms */
+uint8_t sim_serial_tx[SIM_SERIAL_TX_LEN];   /* What was written to the serial port */
+size_t sim_serial_tx_len = 0;
+bool sim_serial_echo = false;               /* Every byte written is received as well */
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+unsigned long sys_millis(void)
+{
+    return sim_millis;
+}
+
+void hal_serial_init(void (*cb_rx_irq)(uint8_t))
+{
+    sim_serial_rx_cb = cb_rx_irq;
+}
+
+void hal_serial_flush(void) {}
+
+size_t hal_serial_write(uint8_t c)
+{
+    if (sim_serial_tx_len < SIM_SERIAL_TX_LEN)
+        sim_serial_tx[sim_serial_tx_len++] = c;
+    if ((sim_serial_echo) && (sim_serial_rx_cb != NULL))
+        sim_serial_rx_cb(c);
+    return 1;
+}
+
+bool sys_cb_tmr_start(void (*cb_tmr_exp)(void), unsigned long interval, bool reload)
+{
+    return true;
+}
+
+void sys_cb_tmr_stop(void (*cb_tmr_exp)(void)) {}
+
+void sys_stopwatch_ms_start(stopwatch_ms_t* sw, unsigned long max_time)
+{
+    sw->tick_start = sim_millis;
+    sw->max_time = max_time;
+    sw->running = true;
+    sw->max_time_reached = false;
+}
+
+unsigned long sys_stopwatch_ms_lap(stopwatch_ms_t* sw)
+{
+    unsigned long elapsed;
+
+    if (!sw->running)
+        return 0;
+    elapsed = sim_millis - sw->tick_start;
+    if ((sw->max_time > 0) && (elapsed >= sw->max_time))
+        sw->max_time_reached = true;
+    return (sw->max_time_reached)? sw->max_time : elapsed;
+}
+
+void sys_output_write(uint8_t pin, bool state) {}
+
+void sys_set_io_mode(uint8_t pin, uint8_t mode) {}
+
+long sys_random(long rand_min, long rand_max)
+{
+    return rand_min + (rand() % (rand_max - rand_min));
+}
+
+void console_init(size_t (*cb_write)(uint8_t), void (*cb_flush)(void)) {}
+
+void console_read_byte(uint8_t data_byte) {}
+
+void console_printline(uint8_t traceflags, const char * tag, const char *fmt, ...)
+{
+    va_list args;
+
+    if (!sim_console_verbose)
+        return;
+    va_start(args, fmt);
+    printf("      [%s] ", tag);
+    vprintf(fmt, args);
+    printf("\n");
+    va_end(args);
+}
+
+void console_trace(uint8_t traceflags, const char * tag, const char * fmt, int arg0, int arg1)
+{
+    console_printline(traceflags, tag, fmt, arg0, arg1);
+}
+
+uint8_t crc8(uint8_t crc_start, uint8_t data)
+{
+    uint8_t crc = crc_start;
+    for (uint8_t i = 8; i; i--)
+    {
+        uint8_t sum = (crc ^ data) & 0x01;
+        crc >>= 1;
+        if (sum)
+            crc ^= CRC_POLYNOMIAL;
+        data >>= 1;
+    }
+    return crc;
+}
+
+uint8_t crc8_n(uint8_t crc_start, const uint8_t *data, uint8_t len)
+{
+    uint8_t crc = crc_start;
+    while (len--)
+        crc = crc8(crc, *data++);
+    return crc;
+}
+
+/*************************** END OF FILE *************************************/
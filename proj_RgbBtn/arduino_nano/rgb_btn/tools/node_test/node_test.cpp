@@ -0,0 +1,547 @@
+/*******************************************************************************
+
+Module:     node_test.cpp
+Purpose:    This file contains the host test for the commands handled by the node
+Author:     Rudolph van Niekerk
+
+Runs the node (setup() and loop() of main.cpp, with the real comms) on the
+host, plays msgs from the master into the RX IRQ callback of the comms, made
+up the way the master makes them (a masked broadcast starts with
+cmd_bcast_address_mask), and checks what the node shows on its LED and when,
+and what it answers (whatever it writes is echoed back, as on the bus).
+The clock only moves in steps of TEST_LOOP_MS, with loop() run at every step
+(a msg is read after the playback is serviced, so a step at 0 ms is shown in
+the next loop). Checks (cmd_set_sequence):
+  - The node lights up in the steps with its slot, in the colour of the
+    sequence, for on_ms of every step, after the lead-in, and shows its
+    primary colour in-between and once the sequence is done.
+  - A node with no step in the sequence (not in the mask) shows nothing, a
+    node in slot 17 (above the 16 bits of an int on the AVR) and a step in
+    the 32nd (last) place of a sequence are played back.
+  - A sequence of 0 steps, a new sequence and an activation stop the
+    playback at once. A new primary colour set during a step is only shown
+    once the step is over (and in-between the steps from then on).
+  - A sequence in a direct msg is rejected (it is broadcast only).
+Checks (cmd_roll_call):
+  - A registered node answers a check with its slot, in its own slot
+    (ROLL_CHECK_TIMOUT_MS()), and stays registered.
+  - An unregistered node does not answer a check, and a registered node does
+    not answer a roll-call of the unregistered nodes.
+  - A roll-call of all the nodes is answered without a slot (after a delay
+    based on the address), and the node waits to be registered again.
+
+main.cpp is included (not linked), so that the test can get to the state of
+the node. The Arduino core is stood in for by tools/nvstore_test/stub, the
+serial port, the timers and the console by tools/comms_test/sim_serial.cpp,
+and the LED, the button and the NV store by sim_node.cpp.
+
+Build (from rgb_btn/, with any host C++ compiler, with the enums in a byte as
+on the AVR, where a cmd is read straight into a master_command_t):
+    g++ -O2 -fshort-enums -DCLOCK_CORRECTION_ENABLED=1 -o node_test \
+        -I tools/nvstore_test/stub -I src \
+        tools/node_test/node_test.cpp tools/node_test/sim_node.cpp \
+        tools/comms_test/sim_serial.cpp src/dev_comms.cpp
+
+Use:
+    ./node_test [-v]
+    -v prints the trace of the node. The exit code is the number of failed
+    checks (0 if all passed).
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "main.cpp"
+#include "sim_node.h"
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#ifdef PRINTF_TAG
+#undef PRINTF_TAG
+#endif
+#define PRINTF_TAG ("Test") /* This must be undefined at the end of the file*/
+
+#define TEST_NODE_ADDR      (0x42)
+#define TEST_LOOP_MS        (10)        /* The time between 2 runs of loop() */
+#define TEST_SEQ_RGB        (0x00FF0000lu)
+#define TEST_CHANGES_MAX    (16)
+#define TEST_RC_NONE        (0xFFFF)    /* No answer to a roll-call (see _test_rc_answer()) */
+
+/*******************************************************************************
+Local structure
+ *******************************************************************************/
+typedef struct
+{
+    unsigned long ms;   // When the colour changed
+    uint32_t rgb;
+} _test_change_t;
+
+/*******************************************************************************
+Local function prototypes
+ *******************************************************************************/
+
+/*! \brief Sends a msg from the master: splits it into frames (as _tx_now() in task_comms.c) and plays them into the comms
+ * \param dst The node (or ADDR_BROADCAST)
+ * \param data The cmds and their payloads
+ * \param len The number of data bytes
+ */
+void _test_send(uint8_t dst, const uint8_t * data, uint8_t len);
+
+/*! \brief Sends a single cmd in a masked broadcast (as _init_bcst_msg_mask() and comms_tx_msg_append() in nodes.c)
+ */
+void _test_bcst(uint32_t mask, master_command_t cmd, const void * payload, uint8_t len);
+
+/*! \brief Sends a sequence, as bcst_sequence() in nodes.c does (only to the nodes with a step in it, 0 steps to all)
+ * \param direct Send it to this node directly (which it should reject) instead
+ */
+void _test_sequence(const uint8_t * slots, uint8_t steps, uint16_t lead_ms, uint16_t on_ms, uint16_t off_ms, bool direct = false);
+
+/*! \brief Runs loop() until the time given, clearing the log of colours set first
+ */
+void _test_run_from(unsigned long from_ms);
+void _test_run_until(unsigned long until_ms);
+
+/*! \brief Reduces the log of colours set to the changes of colour
+ * \return The number of changes
+ */
+int _test_changes(_test_change_t * changes);
+
+/*! \brief Checks the changes of colour against those expected
+ * \return true if they are the same
+ */
+bool _test_changes_ok(const _test_change_t * expected, int cnt, char * text, size_t text_len);
+
+/*! \brief Sends a roll-call (a broadcast without a mask, as _bcst_rollcall() in nodes.c)
+ */
+void _test_roll_call(uint8_t type);
+
+/*! \brief Finds the answer to a roll-call in what the node wrote to the serial port
+ * \return The slot the node answered with, TEST_RC_NONE if there was no (single, valid) answer to the master
+ */
+uint16_t _test_rc_answer(void);
+
+/*! \brief Reports the outcome of a check
+ */
+void _test_check(bool ok, const char * name, const char * fmt, ...);
+
+/*******************************************************************************
+Local variables
+ *******************************************************************************/
+static int _test_fails = 0;
+static uint8_t _test_id = 0;
+static uint32_t _test_primary = 0;
+static unsigned long _test_tx_ms = 0;   /* When the node first wrote to the serial port (0 if it did not) */
+
+/*******************************************************************************
+Local (private) Functions
+ *******************************************************************************/
+void _test_send(uint8_t dst, const uint8_t * data, uint8_t len)
+{
+    uint8_t _frame[RGB_BTN_FRAME_MAX_LEN];
+    uint8_t _offset = 0;
+    uint8_t _frag = 0;
+
+    _test_id++;
+    do
+    {
+        comms_msg_hdr_t * _hdr = (comms_msg_hdr_t *)_frame;
+        uint8_t _len = min((uint8_t)(len - _offset), (uint8_t)RGB_BTN_FRAME_MAX_DATA_LEN);
+        uint8_t _frame_len = sizeof(comms_msg_hdr_t) + _len + sizeof(uint8_t);
+
+        _hdr->version = RGB_BTN_MSG_VERSION;
+        _hdr->id = _test_id;
+        _hdr->src = ADDR_MASTER;
+        _hdr->dst = dst;
+        _hdr->frag = _frag | (((_offset + _len) < len)? COMMS_FRAG_MORE : 0);
+        _hdr->len = _len;
+        memcpy(&_frame[sizeof(comms_msg_hdr_t)], &data[_offset], _len);
+        _frame[_frame_len - 1] = crc8_n(0, _frame, _frame_len - 1);
+
+        sim_serial_rx_cb(STX);
+        for (uint8_t i = 0; i < _frame_len; i++)
+        {
+            uint8_t _d = _frame[i];
+            if ((_d == STX) || (_d == DLE) || (_d == ETX))
+            {
+                sim_serial_rx_cb(DLE);
+                _d ^= DLE;
+            }
+            sim_serial_rx_cb(_d);
+        }
+        sim_serial_rx_cb(ETX);
+
+        _offset += _len;
+        _frag++;
+    }while (_offset < len);
+}
+
+void _test_bcst(uint32_t mask, master_command_t cmd, const void * payload, uint8_t len)
+{
+    uint8_t _data[RGB_BTN_MSG_MAX_DATA_LEN];
+    uint8_t _len = 0;
+
+    _data[_len++] = cmd_bcast_address_mask;
+    memcpy(&_data[_len], &mask, sizeof(uint32_t));
+    _len += sizeof(uint32_t);
+    _data[_len++] = cmd;
+    memcpy(&_data[_len], payload, len);
+    _test_send(ADDR_BROADCAST, _data, _len + len);
+}
+
+void _test_sequence(const uint8_t * slots, uint8_t steps, uint16_t lead_ms, uint16_t on_ms, uint16_t off_ms, bool direct)
+{
+    uint8_t _payload[sizeof(cmd_sequence_t) + CMD_SEQ_STEPS_MAX];
+    cmd_sequence_t * _seq = (cmd_sequence_t *)_payload;
+    uint32_t _rgb = TEST_SEQ_RGB;
+    uint32_t _mask = 0;
+
+    _seq->steps = steps;
+    memcpy(_seq->rgb, &_rgb, 3);
+    _seq->lead_ms = lead_ms;
+    _seq->on_ms = on_ms;
+    _seq->off_ms = off_ms;
+    for (uint8_t i = 0; i < steps; i++)
+    {
+        _payload[sizeof(cmd_sequence_t) + i] = slots[i];
+        _mask |= (1UL << slots[i]);
+    }
+    if (steps == 0)
+        _mask = 0xFFFFFFFFlu;
+
+    if (direct)
+    {
+        uint8_t _data[1 + sizeof(_payload)];
+        _data[0] = cmd_set_sequence;
+        memcpy(&_data[1], _payload, sizeof(cmd_sequence_t) + steps);
+        _test_send(TEST_NODE_ADDR, _data, 1 + sizeof(cmd_sequence_t) + steps);
+    }
+    else
+        _test_bcst(_mask, cmd_set_sequence, _payload, sizeof(cmd_sequence_t) + steps);
+}
+
+void _test_run_from(unsigned long from_ms)
+{
+    sim_millis = from_ms;
+    sim_rgb_log_cnt = 0;
+    sim_serial_tx_len = 0;
+    _test_tx_ms = 0;
+}
+
+void _test_run_until(unsigned long until_ms)
+{
+    do
+    {
+        loop();
+        if ((_test_tx_ms == 0) && (sim_serial_tx_len > 0))
+            _test_tx_ms = sim_millis;
+        sim_millis += TEST_LOOP_MS;
+    }while (sim_millis <= until_ms);
+}
+
+int _test_changes(_test_change_t * changes)
+{
+    uint32_t _shown = _test_primary;
+    int cnt = 0;
+
+    for (int i = 0; (i < sim_rgb_log_cnt) && (cnt < TEST_CHANGES_MAX); i++)
+    {
+        if (sim_rgb_log[i].rgb == _shown)
+            continue;
+        _shown = sim_rgb_log[i].rgb;
+        changes[cnt].ms = sim_rgb_log[i].ms;
+        changes[cnt].rgb = _shown;
+        cnt++;
+    }
+    return cnt;
+}
+
+bool _test_changes_ok(const _test_change_t * expected, int cnt, char * text, size_t text_len)
+{
+    _test_change_t _changes[TEST_CHANGES_MAX];
+    int _cnt = _test_changes(_changes);
+    size_t _len = 0;
+    bool ok = (_cnt == cnt);
+
+    text[0] = '\0';
+    for (int i = 0; i < _cnt; i++)
+    {
+        if ((i >= cnt) || (_changes[i].ms != expected[i].ms) || (_changes[i].rgb != expected[i].rgb))
+            ok = false;
+        if (_len < text_len)
+            _len += snprintf(&text[_len], text_len - _len, "%s%lu %s", (i == 0)? "" : ", ", _changes[i].ms,
+                (_changes[i].rgb == TEST_SEQ_RGB)? "on" : ((_changes[i].rgb == _test_primary)? "off" : "?"));
+    }
+    if (_cnt == 0)
+        snprintf(text, text_len, "no change");
+    return ok;
+}
+
+void _test_roll_call(uint8_t type)
+{
+    uint8_t _data[] = {cmd_roll_call, type};
+
+    _test_send(ADDR_BROADCAST, _data, sizeof(_data));
+}
+
+uint16_t _test_rc_answer(void)
+{
+    uint8_t _frame[RGB_BTN_FRAME_MAX_LEN];
+    comms_msg_hdr_t * _hdr = (comms_msg_hdr_t *)_frame;
+    uint8_t * _data = &_frame[sizeof(comms_msg_hdr_t)];
+    uint8_t _len = 0;
+    int _frames = 0;
+    bool _busy = false;
+    bool _escaping = false;
+    uint16_t slot = TEST_RC_NONE;
+
+    for (size_t i = 0; i < sim_serial_tx_len; i++)
+    {
+        uint8_t _d = sim_serial_tx[i];
+
+        if (_d == STX)
+        {
+            _len = 0;
+            _busy = true;
+            _escaping = false;
+        }
+        else if (!_busy)
+            continue; //The "\r\n" after a frame
+        else if (_d == DLE)
+            _escaping = true;
+        else if (_d != ETX)
+        {
+            if (_len < sizeof(_frame))
+                _frame[_len++] = (_escaping)? (_d ^ DLE) : _d;
+            _escaping = false;
+        }
+        else
+        {
+            _busy = false;
+            _frames++;
+            if ((_len == (sizeof(comms_msg_hdr_t) + 3 + 1)) && (crc8_n(0, _frame, _len) == 0) && (_hdr->src == TEST_NODE_ADDR) &&
+                (_hdr->dst == ADDR_MASTER) && (_data[0] == cmd_roll_call) && (_data[1] == resp_ok))
+                slot = _data[2];
+        }
+    }
+    return (_frames == 1)? slot : TEST_RC_NONE;
+}
+
+void _test_check(bool ok, const char * name, const char * fmt, ...)
+{
+    va_list args;
+
+    if (!ok)
+        _test_fails++;
+    printf("%s  %-12s ", ok? "pass" : "FAIL", name);
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+    printf("\n");
+}
+
+static void _test_slot(int8_t slot)
+{
+    //As cmd_set_bitmask_index would have it, once registered
+    my_mask_index = slot;
+    reg_state = idle;
+}
+
+static void _test_playback(void)
+{
+    static const uint8_t _slots[] = {3, 1, 3, 3, 0, 2};
+    //Step n starts at 1000 + lead + n*(on + off)
+    const _test_change_t _expected[] = {{1100, TEST_SEQ_RGB}, {1300, _test_primary}, {1700, TEST_SEQ_RGB},
+                                        {1900, _test_primary}, {2000, TEST_SEQ_RGB}, {2200, _test_primary}};
+    char text[160];
+
+    _test_slot(3);
+    _test_run_from(1000);
+    _test_sequence(_slots, ARRAY_SIZE(_slots), 100, 200, 100);
+    _test_run_until(3000);
+    bool ok = _test_changes_ok(_expected, ARRAY_SIZE(_expected), text, sizeof(text));
+    _test_check(ok && (seq.steps == 0) && (sim_rgb == _test_primary), "playback", "slot 3 in steps 0, 2, 3 at 1000 ms: %s", text);
+
+    //Not in the sequence (and so not in the mask)
+    _test_slot(5);
+    _test_run_from(4000);
+    _test_sequence(_slots, ARRAY_SIZE(_slots), 100, 200, 100);
+    _test_run_until(6000);
+    ok = _test_changes_ok(NULL, 0, text, sizeof(text));
+    _test_check(ok && (seq.steps == 0), "not mine", "slot 5: %s", text);
+}
+
+static void _test_slots(void)
+{
+    static const uint8_t _slots_17[] = {17, 2};
+    const _test_change_t _expected_17[] = {{1050, TEST_SEQ_RGB}, {1100, _test_primary}};
+    uint8_t _slots_32[CMD_SEQ_STEPS_MAX];
+    const _test_change_t _expected_32[] = {{1000 + TEST_LOOP_MS, TEST_SEQ_RGB}, {1020, _test_primary},
+                                           {1000 + (31 * 30), TEST_SEQ_RGB}, {1000 + (31 * 30) + 20, _test_primary}};
+    char text[160];
+
+    //Slot 17: the mask (and the 1UL shift) has to be 32-bit on the node
+    _test_slot(17);
+    _test_run_from(1000);
+    _test_sequence(_slots_17, ARRAY_SIZE(_slots_17), 50, 50, 50);
+    _test_run_until(2000);
+    bool ok = _test_changes_ok(_expected_17, ARRAY_SIZE(_expected_17), text, sizeof(text));
+    _test_check(ok && (seq.steps == 0), "slot 17", "step 0 of 2: %s", text);
+
+    //The longest sequence, with our steps 1st and last
+    for (uint8_t i = 0; i < CMD_SEQ_STEPS_MAX; i++)
+        _slots_32[i] = ((i == 0) || (i == (CMD_SEQ_STEPS_MAX - 1)))? 4 : 1;
+    _test_slot(4);
+    _test_run_from(1000);
+    _test_sequence(_slots_32, CMD_SEQ_STEPS_MAX, 0, 20, 10);
+    _test_run_until(3000);
+    ok = _test_changes_ok(_expected_32, ARRAY_SIZE(_expected_32), text, sizeof(text));
+    _test_check(ok && (seq.steps == 0), "32 steps", "steps 0 and 31: %s", text);
+}
+
+static void _test_stop(void)
+{
+    static const uint8_t _slots[] = {3, 3, 3, 3};
+    static const uint8_t _slots_new[] = {1, 3};
+    const _test_change_t _expected_stop[] = {{1000 + TEST_LOOP_MS, TEST_SEQ_RGB}, {1100, _test_primary}};
+    const _test_change_t _expected_new[] = {{1000 + TEST_LOOP_MS, TEST_SEQ_RGB}, {1050, _test_primary}, {1350, TEST_SEQ_RGB},
+                                            {1450, _test_primary}};
+    uint8_t _activate = CMD_SW_PAYLOAD_ACTIVATE;
+    uint32_t _rgb = 0x00000080lu;
+    char text[160];
+
+    _test_slot(3);
+
+    //Stopped (0 steps) in the middle of a step
+    _test_run_from(1000);
+    _test_sequence(_slots, ARRAY_SIZE(_slots), 0, 200, 100);
+    _test_run_until(1090);
+    _test_sequence(NULL, 0, 0, 0, 0);
+    _test_run_until(3000);
+    bool ok = _test_changes_ok(_expected_stop, ARRAY_SIZE(_expected_stop), text, sizeof(text));
+    _test_check(ok && (seq.steps == 0), "stop", "0 steps at 1100 ms: %s", text);
+
+    //Replaced by a new sequence (our step is the 2nd)
+    _test_run_from(1000);
+    _test_sequence(_slots, ARRAY_SIZE(_slots), 0, 200, 100);
+    _test_run_until(1040);
+    _test_sequence(_slots_new, ARRAY_SIZE(_slots_new), 100, 100, 100);
+    _test_run_until(3000);
+    ok = _test_changes_ok(_expected_new, ARRAY_SIZE(_expected_new), text, sizeof(text));
+    _test_check(ok && (seq.steps == 0), "replace", "new sequence at 1050 ms: %s", text);
+
+    //Activated (the master is waiting for a press)
+    _test_run_from(1000);
+    _test_sequence(_slots, ARRAY_SIZE(_slots), 0, 200, 100);
+    _test_run_until(1090);
+    _test_bcst(1UL << 3, cmd_set_switch, &_activate, sizeof(_activate));
+    _test_run_until(3000);
+    ok = _test_changes_ok(_expected_stop, ARRAY_SIZE(_expected_stop), text, sizeof(text));
+    _test_check(ok && (seq.steps == 0) && (system_flags & flag_activated), "activate", "activated at 1100 ms: %s", text);
+    deactivate_button(flag_deactivated);
+
+    //A new primary colour in the middle of a step is shown once the step is over (at 1200 ms)
+    _test_run_from(1000);
+    _test_sequence(_slots, 2, 0, 200, 100);
+    _test_run_until(1090);
+    _test_bcst(1UL << 3, cmd_set_rgb_0, &_rgb, 3);
+    _test_run_until(3000);
+    unsigned long shown_ms = 0;
+    for (int i = 0; (i < sim_rgb_log_cnt) && (shown_ms == 0); i++)
+        if (sim_rgb_log[i].rgb == _rgb)
+            shown_ms = sim_rgb_log[i].ms;
+    _test_check((shown_ms == 1200) && (sim_rgb == _rgb) && (seq.steps == 0), "colour",
+        "new primary at 1100 ms (step 0 lit until 1200 ms): shown at %lu ms", shown_ms);
+    colour_set(0, _test_primary);
+}
+
+static void _test_check_in(void)
+{
+    uint16_t slot;
+
+    //Registered in slot 3, so the answer goes in the 4th slot of the check
+    _test_slot(3);
+    _test_run_from(1000);
+    _test_roll_call(CMD_RC_PAYLOAD_CHECK);
+    _test_run_until(2000);
+    slot = _test_rc_answer();
+    _test_check((slot == 3) && (_test_tx_ms == 1000 + ROLL_CHECK_TIMOUT_MS(3)) && (reg_state == idle) && (my_mask_index == 3) && (!roll_check),
+        "check", "slot 3: answered slot %d at %lu ms, %s", (slot == TEST_RC_NONE)? -1 : slot, _test_tx_ms,
+        (reg_state == idle)? "still registered" : "no longer registered");
+
+    //Not registered, so there is no slot to answer in
+    my_mask_index = -1;
+    reg_state = un_reg;
+    _test_run_from(1000);
+    _test_roll_call(CMD_RC_PAYLOAD_CHECK);
+    _test_run_until(2000);
+    _test_check((sim_serial_tx_len == 0) && (reg_state == un_reg), "check unreg", "not registered: %d bytes written", (int)sim_serial_tx_len);
+
+    //Registered, so a roll-call of the unregistered nodes is not for us
+    _test_slot(3);
+    _test_run_from(1000);
+    _test_roll_call(CMD_RC_PAYLOAD_UNREG);
+    _test_run_until(1000 + ROLL_CALL_TIMOUT_MS(ADDR_BROADCAST, ADDR_BROADCAST));
+    _test_check((sim_serial_tx_len == 0) && (reg_state == idle), "unreg", "slot 3: %d bytes written", (int)sim_serial_tx_len);
+
+    //Everybody, registered or not, answers (without a slot) and waits to be registered again
+    _test_run_from(1000);
+    _test_roll_call(CMD_RC_PAYLOAD_ALL);
+    _test_run_until(1000 + ROLL_CALL_TIMOUT_MS(ADDR_BROADCAST, ADDR_BROADCAST));
+    slot = _test_rc_answer();
+    _test_check((slot == CMD_RC_SLOT_NONE) && (_test_tx_ms >= 1000 + ROLL_CALL_TIMOUT_MS(TEST_NODE_ADDR, 0)) &&
+        (_test_tx_ms <= 1000 + ROLL_CALL_TIMOUT_MS(TEST_NODE_ADDR, 0xFF) + TEST_LOOP_MS) && (reg_state == waiting), "all",
+        "slot 3: answered slot 0x%02X at %lu ms, %s", (slot == TEST_RC_NONE)? 0 : slot, _test_tx_ms,
+        (reg_state == waiting)? "waiting to be registered" : "not waiting");
+    _test_slot(3);
+}
+
+static void _test_direct(void)
+{
+    static const uint8_t _slots[] = {3, 3};
+    char text[160];
+
+    _test_slot(3);
+    _test_run_from(1000);
+    _test_sequence(_slots, ARRAY_SIZE(_slots), 0, 100, 100, true);
+    _test_run_until(2000);
+    bool ok = _test_changes_ok(NULL, 0, text, sizeof(text));
+    _test_check(ok && (seq.steps == 0), "direct", "sequence in a direct msg: %s", text);
+}
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+int main(int argc, char * argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-v"))
+            sim_console_verbose = true;
+    }
+
+    setup();
+    dev_comms_addr_set(TEST_NODE_ADDR);
+    sim_serial_echo = true;
+    _test_primary = colour[0].rgb;
+
+    printf("Node: sequences of up to %d steps, loop() every %d ms\n", CMD_SEQ_STEPS_MAX, TEST_LOOP_MS);
+    _test_playback();
+    _test_slots();
+    _test_stop();
+    _test_check_in();
+    _test_direct();
+
+    printf("%s (%d failed)\n", (_test_fails == 0)? "PASSED" : "FAILED", _test_fails);
+    return _test_fails;
+}
+
+#undef PRINTF_TAG
+/*************************** END OF FILE *************************************/
@@ -0,0 +1,137 @@
+/*******************************************************************************
+
+Module:     sim_node.cpp
+Purpose:    This file contains the host stand-ins for the node test
+Author:     Rudolph van Niekerk
+
+The rest of what main.cpp needs on top of tools/comms_test/sim_serial.cpp:
+the RGB LED (every colour set is logged with the time it was set, see
+sim_rgb_log in sim_node.h), the button (never pressed), the NV store (always empty, and the
+writes are dropped), the poll timers (never expire), the clock correction and
+the console menus.
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+
+#include "sys_utils.h"
+#include "hal_timers.h"
+#include "dev_rgb.h"
+#include "dev_button.h"
+#include "dev_nvstore.h"
+#include "dev_console.h"
+#include "str_helper.h"
+#include "sim_node.h"
+
+/*******************************************************************************
+Global (public) variables
+ *******************************************************************************/
+sim_rgb_set_t sim_rgb_log[SIM_RGB_LOG_LEN];
+int sim_rgb_log_cnt = 0;
+uint32_t sim_rgb = 0;
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+uint8_t dev_rgb_start(int pin_red, int pin_green, int pin_blue)
+{
+    return 0;
+}
+
+void dev_rgb_set_colour(uint32_t rgb)
+{
+    int i = (sim_rgb_log_cnt < SIM_RGB_LOG_LEN)? sim_rgb_log_cnt++ : (SIM_RGB_LOG_LEN - 1);
+
+    //The LED only uses the low 24 bits (a 3 byte payload leaves the top byte as it was)
+    sim_rgb_log[i].ms = sim_millis;
+    sim_rgb_log[i].rgb = rgb & 0x00FFFFFFlu;
+    sim_rgb = rgb & 0x00FFFFFFlu;
+}
+
+void dev_rgb_set_calibration(const colour_cal_t * cal) {}
+
+void dev_button_init(void (*_cb_btn_down)(void), void (*_cb_btn_release)(void), void (*_cb_short_press)(void),
+    void (*_cb_long_press)(void), void (*_cb_dbl_press)(void)) {}
+
+void dev_button_service(void) {}
+
+void dev_nvstore_init(void) {}
+
+bool dev_nvstore_new_data_available(uint8_t key)
+{
+    return false;
+}
+
+bool dev_nvstore_read(uint8_t key, uint8_t * data, uint8_t len)
+{
+    return false;
+}
+
+bool dev_nvstore_write(uint8_t key, uint8_t * data, uint8_t len)
+{
+    return true;
+}
+
+void sys_poll_tmr_start(timer_ms_t *t, unsigned long interval, bool reload)
+{
+    t->enabled = true;
+    t->expired = false;
+}
+
+void sys_poll_tmr_stop(timer_ms_t *t)
+{
+    t->enabled = false;
+}
+
+bool sys_poll_tmr_expired(timer_ms_t *t)
+{
+    return false;
+}
+
+bool sys_poll_tmr_enabled(timer_ms_t *t)
+{
+    return t->enabled;
+}
+
+unsigned long sys_stopwatch_ms_stop(stopwatch_ms_t* sw)
+{
+    unsigned long elapsed = sys_stopwatch_ms_lap(sw);
+
+    sw->running = false;
+    return elapsed;
+}
+
+void sys_time_correction_factor_set(float correction) {}
+
+void sys_time_correction_factor_reset(void) {}
+
+float sys_time_correction_factor(void)
+{
+    return 1.0f;
+}
+
+int console_add_menu(const char * name, const console_menu_item_t * items, size_t cnt, const char * desc)
+{
+    return 0;
+}
+
+char * console_arg_pop(void)
+{
+    return NULL;
+}
+
+void console_flush(void) {}
+
+void console_service(void) {}
+
+char * float2str(char *buff, double fVal, unsigned int decimalpoints, size_t max_len)
+{
+    snprintf(buff, max_len, "%.*f", (int)decimalpoints, fVal);
+    return buff;
+}
+
+/*************************** END OF FILE *************************************/
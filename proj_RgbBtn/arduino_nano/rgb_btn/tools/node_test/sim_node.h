@@ -0,0 +1,52 @@
+/*****************************************************************************
+
+sim_node.h
+
+Include file for node_test.cpp and sim_node.cpp (the host node test)
+
+The clock, the serial port (the RX IRQ callback of the comms and what was
+written) and the log of the colours set on the RGB LED, shared by the test
+and the stand-ins.
+
+******************************************************************************/
+#ifndef __sim_node_H__
+#define __sim_node_H__
+
+/******************************************************************************
+includes
+******************************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************
+Macros
+******************************************************************************/
+#define SIM_RGB_LOG_LEN     (64)
+
+/******************************************************************************
+Struct & Unions
+******************************************************************************/
+typedef struct
+{
+    unsigned long ms;   // When the colour was set
+    uint32_t rgb;
+} sim_rgb_set_t;
+
+/******************************************************************************
+Global (public) variables
+******************************************************************************/
+extern bool sim_console_verbose;
+extern unsigned long sim_millis;                /* sim_serial.cpp */
+extern void (*sim_serial_rx_cb)(uint8_t);       /* sim_serial.cpp */
+extern uint8_t sim_serial_tx[];                 /* sim_serial.cpp */
+extern size_t sim_serial_tx_len;
+extern bool sim_serial_echo;
+
+extern sim_rgb_set_t sim_rgb_log[SIM_RGB_LOG_LEN]; /* The colours set (the last one is repeated if the log is full) */
+extern int sim_rgb_log_cnt;
+extern uint32_t sim_rgb;                        /* The colour shown */
+
+#endif /* __sim_node_H__ */
+
+/****************************** END OF FILE **********************************/
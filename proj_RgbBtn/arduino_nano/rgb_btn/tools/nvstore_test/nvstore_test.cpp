@@ -0,0 +1,432 @@
+/*******************************************************************************
+
+Module:     nvstore_test.cpp
+Purpose:    This file contains the host test for the NV store (the EEPROM log)
+Author:     Rudolph van Niekerk
+
+Runs dev_nvstore.cpp against a simulated EEPROM (stub/EEPROM.h), "booting"
+(dev_nvstore_init()) after every change, and checks:
+  - The head search: the next block to write and the write count, for logs
+    from 1 write up to several rounds of the EEPROM.
+  - Blocks written by the fw before the keyed records (a version of 0x00
+    where the key is now) read as records of key 0.
+  - A torn write (the power fails part of the way through a block): the key
+    keeps its previous record, the others are untouched, and the torn block
+    is the next one written (the head steps back over it).
+  - The copy forward: a key written once is still there after many rounds
+    of writes to another key.
+  - The EEPROM bytes read at startup, with every key written and with a key
+    never written (which makes the walk back read every header).
+  - A soak of random writes to all the keys, some of them torn.
+
+The store is included (not linked), so that the test can get to its state
+(the head and the index). The EEPROM, the clock and the console are stood in
+for by stub/ and sim_eeprom.cpp.
+
+Build (from rgb_btn/, with any host C++ compiler):
+    g++ -O2 -o nvstore_test -I tools/nvstore_test/stub -I src \
+        tools/nvstore_test/nvstore_test.cpp tools/nvstore_test/sim_eeprom.cpp
+
+Use:
+    ./nvstore_test [-v] [writes]
+    -v prints the trace of the store, writes is the length of the soak
+    (default 20000). The exit code is the number of failed checks (0 if all
+    passed).
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <EEPROM.h>
+
+#include "sys_utils.h"
+#include "hal_timers.h"
+#include "str_helper.h"
+#include "dev_console.h"
+#include "dev_nvstore.h"
+
+//The AVR does not align anything, so the blocks only have the layout they have on the Nano if the store's structs are 
+// packed (the headers above are already in, so it is only those of the store)
+#pragma pack(push, 1)
+#include "dev_nvstore.cpp"
+#pragma pack(pop)
+
+/*******************************************************************************
+Macros and Constants
+ *******************************************************************************/
+#ifdef PRINTF_TAG
+#undef PRINTF_TAG
+#endif
+#define PRINTF_TAG ("Test") /* This must be undefined at the end of the file*/
+
+#define TEST_SOAK_WRITES_DEF    (20000)
+#define TEST_TEAR_PCT           (2)     /* The writes in the soak which are torn */
+#define TEST_SEED               (1)
+
+/* The bytes read at startup: block 0 and the binary search (headers), the head (a block), the walk back (headers) and
+ the latest record of each key (a block each) */
+#define TEST_INIT_RD_MAX        ((7 * sizeof(nvstore_block_header_t)) + NVSTORE_BLOCK_SIZE + \
+                                 (NVSTORE_BLOCK_CNT * sizeof(nvstore_block_header_t)) + (NVSTORE_KEY_CNT * NVSTORE_BLOCK_SIZE))
+
+/*******************************************************************************
+Local structure
+ *******************************************************************************/
+typedef struct
+{
+    bool valid;
+    uint8_t data[NVSTORE_BLOCK_DATA_SIZE];
+} _test_record_t;
+
+/*******************************************************************************
+Global (public) variables
+ *******************************************************************************/
+extern bool sim_console_verbose;
+
+/*******************************************************************************
+Local function prototypes
+ *******************************************************************************/
+
+/*! \brief Erases the EEPROM (as a new Nano) and clears the counters
+ */
+void _test_erase(void);
+
+/*! \brief Starts the store up, as at a reset
+ * \return The EEPROM bytes read
+ */
+uint32_t _test_boot(void);
+
+/*! \brief Fills the data of a record from a number (every record differs from the ones before it)
+ */
+void _test_data(uint8_t * data, uint32_t n);
+
+/*! \brief Writes a record and keeps what it should now read
+ * \param expected The records of all the keys (updated if the write got through)
+ * \return The value of dev_nvstore_write()
+ */
+bool _test_write(_test_record_t * expected, uint8_t key, uint32_t n);
+
+/*! \brief Checks that every key reads what it should
+ * \param torn The record of the key written by a torn write (NULL if none)... either the old or this one will do
+ * \return true if all the keys read as expected
+ */
+bool _test_records_ok(const _test_record_t * expected, uint8_t torn_key, const uint8_t * torn);
+
+/*! \brief Reports the outcome of a check
+ */
+void _test_check(bool ok, const char * name, const char * fmt, ...);
+
+/*******************************************************************************
+Local variables
+ *******************************************************************************/
+static int _test_fails = 0;
+
+/*******************************************************************************
+Local (private) Functions
+ *******************************************************************************/
+void _test_erase(void)
+{
+    memset(sim_eeprom.mem, 0xFF, sizeof(sim_eeprom.mem));
+    sim_eeprom.rd_cnt = 0;
+    sim_eeprom.wr_cnt = 0;
+    sim_eeprom.wr_budget = -1;
+    sim_eeprom.last_wr_addr = -1;
+}
+
+uint32_t _test_boot(void)
+{
+    sim_eeprom.rd_cnt = 0;
+    sim_eeprom.wr_budget = -1;
+    dev_nvstore_init();
+    return sim_eeprom.rd_cnt;
+}
+
+void _test_data(uint8_t * data, uint32_t n)
+{
+    for (unsigned int i = 0; i < NVSTORE_BLOCK_DATA_SIZE; i++)
+        data[i] = (uint8_t)((n * 7) + (i * 31) + (n >> 8));
+}
+
+bool _test_write(_test_record_t * expected, uint8_t key, uint32_t n)
+{
+    uint8_t data[NVSTORE_BLOCK_DATA_SIZE];
+
+    _test_data(data, n);
+    if (!dev_nvstore_write(key, data, sizeof(data)))
+        return false;
+    expected[key].valid = true;
+    memcpy(expected[key].data, data, sizeof(data));
+    return true;
+}
+
+bool _test_records_ok(const _test_record_t * expected, uint8_t torn_key, const uint8_t * torn)
+{
+    for (uint8_t key = 0; key < NVSTORE_KEY_CNT; key++)
+    {
+        uint8_t data[NVSTORE_BLOCK_DATA_SIZE];
+        bool found = dev_nvstore_read(key, data, sizeof(data));
+
+        if ((key == torn_key) && (found) && (!memcmp(data, torn, sizeof(data))))
+            continue; //The torn write made it after all (only the CRC byte matters)
+        if (found != expected[key].valid)
+            return false;
+        if ((found) && (memcmp(data, expected[key].data, sizeof(data))))
+            return false;
+    }
+    return true;
+}
+
+void _test_check(bool ok, const char * name, const char * fmt, ...)
+{
+    va_list args;
+
+    if (!ok)
+        _test_fails++;
+    printf("%s  %-12s ", ok? "pass" : "FAIL", name);
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+    printf("\n");
+}
+
+static void _test_empty(void)
+{
+    _test_record_t expected[NVSTORE_KEY_CNT] = {};
+
+    _test_erase();
+    uint32_t rd = _test_boot();
+    _test_check((_test_records_ok(expected, NVSTORE_KEY_NONE, NULL)) && (_nvstore.current.next_wr == 0) && (_nvstore.new_data == 0),
+                "empty", "no records, next block 0 (%u bytes read)", rd);
+}
+
+static void _test_head_search(void)
+{
+    static const uint32_t _writes[] = {1, 2, 31, 32, 63, 64, 65, 127, 128, 129, 200, 657};
+
+    for (unsigned int i = 0; i < ARRAY_SIZE(_writes); i++)
+    {
+        _test_record_t expected[NVSTORE_KEY_CNT] = {};
+        bool ok = true;
+
+        _test_erase();
+        _test_boot();
+        for (uint32_t n = 1; n <= _writes[i]; n++)
+            ok &= _test_write(expected, n % NVSTORE_KEY_CNT, n);
+
+        uint32_t wr_cnt = _nvstore.current.wr_cnt;  //Incl. the records copied forward
+        uint8_t next_wr = _nvstore.current.next_wr;
+        uint32_t rd = _test_boot();
+        ok &= (_nvstore.current.wr_cnt == wr_cnt) && (_nvstore.current.next_wr == next_wr) && (next_wr == (wr_cnt % NVSTORE_BLOCK_CNT));
+        ok &= _test_records_ok(expected, NVSTORE_KEY_NONE, NULL);
+        _test_check(ok, "head", "%4u writes (%4u blocks): next block %2d (%u bytes read)", _writes[i], wr_cnt, _nvstore.current.next_wr, rd);
+    }
+}
+
+static void _test_old_fw(void)
+{
+    static const uint32_t _writes[] = {1, 5, 64, 100, 130};
+
+    for (unsigned int i = 0; i < ARRAY_SIZE(_writes); i++)
+    {
+        _test_record_t expected[NVSTORE_KEY_CNT] = {};
+
+        //The old fw: the same header, with a version of 0x00 where the key is now
+        _test_erase();
+        for (uint32_t n = 1; n <= _writes[i]; n++)
+        {
+            nvstore_block_t block;
+            block.hdr.magic = NVSTORE_MAGIC;
+            block.hdr.wr_cnt = n;
+            block.hdr.key = 0x00;
+            _test_data(block.data, n);
+            block.crc = crc8_n(0, (uint8_t *)&block, NVSTORE_BLOCK_SIZE - 1);
+            memcpy(&sim_eeprom.mem[((n - 1) % NVSTORE_BLOCK_CNT) * NVSTORE_BLOCK_SIZE], &block, NVSTORE_BLOCK_SIZE);
+        }
+        expected[0].valid = true;
+        _test_data(expected[0].data, _writes[i]);
+
+        uint32_t rd = _test_boot();
+        _test_check((_test_records_ok(expected, NVSTORE_KEY_NONE, NULL)) && (_nvstore.current.wr_cnt == _writes[i]),
+                    "old fw", "%4u writes: read as key 0 (%u bytes read)", _writes[i], rd);
+    }
+}
+
+static void _test_torn(void)
+{
+    _test_record_t expected[NVSTORE_KEY_CNT] = {};
+    uint8_t image[sizeof(sim_eeprom.mem)];
+    uint8_t torn[NVSTORE_BLOCK_DATA_SIZE];
+    uint32_t n = 0;
+
+    //A log which has been round a few times, with a record of every key
+    _test_erase();
+    _test_boot();
+    while (n < 150)
+    {
+        n++;
+        _test_write(expected, n % NVSTORE_KEY_CNT, n);
+    }
+    memcpy(image, sim_eeprom.mem, sizeof(image));
+    _test_boot();
+    uint8_t head_block = _nvstore.current.next_wr;
+
+    //The power fails after each of the bytes of the next block (0 is a write which never started)
+    for (int budget = 0; budget < NVSTORE_BLOCK_SIZE; budget++)
+    {
+        memcpy(sim_eeprom.mem, image, sizeof(image));
+        _test_boot();
+        _test_data(torn, n + 1);
+        sim_eeprom.wr_budget = budget;
+        dev_nvstore_write(1, torn, sizeof(torn));
+
+        uint32_t rd = _test_boot();
+        bool ok = _test_records_ok(expected, NVSTORE_KEY_NONE, NULL); //Not even the CRC made it, so the old record stays
+        ok &= (_nvstore.current.next_wr == head_block);
+
+        //... and the store carries on from there
+        _test_record_t after[NVSTORE_KEY_CNT];
+        memcpy(after, expected, sizeof(after));
+        ok &= _test_write(after, 1, n + 2);
+        _test_boot();
+        ok &= _test_records_ok(after, NVSTORE_KEY_NONE, NULL);
+        _test_check(ok, "torn", "power lost after %2d of %d bytes: next block %2d (%u bytes read)",
+                    budget, NVSTORE_BLOCK_SIZE, _nvstore.current.next_wr, rd);
+    }
+}
+
+static void _test_copy_forward(void)
+{
+    _test_record_t expected[NVSTORE_KEY_CNT] = {};
+    bool ok = true;
+    uint32_t writes = 10 * NVSTORE_BLOCK_CNT;
+
+    //Every key but the last is written once, and then the last key over and over
+    _test_erase();
+    _test_boot();
+    for (uint8_t key = 0; key < (NVSTORE_KEY_CNT - 1); key++)
+        ok &= _test_write(expected, key, key + 1);
+    for (uint32_t n = 0; n < writes; n++)
+    {
+        ok &= _test_write(expected, NVSTORE_KEY_CNT - 1, 100 + n);
+        if ((n % 37) == 0)
+        {
+            _test_boot();
+            ok &= _test_records_ok(expected, NVSTORE_KEY_NONE, NULL);
+        }
+    }
+    _test_boot();
+    ok &= _test_records_ok(expected, NVSTORE_KEY_NONE, NULL);
+    _test_check(ok, "copy fwd", "%d keys written once, then %u writes of key %d: %u blocks written",
+                NVSTORE_KEY_CNT - 1, writes, NVSTORE_KEY_CNT - 1, _nvstore.current.wr_cnt);
+}
+
+static void _test_init_reads(void)
+{
+    _test_record_t expected[NVSTORE_KEY_CNT] = {};
+    uint32_t rd_all = 0;
+    uint32_t rd_missing = 0;
+
+    //Every key written (the oldest the furthest back it can be)
+    _test_erase();
+    _test_boot();
+    for (uint32_t n = 0; n < 300; n++)
+        _test_write(expected, (n == 0)? 0 : 1 + (n % (NVSTORE_KEY_CNT - 1)), n);
+    rd_all = _test_boot();
+
+    //The last key never written
+    _test_erase();
+    _test_boot();
+    for (uint32_t n = 0; n < 300; n++)
+        _test_write(expected, n % (NVSTORE_KEY_CNT - 1), n);
+    rd_missing = _test_boot();
+
+    _test_check((rd_all <= TEST_INIT_RD_MAX) && (rd_all < rd_missing), "init reads",
+                "%u bytes with every key written, %u with a key never written (a scan of every block was %u)",
+                rd_all, rd_missing, NVSTORE_SIZE);
+}
+
+static void _test_soak(uint32_t writes)
+{
+    _test_record_t expected[NVSTORE_KEY_CNT] = {};
+    uint8_t torn[NVSTORE_BLOCK_DATA_SIZE];
+    uint8_t torn_key = NVSTORE_KEY_NONE;
+    uint32_t tears = 0;
+    uint32_t rd_max = 0;
+    uint32_t fail_at = 0;
+
+    srand(TEST_SEED);
+    _test_erase();
+    for (uint32_t n = 1; (n <= writes) && (fail_at == 0); n++)
+    {
+        uint32_t rd = _test_boot();
+        if (rd > rd_max)
+            rd_max = rd;
+        if (!_test_records_ok(expected, torn_key, torn))
+        {
+            fail_at = n;
+            break;
+        }
+        //The torn write made it (or not), so from here on that is what the key reads
+        if (torn_key != NVSTORE_KEY_NONE)
+            expected[torn_key].valid = dev_nvstore_read(torn_key, expected[torn_key].data, NVSTORE_BLOCK_DATA_SIZE);
+        torn_key = NVSTORE_KEY_NONE;
+
+        //Some keys are written a lot more than others (e.g. the clock factor vs the address)
+        uint8_t key = ((rand() % 100) < 70)? (NVSTORE_KEY_CNT - 1) : (uint8_t)(rand() % NVSTORE_KEY_CNT);
+        if ((rand() % 100) < TEST_TEAR_PCT)
+        {
+            //Anywhere in the write, incl. the copies forward before it
+            torn_key = key;
+            _test_data(torn, n);
+            sim_eeprom.wr_budget = rand() % (3 * NVSTORE_BLOCK_SIZE);
+            dev_nvstore_write(key, torn, sizeof(torn));
+            tears++;
+        }
+        else if (!_test_write(expected, key, n))
+        {
+            fail_at = n;
+            break;
+        }
+    }
+
+    _test_check(fail_at == 0, "soak", "%u writes (%u torn): %s, at most %u bytes read at startup",
+                writes, tears, (fail_at == 0)? "no records lost" : "records lost", rd_max);
+    if (fail_at != 0)
+        printf("      at write %u\n", fail_at);
+}
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+int main(int argc, char * argv[])
+{
+    uint32_t writes = TEST_SOAK_WRITES_DEF;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-v"))
+            sim_console_verbose = true;
+        else
+            writes = (uint32_t)strtoul(argv[i], NULL, 0);
+    }
+
+    printf("NV store: %d blocks of %d bytes (%d data), %d keys\n", NVSTORE_BLOCK_CNT, NVSTORE_BLOCK_SIZE, (int)NVSTORE_BLOCK_DATA_SIZE, NVSTORE_KEY_CNT);
+    _test_empty();
+    _test_head_search();
+    _test_old_fw();
+    _test_torn();
+    _test_copy_forward();
+    _test_init_reads();
+    _test_soak(writes);
+
+    printf("%s (%d failed)\n", (_test_fails == 0)? "PASSED" : "FAILED", _test_fails);
+    return _test_fails;
+}
+
+#undef PRINTF_TAG
+/*************************** END OF FILE *************************************/
@@ -0,0 +1,148 @@
+/*******************************************************************************
+
+Module:     sim_eeprom.cpp
+Purpose:    This file contains the host stand-ins for the NV store test
+Author:     Rudolph van Niekerk
+
+The EEPROM itself is in stub/EEPROM.h (the Arduino library is all inline),
+this is its RAM, the clock, the console (the trace goes to stdout with -v,
+and the console menu of the NV store is registered with nobody, so the string
+helpers it parses its arguments with are never called) and the CRC (the same
+as in sys_utils.cpp, the rest of which is AVR ports and the ADC).
+
+ *******************************************************************************/
+
+/*******************************************************************************
+includes
+ *******************************************************************************/
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <EEPROM.h>
+
+#include "sys_utils.h"
+#include "dev_console.h"
+#include "hal_timers.h"
+#include "str_helper.h"
+
+/*******************************************************************************
+Global (public) variables
+ *******************************************************************************/
+sim_eeprom_t sim_eeprom = {.wr_budget = -1, .last_wr_addr = -1};
+bool sim_console_verbose = false;
+
+/*******************************************************************************
+Global (public) Functions
+ *******************************************************************************/
+unsigned long millis(void)
+{
+    return 0;
+}
+
+void console_printline(uint8_t traceflags, const char * tag, const char *fmt, ...)
+{
+    va_list args;
+
+    if (!sim_console_verbose)
+        return;
+    va_start(args, fmt);
+    printf("      [%s] ", tag);
+    vprintf(fmt, args);
+    printf("\n");
+    va_end(args);
+}
+
+void console_print(uint8_t traceflags, const char * tag, const char *fmt, ...)
+{
+    va_list args;
+
+    if (!sim_console_verbose)
+        return;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+void console_print_ram(int Flags, void * Src, unsigned long Address, int Len) {}
+
+int console_add_menu(const char * name, const console_menu_item_t * items, size_t cnt, const char * desc)
+{
+    return 0;
+}
+
+int console_arg_cnt(void)
+{
+    return 0;
+}
+
+bool console_arg_help_found(void)
+{
+    return false;
+}
+
+char * console_arg_pop(void)
+{
+    return NULL;
+}
+
+void sys_stopwatch_ms_start(stopwatch_ms_t* sw, unsigned long max_time) {}
+
+unsigned long sys_stopwatch_ms_stop(stopwatch_ms_t* sw)
+{
+    return 0;
+}
+
+bool str2int64(int64_t *val, const char * str, int expected_len)
+{
+    return false;
+}
+
+bool str2uint32(uint32_t *val, const char * str, int expected_len)
+{
+    return false;
+}
+
+uint8_t hex2byte(char * hexDigits)
+{
+    return 0;
+}
+
+bool is_natural_number_str(const char * str, int32_t expected_len)
+{
+    return false;
+}
+
+bool is_hex_str(const char * str, unsigned int expected_len)
+{
+    return false;
+}
+
+char * float2str(char *buff, double fVal, unsigned int decimalpoints, size_t max_len)
+{
+    snprintf(buff, max_len, "%.*f", (int)decimalpoints, fVal);
+    return buff;
+}
+
+uint8_t crc8_n(uint8_t crc_start, const uint8_t *data, uint8_t len)
+{
+    uint8_t crc = crc_start;
+    while (len--)
+        crc = crc8(crc, *data++);
+    return crc;
+}
+
+uint8_t crc8(uint8_t crc_start, uint8_t data)
+{
+    uint8_t crc = crc_start;
+    for (uint8_t i = 8; i; i--)
+    {
+        uint8_t sum = (crc ^ data) & 0x01;
+        crc >>= 1;
+        if (sum)
+            crc ^= CRC_POLYNOMIAL;
+        data >>= 1;
+    }
+    return crc;
+}
+
+/*************************** END OF FILE *************************************/
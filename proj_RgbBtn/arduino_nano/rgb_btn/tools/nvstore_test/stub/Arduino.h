@@ -0,0 +1,37 @@
+/*****************************************************************************
+
+Arduino.h
+
+The host stand-in for the Arduino core (only what the NV store, the comms
+and the utilities they use need, see tools/nvstore_test and tools/comms_test)
+
+******************************************************************************/
+#ifndef __Arduino_H__
+#define __Arduino_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define HIGH            (1)
+#define LOW             (0)
+#define OUTPUT          (1)
+#define INPUT           (0)
+
+#define cli()
+#define sei()
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+unsigned long millis(void);
+
+//Macros, as in the AVR core (so the 2 sides may be of different types)
+#define min(a, b)       ((a) < (b)? (a) : (b))
+#define max(a, b)       ((a) > (b)? (a) : (b))
+
+#endif /* __Arduino_H__ */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,58 @@
+/*****************************************************************************
+
+EEPROM.h
+
+The host stand-in for the Arduino EEPROM library: the 1kB EEPROM of the Nano
+in RAM (sim_eeprom.cpp), with the bytes read and written counted, and a write
+budget to tear a block write part of the way through (as a reset or a brown-out
+would).
+
+******************************************************************************/
+#ifndef __EEPROM_H__
+#define __EEPROM_H__
+
+#include <stdint.h>
+
+/******************************************************************************
+Macros
+******************************************************************************/
+#define E2END                   (1023)
+
+/******************************************************************************
+Struct & Unions
+******************************************************************************/
+typedef struct
+{
+    uint8_t mem[E2END + 1];
+    uint32_t rd_cnt;            // Bytes read
+    uint32_t wr_cnt;            // Bytes written
+    int32_t wr_budget;          // The bytes left to write before the "power fails" (< 0 for no limit)
+    int last_wr_addr;           // The address of the last byte written (-1 if none)
+} sim_eeprom_t;
+
+extern sim_eeprom_t sim_eeprom;
+
+struct EEPROMClass
+{
+    uint8_t read(int addr)
+    {
+        sim_eeprom.rd_cnt++;
+        return sim_eeprom.mem[addr];
+    }
+    void write(int addr, uint8_t value)
+    {
+        if (sim_eeprom.wr_budget == 0)
+            return; //The power is gone
+        if (sim_eeprom.wr_budget > 0)
+            sim_eeprom.wr_budget--;
+        sim_eeprom.wr_cnt++;
+        sim_eeprom.mem[addr] = value;
+        sim_eeprom.last_wr_addr = addr;
+    }
+};
+
+static EEPROMClass EEPROM __attribute__((unused));
+
+#endif /* __EEPROM_H__ */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,7 @@
+/*****************************************************************************
+
+io.h
+
+The host stand-in for avr/io.h (nothing the NV store needs)
+
+******************************************************************************/
@@ -0,0 +1,17 @@
+/*****************************************************************************
+
+pgmspace.h
+
+The host stand-in for avr/pgmspace.h (there is only the one address space)
+
+******************************************************************************/
+#ifndef __pgmspace_H__
+#define __pgmspace_H__
+
+#define PROGMEM
+#define PSTR(s)                 (s)
+#define pgm_read_byte(addr)     (*(const uint8_t *)(addr))
+
+#endif /* __pgmspace_H__ */
+
+/****************************** END OF FILE **********************************/
@@ -0,0 +1,17 @@
+/*****************************************************************************
+
+atomic.h
+
+The host stand-in for util/atomic.h (there are no interrupts on the host, so
+an ATOMIC_BLOCK is just a block, see tools/node_test)
+
+******************************************************************************/
+#ifndef __util_atomic_H__
+#define __util_atomic_H__
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_BLOCK(type)  for (int _atomic_once = 1; _atomic_once; _atomic_once = 0)
+
+#endif /* __util_atomic_H__ */
+
+/****************************** END OF FILE **********************************/
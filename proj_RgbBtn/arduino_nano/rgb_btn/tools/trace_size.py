@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Reports the flash/RAM cost of each compile-time trace level of the node fw.
+
+Builds the nano_trace_* envs in platformio.ini (the same build at
+CONSOLE_TRACE_LEVEL NONE, ERROR and INFO) and the default env (DEBUG), picks
+the memory usage from the build output of each, and prints a markdown table
+with the difference of every level to the one below it and to NONE.
+
+Run it from anywhere, with PlatformIO on the path (or pass --pio):
+
+    tools/trace_size.py [--pio ~/.platformio/penv/bin/pio] [--logs <dir>]
+
+With --logs the build output of each env is also saved as <dir>/<env>.log, and
+with --from-logs the envs are not built, the saved logs are read instead.
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# (trace level, env), from the least to the most compiled in
+LEVELS = (
+    ("NONE", "nano_trace_none"),
+    ("ERROR", "nano_trace_error"),
+    ("INFO", "nano_trace_info"),
+    ("DEBUG", "nanoatmega328new"),
+)
+
+# PlatformIO's summary, e.g. "Flash: [=====     ]  48.6% (used 14936 bytes from 30720 bytes)"
+PIO_USAGE = re.compile(r"^(RAM|Flash):\s+\[.*\]\s+[\d.]+%\s+\(used (\d+) bytes from (\d+) bytes\)", re.MULTILINE)
+# The linker's (-Wl,--print-memory-usage), e.g. "            text:       14936 B        32 KB     45.58%"
+LD_USAGE = re.compile(r"^\s*(text|data):\s+(\d+)\s*([KM]?)B\s", re.MULTILINE)
+
+
+def build(pio, env):
+    """Builds an env and returns its output (stdout and stderr)"""
+    result = subprocess.run([pio, "run", "-d", PROJECT_DIR, "-e", env],
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    if result.returncode != 0:
+        sys.stderr.write(result.stdout)
+        raise SystemExit("pio run -e %s failed (%d)" % (env, result.returncode))
+    return result.stdout
+
+
+def usage(output, env):
+    """Returns (flash, ram) in bytes from the build output of an env"""
+    found = {name: int(used) for name, used, _ in PIO_USAGE.findall(output)}
+    if ("Flash" in found) and ("RAM" in found):
+        return found["Flash"], found["RAM"]
+
+    # No summary (e.g. a quiet build), fall back on the linker's report
+    scale = {"": 1, "K": 1024, "M": 1024 * 1024}
+    found = {name: int(used) * scale[unit] for name, used, unit in LD_USAGE.findall(output)}
+    if ("text" in found) and ("data" in found):
+        return found["text"], found["data"]
+
+    raise SystemExit("No memory usage in the build output of %s" % env)
+
+
+def delta(value, ref):
+    return "%+d" % (value - ref) if ref is not None else "-"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--pio", default="pio", help="The PlatformIO executable (default: pio)")
+    parser.add_argument("--logs", help="Saves the build output of each env in this directory")
+    parser.add_argument("--from-logs", help="Reads the build output of each env from this directory iso building")
+    args = parser.parse_args()
+
+    rows = []
+    for level, env in LEVELS:
+        if args.from_logs:
+            with open(os.path.join(args.from_logs, env + ".log")) as f:
+                output = f.read()
+        else:
+            print("Building %s (%s)..." % (env, level), file=sys.stderr)
+            output = build(args.pio, env)
+            if args.logs:
+                os.makedirs(args.logs, exist_ok=True)
+                with open(os.path.join(args.logs, env + ".log"), "w") as f:
+                    f.write(output)
+        flash, ram = usage(output, env)
+        rows.append((level, env, flash, ram))
+
+    none_flash, none_ram = rows[0][2], rows[0][3]
+    prev_flash, prev_ram = None, None
+    print("| Trace level | Env | Flash (B) | vs prev | vs NONE | RAM (B) | vs prev | vs NONE |")
+    print("|-------------|-----|----------:|--------:|--------:|--------:|--------:|--------:|")
+    for level, env, flash, ram in rows:
+        print("| %s | %s | %d | %s | %s | %d | %s | %s |" % (level, env,
+              flash, delta(flash, prev_flash), delta(flash, none_flash),
+              ram, delta(ram, prev_ram), delta(ram, none_ram)))
+        prev_flash, prev_ram = flash, ram
+
+
+if __name__ == "__main__":
+    main()